@@ -0,0 +1,322 @@
+;;; Allocation and garbage collector benchmarks.
+;;;
+;;; Each benchmark runs a few times after a warmup and reports the
+;;; median and the minimum of the wall-clock time, along with the GC
+;;; time and bytes consed from the median run. The results go to a
+;;; JSON object, one member per benchmark, with the keys in a fixed
+;;; order so that the output of two SBCL versions can be diffed.
+;;;
+;;; Only external symbols and interfaces present in older releases are
+;;; used, so the same file can be loaded into the versions being
+;;; compared. Run it with gc-suite.sh, or:
+;;;
+;;; ./run-sbcl.sh --dynamic-space-size 4GB \
+;;;    --load benchmarks/gc-suite.lisp \
+;;;    --eval '(gc-suite:run :output "gc.json")' --quit
+
+(defpackage "GC-SUITE"
+  (:use "CL")
+  (:export "RUN" "*BENCHMARKS*"))
+
+(in-package "GC-SUITE")
+
+(defvar *benchmarks* '()
+  "List of (NAME FUNCTION . PLIST) in order of definition.")
+
+;;; Scale the amount of work of every benchmark.
+(defvar *scale* 1)
+
+(defmacro define-benchmark (name (&rest plist) &body body)
+  "Define a benchmark NAME whose BODY does one run. PLIST can give
+:RUNS, the number of timed runs, and :SETUP, a form evaluated before
+each run, untimed, whose value is bound to SETUP in BODY."
+  (destructuring-bind (&key (runs 5) setup) plist
+    `(let ((entry (list ',name
+                        (lambda (setup)
+                          (declare (ignorable setup))
+                          ,@body)
+                        :runs ,runs
+                        :setup (lambda () ,setup))))
+       (setf *benchmarks*
+             (append (remove ',name *benchmarks* :key #'car)
+                     (list entry)))
+       ',name)))
+
+(defun now ()
+  (get-internal-real-time))
+
+(defun seconds (ticks)
+  (/ (float ticks 1d0) internal-time-units-per-second))
+
+;;; Keep results reachable so that the compiler can't drop the work,
+;;; and clear them between runs.
+(sb-ext:defglobal *sink* nil)
+
+;;; Run ENTRY and return an alist of its statistics.
+(defun measure (entry)
+  (destructuring-bind (name fun &key runs setup) entry
+    (declare (ignore name))
+    (flet ((run-once ()
+             (let ((state (funcall setup)))
+               (sb-ext:gc :full t)
+               (let ((gc-start sb-ext:*gc-run-time*)
+                     (consed-start (sb-ext:get-bytes-consed))
+                     (start (now)))
+                 (let ((extra (funcall fun state)))
+                   (let ((elapsed (- (now) start)))
+                     (setq *sink* nil)
+                     (list* (seconds elapsed)
+                            (seconds (- sb-ext:*gc-run-time* gc-start))
+                            (- (sb-ext:get-bytes-consed) consed-start)
+                            (if (listp extra) extra nil))))))))
+      (run-once)                        ; warmup
+      (let* ((samples (sort (loop repeat runs collect (run-once)) #'< :key #'first))
+             (median (nth (floor runs 2) samples)))
+        (destructuring-bind (real gc consed &rest extra) median
+          `(("median_s" . ,real)
+            ("min_s" . ,(first (first samples)))
+            ("gc_s" . ,gc)
+            ("bytes_consed" . ,consed)
+            ,@extra))))))
+
+;;;; JSON output
+
+(defun write-json-value (value stream)
+  (etypecase value
+    (integer (format stream "~D" value))
+    (real (format stream "~,6F" value))
+    (string (write-char #\" stream)
+            (loop for char across value
+                  do (case char
+                       ((#\" #\\) (write-char #\\ stream) (write-char char stream))
+                       (#\Newline (write-string "\\n" stream))
+                       (t (write-char char stream))))
+            (write-char #\" stream))
+    (list (write-json-object value stream))))
+
+(defun write-json-object (alist stream &optional (indent 0))
+  (format stream "{")
+  (loop for ((key . value) . more) on alist
+        do (format stream "~%~vT" (+ indent 2))
+           (write-json-value (string-downcase key) stream)
+           (write-string ": " stream)
+           (if (and (listp value) value (consp (car value)))
+               (write-json-object value stream (+ indent 2))
+               (write-json-value value stream))
+           (when more (write-char #\, stream)))
+  (format stream "~%~vT}" indent))
+
+(defun run (&key (output *standard-output*) (only nil) ((:scale *scale*) *scale*))
+  "Run the benchmarks, or those named in ONLY, and write the results as
+JSON to OUTPUT, a stream or a pathname designator."
+  (let ((results
+          (loop for entry in *benchmarks*
+                when (or (null only) (member (car entry) only :test #'string-equal))
+                  collect (progn
+                            (format *error-output* "~&; ~(~A~)~%" (car entry))
+                            (cons (car entry) (measure entry)))))
+        (environment
+          `(("lisp_implementation_version" . ,(lisp-implementation-version))
+            ("machine_type" . ,(machine-type))
+            ("dynamic_space_size" . ,(sb-ext:dynamic-space-size))
+            ("bytes_consed_between_gcs" . ,(sb-ext:bytes-consed-between-gcs))
+            ("scale" . ,*scale*))))
+    (flet ((emit (stream)
+             (write-json-object `(("environment" . ,environment)
+                                  ("benchmarks" . ,results))
+                                stream)
+             (terpri stream)))
+      (if (streamp output)
+          (emit output)
+          (with-open-file (stream output :direction :output :if-exists :supersede)
+            (emit stream))))
+    results))
+
+;;;; Allocation throughput
+
+(define-benchmark cons-throughput ()
+  (let ((list nil))
+    (dotimes (i (* *scale* 20000000))
+      (setq list (cons i (if (zerop (logand i 1023)) nil list))))
+    (setq *sink* list)))
+
+(defstruct (small (:constructor make-small (a b)))
+  a b)
+
+(define-benchmark small-instance-throughput ()
+  (let ((last nil))
+    (dotimes (i (* *scale* 10000000))
+      (setq last (make-small i last))
+      (when (zerop (logand i 1023))
+        (setq last nil)))
+    (setq *sink* last)))
+
+(define-benchmark large-vector-throughput ()
+  ;; Vectors past the large object threshold go to their own pages.
+  (dotimes (i (* *scale* 2000))
+    (setq *sink* (make-array 100000 :initial-element i))))
+
+;;;; Minor GC pause versus the size of the old generation and the
+;;;; fraction of its cards that are dirty
+
+(defun make-old-generation (n-conses)
+  (let ((vector (make-array (floor n-conses 64))))
+    (dotimes (i (length vector))
+      (setf (svref vector i) (make-list 64)))
+    (sb-ext:gc :full t)
+    vector))
+
+(defun minor-gc-pause (old dirty-fraction)
+  (let ((n-dirty (floor (* (length old) dirty-fraction)))
+        (pauses '()))
+    (dotimes (iteration 10)
+      ;; Point some old lists at young objects, dirtying their cards.
+      (dotimes (i n-dirty)
+        (setf (car (svref old (floor (* i (length old)) (max n-dirty 1))))
+              (list iteration)))
+      (let ((start (now)))
+        (sb-ext:gc)
+        (push (seconds (- (now) start)) pauses)))
+    (setq pauses (sort pauses #'<))
+    `(("pause_median_s" . ,(nth 5 pauses))
+      ("pause_max_s" . ,(car (last pauses))))))
+
+(macrolet ((def (name n-conses dirty-fraction)
+             `(define-benchmark ,name
+                  (:runs 3 :setup (make-old-generation (* *scale* ,n-conses)))
+                (minor-gc-pause setup ,dirty-fraction))))
+  (def minor-gc-old-1m-clean 1000000 0)
+  (def minor-gc-old-10m-clean 10000000 0)
+  (def minor-gc-old-10m-dirty-1% 10000000 1/100)
+  (def minor-gc-old-10m-dirty-25% 10000000 1/4))
+
+;;;; Pinning: collections while deep stacks hold many conservative
+;;;; roots, and explicit pins
+
+(defun recurse-and-collect (depth n-gcs)
+  (declare (fixnum depth))
+  (let ((a (list depth)) (b (make-small depth nil)) (c (make-array 3)))
+    (if (zerop depth)
+        (dotimes (i n-gcs) (sb-ext:gc))
+        (recurse-and-collect (1- depth) n-gcs))
+    ;; Use the locals after the call so that they stay on the stack.
+    (setq *sink* (list* a b c *sink*))
+    nil))
+
+(define-benchmark pinned-deep-stack ()
+  (recurse-and-collect (* *scale* 20000) 20))
+
+(define-benchmark with-pinned-objects ()
+  (let ((objects (loop repeat 1000 collect (make-array 10))))
+    (dotimes (i (* *scale* 200))
+      (labels ((pin (list)
+                 (if list
+                     (sb-sys:with-pinned-objects ((car list))
+                       (pin (cdr list)))
+                     (sb-ext:gc))))
+        (pin objects)))))
+
+;;;; Weak hash tables
+
+(macrolet ((def (name weakness)
+             `(define-benchmark ,name ()
+                (let ((table (make-hash-table :test 'eq :weakness ,weakness)))
+                  (dotimes (i (* *scale* 2000000))
+                    (let ((object (make-small i nil)))
+                      (setf (gethash object table) object)
+                      (when (zerop (mod i 200000))
+                        (sb-ext:gc))))
+                  (setq *sink* table)
+                  `(("final_count" . ,(hash-table-count table)))))))
+  (def weak-table-key :key)
+  (def weak-table-value :value)
+  (def weak-table-key-or-value :key-or-value))
+
+;;;; Finalizers
+
+(define-benchmark finalizer-storm ()
+  ;; The finalizers may run in a thread of their own.
+  (let ((count (list 0)) (n (* *scale* 200000)))
+    (dotimes (i n)
+      (sb-ext:finalize (make-small i nil)
+                       (lambda () (sb-ext:atomic-incf (car count)))
+                       :dont-save t))
+    (sb-ext:gc :full t)
+    (let ((deadline (+ (now) (* 60 internal-time-units-per-second))))
+      (loop until (or (>= (car count) n) (> (now) deadline))
+            do (sb-impl::run-pending-finalizers)
+               (sleep 0.001)))
+    `(("finalizers_run" . ,(car count)))))
+
+;;;; Multi-threaded allocation scaling
+
+#+sb-thread
+(defun threaded-allocation (n-threads)
+  (let* ((work (floor (* *scale* 40000000) n-threads))
+         (threads
+           (loop repeat n-threads
+                 collect (sb-thread:make-thread
+                          (lambda ()
+                            (let ((list nil))
+                              (dotimes (i work)
+                                (setq list (cons i (if (zerop (logand i 1023)) nil list))))
+                              (length list)))))))
+    (mapc #'sb-thread:join-thread threads)
+    nil))
+
+#+sb-thread
+(macrolet ((def (name n-threads)
+             `(define-benchmark ,name ()
+                (threaded-allocation ,n-threads))))
+  (def threaded-cons-1 1)
+  (def threaded-cons-2 2)
+  (def threaded-cons-4 4)
+  (def threaded-cons-8 8))
+
+;;;; Handlers and restarts: establishing them around each record, as
+;;;; a parser does, should not cons. One record in 1000 fails, and only
+;;;; those cons, for the condition.
+
+(defun parse-record (string fail)
+  (declare (simple-string string))
+  (multiple-value-bind (value end) (parse-integer string :junk-allowed t)
+    (if (and fail (= end (length string)))
+        (error "Bad record ~S" string)
+        value)))
+
+(macrolet ((def (name (string fail) form)
+             `(define-benchmark ,name ()
+                (let ((n (* *scale* 5000000))
+                      (string (copy-seq "12345"))
+                      (sum 0)
+                      (consed-start (sb-ext:get-bytes-consed)))
+                  (dotimes (i n)
+                    (let ((,string string)
+                          (,fail (zerop (mod i 1000))))
+                      (incf sum (or ,form 0))))
+                  `(("bytes_per_record"
+                     . ,(float (/ (- (sb-ext:get-bytes-consed) consed-start) n) 1d0))
+                    ("sum" . ,sum))))))
+  (def handler-case-per-record (string fail)
+    (handler-case (parse-record string fail)
+      (error () nil)))
+  (def handler-bind-per-record (string fail)
+    (block record
+      (handler-bind ((error (lambda (c)
+                              (declare (ignore c))
+                              (return-from record nil))))
+        (parse-record string fail))))
+  (def restart-case-per-record (string fail)
+    (handler-bind ((error (lambda (c)
+                            (declare (ignore c))
+                            (invoke-restart 'use-value nil))))
+      (restart-case (parse-record string fail)
+        (use-value (value)
+          :report (lambda (stream) (format stream "Use a value for ~S." string))
+          value)
+        (continue ()
+          nil))))
+  (def with-simple-restart-per-record (string fail)
+    (handler-bind ((error #'abort))
+      (values (with-simple-restart (abort "Skip record ~S." string)
+                (parse-record string fail))))))
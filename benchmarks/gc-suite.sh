@@ -0,0 +1,48 @@
+#!/bin/sh
+# Run the allocation and GC benchmarks in gc-suite.lisp and write the
+# results as JSON.
+#
+#   sh benchmarks/gc-suite.sh [OPTIONS] [BENCHMARK ...]
+#
+# Options:
+#   --sbcl COMMAND   the SBCL to measure (default: the freshly built one)
+#   --output FILE    where to write the JSON (default: standard output)
+#   --scale N        multiply the work of each benchmark by N (default: 1)
+#
+# Progress goes to standard error. To compare two releases, run the
+# suite with each one and diff the JSON.
+
+set -e
+
+here=`dirname "$0"`
+sbcl="$here/../run-sbcl.sh"
+output=""
+scale=1
+only=""
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --sbcl) sbcl="$2"; shift 2 ;;
+        --output) output="$2"; shift 2 ;;
+        --scale) scale="$2"; shift 2 ;;
+        -*) echo "unknown option: $1" >&2; exit 1 ;;
+        *) only="$only \"$1\""; shift ;;
+    esac
+done
+
+if [ -n "$output" ]; then
+    output_arg="\"$output\""
+else
+    output_arg="*standard-output*"
+fi
+if [ -n "$only" ]; then
+    only_arg="'($only)"
+else
+    only_arg="nil"
+fi
+
+exec $sbcl --dynamic-space-size 4GB --noinform --non-interactive \
+    --no-sysinit --no-userinit \
+    --eval '(setq *compile-verbose* nil *compile-print* nil)' \
+    --load "$here/gc-suite.lisp" \
+    --eval "(gc-suite:run :output $output_arg :only $only_arg :scale $scale)"
@@ -37,6 +37,73 @@ The statistics:
  [ 6463084  5699894  6391162  5323400  5510025  5425688  6288613  4886611  5456971  5394043  5564274  5639621  5054329  5722550  5208487  5986264  6858847  5267559  7030543  5811645  5656792  5012832  6000738  5682139  7220169  6433044  5468151  5295718  5333045  5908446]
 |#
 
+;;; Stop-the-world latency, which works the same with either way of
+;;; stopping threads. Build twice to compare them:
+;;;   ./make.sh --with-sb-thread                   ; signals (SIG_STOP_FOR_GC)
+;;;   ./make.sh --with-sb-thread --with-sb-safepoint
+;;; then, in each:
+;;; * (load (compile-file "benchmarks/threads-compile"))
+;;; * (stop-latency-benchmark 1000)
+;;; which prints the distribution of the time taken to stop every thread,
+;;; and of the whole pause, from SB-EXT:GC-PAUSE-HISTOGRAM.
+
+;;; Print the median, 99th percentile and maximum of the samples that
+;;; histogram row ROW gained between BEFORE and AFTER. Those are bucket
+;;; bounds, so they are only accurate to within a factor of 2.
+(defun print-pause-distribution (label before after row)
+  (let* ((counts (loop for i below 32
+                       collect (- (aref after row i) (aref before row i))))
+         (total (reduce #'+ counts)))
+    (flet ((quantile (q)
+             (let ((sum 0) (rank (max 1 (ceiling (* q total)))))
+               (loop for count in counts for i from 0
+                     do (incf sum count)
+                     when (>= sum rank) return (ash 1 i)))))
+      (if (zerop total)
+          (format t "~&~A: no samples~%" label)
+          (format t "~&~A: ~D samples, median <= ~Dus, p99 <= ~Dus, max <= ~Dus~%"
+                  label total (quantile 1/2) (quantile 99/100) (quantile 1))))))
+
+;;; Run N-THREADS threads and collect garbage N-GCS times. IDLE-FRACTION
+;;; of the threads wait on a semaphore, so they are in foreign code,
+;;; and the rest run Lisp code that conses a little now and then.
+(defun stop-latency-benchmark (n-threads &key (n-gcs 100) (idle-fraction 1/2))
+  (let* ((n-idle (floor (* n-threads idle-fraction)))
+         (stop nil)
+         (idle (sb-thread:make-semaphore))
+         (started (sb-thread:make-semaphore))
+         (threads
+          (loop for i below n-threads
+                collect (sb-thread:make-thread
+                         (if (< i n-idle)
+                             (lambda ()
+                               (sb-thread:signal-semaphore started)
+                               (sb-thread:wait-on-semaphore idle))
+                             (lambda ()
+                               (sb-thread:signal-semaphore started)
+                               (let ((sum 0) (list nil))
+                                 (declare (fixnum sum))
+                                 (loop until stop
+                                       do (dotimes (j 10000)
+                                            (setq sum (logand (+ sum j) #xffff)))
+                                          (setq list (make-list 10)))
+                                 (length list))))
+                         :name (format nil "worker~d" i)))))
+    (sb-thread:wait-on-semaphore started :n n-threads)
+    (let ((before (sb-ext:gc-pause-histogram)))
+      (dotimes (i n-gcs)
+        (gc)
+        (sleep .01))
+      (let ((after (sb-ext:gc-pause-histogram)))
+        (format t "~&~D threads, ~D idle, ~A~%" n-threads n-idle
+                #+sb-safepoint "safepoints" #-sb-safepoint "signals")
+        (print-pause-distribution "stop all threads" before after 6)
+        (print-pause-distribution "whole pause" before after 5)))
+    (setq stop t)
+    (sb-thread:signal-semaphore idle n-idle)
+    (mapc #'sb-thread:join-thread threads)
+    nil))
+
 (defparameter *gcmetrics-condvar*
   (sb-sys:find-dynamic-foreign-symbol-address "gcmetrics_condvar"))
 (defparameter *gcmetrics-mutex*
@@ -89,7 +156,8 @@ The statistics:
              :name (format nil "worker~d" i)
              :arguments i)
             threads)))
-    (let ((start (get-internal-real-time)))
+    (let ((start (get-internal-real-time))
+          (histogram (sb-ext:gc-pause-histogram)))
       (assert (= 0 (pthread-mutex-lock *gcmetrics-mutex*)))
       (loop
         (let ((count (count t running)))
@@ -111,7 +179,9 @@ The statistics:
       (pthread-mutex-unlock *gcmetrics-mutex*)
       (let ((end (get-internal-real-time)))
         (format t "~&all done: ~fs~%"
-                (/ (- end start) internal-time-units-per-second))))))
+                (/ (- end start) internal-time-units-per-second))
+        (print-pause-distribution "stop all threads" histogram
+                                  (sb-ext:gc-pause-histogram) 6)))))
 
 ;;; run this with a 16GB dynamic space
 (defun allocator-benchmark (n-threads n-iter)
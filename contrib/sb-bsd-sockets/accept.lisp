@@ -0,0 +1,81 @@
+(in-package :sb-bsd-sockets)
+
+;;;; Accepting connections without consing, and spreading them between
+;;;; listeners with SO_REUSEPORT
+
+;;; Copy the address of the INET or INET6 SOCKADDR into OCTETS from
+;;; START, and return its port, or NIL if it is of another family.
+;;; Ports and addresses are in network byte order in a sockaddr.
+(defun sockaddr-address-into (sockaddr octets start)
+  (declare (type sb-sys:system-area-pointer sockaddr)
+           (type (simple-array (unsigned-byte 8) (*)) octets)
+           (type sb-int:index start))
+  (flet ((store (port-offset addr-offset n)
+           (dotimes (j n)
+             (setf (aref octets (+ start j))
+                   (sb-sys:sap-ref-8 sockaddr (+ addr-offset j))))
+           (logior (ash (sb-sys:sap-ref-8 sockaddr port-offset) 8)
+                   (sb-sys:sap-ref-8 sockaddr (1+ port-offset)))))
+    (let ((family (sb-sys:sap-ref-16 sockaddr sockint::sin-family-offset)))
+      (cond ((= family sockint::af-inet)
+             (store sockint::sin-port-offset sockint::sin-addr-offset 4))
+            ((= family sockint::af-inet6)
+             (store sockint::sin6-port-offset sockint::sin6-addr-offset 16))
+            (t nil)))))
+
+(defmethod socket-accept-file-descriptor ((socket socket) address
+                                          &key (start 0) (nonblocking t)
+                                               (close-on-exec t))
+  (declare (type (or null (simple-array (unsigned-byte 8) (*))) address)
+           (type sb-int:index start))
+  (when address
+    (let ((needed (case (socket-family socket)
+                    (#.sockint::af-inet 4)
+                    (#.sockint::af-inet6 16)
+                    (t 0))))
+      (unless (<= (+ start needed) (length address))
+        (error "~S has no room for ~D octets of address from ~D."
+               address needed start))))
+  (let ((flags (logior (if nonblocking sockint::sock-nonblock 0)
+                       (if close-on-exec sockint::sock-cloexec 0))))
+    (sb-alien:with-alien ((sockaddr (array (sb-alien:unsigned 8)
+                                           #.sockint::size-of-sockaddr-storage)))
+      (let ((sap (sb-alien:alien-sap sockaddr)))
+        (socket-error-case ("accept4"
+                            (sockint::accept4 (socket-file-descriptor socket)
+                                              (if address sap (sb-sys:int-sap 0))
+                                              (if address
+                                                  sockint::size-of-sockaddr-storage
+                                                  0)
+                                              flags)
+                            fd)
+            (values fd (and address (sockaddr-address-into sap address start)))
+          (:interrupted nil))))))
+
+(defun make-reuse-port-listeners (count address port &key (backlog 128))
+  "Returns a list of COUNT listening TCP sockets bound to ADDRESS and
+PORT with SO_REUSEPORT set. The kernel spreads the incoming connections
+between them, so that a thread accepting from each one does not contend
+with the others for a single queue. ADDRESS is a vector of 4 octets for
+INET-SOCKETs or of 16 for INET6-SOCKETs. If PORT is 0, the kernel picks
+a port for the first socket, and the others are bound to the same."
+  (declare (type (integer 1) count))
+  (let ((class (ecase (length address)
+                 (4 'inet-socket)
+                 (16 'inet6-socket)))
+        (listeners '())
+        (done nil))
+    (unwind-protect
+         (progn
+           (dotimes (i count)
+             (let ((socket (make-instance class :type :stream :protocol :tcp)))
+               (push socket listeners)
+               (setf (sockopt-reuse-port socket) t)
+               (socket-bind socket address port)
+               (when (zerop port)
+                 (setf port (nth-value 1 (socket-name socket))))
+               (socket-listen socket backlog)))
+           (setf done t)
+           (nreverse listeners))
+      (unless done
+        (mapc #'socket-close listeners)))))
@@ -0,0 +1,190 @@
+(in-package :sb-bsd-sockets)
+
+;;;; Sending and receiving many datagrams per system call, with
+;;;; recvmmsg(2) and sendmmsg(2)
+
+;;; A batch owns a block of foreign memory with a struct mmsghdr, a
+;;; struct iovec and a struct sockaddr_storage for each datagram. The
+;;; fields that point within that block are set once, when the batch
+;;; is made. Each call only stores the pointers into DATA, which may
+;;; have moved since the previous call, and the lengths.
+
+(defconstant +mmsghdr-size+
+  ;; struct mmsghdr { struct msghdr msg_hdr; unsigned int msg_len; }
+  (* sb-vm:n-word-bytes (ceiling (+ sockint::size-of-msghdr 4) sb-vm:n-word-bytes)))
+
+(defstruct (datagram-batch (:constructor %make-datagram-batch
+                               (count buffer-size data lengths addresses ports
+                                headers))
+                           (:copier nil))
+  "Storage for receiving or sending up to COUNT datagrams of at most
+BUFFER-SIZE octets each with one system call. Datagram I occupies DATA
+from I times BUFFER-SIZE, and its length is element I of LENGTHS. The
+address of its peer is in ADDRESSES from I times 16: all 16 octets for
+an INET6-SOCKET, the first 4 for an INET-SOCKET. Its port is element I
+of PORTS.
+
+SOCKET-RECEIVE-BATCH and SOCKET-SEND-BATCH allocate nothing in the Lisp
+heap."
+  (count 0 :type sb-int:index :read-only t)
+  (buffer-size 0 :type sb-int:index :read-only t)
+  (data nil :type (simple-array (unsigned-byte 8) (*)) :read-only t)
+  (lengths nil :type (simple-array (unsigned-byte 32) (*)) :read-only t)
+  (addresses nil :type (simple-array (unsigned-byte 8) (*)) :read-only t)
+  (ports nil :type (simple-array (unsigned-byte 16) (*)) :read-only t)
+  ;; The headers, then the iovecs, then the sockaddrs
+  (headers (sb-sys:int-sap 0) :type sb-sys:system-area-pointer :read-only t))
+
+(declaim (inline batch-header batch-sockaddr))
+(defun batch-header (batch i)
+  (sb-sys:sap+ (datagram-batch-headers batch) (* i +mmsghdr-size+)))
+
+(defun batch-sockaddr (batch i)
+  (sb-sys:sap+ (datagram-batch-headers batch)
+               (* (datagram-batch-count batch)
+                  (+ +mmsghdr-size+ sockint::size-of-iovec))
+               (* i sockint::size-of-sockaddr-storage)))
+
+(defun make-datagram-batch (count buffer-size)
+  "Returns a DATAGRAM-BATCH for COUNT datagrams of at most BUFFER-SIZE
+octets. Its foreign memory is freed when the batch is garbage
+collected. A batch can't be used after SAVE-LISP-AND-DIE."
+  (declare (type (integer 1 1024) count)
+           (type (integer 1 #.(1- (ash 1 31))) buffer-size))
+  (let* ((total (* count (+ +mmsghdr-size+ sockint::size-of-iovec
+                            sockint::size-of-sockaddr-storage)))
+         (memory (sb-alien:make-alien (sb-alien:unsigned 8) total))
+         (sap (sb-alien:alien-sap memory))
+         (batch (%make-datagram-batch
+                 count buffer-size
+                 (make-array (* count buffer-size) :element-type '(unsigned-byte 8)
+                                                   :initial-element 0)
+                 (make-array count :element-type '(unsigned-byte 32)
+                                   :initial-element 0)
+                 (make-array (* count 16) :element-type '(unsigned-byte 8)
+                                          :initial-element 0)
+                 (make-array count :element-type '(unsigned-byte 16)
+                                   :initial-element 0)
+                 sap)))
+    (dotimes (i total)
+      (setf (sb-sys:sap-ref-8 sap i) 0))
+    (dotimes (i count)
+      (let ((header (batch-header batch i))
+            (iovec (sb-sys:sap+ sap (* count +mmsghdr-size+)
+                                (* i sockint::size-of-iovec))))
+        (setf (sb-sys:sap-ref-sap header sockint::msg-iov-offset) iovec
+              (sb-sys:sap-ref-word header sockint::msg-iovlen-offset) 1)))
+    (sb-ext:finalize batch (lambda () (sb-alien:free-alien memory))
+                     :dont-save t)
+    batch))
+
+;;; Point the header of datagram I at its piece of DATA, whose
+;;; address is DATA-SAP, with LENGTH octets, and at NAMELEN octets of
+;;; its sockaddr if NAMELEN is nonzero.
+(declaim (inline set-batch-header))
+(defun set-batch-header (batch i data-sap length namelen)
+  (let* ((header (batch-header batch i))
+         (iovec (sb-sys:sap-ref-sap header sockint::msg-iov-offset)))
+    (setf (sb-sys:sap-ref-sap iovec sockint::iov-base-offset)
+          (sb-sys:sap+ data-sap (* i (datagram-batch-buffer-size batch)))
+          (sb-sys:sap-ref-word iovec sockint::iov-len-offset) length
+          (sb-sys:sap-ref-sap header sockint::msg-name-offset)
+          (if (zerop namelen) (sb-sys:int-sap 0) (batch-sockaddr batch i))
+          (sb-sys:sap-ref-32 header sockint::msg-namelen-offset) namelen
+          (sb-sys:sap-ref-32 header sockint::msg-flags-offset) 0)))
+
+(defun sockaddr-to-batch (batch i)
+  (setf (aref (datagram-batch-ports batch) i)
+        (or (sockaddr-address-into (batch-sockaddr batch i)
+                                   (datagram-batch-addresses batch)
+                                   (* i 16))
+            0)))
+
+;;; Returns the length of the sockaddr.
+(defun batch-to-sockaddr (socket batch i)
+  (let ((sockaddr (batch-sockaddr batch i))
+        (addresses (datagram-batch-addresses batch))
+        (port (aref (datagram-batch-ports batch) i))
+        (family (socket-family socket)))
+    (dotimes (j sockint::size-of-sockaddr-storage)
+      (setf (sb-sys:sap-ref-8 sockaddr j) 0))
+    (flet ((store (family-offset port-offset addr-offset n)
+             (setf (sb-sys:sap-ref-16 sockaddr family-offset) family
+                   (sb-sys:sap-ref-8 sockaddr port-offset) (ldb (byte 8 8) port)
+                   (sb-sys:sap-ref-8 sockaddr (1+ port-offset)) (ldb (byte 8 0) port))
+             (dotimes (j n)
+               (setf (sb-sys:sap-ref-8 sockaddr (+ addr-offset j))
+                     (aref addresses (+ (* i 16) j))))))
+      (cond ((= family sockint::af-inet)
+             (store sockint::sin-family-offset sockint::sin-port-offset
+                    sockint::sin-addr-offset 4)
+             sockint::size-of-sockaddr-in)
+            ((= family sockint::af-inet6)
+             (store sockint::sin6-family-offset sockint::sin6-port-offset
+                    sockint::sin6-addr-offset 16)
+             sockint::size-of-sockaddr-in6)
+            (t
+             (error "Can't send a batch to addresses of ~S." socket))))))
+
+(defun check-batch-bounds (batch start end)
+  (let ((end (or end (datagram-batch-count batch))))
+    (unless (<= 0 start end (datagram-batch-count batch))
+      (error "Bounding indices ~S and ~S are bad for ~S."
+             start end batch))
+    end))
+
+(defmethod socket-receive-batch ((socket socket) batch
+                                 &key (start 0) end dontwait waitforone)
+  (let ((end (check-batch-bounds batch start end))
+        (flags (logior (if dontwait sockint::msg-dontwait 0)
+                       (if waitforone sockint::msg-waitforone 0)
+                       (if (eql (socket-type socket) :datagram)
+                           sockint::msg-trunc 0)))
+        (data (datagram-batch-data batch))
+        (lengths (datagram-batch-lengths batch)))
+    (sb-sys:with-pinned-objects (data)
+      (let ((data-sap (sb-sys:vector-sap data))
+            (size (datagram-batch-buffer-size batch)))
+        (loop for i from start below end
+              do (set-batch-header batch i data-sap size
+                                   sockint::size-of-sockaddr-storage))
+        (socket-error-case ("recvmmsg"
+                            (sockint::recvmmsg (socket-file-descriptor socket)
+                                               (batch-header batch start)
+                                               (- end start) flags nil)
+                            n)
+            (progn
+              (loop for i from start below (+ start n)
+                    do (setf (aref lengths i)
+                             (sb-sys:sap-ref-32 (batch-header batch i)
+                                                sockint::size-of-msghdr))
+                       (sockaddr-to-batch batch i))
+              n)
+          (:interrupted 0))))))
+
+(defmethod socket-send-batch ((socket socket) batch
+                              &key (start 0) end addressed dontwait nosignal)
+  (let ((end (check-batch-bounds batch start end))
+        (flags (logior (if dontwait sockint::msg-dontwait 0)
+                       (if nosignal sockint::msg-nosignal 0)))
+        (data (datagram-batch-data batch))
+        (lengths (datagram-batch-lengths batch))
+        (size (datagram-batch-buffer-size batch)))
+    (sb-sys:with-pinned-objects (data)
+      (let ((data-sap (sb-sys:vector-sap data)))
+        (loop for i from start below end
+              do (let ((length (aref lengths i)))
+                   (unless (<= length size)
+                     (error "Datagram ~D of ~S is longer than ~D octets."
+                            i batch size))
+                   (set-batch-header batch i data-sap length
+                                     (if addressed
+                                         (batch-to-sockaddr socket batch i)
+                                         0))))
+        (socket-error-case ("sendmmsg"
+                            (sockint::sendmmsg (socket-file-descriptor socket)
+                                               (batch-header batch start)
+                                               (- end start) flags)
+                            n)
+            n
+          (:interrupted 0))))))
@@ -1,4 +1,5 @@
-("sys/socket.h" "errno.h" "fcntl.h")
+("sys/socket.h" "errno.h" "fcntl.h"
+ #+linux "stddef.h" #+linux "sys/uio.h" #+linux "netinet/in.h")
 
 ((:integer af-local
            #+(or sunos solaris) "AF_UNIX"
@@ -23,6 +24,44 @@
  #+linux (:integer msg-nosignal "MSG_NOSIGNAL")
  #+linux (:integer msg-confirm "MSG_CONFIRM")
  #+linux (:integer msg-more "MSG_MORE")
+ #+linux (:integer msg-waitforone "MSG_WAITFORONE")
+
+ ;; for recvmmsg() and sendmmsg(). struct mmsghdr needs _GNU_SOURCE,
+ ;; but it is only a struct msghdr followed by an unsigned int.
+ #+linux (:integer-no-check size-of-iovec "sizeof(struct iovec)")
+ #+linux (:integer-no-check iov-base-offset "offsetof(struct iovec, iov_base)")
+ #+linux (:integer-no-check iov-len-offset "offsetof(struct iovec, iov_len)")
+ #+linux (:integer-no-check size-of-msghdr "sizeof(struct msghdr)")
+ #+linux (:integer-no-check msg-name-offset "offsetof(struct msghdr, msg_name)")
+ #+linux (:integer-no-check msg-namelen-offset "offsetof(struct msghdr, msg_namelen)")
+ #+linux (:integer-no-check msg-iov-offset "offsetof(struct msghdr, msg_iov)")
+ #+linux (:integer-no-check msg-iovlen-offset "offsetof(struct msghdr, msg_iovlen)")
+ #+linux (:integer-no-check msg-control-offset "offsetof(struct msghdr, msg_control)")
+ #+linux (:integer-no-check msg-controllen-offset "offsetof(struct msghdr, msg_controllen)")
+ #+linux (:integer-no-check msg-flags-offset "offsetof(struct msghdr, msg_flags)")
+ #+linux (:integer-no-check size-of-sockaddr-storage "sizeof(struct sockaddr_storage)")
+ #+linux (:integer-no-check sin-family-offset "offsetof(struct sockaddr_in, sin_family)")
+ #+linux (:integer-no-check sin-port-offset "offsetof(struct sockaddr_in, sin_port)")
+ #+linux (:integer-no-check sin-addr-offset "offsetof(struct sockaddr_in, sin_addr)")
+ #+linux (:integer-no-check sin6-family-offset "offsetof(struct sockaddr_in6, sin6_family)")
+ #+linux (:integer-no-check sin6-port-offset "offsetof(struct sockaddr_in6, sin6_port)")
+ #+linux (:integer-no-check sin6-addr-offset "offsetof(struct sockaddr_in6, sin6_addr)")
+ #+linux (:function accept4 ("accept4" int
+                             (socket int)
+                             (my-addr (* t))
+                             (addrlen socklen-t :in-out)
+                             (flags int)))
+ #+linux (:function recvmmsg ("recvmmsg" int
+                              (socket int)
+                              (msgvec (* t))
+                              (vlen unsigned-int)
+                              (flags int)
+                              (timeout (* t))))
+ #+linux (:function sendmmsg ("sendmmsg" int
+                              (socket int)
+                              (msgvec (* t))
+                              (vlen unsigned-int)
+                              (flags int)))
 
  (:integer EADDRINUSE "EADDRINUSE")
  (:integer EAGAIN "EAGAIN")
@@ -22,6 +22,8 @@
            "Connectionless, unreliable datagrams of fixed maximum length.")
  (:integer sock-raw "SOCK_RAW"
            "Raw protocol interface.")
+ #+linux (:integer sock-nonblock "SOCK_NONBLOCK")
+ #+linux (:integer sock-cloexec "SOCK_CLOEXEC")
  (:integer sock-rdm "SOCK_RDM"
            "Reliably-delivered messages.")
  (:integer sock-seqpacket "SOCK_SEQPACKET"
@@ -33,6 +35,8 @@
  (:integer so-debug "SO_DEBUG"
            "Enable debugging in underlying protocol modules")
  (:integer so-reuseaddr "SO_REUSEADDR" "Enable local address reuse")
+ #+linux (:integer so-reuseport "SO_REUSEPORT"
+                   "Allow several sockets to bind the same address and port")
  (:integer so-type "SO_TYPE")                   ;get only
  (:integer so-error "SO_ERROR")         ;get only (also clears)
  (:integer so-dontroute "SO_DONTROUTE"
@@ -42,7 +42,21 @@
            #:make-inet-address
            #:make-inet6-address
 
-           #:non-blocking-mode)
+           #:non-blocking-mode
+
+           #+linux #:socket-accept-file-descriptor
+           #+linux #:make-reuse-port-listeners
+
+           #+linux #:datagram-batch
+           #+linux #:make-datagram-batch
+           #+linux #:datagram-batch-count
+           #+linux #:datagram-batch-buffer-size
+           #+linux #:datagram-batch-data
+           #+linux #:datagram-batch-lengths
+           #+linux #:datagram-batch-addresses
+           #+linux #:datagram-batch-ports
+           #+linux #:socket-receive-batch
+           #+linux #:socket-send-batch)
   (:use "COMMON-LISP" "SB-BSD-SOCKETS-INTERNAL")
   (:import-from "SB-INT" "UNSUPPORTED-OPERATOR" "FEATUREP")
   (:documentation
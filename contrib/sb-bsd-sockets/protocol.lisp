@@ -72,6 +72,23 @@ address family sockets, pass the filename string.  See also bind(2)"))
    "Perform the accept(2) call, returning a newly-created connected
 socket and the peer address as multiple values"))
 
+#+linux
+(defgeneric socket-accept-file-descriptor (socket address
+                                           &key start nonblocking close-on-exec)
+  (:documentation
+   "Perform the accept4(2) call, returning the file descriptor of a
+newly-accepted connection and the port of its peer as multiple values,
+or NIL if the call was interrupted or SOCKET is in non-blocking mode
+and no connection is waiting. Unlike SOCKET-ACCEPT, makes no socket
+instance: the peer address is stored in the octet vector ADDRESS from
+START, 4 octets for an INET-SOCKET and 16 for an INET6-SOCKET, and
+nothing is stored if ADDRESS is NIL. The descriptor is put in
+non-blocking mode if NONBLOCKING is true, and is not inherited by
+programs run from SBCL if CLOSE-ON-EXEC is true; both default to
+true. The caller owns the descriptor, and can close it with
+close(2) or give it to MAKE-INSTANCE of a socket class as
+:DESCRIPTOR."))
+
 (defgeneric socket-connect (socket &rest address)
   (:documentation
    "Perform the connect(2) call to connect SOCKET to a remote PEER.
@@ -105,6 +122,27 @@ for INET domain sockets it would be a list of an IP address and a
 port). If no socket address is provided, send(2) will be called
 instead. Returns the number of octets written."))
 
+#+linux
+(defgeneric socket-receive-batch (socket batch &key start end dontwait waitforone)
+  (:documentation
+   "Receive datagrams from SOCKET into the DATAGRAM-BATCH BATCH, from
+datagram START up to END, using recvmmsg(2). Returns the number of
+datagrams received, and stores their lengths and the addresses and ports
+of their peers in BATCH. On datagram sockets, the length is that of the
+whole packet, even if it was truncated to the buffer size of BATCH.
+If WAITFORONE is true, waits only for the first datagram. Returns 0
+instead of waiting if DONTWAIT is true and no datagram is available."))
+
+#+linux
+(defgeneric socket-send-batch (socket batch &key start end addressed
+                                                dontwait nosignal)
+  (:documentation
+   "Send the datagrams of the DATAGRAM-BATCH BATCH from START up to END
+into SOCKET, using sendmmsg(2). The length of each is taken from the
+lengths of BATCH. If ADDRESSED is true, each goes to its address and
+port in BATCH, otherwise SOCKET must be connected. Returns the number
+of datagrams sent, which can be fewer than requested."))
+
 (defgeneric socket-listen (socket backlog)
   (:documentation
    "Mark SOCKET as willing to accept incoming connections.  The
@@ -140,6 +140,9 @@ Code for options that not every system has should be conditionalised:
 
 (define-socket-option-bool
   sockopt-reuse-address sockint::sol-socket sockint::so-reuseaddr)
+(define-socket-option-bool
+  sockopt-reuse-port sockint::sol-socket sockint::so-reuseport :linux
+  "Available only on Linux.")
 (define-socket-option-bool
   sockopt-keep-alive sockint::sol-socket sockint::so-keepalive)
 (define-socket-option-bool
@@ -562,3 +562,83 @@
                                server)
         (string= (sb-ext:octets-to-string (socket-peername client)) address)))
   t)
+
+#+(and linux ipv4-support)
+(deftest datagram-batch.loopback
+    (let ((receiver (make-instance 'inet-socket :type :datagram :protocol :udp))
+          (sender (make-instance 'inet-socket :type :datagram :protocol :udp))
+          (out (make-datagram-batch 8 64))
+          (in (make-datagram-batch 8 16)))
+      (unwind-protect
+           (progn
+             (socket-bind receiver #(127 0 0 1) 0)
+             (socket-bind sender #(127 0 0 1) 0)
+             (let ((receiver-port (nth-value 1 (socket-name receiver)))
+                   (sender-port (nth-value 1 (socket-name sender))))
+               (dotimes (i 5)
+                 (let ((length (* 5 i)))
+                   (fill (datagram-batch-data out) i
+                         :start (* i 64) :end (+ (* i 64) length))
+                   (setf (aref (datagram-batch-lengths out) i) length)
+                   (replace (datagram-batch-addresses out) #(127 0 0 1)
+                            :start1 (* i 16))
+                   (setf (aref (datagram-batch-ports out) i) receiver-port)))
+               (let ((sent (socket-send-batch sender out :end 5 :addressed t))
+                     (received (socket-receive-batch receiver in :start 1
+                                                     :waitforone t)))
+                 (loop until (= received 5)
+                       do (incf received
+                                (socket-receive-batch receiver in
+                                                      :start (1+ received)
+                                                      :end 6)))
+                 (list sent
+                       (coerce (subseq (datagram-batch-lengths in) 1 6) 'list)
+                       (loop for i from 1 to 5
+                             always (= (aref (datagram-batch-ports in) i)
+                                       sender-port))
+                       (coerce (subseq (datagram-batch-addresses in) 16 20) 'list)
+                       ;; The last two were truncated to 16 octets.
+                       (loop for i from 1 to 5
+                             collect (count (1- i) (datagram-batch-data in)
+                                            :start (* i 16)
+                                            :end (+ (* i 16)
+                                                    (min 16 (* 5 (1- i))))))
+                       (socket-receive-batch receiver in :dontwait t)))))
+        (socket-close receiver)
+        (socket-close sender)))
+  (5 (0 5 10 15 20) t (127 0 0 1) (0 5 10 15 16) 0))
+
+#+(and linux ipv4-support)
+(deftest reuse-port-listeners.accept-file-descriptor
+    (let* ((listeners (make-reuse-port-listeners 2 #(127 0 0 1) 0))
+           (client (make-instance 'inet-socket :type :stream :protocol :tcp))
+           (address (make-array 8 :element-type '(unsigned-byte 8)
+                                  :initial-element 0)))
+      (unwind-protect
+           (let ((port (nth-value 1 (socket-name (first listeners)))))
+             (dolist (listener listeners)
+               (setf (non-blocking-mode listener) t))
+             (socket-connect client #(127 0 0 1) port)
+             ;; The kernel chooses which listener gets the connection.
+             (multiple-value-bind (fd peer-port)
+                 (block accept
+                   (loop (dolist (listener listeners)
+                           (multiple-value-bind (fd peer-port)
+                               (socket-accept-file-descriptor listener address
+                                                              :start 2)
+                             (when fd
+                               (return-from accept (values fd peer-port)))))
+                         (sleep 0.01)))
+               (unwind-protect
+                    (list (= port (nth-value 1 (socket-name (second listeners))))
+                          (= peer-port (nth-value 1 (socket-name client)))
+                          (coerce address 'list)
+                          (logtest (sockint::fcntl fd sockint::f-getfl)
+                                   sockint::o-nonblock)
+                          (loop for listener in listeners
+                                always (null (socket-accept-file-descriptor
+                                              listener nil))))
+                 (sockint::close fd))))
+        (mapc #'socket-close listeners)
+        (socket-close client)))
+  (t t (0 0 127 0 0 1 0 0) t t))
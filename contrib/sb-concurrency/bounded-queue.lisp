@@ -0,0 +1,335 @@
+;;;; Bounded multi-producer multi-consumer queue
+;;;;
+;;;; This software is part of the SBCL system. See the README file for
+;;;; more information.
+;;;;
+;;;; This software is derived from the CMU CL system, which was written at
+;;;; Carnegie Mellon University and released into the public domain. The
+;;;; software is in the public domain and is provided with absolutely no
+;;;; warranty. See the COPYING and CREDITS files for more information.
+
+;;; The algorithm is Dmitry Vyukov's bounded MPMC queue. The queue is a
+;;; ring of cells, each holding a value and a sequence number, and two
+;;; positions that only ever increase: producers claim the cell at the
+;;; enqueue position, consumers the one at the dequeue position, each
+;;; with a single CAS that moves the position forward.
+;;;
+;;; The sequence number of a cell says whose turn it is. A cell at
+;;; index I is free for the producer at position P when its sequence
+;;; number is P, and holds a value for the consumer at position P when
+;;; it is P+1. After taking the value, the consumer sets the sequence
+;;; number to P plus the capacity, which is the producer position that
+;;; comes to the same cell on the next lap. Claiming a cell and
+;;; publishing it are two steps, so both happen without interrupts: a
+;;; thread unwinding in between would leave the cell claimed forever,
+;;; and the whole queue stuck behind it.
+;;;
+;;; Positions are kept modulo 2^+POSITION-BITS+, so that they remain
+;;; fixnums, and are compared by their difference. The capacity is a
+;;; power of two, so wrapping around does not change the index of the
+;;; cell a position maps to.
+;;;
+;;; Nothing is allocated once the queue exists. The mutex and the two
+;;; waitqueues are only used by threads that have to wait: producers
+;;; and consumers that succeed without waiting look at a count of
+;;; waiters to decide whether there is anyone to wake up.
+
+(in-package :sb-concurrency)
+
+(defconstant +position-bits+ (1- sb-vm:n-positive-fixnum-bits))
+(defconstant +position-mask+ (1- (ash 1 +position-bits+)))
+(deftype ring-position () `(unsigned-byte ,+position-bits+))
+
+(declaim (inline position+ position-))
+(defun position+ (position n)
+  (logand (+ position n) +position-mask+))
+
+;;; Signed distance from B to A.
+(defun position- (a b)
+  (let ((difference (logand (- a b) +position-mask+)))
+    (if (logbitp (1- +position-bits+) difference)
+        (- difference (ash 1 +position-bits+))
+        difference)))
+
+(defstruct (bounded-queue (:constructor %make-bounded-queue
+                              (cells mask name mutex not-full not-empty))
+                          (:copier nil)
+                          (:predicate bounded-queuep))
+  "Lock-free thread safe FIFO queue with a fixed capacity.
+
+Use BOUNDED-QUEUE-PUSH to add objects to the queue, waiting while it is
+full, and BOUNDED-QUEUE-POP to remove them, waiting while it is empty.
+BOUNDED-QUEUE-TRY-PUSH and BOUNDED-QUEUE-TRY-POP do not wait, and
+BOUNDED-QUEUE-PUSH-SEQUENCE and BOUNDED-QUEUE-POP-INTO move several
+objects at once."
+  (enqueue-position 0 :type ring-position)
+  ;; Cell I is at 2I, its sequence number, and 2I+1, its value.
+  (cells (missing-arg) :type simple-vector :read-only t)
+  (mask (missing-arg) :type index :read-only t)
+  (dequeue-position 0 :type ring-position)
+  ;; Numbers of threads waiting in BOUNDED-QUEUE-PUSH and BOUNDED-QUEUE-POP
+  (push-waiters 0 :type sb-ext:word)
+  (pop-waiters 0 :type sb-ext:word)
+  (mutex (missing-arg) :type mutex :read-only t)
+  (not-full (missing-arg) :type waitqueue :read-only t)
+  (not-empty (missing-arg) :type waitqueue :read-only t)
+  (name nil))
+(declaim (sb-ext:freeze-type bounded-queue))
+
+(setf (documentation 'bounded-queuep 'function)
+      "Returns true if argument is a BOUNDED-QUEUE, NIL otherwise."
+      (documentation 'bounded-queue-name 'function)
+      "Name of a BOUNDED-QUEUE. SETFable.")
+
+(defmethod print-object ((queue bounded-queue) stream)
+  (print-unreadable-object (queue stream :type t :identity t)
+    (format stream "~@[~S ~](~D/~D)"
+            (bounded-queue-name queue)
+            (bounded-queue-count queue)
+            (bounded-queue-capacity queue))))
+
+(declaim (ftype (sfunction ((integer 1) &key (:name t)) bounded-queue)
+                make-bounded-queue))
+(defun make-bounded-queue (capacity &key name)
+  "Returns a new empty BOUNDED-QUEUE with NAME, which can hold at least
+CAPACITY objects. The capacity is rounded up to a power of two."
+  (let* ((size (max 2 (ash 1 (integer-length (1- capacity)))))
+         (cells (make-array (* 2 size) :initial-element nil)))
+    (unless (<= size (ash 1 (1- +position-bits+)))
+      (error "Bounded queue capacity ~S is too large." capacity))
+    (dotimes (i size)
+      (setf (svref cells (* 2 i)) i))
+    (flet ((generate-name (thing)
+             (when name
+               (format nil "bounded queue ~S's ~A" name thing))))
+      (%make-bounded-queue cells (1- size) name
+                           (make-mutex :name (generate-name "lock"))
+                           (make-waitqueue :name (generate-name "not-full"))
+                           (make-waitqueue :name (generate-name "not-empty"))))))
+
+(declaim (ftype (sfunction (bounded-queue) (integer 2)) bounded-queue-capacity))
+(defun bounded-queue-capacity (queue)
+  "Returns the number of objects QUEUE can hold."
+  (1+ (bounded-queue-mask queue)))
+
+(declaim (ftype (sfunction (bounded-queue) unsigned-byte) bounded-queue-count))
+(defun bounded-queue-count (queue)
+  "Returns the number of objects in QUEUE. The count may be out of date
+by the time it is returned."
+  (let* ((dequeue (bounded-queue-dequeue-position queue))
+         (enqueue (bounded-queue-enqueue-position queue)))
+    (max 0 (min (position- enqueue dequeue)
+                (bounded-queue-capacity queue)))))
+
+(declaim (ftype (sfunction (bounded-queue) boolean) bounded-queue-empty-p))
+(defun bounded-queue-empty-p (queue)
+  "Returns T if QUEUE is empty, NIL otherwise."
+  (zerop (bounded-queue-count queue)))
+
+(declaim (ftype (sfunction (bounded-queue) boolean) bounded-queue-full-p))
+(defun bounded-queue-full-p (queue)
+  "Returns T if QUEUE is full, NIL otherwise."
+  (= (bounded-queue-count queue) (bounded-queue-capacity queue)))
+
+;;; Wake up the threads waiting to pop if there are any. Our push has
+;;; to be visible before the count of waiters is read: a consumer
+;;; increments the count before it tries to pop, so either it sees the
+;;; object, or we see it waiting.
+(declaim (inline wake-consumers wake-producers))
+(defun wake-consumers (queue)
+  (barrier (:memory))
+  (unless (zerop (bounded-queue-pop-waiters queue))
+    (with-recursive-lock ((bounded-queue-mutex queue))
+      (condition-broadcast (bounded-queue-not-empty queue)))))
+
+(defun wake-producers (queue)
+  (barrier (:memory))
+  (unless (zerop (bounded-queue-push-waiters queue))
+    (with-recursive-lock ((bounded-queue-mutex queue))
+      (condition-broadcast (bounded-queue-not-full queue)))))
+
+(declaim (ftype (sfunction (t bounded-queue) boolean) %try-push))
+(defun %try-push (value queue)
+  (declare (optimize speed))
+  (let ((cells (bounded-queue-cells queue))
+        (mask (bounded-queue-mask queue)))
+    (loop
+      (let* ((position (bounded-queue-enqueue-position queue))
+             (index (* 2 (logand position mask)))
+             (sequence (svref cells index)))
+        (declare (ring-position sequence))
+        (barrier (:read))
+        ;; If the difference is positive, another producer took the
+        ;; cell, and we try again at the new position.
+        (let ((difference (position- sequence position)))
+          (cond ((zerop difference)
+                 (sb-sys:without-interrupts
+                   (when (eql position
+                              (cas (bounded-queue-enqueue-position queue)
+                                   position (position+ position 1)))
+                     (setf (svref cells (1+ index)) value)
+                     (barrier (:write))
+                     (setf (svref cells index) (position+ position 1))
+                     (return t))))
+                ;; The cell still holds the value from the previous lap.
+                ((minusp difference)
+                 (return nil))))))))
+
+(declaim (ftype (sfunction (bounded-queue) (values t boolean)) %try-pop))
+(defun %try-pop (queue)
+  (declare (optimize speed))
+  (let ((cells (bounded-queue-cells queue))
+        (mask (bounded-queue-mask queue)))
+    (loop
+      (let* ((position (bounded-queue-dequeue-position queue))
+             (index (* 2 (logand position mask)))
+             (sequence (svref cells index)))
+        (declare (ring-position sequence))
+        (barrier (:read))
+        (let ((difference (position- sequence (position+ position 1))))
+          (cond ((zerop difference)
+                 (sb-sys:without-interrupts
+                   (when (eql position
+                              (cas (bounded-queue-dequeue-position queue)
+                                   position (position+ position 1)))
+                     (let ((value (svref cells (1+ index))))
+                       ;; Don't keep the object alive from the queue.
+                       (setf (svref cells (1+ index)) nil)
+                       (barrier (:write))
+                       (setf (svref cells index) (position+ position (1+ mask)))
+                       (return (values value t))))))
+                ((minusp difference)
+                 (return (values nil nil)))))))))
+
+;;; Call TEST until it returns true, waiting on QUEUE for the other side
+;;; between calls. Returns NIL if TIMEOUT seconds pass.
+(defun wait-on-bounded-queue (queue test producerp timeout)
+  (declare (function test))
+  (let ((mutex (bounded-queue-mutex queue))
+        (waitqueue (if producerp
+                       (bounded-queue-not-full queue)
+                       (bounded-queue-not-empty queue))))
+    (sb-thread::with-progressive-timeout (time-left :seconds timeout)
+      (with-mutex (mutex)
+        (if producerp
+            (atomic-incf (bounded-queue-push-waiters queue))
+            (atomic-incf (bounded-queue-pop-waiters queue)))
+        (unwind-protect
+             (loop
+               (when (funcall test)
+                 (if producerp
+                     (wake-consumers queue)
+                     (wake-producers queue))
+                 (return t))
+               (unless (condition-wait waitqueue mutex :timeout (time-left))
+                 (return nil)))
+          (if producerp
+              (atomic-decf (bounded-queue-push-waiters queue))
+              (atomic-decf (bounded-queue-pop-waiters queue))))))))
+
+(declaim (ftype (sfunction (t bounded-queue) boolean) bounded-queue-try-push))
+(defun bounded-queue-try-push (value queue)
+  "Adds VALUE to the end of QUEUE and returns T, or returns NIL if QUEUE
+is full."
+  (when (%try-push value queue)
+    (wake-consumers queue)
+    t))
+
+(declaim (ftype (sfunction (bounded-queue) (values t boolean))
+                bounded-queue-try-pop))
+(defun bounded-queue-try-pop (queue)
+  "Removes the oldest value in QUEUE and returns it as the primary value,
+and T as secondary value. If QUEUE is empty, returns NIL as both primary
+and secondary value."
+  (multiple-value-bind (value ok) (%try-pop queue)
+    (when ok
+      (wake-producers queue))
+    (values value ok)))
+
+(declaim (ftype (sfunction (t bounded-queue &key (:timeout t)) boolean)
+                bounded-queue-push))
+(defun bounded-queue-push (value queue &key timeout)
+  "Adds VALUE to the end of QUEUE and returns T. If QUEUE is full, waits
+until another thread removes an object.
+
+If TIMEOUT is provided, and QUEUE is still full after the specified
+interval, returns NIL."
+  (or (bounded-queue-try-push value queue)
+      (flet ((try ()
+               (%try-push value queue)))
+        (declare (dynamic-extent #'try))
+        (wait-on-bounded-queue queue #'try t timeout))))
+
+(declaim (ftype (sfunction (bounded-queue &key (:timeout t)) (values t boolean))
+                bounded-queue-pop))
+(defun bounded-queue-pop (queue &key timeout)
+  "Removes the oldest value in QUEUE and returns it as the primary value,
+and T as secondary value. If QUEUE is empty, waits until another thread
+adds an object.
+
+If TIMEOUT is provided, and QUEUE is still empty after the specified
+interval, returns NIL as both primary and secondary value."
+  (multiple-value-bind (value ok) (bounded-queue-try-pop queue)
+    (if ok
+        (values value t)
+        (let ((result nil))
+          (flet ((try ()
+                   (multiple-value-bind (value ok) (%try-pop queue)
+                     (when ok
+                       (setf result value)
+                       t))))
+            (declare (dynamic-extent #'try))
+            (if (wait-on-bounded-queue queue #'try nil timeout)
+                (values result t)
+                (values nil nil)))))))
+
+(declaim (ftype (sfunction (sequence bounded-queue &key (:start index)
+                                     (:end (or null index)))
+                           index)
+                bounded-queue-push-sequence))
+(defun bounded-queue-push-sequence (sequence queue &key (start 0) end)
+  "Adds the elements of SEQUENCE between START and END to the end of
+QUEUE, in order, until QUEUE is full. Returns the number of elements
+added. Does not wait.
+
+Elements pushed concurrently by other threads may end up between
+the elements of SEQUENCE."
+  (let ((count 0))
+    (declare (index count))
+    (block push
+      (flet ((push-1 (value)
+               (unless (%try-push value queue)
+                 (return-from push))
+               (incf count)))
+        (etypecase sequence
+          (list
+           (loop for value in (nthcdr start sequence)
+                 for i of-type index from start
+                 while (or (null end) (< i end))
+                 do (push-1 value)))
+          (vector
+           (loop for i of-type index from start below (or end (length sequence))
+                 do (push-1 (aref sequence i)))))))
+    (when (plusp count)
+      (wake-consumers queue))
+    count))
+
+(declaim (ftype (sfunction (vector bounded-queue &key (:start index)
+                                   (:end (or null index)))
+                           index)
+                bounded-queue-pop-into))
+(defun bounded-queue-pop-into (vector queue &key (start 0) end)
+  "Removes the oldest objects from QUEUE and stores them into VECTOR from
+START, until QUEUE is empty or END is reached. Returns the number of
+objects stored. Does not wait."
+  (let ((count 0))
+    (declare (index count))
+    (loop for i of-type index from start below (or end (length vector))
+          do (multiple-value-bind (value ok) (%try-pop queue)
+               (unless ok
+                 (loop-finish))
+               (setf (aref vector i) value)
+               (incf count)))
+    (when (plusp count)
+      (wake-producers queue))
+    count))
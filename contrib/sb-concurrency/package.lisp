@@ -36,6 +36,22 @@
    "QUEUE-NAME"
    "QUEUEP"
 
+   ;; BOUNDED-QUEUE
+   "BOUNDED-QUEUE"
+   "BOUNDED-QUEUE-CAPACITY"
+   "BOUNDED-QUEUE-COUNT"
+   "BOUNDED-QUEUE-EMPTY-P"
+   "BOUNDED-QUEUE-FULL-P"
+   "BOUNDED-QUEUE-NAME"
+   "BOUNDED-QUEUE-POP"
+   "BOUNDED-QUEUE-POP-INTO"
+   "BOUNDED-QUEUE-PUSH"
+   "BOUNDED-QUEUE-PUSH-SEQUENCE"
+   "BOUNDED-QUEUE-TRY-POP"
+   "BOUNDED-QUEUE-TRY-PUSH"
+   "BOUNDED-QUEUEP"
+   "MAKE-BOUNDED-QUEUE"
+
    ;; GATE
    "CLOSE-GATE"
    "GATE"
@@ -46,6 +62,25 @@
    "OPEN-GATE"
    "WAIT-ON-GATE"
 
+   ;; THREAD-POOL
+   "*THREAD-POOL*"
+   "AWAIT"
+   "FULFILL-FUTURE"
+   "FUTURE"
+   "FUTURE-DONE-P"
+   "FUTURE-NAME"
+   "FUTUREP"
+   "MAKE-FUTURE"
+   "MAKE-THREAD-POOL"
+   "PARALLEL-MAP"
+   "PARALLEL-REDUCE"
+   "SHUTDOWN-THREAD-POOL"
+   "SUBMIT-TASK"
+   "THREAD-POOL"
+   "THREAD-POOL-NAME"
+   "THREAD-POOL-SIZE"
+   "THREAD-POOLP"
+
    ;; FRLOCK
    "MAKE-FRLOCK"
    "FRLOCK"
@@ -0,0 +1,152 @@
+;;;; This software is part of the SBCL system. See the README file for
+;;;; more information.
+;;;;
+;;;; This software is derived from the CMU CL system, which was written at
+;;;; Carnegie Mellon University and released into the public domain. The
+;;;; software is in the public domain and is provided with absolutely no
+;;;; warranty. See the COPYING and CREDITS files for more information.
+
+(in-package :sb-concurrency-test)
+
+(deftest bounded-queue.1
+    (let ((q (make-bounded-queue 3 :name 'test-q)))
+      (values (bounded-queue-name q)
+              (bounded-queue-capacity q)
+              (bounded-queue-empty-p q)
+              (loop for i from 1 to 5 collect (bounded-queue-try-push i q))
+              (bounded-queue-full-p q)
+              (bounded-queue-count q)
+              (multiple-value-list (bounded-queue-try-pop q))
+              (bounded-queue-try-push 5 q)
+              (loop repeat 5 collect (bounded-queue-try-pop q))))
+  test-q
+  4
+  t
+  (t t t t nil)
+  t
+  4
+  (1 t)
+  t
+  (2 3 4 5 nil))
+
+(deftest bounded-queue.2
+    (let ((q (make-bounded-queue 1)))
+      (bounded-queue-try-push nil q)
+      (values (bounded-queuep q)
+              (bounded-queuep (make-queue))
+              (multiple-value-list (bounded-queue-try-pop q))
+              (multiple-value-list (bounded-queue-try-pop q))
+              (multiple-value-list (bounded-queue-pop q :timeout 0.01))
+              (progn (bounded-queue-try-push 1 q)
+                     (bounded-queue-try-push 2 q)
+                     (bounded-queue-push 3 q :timeout 0.01))))
+  t
+  nil
+  (nil t)
+  (nil nil)
+  (nil nil)
+  nil)
+
+;;; Go around the ring many times, so that the positions wrap around
+;;; the cells, in batches that don't divide the capacity.
+(deftest bounded-queue.batch
+    (let ((q (make-bounded-queue 8))
+          (out (make-array 5 :initial-element 0))
+          (result '()))
+      (values
+       (bounded-queue-push-sequence '(a b c d e f g h i j) q :start 1)
+       (bounded-queue-pop-into out q :start 1 :end 4)
+       (coerce out 'list)
+       (progn
+         (bounded-queue-pop-into (make-array 5) q)
+         (dotimes (i 1000 (equal (nreverse result)
+                                 (loop for i below 3000 collect i)))
+           (let ((vector (vector (* 3 i) (+ (* 3 i) 1) (+ (* 3 i) 2))))
+             (assert (= 3 (bounded-queue-push-sequence vector q)))
+             (fill vector nil)
+             (assert (= 3 (bounded-queue-pop-into vector q)))
+             (map nil (lambda (x) (push x result)) vector))))))
+  8
+  3
+  (0 b c d 0)
+  t)
+
+#+sb-thread
+(progn
+
+(defun test-bounded-queue-producers-consumers (&key capacity n-producers
+                                                    n-consumers n-objects)
+  (let* ((q (make-bounded-queue capacity))
+         (total (* n-producers n-objects))
+         (seen (make-array total :element-type 'bit :initial-element 0))
+         (producers
+           (loop for p below n-producers
+                 collect (let ((p p))
+                           (make-thread
+                            (lambda ()
+                              (dotimes (i n-objects)
+                                (bounded-queue-push (+ (* p n-objects) i) q)))
+                            :name (format nil "producer-~D" p)))))
+         (consumers
+           (make-threads n-consumers "consumer"
+                         (lambda ()
+                           (let ((received '()))
+                             (loop
+                               (multiple-value-bind (x ok)
+                                   (bounded-queue-pop q :timeout +timeout+)
+                                 (unless ok (return :timeout))
+                                 (when (eq x :done) (return received))
+                                 (push x received))))))))
+    (mapc #'timed-join-thread producers)
+    (loop repeat n-consumers do (bounded-queue-push :done q))
+    (let ((duplicates 0) (timeouts 0) (in-order t))
+      (dolist (consumer consumers)
+        (let ((received (timed-join-thread consumer)))
+          (if (listp received)
+              (let ((last (make-array n-producers :initial-element -1)))
+                (dolist (x (nreverse received))
+                  (multiple-value-bind (p i) (floor x n-objects)
+                    ;; Each consumer sees each producer's objects in order.
+                    (unless (< (aref last p) i)
+                      (setf in-order nil))
+                    (setf (aref last p) i))
+                  (if (zerop (bit seen x))
+                      (setf (bit seen x) 1)
+                      (incf duplicates))))
+              (incf timeouts))))
+      (list (count 1 seen) duplicates timeouts in-order))))
+
+(deftest bounded-queue.single-producer-single-consumer
+    (test-bounded-queue-producers-consumers :capacity 16
+                                            :n-producers 1
+                                            :n-consumers 1
+                                            :n-objects 100000)
+  (100000 0 0 t))
+
+(deftest bounded-queue.multiple-producers-multiple-consumers
+    (test-bounded-queue-producers-consumers :capacity 4
+                                            :n-producers 8
+                                            :n-consumers 8
+                                            :n-objects 20000)
+  (160000 0 0 t))
+
+;;; A full queue makes the producer wait until the consumer takes an
+;;; object.
+(deftest bounded-queue.backpressure
+    (let* ((q (make-bounded-queue 2))
+           (producer (make-thread (lambda ()
+                                    (dotimes (i 3)
+                                      (bounded-queue-push i q))
+                                    :done))))
+      (loop until (bounded-queue-full-p q) do (thread-yield))
+      (sleep 0.1)
+      (values (thread-alive-p producer)
+              (bounded-queue-pop q)
+              (timed-join-thread producer)
+              (loop repeat 3 collect (bounded-queue-try-pop q))))
+  t
+  0
+  :done
+  (1 2 nil))
+
+) ; #+sb-thread (progn ...
@@ -0,0 +1,124 @@
+;;;; This software is part of the SBCL system. See the README file for
+;;;; more information.
+;;;;
+;;;; This software is derived from the CMU CL system, which was written at
+;;;; Carnegie Mellon University and released into the public domain. The
+;;;; software is in the public domain and is provided with absolutely no
+;;;; warranty. See the COPYING and CREDITS files for more information.
+
+(in-package :sb-concurrency-test)
+
+(deftest future.1
+    (let ((f (make-future :name 'test-f)))
+      (values (futurep f)
+              (future-name f)
+              (future-done-p f)
+              (progn (fulfill-future f 1 2)
+                     (future-done-p f))
+              (multiple-value-list (await f))
+              (handler-case (fulfill-future f 3)
+                (error () :error))))
+  t
+  test-f
+  nil
+  t
+  (1 2)
+  :error)
+
+(deftest parallel-map.no-pool
+    (let ((*thread-pool* nil))
+      (values (parallel-map #'1+ #(1 2 3))
+              (parallel-reduce #'+ #(1 2 3))
+              (parallel-reduce #'+ #() :initial-value 10)
+              (parallel-reduce #'+ #())))
+  #(2 3 4)
+  6
+  10
+  0)
+
+#+sb-thread
+(progn
+
+(defmacro with-test-pool ((var &rest args) &body body)
+  `(let ((,var (make-thread-pool ,@args)))
+     (unwind-protect (progn ,@body)
+       (shutdown-thread-pool ,var))))
+
+(deftest thread-pool.submit
+    (with-test-pool (pool :size 4 :name "test")
+      (values (thread-poolp pool)
+              (thread-pool-size pool)
+              (multiple-value-list
+               (await (submit-task pool (lambda () (values 1 2)))))
+              (handler-case (await (submit-task pool (lambda () (error "oops"))))
+                (simple-error (condition)
+                  (simple-condition-format-control condition)))
+              (let ((f (make-future)))
+                (submit-task pool (lambda () (fulfill-future f :ok)))
+                (await f))))
+  t
+  4
+  (1 2)
+  "oops"
+  :ok)
+
+;;; Recursive tasks awaiting their children, many more than there are
+;;; workers: a worker that waits runs other tasks.
+(deftest thread-pool.fork-join
+    (with-test-pool (pool :size 4)
+      (labels ((fib (n)
+                 (if (< n 15)
+                     (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))
+                     (let ((a (submit-task pool (lambda () (fib (- n 1))))))
+                       (+ (fib (- n 2)) (await a))))))
+        (await (submit-task pool (lambda () (fib 25))))))
+  75025)
+
+(deftest thread-pool.submitters
+    (with-test-pool (pool :size 4)
+      (let* ((counter (list 0))
+             (submitters
+               (make-threads 4 "submitter"
+                             (lambda ()
+                               (let ((futures
+                                       (loop repeat 1000
+                                             collect (submit-task
+                                                      pool
+                                                      (lambda ()
+                                                        (sb-ext:atomic-incf
+                                                         (car counter)))))))
+                                 (mapc #'await futures)
+                                 t)))))
+        (values (mapcar #'timed-join-thread submitters)
+                (car counter))))
+  (t t t t)
+  4000)
+
+(deftest thread-pool.parallel-map
+    (with-test-pool (*thread-pool* :size 3)
+      (let ((vector (coerce (loop for i below 10000 collect i) 'vector)))
+        (values (equalp (parallel-map (lambda (x) (* x x)) vector :grain 7)
+                        (map 'vector (lambda (x) (* x x)) vector))
+                (parallel-reduce #'+ vector)
+                (parallel-reduce #'max vector :key #'- :initial-value 0 :grain 100)
+                (parallel-reduce #'list #(1) :initial-value 0))))
+  t
+  49995000
+  0
+  (0 1))
+
+(deftest thread-pool.shutdown
+    (let ((pool (make-thread-pool :size 2))
+          (counter (list 0)))
+      (loop repeat 100
+            do (submit-task pool (lambda ()
+                                   (sleep 0.001)
+                                   (sb-ext:atomic-incf (car counter)))))
+      (shutdown-thread-pool pool)
+      (values (car counter)
+              (handler-case (submit-task pool (lambda ()))
+                (error () :error))))
+  100
+  :error)
+
+) ; #+sb-thread (progn ...
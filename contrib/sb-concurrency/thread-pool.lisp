@@ -0,0 +1,415 @@
+;;;; Work-stealing thread pool
+;;;;
+;;;; This software is part of the SBCL system. See the README file for
+;;;; more information.
+;;;;
+;;;; This software is derived from the CMU CL system, which was written at
+;;;; Carnegie Mellon University and released into the public domain. The
+;;;; software is in the public domain and is provided with absolutely no
+;;;; warranty. See the COPYING and CREDITS files for more information.
+
+;;; Each worker has a Chase-Lev deque of tasks. The worker pushes and
+;;; pops at the bottom. Other workers steal from the top when they run
+;;; out of tasks of their own. Tasks submitted from threads that are
+;;; not workers of the pool go to a shared QUEUE, which workers take
+;;; from before they try to steal.
+;;;
+;;; A task is represented by its FUTURE, which holds the function to
+;;; call until it has run. AWAIT in a worker runs other tasks until
+;;; the future is done, starting with those in its own deque. The
+;;; awaited task is often among them.
+;;;
+;;; A worker that finds nothing to do parks on the pool's waitqueue,
+;;; counting itself among the sleepers first, and looks for work once
+;;; more before it waits. Submitting a task wakes a worker only if
+;;; there are sleepers. A parked worker is blocked in CONDITION-WAIT,
+;;; where stopping the world for GC interrupts it like any other
+;;; waiting thread, and idle workers never spin.
+
+(in-package :sb-concurrency)
+
+;;;; Chase-Lev deques
+
+(defstruct (task-deque (:constructor make-task-deque ())
+                       (:copier nil)
+                       (:predicate nil))
+  (top 0 :type fixnum)
+  (bottom 0 :type fixnum)
+  ;; The length is a power of two. A thief may still be reading the
+  ;; previous buffer after the owner has grown it, so a buffer is never
+  ;; modified once it is replaced.
+  (buffer (make-array 64 :initial-element nil) :type simple-vector))
+(declaim (sb-ext:freeze-type task-deque))
+
+;;; Only the owner pushes and pops. Without interrupts, so that code
+;;; run by INTERRUPT-THREAD can submit tasks.
+(defun task-deque-push (deque task)
+  (declare (optimize speed))
+  (sb-sys:without-interrupts
+    (let* ((bottom (task-deque-bottom deque))
+           (top (task-deque-top deque))
+           (buffer (task-deque-buffer deque))
+           (length (length buffer)))
+      (when (>= (- bottom top) (1- length))
+        (let ((new (make-array (* 2 length) :initial-element nil)))
+          (loop for i from top below bottom
+                do (setf (svref new (logand i (1- (* 2 length))))
+                         (svref buffer (logand i (1- length)))))
+          (setf buffer new
+                length (* 2 length))
+          (barrier (:write))
+          (setf (task-deque-buffer deque) new)))
+      (setf (svref buffer (logand bottom (1- length))) task)
+      (barrier (:write))
+      (setf (task-deque-bottom deque) (1+ bottom))))
+  task)
+
+(defun task-deque-pop (deque)
+  (declare (optimize speed))
+  (sb-sys:without-interrupts
+    (let ((bottom (1- (task-deque-bottom deque)))
+          (buffer (task-deque-buffer deque)))
+      (setf (task-deque-bottom deque) bottom)
+      ;; Thieves have to see the new bottom before we look at the top.
+      (barrier (:memory))
+      (let ((top (task-deque-top deque)))
+        (cond ((< top bottom)
+               (svref buffer (logand bottom (1- (length buffer)))))
+              ((= top bottom)
+               ;; The last task: race the thieves for it.
+               (let ((task (svref buffer (logand bottom (1- (length buffer))))))
+                 (prog1 (when (eql top (cas (task-deque-top deque) top (1+ top)))
+                          task)
+                   (setf (task-deque-bottom deque) (1+ bottom)))))
+              (t
+               (setf (task-deque-bottom deque) (1+ bottom))
+               nil))))))
+
+;;; Returns NIL if DEQUE is empty, or if another thread took the task.
+(defun task-deque-steal (deque)
+  (declare (optimize speed))
+  (let ((top (task-deque-top deque)))
+    (barrier (:memory))
+    (let ((bottom (task-deque-bottom deque)))
+      (when (< top bottom)
+        (barrier (:read))
+        (let* ((buffer (task-deque-buffer deque))
+               (task (svref buffer (logand top (1- (length buffer))))))
+          (when (eql top (cas (task-deque-top deque) top (1+ top)))
+            task))))))
+
+(declaim (inline task-deque-empty-p))
+(defun task-deque-empty-p (deque)
+  (>= (task-deque-top deque) (task-deque-bottom deque)))
+
+;;;; Futures
+
+(defstruct (future (:constructor %make-future (function name))
+                   (:copier nil)
+                   (:predicate futurep))
+  "A value that will be available later, either computed by a task
+submitted with SUBMIT-TASK, or provided with FULFILL-FUTURE.
+
+Use AWAIT to wait for the value, and FUTURE-DONE-P to check for it
+without waiting."
+  ;; The function of a task that has not run yet, or NIL
+  (function nil :type (or null function))
+  (state :pending :type (member :pending :done :failed))
+  ;; The values, or a list of the condition that the task signalled
+  (values nil :type list)
+  (mutex (make-mutex :name "future lock") :type mutex :read-only t)
+  (waitqueue (make-waitqueue :name "future") :type waitqueue :read-only t)
+  (name nil))
+(declaim (sb-ext:freeze-type future))
+
+(setf (documentation 'futurep 'function)
+      "Returns true if argument is a FUTURE, NIL otherwise."
+      (documentation 'future-name 'function)
+      "Name of a FUTURE. SETFable.")
+
+(defmethod print-object ((future future) stream)
+  (print-unreadable-object (future stream :type t :identity t)
+    (format stream "~@[~S ~]~((~A)~)"
+            (future-name future)
+            (future-state future))))
+
+(defun make-future (&key name)
+  "Returns a new FUTURE with NAME, to be made done by FULFILL-FUTURE."
+  (%make-future nil name))
+
+(declaim (inline future-done-p))
+(defun future-done-p (future)
+  "Returns true if FUTURE has a value, or its task signalled an error."
+  (not (eq (future-state future) :pending)))
+
+(defun complete-future (future state values)
+  (with-mutex ((future-mutex future))
+    (when (future-done-p future)
+      (error "~S is already done." future))
+    (setf (future-function future) nil
+          (future-values future) values)
+    (barrier (:write))
+    (setf (future-state future) state)
+    (condition-broadcast (future-waitqueue future))))
+
+(defun fulfill-future (future &rest values)
+  "Makes VALUES the values of FUTURE, which must come from MAKE-FUTURE,
+and wakes up the threads waiting for it. Returns FUTURE."
+  (declare (future future))
+  (when (future-function future)
+    (error "~S is computed by a task." future))
+  (complete-future future :done values)
+  future)
+
+(defun run-task (future)
+  (let ((function (future-function future))
+        (done nil))
+    (unwind-protect
+         (handler-case
+             (let ((values (multiple-value-list (funcall function))))
+               (setf done t)
+               (complete-future future :done values))
+           (error (condition)
+             (setf done t)
+             (complete-future future :failed (list condition))))
+      (unless done
+        (complete-future future :failed
+                         (list (make-condition
+                                'simple-error
+                                :format-control "The task of ~S exited abnormally."
+                                :format-arguments (list future))))))))
+
+;;;; Pools
+
+(defstruct (worker (:constructor make-worker (pool index))
+                   (:copier nil)
+                   (:predicate nil))
+  (pool (missing-arg) :read-only t)
+  (index 0 :type index :read-only t)
+  (deque (make-task-deque) :type task-deque :read-only t)
+  (thread nil))
+(declaim (sb-ext:freeze-type worker))
+
+(defstruct (thread-pool (:constructor %make-thread-pool (name))
+                        (:copier nil)
+                        (:predicate thread-poolp))
+  "Set of worker threads that run tasks.
+
+Use SUBMIT-TASK to run a function in a worker, PARALLEL-MAP and
+PARALLEL-REDUCE to divide work on a vector between workers, and
+SHUTDOWN-THREAD-POOL to stop the workers."
+  (workers #() :type simple-vector)
+  (injection-queue (make-queue) :type queue :read-only t)
+  (mutex (make-mutex :name "thread pool lock") :type mutex :read-only t)
+  (waitqueue (make-waitqueue :name "thread pool") :type waitqueue :read-only t)
+  ;; Number of workers parked or about to park
+  (sleepers 0 :type sb-ext:word)
+  (state :running :type (member :running :shutdown))
+  (name nil))
+(declaim (sb-ext:freeze-type thread-pool))
+
+(setf (documentation 'thread-poolp 'function)
+      "Returns true if argument is a THREAD-POOL, NIL otherwise."
+      (documentation 'thread-pool-name 'function)
+      "Name of a THREAD-POOL. SETFable.")
+
+(defvar *thread-pool* nil
+  "The THREAD-POOL used by PARALLEL-MAP and PARALLEL-REDUCE when no
+pool is given. If NIL, they do all the work in the calling thread.")
+
+;;; The worker that the current thread is
+(defvar *current-worker* nil)
+
+(defmethod print-object ((pool thread-pool) stream)
+  (print-unreadable-object (pool stream :type t :identity t)
+    (format stream "~@[~S ~](~D workers, ~(~A~))"
+            (thread-pool-name pool)
+            (thread-pool-size pool)
+            (thread-pool-state pool))))
+
+(defun thread-pool-size (pool)
+  "Returns the number of worker threads of POOL."
+  (length (thread-pool-workers pool)))
+
+(defun work-available-p (pool)
+  (or (not (queue-empty-p (thread-pool-injection-queue pool)))
+      (some (lambda (worker)
+              (not (task-deque-empty-p (worker-deque worker))))
+            (thread-pool-workers pool))))
+
+;;; Submitters call this after publishing a task: either the worker
+;;; about to park sees the task, or we see it among the sleepers.
+(defun wake-worker (pool)
+  (barrier (:memory))
+  (unless (zerop (thread-pool-sleepers pool))
+    (with-mutex ((thread-pool-mutex pool))
+      (condition-notify (thread-pool-waitqueue pool)))))
+
+(defun find-task (pool worker)
+  (or (and worker (task-deque-pop (worker-deque worker)))
+      (values (dequeue (thread-pool-injection-queue pool)))
+      (let* ((workers (thread-pool-workers pool))
+             (n (length workers))
+             (start (if worker (1+ (worker-index worker)) 0)))
+        (dotimes (i n)
+          (let ((victim (svref workers (mod (+ start i) n))))
+            (unless (eq victim worker)
+              (let ((task (task-deque-steal (worker-deque victim))))
+                (when task
+                  (return task)))))))))
+
+;;; Wait for work, and return NIL if POOL is shutting down instead.
+(defun park-worker (pool)
+  (let ((mutex (thread-pool-mutex pool)))
+    (with-mutex (mutex)
+      (atomic-incf (thread-pool-sleepers pool))
+      (unwind-protect
+           (progn
+             (barrier (:memory))
+             (loop
+               (cond ((work-available-p pool)
+                      (return t))
+                     ((eq (thread-pool-state pool) :shutdown)
+                      (return nil))
+                     (t
+                      (condition-wait (thread-pool-waitqueue pool) mutex)))))
+        (atomic-decf (thread-pool-sleepers pool))))))
+
+(defun worker-loop (worker)
+  (let ((pool (worker-pool worker))
+        (*current-worker* worker))
+    (loop
+      (let ((task (find-task pool worker)))
+        (cond (task
+               (run-task task))
+              ((not (park-worker pool))
+               (return)))))))
+
+(defun make-thread-pool (&key size name)
+  "Returns a new THREAD-POOL with NAME and SIZE worker threads. SIZE
+defaults to the number of processors."
+  (let* ((size (or size
+                   (sb-alien:alien-funcall
+                    (sb-alien:extern-alien "sb_online_processor_count"
+                                           (function sb-alien:int)))))
+         (pool (%make-thread-pool name))
+         (workers (make-array size)))
+    (dotimes (i size)
+      (setf (svref workers i) (make-worker pool i)))
+    (setf (thread-pool-workers pool) workers)
+    (loop for worker across workers
+          do (setf (worker-thread worker)
+                   (make-thread #'worker-loop
+                                :name (format nil "~@[~A ~]worker ~D"
+                                              name (worker-index worker))
+                                :arguments (list worker))))
+    pool))
+
+(defun shutdown-thread-pool (pool &key (wait t))
+  "Makes the workers of POOL exit once there are no tasks left, and if
+WAIT is true, waits for them to do so. Tasks can't be submitted to POOL
+afterwards."
+  (with-mutex ((thread-pool-mutex pool))
+    (setf (thread-pool-state pool) :shutdown)
+    (condition-broadcast (thread-pool-waitqueue pool)))
+  (when wait
+    (loop for worker across (thread-pool-workers pool)
+          do (join-thread (worker-thread worker) :default nil)))
+  pool)
+
+(defun submit-task (pool function)
+  "Arranges for a worker of POOL to call FUNCTION with no arguments,
+and returns a FUTURE of its values. If FUNCTION signals an error, AWAIT
+signals it again."
+  (declare (thread-pool pool))
+  (let ((future (%make-future (sb-kernel:%coerce-callable-to-fun function) nil))
+        (worker *current-worker*))
+    (when (eq (thread-pool-state pool) :shutdown)
+      (error "~S is shut down." pool))
+    (if (and worker (eq (worker-pool worker) pool))
+        (task-deque-push (worker-deque worker) future)
+        (enqueue future (thread-pool-injection-queue pool)))
+    (wake-worker pool)
+    future))
+
+(defun await (future)
+  "Waits until FUTURE is done and returns its values. If its task
+signalled an error, signals that error.
+
+In a worker thread, runs other tasks while it waits."
+  (declare (future future))
+  (unless (future-done-p future)
+    (let ((worker *current-worker*))
+      (when worker
+        (loop until (future-done-p future)
+              do (let ((task (find-task (worker-pool worker) worker)))
+                   (if task
+                       (run-task task)
+                       (return)))))
+      ;; The task is running in another thread.
+      (with-mutex ((future-mutex future))
+        (loop until (future-done-p future)
+              do (condition-wait (future-waitqueue future)
+                                 (future-mutex future))))))
+  (barrier (:read))
+  (let ((values (future-values future)))
+    (if (eq (future-state future) :failed)
+        (error (first values))
+        (values-list values))))
+
+;;;; Parallel sequence functions
+
+;;; Call FUNCTION with the bounds of consecutive pieces of [0,LENGTH),
+;;; each in a task of POOL, except for the first, which the current
+;;; thread does. Returns a list of the primary values in order.
+(defun map-pieces (function length pool grain)
+  (declare (function function) (index length))
+  (if (null pool)
+      (list (funcall function 0 length))
+      (let* ((grain (or grain
+                        (max 1 (ceiling length (* 4 (thread-pool-size pool))))))
+             (futures
+               (loop for start from grain below length by grain
+                     collect (let ((start start))
+                               (submit-task pool
+                                            (lambda ()
+                                              (funcall function start
+                                                       (min length (+ start grain)))))))))
+        (cons (funcall function 0 (min length grain))
+              (mapcar #'await futures)))))
+
+(defun parallel-map (function vector &key (pool *thread-pool*) grain)
+  "Returns a simple-vector of the results of calling FUNCTION on each
+element of VECTOR. The calls happen in the workers of POOL and in the
+calling thread, in pieces of GRAIN elements, in no particular order.
+GRAIN defaults to a quarter of the share of each worker."
+  (let* ((function (sb-kernel:%coerce-callable-to-fun function))
+         (length (length vector))
+         (result (make-array length)))
+    (map-pieces (lambda (start end)
+                  (loop for i from start below end
+                        do (setf (svref result i)
+                                 (funcall function (aref vector i)))))
+                length pool grain)
+    result))
+
+(defun parallel-reduce (function vector &key (pool *thread-pool*) grain key
+                                            (initial-value nil initial-value-p))
+  "Like REDUCE on VECTOR, but reduces pieces of GRAIN elements of VECTOR
+in the workers of POOL and in the calling thread, then combines their
+results in order. FUNCTION must be associative. GRAIN defaults to a
+quarter of the share of each worker."
+  (let ((function (sb-kernel:%coerce-callable-to-fun function))
+        (length (length vector)))
+    (cond ((plusp length)
+           (let ((results (map-pieces (lambda (start end)
+                                        (reduce function vector
+                                                :start start :end end :key key))
+                                      length pool grain)))
+             (if initial-value-p
+                 (reduce function results :initial-value initial-value)
+                 (reduce function results))))
+          (initial-value-p
+           initial-value)
+          (t
+           (funcall function)))))
@@ -0,0 +1,39 @@
+(in-package "SB-DIGEST")
+
+;;; The CRC32 instructions are optional before ARMv8.1, so ask the
+;;; kernel whether this CPU has them, again when a saved core starts.
+(sb-ext:defglobal **crc32c-instructions-p** nil)
+
+(defun find-crc32c-instructions ()
+  (setf **crc32c-instructions-p**
+        #+darwin t
+        #-darwin
+        (logbitp 7 ; HWCAP_CRC32
+                 (sb-alien:alien-funcall
+                  (sb-alien:extern-alien "getauxval"
+                                         (function sb-alien:unsigned-long
+                                                   sb-alien:unsigned-long))
+                  16)))) ; AT_HWCAP
+
+(find-crc32c-instructions)
+(pushnew 'find-crc32c-instructions sb-ext:*init-hooks*)
+
+(declaim (inline crc32c-instructions-p))
+(defun crc32c-instructions-p ()
+  **crc32c-instructions-p**)
+
+(define-vop (%crc32c-64)
+  (:policy :fast-safe)
+  (:translate %crc32c-64)
+  (:note "inline CRC32C")
+  (:args (crc :scs (sb-vm::unsigned-reg))
+         (word :scs (sb-vm::unsigned-reg)))
+  (:arg-types sb-vm::unsigned-num sb-vm::unsigned-num)
+  (:results (result :scs (sb-vm::unsigned-reg)))
+  (:result-types sb-vm::unsigned-num)
+  (:generator 3
+    ;; CRC32CX Wd, Wn, Xm, which the assembler doesn't know
+    (inst dword (logior #x9AC05C00
+                        (ash (tn-offset word) 16)
+                        (ash (tn-offset crc) 5)
+                        (tn-offset result)))))
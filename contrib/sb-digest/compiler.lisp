@@ -0,0 +1,10 @@
+(in-package "SB-DIGEST")
+
+;;; One step of CRC32C over the eight octets of WORD, taken in little
+;;; endian order, without the inversions before and after. This is
+;;; what the CRC32 instruction of SSE4.2 and CRC32CX of ARMv8 do, and
+;;; on these the VOP is used only when CRC32C-INSTRUCTIONS-P is true.
+#+(or x86-64 arm64)
+(defknown %crc32c-64 ((unsigned-byte 32) (unsigned-byte 64)) (unsigned-byte 32)
+  (flushable movable)
+  :overwrite-fndb-silently t)
@@ -0,0 +1,136 @@
+(in-package "SB-DIGEST")
+
+;;;; The compression functions of MD5, SHA-1 and SHA-256 (FIPS 180-4)
+;;;;
+;;;; Each one updates the state words H with N-BLOCKS blocks of 64
+;;;; octets read from SAP at OFFSET, using W for the message schedule.
+;;;; The arithmetic is modular on (UNSIGNED-BYTE 32), and ROTATE-BYTE
+;;;; compiles to rotate instructions, so no intermediate value conses.
+
+(deftype ub32 () '(unsigned-byte 32))
+
+(defmacro u32+ (&rest args)
+  `(ldb (byte 32 0) (+ ,@args)))
+
+(defmacro rol32 (x count)
+  `(sb-rotate-byte:rotate-byte ,count (byte 32 0) ,x))
+
+(defmacro ror32 (x count)
+  `(sb-rotate-byte:rotate-byte ,(- count) (byte 32 0) ,x))
+
+(declaim (inline sap-be32))
+(defun sap-be32 (sap offset)
+  #+big-endian (sb-sys:sap-ref-32 sap offset)
+  #-big-endian (logior (ash (sb-sys:sap-ref-8 sap offset) 24)
+                       (ash (sb-sys:sap-ref-8 sap (+ offset 1)) 16)
+                       (ash (sb-sys:sap-ref-8 sap (+ offset 2)) 8)
+                       (sb-sys:sap-ref-8 sap (+ offset 3))))
+
+;;; SB-MD5 does the rounds of MD5, on a block of words.
+(defun md5-blocks (h w sap offset n-blocks)
+  (declare (type (simple-array ub32 (4)) h)
+           (type (simple-array ub32 (16)) w)
+           (type sb-sys:system-area-pointer sap)
+           (type index offset n-blocks)
+           (optimize speed (safety 0)))
+  (dotimes (j n-blocks)
+    (let ((base (+ offset (* j 64))))
+      (dotimes (i 16)
+        (setf (aref w i) (sap-le32 sap (+ base (* i 4))))))
+    (sb-md5::update-md5-block h w)))
+
+(defun sha1-blocks (h w sap offset n-blocks)
+  (declare (type (simple-array ub32 (5)) h)
+           (type (simple-array ub32 (80)) w)
+           (type sb-sys:system-area-pointer sap)
+           (type index offset n-blocks)
+           (optimize speed (safety 0)))
+  (dotimes (j n-blocks)
+    (let ((base (+ offset (* j 64))))
+      (dotimes (i 16)
+        (setf (aref w i) (sap-be32 sap (+ base (* i 4))))))
+    (loop for i from 16 below 80
+          do (setf (aref w i)
+                   (rol32 (logxor (aref w (- i 3)) (aref w (- i 8))
+                                  (aref w (- i 14)) (aref w (- i 16)))
+                          1)))
+    (let ((a (aref h 0)) (b (aref h 1)) (c (aref h 2)) (d (aref h 3))
+          (e (aref h 4)))
+      (declare (type ub32 a b c d e))
+      (macrolet ((rounds (from to f k)
+                   `(loop for i from ,from below ,to
+                          do (let ((temp (u32+ (rol32 a 5) ,f e ,k (aref w i))))
+                               (setf e d
+                                     d c
+                                     c (rol32 b 30)
+                                     b a
+                                     a temp)))))
+        (rounds 0 20 (logior (logand b c) (logandc1 b d)) #x5A827999)
+        (rounds 20 40 (logxor b c d) #x6ED9EBA1)
+        (rounds 40 60 (logior (logand b c) (logand b d) (logand c d)) #x8F1BBCDC)
+        (rounds 60 80 (logxor b c d) #xCA62C1D6))
+      (setf (aref h 0) (u32+ (aref h 0) a)
+            (aref h 1) (u32+ (aref h 1) b)
+            (aref h 2) (u32+ (aref h 2) c)
+            (aref h 3) (u32+ (aref h 3) d)
+            (aref h 4) (u32+ (aref h 4) e)))))
+
+(declaim (type (simple-array ub32 (64)) **sha256-k**))
+(sb-ext:defglobal **sha256-k**
+    (make-array 64 :element-type 'ub32 :initial-contents
+                '(#x428a2f98 #x71374491 #xb5c0fbcf #xe9b5dba5 #x3956c25b #x59f111f1
+                  #x923f82a4 #xab1c5ed5 #xd807aa98 #x12835b01 #x243185be #x550c7dc3
+                  #x72be5d74 #x80deb1fe #x9bdc06a7 #xc19bf174 #xe49b69c1 #xefbe4786
+                  #x0fc19dc6 #x240ca1cc #x2de92c6f #x4a7484aa #x5cb0a9dc #x76f988da
+                  #x983e5152 #xa831c66d #xb00327c8 #xbf597fc7 #xc6e00bf3 #xd5a79147
+                  #x06ca6351 #x14292967 #x27b70a85 #x2e1b2138 #x4d2c6dfc #x53380d13
+                  #x650a7354 #x766a0abb #x81c2c92e #x92722c85 #xa2bfe8a1 #xa81a664b
+                  #xc24b8b70 #xc76c51a3 #xd192e819 #xd6990624 #xf40e3585 #x106aa070
+                  #x19a4c116 #x1e376c08 #x2748774c #x34b0bcb5 #x391c0cb3 #x4ed8aa4a
+                  #x5b9cca4f #x682e6ff3 #x748f82ee #x78a5636f #x84c87814 #x8cc70208
+                  #x90befffa #xa4506ceb #xbef9a3f7 #xc67178f2)))
+
+(defun sha256-blocks (h w sap offset n-blocks)
+  (declare (type (simple-array ub32 (8)) h)
+           (type (simple-array ub32 (64)) w)
+           (type sb-sys:system-area-pointer sap)
+           (type index offset n-blocks)
+           (optimize speed (safety 0)))
+  (let ((k **sha256-k**))
+    (dotimes (j n-blocks)
+      (let ((base (+ offset (* j 64))))
+        (dotimes (i 16)
+          (setf (aref w i) (sap-be32 sap (+ base (* i 4))))))
+      (loop for i from 16 below 64
+            do (let* ((w15 (aref w (- i 15)))
+                      (w2 (aref w (- i 2)))
+                      (s0 (logxor (ror32 w15 7) (ror32 w15 18) (ash w15 -3)))
+                      (s1 (logxor (ror32 w2 17) (ror32 w2 19) (ash w2 -10))))
+                 (setf (aref w i) (u32+ (aref w (- i 16)) s0 (aref w (- i 7)) s1))))
+      (let ((a (aref h 0)) (b (aref h 1)) (c (aref h 2)) (d (aref h 3))
+            (e (aref h 4)) (f (aref h 5)) (g (aref h 6)) (hh (aref h 7)))
+        (declare (type ub32 a b c d e f g hh))
+        (dotimes (i 64)
+          (let* ((t1 (u32+ hh
+                           (logxor (ror32 e 6) (ror32 e 11) (ror32 e 25))
+                           (logxor (logand e f) (logandc1 e g))
+                           (aref k i)
+                           (aref w i)))
+                 (t2 (u32+ (logxor (ror32 a 2) (ror32 a 13) (ror32 a 22))
+                           (logxor (logand a b) (logand a c) (logand b c)))))
+            (setf hh g
+                  g f
+                  f e
+                  e (u32+ d t1)
+                  d c
+                  c b
+                  b a
+                  a (u32+ t1 t2))))
+        (setf (aref h 0) (u32+ (aref h 0) a)
+              (aref h 1) (u32+ (aref h 1) b)
+              (aref h 2) (u32+ (aref h 2) c)
+              (aref h 3) (u32+ (aref h 3) d)
+              (aref h 4) (u32+ (aref h 4) e)
+              (aref h 5) (u32+ (aref h 5) f)
+              (aref h 6) (u32+ (aref h 6) g)
+              (aref h 7) (u32+ (aref h 7) hh))))))
@@ -0,0 +1,83 @@
+(in-package "SB-DIGEST")
+
+;;;; CRC32C, the Castagnoli CRC used by iSCSI, SCTP, ext4 and others
+
+;;; Eight tables for the reflected polynomial #x82F63B78, so that
+;;; eight octets are folded into the CRC at a time where there is no
+;;; instruction for it. Table K gives the CRC of an octet followed by
+;;; K zero octets.
+(declaim (type (simple-array (unsigned-byte 32) (2048)) **crc32c-tables**))
+(sb-ext:defglobal **crc32c-tables**
+    (let ((tables (make-array 2048 :element-type '(unsigned-byte 32))))
+      (dotimes (n 256)
+        (let ((crc n))
+          (dotimes (k 8)
+            (setf crc (if (logbitp 0 crc)
+                          (logxor (ash crc -1) #x82F63B78)
+                          (ash crc -1))))
+          (setf (aref tables n) crc)))
+      (loop for k from 256 below 2048
+            do (let ((previous (aref tables (- k 256))))
+                 (setf (aref tables k)
+                       (logxor (ash previous -8)
+                               (aref tables (logand previous #xff))))))
+      tables))
+
+#+(or x86-64 arm64)
+(defun %crc32c-64 (crc word)
+  (declare (type (unsigned-byte 32) crc) (type (unsigned-byte 64) word))
+  (%crc32c-64 crc word))
+
+(declaim (inline sap-le32))
+(defun sap-le32 (sap offset)
+  #+little-endian (sb-sys:sap-ref-32 sap offset)
+  #-little-endian (logior (sb-sys:sap-ref-8 sap offset)
+                          (ash (sb-sys:sap-ref-8 sap (+ offset 1)) 8)
+                          (ash (sb-sys:sap-ref-8 sap (+ offset 2)) 16)
+                          (ash (sb-sys:sap-ref-8 sap (+ offset 3)) 24)))
+
+;;; Return the CRC register CRC, without the inversions before and
+;;; after, updated with the octets of SAP from START below END.
+(defun %update-crc32c (crc sap start end)
+  (declare (type (unsigned-byte 32) crc)
+           (type sb-sys:system-area-pointer sap)
+           (type index start end)
+           (optimize speed (safety 0)))
+  #+(or x86-64 arm64)
+  (when (crc32c-instructions-p)
+    (loop while (<= (+ start 8) end)
+          do (setf crc (%crc32c-64 crc (sb-sys:sap-ref-64 sap start)))
+             (incf start 8)))
+  (let ((tables **crc32c-tables**))
+    (macrolet ((table (k octet)
+                 `(aref tables (+ ,(* k 256) ,octet))))
+      (loop while (<= (+ start 8) end)
+            do (let ((low (logxor crc (sap-le32 sap start)))
+                     (high (sap-le32 sap (+ start 4))))
+                 (setf crc (logxor (table 7 (ldb (byte 8 0) low))
+                                   (table 6 (ldb (byte 8 8) low))
+                                   (table 5 (ldb (byte 8 16) low))
+                                   (table 4 (ldb (byte 8 24) low))
+                                   (table 3 (ldb (byte 8 0) high))
+                                   (table 2 (ldb (byte 8 8) high))
+                                   (table 1 (ldb (byte 8 16) high))
+                                   (table 0 (ldb (byte 8 24) high)))))
+               (incf start 8))
+      (loop while (< start end)
+            do (setf crc (logxor (table 0 (logand (logxor crc (sb-sys:sap-ref-8 sap start))
+                                                  #xff))
+                                 (ash crc -8)))
+               (incf start))
+      crc)))
+
+(defun crc32c (octets &key (start 0) end (crc 0))
+  "Returns the CRC32C of OCTETS from START to END, an (UNSIGNED-BYTE 32).
+CRC is the CRC of the octets that came before, so that the CRC of a
+sequence of octets can be computed piece by piece."
+  (declare (type (simple-array (unsigned-byte 8) (*)) octets)
+           (type (unsigned-byte 32) crc))
+  (with-array-data ((octets octets) (start start) (end end) :check-fill-pointer t)
+    (sb-sys:with-pinned-objects (octets)
+      (logxor (%update-crc32c (logxor crc #xFFFFFFFF) (sb-sys:vector-sap octets)
+                              start end)
+              #xFFFFFFFF))))
@@ -0,0 +1,125 @@
+(defpackage "SB-DIGEST-TESTS"
+  (:use "CL" "SB-DIGEST" "SB-RT"))
+
+(in-package "SB-DIGEST-TESTS")
+
+(defun hex (octets)
+  (format nil "~(~{~2,'0X~}~)" (coerce octets 'list)))
+
+(defun ascii (string)
+  (sb-ext:string-to-octets string :external-format :ascii))
+
+;;; Octets I modulo 251 for I below N, so that no block repeats
+(defun octets (n)
+  (let ((octets (make-array n :element-type '(unsigned-byte 8))))
+    (dotimes (i n octets)
+      (setf (aref octets i) (mod i 251)))))
+
+(macrolet ((define-vectors (&rest vectors)
+             `(progn
+                ,@(loop for (algorithm message expected) in vectors
+                        for i from 0
+                        collect `(deftest ,(intern (format nil "~A.~D" algorithm i))
+                                     (hex (digest-octets ,algorithm ,message))
+                                   ,expected)))))
+  (define-vectors
+    (:md5 (ascii "") "d41d8cd98f00b204e9800998ecf8427e")
+    (:md5 (ascii "abc") "900150983cd24fb0d6963f7d28e17f72")
+    (:md5 (make-array 1000000 :element-type '(unsigned-byte 8)
+                              :initial-element (char-code #\a))
+          "7707d6ae4e027c70eea2a935c2296f21")
+    (:sha1 (ascii "") "da39a3ee5e6b4b0d3255bfef95601890afd80709")
+    (:sha1 (ascii "abc") "a9993e364706816aba3e25717850c26c9cd0d89d")
+    (:sha1 (ascii "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")
+           "84983e441c3bd26ebaae4aa1f95129e5e54670f1")
+    (:sha1 (make-array 1000000 :element-type '(unsigned-byte 8)
+                               :initial-element (char-code #\a))
+           "34aa973cd4c4daa4f61eeb2bdbad27316534016f")
+    (:sha1 (octets 55) "8ae2d46729cfe68ff927af5eec9c7d1b66d65ac2")
+    (:sha1 (octets 56) "636e2ec698dac903498e648bd2f3af641d3c88cb")
+    (:sha1 (octets 63) "6d942da0c4392b123528f2905c713a3ce28364bd")
+    (:sha1 (octets 64) "c6138d514ffa2135bfce0ed0b8fac65669917ec7")
+    (:sha1 (octets 65) "69bd728ad6e13cd76ff19751fde427b00e395746")
+    (:sha256 (ascii "")
+             "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855")
+    (:sha256 (ascii "abc")
+             "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad")
+    (:sha256 (ascii "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")
+             "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1")
+    (:sha256 (make-array 1000000 :element-type '(unsigned-byte 8)
+                                 :initial-element (char-code #\a))
+             "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0")
+    (:sha256 (octets 55)
+             "463eb28e72f82e0a96c0a4cc53690c571281131f672aa229e0d45ae59b598b59")
+    (:sha256 (octets 56)
+             "da2ae4d6b36748f2a318f23e7ab1dfdf45acdc9d049bd80e59de82a60895f562")
+    (:sha256 (octets 63)
+             "29af2686fd53374a36b0846694cc342177e428d1647515f078784d69cdb9e488")
+    (:sha256 (octets 64)
+             "fdeab9acf3710362bd2658cdc9a29e8f9c757fcf9811603a8c447cd1d9151108")
+    (:sha256 (octets 65)
+             "4bfd2c8b6f1eec7a2afeb48b934ee4b2694182027e6d0fc075074f2fabb31781")
+    ;; From RFC 3720
+    (:crc32c (ascii "123456789") "e3069283")
+    (:crc32c (make-array 32 :element-type '(unsigned-byte 8) :initial-element 0)
+             "8a9136aa")
+    (:crc32c (make-array 32 :element-type '(unsigned-byte 8) :initial-element #xff)
+             "62a8ab43")
+    (:crc32c (octets 32) "46dd794e")))
+
+;;; The same as SB-MD5 across the lengths where padding changes
+(deftest md5.sb-md5
+    (loop for n from 0 to 130
+          always (equalp (digest-octets :md5 (octets n))
+                         (sb-md5:md5sum-sequence (octets n))))
+  t)
+
+;;; Pieces of every length up to 70, starting at every offset in a block
+(deftest update-digest.pieces
+    (let ((octets (octets 1000)))
+      (loop for algorithm in '(:md5 :sha1 :sha256 :crc32c)
+            for expected = (digest-octets algorithm octets)
+            always (loop for piece from 1 to 70
+                         always (let ((digest (make-digest algorithm)))
+                                  (loop for start from 0 below 1000 by piece
+                                        do (update-digest digest octets
+                                                          :start start
+                                                          :end (min 1000 (+ start piece))))
+                                  (equalp (finalize-digest digest) expected)))))
+  t)
+
+(deftest crc32c.crc
+    (let ((octets (ascii "123456789")))
+      (list (crc32c octets)
+            (crc32c octets :start 4 :crc (crc32c octets :end 4))
+            (crc32c octets :start 9)))
+  (#xe3069283 #xe3069283 0))
+
+(deftest finalize-digest.twice
+    (let ((digest (make-digest :sha1)))
+      (finalize-digest digest)
+      (handler-case (progn (finalize-digest digest) nil)
+        (error () t)))
+  t)
+
+;;; From an fd-stream after a READ-BYTE, and from another kind of stream
+(deftest digest-stream.fd-stream
+    (let ((pathname (format nil "digest-test-~D.tmp" (random 100000)))
+          (octets (octets 100000)))
+      (unwind-protect
+           (progn
+             (with-open-file (stream pathname :direction :output
+                                              :element-type '(unsigned-byte 8)
+                                              :if-exists :supersede)
+               (write-sequence octets stream))
+             (list (equalp (digest-file :sha256 pathname)
+                           (digest-octets :sha256 octets))
+                   (with-open-file (stream pathname :element-type '(unsigned-byte 8))
+                     (read-byte stream)
+                     (equalp (digest-stream :sha1 stream)
+                             (digest-octets :sha1 octets :start 1)))
+                   (with-open-file (stream pathname :element-type '(unsigned-byte 8))
+                     (equalp (digest-stream :crc32c (make-concatenated-stream stream))
+                             (digest-octets :crc32c octets)))))
+        (delete-file pathname)))
+  (t t t))
@@ -0,0 +1,204 @@
+(in-package "SB-DIGEST")
+
+;;;; Digests of octets fed piece by piece
+
+(defstruct (digest (:constructor %make-digest (algorithm state schedule))
+                   (:copier nil)
+                   (:predicate digestp))
+  (algorithm nil :type (member :md5 :sha1 :sha256 :crc32c) :read-only t)
+  ;; The chaining words, or for CRC32C the CRC register
+  (state nil :type (simple-array ub32 (*)) :read-only t)
+  ;; Space for the message schedule of the compression function
+  (schedule nil :type (simple-array ub32 (*)) :read-only t)
+  ;; The octets of a block that isn't complete yet
+  (buffer (make-array 64 :element-type '(unsigned-byte 8) :initial-element 0)
+   :type (simple-array (unsigned-byte 8) (64)) :read-only t)
+  (buffer-index 0 :type (integer 0 63))
+  ;; The number of octets seen so far, modulo 2^64
+  (octet-count 0 :type sb-ext:word)
+  (finalized nil :type boolean))
+(declaim (sb-ext:freeze-type digest))
+
+(setf (documentation 'digestp 'function)
+      "Returns true if argument is a DIGEST, NIL otherwise.")
+
+(defun digest-length (algorithm)
+  "Returns the number of octets in a digest by ALGORITHM, one of :MD5,
+:SHA1, :SHA256 and :CRC32C."
+  (ecase algorithm
+    (:md5 16)
+    (:sha1 20)
+    (:sha256 32)
+    (:crc32c 4)))
+
+(defun make-digest (algorithm)
+  "Returns a DIGEST that computes the digest by ALGORITHM, one of :MD5,
+:SHA1, :SHA256 and :CRC32C, of the octets given to UPDATE-DIGEST and
+UPDATE-DIGEST-FROM-STREAM, and returned by FINALIZE-DIGEST."
+  (flet ((words (&rest words)
+           (make-array (length words) :element-type 'ub32
+                                      :initial-contents words))
+         (schedule (length)
+           (make-array length :element-type 'ub32 :initial-element 0)))
+    (ecase algorithm
+      (:md5
+       (%make-digest algorithm
+                     (words #x67452301 #xefcdab89 #x98badcfe #x10325476)
+                     (schedule 16)))
+      (:sha1
+       (%make-digest algorithm
+                     (words #x67452301 #xefcdab89 #x98badcfe #x10325476 #xc3d2e1f0)
+                     (schedule 80)))
+      (:sha256
+       (%make-digest algorithm
+                     (words #x6a09e667 #xbb67ae85 #x3c6ef372 #xa54ff53a
+                            #x510e527f #x9b05688c #x1f83d9ab #x5be0cd19)
+                     (schedule 64)))
+      (:crc32c
+       (%make-digest algorithm (words #xFFFFFFFF) (schedule 0))))))
+
+(defun compress-blocks (digest sap offset n-blocks)
+  (declare (type digest digest) (type index offset n-blocks))
+  (let ((h (digest-state digest))
+        (w (digest-schedule digest)))
+    (ecase (digest-algorithm digest)
+      (:md5 (md5-blocks h w sap offset n-blocks))
+      (:sha1 (sha1-blocks h w sap offset n-blocks))
+      (:sha256 (sha256-blocks h w sap offset n-blocks)))))
+
+;;; Feed the octets of SAP from START below END to DIGEST. Whole blocks
+;;; are compressed where they are, and only the octets of a block that
+;;; isn't complete are copied, into the buffer of DIGEST.
+(defun %update-digest (digest sap start end)
+  (declare (type digest digest)
+           (type sb-sys:system-area-pointer sap)
+           (type index start end))
+  (when (digest-finalized digest)
+    (error "~S has been finalized." digest))
+  (setf (digest-octet-count digest)
+        (ldb (byte 64 0) (+ (digest-octet-count digest) (- end start))))
+  (when (eq (digest-algorithm digest) :crc32c)
+    (let ((state (digest-state digest)))
+      (setf (aref state 0) (%update-crc32c (aref state 0) sap start end)))
+    (return-from %update-digest digest))
+  (let ((buffer (digest-buffer digest))
+        (index (digest-buffer-index digest)))
+    (sb-sys:with-pinned-objects (buffer)
+      (let ((buffer-sap (sb-sys:vector-sap buffer)))
+        (when (plusp index)
+          (let ((n (min (- 64 index) (- end start))))
+            (system-area-ub8-copy sap start buffer-sap index n)
+            (incf index n)
+            (incf start n)
+            (when (= index 64)
+              (compress-blocks digest buffer-sap 0 1)
+              (setf index 0))))
+        (let ((n-blocks (floor (- end start) 64)))
+          (when (plusp n-blocks)
+            (compress-blocks digest sap start n-blocks)
+            (incf start (* n-blocks 64))))
+        (system-area-ub8-copy sap start buffer-sap index (- end start))
+        (setf (digest-buffer-index digest) (+ index (- end start)))))
+    digest))
+
+(defun update-digest (digest octets &key (start 0) end)
+  "Feeds the octets of OCTETS from START to END to DIGEST, and returns
+DIGEST."
+  (declare (type digest digest)
+           (type (simple-array (unsigned-byte 8) (*)) octets))
+  (with-array-data ((octets octets) (start start) (end end) :check-fill-pointer t)
+    (sb-sys:with-pinned-objects (octets)
+      (%update-digest digest (sb-sys:vector-sap octets) start end))))
+
+;;; Feed what an FD-STREAM of octets has to DIGEST from its own
+;;; buffers, refilling them until the end of file.
+(defun update-digest-from-fd-stream (digest stream)
+  (let ((in-buffer (sb-impl::ansi-stream-in-buffer stream)))
+    (when in-buffer
+      (let ((index (sb-impl::ansi-stream-in-index stream)))
+        (update-digest digest in-buffer :start index)
+        (setf (sb-impl::ansi-stream-in-index stream) (length in-buffer)))))
+  (loop
+    (let* ((ibuf (sb-impl::fd-stream-ibuf stream))
+           (head (sb-impl::buffer-head ibuf))
+           (tail (sb-impl::buffer-tail ibuf)))
+      (%update-digest digest (sb-impl::buffer-sap ibuf) head tail)
+      (setf (sb-impl::buffer-head ibuf) tail)
+      (unless (catch 'sb-impl::eof-input-catcher
+                (sb-impl::refill-input-buffer stream))
+        (return digest)))))
+
+(defun update-digest-from-stream (digest stream)
+  "Feeds the octets read from STREAM until the end of file to DIGEST,
+and returns DIGEST. The element type of STREAM must be (UNSIGNED-BYTE
+8). The octets of an FD-STREAM are taken from its buffer, without
+copying them."
+  (declare (type digest digest) (type stream stream))
+  (if (and (sb-impl::fd-stream-p stream)
+           (sb-impl::fd-stream-ibuf stream)
+           (or (sb-impl::fd-stream-bivalent-p stream)
+               (equal (stream-element-type stream) '(unsigned-byte 8)))
+           (zerop (length (sb-impl::fd-stream-instead stream))))
+      (update-digest-from-fd-stream digest stream)
+      (let ((buffer (make-array 65536 :element-type '(unsigned-byte 8))))
+        (loop for end = (read-sequence buffer stream)
+              do (update-digest digest buffer :end end)
+              until (< end (length buffer)))
+        digest)))
+
+(defun finalize-digest (digest)
+  "Returns the digest of the octets fed to DIGEST, as a vector of
+(UNSIGNED-BYTE 8) of DIGEST-LENGTH of its algorithm. DIGEST can't be
+updated after that."
+  (declare (type digest digest))
+  (when (digest-finalized digest)
+    (error "~S has been finalized." digest))
+  (let* ((algorithm (digest-algorithm digest))
+         (state (digest-state digest))
+         (result (make-array (digest-length algorithm)
+                             :element-type '(unsigned-byte 8))))
+    (if (eq algorithm :crc32c)
+        (setf (aref state 0) (logxor (aref state 0) #xFFFFFFFF))
+        ;; Pad with a one bit, zeros to 56 octets modulo 64, and the
+        ;; length in bits as 64 bits.
+        (let ((buffer (digest-buffer digest))
+              (index (digest-buffer-index digest))
+              (bits (ldb (byte 64 0) (* 8 (digest-octet-count digest)))))
+          (sb-sys:with-pinned-objects (buffer)
+            (let ((buffer-sap (sb-sys:vector-sap buffer)))
+              (setf (aref buffer index) #x80)
+              (fill buffer 0 :start (1+ index))
+              (when (>= index 56)
+                (compress-blocks digest buffer-sap 0 1)
+                (fill buffer 0))
+              (dotimes (i 8)
+                (setf (aref buffer (+ 56 i))
+                      (if (eq algorithm :md5)
+                          (ldb (byte 8 (* i 8)) bits)
+                          (ldb (byte 8 (* (- 7 i) 8)) bits))))
+              (compress-blocks digest buffer-sap 0 1)))))
+    (setf (digest-finalized digest) t)
+    ;; MD5 is little endian and the rest big endian.
+    (dotimes (i (length result) result)
+      (multiple-value-bind (word octet) (floor i 4)
+        (setf (aref result i)
+              (ldb (byte 8 (if (eq algorithm :md5)
+                               (* octet 8)
+                               (* (- 3 octet) 8)))
+                   (aref state word)))))))
+
+(defun digest-octets (algorithm octets &key (start 0) end)
+  "Returns the digest by ALGORITHM of OCTETS from START to END."
+  (finalize-digest (update-digest (make-digest algorithm) octets
+                                  :start start :end end)))
+
+(defun digest-stream (algorithm stream)
+  "Returns the digest by ALGORITHM of the octets read from STREAM until
+the end of file."
+  (finalize-digest (update-digest-from-stream (make-digest algorithm) stream)))
+
+(defun digest-file (algorithm pathname)
+  "Returns the digest by ALGORITHM of the contents of the file named by
+PATHNAME."
+  (with-open-file (stream pathname :element-type '(unsigned-byte 8))
+    (digest-stream algorithm stream)))
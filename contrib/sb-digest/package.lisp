@@ -0,0 +1,8 @@
+(defpackage "SB-DIGEST"
+  (:use "CL" "SB-C" "SB-VM" "SB-INT" "SB-KERNEL" "SB-ASSEM")
+  (:export "DIGEST" "DIGESTP" "MAKE-DIGEST" "DIGEST-ALGORITHM" "DIGEST-LENGTH"
+           "UPDATE-DIGEST" "UPDATE-DIGEST-FROM-STREAM" "FINALIZE-DIGEST"
+           "DIGEST-OCTETS" "DIGEST-STREAM" "DIGEST-FILE"
+           "CRC32C"))
+(eval-when (:compile-toplevel :load-toplevel :execute)
+  (setf (sb-int:system-package-p (find-package "SB-DIGEST")) t))
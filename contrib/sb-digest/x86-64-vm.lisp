@@ -0,0 +1,18 @@
+(in-package "SB-DIGEST")
+
+(declaim (inline crc32c-instructions-p))
+(defun crc32c-instructions-p ()
+  (logbitp sb-vm::cpu-has-sse42 sb-vm::*cpu-feature-bits*))
+
+(define-vop (%crc32c-64)
+  (:policy :fast-safe)
+  (:translate %crc32c-64)
+  (:note "inline CRC32C")
+  (:args (crc :scs (sb-vm::unsigned-reg) :target result)
+         (word :scs (sb-vm::unsigned-reg)))
+  (:arg-types sb-vm::unsigned-num sb-vm::unsigned-num)
+  (:results (result :scs (sb-vm::unsigned-reg) :from (:argument 0)))
+  (:result-types sb-vm::unsigned-num)
+  (:generator 3
+    (move result crc)
+    (inst crc32 :qword result word)))
@@ -487,6 +487,69 @@ not supported."
 
  (define-call "msync" int minusp
    (addr sb-sys:system-area-pointer) (length unsigned) (flags int)))
+
+;;; Vectors whose elements are the contents of a mapped file. The file
+;;; is mapped right after an anonymous page, and the vector header goes
+;;; in the last two words of that page, so the vector lives neither in
+;;; the heap nor in any of its spaces and the GC leaves it alone.
+#-win32
+(progn
+  (export '(map-file-vector unmap-file-vector))
+
+  (defun map-file-vector (pathname &key (element-type '(unsigned-byte 8))
+                                        (direction :input))
+    "Returns a simple vector of ELEMENT-TYPE, a specialized element type
+of numbers, whose elements are the contents of the file named by
+PATHNAME, mapped in memory rather than copied. The size of the file
+must be a multiple of the size of the elements. With DIRECTION :IO,
+storing into the vector changes the file; with :INPUT, the default,
+it is an error. The vector must be given to UNMAP-FILE-VECTOR once
+it is no longer referenced, and must not be in a saved core."
+    (declare (type (member :input :io) direction))
+    (multiple-value-bind (widetag n-bits-shift)
+        (sb-impl::%vector-widetag-and-n-bits-shift element-type)
+      (unless (and (subtypep element-type 'number)
+                   (>= n-bits-shift 3))
+        (error "Can't map a file as a vector of ~S." element-type))
+      (let ((fd (open pathname (if (eq direction :io) o-rdwr o-rdonly)))
+            (page (getpagesize)))
+        (unwind-protect
+             (multiple-value-bind (length remainder)
+                 (floor (stat-size (fstat fd)) (ash 1 (- n-bits-shift 3)))
+               (unless (zerop remainder)
+                 (error "The size of ~A is not a multiple of the size of ~S."
+                        pathname element-type))
+               (let* ((size (ash length (- n-bits-shift 3)))
+                      (region (mmap nil (+ page size)
+                                    (logior prot-read prot-write)
+                                    (logior map-private map-anon) -1 0))
+                      (header (sb-sys:sap+ region
+                                            (- page (* 2 sb-vm:n-word-bytes)))))
+                 (when (plusp size)
+                   (mmap (sb-sys:sap+ region page) size
+                         (if (eq direction :io)
+                             (logior prot-read prot-write)
+                             prot-read)
+                         (logior map-shared map-fixed) fd 0))
+                 (setf (sb-sys:sap-ref-word header 0) widetag
+                       (sb-sys:sap-ref-word header sb-vm:n-word-bytes)
+                       (sb-kernel:get-lisp-obj-address length))
+                 (sb-kernel:%make-lisp-obj
+                  (logior (sb-sys:sap-int header) sb-vm:other-pointer-lowtag))))
+          (close fd)))))
+
+  (defun unmap-file-vector (vector)
+    "Unmaps VECTOR, as returned by MAP-FILE-VECTOR, after which it must
+not be used."
+    (multiple-value-bind (widetag n-bits-shift)
+        (sb-impl::%vector-widetag-and-n-bits-shift (array-element-type vector))
+      (declare (ignore widetag))
+      (let ((page (getpagesize))
+            (header (logandc2 (sb-kernel:get-lisp-obj-address vector)
+                              sb-vm:lowtag-mask)))
+        (munmap (sb-sys:int-sap (- (+ header (* 2 sb-vm:n-word-bytes)) page))
+                (+ page (ash (length vector) (- n-bits-shift 3))))
+        nil))))
 #+win32
 (progn
   ;; No attempt is made to offer a full mmap-like interface on Windows.
@@ -901,3 +901,32 @@
   "name1,test1"
   "name2,test1"
   "name2,test2")
+
+#-win32
+(deftest map-file-vector.1
+    (let ((name (merge-pathnames "map-file-vector-test.dat" *test-directory*))
+          (octets (make-array 10000 :element-type '(unsigned-byte 8))))
+      (dotimes (i (length octets))
+        (setf (aref octets i) (mod i 251)))
+      (unwind-protect
+           (progn
+             (with-open-file (stream name :direction :output
+                                          :element-type '(unsigned-byte 8)
+                                          :if-exists :supersede)
+               (write-sequence octets stream))
+             (list
+              (let ((vector (sb-posix:map-file-vector name)))
+                (sb-ext:gc :full t)
+                (prog1 (list (typep vector '(simple-array (unsigned-byte 8) (*)))
+                             (equalp vector octets))
+                  (sb-posix:unmap-file-vector vector)))
+              (let ((vector (sb-posix:map-file-vector
+                             name :element-type '(unsigned-byte 16)
+                                  :direction :io)))
+                (setf (aref vector 0) #xffff)
+                (prog1 (length vector)
+                  (sb-posix:unmap-file-vector vector)))
+              (with-open-file (stream name :element-type '(unsigned-byte 8))
+                (list (read-byte stream) (read-byte stream) (read-byte stream)))))
+        (ignore-errors (sb-posix:unlink name))))
+  ((t t) 5000 (255 255 2)))
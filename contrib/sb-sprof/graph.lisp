@@ -151,6 +151,8 @@
   (sample-interval (sb-int:missing-arg) :type (real (0)) :read-only t)
   ;; the sampling-mode that was used for the profiling run
   (sampling-mode   (sb-int:missing-arg) :type sampling-mode :read-only t)
+  ;; true if SAMPLE-INTERVAL is a number of bytes, in :ALLOC mode
+  (alloc-interval-p nil                 :type boolean :read-only t)
   ;; number of samples taken
   (nsamples        (sb-int:missing-arg) :type sb-int:index :read-only t)
   (unique-trace-count (sb-int:missing-arg) :type sb-int:index :read-only t)
@@ -386,8 +388,9 @@
         (%make-call-graph :nsamples (samples-trace-count samples)
                           :unique-trace-count (samples-unique-trace-count samples)
                           :sample-interval (if (eq (samples-mode samples) :alloc)
-                                               1
+                                               (or (samples-alloc-interval samples) 1)
                                                (samples-sample-interval samples))
+                          :alloc-interval-p (and (samples-alloc-interval samples) t)
                           :sampling-mode (samples-mode samples)
                           :sampled-threads (samples-sampled-threads samples)
                           :elsewhere-count elsewhere-count
@@ -420,18 +423,24 @@
             (round (* (/ (call-count call) (node-count to))
                       (node-accrued-count to)))))))
 
-;;; Return a CALL-GRAPH structure for the current contents of
-;;; *SAMPLES*.  The result contain a list of nodes sorted by self-time
-;;; in the FLAT-NODES slot, and a dag in VERTICES, with call cycles
-;;; reduced to CYCLE structures.
-(defun make-call-graph (samples max-depth)
+;;; Convert the raw data in the profiling buffers into SAMPLES, once.
+(defun aggregate-samples (samples)
   (stop-profiling)
   (when (zerop (length (samples-vector samples)))
     (show-progress "~&Aggregating raw data")
     (setf (values (samples-vector samples)
                   (samples-unique-trace-count samples)
-                  (samples-sampled-threads samples))
-          (convert-raw-data)))
+                  (samples-sampled-threads samples)
+                  (samples-live-traces samples))
+          (convert-raw-data (when (samples-alloc-interval samples)
+                              (alloc-live-weights))))))
+
+;;; Return a CALL-GRAPH structure for the current contents of
+;;; *SAMPLES*.  The result contain a list of nodes sorted by self-time
+;;; in the FLAT-NODES slot, and a dag in VERTICES, with call cycles
+;;; reduced to CYCLE structures.
+(defun make-call-graph (samples max-depth)
+  (aggregate-samples samples)
   (show-progress "~&Computing call graph")
   ;; I _think_ the reason for pinning all code is that the graph logic
   ;; compares absolute PC locations. Wonderfully commented, it is.
@@ -27,6 +27,8 @@ profiling, and :TIME for wallclock profiling.")
                                 max-depth
                                 show-progress
                                 (threads :all)
+                                event
+                                (event-period 1000000)
                                 (report nil report-p))
                           &body body)
   "Evaluate BODY with statistical profiling turned on. If LOOP is true,
@@ -43,6 +45,14 @@ The following keyword args are recognized:
    profiler in allocation profiling mode. If :TIME, run the profiler
    in wallclock profiling mode.
 
+ :ALLOC-INTERVAL <n>
+   In :ALLOC mode, sample an average of once every <n> bytes allocated.
+   See START-PROFILING.
+
+ :EVENT <event>
+ :EVENT-PERIOD <n>
+   Choose what triggers samples in :CPU mode. See START-PROFILING.
+
  :MAX-SAMPLES <max>
    If :LOOP is NIL (the default), collect no more than <max> samples.
    If :LOOP is T, repeat evaluating body until <max> samples are taken.
@@ -72,7 +82,6 @@ The following keyword args are recognized:
   (declare (type report-type report))
   (check-type loop boolean)
   #-sb-thread (unless (eq threads :all) (warn ":THREADS is ignored"))
-  (when alloc-interval (warn "ALLOC-INTERVAL is ignored"))
   (when max-depth (warn "MAX-DEPTH is ignored"))
   (let ((message "~@<No sampling progress; run too short, sampling frequency too low, ~
 inappropriate set of sampled threads, or possibly a profiler bug.~:@>"))
@@ -83,7 +92,9 @@ inappropriate set of sampled threads, or possibly a profiler bug.~:@>"))
               (progn
                 (start-profiling :mode ,mode :max-samples ,max-samples
                                  :sample-interval ,sample-interval
-                                 :threads ,threads)
+                                 :alloc-interval ,alloc-interval
+                                 :threads ,threads
+                                 :event ,event :event-period ,event-period)
                 ,(if loop
                      `(let (,values)
                         (loop ; Uh, shouldn't this be a trailing test, not a leading test?
@@ -108,13 +119,61 @@ inappropriate set of sampled threads, or possibly a profiler bug.~:@>"))
 ;;; or SB-EXT:TIMER depending on whether thread support exists.
 (defglobal *timer* nil)
 
+;;; The values of START-PROFILING's :EVENT argument which name a hardware
+;;; event, in the order of the PERF_COUNT_HW_ constants of Linux.
+(defglobal *hardware-events*
+    '(:cpu-cycles :instructions :cache-references :cache-misses
+      :branch-instructions :branch-misses))
+
+;;; True if threads have samplers of their own. See 'sprof.c'
+(defglobal *thread-samplers* nil)
+
+#+linux
+(progn
+(defun start-thread-samplers (event period threads)
+  (setf (extern-alien "sb_sprof_sampler_period" long) period
+        (extern-alien "sb_sprof_sampler_event" int)
+        (if (eq event :thread-cpu) 0 (1+ (position event *hardware-events*)))
+        *thread-samplers* t)
+  (let ((errno 0))
+    (sb-thread::avltree-filter
+     (lambda (node &aux (thread (sb-thread::avlnode-data node)))
+       (when (or (eq threads :all) (memq thread threads))
+         (sb-thread:with-deathlok (thread c-thread)
+           (unless (= c-thread 0)
+             (let ((result (alien-funcall
+                            (extern-alien "sb_sprof_start_thread_sampler"
+                                          (function int unsigned))
+                            c-thread)))
+               (when (eq thread sb-thread:*current-thread*)
+                 (setq errno result)))))))
+     sb-thread::*all-threads*)
+    (unless (zerop errno)
+      (error "Can't sample on ~S: ~A" event (strerror errno)))))
+
+(defun stop-thread-samplers ()
+  ;; Stop arming new threads first, so that none is missed below
+  (setf (extern-alien "sb_sprof_sampler_event" int) -1
+        *thread-samplers* nil)
+  (sb-thread::avltree-filter
+   (lambda (node &aux (thread (sb-thread::avlnode-data node)))
+     (sb-thread:with-deathlok (thread c-thread)
+       (unless (= c-thread 0)
+         (alien-funcall (extern-alien "sb_sprof_stop_thread_sampler"
+                                      (function void unsigned))
+                        c-thread)))
+     nil)
+   sb-thread::*all-threads*)))
+
 #-win32
 (defun start-profiling (&key (max-samples *max-samples*)
                         (mode *sampling-mode*)
                         (sample-interval *sample-interval*)
                         alloc-interval
                         max-depth
-                        (threads :all))
+                        (threads :all)
+                        event
+                        (event-period 1000000))
   "Start profiling statistically in the current thread if not already profiling.
 The following keyword args are recognized:
 
@@ -126,6 +185,14 @@ The following keyword args are recognized:
      the profiler in allocation profiling mode. If :TIME, run the profiler
      in wallclock profiling mode.
 
+   :ALLOC-INTERVAL <n>
+     In :ALLOC mode, take samples an average of <n> bytes of allocation
+     apart, at random, rather than one sample per allocation region filled.
+     Each sample then stands for <n> bytes, no matter how big the allocated
+     objects are. The object allocated at each sample is followed through
+     garbage collection, so that REPORT-ALLOCATION-SITES can show how much
+     of what was allocated is still live.
+
    :MAX-SAMPLES <max>
      Maximum number of stack traces to collect.  Default is *MAX-SAMPLES*.
 
@@ -139,16 +206,39 @@ The following keyword args are recognized:
      not properly delivered to threads in proportion to their CPU usage
      when doing :CPU profiling. If you see empty call graphs, or are obviously
      missing several samples from certain threads, you may be falling afoul
-     of this."
+     of this.
+
+   :EVENT <event>
+     What triggers samples in :CPU mode. If NIL (the default), a process-wide
+     timer interrupts some thread every SAMPLE-INTERVAL seconds of the CPU
+     time of all threads together. On Linux, each profiled thread can instead
+     have a sampler of its own, which interrupts only that thread:
+     :THREAD-CPU samples every SAMPLE-INTERVAL seconds of the thread's
+     own CPU time, and one of :CPU-CYCLES, :INSTRUCTIONS, :CACHE-REFERENCES,
+     :CACHE-MISSES, :BRANCH-INSTRUCTIONS or :BRANCH-MISSES samples every
+     EVENT-PERIOD occurrences of that hardware event in the thread.
+
+   :EVENT-PERIOD <n>
+     Number of hardware events between samples. Default is 1000000."
   ;; Starting the clock with an interval of zero or negative is meaningless.
   ;; If, by 0, you mean STOP-PROFILING then you should use STOP-PROFILING.
   (declare (type (real (0)) sample-interval))
-  (when alloc-interval (warn "ALLOC-INTERVAL is ignored"))
+  (when alloc-interval
+    (unless (eq mode :alloc)
+      (error ":ALLOC-INTERVAL is only supported in :ALLOC mode"))
+    (check-type alloc-interval (integer 1)))
   (when max-depth (warn "MAX-DEPTH is ignored"))
   #-gencgc
   (when (eq mode :alloc)
     (error "Allocation profiling is only supported for builds using the generational garbage collector."))
   #-sb-thread (unless (eq threads :all) (warn ":THREADS is ignored"))
+  (when event
+    (unless (eq mode :cpu)
+      (error ":EVENT is only supported in :CPU mode"))
+    #-linux (error ":EVENT is only supported on Linux")
+    (unless (or (eq event :thread-cpu) (memq event *hardware-events*))
+      (error "~S is not a known sampling event" event))
+    (check-type event-period (integer 1)))
   (when *profiling*
     (warn "START-PROFILING will STOP-PROFILING first before applying new parameters")
     (stop-profiling))
@@ -160,7 +250,8 @@ The following keyword args are recognized:
   ;; start/stop/start/stop should leave *SAMPLES* holding a union of all
   ;; traces captured by both "on" periods, whereas with a RESET in between
   ;; it would not. But they behave identically, because this is a reset.
-  (setf *samples* (make-samples mode sample-interval))
+  (setf *samples* (make-samples mode sample-interval)
+        (samples-alloc-interval *samples*) alloc-interval)
   (setf trace-limit max-samples trace-count 0)
   (enable-call-counting)
   #+sb-thread (setf sb-thread::*profiled-threads* threads)
@@ -182,12 +273,15 @@ The following keyword args are recognized:
   (setf (extern-alien "sb_sprof_enabled" int) 1)
   (ecase mode
     (:alloc
+     (setf (extern-alien "alloc_sampled_objects_ct" int) 0
+           alloc-sample-bytes (or alloc-interval 0))
      (setq enable-alloc-profiler 1))
     (:cpu
-     (multiple-value-bind (secs usecs)
-         (multiple-value-bind (secs rest) (truncate sample-interval)
-           (values secs (truncate (* rest 1000000))))
-       (unix-setitimer :profile secs usecs secs usecs)))
+     (unless event
+       (multiple-value-bind (secs usecs)
+           (multiple-value-bind (secs rest) (truncate sample-interval)
+             (values secs (truncate (* rest 1000000))))
+         (unix-setitimer :profile secs usecs secs usecs))))
     (:time
      #+sb-thread
      (flet ((map-threads (function &aux (threads sb-thread::*profiled-threads*))
@@ -216,7 +310,15 @@ The following keyword args are recognized:
      (schedule-timer (setf *timer* (make-timer (lambda () (unix-kill 0 sb-unix:sigprof))
                                                :name "SPROF timer"))
                      sample-interval :repeat-interval sample-interval)))
-  (setq *profiling* mode))
+  (setq *profiling* mode)
+  ;; This is done last so that STOP-PROFILING can clean up if it fails
+  #+linux
+  (when event
+    (start-thread-samplers event
+                           (if (eq event :thread-cpu)
+                               (max 1 (round (* sample-interval 1000000000)))
+                               event-period)
+                           threads)))
 
 (defun stop-profiling ()
   "Stop profiling if profiling."
@@ -226,8 +328,9 @@ The following keyword args are recognized:
       ;; undelivered sigprof.
       (ecase profiling
         (:alloc
-         (setq enable-alloc-profiler 0))
+         (setq enable-alloc-profiler 0 alloc-sample-bytes 0))
         (:cpu
+         #+linux (when *thread-samplers* (stop-thread-samplers))
          (unix-setitimer :profile 0 0 0 0))
         (:time
          (let ((timer *timer*))
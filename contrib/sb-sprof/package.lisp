@@ -16,11 +16,14 @@
 
    ;; Reporting
    #:*report-sort-by* #:*report-sort-order*
-   #:report
+   #:report #:report-allocation-sites #:write-pprof
+   #:save-profile #:load-profile
+   #:start-static-relinking #:stop-static-relinking
 
    ;; Interface
    #:*sample-interval* #:*max-samples*
    #:start-profiling #:stop-profiling #:with-profiling
+   #:start-continuous-profiling #:stop-continuous-profiling
    #:reset))
 (eval-when (:compile-toplevel :load-toplevel :execute)
   (setf (sb-int:system-package-p (find-package "SB-SPROF")) t))
@@ -0,0 +1,313 @@
+;;;; Output in the format of pprof, and continuous profiling
+;;;;
+;;;; This software is part of the SBCL system. See the README file for
+;;;; more information.
+
+(in-package #:sb-sprof)
+
+;;; WRITE-PPROF exports a profiling run as a pprof profile, which
+;;; "go tool pprof", Pyroscope, Parca and the like can read.
+;;;
+;;; In continuous mode, the profiler samples at a low rate for as long
+;;; as the program runs. Each thread's trace buffer is bounded (see
+;;; 'sprof.c'), and a background thread drains all of them every so
+;;; often into one profile in the protocol buffer format read by pprof,
+;;; which it hands to a user-supplied function or writes to a file.
+;;; Memory use thus stays constant no matter how long profiling goes on.
+
+;;;; A minimal protocol buffer encoder, enough for profile.proto
+
+(defun make-octet-buffer ()
+  (make-array 256 :element-type '(unsigned-byte 8) :fill-pointer 0 :adjustable t))
+
+(defun pb-varint (buffer n)
+  (let ((n (ldb (byte 64 0) n))) ; negative int64 values take 10 bytes
+    (loop
+      (if (< n #x80)
+          (return (vector-push-extend n buffer))
+          (vector-push-extend (logior #x80 (ldb (byte 7 0) n)) buffer))
+      (setq n (ash n -7)))))
+
+(defun pb-uint (buffer field n)
+  (unless (eql n 0)
+    (pb-varint buffer (ash field 3))
+    (pb-varint buffer n)))
+
+(defun pb-bytes (buffer field octets)
+  (pb-varint buffer (logior (ash field 3) 2))
+  (pb-varint buffer (length octets))
+  (loop for octet across octets do (vector-push-extend octet buffer)))
+
+;;; Encode BODY into a fresh buffer bound to BUFFER, then append that
+;;; to the outer BUFFER as field FIELD
+(defmacro pb-message ((buffer field) &body body)
+  (with-unique-names (outer)
+    `(let* ((,outer ,buffer) (,buffer (make-octet-buffer)))
+       ,@body
+       (pb-bytes ,outer ,field ,buffer))))
+
+(defun pb-packed (buffer field list)
+  (pb-message (buffer field)
+    (dolist (n list) (pb-varint buffer n))))
+
+;;;; Profiles
+
+;;; A Profile message is written out piece by piece: each string, Function
+;;; and Location as it is first needed, and each Sample as soon as it is
+;;; known. Protocol buffers allow the fields of a message in any order,
+;;; so nothing but the tables for de-duplication is kept in memory.
+(defstruct (pprof-writer (:constructor %make-pprof-writer (output period-ns))
+                         (:copier nil) (:predicate nil))
+  ;; a stream, or an adjustable octet vector to append to
+  (output nil :read-only t)
+  (period-ns 0 :read-only t)
+  (strings (make-hash-table :test 'equal) :read-only t)
+  (functions (make-hash-table :test 'equal) :read-only t))
+
+(defun pprof-emit (writer octets)
+  (let ((output (pprof-writer-output writer)))
+    (if (streamp output)
+        (write-sequence octets output)
+        (loop for octet across octets do (vector-push-extend octet output)))))
+
+(defun pprof-string (writer string)
+  (let ((table (pprof-writer-strings writer)))
+    (or (gethash string table)
+        (let ((buffer (make-octet-buffer)))
+          (pb-bytes buffer 6 (string-to-octets string :external-format :utf-8))
+          (pprof-emit writer buffer)
+          (setf (gethash string table) (hash-table-count table))))))
+
+(defun frame-name (info)
+  (let ((name (node-name (make-node info))))
+    (if (stringp name)
+        name
+        (let ((*package* (find-package "KEYWORD"))
+              (*print-pretty* nil))
+          (prin1-to-string name)))))
+
+;;; Every distinct frame name becomes one Function and one Location
+;;; with the same ID.
+(defun pprof-function (writer info)
+  (let ((name (frame-name info))
+        (table (pprof-writer-functions writer)))
+    (or (gethash name table)
+        (let ((id (1+ (hash-table-count table)))
+              (name-index (pprof-string writer name))
+              (buffer (make-octet-buffer)))
+          (pb-message (buffer 5) ; Function
+            (pb-uint buffer 1 id)
+            (pb-uint buffer 2 name-index))
+          (pb-message (buffer 4) ; Location
+            (pb-uint buffer 1 id)
+            (pb-message (buffer 4) ; Line
+              (pb-uint buffer 1 id)))
+          (pprof-emit writer buffer)
+          (setf (gethash name table) id)))))
+
+(defun pprof-value-type (writer field type unit)
+  (let ((type (pprof-string writer type))
+        (unit (pprof-string writer unit))
+        (buffer (make-octet-buffer)))
+    (pb-message (buffer field)
+      (pb-uint buffer 1 type)
+      (pb-uint buffer 2 unit))
+    (pprof-emit writer buffer)))
+
+;;; Start a profile on OUTPUT of samples taken every PERIOD-NS nanoseconds
+;;; of some kind of time (named by CLOCK), or of allocation if CLOCK is NIL.
+(defun start-pprof (output clock period-ns)
+  (let ((writer (%make-pprof-writer output (if clock period-ns 0))))
+    (pprof-string writer "")
+    (pprof-value-type writer 1 "samples" "count")
+    (when clock
+      (pprof-value-type writer 1 clock "nanoseconds")
+      (pprof-value-type writer 11 clock "nanoseconds")
+      (let ((buffer (make-octet-buffer)))
+        (pb-uint buffer 12 period-ns)
+        (pprof-emit writer buffer)))
+    writer))
+
+;;; Write a Sample for a trace as made by EXTRACT-TRACES: a vector with
+;;; the debug-info and PC of each frame, innermost first.
+(defun pprof-sample (writer locs count thread)
+  (let ((ids (loop for i from 0 below (length locs) by 2
+                   collect (pprof-function writer (aref locs i))))
+        (label (when thread
+                 (cons (pprof-string writer "thread")
+                       (pprof-string writer (or (sb-thread:thread-name thread)
+                                                "unnamed")))))
+        (period-ns (pprof-writer-period-ns writer))
+        (buffer (make-octet-buffer)))
+    (pb-message (buffer 2)
+      (pb-packed buffer 1 ids)
+      (pb-packed buffer 2 (if (plusp period-ns)
+                              (list count (* count period-ns))
+                              (list count)))
+      (when label
+        (pb-message (buffer 3)
+          (pb-uint buffer 1 (car label))
+          (pb-uint buffer 2 (cdr label)))))
+    (pprof-emit writer buffer)))
+
+(defun finish-pprof (writer start-ns end-ns)
+  (let ((buffer (make-octet-buffer)))
+    (pb-uint buffer 9 start-ns)
+    (pb-uint buffer 10 (- end-ns start-ns))
+    (pprof-emit writer buffer)))
+
+;;; Call FUNCTION with the traces of each thread's raw sample buffer,
+;;; as a list of (LOCATIONS . COUNT), and the thread. The buffers are freed.
+(defun map-profile-buffers (function)
+  (let ((serialno-to-code (build-serialno-to-code-map)))
+    (call-with-each-profile-buffer
+     (lambda (sap thread memusage)
+       (declare (ignore memusage))
+       (funcall function (extract-traces sap serialno-to-code) thread)))
+    (setf trace-count 0)))
+
+;;;; Exporting a profiling run
+
+(defun write-pprof (destination &key (samples *samples*))
+  "Write the samples of the last profiling run to DESTINATION, a binary
+stream or a pathname designator, as a profile in the protocol buffer
+format read by pprof and tools built on it. Samples are labeled with
+the name of their thread.
+
+Unless REPORT has been called since the samples were taken, they are
+written straight from each thread's sample buffer, without building a
+call graph, and the buffers are freed. A later REPORT then finds no
+samples."
+  (stop-profiling)
+  (unless samples
+    (error "No samples to write"))
+  (flet ((write-to (stream)
+           (let ((writer (start-pprof stream
+                                      (case (samples-mode samples)
+                                        (:cpu "cpu")
+                                        (:time "wall"))
+                                      (round (* (samples-sample-interval samples)
+                                                1000000000)))))
+             (if (zerop (samples-index samples))
+                 (progn
+                   (map-profile-buffers
+                    (lambda (traces thread)
+                      (loop for (locs . count) in traces
+                            do (pprof-sample writer locs count thread))))
+                   (setf (extern-alien "sb_sprof_enabled" int) 0))
+                 (map-traces (lambda (thread trace)
+                               (destructuring-bind (vector start end) trace
+                                 (pprof-sample writer (subseq vector (+ start +elements-per-trace-start+) end)
+                                               1 thread)))
+                             samples)))))
+    (if (streamp destination)
+        (write-to destination)
+        (with-open-file (stream destination :direction :output
+                                            :element-type '(unsigned-byte 8)
+                                            :if-exists :supersede)
+          (write-to stream))))
+  (values))
+
+(defun unix-time-ns ()
+  (multiple-value-bind (sec usec) (get-time-of-day)
+    (+ (* sec 1000000000) (* usec 1000))))
+
+;;;; Continuous profiling
+
+;;; (SEMAPHORE THREAD SAVED-CAPACITY-MAX) while continuous profiling is on
+(defglobal *continuous-profiler* nil)
+
+(defun profile-file-writer (directory)
+  (lambda (octets)
+    (with-open-file (stream (merge-pathnames
+                             (format nil "sbcl-~D-~D.pb" (unix-getpid)
+                                     (floor (unix-time-ns) 1000000000))
+                             directory)
+                            :direction :output :element-type '(unsigned-byte 8)
+                            :if-exists :supersede)
+      (write-sequence octets stream))))
+
+#-win32
+(defun start-continuous-profiling (&key (frequency 19)
+                                        (interval 60)
+                                        (output *default-pathname-defaults*)
+                                        (max-buffer-bytes (* 1024 1024))
+                                        (threads :all)
+                                        event)
+  "Start sampling at a low rate indefinitely, and turn the samples into a
+profile in the format of pprof every INTERVAL seconds.
+
+   :FREQUENCY <n>
+     Samples per second of CPU time. Default is 19.
+
+   :INTERVAL <n>
+     Seconds between profiles. Default is 60.
+
+   :OUTPUT <output>
+     A function of one argument, which is called with each profile as
+     a vector of (UNSIGNED-BYTE 8), or a pathname designator for a directory
+     in which each profile is written to a file named sbcl-<pid>-<time>.pb.
+     Default is *DEFAULT-PATHNAME-DEFAULTS*.
+
+   :MAX-BUFFER-BYTES <n>
+     Largest size of each thread's trace buffer. Once a buffer is full,
+     samples with traces not yet in it are dropped until the next profile.
+     Default is one megabyte.
+
+   :THREADS <list>
+   :EVENT <event>
+     As for START-PROFILING.
+
+Code which is garbage collected between being sampled and being written
+out is shown as \"Unknown fn\". Stop with STOP-CONTINUOUS-PROFILING."
+  (declare (type (real (0)) frequency interval))
+  #-sb-thread (error "Continuous profiling requires thread support")
+  (when *continuous-profiler*
+    (stop-continuous-profiling))
+  (let ((period-ns (round 1000000000 frequency))
+        (output (if (functionp output) output (profile-file-writer output)))
+        (semaphore (sb-thread:make-semaphore))
+        (saved-capacity-max (extern-alien "sb_sprof_capacity_max" (unsigned 32))))
+    (setf (extern-alien "sb_sprof_capacity_max" (unsigned 32))
+          (max 1024 (floor max-buffer-bytes element-size))
+          (extern-alien "sb_sprof_bounded" int) 1)
+    (start-profiling :mode :cpu :sample-interval (/ frequency)
+                     :max-samples (1- (ash 1 31)) :threads threads
+                     :event event)
+    ;; Don't keep all code alive for weeks on end
+    (setf (extern-alien "sb_sprof_enabled" int) 0)
+    (setq *continuous-profiler*
+          (list semaphore
+                (sb-thread:make-thread
+                 (lambda ()
+                   (stop-sampling)
+                   (loop for start = (unix-time-ns) then end
+                         for done = (sb-thread:wait-on-semaphore semaphore
+                                                                 :timeout interval)
+                         for end = (unix-time-ns)
+                         do (let* ((octets (make-octet-buffer))
+                                   (writer (start-pprof octets "cpu" period-ns)))
+                              (map-profile-buffers
+                               (lambda (traces thread)
+                                 (loop for (locs . count) in traces
+                                       do (pprof-sample writer locs count thread))))
+                              (finish-pprof writer start end)
+                              (funcall output (coerce octets '(simple-array (unsigned-byte 8) (*)))))
+                         until done))
+                 :name "continuous profiler")
+                saved-capacity-max))
+    (values)))
+
+(defun stop-continuous-profiling ()
+  "Stop continuous profiling, after writing a last profile of the samples
+taken since the previous one."
+  (let ((profiler *continuous-profiler*))
+    (when profiler
+      (destructuring-bind (semaphore thread saved-capacity-max) profiler
+        (setq *continuous-profiler* nil)
+        (stop-profiling)
+        (sb-thread:signal-semaphore semaphore)
+        (sb-thread:join-thread thread :default nil)
+        (setf (extern-alien "sb_sprof_bounded" int) 0
+              (extern-alien "sb_sprof_capacity_max" (unsigned 32)) saved-capacity-max))))
+  (values))
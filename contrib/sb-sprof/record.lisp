@@ -24,6 +24,12 @@
   (trace-count     0                    :type sb-int:index)
   (unique-trace-count nil)
   (sampled-threads nil                  :type list)
+  ;; In :ALLOC mode, the mean number of bytes between samples, or NIL if
+  ;; every refill of an allocation region was sampled
+  (alloc-interval  nil                  :type (or null (integer 1)))
+  ;; With an ALLOC-INTERVAL, a list of (trace . n-samples) for the sampled
+  ;; objects that were still alive after a GC
+  (live-traces     nil                  :type list)
   ;; Metadata
   (mode            nil                  :type sampling-mode              :read-only t)
   (sample-interval (sb-int:missing-arg) :type (real (0))                 :read-only t))
@@ -31,6 +37,8 @@
 (defun samples-index (x) (length (samples-vector x)))
 
 (define-alien-variable ("gencgc_alloc_profiler" enable-alloc-profiler) (signed 32))
+(define-alien-variable ("gencgc_alloc_sample_bytes" alloc-sample-bytes)
+    (unsigned #.sb-vm:n-word-bits))
 (define-alien-variable ("sb_sprof_trace_ct" trace-count) (signed 32))
 (define-alien-variable ("sb_sprof_trace_ct_max" trace-limit) (signed 32))
 
@@ -224,6 +232,24 @@ EXPERIMENTAL: Interface subject to change."
 (defun trace-len (trace)
   #+64-bit (logand (sap-ref-64 trace 8) #xffffffff)
   #-64-bit (sap-ref-32 trace 8))
+(defun trace-hash (trace)
+  #+64-bit (ash (sap-ref-64 trace 8) -32)
+  #-64-bit (sap-ref-32 trace 12))
+
+;;; Return a hash-table of trace hash -> number of samples, for the sampled
+;;; allocations which survived at least one GC. The C side keeps an array of
+;;; struct alloc_sampled_object { base, trace_hash, weight, n_gcs }.
+(defconstant alloc-sampled-object-size (+ sb-vm:n-word-bytes 8))
+(defun alloc-live-weights ()
+  (let ((weights (make-hash-table)))
+    ;; GC rewrites the array
+    (without-gcing
+      (let ((objects (foreign-symbol-sap "alloc_sampled_objects" t)))
+        (dotimes (i (extern-alien "alloc_sampled_objects_ct" int) weights)
+          (let ((object (sap+ objects (* i alloc-sampled-object-size))))
+            (when (plusp (sap-ref-16 object (+ sb-vm:n-word-bytes 6)))
+              (incf (gethash (sap-ref-32 object sb-vm:n-word-bytes) weights 0)
+                    (sap-ref-16 object (+ sb-vm:n-word-bytes 4))))))))))
 
 ;;; Pseudo-functions for marking questionable parts of the stack trace
 (defun unavailable-frames ())
@@ -245,7 +271,10 @@ EXPERIMENTAL: Interface subject to change."
            (setf (gethash serial ht) x)))))
     ht))
 
-(defun extract-traces (sap serialno-to-code)
+;;; Return a list of (trace . multiplicity) for the traces in SAP.
+;;; If LIVE-WEIGHTS is supplied, also return a list of (trace . n-samples)
+;;; for the traces having an entry in it, removing the entries.
+(defun extract-traces (sap serialno-to-code &optional live-weights)
   (macrolet ((absolute-pc (pc)
                ;; Foreign function or immovable code
                `(let ((sap (int-sap ,pc)))
@@ -278,18 +307,17 @@ EXPERIMENTAL: Interface subject to change."
                   (debug-info (sb-kernel:code-instructions code) code))))
     (do ((free-ptr (nth-value 1 (sprof-data-header sap)))
          (trace-ptr 2)
-         (result))
+         (result)
+         (live))
         ((>= trace-ptr free-ptr)
          (aver (= trace-ptr free-ptr))
-         result)
+         (values result live))
       (let* ((trace (sprof-data-trace sap trace-ptr))
              (len (trace-len trace))
              ;; byte offset into the trace at which the locs[] array begins
              (element-offset 16)
              (locs))
-        (dotimes (i len (push (cons (nreverse (coerce locs 'vector))
-                                    (trace-multiplicity trace))
-                              result))
+        (dotimes (i len)
           (multiple-value-bind (info pc-or-offset)
               #-64-bit
               (let ((word0 (sap-ref-word trace element-offset))
@@ -305,6 +333,14 @@ EXPERIMENTAL: Interface subject to change."
                       (t (absolute-pc bits))))
           (setf locs (list* pc-or-offset info locs))
           (incf element-offset element-size)))
+        (let ((locs (nreverse (coerce locs 'vector)))
+              (hash (trace-hash trace)))
+          (push (cons locs (trace-multiplicity trace)) result)
+          ;; Identical traces from several threads have the same hash,
+          ;; so only the first one takes the live samples.
+          (awhen (and live-weights (gethash hash live-weights))
+            (remhash hash live-weights)
+            (push (cons locs it) live)))
         (incf trace-ptr (+ 2 len))))))
 
 ;;; Call FUNCTION with each thread's sampled data, and deallocate the data.
@@ -352,20 +388,23 @@ EXPERIMENTAL: Interface subject to change."
            nil)
          all-threads)))))
 
-(defun convert-raw-data ()
+(defun convert-raw-data (&optional live-weights)
   (let ((ht (build-serialno-to-code-map))
         (threads)
         ;; traces are not de-deduplicated across threads,
         ;; so this number is only approximate.
         (n-unique-traces 0)
-        (aggregate-data))
+        (aggregate-data)
+        (live-traces))
     ;; Mask SIGPROF in this thread in case of pending signal
     ;; and funky scheduling by the OS.
     (let ((saved-sigprof-mask (sb-toggle-sigprof (int-sap 0) 1)))
       (call-with-each-profile-buffer
        (lambda (sap thread memusage)
          (push (cons thread memusage) threads)
-         (push (cons (extract-traces sap ht) thread) aggregate-data)))
+         (multiple-value-bind (traces live) (extract-traces sap ht live-weights)
+           (push (cons traces thread) aggregate-data)
+           (setf live-traces (nconc live live-traces)))))
       (setf (extern-alien "sb_sprof_enabled" int) 0)
       (sb-toggle-sigprof (int-sap 0) saved-sigprof-mask))
     ;; Precompute the length of the new SAMPLES-VECTOR
@@ -392,7 +431,7 @@ EXPERIMENTAL: Interface subject to change."
                      (replace vector trace :start1 (+ index 2))
                      (setq index end)))))
       (aver (= index (length vector)))
-      (values vector n-unique-traces threads))))
+      (values vector n-unique-traces threads live-traces))))
 
 #+nil
 (defun dump-hash-buckets (sap-or-thread)
@@ -36,23 +36,34 @@
         (interval (call-graph-sample-interval call-graph))
         (ncycles (loop for v in (graph-vertices call-graph)
                     count (scc-p v))))
-    (if (eq (call-graph-sampling-mode call-graph) :alloc)
-        (format t "~2&Number of samples:     ~d~%~
-                      Unique traces:         ~d~%~
-                      Alloc interval:        ~a regions (approximately ~a kB)~%~
-                      Total sampling amount: ~a regions (approximately ~a kB)"
-                nsamples
-                (call-graph-unique-trace-count call-graph)
-                interval
-                (truncate (* interval +alloc-region-size+) 1024)
-                (* nsamples interval)
-                (truncate (* nsamples interval +alloc-region-size+) 1024))
-        (format t "~2&Number of samples:   ~d~%~
-                      Sample interval:     ~f seconds~%~
-                      Total sampling time: ~f seconds"
-                nsamples
-                interval
-                (* nsamples interval)))
+    (cond
+      ((call-graph-alloc-interval-p call-graph)
+       (format t "~2&Number of samples:     ~d~%~
+                     Unique traces:         ~d~%~
+                     Alloc interval:        ~d bytes on average~%~
+                     Total sampling amount: approximately ~d kB"
+               nsamples
+               (call-graph-unique-trace-count call-graph)
+               interval
+               (truncate (* nsamples interval) 1024)))
+      ((eq (call-graph-sampling-mode call-graph) :alloc)
+       (format t "~2&Number of samples:     ~d~%~
+                     Unique traces:         ~d~%~
+                     Alloc interval:        ~a regions (approximately ~a kB)~%~
+                     Total sampling amount: ~a regions (approximately ~a kB)"
+               nsamples
+               (call-graph-unique-trace-count call-graph)
+               interval
+               (truncate (* interval +alloc-region-size+) 1024)
+               (* nsamples interval)
+               (truncate (* nsamples interval +alloc-region-size+) 1024)))
+      (t
+       (format t "~2&Number of samples:   ~d~%~
+                     Sample interval:     ~f seconds~%~
+                     Total sampling time: ~f seconds"
+               nsamples
+               interval
+               (* nsamples interval))))
     (format t "~%Graph cycles:        ~d~%~
                Sampled threads:~%" ncycles)
     (loop for (thread bytes-used bytes-reserved buckets-used)
@@ -273,3 +284,151 @@ Profiling is stopped before the call graph is generated."
          (t
           (format stream "~&; No samples to report.~%")
           nil)))
+
+(defun save-profile (pathname &key (samples *samples*) call-graph)
+  "Write the number of samples that each global function took in the
+latest profiling results, or in CALL-GRAPH, to the file named by
+PATHNAME, for LOAD-PROFILE to read back, possibly in another image."
+  (let ((graph (or call-graph
+                   (and samples (make-call-graph samples most-positive-fixnum)))))
+    (unless graph
+      (error "No samples to save."))
+    (with-open-file (stream pathname :direction :output :if-exists :supersede)
+      (with-standard-io-syntax
+        (let ((*package* (find-package "KEYWORD")))
+          (prin1 (list :samples (call-graph-nsamples graph)
+                       :functions
+                       (loop for node in (graph-vertices graph)
+                             for name = (node-name node)
+                             when (and (plusp (node-count node))
+                                       (sb-int:legal-fun-name-p name))
+                             collect (cons name (node-count node))))
+                 stream)
+          (terpri stream))))
+    pathname))
+
+(defun load-profile (pathname &key (min-percent 1))
+  "Read a profile written by SAVE-PROFILE from the file named by PATHNAME,
+and make the functions that took at least MIN-PERCENT of its samples hot
+for the compiler: calls from them to functions that have inline
+expansions, such as those declared MAYBE-INLINE, are inlined unless the
+SPACE policy is 2 or more, and SAVE-LISP-AND-DIE places their code first
+in immobile space. Returns a hash table from the names of the hot
+functions to their share of the samples. A MIN-PERCENT of NIL makes no
+function hot."
+  (let ((profile (with-open-file (stream pathname)
+                   (with-standard-io-syntax
+                     (let ((*read-eval* nil))
+                       (read stream)))))
+        (hot (make-hash-table :test 'equal)))
+    (destructuring-bind (&key samples functions) profile
+      (when (and min-percent (typep samples '(integer 1)))
+        (loop for (name . count) in functions
+              for share = (/ count samples)
+              when (>= (* 100 share) min-percent)
+              do (setf (gethash name hot) share))))
+    (setf sb-c::*hot-functions* (and (plusp (hash-table-count hot)) hot))
+    hot))
+
+;;;; Static relinking
+
+;;; (SEMAPHORE THREAD) while static relinking is on
+(defglobal *static-relinker* nil)
+
+(defun start-static-relinking (&key (interval 60) (quiet-period 600))
+  "Every INTERVAL seconds, statically link the calls through fdefns from
+the hot functions of the profile loaded by LOAD-PROFILE, so that they
+jump straight to the functions they call. Redefining a function still
+unlinks the calls to it, and calls to a function that was redefined less
+than QUIET-PERIOD seconds ago are left alone, so that a function being
+worked on isn't relinked over and over. Does nothing on platforms that
+don't place code in immobile space. Stop with STOP-STATIC-RELINKING."
+  (declare (type (real (0)) interval) (type (real 0) quiet-period)
+           (ignorable interval quiet-period))
+  #-sb-thread (error "Static relinking requires thread support")
+  #+immobile-code
+  (let ((semaphore (sb-thread:make-semaphore)))
+    (when *static-relinker*
+      (stop-static-relinking))
+    (setq *static-relinker*
+          (list semaphore
+                (sb-thread:make-thread
+                 (lambda ()
+                   (loop
+                     (let ((hot sb-c::*hot-functions*))
+                       (when hot
+                         (sb-vm::statically-link-core
+                          :callers (loop for name being each hash-key of hot
+                                         collect name)
+                          :quiet-period quiet-period)))
+                     (when (sb-thread:wait-on-semaphore semaphore :timeout interval)
+                       (return))))
+                 :name "static relinker"))))
+  (values))
+
+(defun stop-static-relinking ()
+  "Stop the relinking started by START-STATIC-RELINKING. Calls that were
+statically linked stay so until the functions they call are redefined."
+  (let ((relinker *static-relinker*))
+    (when relinker
+      (destructuring-bind (semaphore thread) relinker
+        (setq *static-relinker* nil)
+        (sb-thread:signal-semaphore semaphore)
+        (sb-thread:join-thread thread :default nil))))
+  (values))
+
+;;; The innermost frames of an allocation trace are in the allocator itself,
+;;; so the allocation site is the first frame in Lisp code. The (info pc)
+;;; pairs of the trace are the elements of VECTOR from START below END.
+(defun allocation-site-name (vector start end)
+  (loop for i from start below end by +elements-per-pc-loc+
+        for info = (aref vector i)
+        when (typep info '(or sb-di::debug-fun sb-kernel:code-component))
+        return (node-name (make-node info))
+        finally (return "elsewhere")))
+
+(defun report-allocation-sites (&key (samples *samples*) max
+                                     (stream *standard-output*))
+  "Report the result of allocation profiling with an :ALLOC-INTERVAL by
+allocation site, that is, by the function which did the allocating. For each
+site, show the number of samples and the approximate number of bytes they
+stand for, and the same for the sampled objects which were still alive after
+the most recent garbage collection. Show no more than MAX sites if MAX is
+given. Return a list of (site n-samples n-live-samples), heaviest first."
+  (unless (and samples (samples-alloc-interval samples))
+    (format stream "~&; No allocation samples to report.~%")
+    (return-from report-allocation-sites nil))
+  (aggregate-samples samples)
+  (let ((interval (samples-alloc-interval samples))
+        (sites (make-hash-table :test 'equal))
+        (*standard-output* stream)
+        (*print-pretty* nil))
+    (flet ((site (name)
+             (or (gethash name sites)
+                 (setf (gethash name sites) (list name 0 0)))))
+      (map-traces (lambda (thread trace)
+                    (declare (ignore thread))
+                    (destructuring-bind (vector start end) trace
+                      (incf (second (site (allocation-site-name
+                                           vector
+                                           (+ start +elements-per-trace-start+)
+                                           end))))))
+                  samples)
+      (loop for (locs . n-samples) in (samples-live-traces samples)
+            do (incf (third (site (allocation-site-name locs 0 (length locs))))
+                     n-samples)))
+    (let ((sites (sort (loop for site being each hash-value of sites collect site)
+                       #'> :key #'second)))
+      (format t "~&Alloc interval: ~d bytes on average~%~
+                 Samples  Allocated kB  Live samples   Live kB  Site~%"
+              interval)
+      (print-separator)
+      (loop for (name n-samples n-live) in sites
+            for i from 1
+            until (and max (> i max))
+            do (format t "~&~7d ~13d ~13d ~9d  ~:[~s~;~a~]~%"
+                       n-samples (truncate (* n-samples interval) 1024)
+                       n-live (truncate (* n-live interval) 1024)
+                       (stringp name) name))
+      (print-separator)
+      sites)))
@@ -74,6 +74,28 @@
   (delete-file *compiler-output*)
   (let ((*standard-output* (make-broadcast-stream)))
     (test)
+    ;; A profile reads back as what the call graph says, and makes
+    ;; the compiler consult it until it is loaded with no hot functions.
+    (let ((pathname "./sprof-test.prof")
+          (graph (report :type nil)))
+      (when graph
+        (save-profile pathname :call-graph graph)
+        (let ((hot (load-profile pathname :min-percent 0)))
+          (assert (eq sb-c::*hot-functions* (and (plusp (hash-table-count hot)) hot)))
+          (loop for node in (sb-sprof::graph-vertices graph)
+                for name = (sb-sprof::node-name node)
+                when (and (plusp (sb-sprof::node-count node))
+                          (sb-int:legal-fun-name-p name))
+                do (assert (gethash name hot))))
+        (load-profile pathname :min-percent nil)
+        (assert (null sb-c::*hot-functions*))
+        (delete-file pathname)))
+    #+sb-thread
+    (progn
+      (start-static-relinking :interval 0.01)
+      (sleep 0.05)
+      (stop-static-relinking)
+      (assert (null sb-sprof::*static-relinker*)))
     (consing-test)
     ;; This test shows that STOP-SAMPLING and START-SAMPLING on a thread do something.
     ;; Based on rev b6bf65d9 it would seem that the API got broken a little.
@@ -377,7 +377,6 @@ Please check that all strings which were not recognizable to the compiler
   (sb-c::repack-xref :verbose 1))
 (fmakunbound 'sb-c::repack-xref)
 
-(load (merge-pathnames "src/code/shaketree" *load-pathname*))
 (defun asm-inst-p (symbol)
     ;; Assembler instruction names can't be made external because to do so would
     ;; conflict with common-lisp symbols. Notable examples are PUSH and POP.
@@ -462,7 +461,6 @@ Please check that all strings which were not recognizable to the compiler
                (sb-int:symbol-fdefn symbol)
                (and (boundp symbol) (not (keywordp symbol))))))))
    :verbose nil :print nil)
-  (unintern 'sb-impl::shake-packages 'sb-impl)
   (let ((sum-delta-ext 0)
         (sum-delta-int 0))
     (format t "~&~26TExternal   |    Internal~%")
@@ -67,16 +67,13 @@
   ;; but 'vector' is pinned because it's in a register, so this is ok.
   (inst lea start (ea (- (ash vector-data-offset word-shift) other-pointer-lowtag)
                       vector start (ash 1 (- word-shift n-fixnum-tag-bits))))
+  ;; REP STOS is only preferable if the cpu has enhanced REP MOVSB/STOSB.
+  (test-cpu-feature cpu-has-erms)
+  (inst jmp :z unroll)
   ;; REP STOS has a fixed cost that makes it suboptimal below
   ;; a certain fairly high threshold - about 350 objects in my testing.
   (inst cmp count (fixnumize 350))
-
-  ;; *** tune_asm_routines_for_microarch() will replace this unconditional
-  ;;     "JMP UNROLL" with "JL UNROLL" after the core file is parsed,
-  ;;     if STOS is deemed to be preferable on this cpu.
-  ;;     Otherwise we'll always jump over the REP STOS instruction.
-  ;;     The preceding CMP is pointless in that case, but harmless.
-  (inst jmp unroll)
+  (inst jmp :l unroll)
 
   (inst shr count n-fixnum-tag-bits)
   (inst rep)
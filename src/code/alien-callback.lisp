@@ -339,3 +339,20 @@ function value."
     #-pauseless-threadstart
     (dx-let ((args (list index return arguments)))
       (run thread nil #'sb-alien::enter-alien-callback args))))
+
+;;; When keep_foreign_threads_attached is set in the runtime, a foreign
+;;; thread gets its FOREIGN-THREAD from ATTACH-FOREIGN-THREAD before its
+;;; first callback, and then enters ENTER-ALIEN-CALLBACK directly, as a
+;;; Lisp thread would. DETACH-FOREIGN-THREAD is called as the thread exits.
+#+(and sb-thread (not sb-safepoint))
+(progn
+(defun attach-foreign-thread ()
+  (let ((thread (init-thread-local-storage (make-foreign-thread t))))
+    (copy-primitive-thread-fields thread)
+    (set-thread-control-stack-slots thread)
+    (update-all-threads (thread-primitive-thread thread) thread))
+  0)
+
+(defun detach-foreign-thread ()
+  (handle-thread-exit)
+  0))
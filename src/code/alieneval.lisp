@@ -1151,7 +1151,11 @@
   ;; as indicative of "..." in the C prototype. We can record that too.
   (varargs nil :type (or boolean fixnum (eql :unspecified)))
   (stub nil :type (or null function))
-  (convention nil :type calling-convention))
+  (convention nil :type calling-convention)
+  ;; True if the function was declared :LEAF, a promise that it neither
+  ;; blocks nor calls back into Lisp, so that it can be called without
+  ;; telling GC that the thread is in foreign code.
+  (leaf nil :type boolean))
 ;;; The safe default is to assume that everything is varargs.
 ;;; On x86-64 we have to emit a spurious instruction because of it.
 ;;; So until all users fix their lambda lists to be explicit about &REST
@@ -1166,15 +1170,27 @@
 ;;; starting with a convention keyword; its second item is a real
 ;;; result-type in this case. If convention is ever to become a part
 ;;; of result-type, such a syntax can be retained.
-
+;;;
+;;; :LEAF may appear among the leading keywords too, as in
+;;; (FUNCTION (:LEAF INT) INT).
 
 (define-alien-type-translator function (result-type &rest arg-types
                                                     &environment env)
-  (binding* (((bare-result-type calling-convention)
-              (typecase result-type
-                ((cons calling-convention *)
-                 (values (second result-type) (first result-type)))
-                (t result-type)))
+  (binding* ((options (and (consp result-type)
+                           (loop for option in result-type
+                                 while (keywordp option)
+                                 collect option)))
+             ((bare-result-type calling-convention leafp)
+              (if options
+                  (destructuring-bind (bare-result-type)
+                      (nthcdr (length options) result-type)
+                    (let ((conventions (remove :leaf options)))
+                      (unless (and (<= (length conventions) 1)
+                                   (typep (first conventions) 'calling-convention))
+                        (error "bad options in function result type: ~S" options))
+                      (values bare-result-type (first conventions)
+                              (and (member :leaf options) t))))
+                  result-type))
              (varargs (or (eq (car (last arg-types)) '&rest)
                           (position '&optional arg-types)))
              (arg-types (if (integerp varargs)
@@ -1182,6 +1198,7 @@
                             arg-types)))
     (make-alien-fun-type
      :convention calling-convention
+     :leaf leafp
      :result-type (let ((*values-type-okay* t))
                     (parse-alien-type bare-result-type env))
      :varargs (or varargs *alien-fun-type-varargs-default*)
@@ -1194,8 +1211,10 @@
 (define-alien-type-method (fun :unparse) (type)
   `(function ,(let ((result-type
                      (%unparse-alien-type (alien-fun-type-result-type type)))
-                    (convention (alien-fun-type-convention type)))
-                (if convention (list convention result-type)
+                    (options
+                      (append (ensure-list (alien-fun-type-convention type))
+                              (when (alien-fun-type-leaf type) '(:leaf)))))
+                (if options (append options (list result-type))
                     result-type))
              ,@(mapcar #'%unparse-alien-type
                        (alien-fun-type-arg-types type))
@@ -1207,6 +1226,8 @@
                      (alien-fun-type-result-type type2))
        (eq (alien-fun-type-convention type1)
            (alien-fun-type-convention type2))
+       (eq (alien-fun-type-leaf type1)
+           (alien-fun-type-leaf type2))
        (= (length (alien-fun-type-arg-types type1))
           (length (alien-fun-type-arg-types type2)))
        (every #'alien-type-=
@@ -94,14 +94,27 @@
 (define-alien-routine "find_preceding_object" long (where long))
 
 ;;; Lazily created freelist, used only when unallocate is called:
-;;; A cons whose car is a sorted list of hole sizes available
-;;; and whose cdr is a hashtable.
-;;; The keys in the hashtable are hole sizes, values are lists of holes.
-;;; A better structure would be just a sorted array of sizes
-;;; with each entry pointing to the holes which are threaded through
-;;; some bytes in the storage itself rather than through cons cells.
+;;; A cons whose car is a vector of buckets, each a list of holes,
+;;; and whose cdr is a bit-vector with a 1 for each nonempty bucket.
+;;; Holes smaller than +N-EXACT-HOLE-BUCKETS+ doublewords have one bucket
+;;; per size. Larger holes are bucketed by power of 2, so each of those
+;;; buckets holds dissimilar sizes, but all exceeding the sizes in
+;;; the buckets below it. Finding the smallest sufficient bucket is then
+;;; a search for a 1 bit instead of a walk over all of the sizes.
 (define-load-time-global *immobile-freelist* nil)
 
+(defconstant +n-exact-hole-buckets+ 256)
+(defconstant +n-hole-buckets+ (+ +n-exact-hole-buckets+ (- n-word-bits 8)))
+
+(declaim (inline hole-bucket))
+(defun hole-bucket (size) ; SIZE is in bytes
+  (declare (type (and fixnum unsigned-byte) size))
+  (let ((doublewords (ash size (- (1+ word-shift)))))
+    (if (< doublewords +n-exact-hole-buckets+)
+        doublewords
+        (+ +n-exact-hole-buckets+
+           (- (integer-length doublewords) (integer-length +n-exact-hole-buckets+))))))
+
 ;;; Return the zero-based index within the varyobj subspace of immobile space.
 (defun varyobj-page-index (address)
   (declare (type (and fixnum unsigned-byte) address))
@@ -155,60 +168,50 @@
 (defun hole-end-address (hole-address)
   (+ hole-address (hole-size hole-address)))
 
-(defun sorted-list-insert (item list key-fn)
-  (declare (function key-fn))
-  (let ((key (funcall key-fn item)) (tail list) prev)
-    (loop
-     (when (null tail)
-       (let ((new-tail (list item)))
-         (return (cond ((not prev) new-tail)
-                       (t (setf (cdr prev) new-tail) list)))))
-     (let ((head (car tail)))
-       (when (< key (funcall key-fn head))
-         (rplaca tail item)
-         (rplacd tail (cons head (cdr tail)))
-         (return list)))
-     (setq prev tail tail (cdr tail)))))
-
-;;; These routines are not terribly efficient, but very straightforward
-;;; since we can assume the existence of hashtables.
+;;; The freelist is only touched with *ALLOCATOR-MUTEX* held.
+(defmacro freelist-buckets (freelist) `(truly-the simple-vector (car ,freelist)))
+(defmacro freelist-nonempty (freelist) `(truly-the simple-bit-vector (cdr ,freelist)))
+
 (defun add-to-freelist (hole)
-  (let* ((size (hole-size hole))
-         (freelist *immobile-freelist*)
-         (table (cdr freelist))
-         (old (gethash (hole-size hole) table)))
+  (let* ((freelist *immobile-freelist*)
+         (bucket (hole-bucket (hole-size hole))))
     ;; Check for double-free error
-    #+immobile-space-debug (aver (not (member hole (gethash size table))))
-    (unless old
-      (setf (car freelist)
-            (sorted-list-insert size (car freelist) #'identity)))
-    (setf (gethash size table) (cons hole old))))
+    #+immobile-space-debug
+    (aver (not (member hole (svref (freelist-buckets freelist) bucket))))
+    (push hole (svref (freelist-buckets freelist) bucket))
+    (setf (sbit (freelist-nonempty freelist) bucket) 1)))
 
 (defun remove-from-freelist (hole)
-  (let* ((key (hole-size hole))
-         (freelist *immobile-freelist*)
-         (table (cdr freelist))
-         (list (gethash key table))
+  (let* ((freelist *immobile-freelist*)
+         (bucket (hole-bucket (hole-size hole)))
+         (list (svref (freelist-buckets freelist) bucket))
          (old-length (length list))
          (new (delete hole list :count 1)))
     (declare (ignorable old-length))
     #+immobile-space-debug (aver (= (length new) (1- old-length)))
-    (cond (new
-           (setf (gethash key table) new))
-          (t
-           (setf (car freelist) (delete key (car freelist) :count 1))
-           (remhash key table)))))
+    (setf (svref (freelist-buckets freelist) bucket) new)
+    (unless new
+      (setf (sbit (freelist-nonempty freelist) bucket) 0))))
 
 (defun find-in-freelist (size test)
+  (declare (type (and fixnum unsigned-byte) size))
   (let* ((freelist *immobile-freelist*)
-         (hole-size
-          (if (eq test '<=)
-              (let ((sizes (member size (car freelist) :test '<=)))
-                (unless sizes
-                  (return-from find-in-freelist nil))
-                (car sizes))
-              size))
-         (found (car (gethash hole-size (cdr freelist)))))
+         (buckets (freelist-buckets freelist))
+         (bucket (hole-bucket size))
+         (found
+          (flet ((first-hole-above (bucket)
+                   (let ((index (position 1 (freelist-nonempty freelist)
+                                          :start bucket)))
+                     (when index (car (svref buckets index))))))
+            (cond ((< bucket +n-exact-hole-buckets+)
+                   ;; All holes in the bucket are exactly SIZE
+                   (if (eq test '=)
+                       (car (svref buckets bucket))
+                       (first-hole-above bucket)))
+                  ((find size (svref buckets bucket)
+                         :test (if (eq test '<=) #'<= #'=) :key #'hole-size))
+                  ((and (eq test '<=) (< (1+ bucket) +n-hole-buckets+))
+                   (first-hole-above (1+ bucket)))))))
     (when found
       (remove-from-freelist found))
     found))
@@ -272,7 +275,9 @@
                     0))))) ; Page becomes empty
 
     (unless *immobile-freelist*
-      (setf *immobile-freelist* (cons nil (make-hash-table :test #'eq))))
+      (setf *immobile-freelist*
+            (cons (make-array +n-hole-buckets+ :initial-element nil)
+                  (make-array +n-hole-buckets+ :element-type 'bit :initial-element 0))))
 
     ;; find-preceding is the most expensive operation in this sequence
     ;; of steps. Not sure how to improve it, but I doubt it's a problem.
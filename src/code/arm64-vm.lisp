@@ -124,6 +124,13 @@
     (value unsigned)
     (index unsigned))
 
+  (define-alien-routine jit-copy-code-constants
+    void
+    (code unsigned)
+    (values unsigned)
+    (index unsigned)
+    (n unsigned))
+
   (define-alien-routine jit-patch-int
     void
     (address unsigned)
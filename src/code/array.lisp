@@ -1671,7 +1671,13 @@ function to be removed without further warning."
 ;;; technique might be to enforce an invariant that the last word contain 0
 ;;; in all unused bits so that EQUAL and SXHASH become far simpler.
 
-(macrolet ((def-bit-array-op (name function)
+;;; Operations on simple bit vectors of at least this many words call out
+;;; to %BIT-VECTOR-OP instead of the word loop that they transform to.
+#+(and (or x86-64 arm64) (not cheneygc))
+(defconstant min-words-bit-vector-op-c-call-threshold 64)
+
+(macrolet ((def-bit-array-op (name function op)
+  (declare (ignorable op))
   `(defun ,name (bit-array-1 bit-array-2 &optional result-bit-array)
      ,(format nil
               "Perform a bit-wise ~A on the elements of BIT-ARRAY-1 and ~
@@ -1685,12 +1691,21 @@ function to be removed without further warning."
      (unless (bit-array-same-dimensions-p bit-array-1 bit-array-2)
        (error "~S and ~S don't have the same dimensions."
               bit-array-1 bit-array-2))
+     (flet ((word-op (bit-array-1 bit-array-2 result-bit-array)
+              (declare (type simple-bit-vector bit-array-1 bit-array-2
+                             result-bit-array)
+                       (optimize (speed 3) (safety 0)))
+              #+(and (or x86-64 arm64) (not cheneygc))
+              (when (>= (length result-bit-array)
+                        (* min-words-bit-vector-op-c-call-threshold sb-vm:n-word-bits))
+                (return-from word-op
+                  (%bit-vector-op ,op bit-array-1 bit-array-2 result-bit-array)))
+              (,name bit-array-1 bit-array-2 result-bit-array)))
      (let ((result-bit-array (pick-result-array result-bit-array bit-array-1)))
        (if (and (simple-bit-vector-p bit-array-1)
                 (simple-bit-vector-p bit-array-2)
                 (simple-bit-vector-p result-bit-array))
-           (locally (declare (optimize (speed 3) (safety 0)))
-             (,name bit-array-1 bit-array-2 result-bit-array))
+           (word-op bit-array-1 bit-array-2 result-bit-array)
            (with-array-data ((data1 bit-array-1) (start1) (end1))
              (with-array-data ((data2 bit-array-2) (start2) (end2))
                (with-array-data ((data3 result-bit-array) (start3) (end3))
@@ -1700,8 +1715,7 @@ function to be removed without further warning."
                           (= (length data1) end1)
                           (= (length data2) end2)
                           (= (length data3) end3))
-                     (locally (declare (optimize (speed 3) (safety 0)))
-                       (,name data1 data2 data3))
+                     (word-op data1 data2 data3)
                      (do ((index-1 start1 (1+ index-1))
                           (index-2 start2 (1+ index-2))
                           (index-3 start3 (1+ index-3)))
@@ -1711,18 +1725,19 @@ function to be removed without further warning."
                              (logand (,function (sbit data1 index-1)
                                                 (sbit data2 index-2))
                                      1))))
-                 result-bit-array))))))))
-
-(def-bit-array-op bit-and logand)
-(def-bit-array-op bit-ior logior)
-(def-bit-array-op bit-xor logxor)
-(def-bit-array-op bit-eqv logeqv)
-(def-bit-array-op bit-nand lognand)
-(def-bit-array-op bit-nor lognor)
-(def-bit-array-op bit-andc1 logandc1)
-(def-bit-array-op bit-andc2 logandc2)
-(def-bit-array-op bit-orc1 logorc1)
-(def-bit-array-op bit-orc2 logorc2)
+                 result-bit-array)))))))))
+
+;;; The last argument is the code of the operation for %BIT-VECTOR-OP
+(def-bit-array-op bit-and logand 0)
+(def-bit-array-op bit-ior logior 1)
+(def-bit-array-op bit-xor logxor 2)
+(def-bit-array-op bit-eqv logeqv 3)
+(def-bit-array-op bit-nand lognand 4)
+(def-bit-array-op bit-nor lognor 5)
+(def-bit-array-op bit-andc1 logandc1 6)
+(def-bit-array-op bit-andc2 logandc2 7)
+(def-bit-array-op bit-orc1 logorc1 8)
+(def-bit-array-op bit-orc2 logorc2 9)
 ) ; end MACROLET
 
 (defun bit-not (bit-array &optional result-bit-array)
@@ -3,12 +3,10 @@
 
 ;;; Return the difference in left and right heights. Some people do the subtraction
 ;;; the other way around (like on Wikipedia). Oh well, it is what it is.
+;;; Each node stores its height, without which this would have to walk both
+;;; subtrees, making every insertion and deletion linear in the size of the tree.
 (defun avl-balance-factor (node)
-  ;; would keeping the balance factor in each node would entail more consing? unsure.
-  (labels ((height (node)
-             (if node
-                 (1+ (max (height (avlnode-left node)) (height (avlnode-right node))))
-                 0)))
+  (flet ((height (node) (if node (avlnode-height node) 0)))
     (- (height (avlnode-left node)) (height (avlnode-right node)))))
 
 (defun avl-rotate-left (node)
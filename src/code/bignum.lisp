@@ -423,6 +423,152 @@
 
 ;;;; multiplication
 
+;;; The helpers below work on unsigned digit strings, given as a bignum
+;;; used as a buffer, a start index and a number of digits.
+
+;;; Store the product of the LEN-A digits of A from START-A and the
+;;; LEN-B digits of B from START-B into the LEN-A + LEN-B digits of RES
+;;; from START-RES, which need not be zeroed.
+(defun %multiply-digits-schoolbook (a start-a len-a b start-b len-b res start-res)
+  (declare (type bignum a b res)
+           (type bignum-index start-a start-b start-res)
+           (type bignum-length len-a len-b))
+  (dotimes (j len-b)
+    (setf (%bignum-ref res (+ start-res j)) 0))
+  (dotimes (i len-a)
+    (declare (type bignum-index i))
+    (let ((carry-digit 0)
+          (x (%bignum-ref a (+ start-a i)))
+          (k (+ start-res i)))
+      (declare (type bignum-index k)
+               (type bignum-element-type carry-digit x))
+      (dotimes (j len-b)
+        (multiple-value-bind (big-carry res-digit)
+            (%multiply-and-add x
+                               (%bignum-ref b (+ start-b j))
+                               (%bignum-ref res k)
+                               carry-digit)
+          (declare (type bignum-element-type big-carry res-digit))
+          (setf (%bignum-ref res k) res-digit)
+          (setf carry-digit big-carry)
+          (incf k)))
+      (setf (%bignum-ref res k) carry-digit))))
+
+;;; Add the LEN-X digits of X from START-X to the digits of RES from
+;;; START-RES, propagating the carry up to END-RES.
+(defun %add-digits-into (res start-res end-res x start-x len-x)
+  (declare (type bignum res x)
+           (type bignum-index start-res start-x)
+           (type bignum-length end-res len-x))
+  (let ((carry 0)
+        (k start-res))
+    (declare (type (mod 2) carry)
+             (type bignum-index k))
+    (dotimes (i len-x)
+      (declare (type bignum-index i))
+      (multiple-value-bind (v c)
+          (%add-with-carry (%bignum-ref res k) (%bignum-ref x (+ start-x i)) carry)
+        (setf (%bignum-ref res k) v
+              carry c))
+      (incf k))
+    (loop while (and (= carry 1) (< k end-res))
+          do (multiple-value-bind (v c) (%add-with-carry (%bignum-ref res k) 0 carry)
+               (setf (%bignum-ref res k) v
+                     carry c))
+             (incf k)))
+  (values))
+
+;;; Subtract the LEN-X digits of X from START-X from the digits of RES
+;;; from START-RES, propagating the borrow up to END-RES.
+(defun %subtract-digits-from (res start-res end-res x start-x len-x)
+  (declare (type bignum res x)
+           (type bignum-index start-res start-x)
+           (type bignum-length end-res len-x))
+  (let ((borrow 1)
+        (k start-res))
+    (declare (type (mod 2) borrow)
+             (type bignum-index k))
+    (dotimes (i len-x)
+      (declare (type bignum-index i))
+      (multiple-value-bind (v c)
+          (%subtract-with-borrow (%bignum-ref res k) (%bignum-ref x (+ start-x i)) borrow)
+        (setf (%bignum-ref res k) v
+              borrow c))
+      (incf k))
+    (loop while (and (= borrow 0) (< k end-res))
+          do (multiple-value-bind (v c) (%subtract-with-borrow (%bignum-ref res k) 0 borrow)
+               (setf (%bignum-ref res k) v
+                     borrow c))
+             (incf k)))
+  (values))
+
+;;; Return a new buffer of LEN + 1 digits holding the sum of the LEN-A0
+;;; digits of A from START and the LEN-A1 digits following those,
+;;; LEN-A0 >= LEN-A1.
+(defun %add-digit-halves (a start len-a0 len-a1)
+  (declare (type bignum a)
+           (type bignum-index start)
+           (type bignum-length len-a0 len-a1))
+  (let ((sum (%allocate-bignum (1+ len-a0))))
+    (dotimes (i len-a0)
+      (setf (%bignum-ref sum i) (%bignum-ref a (+ start i))))
+    (setf (%bignum-ref sum len-a0) 0)
+    (%add-digits-into sum 0 (1+ len-a0) a (+ start len-a0) len-a1)
+    sum))
+
+;;; Below this many digits in the shorter factor, MULTIPLY-BIGNUMS uses
+;;; schoolbook multiplication, whose inner loop is a single VOP.
+(define-load-time-global *karatsuba-cutoff* 40)
+
+;;; As %MULTIPLY-DIGITS-SCHOOLBOOK, but LEN-A >= LEN-B, and recursing
+;;; with Karatsuba's method while there are at least *KARATSUBA-CUTOFF*
+;;; digits in B. With A = A1*2^(64H) + A0 and B = B1*2^(64H) + B0,
+;;;   A*B = A1*B1*2^(128H) + ((A0+A1)(B0+B1) - A0*B0 - A1*B1)*2^(64H)
+;;;         + A0*B0
+;;; which takes three half-size products instead of four.
+(defun %multiply-digits (a start-a len-a b start-b len-b res start-res)
+  (declare (type bignum a b res)
+           (type bignum-index start-a start-b start-res)
+           (type bignum-length len-a len-b))
+  (let ((h (ceiling len-a 2))
+        (end-res (+ start-res len-a len-b)))
+    (declare (type bignum-length h end-res))
+    ;; Splitting fewer than 4 digits would not make them any shorter.
+    (cond ((< len-b (max 4 (the bignum-length *karatsuba-cutoff*)))
+           (%multiply-digits-schoolbook a start-a len-a b start-b len-b
+                                        res start-res))
+          ((<= len-b h)
+           ;; Too lopsided to split both. Multiply B by one LEN-B digit
+           ;; slice of A at a time.
+           (let ((product (%allocate-bignum (* 2 len-b))))
+             (loop for k from start-res below end-res
+                   do (setf (%bignum-ref res k) 0))
+             (loop for offset of-type bignum-index from 0 below len-a by len-b
+                   do (let ((len (min len-b (- len-a offset))))
+                        (%multiply-digits b start-b len-b a (+ start-a offset) len
+                                          product 0)
+                        (%add-digits-into res (+ start-res offset) end-res
+                                          product 0 (+ len-b len))))))
+          (t
+           (let* ((len-a1 (- len-a h))
+                  (len-b1 (- len-b h))
+                  (sum-a (%add-digit-halves a start-a h len-a1))
+                  (sum-b (%add-digit-halves b start-b h len-b1))
+                  (len-middle (+ h h 2))
+                  (middle (%allocate-bignum len-middle)))
+             (declare (type bignum-length len-a1 len-b1 len-middle))
+             (%multiply-digits a start-a h b start-b h res start-res)
+             (%multiply-digits a (+ start-a h) len-a1 b (+ start-b h) len-b1
+                               res (+ start-res h h))
+             (%multiply-digits sum-a 0 (1+ h) sum-b 0 (1+ h) middle 0)
+             (%subtract-digits-from middle 0 len-middle res start-res (+ h h))
+             (%subtract-digits-from middle 0 len-middle
+                                    res (+ start-res h h) (+ len-a1 len-b1))
+             ;; The high digits of MIDDLE that would land past END-RES are 0.
+             (%add-digits-into res (+ start-res h) end-res
+                               middle 0 (min len-middle (- end-res start-res h)))))))
+  (values))
+
 (defun multiply-bignums (a b)
   (declare (type bignum a b))
   (let* ((a-plusp (bignum-plus-p a))
@@ -432,27 +578,12 @@
          (len-a (%bignum-length a))
          (len-b (%bignum-length b))
          (len-res (+ len-a len-b))
-         (res (alloc-zeroing len-res))
+         (res (%allocate-bignum len-res))
          (negate-res (not (eq a-plusp b-plusp))))
     (declare (type bignum-length len-a len-b len-res))
-    (dotimes (i len-a)
-      (declare (type bignum-index i))
-      (let ((carry-digit 0)
-            (x (%bignum-ref a i))
-            (k i))
-        (declare (type bignum-index k)
-                 (type bignum-element-type carry-digit x))
-        (dotimes (j len-b)
-          (multiple-value-bind (big-carry res-digit)
-              (%multiply-and-add x
-                                 (%bignum-ref b j)
-                                 (%bignum-ref res k)
-                                 carry-digit)
-            (declare (type bignum-element-type big-carry res-digit))
-            (setf (%bignum-ref res k) res-digit)
-            (setf carry-digit big-carry)
-            (incf k)))
-        (setf (%bignum-ref res k) carry-digit)))
+    (if (>= len-a len-b)
+        (%multiply-digits a 0 len-a b 0 len-b res 0)
+        (%multiply-digits b 0 len-b a 0 len-a res 0))
     (when negate-res (negate-bignum-in-place res))
     (%normalize-bignum res len-res)))
 
@@ -38,7 +38,14 @@
   (defconstant min-bytes-c-call-threshold
     ;; mostly just guessing here
     #+(or x86 x86-64 ppc ppc64) 128
-    #-(or x86 x86-64 ppc ppc64) 256))
+    #-(or x86 x86-64 ppc ppc64) 256)
+  ;; Fills of at least this many bytes call out to BULK-FILL-WORDS.
+  ;; Not with cheneygc, which can't handle a WP fault in C.
+  #+(and x86-64 (not cheneygc))
+  (defconstant min-bytes-bulk-fill-threshold 2048)
+  ;; Counts of bits in at least this many words call out to BIT-VECTOR-COUNT.
+  #+(or x86-64 arm64)
+  (defconstant min-words-bit-count-c-call-threshold 32))
 
 (defmacro verify-src/dst-bits-per-elt (source destination expect-bits-per-element)
   (declare (ignorable source destination expect-bits-per-element))
@@ -99,11 +106,12 @@
            ;; by subtracting the start. Regardless, the args are way too confusing,
            ;; so let's go directly to memmove. Cribbed from (DEFTRANSFORM %BYTE-BLT)
            `(with-pinned-objects (dst src)
-              (memmove (sap+ (vector-sap (the ,vtype dst))
-                             (the signed-word (* dst-start ,bytes-per-element)))
-                       (sap+ (vector-sap (the ,vtype src))
-                             (the signed-word (* src-start ,bytes-per-element)))
-                      (the word (* nelements ,bytes-per-element))))))
+              (#+x86-64 bulk-copy #-x86-64 memmove
+                 (sap+ (vector-sap (the ,vtype dst))
+                       (the signed-word (* dst-start ,bytes-per-element)))
+                 (sap+ (vector-sap (the ,vtype src))
+                       (the signed-word (* src-start ,bytes-per-element)))
+                 (the word (* nelements ,bytes-per-element))))))
     ;; The arguments are array element indices.
     `(defun ,(intern (format nil "UB~D-BASH-COPY" bits-per-element)
                      (find-package "SB-KERNEL"))
@@ -274,6 +282,14 @@
                          (incf dst-word-offset))))
                   (let ((end (+ dst-word-offset interior)))
                     (declare (type ,word-offset end))
+                    #+(and x86-64 (not cheneygc))
+                    (when (>= interior ,(/ min-bytes-bulk-fill-threshold n-word-bytes))
+                      (with-pinned-objects (dst)
+                        (bulk-fill-words (sap+ (vector-sap dst)
+                                               (the signed-word
+                                                    (* dst-word-offset n-word-bytes)))
+                                         value interior))
+                      (setf dst-word-offset end))
                     (do ()
                         ((>= dst-word-offset end))
                       (%set-vector-raw-bits dst dst-word-offset value)
@@ -815,7 +831,44 @@
   (def %bit-pos-fwd/1 nil (identity))
   (def %bit-pos-rev/1   t (identity))
   (def %bit-pos-fwd/0 nil (logandc2 most-positive-word))
-  (def %bit-pos-rev/0   t (logandc2 most-positive-word)))
+  (def %bit-pos-rev/0   t (logandc2 most-positive-word))
+
+  ;; The number of 1 bits of VECTOR from START below END, with the same
+  ;; masks as the search for the leading and trailing words. The words
+  ;; between them are counted in C when there are many.
+  (defun %bit-count (vector start end)
+    (declare (simple-bit-vector vector)
+             (index start end)
+             (optimize (speed 3) (safety 0)))
+    (let* ((first-word (ash start (- +bit-position-base-shift+)))
+           (last-word (ash end (- +bit-position-base-shift+)))
+           (start-mask (compute-start-mask start))
+           (end-mask (compute-end-mask end)))
+      (declare (index last-word first-word))
+      (when (= first-word last-word)
+        (let ((mask (logand start-mask end-mask)))
+          (return-from %bit-count
+            (if (zerop mask)
+                0
+                (logcount (logand mask (%vector-raw-bits vector first-word)))))))
+      (let ((count (logcount (logand start-mask (%vector-raw-bits vector first-word))))
+            (word-index (1+ first-word)))
+        (declare (index count word-index))
+        #+(or x86-64 arm64)
+        (let ((interior (- last-word word-index)))
+          (when (>= interior min-words-bit-count-c-call-threshold)
+            (with-pinned-objects (vector)
+              (incf count (bit-vector-count (sap+ (vector-sap vector)
+                                                  (* word-index n-word-bytes))
+                                            interior)))
+            (setf word-index last-word)))
+        (loop while (< word-index last-word)
+              do (incf count (logcount (%vector-raw-bits vector word-index)))
+                 (incf word-index))
+        ;; As for the search, don't read the word at END if no bits of it count
+        (unless (zerop end-mask)
+          (incf count (logcount (logand end-mask (%vector-raw-bits vector last-word)))))
+        count))))
 
 ;; Known direction, unknown item to find
 (defun %bit-pos-fwd (bit vector start end)
@@ -850,3 +903,80 @@
 (clear-info :function :inlinep '%bit-position/1)
 
 (run-bit-position-assertions)
+
+;;; Perform the bit-wise operation OP, the position of its function in
+;;; (BIT-AND BIT-IOR BIT-XOR BIT-EQV BIT-NAND BIT-NOR BIT-ANDC1 BIT-ANDC2
+;;; BIT-ORC1 BIT-ORC2), on all the words of the vectors, in C, which uses
+;;; the vector registers of the CPU. The C function is chosen over the
+;;; word loop of the transforms only for long vectors, as the call costs
+;;; as much as a few dozen words.
+#+(and (or x86-64 arm64) (not cheneygc))
+(defun %bit-vector-op (op bit-array-1 bit-array-2 result-bit-array)
+  (declare (type (mod 10) op)
+           (type simple-bit-vector bit-array-1 bit-array-2 result-bit-array))
+  (with-pinned-objects (bit-array-1 bit-array-2 result-bit-array)
+    (bit-vector-op op (vector-sap result-bit-array)
+                   (vector-sap bit-array-1) (vector-sap bit-array-2)
+                   (ceiling (length result-bit-array) n-word-bits)))
+  result-bit-array)
+
+;;;; Search for an octet in octet vectors and base-strings
+;;;;
+;;;; A word is scanned at once: XORing it with the target octet replicated
+;;;; into every byte leaves a zero byte wherever the target was, and
+;;;; (X - #x0101...) & ~X & #x8080... is nonzero iff X has a zero byte.
+;;;; The exact position within such a word is then found bytewise, which
+;;;; is correct for either byte order.
+
+(macrolet ((def (name from-end)
+             `(defun ,name (byte vector start end)
+                (declare (type (unsigned-byte 8) byte)
+                         (type (or (simple-array (unsigned-byte 8) (*))
+                                   simple-base-string)
+                               vector)
+                         (index start end)
+                         (optimize speed (safety 0)))
+                (let* ((ones (floor most-positive-word #xff))
+                       (pattern (* byte ones)))
+                  (with-pinned-objects (vector)
+                    (let ((sap (vector-sap vector))
+                          (i ,(if from-end 'end 'start)))
+                      (declare (index i))
+                      (flet ((match-p (i)
+                               (= (sap-ref-8 sap i) byte))
+                             (word-matches-p (i)
+                               (let ((x (logxor (sap-ref-word sap i) pattern)))
+                                 (logtest (logandc2 (logand (- x ones) most-positive-word) x)
+                                          (* #x80 ones))))
+                             (aligned-p (i)
+                               (not (logtest i (1- n-word-bytes)))))
+                        (declare (inline match-p word-matches-p aligned-p))
+                        ,(if from-end
+                             `(progn
+                                (loop while (and (> i start) (not (aligned-p i)))
+                                      do (decf i)
+                                         (when (match-p i) (return-from ,name i)))
+                                (loop while (and (>= i (+ start n-word-bytes))
+                                                 (not (word-matches-p (- i n-word-bytes))))
+                                      do (decf i n-word-bytes))
+                                (loop while (> i start)
+                                      do (decf i)
+                                         (when (match-p i) (return-from ,name i))))
+                             `(progn
+                                (loop while (and (< i end) (not (aligned-p i)))
+                                      do (when (match-p i) (return-from ,name i))
+                                         (incf i))
+                                (loop while (and (<= (+ i n-word-bytes) end)
+                                                 (not (word-matches-p i)))
+                                      do (incf i n-word-bytes))
+                                (loop while (< i end)
+                                      do (when (match-p i) (return-from ,name i))
+                                         (incf i))))
+                        nil)))))))
+  (def %octet-pos-fwd nil)
+  (def %octet-pos-rev t))
+
+(defun %octet-position (byte vector from-end start end)
+  (if from-end
+      (%octet-pos-rev byte vector start end)
+      (%octet-pos-fwd byte vector start end)))
@@ -6,6 +6,17 @@
 (defun (cas first) (old new cons) (%compare-and-swap-car cons old new))
 (defun (cas rest) (old new cons) (%compare-and-swap-cdr cons old new))
 
+;;; Each branch is open coded by the transform for its type of vector.
+(defun (cas aref) (old new vector index)
+  (etypecase vector
+    (simple-vector (funcall #'(cas aref) old new vector index))
+    #+x86-64
+    ((simple-array word (*)) (funcall #'(cas aref) old new vector index))
+    #+x86-64
+    ((simple-array (unsigned-byte 32) (*)) (funcall #'(cas aref) old new vector index))
+    #+x86-64
+    ((simple-array fixnum (*)) (funcall #'(cas aref) old new vector index))))
+
 ;;; Out-of-line definitions for various primitive cas functions.
 (macrolet ((def (name lambda-list ref &optional set)
              #+compare-and-swap-vops
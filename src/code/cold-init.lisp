@@ -382,6 +382,16 @@ process to continue normally."
 
 ;;;; initialization functions
 
+;;; Record the end of the phase of startup named PHASE, for the
+;;; runtime's --startup-trace option. This does nothing when the
+;;; option is off, and is safe to use before streams exist.
+(defmacro startup-trace-mark (phase)
+  `(let ((name ,(coerce phase 'simple-base-string)))
+     (with-pinned-objects (name)
+       (alien-funcall (extern-alien "startup_trace_mark"
+                                    (function void system-area-pointer))
+                      (vector-sap name)))))
+
 (defun reinit (total)
   ;; WITHOUT-GCING implies WITHOUT-INTERRUPTS.
   (without-gcing
@@ -389,25 +399,33 @@ process to continue normally."
     ;; can be called, as pretty much anything can assume that it is set.
     (when total ; newly started process, and not a failed save attempt
       (sb-thread::init-main-thread)
-      (rebuild-package-vector))
+      (rebuild-package-vector)
+      (startup-trace-mark "init-main-thread"))
     ;; Initializing the standard streams calls ALLOC-BUFFER which calls FINALIZE
     (finalizers-reinit)
     ;; Initialize streams next, so that any errors can be printed
     (stream-reinit t)
+    (startup-trace-mark "stream-reinit")
     (os-cold-init-or-reinit)
     #-(and win32 (not sb-thread))
     (signal-cold-init-or-reinit)
     (setf (extern-alien "internal_errors_enabled" int) 1)
-    (float-cold-init-or-reinit))
+    (float-cold-init-or-reinit)
+    (startup-trace-mark "os-and-signal-reinit"))
   (gc-reinit)
   (foreign-reinit)
+  (startup-trace-mark "foreign-reinit")
   #+win32 (reinit-internal-real-time)
   ;; If the debugger was disabled in the saved core, we need to
   ;; re-disable ldb again.
   (when (eq *invoke-debugger-hook* 'sb-debug::debugger-disabled-hook)
     (sb-debug::disable-debugger))
   (call-hooks "initialization" *init-hooks*)
-  #+sb-thread (finalizer-thread-start))
+  (startup-trace-mark "init-hooks")
+  #+sb-thread (finalizer-thread-start)
+  (when total
+    (startup-trace-mark "finalizer-thread-start")
+    (alien-funcall (extern-alien "startup_trace_report" (function void)))))
 
 ;;;; some support for any hapless wretches who end up debugging cold
 ;;;; init code
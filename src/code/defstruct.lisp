@@ -91,6 +91,7 @@
   (if (member (dd-type dd) '(structure funcallable-structure)) t nil))
 (defmacro dd-named (dd) `(logtest (dd-flags ,dd) +dd-named+))
 (defmacro dd-pure (dd) `(logtest (dd-flags ,dd) +dd-pure+))
+(defmacro dd-packed (dd) `(logtest (dd-flags ,dd) +dd-packed+))
 (defmacro dd-null-lexenv-p (dd) `(logtest (dd-flags ,dd) +dd-nullenv+))
 (defun dd-print-option (dd)
   (cond ((logtest (dd-flags dd) +dd-printfun+) :print-function)
@@ -104,7 +105,8 @@
 ;;; A DEFSTRUCT-SLOT-DESCRIPTION holds compile-time information about
 ;;; a structure slot. These objects are immutable.
 (def!struct (defstruct-slot-description
-             (:constructor make-dsd (name type accessor-name bits default))
+             (:constructor make-dsd (name type accessor-name bits default
+                                     &optional (packing 0)))
              (:conc-name dsd-)
              (:copier nil)
              (:pure t))
@@ -115,7 +117,10 @@
   ;; FIXNUM is ok for the host - it's guaranteed to be at least 16 signed bits
   ;; and we don't have structures whose slot indices run into the thousands.
   (bits 0 :type fixnum :read-only t)
-  (default nil :read-only t))                    ; default value expression
+  (default nil :read-only t)                    ; default value expression
+  ;; 0, or the bit field of a raw word that the slot takes in a
+  ;; structure defined with (:PACKED T). See PACK-DSD-PACKING.
+  (packing 0 :type fixnum :read-only t))
 (declaim (freeze-type defstruct-slot-description))
 
 (eval-when (:compile-toplevel)
@@ -205,6 +210,76 @@
          (t
           (values '%instance-ref '%instance-set))))
 
+;;;; packed slots
+
+;;; In a structure defined with (:PACKED T), a slot of type BOOLEAN, or
+;;; (UNSIGNED-BYTE N) or (SIGNED-BYTE N) for N up to 32, takes a bit field
+;;; of a raw word rather than a word of its own, and consecutive such
+;;; slots share the word while they fit. These slots have the RSD-INDEX
+;;; of SB-VM:WORD and the DSD-INDEX of the word, so that the bitmap,
+;;; copying, EQUALP and hashing all see an ordinary raw word. Only their
+;;; accessors and constructors need to know about the field: the kind in
+;;; the low 2 bits of DSD-PACKING, the width in the next 6, the position
+;;; in the word above those.
+(defconstant +max-packed-slot-width+ 32)
+(defun pack-dsd-packing (kind width position)
+  (logior (ash position 8)
+          (ash width 2)
+          (ecase kind
+            (unsigned-byte 1)
+            (signed-byte 2)
+            (boolean 3))))
+(defun dsd-packed-p (dsd) (/= (dsd-packing dsd) 0))
+(defun dsd-packed-kind (dsd)
+  (case (ldb (byte 2 0) (dsd-packing dsd))
+    (1 'unsigned-byte)
+    (2 'signed-byte)
+    (3 'boolean)))
+(defun dsd-packed-width (dsd) (ldb (byte 6 2) (dsd-packing dsd)))
+(defun dsd-packed-position (dsd) (ash (dsd-packing dsd) -8))
+
+;;; Return the kind and the width of the field that a slot of type CTYPE
+;;; can take in a packed structure, or NIL if it needs a word of its own.
+(defun choose-packed-slot-representation (ctype)
+  (flet ((width (kind)
+           (loop for width from 1 to +max-packed-slot-width+
+                 when (csubtypep ctype (specifier-type (list kind width)))
+                 return width)))
+    (cond ((csubtypep ctype (specifier-type 'boolean))
+           (values 'boolean 1))
+          ((csubtypep ctype (specifier-type 'unsigned-byte))
+           (let ((width (width 'unsigned-byte)))
+             (when width (values 'unsigned-byte width))))
+          ((csubtypep ctype (specifier-type 'integer))
+           (let ((width (width 'signed-byte)))
+             (when width (values 'signed-byte width)))))))
+
+;;; Return the form which extracts the value of the packed slot DSD
+;;; from WORD, a form for the raw word that holds it.
+(defun packed-slot-read-form (dsd word)
+  (let ((width (dsd-packed-width dsd))
+        (position (dsd-packed-position dsd)))
+    (ecase (dsd-packed-kind dsd)
+      (unsigned-byte `(ldb (byte ,width ,position) ,word))
+      (signed-byte `(sb-c::mask-signed-field ,width (ldb (byte ,width ,position) ,word)))
+      (boolean `(logbitp ,position ,word)))))
+
+;;; Return the form which computes the bits of VALUE, a form for the new
+;;; value of the packed slot DSD, in the low bits of an integer.
+(defun packed-slot-bits-form (dsd value)
+  (ecase (dsd-packed-kind dsd)
+    (unsigned-byte value)
+    (signed-byte `(ldb (byte ,(dsd-packed-width dsd) 0) ,value))
+    (boolean `(if ,value 1 0))))
+
+;;; The same as PACKED-SLOT-READ-FORM, for the printer and the like
+(defun packed-slot-value (dsd word)
+  (let ((bits (ldb (byte (dsd-packed-width dsd) (dsd-packed-position dsd)) word)))
+    (ecase (dsd-packed-kind dsd)
+      (unsigned-byte bits)
+      (signed-byte (sb-c::mask-signed-field (dsd-packed-width dsd) bits))
+      (boolean (/= bits 0)))))
+
 ;;;; typed (non-class) structures
 
 ;;; Return a type specifier we can use for testing :TYPE'd structures.
@@ -282,7 +357,8 @@
                              `(,(slot-access-transform :setf `(#1# (truly-the ,(dd-name dd) #2#))
                                                        key :function))))
                     `(named-lambda ,name (#2#)
-                       ,(if (and (dsd-always-boundp dsd) (dsd-safe-p dsd))
+                       ,(if (and (dsd-always-boundp dsd) (dsd-safe-p dsd)
+                                 (not (dsd-packed-p dsd)))
                             ;; Most slots are always-boundp (don't have a BOA constructor
                             ;; that omits slots) and safe-p (type-safe for reading),
                             ;; so we can be concise rather than use SLOT-ACCESS-TRANSFORM
@@ -426,11 +502,18 @@
   ;; Process the easiest slots first.
   ;; TODO: consecutive word-sized slots should try to use instructions
   ;; that compare more than one word at a time.
-  (collect ((group1) (group2) (group3))
+  (collect ((group1) (group2) (group3) (packed-words))
     (mapc (lambda (dsd comparator)
             (let ((x `(truly-the ,(dsd-type dsd) (,(dsd-reader dsd nil) a ,(dsd-index dsd))))
                   (y `(truly-the ,(dsd-type dsd) (,(dsd-reader dsd nil) b ,(dsd-index dsd)))))
-              (cond ((member comparator '(= char-equal))
+              (cond ((dsd-packed-p dsd)
+                     ;; Packed slots hold integers and booleans, which are EQUALP
+                     ;; when their bits are the same, so compare each word once.
+                     (unless (member (dsd-index dsd) (packed-words))
+                       (packed-words (dsd-index dsd))
+                       (group1 `(= (,(dsd-reader dsd nil) a ,(dsd-index dsd))
+                                   (,(dsd-reader dsd nil) b ,(dsd-index dsd))))))
+                    ((member comparator '(= char-equal))
                      (group1 `(,comparator ,x ,y))) ; bounded amount of testing
                     ((member comparator '(bit-vector-=))
                      ;; unbounded but not recursive. Try EQ first though
@@ -481,6 +564,11 @@
        Make this type a subtype of the structure type Supertype. The optional
        Slot-Specs override inherited slot options.
 
+   (:PACKED T)
+       Store slots of type BOOLEAN, (UNSIGNED-BYTE N) or (SIGNED-BYTE N)
+       with N up to 32 in bit fields that share words. Writing such a slot
+       is not atomic with respect to the other slots in its word.
+
    Slot options:
 
    :TYPE Type-Spec
@@ -600,6 +688,7 @@
     #(:include        ; at least 1 argument
       :initial-offset ; exactly 1 argument
       :pure           ; exactly 1 argument [nonstandard]
+      :packed         ; exactly 1 argument [nonstandard]
       :type           ; exactly 1 argument
       :conc-name      ; 0 or 1 arg
       :copier         ; "
@@ -617,7 +706,7 @@
          (arg-p (consp args))
          (arg (if arg-p (car args)))
          (name (dd-name dd)))
-    (declare (type (unsigned-byte 9) seen-options)) ; mask over DD-OPTION-NAMES
+    (declare (type (unsigned-byte 10) seen-options)) ; mask over DD-OPTION-NAMES
     (when bit
       (if (logbitp bit seen-options)
           (error "More than one ~S option is not allowed" keyword)
@@ -625,7 +714,7 @@
       (multiple-value-bind (syntax-group winp)
           (cond ; Perform checking per comment at +DD-OPTION-NAMES+.
             ((= bit 0) (values 0 (and arg-p (proper-list-p args)))) ; >1 arg
-            ((< bit 4) (values 1 (and arg-p (not (cdr args))))) ; exactly 1
+            ((< bit 5) (values 1 (and arg-p (not (cdr args))))) ; exactly 1
             (t         (values 2 (or (not args) (singleton-p args))))) ; 0 or 1
         (unless winp
           (if (proper-list-p option)
@@ -706,6 +795,9 @@ requires exactly~;accepts at most~] one argument" keyword syntax-group)
       (:pure
        (setf (dd-flags dd) (logior (logandc2 (dd-flags dd) +dd-pure+)
                                    (if arg +dd-pure+ 0))))
+      (:packed
+       (setf (dd-flags dd) (logior (logandc2 (dd-flags dd) +dd-packed+)
+                                   (if arg +dd-packed+ 0))))
       (t
        (error "unknown DEFSTRUCT option:~%  ~S" option)))
     seen-options))
@@ -759,6 +851,8 @@ requires exactly~;accepts at most~] one argument" keyword syntax-group)
 unless :NAMED is also specified.")))
        (awhen (dd-print-option dd)
          (error ":TYPE option precludes specification of ~S option" it))
+       (when (dd-packed dd)
+         (error ":TYPE option precludes specification of ~S option" :packed))
        (when named-p
          (incf (dd-length dd)))
        (let ((offset (dd-offset dd)))
@@ -876,7 +970,7 @@ unless :NAMED is also specified.")))
 ;;; type, and read-only flag for the new slot.
 (defun parse-1-dsd (proto-classoid defstruct spec &optional included-slot
                     &aux accessor-name (always-boundp t) (safe-p t)
-                         ctype rsd-index index)
+                         ctype rsd-index index (packing 0))
   #-sb-xc-host (declare (muffle-conditions style-warning))
   (multiple-value-bind (name default default-p type type-p read-only ro-p)
       (typecase spec
@@ -901,7 +995,8 @@ unless :NAMED is also specified.")))
              ;; warning is justified.
              (typecase name
                ((member :conc-name :constructor :copier :predicate :include
-                        :print-function :print-object :type :initial-offset :pure)
+                        :print-function :print-object :type :initial-offset :pure
+                        :packed)
                 (warn "slot name of ~S indicates probable syntax error in DEFSTRUCT" name))))
            (values name default default-p
                    (uncross type) type-p
@@ -987,11 +1082,28 @@ unless :NAMED is also specified.")))
            (setf rsd-index (dsd-rsd-index included-slot)
                  safe-p (dsd-safe-p included-slot)
                  always-boundp (dsd-always-boundp included-slot)
-                 index (dsd-index included-slot))
+                 index (dsd-index included-slot)
+                 packing (dsd-packing included-slot))
            (when (and safe-p
                       (not (equal type (dsd-type included-slot)))
                       (not (subtypep (dsd-type included-slot) type)))
              (setf safe-p nil)))
+          ((and (dd-packed defstruct) (choose-packed-slot-representation ctype))
+           ;; Take the bits after the last packed slot if they fit in its word,
+           ;; or else the start of a new word.
+           (multiple-value-bind (kind width) (choose-packed-slot-representation ctype)
+             (let* ((last (find-if #'dsd-packed-p (dd-slots defstruct) :from-end t))
+                    (start (if last
+                               (+ (dsd-packed-position last) (dsd-packed-width last))
+                               sb-vm:n-word-bits)))
+               (setf rsd-index (position 'sb-vm:word *raw-slot-data*
+                                         :key #'raw-slot-data-raw-type))
+               (cond ((<= (+ start width) sb-vm:n-word-bits)
+                      (setf index (dsd-index last)))
+                     (t
+                      (setf index (dd-length defstruct) start 0)
+                      (incf (dd-length defstruct))))
+               (setf packing (pack-dsd-packing kind width start)))))
           (t
            ;; Compute the index of this DSD. First decide whether the slot is raw.
            (setf rsd-index (and (eq (dd-type defstruct) 'structure)
@@ -1038,7 +1150,7 @@ unless :NAMED is also specified.")))
                           (pack-dsd-bits index read-only safe-p
                                          always-boundp gc-ignorable
                                          rsd-index)
-                          default)))
+                          default packing)))
       (push (cons dsd spec) *dsd-source-form*)
       (setf (dd-slots defstruct) (nconc (dd-slots defstruct) (list dsd)))
       (let ((comparator
@@ -1235,6 +1347,8 @@ unless :NAMED is also specified.")))
        (when (singleton-p args)
          (let* ((instance-form `(the ,(dd-name dd) ,(car args)))
                 (place `(,reader ,instance-form ,index)))
+            (when (dsd-packed-p dsd)
+              (setf place (packed-slot-read-form dsd place)))
             ;; There are 4 cases of {safe,unsafe} x {always-boundp,possibly-unbound}
             ;; If unsafe - which implies TYPE-SPEC other than type T - then we must
             ;; check the type on each read. Assuming that type-checks reject
@@ -1254,10 +1368,19 @@ unless :NAMED is also specified.")))
         ;; the order in which a use of SETF has them, but because the vops
         ;; do not return anything, we have to bind both arguments.
         (when (and (listp args) (singleton-p (cdr args)))
-          (multiple-value-bind (newval-form instance-form)
-              (ecase fun-or-macro
-                (:function (values (first args) (second args)))
-                (:macro (values (second args) (first args))))
+          (binding* (((newval-form instance-form)
+                      (ecase fun-or-macro
+                        (:function (values (first args) (second args)))
+                        (:macro (values (second args) (first args)))))
+                     ;; A packed slot is stored into the bits of its word,
+                     ;; which is not atomic with respect to the other slots in it.
+                     (store (if (dsd-packed-p dsd)
+                                `(,writer #1=#:instance ,index
+                                          (dpb ,(packed-slot-bits-form dsd '#2=#:val)
+                                               (byte ,(dsd-packed-width dsd)
+                                                     ,(dsd-packed-position dsd))
+                                               (,reader #1# ,index)))
+                                `(,writer #1# ,index #2#))))
             (if (eq fun-or-macro :function)
                 ;; This used only for source-transforming (funcall #'(setf myslot) ...).
                 ;; (SETF x) writer functions have been defined as source-transforms instead of
@@ -1265,15 +1388,15 @@ unless :NAMED is also specified.")))
                 ;; writers with random DEFUNs either deliberately or accidentally.
                 ;; Since users can't define source-transforms (not portably anyway),
                 ;; we can easily discern which functions were system-generated.
-                `(let ((#2=#:val
+                `(let ((#2#
                         #4=,(if (eq type-spec t)
                                 newval-form
                                 `(the* (,type-spec :context (:struct ,(dd-name dd) . ,(dsd-name dsd)))
                                        ,newval-form)))
-                       (#1=#:instance #3=(the ,(dd-name dd) ,instance-form)))
-                   (,writer #1# ,index #2#)
+                       (#1# #3=(the ,(dd-name dd) ,instance-form)))
+                   ,store
                    #2#)
-                `(let ((#1# #3#) (#2# #4#)) (,writer #1# ,index #2#) #2#))))))))
+                `(let ((#1# #3#) (#2# #4#)) ,store #2#))))))))
 
 ;;; Apply TRANSFORM - a special indicator stored in :SOURCE-TRANSFORM
 ;;; for a DEFSTRUCT copier, accessor, or predicate - to SEXPR.
@@ -1473,7 +1596,8 @@ or they must be declared locally notinline at each call site.~@:>"
           (unless (subtypep (dsd-type ns) (dsd-type os))
             (retyped name))
           (unless (and (= (dsd-index os) (dsd-index ns))
-                       (eq (dsd-raw-type os) (dsd-raw-type ns)))
+                       (eq (dsd-raw-type os) (dsd-raw-type ns))
+                       (= (dsd-packing os) (dsd-packing ns)))
             (moved name))))
       (values (moved)
               (retyped)
@@ -1849,18 +1973,35 @@ or they must be declared locally notinline at each call site.~@:>"
 ;;;     which might have "name" symbols stuck in at various weird places.
 (defun instance-constructor-form (dd values &aux (dd-slots (dd-slots dd)))
   (aver (= (length dd-slots) (length values)))
-  (collect ((slot-specs) (slot-values))
-      (mapc (lambda (dsd value &aux (raw-type (dsd-raw-type dsd))
-                                    (spec (list* :slot raw-type (dsd-index dsd))))
-              (cond ((eq value '.do-not-initialize-slot.)
-                     (when (eq raw-type t)
-                       (rplaca spec :unbound)
-                       (slot-specs spec)))
-                    (t
-                     (slot-specs spec)
-                     (slot-values value))))
-            dd-slots values)
-      `(%make-structure-instance-macro ,dd ',(slot-specs) ,@(slot-values)))
+  (collect ((slot-specs) (slot-values) (bindings))
+      ;; The fields of a packed word are combined into one value for the word,
+      ;; so the values are bound first to keep them evaluated in order.
+      (let ((packedp (some #'dsd-packed-p dd-slots))
+            (packed-words)) ; (index LOGIOR . fields)
+        (mapc (lambda (dsd value &aux (raw-type (dsd-raw-type dsd))
+                                      (spec (list* :slot raw-type (dsd-index dsd))))
+                (when (and packedp (neq value '.do-not-initialize-slot.))
+                  (let ((var (copy-symbol (dsd-name dsd))))
+                    (bindings `(,var ,value))
+                    (setq value var)))
+                (cond ((eq value '.do-not-initialize-slot.)
+                       (when (eq raw-type t)
+                         (rplaca spec :unbound)
+                         (slot-specs spec)))
+                      ((dsd-packed-p dsd)
+                       (let ((word (assoc (dsd-index dsd) packed-words)))
+                         (unless word
+                           (push (setq word (list (dsd-index dsd) 'logior)) packed-words)
+                           (slot-specs spec)
+                           (slot-values (cdr word)))
+                         (nconc word `((ash ,(packed-slot-bits-form dsd value)
+                                            ,(dsd-packed-position dsd))))))
+                      (t
+                       (slot-specs spec)
+                       (slot-values value))))
+              dd-slots values))
+      (let ((form `(%make-structure-instance-macro ,dd ',(slot-specs) ,@(slot-values))))
+        (if (bindings) `(let ,(bindings) ,form) form)))
   )
 
 ;;; A "typed" constructor prefers to use a single call to LIST or VECTOR
@@ -15,12 +15,13 @@
 
 ;;;; DEFSTRUCT-DESCRIPTION
 
-(defconstant +dd-named+      #b000001) ; :NAMED was specified
-(defconstant +dd-printfun+   #b000010) ; :PRINT-FUNCTION was specified
-(defconstant +dd-printobj+   #b000100) ; :PRINT-OBJECT was specified
-(defconstant +dd-pure+       #b001000) ; :PURE T was specified
-(defconstant +dd-varylen+    #b010000)
-(defconstant +dd-nullenv+    #b100000)
+(defconstant +dd-named+      #b0000001) ; :NAMED was specified
+(defconstant +dd-printfun+   #b0000010) ; :PRINT-FUNCTION was specified
+(defconstant +dd-printobj+   #b0000100) ; :PRINT-OBJECT was specified
+(defconstant +dd-pure+       #b0001000) ; :PURE T was specified
+(defconstant +dd-varylen+    #b0010000)
+(defconstant +dd-nullenv+    #b0100000)
+(defconstant +dd-packed+     #b1000000) ; :PACKED T was specified
 
 ;;; The DEFSTRUCT-DESCRIPTION structure holds compile-time information
 ;;; about a structure type.
@@ -20,6 +20,10 @@
 
 (defvar *trace-encapsulate-default* t
   "the default value for the :ENCAPSULATE option to TRACE")
+
+(defvar *trace-buffer-length* 4096
+  "the number of events kept by TRACE with :REPORT :BUFFER, rounded up to
+   a power of two. A new length takes effect when the buffer is cleared.")
 
 ;;;; internal state
 
@@ -29,7 +33,7 @@
     (make-hash-table :test 'eq :synchronized t))
 
 (deftype trace-report-type ()
-  '(member nil trace))
+  '(member nil trace :buffer))
 
 ;;; A TRACE-INFO object represents all the information we need to
 ;;; trace a given function.
@@ -44,6 +48,10 @@
   ;; Is tracing to be done by encapsulation rather than breakpoints?
   ;; T implies NAMED.
   (encapsulated *trace-encapsulate-default*)
+  ;; the wrapper that the entry point of the function was redirected to,
+  ;; if it was traced that way rather than by breakpoints or by
+  ;; encapsulating its name
+  (wrapper nil :type (or function null))
   ;; Has this trace been untraced?
   (untraced nil)
   ;; breakpoints we set up to trigger tracing
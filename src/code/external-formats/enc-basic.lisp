@@ -68,7 +68,8 @@
       (return-from decode-break-reason 1)
       (code-char byte))
   ascii->string-aref
-  string->ascii)
+  string->ascii
+  :single-octet-limit 128)
 
 ;;; Latin-1
 
@@ -108,11 +109,76 @@
       (setf (sap-ref-8 sap tail) bits))
   (code-char byte)
   latin1->string-aref
-  string->latin1)
+  string->latin1
+  :single-octet-limit 256)
 
 
 ;;; UTF-8
 
+;;; Most text is mostly ASCII, which needs no transcoding. These find the
+;;; end of a run of ASCII a word at a time, by testing the high bit of each
+;;; byte or character in the word together.
+
+;;; Return the index of the first non-ASCII octet in ARRAY from POS below
+;;; END, or END.
+(defmacro define-utf8-ascii-end (accessor type)
+  (let ((name (make-od-name 'utf8-ascii-end accessor)))
+    `(defun ,name (array pos end)
+       (declare (optimize speed #.*safety-0*)
+                (type ,type array)
+                (type array-range pos end))
+       (flet ((ascii-p (i)
+                (< (,accessor array i) #x80))
+              (word-aligned-p (i)
+                (not (logtest ,(ecase accessor
+                                 (aref 'i)
+                                 (sap-ref-8 '(+ (sap-int array) i)))
+                              (1- sb-vm:n-word-bytes)))))
+         (declare (inline ascii-p word-aligned-p))
+         (loop until (or (>= pos end) (word-aligned-p pos) (not (ascii-p pos)))
+               do (incf pos))
+         (when (and (< pos end) (word-aligned-p pos))
+           (loop while (and (<= (+ pos sb-vm:n-word-bytes) end)
+                            (not (logtest ,(ecase accessor
+                                             (aref '(%vector-raw-bits
+                                                     array (ash pos (- sb-vm:word-shift))))
+                                             (sap-ref-8 '(sap-ref-word array pos)))
+                                          #.(* #x80 (floor most-positive-word #xff)))))
+                 do (incf pos sb-vm:n-word-bytes)))
+         (loop while (and (< pos end) (ascii-p pos))
+               do (incf pos))
+         pos))))
+(instantiate-octets-definition define-utf8-ascii-end)
+
+;;; Return the index of the first non-ASCII character in STRING from START
+;;; below END, or END.
+(defun character-string-ascii-end (string start end)
+  (declare (optimize speed #.*safety-0*)
+           (type (simple-array character (*)) string)
+           (type array-range start end))
+  (let ((pos start))
+    (declare (type array-range pos))
+    (flet ((ascii-p (i)
+             (< (char-code (schar string i)) #x80)))
+      (declare (inline ascii-p))
+      #+sb-unicode
+      (let ((chars-per-word (/ sb-vm:n-word-bytes 4)))
+        (loop until (or (>= pos end)
+                        (not (logtest pos (1- chars-per-word)))
+                        (not (ascii-p pos)))
+              do (incf pos))
+        (when (and (< pos end) (not (logtest pos (1- chars-per-word))))
+          (loop while (and (<= (+ pos chars-per-word) end)
+                           (not (logtest (%vector-raw-bits
+                                          string (floor pos chars-per-word))
+                                         #.(* #xffffff80
+                                              (floor most-positive-word
+                                                     #xffffffff)))))
+                do (incf pos chars-per-word))))
+      (loop while (and (< pos end) (ascii-p pos))
+            do (incf pos))
+      pos)))
+
 ;;; to UTF-8
 
 (declaim (inline char-len-as-utf8))
@@ -157,10 +223,11 @@
                      (add-byte (logior #x80 (ldb (byte 6 0) code)))))))
     (etypecase string
       ((simple-array character (*))
-       (let ((utf8-length 0))
+       (let* ((ascii-end (character-string-ascii-end string sstart send))
+              (utf8-length (- ascii-end sstart)))
          ;; Since it has to fit in a vector, it must be a fixnum!
          (declare (type (and unsigned-byte fixnum) utf8-length))
-         (loop for i of-type index from sstart below send
+         (loop for i of-type index from ascii-end below send
                do (incf utf8-length (char-len-as-utf8 (char-code (char string i)))))
          (if (= utf8-length (- send sstart))
              (ascii-bash)
@@ -355,26 +422,48 @@
 (instantiate-octets-definition define-simple-get-utf8-char)
 
 (defmacro define-utf8->string (accessor type)
-  (let ((name (make-od-name 'utf8->string accessor)))
+  (let ((name (make-od-name 'utf8->string accessor))
+        (ascii-end (make-od-name 'utf8-ascii-end accessor)))
     `(progn
       (defun ,name (array astart aend)
         (declare (optimize speed #.*safety-0*)
                  (type ,type array)
                  (type array-range astart aend))
-        (let ((string (make-array 0 :adjustable t :fill-pointer 0 :element-type 'character)))
-          (loop with pos = astart
-                while (< pos aend)
-                do (multiple-value-bind (bytes invalid)
-                       (,(make-od-name 'bytes-per-utf8-character accessor) array pos aend)
-                     (declare (type (or null string) invalid))
-                     (cond
-                       ((null invalid)
-                        (vector-push-extend (,(make-od-name 'simple-get-utf8-char accessor) array pos bytes) string))
-                       (t
-                        (dotimes (i (length invalid))
-                          (vector-push-extend (char invalid i) string))))
-                     (incf pos bytes)))
-          (coerce string 'simple-string))))))
+        (let ((pos (,ascii-end array astart aend)))
+          (declare (type array-range pos))
+          (if (= pos aend)
+              ;; All ASCII, so one character per octet
+              (let ((string (make-string (- aend astart))))
+                (loop for i of-type index from 0
+                      for j of-type index from astart below aend
+                      do (setf (schar string i) (code-char (,accessor array j))))
+                string)
+              ;; There is at most one character per octet,
+              ;; unless replacements are longer than what they replace.
+              (let ((string (make-array (- aend astart) :adjustable t :fill-pointer 0
+                                                        :element-type 'character)))
+                (flet ((copy-ascii (start end)
+                         (loop for j of-type index from start below end
+                               do (vector-push-extend (code-char (,accessor array j))
+                                                      string))))
+                  (declare (inline copy-ascii))
+                  (copy-ascii astart pos)
+                  (loop while (< pos aend)
+                        do (if (< (,accessor array pos) #x80)
+                               (let ((end (,ascii-end array pos aend)))
+                                 (copy-ascii pos end)
+                                 (setq pos end))
+                               (multiple-value-bind (bytes invalid)
+                                   (,(make-od-name 'bytes-per-utf8-character accessor) array pos aend)
+                                 (declare (type (or null string) invalid))
+                                 (cond
+                                   ((null invalid)
+                                    (vector-push-extend (,(make-od-name 'simple-get-utf8-char accessor) array pos bytes) string))
+                                   (t
+                                    (dotimes (i (length invalid))
+                                      (vector-push-extend (char invalid i) string))))
+                                 (incf pos bytes)))))
+                (coerce string 'simple-string))))))))
 (instantiate-octets-definition define-utf8->string)
 
 (define-external-format/variable-width (:utf-8 :utf8) t
@@ -430,4 +519,5 @@
                               (dpb byte3 (byte 6 6) byte4)))))))
   utf8->string-aref
   string->utf8
-  #+sb-unicode :base-string-direct-mapping #+sb-unicode t)
+  #+sb-unicode :base-string-direct-mapping #+sb-unicode t
+  :single-octet-limit #x80)
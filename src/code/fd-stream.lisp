@@ -386,53 +386,94 @@
                               (write-output-from-queue stream)))))
     new))
 
+;;; Write as much of the output queue of STREAM as one system call will
+;;; take. Return the number of bytes written or NIL, the errno, and the
+;;; number of bytes that were offered.
+(defun write-queued-buffers (stream)
+  (let ((queue (fd-stream-output-queue stream)))
+    #+win32
+    (let* ((buffer (car queue))
+           (head (buffer-head buffer))
+           (length (- (buffer-tail buffer) head)))
+      (multiple-value-bind (count errno)
+          (sb-unix:unix-write (fd-stream-fd stream) (buffer-sap buffer)
+                              head length)
+        (values count errno length)))
+    ;; A stream whose reader is slow can pile up many buffers,
+    ;; so gather several into one writev().
+    #-win32
+    (with-alien ((iov (array (struct sb-unix:iovec) 16)))
+      (let ((n 0) (total 0))
+        (declare (index n total))
+        (dolist (buffer queue)
+          (when (= n 16)
+            (return))
+          (let* ((head (buffer-head buffer))
+                 (length (- (buffer-tail buffer) head)))
+            (declare (index head length))
+            (aver (>= length 0))
+            (setf (slot (deref iov n) 'sb-unix:iov-base)
+                  (sap+ (buffer-sap buffer) head)
+                  (slot (deref iov n) 'sb-unix:iov-len) length)
+            (incf n)
+            (incf total length)))
+        (multiple-value-bind (count errno)
+            (sb-unix:unix-writev (fd-stream-fd stream) (alien-sap iov) n)
+          (values count errno total))))))
+
 ;;; This is called by the FD-HANDLER for the stream when output is
 ;;; possible.
 (defun write-output-from-queue (stream)
   (aver (fd-stream-serve-events stream))
   (synchronize-stream-output stream)
   (let (not-first-p)
-    (tagbody
-     :pop-buffer
-       (let* ((buffer (pop (fd-stream-output-queue stream)))
-              (head (buffer-head buffer))
-              (length (- (buffer-tail buffer) head)))
-         (declare (index head length))
-         (aver (>= length 0))
-         (multiple-value-bind (count errno)
-             (sb-unix:unix-write (fd-stream-fd stream) (buffer-sap buffer)
-                                 head length)
-           (cond ((eql count length)
-                  ;; Complete write, see if we can do another right
-                  ;; away, or remove the handler if we're done.
-                  (release-buffer buffer)
-                  (cond ((fd-stream-output-queue stream)
-                         (setf not-first-p t)
-                         (go :pop-buffer))
-                        (t
-                         (let ((handler (fd-stream-handler stream)))
-                           (aver handler)
-                           (setf (fd-stream-handler stream) nil)
-                           (remove-fd-handler handler)))))
-                 (count
-                  ;; Partial write. Update buffer status and requeue.
-                  (aver (< count length))
-                  ;; Do not use INCF! Another thread might have moved head.
-                  (setf (buffer-head buffer) (+ head count))
-                  (push buffer (fd-stream-output-queue stream)))
-                 (not-first-p
-                  ;; We tried to do multiple writes, and finally our
-                  ;; luck ran out. Requeue.
-                  (push buffer (fd-stream-output-queue stream)))
-                 (t
-                  ;; Could not write on the first try at all!
-                  #+win32
-                  (simple-stream-perror +write-failed+ stream errno)
-                  #-win32
-                  (if (= errno sb-unix:ewouldblock)
-                      (bug "Unexpected blocking in WRITE-OUTPUT-FROM-QUEUE.")
-                      (simple-stream-perror +write-failed+
-                                            stream errno))))))))
+    (loop
+      (multiple-value-bind (count errno total)
+          (write-queued-buffers stream)
+        (declare (index total))
+        (unless count
+          (when not-first-p
+            ;; We tried to do multiple writes, and finally our
+            ;; luck ran out.
+            (return))
+          ;; Could not write on the first try at all!
+          #+win32
+          (simple-stream-perror +write-failed+ stream errno)
+          #-win32
+          (if (= errno sb-unix:ewouldblock)
+              (bug "Unexpected blocking in WRITE-OUTPUT-FROM-QUEUE.")
+              (simple-stream-perror +write-failed+ stream errno)))
+        ;; Release the buffers that were written completely, and
+        ;; advance the head of the one that was written partially.
+        (let ((left count))
+          (declare (index left))
+          (loop
+            (let* ((buffer (car (fd-stream-output-queue stream)))
+                   (head (buffer-head buffer))
+                   (length (- (buffer-tail buffer) head)))
+              (declare (index head length))
+              (when (> length left)
+                ;; Do not use INCF! Another thread might have moved head.
+                (setf (buffer-head buffer) (+ head left))
+                (return))
+              (pop (fd-stream-output-queue stream))
+              (release-buffer buffer)
+              (decf left length)
+              (unless (fd-stream-output-queue stream)
+                (return)))))
+        (cond ((not (fd-stream-output-queue stream))
+               ;; Done, remove the handler.
+               (let ((handler (fd-stream-handler stream)))
+                 (aver handler)
+                 (setf (fd-stream-handler stream) nil)
+                 (remove-fd-handler handler))
+               (return))
+              ((< count total)
+               ;; Partial write, wait for the handler to be called again.
+               (return))
+              (t
+               ;; There were more buffers than one call takes.
+               (setf not-first-p t))))))
   nil)
 
 ;;; Try to write THING directly to STREAM without buffering, if
@@ -1439,20 +1480,26 @@
 
 (defmacro define-unibyte-external-format
     (canonical-name (&rest other-names)
-     out-form in-form octets-to-string-symbol string-to-octets-symbol)
+     out-form in-form octets-to-string-symbol string-to-octets-symbol
+     &rest keys)
   `(define-external-format/variable-width (,canonical-name ,@other-names)
      t #\? 1
      ,out-form
      1
      ,in-form
      ,octets-to-string-symbol
-     ,string-to-octets-symbol))
+     ,string-to-octets-symbol
+     ,@keys))
 
+;;; If SINGLE-OCTET-LIMIT is given, each character whose code is below it
+;;; is encoded as the one octet of the same value, and vice versa, as for
+;;; ASCII in UTF-8. Runs of such characters are then copied between the
+;;; stream's buffer and the string by a loop that skips OUT-EXPR and IN-EXPR.
 (defmacro define-external-format/variable-width
     (external-format output-restart replacement-character
      out-size-expr out-expr in-size-expr in-expr
      octets-to-string-sym string-to-octets-sym
-     &key base-string-direct-mapping)
+     &key base-string-direct-mapping single-octet-limit)
   (let* ((name (first external-format))
          (out-function (symbolicate "OUTPUT-BYTES/" name))
          (format (format nil "OUTPUT-CHAR-~A-~~A-BUFFERED" (string name)))
@@ -1493,6 +1540,20 @@
                          `(progn))
                      (do* ()
                           ((or (= start end) (< (- len tail) 4)))
+                       ,@(when single-octet-limit
+                           `((let ((bits (char-code (aref string start))))
+                               (when (< bits ,single-octet-limit)
+                                 (let ((stop (min end (+ start (- len tail)))))
+                                   (declare (type index stop))
+                                   (loop (setf (sap-ref-8 sap tail) bits)
+                                         (incf tail)
+                                         (incf start)
+                                         (when (or (= start stop)
+                                                   (>= (setq bits (char-code (aref string start)))
+                                                       ,single-octet-limit))
+                                           (return))))
+                                 (setf (buffer-tail obuf) tail)
+                                 (go next)))))
                        (let* ((byte (aref string start))
                               (bits (char-code byte))
                               (size ,out-size-expr))
@@ -1500,7 +1561,8 @@
                          ,out-expr
                          (incf tail size)
                          (setf (buffer-tail obuf) tail)
-                         (incf start)))
+                         (incf start))
+                       ,@(when single-octet-limit '(next)))
                      (go flush))
                   ;; Exited via RETURN-FROM OUTPUT-NOTHING: skip the current character.
                   (incf start))))
@@ -1554,6 +1616,17 @@
             ;; Copy data from stream buffer into user's buffer.
             (do ((size nil nil))
                 ((or (= tail head) (= requested total-copied)))
+              ,@(when single-octet-limit
+                  `((let ((byte (sap-ref-8 sap head)))
+                      (when (< byte ,single-octet-limit)
+                        (loop (setf (aref buffer (+ start total-copied)) (code-char byte))
+                              (incf total-copied)
+                              (incf head)
+                              (when (or (= head tail) (= requested total-copied)
+                                        (>= (setq byte (sap-ref-8 sap head))
+                                            ,single-octet-limit))
+                                (return)))
+                        (go next)))))
               (setf decode-break-reason
                     (block decode-break-reason
                       ,@(when (consp in-size-expr)
@@ -1586,7 +1659,8 @@
                 ;; we might have been given stuff to use instead, so
                 ;; we have to return (and trust our caller to know
                 ;; what to do about TOTAL-COPIED being 0).
-                (return-from ,in-function total-copied)))
+                (return-from ,in-function total-copied))
+              ,@(when single-octet-limit '(next)))
             (setf (buffer-head ibuf) head)
             ;; Maybe we need to refill the stream buffer.
             (cond ( ;; If was data in the stream buffer, we're done.
@@ -2584,6 +2658,116 @@
               (when new-if-does-not-exist
                 (setf if-does-not-exist new-if-does-not-exist
                       if-does-not-exist-given t)))))))))
+;;;; copying between streams
+
+;;; The element type of a buffer for copying from STREAM
+(defun copy-buffer-element-type (stream)
+  (let ((type (stream-element-type stream)))
+    (if (eq type :default) '(unsigned-byte 8) type)))
+
+;;; True if the kernel can move octets to or from STREAM
+;;; without making its buffers disagree with the descriptor.
+#+linux
+(defun fd-stream-raw-p (stream direction)
+  (and (fd-stream-p stream)
+       (eql (fd-stream-element-size stream) 1)
+       (not (eq (fd-stream-element-mode stream) 'character))
+       (ecase direction
+         (:input (and (fd-stream-ibuf stream)
+                      (not (ansi-stream-cin-buffer stream))
+                      (not (fd-stream-eof-forced-p stream))
+                      (zerop (length (fd-stream-instead stream)))))
+         (:output (fd-stream-obuf stream)))))
+
+;;; The number of octets read from the descriptor of STREAM
+;;; that the stream hasn't returned yet
+#+linux
+(defun fd-stream-buffered-input (stream)
+  (let ((ibuf (fd-stream-ibuf stream)))
+    (+ (if (ansi-stream-in-buffer stream)
+           (- +ansi-stream-in-buffer-length+ (ansi-stream-in-index stream))
+           0)
+       (- (buffer-tail ibuf) (buffer-head ibuf)))))
+
+(defun copy-stream (input output &optional count)
+  "Copy the elements of INPUT to OUTPUT until the end of INPUT, or until
+COUNT elements have been copied if COUNT is given. Return the number of
+elements copied.
+
+On Linux, if INPUT and OUTPUT are FD-STREAMs of octets, the kernel moves
+the data with copy_file_range(), sendfile() or splice(), whichever works
+for the two descriptors, so that it doesn't pass through Lisp. Otherwise
+the elements are passed along with READ-SEQUENCE and WRITE-SEQUENCE."
+  (declare (type (or null index) count))
+  (let ((copied 0))
+    (declare (type index copied))
+    (flet ((remaining ()
+             (if count (- count copied) most-positive-fixnum)))
+      #+linux
+      (when (and (fd-stream-raw-p input :input)
+                 (fd-stream-raw-p output :output))
+        ;; What INPUT has buffered goes first, by way of OUTPUT's buffer.
+        (let ((n (min (fd-stream-buffered-input input) (remaining))))
+          (when (plusp n)
+            (let ((buffer (make-array n :element-type
+                                      (copy-buffer-element-type input))))
+              (read-sequence buffer input)
+              (write-sequence buffer output)
+              (incf copied n))))
+        (finish-output output)
+        (when (output-stream-p input)
+          (finish-output input))
+        (setf (fd-stream-listen input) nil)
+        (let ((in (fd-stream-fd input))
+              (out (fd-stream-fd output))
+              (how 0)
+              (moved nil))
+          (flet ((wait (stream fd direction)
+                   (or (wait-until-fd-usable fd direction
+                                             (fd-stream-timeout stream) nil)
+                       (signal-timeout 'io-timeout
+                                       :stream stream
+                                       :direction direction
+                                       :seconds (fd-stream-timeout stream)))))
+            (loop
+              (let ((want (min (remaining) (1- (ash 1 30)))))
+                (when (zerop want)
+                  (return-from copy-stream copied))
+                (multiple-value-bind (n errno)
+                    (sb-unix:unix-copy-fd-range in out want how)
+                  (cond ((eq n :unsupported)
+                         (if (< how 2)
+                             (incf how)
+                             (return)))
+                        ((eql n 0)
+                         ;; copy_file_range() sees files in /proc as empty
+                         (if (and (eql how 0) (not moved))
+                             (incf how)
+                             (return-from copy-stream copied)))
+                        (n
+                         (incf copied n)
+                         (setq moved t))
+                        ((eql errno sb-unix:ewouldblock)
+                         (wait output out :output)
+                         (wait input in :input))
+                        ((eql errno sb-unix:eintr))
+                        (t
+                         (simple-stream-perror "Couldn't copy from ~S to ~S"
+                                               input errno output)))))))))
+      ;; The descriptors are in sync with the streams at this point
+      ;; if the kernel gave up, so we can carry on here.
+      (let ((buffer (make-array (min (remaining) 65536)
+                                :element-type (copy-buffer-element-type input))))
+        (loop
+          (let ((want (min (length buffer) (remaining))))
+            (when (zerop want)
+              (return copied))
+            (let ((n (read-sequence buffer input :end want)))
+              (write-sequence buffer output :end n)
+              (incf copied n)
+              (when (< n want)
+                (return copied)))))))))
+
 ;;;; miscellany
 
 ;;; the Unix way to beep
@@ -0,0 +1,226 @@
+;;;; Conversions between floats and decimals on word arithmetic: the
+;;;; shortest digits of a float by Schubfach, for the printer, and the
+;;;; float nearest to a decimal by Eisel and Lemire, for the reader.
+;;;; Both fall back on the exact algorithms with bignums, in print.lisp
+;;;; and reader.lisp, for what they don't cover.
+
+;;;; This software is part of the SBCL system. See the README file for
+;;;; more information.
+;;;;
+;;;; This software is derived from the CMU CL system, which was
+;;;; written at Carnegie Mellon University and released into the
+;;;; public domain. The software is in the public domain and is
+;;;; provided with absolutely no warranty. See the COPYING and CREDITS
+;;;; files for more information.
+
+(in-package "SB-IMPL")
+
+#+64-bit
+(progn
+
+;;;; Shortest digits
+;;;;
+;;;; Raffaello Giulietti, "The Schubfach way to render doubles", 2020,
+;;;; as in java.lang.DoubleToDecimal. The digits are the same as those
+;;;; of the free-format algorithm of Burger and Dybvig in %FLONUM-TO-DIGITS:
+;;;; the fewest digits that read back as the float, and of those the
+;;;; nearest to it. Where two are equally near, the greater wins, as in
+;;;; %FLONUM-TO-DIGITS, rather than the even one.
+
+;;; floor(Q log10(2)), floor(Q log10(3/4 2)) and floor(Q log2(10)),
+;;; for the exponents of double-floats.
+(declaim (inline flog10-pow2 flog10-three-quarters-pow2 flog2-pow10))
+(defun flog10-pow2 (q)
+  (declare (type (integer -2000 2000) q))
+  (ash (* q 661971961083) -41))
+(defun flog10-three-quarters-pow2 (q)
+  (declare (type (integer -2000 2000) q))
+  (ash (- (* q 661971961083) 274743187321) -41))
+(defun flog2-pow10 (q)
+  (declare (type (integer -2000 2000) q))
+  (ash (* q 913124641741) -38))
+
+(defconstant schubfach-min-k -324)
+(defconstant schubfach-max-k 292)
+
+;;; For each K, G = floor(10^-K 2^(125 - floor(log2(10^-K)))) + 1,
+;;; a 126-bit approximation of 10^-K from above, as two 63-bit halves.
+(declaim (type (simple-array word (*)) **schubfach-g**))
+(define-load-time-global **schubfach-g**
+    (let ((table (make-array (* 2 (1+ (- schubfach-max-k schubfach-min-k)))
+                             :element-type 'word)))
+      (loop for k from schubfach-min-k to schubfach-max-k
+            for i from 0 by 2
+            do (let* ((shift (- 125 (flog2-pow10 (- k))))
+                      (g (1+ (if (<= k 0)
+                                 (ash (expt 10 (- k)) shift)
+                                 (floor (ash 1 shift) (expt 10 k))))))
+                 (setf (aref table i) (ash g -63)
+                       (aref table (1+ i)) (ldb (byte 63 0) g))))
+      table))
+
+;;; The 64 bits above the 127th of G CP, rounded to odd: with the lowest
+;;; bit set if any of the bits below are.
+(declaim (inline schubfach-rop))
+(defun schubfach-rop (g1 g0 cp)
+  (declare (type word g1 g0 cp))
+  (let* ((x1 (%multiply-high g0 cp))
+         (y0 (logand (* g1 cp) most-positive-word))
+         (y1 (%multiply-high g1 cp))
+         (z (logand (+ (ash y0 -1) x1) most-positive-word))
+         (vbp (logand (+ y1 (ash z -63)) most-positive-word)))
+    (logior vbp (ash (logand (+ (ldb (byte 63 0) z) (ldb (byte 63 0) -1))
+                             most-positive-word)
+                     -63))))
+
+;;; Return D and K such that D 10^K has the digits that %FLONUM-TO-DIGITS
+;;; would produce for C 2^Q, perhaps followed by zeros, where the gap
+;;; below C 2^Q is half of the one above if ASYMMETRIC.
+(defun schubfach (c q asymmetric)
+  (declare (type (unsigned-byte 53) c)
+           (type (integer -1074 971) q)
+           (optimize speed (safety 0)))
+  (let* ((out (logand c 1))
+         (cb (ash c 2))
+         (cbr (+ cb 2))
+         (cbl (if asymmetric (- cb 1) (- cb 2)))
+         (k (if asymmetric (flog10-three-quarters-pow2 q) (flog10-pow2 q)))
+         (h (+ q (flog2-pow10 (- k)) 2))
+         (table **schubfach-g**)
+         (i (* 2 (- k schubfach-min-k)))
+         (g1 (aref table i))
+         (g0 (aref table (1+ i)))
+         (vb (schubfach-rop g1 g0 (ash cb h)))
+         (vbl (schubfach-rop g1 g0 (ash cbl h)))
+         (vbr (schubfach-rop g1 g0 (ash cbr h)))
+         (s (ash vb -2)))
+    (declare (type (integer 2 5) h)
+             (type (unsigned-byte 62) vb vbl vbr))
+    ;; One digit fewer, if there is such a decimal in the interval
+    ;; and only one of the two around the float
+    (when (>= s 100)
+      (let* ((sp10 (* 10 (floor s 10)))
+             (tp10 (+ sp10 10))
+             (upin (<= (+ vbl out) (ash sp10 2)))
+             (wpin (<= (+ (ash tp10 2) out) vbr)))
+        (unless (eq upin wpin)
+          (return-from schubfach (values (if upin sp10 tp10) k)))))
+    (let* ((tt (1+ s))
+           (uin (<= (+ vbl out) (ash s 2)))
+           (win (<= (+ (ash tt 2) out) vbr)))
+      (values (cond ((neq uin win) (if uin s tt))
+                    ((< vb (ash (+ s tt) 1)) s)
+                    (t tt))
+              k))))
+
+;;; Return the digits of FLOAT, a positive SINGLE-FLOAT or DOUBLE-FLOAT,
+;;; as an integer D without trailing zeros, and the exponent K such that
+;;; FLOAT is about D 10^K. Return NIL for subnormals: %FLONUM-TO-DIGITS
+;;; gives them all the digits of a normal float, which these can't.
+(defun float-shortest-decimal (float)
+  (multiple-value-bind (f e) (integer-decode-float float)
+    (multiple-value-bind (digits min-e)
+        (etypecase float
+          (single-float (values sb-vm:single-float-digits
+                                (- 2 sb-vm:single-float-bias sb-vm:single-float-digits)))
+          (double-float (values sb-vm:double-float-digits
+                                (- 2 sb-vm:double-float-bias sb-vm:double-float-digits))))
+      (when (= (integer-length f) digits)
+        ;; The same test as %FLONUM-TO-DIGITS for the narrower gap below
+        ;; a power of two
+        (multiple-value-bind (d k)
+            (schubfach f e (and (/= e min-e) (= f (ash 1 (1- digits)))))
+          (declare (type (unsigned-byte 62) d) (fixnum k))
+          (loop (multiple-value-bind (quotient remainder) (floor d 10)
+                  (unless (zerop remainder)
+                    (return (values d k)))
+                  (setf d quotient)
+                  (incf k))))))))
+
+;;;; Nearest floats
+;;;;
+;;;; Daniel Lemire, "Number Parsing at a Gigabyte per Second", 2021,
+;;;; after Michael Eisel, as in the fast_float library.
+
+(defconstant eisel-lemire-min-q -342)
+(defconstant eisel-lemire-max-q 308)
+
+;;; For each Q, 5^Q normalized to 128 bits, most significant word first.
+;;; From below for Q >= 0, from above for Q < 0.
+(declaim (type (simple-array word (*)) **eisel-lemire-powers**))
+(define-load-time-global **eisel-lemire-powers**
+    (let ((table (make-array (* 2 (1+ (- eisel-lemire-max-q eisel-lemire-min-q)))
+                             :element-type 'word)))
+      (loop for q from eisel-lemire-min-q to eisel-lemire-max-q
+            for i from 0 by 2
+            do (let ((p (if (>= q 0)
+                            (let ((p (expt 5 q)))
+                              (ash p (- 128 (integer-length p))))
+                            (let* ((power5 (expt 5 (- q)))
+                                   (z (integer-length (1- power5)))
+                                   (c (1+ (floor (ash 1 (if (>= q -27)
+                                                            (+ z 127)
+                                                            (+ (* 2 z) 128)))
+                                                 power5))))
+                              (ash c (min 0 (- 128 (integer-length c))))))))
+                 (setf (aref table i) (ash p -64)
+                       (aref table (1+ i)) (ldb (byte 64 0) p))))
+      table))
+
+;;; Return the float of FORMAT, SINGLE-FLOAT or DOUBLE-FLOAT, nearest
+;;; to W 10^Q, or NIL if it is subnormal, too large, or too close to
+;;; halfway between two floats to tell with 128 bits.
+(defun decimal-to-float (w q format)
+  (declare (type word w) (type fixnum q)
+           (optimize speed (safety 0)))
+  (when (or (zerop w) (< q eisel-lemire-min-q) (> q eisel-lemire-max-q))
+    (return-from decimal-to-float nil))
+  (multiple-value-bind (mantissa-bits min-exponent infinite-power
+                        min-round-to-even max-round-to-even)
+      (ecase format
+        (single-float (values 23 -127 #xff -17 10))
+        (double-float (values 52 -1023 #x7ff -4 23)))
+    (let* ((lz (- 64 (integer-length w)))
+           (w (logand (ash w lz) most-positive-word))
+           (table **eisel-lemire-powers**)
+           (i (* 2 (- q eisel-lemire-min-q)))
+           (hi (%multiply-high w (aref table i)))
+           (lo (logand (* w (aref table i)) most-positive-word))
+           (mask (ash most-positive-word (- (+ mantissa-bits 3)))))
+      (declare (type word hi lo))
+      ;; Only when the low bits of the product with the upper word are
+      ;; all ones might the lower word carry into them.
+      (when (= (logand hi mask) mask)
+        (let ((hi2 (%multiply-high w (aref table (1+ i)))))
+          (setf lo (logand (+ lo hi2) most-positive-word))
+          (when (> hi2 lo)
+            (incf hi))
+          (when (and (= lo most-positive-word) (or (< q -27) (> q 55)))
+            (return-from decimal-to-float nil))))
+      (let* ((upper (ash hi -63))
+             (shift (+ upper (- 64 mantissa-bits 3)))
+             (mantissa (ash hi (- shift)))
+             (power2 (- (+ (ash (* (+ 152170 65536) q) -16) 63 upper)
+                        lz min-exponent)))
+        (declare (type word mantissa) (fixnum power2))
+        (when (<= power2 0)
+          (return-from decimal-to-float nil))
+        ;; Halfway between two floats: round to even, which means down
+        ;; when the mantissa is odd.
+        (when (and (<= lo 1) (<= min-round-to-even q max-round-to-even)
+                   (= (logand mantissa 3) 1)
+                   (= (logand (ash mantissa shift) most-positive-word) hi))
+          (setf mantissa (logand mantissa (lognot 1))))
+        (setf mantissa (ash (+ mantissa (logand mantissa 1)) -1))
+        (when (>= mantissa (ash 2 mantissa-bits))
+          (setf mantissa (ash 1 mantissa-bits))
+          (incf power2))
+        (when (>= power2 infinite-power)
+          (return-from decimal-to-float nil))
+        (let ((bits (logior (ash power2 mantissa-bits)
+                            (ldb (byte mantissa-bits 0) mantissa))))
+          (if (eq format 'single-float)
+              (make-single-float bits)
+              (%make-double-float bits)))))))
+
+) ; #+64-bit
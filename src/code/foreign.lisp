@@ -55,6 +55,7 @@ if the symbol isn't found."
 
 ;;; Cleanups before saving a core
 (defun foreign-deinit ()
+  (save-linkage-table)
   ;; Clobber list of undefineds. Reinit will figure it all out again.
   (setf (cdr *linkage-info*) nil)
   #+os-provides-dlopen
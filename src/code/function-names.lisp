@@ -54,6 +54,13 @@ use as a BLOCK name in the function in question."
           (cons (unless (member (car fun) '(cas setf))
                   (valid-function-name-p fun))))))))
 
+;;; (UNBOXED-RETURN NAME) is the companion of the function NAME which
+;;; returns its result unboxed. See SB-C::UNBOXED-RETURN-CALL-TRANSFORM.
+(defun %check-unboxed-return-fun-name (name)
+  (let ((tail (cdr name)))
+    (when (and (consp tail) (null (cdr tail)) (symbolp (car tail)))
+      (values t (car tail)))))
+
 ;;; FBOUNDP wants to know what names are valid early on in COLD-INIT.
 (defun !function-names-init ()
   (setq *valid-fun-names-alist* nil)
@@ -62,7 +69,8 @@ use as a BLOCK name in the function in question."
   ;; 'cas.lisp' doesn't need to know this technique for sharing the parser,
   ;; so the name syntax is defined here instead of there.
   (%define-fun-name-syntax 'setf #'%check-setf-fun-name)
-  (%define-fun-name-syntax 'cas #'%check-setf-fun-name))
+  (%define-fun-name-syntax 'cas #'%check-setf-fun-name)
+  (%define-fun-name-syntax 'unboxed-return #'%check-unboxed-return-fun-name))
 
 #+sb-xc-host
 (!function-names-init)
@@ -30,7 +30,7 @@
 (declaim (inline dynamic-usage))
 (defun dynamic-usage ()
   #+gencgc
-  (extern-alien "bytes_allocated" os-vm-size-t)
+  (alien-funcall (extern-alien "dynamic_usage" (function os-vm-size-t)))
   #-gencgc
   (truly-the word
              (- (sap-int (sb-c::dynamic-space-free-pointer))
@@ -102,6 +102,18 @@ and submit it as a patch."
 triggered during thread exits. In a multithreaded environment these hooks may
 run in any thread.")
 
+(define-load-time-global *memory-pressure-hooks* nil
+  "Called after *AFTER-GC-HOOKS* when a garbage collection leaves the heap
+close to its soft limit (see SOFT-HEAP-LIMIT), so that caches can drop
+entries before the process runs out of memory. They are called in the same
+circumstances as *AFTER-GC-HOOKS*. On CheneyGC platforms they are never
+called.")
+
+(declaim (inline memory-pressure-p))
+(defun memory-pressure-p ()
+  #+gencgc (/= (extern-alien "gc_memory_pressure" int) 0)
+  #-gencgc nil)
+
 
 ;;;; internal GC
 
@@ -116,6 +128,46 @@ run in any thread.")
   (defun gc-stop-the-world ())
   (defun gc-start-the-world ()))
 
+;;; The layout of this must agree with 'gc_pause_histogram' in gc.h
+(defun gc-pause-histogram (&optional (result (make-array '(7 32) :element-type 'word)))
+  "Store into RESULT, a 7x32 array of WORD, and return the runtime's
+histograms of stop-the-world durations. Each row is a phase:
+  0 - time to safepoint, sampled once for each thread that was stopped,
+      only when threads are stopped with signals (#-sb-safepoint)
+  1 - root scanning
+  2 - scavenging of newspace (or marking, in a full mark-and-sweep)
+  3 - weak object processing
+  4 - freeing
+  5 - the whole time that the world was stopped
+  6 - the time until every other thread was stopped, sampled once per stop
+Column 0 counts samples under one microsecond, and column I > 0
+those from 2^(I-1) to 2^I microseconds.
+Counts keep increasing for the life of the process."
+  (declare (type (simple-array word (7 32)) result))
+  (let ((histogram (extern-alien "gc_pause_histogram" (array unsigned 7 32))))
+    (dotimes (i 7 result)
+      (dotimes (j 32)
+        (setf (aref result i j) (deref histogram i j))))))
+
+;;; The layout of this must agree with 'gc_stop_offenders' in gc.h
+(defun gc-stop-offenders ()
+  "Return a list of the threads that most delayed stopping the world for
+garbage collection, worst first. Each element is a list of
+  (MICROSECONDS PC OS-TID)
+for one stop of the world, where MICROSECONDS is the time from the start of
+the stop until the thread was seen to be stopped, PC is the address at which
+the thread stopped, or 0 if unknown, and OS-TID is the thread's kernel
+identifier as returned by SB-THREAD::THREAD-OS-TID. At most 16 entries are
+kept, for the life of the process."
+  (let ((table (extern-alien "gc_stop_offenders" (array unsigned 48)))
+        (result))
+    (dotimes (i 16 (nreverse result))
+      (let ((nsec (deref table (* i 3))))
+        (when (zerop nsec) (return (nreverse result)))
+        (push (list (floor nsec 1000) (deref table (+ (* i 3) 1))
+                    (deref table (+ (* i 3) 2)))
+              result)))))
+
 (declaim (inline dynamic-space-size))
 (defun dynamic-space-size ()
   "Size of the dynamic space in bytes."
@@ -237,12 +289,13 @@ run in any thread.")
 #+sb-thread
 (defun post-gc ()
   (sb-impl::finalizer-thread-notify)
-  (alien-funcall (extern-alien "empty_thread_recyclebin" (function void)))
   ;; Post-GC actions are invoked synchronously by the GCing thread,
   ;; which is an arbitrary one. If those actions aquire any locks, or are sensitive
   ;; to the state of *ALLOW-WITH-INTERRUPTS*, any deadlocks of what-have-you
   ;; are user error. Hooks need to be sufficiently uncomplicated as to be harmless.
-  (call-hooks "after-GC" *after-gc-hooks* :on-error :warn))
+  (call-hooks "after-GC" *after-gc-hooks* :on-error :warn)
+  (when (memory-pressure-p)
+    (call-hooks "memory pressure" *memory-pressure-hooks* :on-error :warn)))
 
 #-sb-thread
 (defun post-gc ()
@@ -293,11 +346,14 @@ run in any thread.")
                (or (and (sb-impl::hash-table-culled-values
                          (sb-impl::finalizer-id-map sb-impl::**finalizer-store**))
                         (not sb-impl::*in-a-finalizer*))
-                   *after-gc-hooks*))
+                   *after-gc-hooks*
+                   (and *memory-pressure-hooks* (memory-pressure-p))))
       (sb-thread::without-thread-waiting-for ()
         (with-interrupts
           (run-pending-finalizers)
-          (call-hooks "after-GC" *after-gc-hooks* :on-error :warn)))))
+          (call-hooks "after-GC" *after-gc-hooks* :on-error :warn)
+          (when (memory-pressure-p)
+            (call-hooks "memory pressure" *memory-pressure-hooks* :on-error :warn))))))
 
 ;;; This is the user-advertised garbage collection function.
 (defun gc (&key (full nil) (gen 0) &allow-other-keys)
@@ -384,6 +440,23 @@ Note: currently changes to this value are lost when saving core."
 (define-symbol-macro sb-vm:dynamic-space-end
     (+ (dynamic-space-size) sb-vm:dynamic-space-start))
 
+(defun soft-heap-limit ()
+  "The number of bytes of dynamic space in use, as by DYNAMIC-USAGE, that
+the garbage collector tries to stay under, or NIL if there is no such limit.
+Near the limit collections happen sooner, free memory goes back to the
+operating system after each of them, and *MEMORY-PRESSURE-HOOKS* are
+called. A collection that starts above it collects all generations. This
+can be set with SETF, or with the runtime option --soft-heap-limit. On
+Linux it defaults to 3/4 of the memory.max of the cgroup of the process, if
+it has one."
+  (let ((limit (extern-alien "gencgc_soft_heap_limit" os-vm-size-t)))
+    (if (zerop limit) nil limit)))
+
+(defun (setf soft-heap-limit) (limit)
+  (declare (type (or null (and fixnum unsigned-byte)) limit))
+  (setf (extern-alien "gencgc_soft_heap_limit" os-vm-size-t) (or limit 0))
+  limit)
+
 (define-alien-variable ("gc_logfile" %gc-logfile) (* char))
 
 (defun (setf gc-logfile) (pathname)
@@ -405,6 +478,126 @@ statistics are appended to it."
     (when val
       (native-pathname val))))
 
+(define-alien-variable ("gc_heap_dump_pathname" %gc-heap-dump-pathname) (* char))
+(define-alien-variable ("gc_heap_dump_errno" %gc-heap-dump-errno) int)
+
+(defun write-heap-dump (pathname)
+  "Collect garbage in all generations, then write the objects which remain in
+the heap, the references between them, and the roots that keep them alive to
+PATHNAME, for analysis by other programs. The format is described in the SBCL
+source file src/runtime/heapdump.c. The dump is written while the world is
+stopped, using the garbage collector's helper threads if there are any.
+Return PATHNAME.
+
+Experimental: interface subject to change."
+  (let ((namestring (make-alien-string
+                     (native-namestring (translate-logical-pathname pathname)
+                                        :as-file t))))
+    (setf %gc-heap-dump-errno 0
+          %gc-heap-dump-pathname namestring)
+    (unwind-protect (gc :full t)
+      (setf %gc-heap-dump-pathname nil)
+      (free-alien namestring))
+    (let ((errno %gc-heap-dump-errno))
+      (unless (zerop errno)
+        (simple-perror (format nil "Couldn't write heap dump to ~S" pathname)
+                       :errno errno)))
+    pathname))
+
+;;;; Arenas
+
+(defstruct (arena (:constructor %make-arena (address))
+                  (:copier nil))
+  ;; The arena in the runtime, or 0 once destroyed
+  (address 0 :type word))
+
+(defvar *current-arena* nil)
+(declaim (type (or arena null) *current-arena*))
+
+(defun make-arena (&key (block-size (* 1024 1024)))
+  "Return an ARENA, memory outside of the heap that WITH-ARENA can allocate
+from, obtained from the operating system BLOCK-SIZE bytes at a time.
+
+Experimental: interface subject to change."
+  (declare (type (and fixnum unsigned-byte) block-size))
+  (let ((address (alien-funcall (extern-alien "arena_create"
+                                              (function os-vm-size-t os-vm-size-t))
+                                block-size)))
+    (when (zerop address)
+      (error "Couldn't create an arena"))
+    (%make-arena address)))
+
+(defun destroy-arena (arena)
+  "Free the memory of ARENA all at once, along with everything allocated in
+it, which must not be referenced afterwards. It is an error to destroy an
+arena that a thread is allocating from.
+
+Experimental: interface subject to change."
+  (declare (type arena arena))
+  (let ((address (arena-address arena)))
+    (when (zerop address)
+      (error "~S has already been destroyed." arena))
+    (when (zerop (alien-funcall (extern-alien "arena_destroy" (function int os-vm-size-t))
+                                address))
+      (error "~S is in use by a thread." arena))
+    (setf (arena-address arena) 0)
+    nil))
+
+(defun rewind-arena (arena)
+  "Free everything allocated in ARENA, which must not be referenced
+afterwards, keeping the memory of its first block for what is allocated in
+it next. Unlike a garbage collection, this doesn't stop other threads, so an
+arena that holds what one thread allocates for each unit of work can be
+rewound between units. It is an error to rewind an arena that a thread is
+allocating from.
+
+Experimental: interface subject to change."
+  (declare (type arena arena))
+  (let ((address (arena-address arena)))
+    (when (zerop address)
+      (error "~S has been destroyed." arena))
+    (when (zerop (without-gcing
+                   (alien-funcall (extern-alien "arena_rewind" (function int os-vm-size-t))
+                                  address)))
+      (error "~S is in use by a thread." arena))
+    arena))
+
+(defun call-with-arena (function arena)
+  (declare (type (or arena null) arena) (function function))
+  (when (and arena (zerop (arena-address arena)))
+    (error "~S has been destroyed." arena))
+  (flet ((switch (arena enter)
+           (without-gcing
+             (alien-funcall (extern-alien "arena_switch" (function void os-vm-size-t int))
+                            (if arena (arena-address arena) 0) enter))))
+    (let ((previous *current-arena*)
+          (*current-arena* arena))
+      (without-interrupts
+        (unwind-protect
+             (progn (switch arena 1)
+                    (with-local-interrupts (funcall function)))
+          (switch previous 0))))))
+
+(defmacro with-arena ((arena) &body body)
+  "Evaluate BODY with what the current thread allocates on the heap taken
+instead from ARENA, or from the heap if ARENA is NIL. Objects in an arena
+are neither collected nor moved, and are freed only by DESTROY-ARENA.
+
+The contract is not checked: no object in an arena may be referenced once
+it is destroyed, from the heap, from another arena or from anywhere else.
+That includes what interrupt handlers, after-GC hooks and anything else run
+by the thread inside BODY allocate, so that for instance an object cached in
+a global table must be made outside BODY, or by (WITH-ARENA (NIL) ...).
+Objects in arenas are roots of every garbage collection, as if they were in
+static space. A runtime built with DEBUG protects the memory of destroyed
+arenas instead of unmapping it, so that touching it faults, and the heap
+verifier reports pointers into it.
+
+Experimental: interface subject to change."
+  (let ((thunk (sb-xc:gensym "THUNK")))
+    `(dx-flet ((,thunk () ,@body))
+       (call-with-arena #',thunk ,arena))))
+
 (deftype generation-index ()
   `(integer 0 ,sb-vm:+pseudo-static-generation+))
 
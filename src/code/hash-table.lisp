@@ -94,6 +94,10 @@
   ;; The index vector. This may be larger than the capacity to help
   ;; reduce collisions.
   (index-vector nil :type (simple-array hash-table-index (*)))
+  ;; After an incremental doubling of the index vector, the number of buckets
+  ;; at the start of the lower half whose chains still hold the entries that
+  ;; belong to their partner in the upper half. See HASH-TABLE-BUCKET.
+  (unsplit-buckets 0 :type index)
   ;; This table parallels the KV vector, and is used to chain together
   ;; the hash buckets and the free list. A slot will only ever be in
   ;; one of these lists.
@@ -123,6 +127,10 @@
   ;; with nonsynchronized tables that are guarded by WITH-LOCKED-HASH-TABLE
   ;; or an equivalent "system" variant of the locking macro.
   (%lock nil #-c-headers-only :type #-c-headers-only (or null sb-thread:mutex))
+  ;; Odd while a thread holding the lock of a synchronized table modifies it,
+  ;; and advanced to the next even number when it is done.
+  ;; See WITH-HASH-TABLE-WRITE.
+  (%write-version 0 :type fixnum)
 
   ;; The 4 standard tests functions don't need these next 2 slots:
   ;; (TODO: possibly don't have them in all hash-tables)
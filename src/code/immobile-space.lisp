@@ -114,11 +114,16 @@
     (vector-push-extend (fill-pointer relocs) code-components)
     (values code-components relocs)))
 
-(defun sb-vm::statically-link-core (&key callers)
+;;; Statically link the calls through fdefns in the immobile code of CALLERS,
+;;; a list of function names, or of all immobile code if NIL. QUIET-PERIOD
+;;; is as for SB-VM::*STATIC-LINK-QUIET-PERIOD*.
+(defun sb-vm::statically-link-core (&key callers
+                                          ((:quiet-period sb-vm::*static-link-quiet-period*)))
   (do-immobile-code (code)
     (when (or (not callers)
               (and (plusp (code-n-entries code))
-                   (member (%simple-fun-name (%code-entry-point code 0)) callers)))
+                   (member (%simple-fun-name (%code-entry-point code 0)) callers
+                           :test 'equal)))
       (let* ((fixups)
              (code-begin (- (get-lisp-obj-address code) sb-vm:other-pointer-lowtag))
              (code-end (+ code-begin (sb-vm::code-object-size code)))
@@ -173,6 +178,11 @@
                  (cas (sap-ref-32 sap 0)
                       (ldb (byte 32 0) oldval)
                       (ldb (byte 32 0) newval)))))
+        (setf (gethash fdefn (or sb-vm::*static-unlink-times*
+                                 (setq sb-vm::*static-unlink-times*
+                                       (make-hash-table :test 'eq :weakness :key
+                                                        :synchronized t))))
+              (get-internal-real-time))
         (do-immobile-code (code)
           ;; Examine only those code components which potentially use FDEFN.
           (binding* ((constant-index (code-statically-links-fdefn-p code) :exit-if-null)
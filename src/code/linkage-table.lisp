@@ -27,6 +27,12 @@
     (list (make-hash-table :test 'equal :synchronized t)))
 (declaim (type (cons hash-table) *linkage-info*))
 
+;;; NIL, or a list (ENVIRONMENT OBJECTS . ENTRIES) made by
+;;; SAVE-LINKAGE-TABLE. OBJECTS is a vector of lists (NAMESTRING STAMP
+;;; ANCHOR-KEY ANCHOR-OFFSET), and ENTRIES a vector with for each index
+;;; of the linkage table NIL or a cons (OBJECT-INDEX . OFFSET).
+(define-load-time-global *saved-linkage* nil)
+
 (define-alien-variable undefined-alien-address unsigned)
 
 (macrolet ((dlsym-wrapper (&optional warn)
@@ -92,18 +98,28 @@
          (info *linkage-info*)
          (ht (car info))
          ;; for computing anew the list of undefined symbols
-         (notdef))
+         (notdef)
+         ;; where the symbols were found when the core was saved
+         (saved (when full-scan (saved-linkage-bases)))
+         (saved-bases (car saved))
+         (saved-entries (cdr saved)))
     (flet ((recheck (key index)
              (let* ((datap (listp key))
-                    (name (if datap (car key) key)))
+                    (name (if datap (car key) key))
+                    (entry (when (and saved (< index (length saved-entries)))
+                             (svref saved-entries index)))
+                    (base (when entry (svref saved-bases (car entry)))))
                ;; Symbols required for Lisp startup
                ;; will not be re-pointed to a different address ever.
                ;; Nor will those referenced by ELF core.
                (when (>= index n-prelinked)
-                 (multiple-value-bind (defined real-address) (dlsym-wrapper)
-                   (unless defined (push key notdef))
-                   (arch-write-linkage-table-entry index real-address
-                                                   (if datap 1 0)))))))
+                 (if base
+                     (arch-write-linkage-table-entry index (+ base (cdr entry))
+                                                     (if datap 1 0))
+                     (multiple-value-bind (defined real-address) (dlsym-wrapper)
+                       (unless defined (push key notdef))
+                       (arch-write-linkage-table-entry index real-address
+                                                       (if datap 1 0))))))))
     (with-system-mutex ((hash-table-lock ht))
       (if full-scan
           ;; Look up everything; this is for image restart or library unload.
@@ -113,4 +129,110 @@
           (dolist (key (cdr info))
             (recheck key (the (not null) (gethash key ht)))))
       (setf (cdr info) notdef)))))
+
+;;;; Remembering where foreign symbols were found
+;;;;
+;;;; Calling dlsym() again for each of thousands of foreign symbols
+;;;; takes a noticeable part of the startup of a large core. So
+;;;; SAVE-LISP-AND-DIE records, for each symbol that was found, which
+;;;; shared object (the runtime included) it was in, and its offset from
+;;;; the base of the object. On startup, an object is reused if it is
+;;;; the same file as when the core was saved, judging by its device,
+;;;; inode, size and modification times, and if one of its symbols is
+;;;; still found in it. Its base is then that symbol's address less its
+;;;; offset, and its other symbols need no lookup. Symbols that were
+;;;; undefined or in no object that passes are looked up as usual.
+
+;;; Things other than the objects themselves that can change where a
+;;; symbol is found
+(defun linkage-environment ()
+  (declare (special *shared-objects*))
+  (list #+os-provides-dlopen
+        (mapcar #'sb-alien::shared-object-namestring *shared-objects*)
+        (posix-getenv "LD_PRELOAD")
+        (posix-getenv "LD_LIBRARY_PATH")))
+
+;;; Return the file name of the shared object containing ADDRESS, and
+;;; its base address, or NIL.
+(defun shared-object-containing (address)
+  #-os-provides-dladdr (declare (ignore address))
+  #+os-provides-dladdr
+  (with-alien ((info (struct dl-info
+                             (filename c-string)
+                             (base unsigned)
+                             (symbol c-string)
+                             (symbol-address unsigned)))
+               (dladdr (function unsigned unsigned (* (struct dl-info)))
+                       :extern "dladdr"))
+    (unless (zerop (alien-funcall dladdr address (addr info)))
+      (let ((filename (slot info 'filename)))
+        (when (and filename (plusp (length filename)))
+          (values filename (slot info 'base)))))))
+
+(defun shared-object-file-stamp (namestring)
+  (multiple-value-bind (ok dev ino mode nlink uid gid rdev size atime mtime ctime)
+      (sb-unix:unix-stat namestring)
+    (declare (ignore mode nlink uid gid rdev atime))
+    (when ok
+      (list dev ino size mtime ctime))))
+
+;;; Called by FOREIGN-DEINIT, while the shared objects are still open
+;;; and before the list of undefined symbols is cleared.
+(defun save-linkage-table ()
+  (setq *saved-linkage* nil)
+  (let* ((n-prelinked (extern-alien "lisp_linkage_table_n_prelinked" int))
+         (info *linkage-info*)
+         (ht (car info))
+         (undefined (cdr info))
+         (entries (make-array (hash-table-count ht) :initial-element nil))
+         (objects (make-array 4 :fill-pointer 0 :adjustable t)))
+    (with-system-mutex ((hash-table-lock ht))
+      (dohash ((key index) ht)
+        (let ((name (if (listp key) (car key) key)))
+          (when (and (>= index n-prelinked)
+                     (< index (length entries))
+                     (not (member key undefined :test #'equal)))
+            (let ((address (find-dynamic-foreign-symbol-address name)))
+              (when address
+                (multiple-value-bind (namestring base)
+                    (shared-object-containing address)
+                  (when namestring
+                    (let ((object
+                            (or (position namestring objects
+                                          :key #'first :test #'string=)
+                                (vector-push-extend
+                                 (list namestring
+                                       (shared-object-file-stamp namestring)
+                                       key (- address base))
+                                 objects))))
+                      (when (second (aref objects object))
+                        (setf (svref entries index)
+                              (cons object (- address base)))))))))))))
+    (when (plusp (length objects))
+      (setq *saved-linkage*
+            (list* (linkage-environment) (coerce objects 'simple-vector) entries)))))
+
+;;; Return NIL, or a cons of a vector with the current base address
+;;; of each object in *SAVED-LINKAGE*, or NIL if it can't be reused,
+;;; and the vector of saved entries. *SAVED-LINKAGE* is cleared, as
+;;; it only describes the first lookup after startup.
+(defun saved-linkage-bases ()
+  (let ((saved *saved-linkage*))
+    (setq *saved-linkage* nil)
+    (when (and saved (equal (first saved) (linkage-environment)))
+      (flet ((object-base (object)
+               (destructuring-bind (namestring stamp anchor-key anchor-offset) object
+                 (let ((address (find-dynamic-foreign-symbol-address
+                                 (if (listp anchor-key) (car anchor-key) anchor-key))))
+                   (when address
+                     (multiple-value-bind (found-namestring base)
+                         (shared-object-containing address)
+                       (when (and found-namestring
+                                  (string= found-namestring namestring)
+                                  (= base (- address anchor-offset))
+                                  (equal stamp (shared-object-file-stamp namestring)))
+                         base)))))))
+        (let ((bases (map 'simple-vector #'object-base (second saved))))
+          (when (find-if #'identity bases)
+            (cons bases (cddr saved))))))))
 )
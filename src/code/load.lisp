@@ -248,10 +248,16 @@
             (code-char (fast-read-byte)))))
   string)
 ;;; Variation 2: base-string, transfer elements of type (unsigned-byte 8)
+;;; A base-char occupies one octet in the string as in the file,
+;;; so from an ANSI-STREAM the whole string is copied out of the buffer at once.
 (defun read-base-string-as-bytes (stream string &optional (length (length string)))
   (declare (type (simple-array base-char (*)) string)
            (type index length)
            (optimize speed))
+  #-sb-xc-host
+  (when (ansi-stream-p stream)
+    (read-n-bytes stream string 0 length)
+    (return-from read-base-string-as-bytes string))
   (with-fast-read-byte ((unsigned-byte 8) stream)
     (dotimes (i length)
       (setf (aref string i)
@@ -1116,6 +1122,19 @@
 ;;; fasl file header.)
 
 (define-load-time-global *show-new-code* nil)
+
+;;; With the --perf-map runtime option, tell the runtime the name and
+;;; address range of each function in CODE so that Linux perf can
+;;; symbolize samples in it. Call this once CODE has its debug-info.
+#-sb-xc-host
+(defun note-code-for-perf-map (code)
+  #+(and linux gencgc)
+  (unless (zerop (extern-alien "perf_map_enabled" int))
+    (without-gcing
+      (alien-funcall (extern-alien "perf_map_note_code" (function void unsigned))
+                     (logandc2 (get-lisp-obj-address code) sb-vm:lowtag-mask))))
+  #-(and linux gencgc)
+  (declare (ignore code)))
 (define-fop 17 :not-host (fop-load-code ((:operands header n-code-bytes n-fixups)))
   (let* ((n-simple-funs (read-unsigned-byte-32-arg (fasl-input-stream)))
          (n-named-calls (read-unsigned-byte-32-arg (fasl-input-stream)))
@@ -1156,6 +1175,18 @@
           ;; Boxed constants can be assigned only after figuring out where the range
           ;; of implicitly tagged words is, which requires knowing how many functions
           ;; are in the code component, which requires reading the code trailer.
+          ;; With MAP_JIT each store would make the code pages writable and
+          ;; executable again, so they are all copied in one go, in which
+          ;; GC must not move the objects out from under the copy.
+          #+darwin-jit
+          (with-pinned-objects (stack)
+            (without-gcing
+              (sb-vm::jit-copy-code-constants
+               (get-lisp-obj-address code)
+               (sap-int (sap+ (vector-sap stack) (ash ptr sb-vm:word-shift)))
+               sb-vm:code-constants-offset
+               n-constants)))
+          #-darwin-jit
           (let* ((header-index sb-vm:code-constants-offset)
                  (stack-index ptr))
             (declare (type index header-index stack-index))
@@ -1174,6 +1205,7 @@
               (incf stack-index)))
           ;; Now apply fixups. The fixups to perform are popped from the fasl stack.
           (sb-c::apply-fasl-fixups stack code n-fixups))
+        (note-code-for-perf-map code)
         (when *show-new-code*
           (let ((*print-pretty* nil))
             (format t "~&New code(~Db,load): ~A~%" (code-object-size code) code)))
@@ -113,7 +113,76 @@ tree structure resulting from the evaluation of EXPRESSION."
               entry-points
               (not (member name entry-points :test #'equal))))))
 
+;;; DOUBLE-FLOAT or WORD if the function to be defined as NAME with
+;;; LAMBDA-LIST can return its result unboxed to callers compiled after
+;;; it. It must take only required arguments, and its proclaimed FTYPE
+;;; return one DOUBLE-FLOAT, or one WORD which needn't be a FIXNUM.
+#-sb-xc-host
+(defun unboxed-return-kind (env name lambda-list)
+  (let ((ftype (and (symbolp name)
+                    (eq (info :function :where-from name) :declared)
+                    (not (save-inline-expansion-p name))
+                    (not (block-compilation-non-entry-point name))
+                    (sb-c:policy env (and (< debug 2) (> speed space)))
+                    (global-ftype name))))
+    (when (and (fun-type-p ftype)
+               (not (fun-type-optional ftype))
+               (not (fun-type-rest ftype))
+               (not (fun-type-keyp ftype))
+               (= (length (fun-type-required ftype)) (length lambda-list))
+               (every (lambda (arg)
+                        (and (symbolp arg) (not (member arg lambda-list-keywords))))
+                      lambda-list))
+      (let ((returns (fun-type-returns ftype)))
+        (when (or (not (values-type-p returns))
+                  (and (singleton-p (values-type-required returns))
+                       (null (values-type-optional returns))
+                       (null (values-type-rest returns))))
+          (let ((type (single-value-type returns)))
+            (cond ((eq type *empty-type*) nil)
+                  ((csubtypep type (specifier-type 'double-float))
+                   'double-float)
+                  ((and (csubtypep type (specifier-type 'word))
+                        (not (csubtypep type (specifier-type 'fixnum))))
+                   'word))))))))
+
+;;; Define the companion (UNBOXED-RETURN NAME) with the body, and NAME
+;;; as a call to it which boxes the result, for callers that don't know
+;;; of the companion.
+#-sb-xc-host
+(defun unboxed-return-defun (kind name lambda-list body)
+  (multiple-value-bind (forms decls doc) (parse-body body t)
+    (let ((companion `(unboxed-return ,name))
+          (result (make-symbol "RESULT"))
+          (high (make-symbol "HIGH"))
+          (low (make-symbol "LOW")))
+      `(progn
+         (declaim (ftype (function ,(mapcar #'type-specifier
+                                            (fun-type-required (global-ftype name)))
+                                   ,(sb-c::unboxed-return-values-type kind))
+                         ,companion))
+         ;; NAME first, since defining it forgets any old companion. Not
+         ;; by DEFUN, which would make another companion.
+         (eval-when (:compile-toplevel)
+           (sb-c:%compiler-defun ',name t nil nil)
+           (setf (info :function :unboxed-return ',name) ',kind))
+         (%defun ',name
+                 (named-lambda ,name ,lambda-list
+                   ,@(when doc (list doc))
+                   (multiple-value-bind (,high ,low) (funcall #',companion ,@lambda-list)
+                     ,(sb-c::unboxed-return-join-form kind high low))))
+         (defun ,companion ,lambda-list
+           ,@decls
+           (let ((,result (block ,name ,@forms)))
+             ,(sb-c::unboxed-return-split-form kind result)))
+         (%define-unboxed-return ',name ',kind)))))
+
 (flet ((defun-expander (env name lambda-list body snippet &optional source-form)
+  #-sb-xc-host
+  (let ((kind (and (not snippet) (unboxed-return-kind env name lambda-list))))
+    (when kind
+      (return-from defun-expander
+        (unboxed-return-defun kind name lambda-list body))))
   (multiple-value-bind (forms decls doc) (parse-body body t)
     ;; Maybe kill docstring, but only under the cross-compiler.
     #+(and (not sb-doc) sb-xc-host) (setq doc nil)
@@ -1925,7 +1994,7 @@ symbol-case giving up: case=((V U) (F))
          (index (dsd-index slotd))
          (type (dsd-type slotd))
          (casser
-           (case (dsd-raw-type slotd)
+           (case (and (not (dsd-packed-p slotd)) (dsd-raw-type slotd))
              ((t) '%instance-cas)
              #+(or arm64 ppc ppc64 riscv x86 x86-64)
              ((word) '%raw-instance-cas/word)
@@ -2080,6 +2149,10 @@ whose CAR is one of the following:
  CAR, CDR, FIRST, REST, SVREF, SYMBOL-PLIST, SYMBOL-VALUE, SVREF, SLOT-VALUE
  SB-MOP:STANDARD-INSTANCE-ACCESS, SB-MOP:FUNCALLABLE-STANDARD-INSTANCE-ACCESS,
 
+AREF of a SIMPLE-VECTOR, and on x86-64 of a (SIMPLE-ARRAY SB-EXT:WORD (*)),
+(SIMPLE-ARRAY (UNSIGNED-BYTE 32) (*)) or (SIMPLE-ARRAY FIXNUM (*)), whose
+elements are compared as numbers rather than by EQ,
+
 or the name of a DEFSTRUCT created accessor for a slot whose storage type
 is not raw. (Refer to the the \"Efficiency\" chapter of the manual
 for the list of raw slot types.  Future extensions to this macro may allow
@@ -2132,6 +2205,24 @@ been defined. (See SB-EXT:CAS for more information.)
         (aref
          (unless (singleton-p (cdr args))
            (invalid-place))
+         #+x86-64
+         (with-unique-names (array index delta)
+           ;; The delta modulo 2^64 is right for every element type:
+           ;; a fixnum is incremented as its tagged word.
+           `(let ((,array ,(car args))
+                  (,index ,(cadr args))
+                  (,delta ,(compute-delta)))
+              (etypecase ,array
+                ((simple-array word (*))
+                 (%array-atomic-incf/word
+                  ,array (check-bound ,array (length ,array) ,index) ,delta))
+                ((simple-array (unsigned-byte 32) (*))
+                 (%array-atomic-incf/ub32
+                  ,array (check-bound ,array (length ,array) ,index) ,delta))
+                ((simple-array fixnum (*))
+                 (%array-atomic-incf/fixnum
+                  ,array (check-bound ,array (length ,array) ,index) ,delta)))))
+         #-x86-64
          (with-unique-names (array)
            `(let ((,array (the (simple-array word (*)) ,(car args))))
               #+compare-and-swap-vops
@@ -2200,15 +2291,19 @@ PLACE must access one of the following:
  - a DEFSTRUCT slot with declared type (UNSIGNED-BYTE ~D~:*)
    or AREF of a (SIMPLE-ARRAY (UNSIGNED-BYTE ~D~:*) (*))
    The type SB-EXT:WORD can be used for these purposes.
+ - on x86-64, AREF of a (SIMPLE-ARRAY (UNSIGNED-BYTE 32) (*))
+   or of a (SIMPLE-ARRAY FIXNUM (*)).
  - CAR or CDR (respectively FIRST or REST) of a CONS.
  - a variable defined using DEFGLOBAL with a proclaimed type of FIXNUM.
 Macroexpansion is performed on PLACE before expanding ATOMIC-INCF.
 
 Incrementing is done using modular arithmetic,
 which is well-defined over two different domains:
- - For structures and arrays, the operation accepts and produces
+ - For structures and arrays of words, the operation accepts and produces
    an (UNSIGNED-BYTE ~D~:*), and DIFF must be of type (SIGNED-BYTE ~D).
    ATOMIC-INCF of #x~x by one results in #x0 being stored in PLACE.
+   Other arrays wrap around modulo their element type, with the same
+   type of DIFF.
  - For other places, the domain is FIXNUM, and DIFF must be a FIXNUM.
    ATOMIC-INCF of #x~x by one results in #x~x
    being stored in PLACE.
@@ -2229,15 +2324,19 @@ PLACE must access one of the following:
  - a DEFSTRUCT slot with declared type (UNSIGNED-BYTE ~D~:*)
    or AREF of a (SIMPLE-ARRAY (UNSIGNED-BYTE ~D~:*) (*))
    The type SB-EXT:WORD can be used for these purposes.
+ - on x86-64, AREF of a (SIMPLE-ARRAY (UNSIGNED-BYTE 32) (*))
+   or of a (SIMPLE-ARRAY FIXNUM (*)).
  - CAR or CDR (respectively FIRST or REST) of a CONS.
  - a variable defined using DEFGLOBAL with a proclaimed type of FIXNUM.
 Macroexpansion is performed on PLACE before expanding ATOMIC-DECF.
 
 Decrementing is done using modular arithmetic,
 which is well-defined over two different domains:
- - For structures and arrays, the operation accepts and produces
+ - For structures and arrays of words, the operation accepts and produces
    an (UNSIGNED-BYTE ~D~:*), and DIFF must be of type (SIGNED-BYTE ~D).
    ATOMIC-DECF of #x0 by one results in #x~x being stored in PLACE.
+   Other arrays wrap around modulo their element type, with the same
+   type of DIFF.
  - For other places, the domain is FIXNUM, and DIFF must be a FIXNUM.
    ATOMIC-DECF of #x~x by one results in #x~x
    being stored in PLACE.
@@ -2249,6 +2348,103 @@ EXPERIMENTAL: Interface subject to change."
   most-negative-fixnum most-positive-fixnum)
   (expand-atomic-frob 'atomic-decf place diff env))
 
+(defun check-memory-order (name order orders)
+  (unless (member order orders)
+    (error "~S ~S of ~S is not one of ~{~S~^, ~}." :order order name orders)))
+
+;;; Exchange by CAS until the value that was replaced is the one read
+(defun expand-exchange-by-cas (place new env)
+  (multiple-value-bind (vars vals old new-temp cas-form read-form)
+      (get-cas-expansion place env)
+    (with-unique-names (actual)
+      `(let* (,@(mapcar 'list vars vals)
+              (,new-temp ,new)
+              (,old ,read-form))
+         (loop (let ((,actual ,cas-form))
+                 ;; EQL rather than EQ, for words that are bignums
+                 (when (eql ,actual ,old)
+                   (return ,actual))
+                 (setq ,old ,actual)))))))
+
+(sb-xc:defmacro atomic-exchange (&environment env place new &key (order :seq-cst))
+  "Atomically stores NEW in PLACE, and returns the value of PLACE before the
+store.
+
+On x86-64, the exchange is a single instruction for AREF of a (SIMPLE-ARRAY
+SB-EXT:WORD (*)), (SIMPLE-ARRAY (UNSIGNED-BYTE 32) (*)) or (SIMPLE-ARRAY
+FIXNUM (*)), and for a DEFSTRUCT slot of type SB-EXT:WORD. PLACE can also be
+any place supported by COMPARE-AND-SWAP, which is then retried until it
+succeeds.
+
+ORDER is the memory order of the exchange, one of :RELAXED, :ACQUIRE,
+:RELEASE, :ACQ-REL and :SEQ-CST, the default. The exchange may be stronger
+than ORDER: it is sequentially consistent on x86-64, and wherever it is done
+by COMPARE-AND-SWAP.
+
+EXPERIMENTAL: Interface subject to change."
+  (check-memory-order 'atomic-exchange order
+                      '(:relaxed :acquire :release :acq-rel :seq-cst))
+  (let ((place (macroexpand place env)))
+    #+x86-64
+    (when (consp place)
+      (destructuring-bind (op . args) place
+        (when (and (eq op 'aref) (singleton-p (cdr args)))
+          (return-from atomic-exchange
+            (with-unique-names (vector index value)
+              `(let ((,vector ,(car args))
+                     (,index ,(cadr args))
+                     (,value ,new))
+                 (typecase ,vector
+                   ((simple-array word (*))
+                    (%vector-xchg/word
+                     ,vector (check-bound ,vector (length ,vector) ,index) ,value))
+                   ((simple-array (unsigned-byte 32) (*))
+                    (%vector-xchg/ub32
+                     ,vector (check-bound ,vector (length ,vector) ,index) ,value))
+                   ((simple-array fixnum (*))
+                    (%vector-xchg/fixnum
+                     ,vector (check-bound ,vector (length ,vector) ,index) ,value))
+                   (t
+                    ,(expand-exchange-by-cas `(aref ,vector ,index) value env)))))))
+        (let ((accessor-info (and (symbolp op)
+                                  (singleton-p args)
+                                  (structure-instance-accessor-p op))))
+          (when accessor-info
+            (let ((slotd (cdr accessor-info)))
+              (when (and (eq (dsd-raw-type slotd) 'sb-vm:word)
+                         (not (dsd-packed-p slotd))
+                         (not (dsd-read-only slotd)))
+                (return-from atomic-exchange
+                  `(truly-the ,(dsd-type slotd)
+                              (%raw-instance-xchg/word
+                               (the ,(dd-name (car accessor-info)) ,@args)
+                               ,(dsd-index slotd)
+                               (the ,(dsd-type slotd) ,new))))))))))
+    (expand-exchange-by-cas place new env)))
+
+(sb-xc:defmacro atomic-load (place &key (order :seq-cst))
+  "Returns the value of PLACE, which is read once.
+
+ORDER is the memory order of the read, one of :RELAXED, :ACQUIRE and
+:SEQ-CST, the default. Unless it is :RELAXED, no read or write that follows
+in the program can be seen to happen before this one. Stores by
+ATOMIC-EXCHANGE, COMPARE-AND-SWAP, ATOMIC-INCF and ATOMIC-DECF are
+sequentially consistent, so :SEQ-CST costs no more than :ACQUIRE on x86 and
+x86-64.
+
+PLACE should be one that is read with a single access to memory, such as the
+places supported by COMPARE-AND-SWAP and ATOMIC-EXCHANGE.
+
+EXPERIMENTAL: Interface subject to change."
+  (check-memory-order 'atomic-load order '(:relaxed :acquire :seq-cst))
+  (ecase order
+    (:relaxed `(values ,place))
+    (:acquire `(multiple-value-prog1 (values ,place) (sb-vm:%read-barrier)))
+    (:seq-cst
+     `(multiple-value-prog1 (values ,place)
+        (#+(or x86 x86-64) sb-vm:%read-barrier
+         #-(or x86 x86-64) sb-vm:%memory-barrier)))))
+
 (sb-xc:defmacro atomic-update (place update-fn &rest arguments &environment env)
   "Updates PLACE atomically to the value returned by calling function
 designated by UPDATE-FN with ARGUMENTS and the previous value of PLACE.
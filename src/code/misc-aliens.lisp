@@ -28,6 +28,35 @@
   (src (* char))
   (n sb-unix::size-t))
 
+;;; Like MEMMOVE, and FILL of words, with stores that bypass the cache
+;;; when there are more bytes than the cache could hold on to anyway.
+#+x86-64
+(progn
+  (declaim (inline bulk-copy bulk-fill-words))
+  (define-alien-routine ("bulk_copy" bulk-copy) void
+    (dest (* char))
+    (src (* char))
+    (n sb-unix::size-t))
+  (define-alien-routine ("bulk_fill_words" bulk-fill-words) void
+    (dest (* char))
+    (value unsigned-long)
+    (nwords sb-unix::size-t)))
+
+;;; Bit-wise operations and counting of bits on words of bit vectors,
+;;; with the vector registers of the CPU
+#+(or x86-64 arm64)
+(progn
+  (declaim (inline bit-vector-op bit-vector-count))
+  (define-alien-routine ("bit_vector_op" bit-vector-op) void
+    (op int)
+    (dest (* char))
+    (a (* char))
+    (b (* char))
+    (nwords sb-unix::size-t))
+  (define-alien-routine ("bit_vector_count" bit-vector-count) sb-unix::size-t
+    (words (* char))
+    (nwords sb-unix::size-t)))
+
 (defun copy-ub8-to-system-area (src src-offset dst dst-offset length)
   (with-pinned-objects (src)
     (memmove (sap+ dst dst-offset) (sap+ (vector-sap src) src-offset) length))
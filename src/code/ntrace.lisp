@@ -273,6 +273,73 @@
             (funcall (trace-end-breakpoint-fun info) frame nil vals nil)
             (values-list vals)))))))
 
+;;;; the trace buffer
+
+;;; With :REPORT :BUFFER, a traced function stores an event into a ring
+;;; buffer when it is called and when it returns, and prints nothing.
+;;; A thread claims a slot by incrementing the cursor and then stores a
+;;; fresh list into it, so writers never wait for each other, and a
+;;; reader sees either a whole event or the one that it replaces.
+(defstruct (trace-buffer (:constructor make-trace-buffer (events))
+                         (:copier nil)
+                         (:predicate nil))
+  (events #() :type simple-vector :read-only t)
+  (cursor 0 :type word))
+(declaim (freeze-type trace-buffer))
+
+(define-load-time-global *trace-buffer* nil)
+(declaim (type (or trace-buffer null) *trace-buffer*))
+
+(defun new-trace-buffer ()
+  (setf *trace-buffer*
+        (make-trace-buffer (make-array (power-of-two-ceiling
+                                        (max *trace-buffer-length* 1))
+                                       :initial-element nil))))
+
+(defun record-trace-event (kind name data)
+  (let ((buffer *trace-buffer*))
+    (when buffer
+      (let ((events (trace-buffer-events buffer)))
+        (setf (svref events (logand (atomic-incf (trace-buffer-cursor buffer))
+                                    (1- (length events))))
+              (list* (get-internal-real-time) sb-thread:*current-thread*
+                     kind name data))))))
+
+(defun trace-buffer-events (&key clear)
+  "Return the events recorded by the functions traced with :REPORT :BUFFER,
+oldest first. Each is a list (TIME THREAD :CALL NAME ARG*) or (TIME THREAD
+:RETURN NAME VALUE*), where TIME is as from GET-INTERNAL-REAL-TIME. Only the
+last *TRACE-BUFFER-LENGTH* events are kept, and calls that exit non-locally
+have no :RETURN event. If CLEAR is true, the events are also discarded."
+  (let ((buffer *trace-buffer*))
+    (when buffer
+      (when clear
+        (new-trace-buffer))
+      (let* ((events (trace-buffer-events buffer))
+             (mask (1- (length events)))
+             (end (trace-buffer-cursor buffer)))
+        ;; A slot that was claimed but not stored into yet is NIL, or
+        ;; still holds the event from one lap earlier.
+        (loop for i from (max 0 (- end (length events))) below end
+              for event = (svref events (logand i mask))
+              when event
+              collect event)))))
+
+;;; This function is called by the trace wrapper with :REPORT :BUFFER.
+;;; It evaluates none of the other options and looks neither at the
+;;; stack nor at *TRACED-FUNS*: what a call costs is the two events.
+(defun trace-call-to-buffer (info function &rest args)
+  (let ((name (trace-info-what info)))
+    (flet ((record (kind data)
+             ;; in case a function that this uses is traced itself
+             (unless *in-trace*
+               (let ((*in-trace* t))
+                 (record-trace-event kind name data)))))
+      (record :call args)
+      (let ((values (multiple-value-list (apply function args))))
+        (record :return values)
+        (values-list values)))))
+
 ;;; Trace one function according to the specified options. We copy the
 ;;; trace info (it was a quoted constant), fill in the functions, and
 ;;; then install the breakpoints or encapsulation.
@@ -290,20 +357,29 @@
         (warn "~S is already TRACE'd, untracing it first." function-or-name)
         (untrace-1 fun))
       (let* ((debug-fun (sb-di:fun-debug-fun fun))
+             (buffer (eq (trace-info-report info) :buffer))
+             ;; With :REPORT :BUFFER, a simple-fun gets its entry point
+             ;; redirected, which needs a bit in the code header to tell
+             ;; the GC. Anything else is encapsulated.
+             (funobj #+64-bit (and buffer (eq kind :compiled) (simple-fun-p fun)))
              (encapsulated
-              (if (eq (trace-info-encapsulated info) :default)
-                  (ecase kind
-                    (:compiled nil)
-                    (:compiled-closure
-                     (unless (functionp function-or-name)
-                       (warn "tracing shared code for ~S:~%  ~S"
-                             function-or-name
-                             fun))
-                     nil)
-                    ((:interpreted :interpreted-closure :funcallable-instance)
-                     t))
-                  (trace-info-encapsulated info)))
-             (loc (if encapsulated
+              (cond
+                (funobj nil)
+                (buffer t)
+                ((eq (trace-info-encapsulated info) :default)
+                 (ecase kind
+                   (:compiled nil)
+                   (:compiled-closure
+                    (unless (functionp function-or-name)
+                      (warn "tracing shared code for ~S:~%  ~S"
+                            function-or-name
+                            fun))
+                    nil)
+                   ((:interpreted :interpreted-closure :funcallable-instance)
+                    t)))
+                (t
+                 (trace-info-encapsulated info))))
+             (loc (if (or encapsulated funobj)
                       :encapsulated
                       (sb-di:debug-fun-start-location debug-fun)))
              (info (make-trace-info
@@ -328,14 +404,28 @@
             (warn ":WHEREIN name ~S is not a defined global function."
                   wherein)))
 
+        (when (and buffer (not *trace-buffer*))
+          (new-trace-buffer))
         (cond
+          (funobj
+           (setf (trace-info-wrapper info)
+                 (encapsulate-funobj fun nil 'trace-call-to-buffer info))
+           ;; An fdefn jumps to the entry point that the function had when
+           ;; it was stored, so store it again. A new definition being
+           ;; traced isn't stored yet.
+           (let ((fdefn (fdefn-holding fun (and named function-or-name))))
+             (when fdefn
+               (setf (fdefn-fun fdefn) fun))))
           (encapsulated
            (unless named
              (error "can't use encapsulation to trace anonymous function ~S"
                     fun))
            (encapsulate function-or-name 'trace
-                        (lambda (function &rest args)
-                          (apply #'trace-call info function args))))
+                        (if buffer
+                            (lambda (function &rest args)
+                              (apply #'trace-call-to-buffer info function args))
+                            (lambda (function &rest args)
+                              (apply #'trace-call info function args)))))
           (t
            (multiple-value-bind (start-fun cookie-fun)
                (trace-start-breakpoint-fun info)
@@ -514,7 +604,11 @@ The following options are defined:
        If Report-Type is TRACE (the default) then information is
        reported by printing immediately. If Report-Type is NIL, then
        the only effect of the trace is to execute other
-       options (e.g. PRINT or BREAK).
+       options (e.g. PRINT or BREAK). If Report-Type is :BUFFER, then
+       calls and returns are recorded in a buffer that is read with
+       TRACE-BUFFER-EVENTS, the other options are ignored, and a
+       compiled function is traced by redirecting its entry point,
+       which costs much less than printing or a breakpoint.
 
    :CONDITION Form
    :CONDITION-AFTER Form
@@ -591,6 +685,10 @@ the N-th value returned by the function."
                     table))))
       (t
        (cond
+         ((trace-info-wrapper info)
+          (unencapsulate-funobj
+           fun (fdefn-holding fun (and (trace-info-named info)
+                                       (trace-info-what info)))))
          ((trace-info-encapsulated info)
           (unencapsulate (trace-info-what info) 'trace))
          (t
@@ -656,6 +754,31 @@ functions when called with no arguments."
       ;; touch the card mark
       (setf (code-header-ref code 1) (code-header-ref code 1)))))
 
+;;; the index in CODE of the header word of FUN
+(defun fun-header-word-index (code fun)
+  (with-pinned-objects (code fun)
+    (let ((delta (- (get-lisp-obj-address fun)
+                    (get-lisp-obj-address code)
+                    sb-vm:fun-pointer-lowtag
+                    (- sb-vm:other-pointer-lowtag))))
+      (aver (not (logtest delta sb-vm:lowtag-mask)))
+      (ash delta (- sb-vm:word-shift)))))
+
+;;; the address of the instructions of FUN, which must be pinned
+(declaim (inline simple-fun-entry-address))
+(defun simple-fun-entry-address (fun)
+  (+ (get-lisp-obj-address fun)
+     (- sb-vm:fun-pointer-lowtag)
+     (ash sb-vm:simple-fun-insts-offset sb-vm:word-shift)))
+
+;;; the fdefn of NAME, or of the name of FUN if NAME is NIL, when it
+;;; holds FUN
+(defun fdefn-holding (fun name)
+  (let* ((name (or name (%fun-name fun)))
+         (fdefn (and (legal-fun-name-p name) (find-fdefn name))))
+    (when (and fdefn (eq (fdefn-fun fdefn) fun))
+      fdefn)))
+
 ;;; FIXME: Symbol is lost by accident
 (eval-when (:compile-toplevel :load-toplevel)
   (export 'sb-int::encapsulate-funobj 'sb-int))
@@ -698,7 +821,9 @@ functions when called with no arguments."
 ;;; In contrast, ENCAPSULATE-FUNOBJ encapsulates TRACED-FUN by changing the
 ;;; entry point of the function to redirect to a tracing wrapper which then
 ;;; calls back to the correct entry point.
-(defun encapsulate-funobj (traced-fun &optional fdefn)
+;;; WRAPPER is the function that the wrapper applies to INFO, the
+;;; original function and the arguments.
+(defun encapsulate-funobj (traced-fun &optional fdefn (wrapper 'trace-call) info)
   (declare (type (or simple-fun closure) traced-fun))
   (let* ((proxy-fun
            (typecase traced-fun
@@ -716,35 +841,25 @@ functions when called with no arguments."
               ;; to the tracing wraper, which will invoke a new closure that is
               ;; behaviorally identical to the original closure.
               (sb-impl::copy-closure traced-fun))))
-         (info (make-trace-info :what (cond (fdefn (fdefn-name fdefn))
-                                            (t (%fun-name traced-fun)))
-                                :encapsulated t
-                                :named t
-                                :report 'trace))
+         (info (or info
+                   (make-trace-info :what (cond (fdefn (fdefn-name fdefn))
+                                                (t (%fun-name traced-fun)))
+                                    :encapsulated t
+                                    :named t
+                                    :report 'trace)))
          (tracing-wrapper
-           (compile-funobj-encapsulation 'trace-call info proxy-fun)))
+           (compile-funobj-encapsulation wrapper info proxy-fun)))
     (with-pinned-objects (tracing-wrapper)
       (let (#+(or x86 x86-64 arm64)
-            (tracing-wrapper-entry
-              (+ (get-lisp-obj-address tracing-wrapper)
-                 (- sb-vm:fun-pointer-lowtag)
-                 (ash sb-vm:simple-fun-insts-offset sb-vm:word-shift))))
+            (tracing-wrapper-entry (simple-fun-entry-address tracing-wrapper)))
         (typecase traced-fun
           (simple-fun
            (let ((code (fun-code-header traced-fun)))
              (set-tracing-bit code code-is-traced)
-             (let ((fun-header-word-index
-                     (with-pinned-objects (code)
-                       (let ((delta (- (get-lisp-obj-address traced-fun)
-                                       (get-lisp-obj-address code)
-                                       sb-vm:fun-pointer-lowtag
-                                       (- sb-vm:other-pointer-lowtag))))
-                         (aver (not (logtest delta sb-vm:lowtag-mask)))
-                         (ash delta (- sb-vm:word-shift))))))
-               ;; the entry point in CODE points to the tracing wrapper
-               (setf (code-header-ref code (1+ fun-header-word-index))
-                     #+(or x86 x86-64 arm64) (make-lisp-obj tracing-wrapper-entry)
-                     #-(or x86 x86-64 arm64) tracing-wrapper))))
+             ;; the entry point in CODE points to the tracing wrapper
+             (setf (code-header-ref code (1+ (fun-header-word-index code traced-fun)))
+                   #+(or x86 x86-64 arm64) (make-lisp-obj tracing-wrapper-entry)
+                   #-(or x86 x86-64 arm64) tracing-wrapper)))
           (closure
            (with-pinned-objects (traced-fun)
              ;; redirect the original closure to the tracing wrapper
@@ -760,3 +875,18 @@ functions when called with no arguments."
     (when (and fdefn (eq (fdefn-fun fdefn) traced-fun))
       (setf (fdefn-fun fdefn) tracing-wrapper))
     tracing-wrapper))
+
+;;; Undo ENCAPSULATE-FUNOBJ of a simple-fun: point its entry back at its
+;;; own instructions, and store it into FDEFN again for the fdefn to
+;;; jump there. The tracing bit stays set, as other functions in the
+;;; code might still be traced, and it costs only some work in GC.
+(defun unencapsulate-funobj (traced-fun &optional fdefn)
+  (declare (type simple-fun traced-fun))
+  (let ((code (fun-code-header traced-fun)))
+    (with-pinned-objects (traced-fun)
+      (setf (code-header-ref code (1+ (fun-header-word-index code traced-fun)))
+            #+(or x86 x86-64 arm64) (make-lisp-obj (simple-fun-entry-address traced-fun))
+            #-(or x86 x86-64 arm64) traced-fun)))
+  (when (and fdefn (eq (fdefn-fun fdefn) traced-fun))
+    (setf (fdefn-fun fdefn) traced-fun))
+  traced-fun)
@@ -1540,11 +1540,34 @@ variable: an unreadable object representing the error is printed instead.")
 ;;; Call CHAR-FUN with the digits of FLOAT
 ;;; PROLOGUE-FUN and EPILOGUE-FUN are called with the exponent before
 ;;; and after printing to set up the state.
+;;; Without POSITION, FLOAT-SHORTEST-DECIMAL finds the same digits
+;;; without bignums, except for subnormals.
 (declaim (inline %flonum-to-digits))
 (defun %flonum-to-digits (char-fun
                           prologue-fun
                           epilogue-fun
                           float &optional position relativep)
+  #+64-bit
+  (unless position
+    (multiple-value-bind (d e)
+        (and (typep float '(or single-float double-float))
+             (float-shortest-decimal float))
+      (when d
+        (let* ((n (do ((n 1 (1+ n))
+                       (power 10 (* power 10)))
+                      ((< d power) n)
+                    (declare (type (integer 1 20) n)
+                             (type (unsigned-byte 64) power))))
+               (k (+ e n)))
+          (declare (type (unsigned-byte 62) d) (fixnum e))
+          (funcall prologue-fun k)
+          (do ((power (expt 10 (1- n)) (truncate power 10)))
+              ((zerop power))
+            (declare (type (unsigned-byte 62) power))
+            (multiple-value-bind (digit rest) (truncate d power)
+              (funcall char-fun digit)
+              (setf d rest)))
+          (return-from %flonum-to-digits (funcall epilogue-fun k))))))
   (let ((print-base 10)                 ; B
         (float-radix 2)                 ; b
         (float-digits (float-digits float)) ; p
@@ -67,12 +67,42 @@
      (* (counter-overflow counter) (1+ most-positive-word))))
 
 ;;;; High resolution timer
-
-(defconstant +ticks-per-second+ internal-time-units-per-second)
+;;;;
+;;;; The time between the two readings in the same thread, from the cycle
+;;;; counter where there is one, and otherwise from the real time clock.
+;;;; Run time is no good: it is of the whole process, so with threads it
+;;;; would charge each function for the time of the others.
 
 (declaim (inline get-internal-ticks))
 (defun get-internal-ticks ()
-  (get-internal-run-time))
+  #+x86-64
+  (logand (sb-vm::%read-cycle-counter-word) most-positive-fixnum)
+  #+(and cycle-counter 64-bit (not x86-64))
+  (multiple-value-bind (hi lo) (sb-impl::read-cycle-counter)
+    (logand (logior (ash hi 32) lo) most-positive-fixnum))
+  #-(and cycle-counter 64-bit)
+  (get-internal-real-time))
+
+;;; the number of ticks per second, measured against the real time clock
+;;; for the cycle counter
+(defvar *ticks-per-second*)
+(declaim (type single-float *ticks-per-second*))
+(makunbound '*ticks-per-second*) ; in case we reload this file when tweaking
+
+(defun ticks-per-second ()
+  (if (boundp '*ticks-per-second*)
+      *ticks-per-second*
+      (setf *ticks-per-second*
+            #-(and cycle-counter 64-bit)
+            (float internal-time-units-per-second)
+            #+(and cycle-counter 64-bit)
+            (let ((real-start (get-internal-real-time))
+                  (start (get-internal-ticks))
+                  (interval (floor internal-time-units-per-second 20)))
+              (loop until (>= (- (get-internal-real-time) real-start) interval))
+              (/ (float (- (get-internal-ticks) start))
+                 (/ (float (- (get-internal-real-time) real-start))
+                    (float internal-time-units-per-second)))))))
 
 ;;;; global data structures
 
@@ -93,28 +123,59 @@
   (clear-stats-fun   (missing-arg) :type function :read-only t))
 (declaim (freeze-type profile-info))
 
-;;; These variables are used to subtract out the time and consing for
+;;;; Statistics
+;;;;
+;;;; Each profiled function has a stripe of +N-STATS+ counters for each
+;;;; of +N-STATS-STRIPES+ groups of threads, allocated one after the
+;;;; other so that different stripes hardly share cache lines. A thread
+;;;; only increments the stripe that its kernel thread identifier
+;;;; selects, so unless more threads than stripes call profiled
+;;;; functions at the same time, the atomic increments aren't contended.
+;;;; Reading the statistics adds the stripes up.
+
+(defconstant +n-stats-stripes+ #+sb-thread 16 #-sb-thread 1)
+;;; the counters of a stripe
+(defconstant +stats-calls+ 0)
+(defconstant +stats-ticks+ 1)
+(defconstant +stats-consing+ 2)
+(defconstant +stats-profiles+ 3)
+(defconstant +stats-gc-run-time+ 4)
+(defconstant +n-stats+ 5)
+
+(defun make-stats ()
+  (let ((stats (make-array (* +n-stats-stripes+ +n-stats+))))
+    (dotimes (i (length stats) stats)
+      (setf (svref stats i) (make-counter)))))
+
+;;; the index of the first counter of the stripe of the current thread
+(declaim (inline current-stats-stripe))
+(defun current-stats-stripe ()
+  #+sb-thread
+  (* +n-stats+
+     (logand #+(or linux win32 freebsd) (sb-thread::my-kernel-thread-id)
+             #-(or linux win32 freebsd) (ash (sb-thread::current-thread-sap-int) -16)
+             (1- +n-stats-stripes+)))
+  #-sb-thread 0)
+
+(defun stats-count (stats index)
+  (loop for stripe below (length stats) by +n-stats+
+        sum (counter-count (svref stats (+ stripe index)))))
+
+;;; This is used to subtract out the ticks, consing and GC run time of
 ;;; recursive and other dynamically nested profiled calls. The total
-;;; resource consumed for each nested call is added into the
-;;; appropriate variable. When the outer function returns, these
-;;; amounts are subtracted from the total.
-(declaim (counter *enclosed-ticks* *enclosed-consing*))
-(defvar *enclosed-ticks*)
-(defvar *enclosed-consing*)
-
-;;; This variable is also used to subtract out time for nested
-;;; profiled calls. The time inside the profile wrapper call --
-;;; between its two calls to GET-INTERNAL-TICKS -- is accounted
-;;; for by the *ENCLOSED-TIME* variable. However, there's also extra
-;;; overhead involved, before we get to the first call to
-;;; GET-INTERNAL-TICKS, and after we get to the second call. By
+;;; consumed by each nested call is added into the word vector which
+;;; this is bound to, on the stack of the outer call. When the outer
+;;; function returns, these amounts are subtracted from its own.
+;;;
+;;; The count of enclosed profiled calls is kept too. The time inside
+;;; the profile wrapper call -- between its two calls to
+;;; GET-INTERNAL-TICKS -- is accounted for as enclosed ticks. However,
+;;; there's also extra overhead involved, before we get to the first
+;;; call to GET-INTERNAL-TICKS, and after we get to the second call. By
 ;;; keeping track of the count of enclosed profiled calls, we can try
 ;;; to compensate for that.
-(declaim (counter *enclosed-profiles*))
-(defvar *enclosed-profiles*)
-
-(declaim (counter *enclosed-gc-run-time*))
-(defvar *enclosed-gc-run-time*)
+(defvar *enclosed*)
+(declaim (simple-vector *enclosed*))
 
 ;;; the encapsulated function we're currently computing profiling data
 ;;; for, recorded so that we can detect the problem of
@@ -163,12 +224,8 @@
 ;;; will minimize profiling overhead.)
 (defun profile-encapsulation-lambdas ()
   (declare (muffle-conditions compiler-note))
-  (let* ((count (make-counter))
-         (ticks (make-counter))
-         (consing (make-counter))
-         (profiles (make-counter))
-         (gc-run-time (make-counter)))
-    (declare (counter count ticks consing profiles gc-run-time))
+  (let ((stats (make-stats)))
+    (declare (simple-vector stats))
     (values
      ;; ENCAPSULATION-FUN
      (lambda (function &rest args)
@@ -183,60 +240,59 @@
                     uses ~S in its computations, it looks as though it's a bad idea to ~
                     profile it.)~:@>"
                 *computing-profiling-data-for* function function))
-       (incf-counter count 1)
-       (let ((dticks 0)
+       (let ((stripe (current-stats-stripe))
+             (dticks 0)
              (dconsing 0)
              (inner-enclosed-profiles 0)
              (dgc-run-time 0))
-         (declare (truly-dynamic-extent dticks dconsing inner-enclosed-profiles))
-         (unwind-protect
-              (let ((start-ticks (get-internal-ticks))
-                    (start-gc-run-time *gc-run-time*)
-                    (*enclosed-ticks* (make-counter))
-                    (*enclosed-consing* (make-counter))
-                    (*enclosed-profiles* (make-counter))
-                    (nbf0 *n-bytes-freed-or-purified*)
-                    (dynamic-usage-0 (sb-kernel:dynamic-usage))
-                    (*enclosed-gc-run-time* (make-counter)))
-                (declare (dynamic-extent *enclosed-ticks* *enclosed-consing*
-                                         *enclosed-profiles* *enclosed-gc-run-time*))
-                (unwind-protect
-                     (apply function args)
-                  (let ((*computing-profiling-data-for* function)
-                        (dynamic-usage-1 (sb-kernel:dynamic-usage)))
-                    (setf dticks (- (get-internal-ticks) start-ticks)
-                          dconsing (if (eql *n-bytes-freed-or-purified* nbf0)
-                                       ;; common special case where we can avoid
-                                       ;; bignum arithmetic
-                                       (- dynamic-usage-1 dynamic-usage-0)
-                                       ;; general case
-                                       (- (get-bytes-consed) nbf0 dynamic-usage-0))
-                          inner-enclosed-profiles (counter-count *enclosed-profiles*)
-                          dgc-run-time (- *gc-run-time* start-gc-run-time))
-                    (incf-counter ticks (- dticks (counter-count *enclosed-ticks*)))
-                    (incf-counter gc-run-time (- dgc-run-time (counter-count *enclosed-gc-run-time*)))
-                    (incf-counter consing (- dconsing (counter-count *enclosed-consing*)))
-                    (incf-counter profiles inner-enclosed-profiles))))
-           (when (boundp '*enclosed-ticks*)
-             (incf-counter *enclosed-ticks* dticks)
-             (incf-counter *enclosed-consing* dconsing)
-             (incf-counter *enclosed-profiles* (1+ inner-enclosed-profiles))
-             (incf-counter *enclosed-gc-run-time* dgc-run-time)))))
+         (declare (index stripe))
+         (macrolet ((stat (index) `(svref stats (+ stripe ,index))))
+           (incf-counter (stat +stats-calls+) 1)
+           (unwind-protect
+                (let* ((start-ticks (get-internal-ticks))
+                       (start-gc-run-time *gc-run-time*)
+                       (enclosed (make-array +n-stats+ :initial-element 0))
+                       (*enclosed* enclosed)
+                       (nbf0 *n-bytes-freed-or-purified*)
+                       (dynamic-usage-0 (sb-kernel:dynamic-usage)))
+                  (declare (dynamic-extent enclosed))
+                  (unwind-protect
+                       (apply function args)
+                    (let ((*computing-profiling-data-for* function)
+                          (dynamic-usage-1 (sb-kernel:dynamic-usage)))
+                      (setf dticks (- (get-internal-ticks) start-ticks)
+                            dconsing (if (eql *n-bytes-freed-or-purified* nbf0)
+                                         ;; common special case where we can avoid
+                                         ;; bignum arithmetic
+                                         (- dynamic-usage-1 dynamic-usage-0)
+                                         ;; general case
+                                         (- (get-bytes-consed) nbf0 dynamic-usage-0))
+                            inner-enclosed-profiles (svref enclosed +stats-profiles+)
+                            dgc-run-time (- *gc-run-time* start-gc-run-time))
+                      (incf-counter (stat +stats-ticks+)
+                                    (- dticks (svref enclosed +stats-ticks+)))
+                      (incf-counter (stat +stats-gc-run-time+)
+                                    (- dgc-run-time (svref enclosed +stats-gc-run-time+)))
+                      (incf-counter (stat +stats-consing+)
+                                    (- dconsing (svref enclosed +stats-consing+)))
+                      (incf-counter (stat +stats-profiles+) inner-enclosed-profiles))))
+             (when (boundp '*enclosed*)
+               (let ((enclosed *enclosed*))
+                 (incf (svref enclosed +stats-ticks+) dticks)
+                 (incf (svref enclosed +stats-consing+) dconsing)
+                 (incf (svref enclosed +stats-profiles+) (1+ inner-enclosed-profiles))
+                 (incf (svref enclosed +stats-gc-run-time+) dgc-run-time)))))))
      ;; READ-STATS-FUN
      (lambda ()
-       (values (counter-count count)
-               (counter-count ticks)
-               (counter-count consing)
-               (counter-count profiles)
-               (counter-count gc-run-time)))
+       (values (stats-count stats +stats-calls+)
+               (stats-count stats +stats-ticks+)
+               (stats-count stats +stats-consing+)
+               (stats-count stats +stats-profiles+)
+               (stats-count stats +stats-gc-run-time+)))
      ;; CLEAR-STATS-FUN
      (lambda ()
-       (setf count (make-counter)
-             ticks (make-counter)
-             consing (make-counter)
-             profiles (make-counter)
-             gc-run-time (make-counter))))))
-
+       (setf stats (make-stats))))))
+
 ;;;; interfaces
 
 ;;; A symbol or (SETF FOO) list names a function, a string names all
@@ -362,7 +418,7 @@
 ;;; the enclosing function.
 (defun compensate-time (calls ticks profile)
   (let ((raw-compensated
-         (- (/ (float ticks) (float +ticks-per-second+))
+         (- (/ (float ticks) (ticks-per-second))
             (* (overhead-internal *overhead*) (float calls))
             (* (- (overhead-total *overhead*)
                   (overhead-internal *overhead*))
@@ -512,7 +568,7 @@ uncalled profiled functions are listed."
              (dotimes (i *timer-overhead-iterations*)
                (funcall fun fun))
              (/ (float (- (get-internal-ticks) start))
-                (float +ticks-per-second+)
+                (ticks-per-second)
                 (float *timer-overhead-iterations*)))))
     (let (;; Measure unprofiled calls to estimate call overhead.
           (call-overhead (frob))
@@ -530,7 +586,7 @@ uncalled profiled functions are listed."
                (time (nth-value 1 (funcall read-stats-fun))))
           (setf internal-overhead
                 (/ (float time)
-                   (float +ticks-per-second+)
+                   (ticks-per-second)
                    (float *timer-overhead-iterations*))))
         (unprofile compute-overhead-aux))
       (prog1
@@ -542,7 +598,9 @@ uncalled profiled functions are listed."
 ;;; It would be bad to compute *OVERHEAD*, save it into a .core file,
 ;;; then load the old *OVERHEAD* value from the .core file into a
 ;;; different machine running at a different speed. We avoid this by
-;;; erasing *CALL-OVERHEAD* whenever we save a .core file.
+;;; erasing *CALL-OVERHEAD* whenever we save a .core file, and
+;;; *TICKS-PER-SECOND* for the same reason.
 (defun profile-deinit ()
   (without-package-locks
-    (makunbound '*overhead*)))
+    (makunbound '*overhead*)
+    (makunbound '*ticks-per-second*)))
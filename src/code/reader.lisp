@@ -593,6 +593,40 @@ standard Lisp readtable when NIL."
   (vector-push-extend (token-buf-fill-ptr buf) (token-buf-escapes buf))
   (ouch-read-buffer char buf))
 
+;;; Append to BUFFER the characters of STRING from START below END that
+;;; can only go on a symbol under the readtable whose base char syntax
+;;; is ATTRIBUTE-ARRAY, as far as the first that might do anything else,
+;;; and return the index of that one. The run of plain constituents that
+;;; most tokens are is so copied at once, instead of a char at a time.
+(defun ouch-constituent-run (buffer string start end attribute-array)
+  (declare (type token-buf buffer) (simple-string string)
+           (index start end) (attribute-table attribute-array)
+           (optimize speed (sb-c:insert-array-bounds-checks 0)))
+  (macrolet ((scan (element-type)
+               `(let ((string (truly-the (simple-array ,element-type (*)) string)))
+                  (do ((i start (1+ i)))
+                      ((or (>= i end)
+                           (let ((char (schar string i)))
+                             (not (and (typep char 'base-char)
+                                       (>= (aref attribute-array (char-code char))
+                                           +char-attr-constituent+)
+                                       (< (get-constituent-trait char)
+                                          +char-attr-package-delimiter+)))))
+                       i)))))
+    (let* ((stop (typecase string
+                   ((simple-array character (*)) (scan character))
+                   #+sb-unicode ((simple-array base-char (*)) (scan base-char))
+                   (t start)))
+           (n (- stop start))
+           (op (token-buf-fill-ptr buffer)))
+      (when (plusp n)
+        (loop while (> (+ op n) (length (token-buf-string buffer)))
+              do (grow-read-buffer))
+        (replace (token-buf-string buffer) string
+                 :start1 op :start2 start :end2 stop)
+        (setf (token-buf-fill-ptr buffer) (+ op n)))
+      stop)))
+
 (defun grow-read-buffer ()
   (let* ((b *read-buffer*)
          (string (token-buf-string b)))
@@ -1459,11 +1493,14 @@ extended <package-name>::<form-in-package> syntax."
         (#.+char-attr-package-delimiter+ (go COLON))
         (t (go SYMBOL)))
      SYMBOL ; not a dot, dots, or number
+      ;; Where the stream's characters are in a string, take the run of
+      ;; plain constituents that follows CHAR from there all at once.
       (macrolet
-           ((scan (read-a-char &optional finish)
+           ((scan (read-a-char &optional finish skip-run)
              `(prog ()
                SYMBOL-LOOP
                (ouch-read-buffer char buf)
+               ,skip-run
                (setq char ,read-a-char)
                (when (eq char +EOF+) (go RETURN-SYMBOL))
                (case (char-class char attribute-array attribute-hash-table)
@@ -1474,11 +1511,25 @@ extended <package-name>::<form-in-package> syntax."
                  (#.+char-attr-multiple-escape+ ,finish (go MULT-ESCAPE))
                  (#.+char-attr-package-delimiter+ ,finish (go COLON))
                  (t (go SYMBOL-LOOP))))))
-        (if (ansi-stream-p stream)
-            (prepare-for-fast-read-char stream
-              (scan (fast-read-char nil +EOF+) (done-with-fast-read-char)))
-            ;; CLOS stream
-            (scan (read-char stream nil +EOF+))))
+        (cond ((typep stream 'string-input-stream)
+               (scan (read-char stream nil +EOF+) nil
+                     (setf (string-input-stream-index stream)
+                           (ouch-constituent-run buf
+                                                 (string-input-stream-string stream)
+                                                 (string-input-stream-index stream)
+                                                 (string-input-stream-limit stream)
+                                                 attribute-array))))
+              ((ansi-stream-p stream)
+               (prepare-for-fast-read-char stream
+                 (scan (fast-read-char nil +EOF+) (done-with-fast-read-char)
+                       (when %frc-buffer%
+                         (setq %frc-index%
+                               (ouch-constituent-run buf %frc-buffer% %frc-index%
+                                                     +ansi-stream-in-buffer-length+
+                                                     attribute-array))))))
+              (t
+               ;; CLOS stream
+               (scan (read-char stream nil +EOF+)))))
      SINGLE-ESCAPE ; saw a single-escape
       ;; Don't put the escape character in the read buffer.
       ;; READ-NEXT CHAR, put in buffer (no case conversion).
@@ -1709,6 +1760,19 @@ extended <package-name>::<form-in-package> syntax."
         (min exponent (floor (- max-exponent magnitude)
                              #.(cl:floor (cl:log 10 2)))))))
 
+;;; The float of FLOAT-FORMAT nearest to NUMBER 10^EXPONENT, found
+;;; without consing, or NIL if that takes the exact way.
+(declaim (inline fast-make-float))
+(defun fast-make-float (number exponent float-format)
+  #-64-bit (declare (ignore number exponent float-format))
+  #+64-bit
+  (and (typep number 'word)
+       (typep exponent 'fixnum)
+       (case float-format
+         ((short-float single-float) (decimal-to-float number exponent 'single-float))
+         ((double-float #-long-float long-float)
+          (decimal-to-float number exponent 'double-float)))))
+
 (defun make-float (stream)
   ;; Assume that the contents of *read-buffer* are a legal float, with nothing
   ;; else after it.
@@ -1716,6 +1780,7 @@ extended <package-name>::<form-in-package> syntax."
         (negative-fraction nil)
         (number 0)
         (divisor 1)
+        (fraction-digits 0) ; as DIVISOR is 10^FRACTION-DIGITS
         (negative-exponent nil)
         (exponent 0)
         (float-char ())
@@ -1733,14 +1798,17 @@ extended <package-name>::<form-in-package> syntax."
       (when (char= char #\.)
       ;; Read digits after the dot.
         (accumulate (setq divisor (* divisor 10)
+                          fraction-digits (1+ fraction-digits)
                           number (+ (* number 10) digit))))
     ;; Is there an exponent letter?
       (cond
           ((null char)
            ;; If not, we've read the whole number.
-           (let ((num (make-float-aux number divisor
-                                      *read-default-float-format*
-                                      stream)))
+           (let ((num (or (fast-make-float number (- fraction-digits)
+                                           *read-default-float-format*)
+                          (make-float-aux number divisor
+                                          *read-default-float-format*
+                                          stream))))
              (return-from make-float (if negative-fraction (- num) num))))
           ((= (get-constituent-trait char) +char-attr-constituent-expt+)
            (setq float-char char)
@@ -1757,9 +1825,12 @@ extended <package-name>::<form-in-package> syntax."
                                   (#\D 'double-float)
                                   (#\L 'long-float)
                                   (#\R 'rational)))
-                  (exponent (truncate-exponent exponent number divisor))
-                  (result (make-float-aux (* (expt 10 exponent) number)
-                                          divisor float-format stream)))
+                  (result
+                    (or (fast-make-float number (- exponent fraction-digits)
+                                         float-format)
+                        (let ((exponent (truncate-exponent exponent number divisor)))
+                          (make-float-aux (* (expt 10 exponent) number)
+                                          divisor float-format stream)))))
              (return-from make-float
                (if negative-fraction (- result) result))))
           (t (bug "bad fallthrough in floating point reader"))))))
@@ -58,34 +58,59 @@
    effect. Users probably want to use RESTART-CASE. A case-name of NIL
    indicates an anonymous restart. When bindings contain the same
    restart name, FIND-RESTART will find the first such binding."
-  (flet ((parse-binding (binding)
-           (with-current-source-form (binding)
-             (unless (>= (length binding) 2)
-               (error "ill-formed restart binding: ~S" binding))
-             (destructuring-bind (name function
-                                       &key interactive-function
-                                       test-function
-                                       report-function)
-                 binding
-               (unless (or name report-function)
-                 (warn "Unnamed restart does not have a report function: ~
-                        ~S" binding))
-               `(make-restart ',name ,function
-                              ,@(and (or report-function
-                                         interactive-function
-                                         test-function)
-                                     `(,report-function))
-                              ,@(and (or interactive-function
-                                         test-function)
-                                     `(,interactive-function))
-                              ,@(and test-function
-                                     `(,test-function)))))))
-    `(let ((*restart-clusters*
-            (cons (list ,@(mapcar #'parse-binding bindings))
-                  *restart-clusters*)))
-       (declare (truly-dynamic-extent *restart-clusters*))
-       (progn
-         ,@forms))))
+  ;; As in %HANDLER-BIND, functions spelled (LAMBDA ...) or #'(LAMBDA ...),
+  ;; possibly inside the WITH-SOURCE-FORM of RESTART-CASE, become local
+  ;; dynamic-extent functions, so that the closures over the RESTART-CASE
+  ;; tags and argument variable aren't heap-allocated on every entry.
+  ;; The restarts themselves are stack-allocated with the cluster.
+  (collect ((local-functions))
+    (labels ((local-function (form &optional source-form)
+               (typecase form
+                 ((cons (eql sb-c::with-source-form) (cons t (cons t null)))
+                  (local-function (third form) (second form)))
+                 ((or (cons (eql lambda) (cons list))
+                      (cons (eql function) (cons (cons (eql lambda) (cons list)) null)))
+                  (let ((lexpr (if (eq (car form) 'function) (cadr form) form))
+                        (name (let ((*gensym-counter* (length (local-functions))))
+                                (sb-xc:gensym "R"))))
+                    (local-functions
+                     `(,name ,(cadr lexpr)
+                             ,@(when source-form
+                                 `((declare (sb-c::source-form ,source-form))))
+                             ,@(cddr lexpr)))
+                    `#',name))
+                 (t
+                  (if source-form
+                      `(sb-c::with-source-form ,source-form ,form)
+                      form))))
+             (parse-binding (binding)
+               (with-current-source-form (binding)
+                 (unless (>= (length binding) 2)
+                   (error "ill-formed restart binding: ~S" binding))
+                 (destructuring-bind (name function
+                                      &key interactive-function
+                                           test-function
+                                           report-function)
+                     binding
+                   (unless (or name report-function)
+                     (warn "Unnamed restart does not have a report function: ~
+                            ~S" binding))
+                   `(make-restart ',name ,(local-function function)
+                                  ,@(and (or report-function
+                                             interactive-function
+                                             test-function)
+                                         `(,(local-function report-function)))
+                                  ,@(and (or interactive-function
+                                             test-function)
+                                         `(,(local-function interactive-function)))
+                                  ,@(and test-function
+                                         `(,(local-function test-function))))))))
+      (let ((restarts (mapcar #'parse-binding bindings)))
+        `(dx-flet ,(local-functions)
+           (dx-let ((*restart-clusters*
+                     (cons (list ,@restarts) *restart-clusters*)))
+             (progn
+               ,@forms)))))))
 
 ;;; Transform into WITH-SIMPLE-CONDITION-RESTARTS when appropriate.
 (eval-when (:compile-toplevel :load-toplevel :execute)
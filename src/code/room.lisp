@@ -494,16 +494,35 @@ We could try a few things to mitigate this:
 
 ;;; Return a list of 3-lists (bytes object type-name) for the objects
 ;;; allocated in Space.
+;;; Count the objects and bytes of dynamic space by type code into COUNTS
+;;; and SIZES. The C runtime divides the pages among the GC helper threads,
+;;; which is much faster than MAP-ALLOCATED-OBJECTS on a large heap.
+#+gencgc
+(defun dynamic-space-census (sizes counts)
+  (declare (type (simple-array word (256)) sizes counts))
+  (let ((census (make-array 512 :initial-element 0 :element-type 'word)))
+    (without-gcing
+      (close-thread-alloc-region)
+      (with-pinned-objects (census)
+        (alien-funcall (extern-alien "heap_census" (function void system-area-pointer))
+                       (vector-sap census))))
+    (dotimes (i 256)
+      (setf (aref counts i) (aref census (* 2 i))
+            (aref sizes i) (* (aref census (1+ (* 2 i))) n-word-bytes)))))
+
 (defun type-breakdown (space)
   (declare (muffle-conditions compiler-note))
   (let ((sizes (make-array 256 :initial-element 0 :element-type 'word))
         (counts (make-array 256 :initial-element 0 :element-type 'word)))
-    (map-allocated-objects
-     (lambda (obj type size)
-       (declare (word size) (optimize (speed 3)) (ignore obj))
-       (incf (aref sizes type) size)
-       (incf (aref counts type)))
-     space)
+    (cond #+gencgc
+          ((eq space :dynamic) (dynamic-space-census sizes counts))
+          (t
+           (map-allocated-objects
+            (lambda (obj type size)
+              (declare (word size) (optimize (speed 3)) (ignore obj))
+              (incf (aref sizes type) size)
+              (incf (aref counts type)))
+            space)))
 
     (let ((totals (make-hash-table :test 'eq)))
       (dotimes (i 256)
@@ -707,6 +726,77 @@ We could try a few things to mitigate this:
         (type-usage totals-label total-objects total-bytes))))
   (values))
 
+;;;; GC-CENSUS
+
+;;; The runtime can count the objects that survive each garbage
+;;; collection as it moves them, which is much cheaper than walking the
+;;; heap afterwards. See the comment above gc_census_note() in gencgc.c.
+#+gencgc
+(progn
+(defconstant gc-census-layouts 4096) ; GC_CENSUS_LAYOUTS in gencgc.c
+
+(defun gc-census-enabled ()
+  "True if each garbage collection takes a census of the objects which
+survive it. See GC-CENSUS."
+  (/= (extern-alien "gc_census_enabled" int) 0))
+(defun (setf gc-census-enabled) (value)
+  (setf (extern-alien "gc_census_enabled" int) (if value 1 0))
+  value)
+
+(defun gc-census (&key (top-n 15) (print t))
+  "Return the census of the objects which survived the most recent garbage
+collection, taken if (GC-CENSUS-ENABLED) was true when it ran. Only the
+generations which that collection examined are counted, so after (GC :FULL T)
+the census covers all of dynamic space. The first value is a list of
+(TYPE-NAME OBJECTS BYTES) by primitive type, and the second value a list of
+the same form by class, for instances and funcallable instances. Both are
+sorted by decreasing BYTES. If PRINT is true, also print the first TOP-N
+entries of each."
+  (declare (type (or fixnum null) top-n))
+  (let ((types (make-hash-table :test 'eq))
+        (classes (make-hash-table :test 'eq)))
+    (flet ((tally (table key objects nwords)
+             (let ((found (ensure-gethash key table (cons 0 0))))
+               (incf (car found) objects)
+               (incf (cdr found) (* nwords n-word-bytes)))))
+      (without-gcing
+        (let ((census (foreign-symbol-sap "gc_census" t)))
+          (dotimes (i 256)
+            (let ((objects (sap-ref-word census (* 2 i n-word-bytes))))
+              (unless (zerop objects)
+                (tally types (room-info-type-name (svref *room-info* i)) objects
+                       (sap-ref-word census (* (1+ (* 2 i)) n-word-bytes))))))
+          (let ((layouts (sap+ census (* 2 256 n-word-bytes))))
+            (dotimes (i gc-census-layouts)
+              (let* ((entry (sap+ layouts (* 3 i n-word-bytes)))
+                     (layout (sap-ref-word entry 0)))
+                (unless (zerop layout)
+                  (tally classes
+                         (wrapper-classoid-name
+                          (layout-friend (%make-lisp-obj layout)))
+                         (sap-ref-word entry n-word-bytes)
+                         (sap-ref-word entry (* 2 n-word-bytes))))))))))
+    (flet ((sorted (table)
+             (sort (loop for name being each hash-key of table
+                           using (hash-value (objects . bytes))
+                         collect (list name objects bytes))
+                   #'> :key #'third)))
+      (let ((types (sorted types))
+            (classes (sorted classes)))
+        (when print
+          (flet ((show (title list)
+                   (format t "~2&~@[Top ~W ~]~A surviving the last GC:~%"
+                           top-n title)
+                   (loop for (name objects bytes)
+                         in (if top-n (subseq list 0 (min (length list) top-n)) list)
+                         do (format t "  ~40@<~/sb-ext:print-symbol-with-prefix/~> ~
+                                       ~15:D bytes, ~12:D object~:P.~%"
+                                    name bytes objects))))
+            (show "types" types)
+            (show "instance types" classes)))
+        (values types classes)))))
+) ; end PROGN
+
 ;;;; PRINT-ALLOCATED-OBJECTS
 
 ;;; This function is sheer madness.  You're better off using
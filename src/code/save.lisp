@@ -91,6 +91,29 @@
             (reinit t)
             (funcall toplevel))))))
 
+;;; Convert the :COMPRESSION argument of SAVE-LISP-AND-DIE to the level
+;;; that the C runtime expects, or NIL for no compression.
+;;; A zstd level N is passed as 1000+N, which has to agree with
+;;; ZSTD_COMPRESSION_LEVEL_BASE in src/runtime/save.h
+(defun core-compression-level (compression)
+  (cond ((not compression) nil)
+        ((or (eq compression :zstd)
+             (and (consp compression) (eq (car compression) :zstd)))
+         #+sb-core-zstd
+         (let ((level (if (consp compression) (cadr compression) 3)))
+           (unless (and (typep level '(integer 1 22))
+                        (or (atom compression) (null (cddr compression))))
+             (error "~S is not a valid zstd core compression specifier" compression))
+           (+ 1000 level))
+         #-sb-core-zstd
+         (error "Unable to save zstd compressed core: this runtime was not built with zstd support"))
+        (t
+         #+sb-core-compression
+         (progn (check-type compression (or (eql t) (integer -1 9)))
+                (if (eq compression t) -1 compression))
+         #-sb-core-compression
+         (error "Unable to save compressed core: this runtime was not built with zlib support"))))
+
 (defun save-lisp-and-die (core-file-name &key
                                          (toplevel #'toplevel-init toplevel-supplied)
                                          (executable nil)
@@ -100,6 +123,9 @@
                                          (root-structures ())
                                          (environment-name "auxiliary")
                                          (compression nil)
+                                         (base-core nil)
+                                         (tree-shake nil)
+                                         (compact t)
                                          #+win32
                                          (application-type :console))
   "Save a \"core image\", i.e. enough information to restart a Lisp
@@ -168,6 +194,42 @@ The following &KEY arguments are defined:
      :SB-CORE-COMPRESSION was enabled at build-time, the argument may also be
      an integer from -1 to 9, corresponding to zlib compression levels, or T
      (which is equivalent to the default compression level, -1).
+     If the runtime was built with the :SB-CORE-ZSTD feature, the argument may
+     be :ZSTD, or a list (:ZSTD level) with a zstd compression level from 1 to
+     22 (:ZSTD alone uses level 3). Zstd cores are compressed and decompressed
+     in independent chunks by several threads, so they load much faster than
+     zlib cores.
+
+  :BASE-CORE
+     If supplied, the pathname of an uncompressed core previously saved by
+     this same runtime. The new core then holds only the pages that differ
+     from those of the base core, and maps the others from the base core
+     when it starts, so the base core has to stay in place and unchanged.
+     This can't be combined with :COMPRESSION, and isn't available on
+     Windows.
+
+  :TREE-SHAKE
+     If true, drop from the image everything that can't be reached from
+     the toplevel function or the callable exports. Symbols are kept in
+     their packages only if something else refers to them, so that what
+     they name goes away with them, except for those of the COMMON-LISP
+     package. TREE-SHAKE may also be a list of more roots: its symbols are
+     kept, its packages keep all their symbols, and any other object is
+     kept along with what it refers to. Documentation strings, source forms
+     of functions, and the debug information about variables and blocks of
+     functions other than external entry points are dropped as well. The
+     bytes taken by each category of objects before and after are printed.
+     Since symbols that were dropped can't be found by name afterwards, an
+     application that reads, interns or evaluates code at run time needs
+     to supply the packages it uses as roots.
+
+  :COMPACT
+     If true (the default), the heap is collected twice before saving: once
+     into high memory and then back down into the lowest pages, so that the
+     core holds no free pages between the objects, and similar objects are
+     coalesced in between. If NIL, it is collected once and saved as it is.
+     That takes about half as long, at the cost of a larger core. This
+     parameter has no effect on cheneygc.
 
   :APPLICATION-TYPE
      Present only on Windows and is meaningful only with :EXECUTABLE T.
@@ -207,17 +269,20 @@ sufficiently motivated to do lengthy fixes."
   (declare (ignore environment-name))
   #+gencgc
   (declare (ignore purify) (ignorable root-structures))
+  #-gencgc
+  (declare (ignore compact))
   (when (and callable-exports toplevel-supplied)
     (error ":TOPLEVEL cannot be supplied when there are callable exports."))
   ;; If the toplevel function is not defined, this will signal an
   ;; error before saving, not at startup time.
   (let ((toplevel (%coerce-callable-to-fun toplevel))
         *streams-closed-by-slad*)
-    #+sb-core-compression
-    (check-type compression (or boolean (integer -1 9)))
-    #-sb-core-compression
-    (when compression
-      (error "Unable to save compressed core: this runtime was not built with zlib support"))
+    (setf compression (core-compression-level compression))
+    (when base-core
+      #-(and gencgc (not win32) (not darwin-jit))
+      (error "Unable to save a delta core: not supported on this platform")
+      (when compression
+        (error ":BASE-CORE and :COMPRESSION can't be used together")))
     (when *dribble-stream*
       (restart-case (error "Dribbling to ~s is enabled." (pathname *dribble-stream*))
         (continue ()
@@ -226,13 +291,19 @@ sufficiently motivated to do lengthy fixes."
         (abort ()
           :report "Abort saving the core."
           (return-from save-lisp-and-die))))
-    (when (eql t compression)
-      (setf compression -1))
     (flet ((foreign-bool (value)
              (if value 1 0)))
-      (let ((name (native-namestring (physicalize-pathname core-file-name)
-                                     :as-file t))
-            (startfun (start-lisp toplevel callable-exports)))
+      (let* ((name (native-namestring (physicalize-pathname core-file-name)
+                                      :as-file t))
+             (base-core-name
+               (and base-core
+                    (native-namestring (physicalize-pathname (truename base-core))
+                                       :as-file t)))
+             (startfun (start-lisp toplevel callable-exports)))
+        (when (and base-core (equal (probe-file core-file-name) (truename base-core)))
+          (error "Can't save a delta core over its base core ~S" base-core))
+        (when tree-shake
+          (shake-tree tree-shake))
         (deinit)
         ;; FIXME: Would it be possible to unmix the PURIFY logic from this
         ;; function, and just do a GC :FULL T here? (Then if the user wanted
@@ -254,6 +325,12 @@ sufficiently motivated to do lengthy fixes."
           ;; as it would require pinning around the whole save operation.
           (with-pinned-objects (startfun)
             (setf lisp-init-function (get-lisp-obj-address startfun)))
+          (setf (extern-alien "gc_save_compact" char) (if compact 1 0))
+          #+(and (not win32) (not darwin-jit))
+          (setf (extern-alien "save_base_core" unsigned)
+                (if base-core-name
+                    (sap-int (alien-sap (make-alien-string base-core-name)))
+                    0))
           ;; Do a destructive non-conservative GC, and then save a core.
           ;; A normal GC will leave huge amounts of storage unreclaimed
           ;; (over 50% on x86). This needs to be done by a single function
@@ -488,10 +565,15 @@ sb-c::
                 (eql (debug-source-created a) (debug-source-created b)))))
     ;; Coalesce the following:
     ;;  DEBUG-INFO-SOURCE, DEBUG-FUN-NAME
+    ;;  the VARS, BLOCKS, ARGUMENTS and RETURNS vectors of debug funs
     ;;  SIMPLE-FUN-ARGLIST, SIMPLE-FUN-TYPE
     ;; FUN-NAMES-EQUALISH considers any two string= gensyms as EQ.
     (let ((source-ht (make-hash-table :test 'equal))
           (name-ht (make-hash-table :test 'equal))
+          ;; Keyed by widetag and contents, as EQUALP alone would equate
+          ;; vectors of different element types. Nothing modifies these
+          ;; vectors, and small functions often have identical ones.
+          (debug-vector-ht (make-hash-table :test 'equalp))
           (arglist-hash (make-hash-table :hash-function 'sb-impl::equal-hash
                                          :test 'sb-impl::fun-names-equalish))
           (type-hash (make-hash-table :test 'equal)))
@@ -545,6 +627,19 @@ sb-c::
                            ((neq name new)
                             (%instance-set debug-fun (get-dsd-index compiled-debug-fun name)
                                   new))))
+                   (macrolet ((share (accessor)
+                                `(let ((vector (,accessor debug-fun)))
+                                   (when (typep vector '(simple-array * (*)))
+                                     (let ((shared
+                                             (ensure-gethash
+                                              (cons (%other-pointer-widetag vector) vector)
+                                              debug-vector-ht vector)))
+                                       (unless (eq shared vector)
+                                         (setf (,accessor debug-fun) shared)))))))
+                     (share sb-c::compiled-debug-fun-vars)
+                     (share sb-c::compiled-debug-fun-blocks)
+                     (share sb-c::compiled-debug-fun-arguments)
+                     (share sb-c::compiled-debug-fun-returns))
                    while next))
             (sb-lockless::linked-list
              ;; In the normal course of execution, incompletely deleted nodes
@@ -770,6 +865,20 @@ sb-c::
       ;; Place functions called by assembler routines next.
       (dovector (f +static-fdefns+)
         (emplace (fun-code-header (symbol-function f))))
+      ;; Then the code of the functions that took the most samples of the
+      ;; profile in SB-C::*HOT-FUNCTIONS*, hottest first, so that what runs
+      ;; most shares pages and cache lines.
+      (let ((hot sb-c::*hot-functions*))
+        (when hot
+          (dolist (name (sort (loop for name being each hash-key of hot
+                                    collect name)
+                              #'> :key (lambda (name) (gethash name hot))))
+            (let ((fun (and (fboundp name) (fdefinition name))))
+              (when (closurep fun)
+                (setq fun (%closure-fun fun)))
+              (when (and (simple-fun-p fun)
+                         (immobile-space-obj-p (fun-code-header fun)))
+                (emplace (fun-code-header fun)))))))
       #+nil
       (mapc #'visit
             (mapcan (lambda (x)
@@ -2500,14 +2500,23 @@ many elements are copied."
                        (typecase sequence
                          #+sb-unicode
                          ((simple-array character (*)) (frob2))
-                         ((simple-array base-char (*)) (frob2))
+                         ,@(when bit-frob
+                             `(((simple-array base-char (*))
+                                (if (and (typep item 'base-char)
+                                         (trivial-key-and-test-p))
+                                    (octet-position (char-code item))
+                                    (frob2)))
+                               ((simple-array (unsigned-byte 8) (*))
+                                (if (and (typep item '(unsigned-byte 8))
+                                         (trivial-key-and-test-p))
+                                    (octet-position item)
+                                    (vector*-frob sequence)))))
+                         ,@(unless bit-frob
+                             `(((simple-array base-char (*)) (frob2))))
                          ,@(when bit-frob
                              `((simple-bit-vector
                                 (if (and (typep item 'bit)
-                                         (eq #'identity key)
-                                         (or (eq #'eq test)
-                                             (eq #'eql test)
-                                             (eq #'equal test)))
+                                         (trivial-key-and-test-p))
                                     (let ((p (%bit-position item sequence
                                                             from-end start end)))
                                       (if p
@@ -2528,7 +2537,17 @@ many elements are copied."
                                   ,from-end start end key test))
                (vector*-frob (sequence)
                  `(%find-position-vector-macro item ,sequence
-                                               from-end start end key test)))
+                                               from-end start end key test))
+               (trivial-key-and-test-p ()
+                 `(and (eq #'identity key)
+                       (or (eq #'eq test)
+                           (eq #'eql test)
+                           (eq #'equal test))))
+               (octet-position (byte)
+                 `(let ((p (%octet-position ,byte sequence from-end start end)))
+                    (if p
+                        (values item p)
+                        (values nil nil)))))
       (frobs t)))
   (defun %find-position-if (predicate sequence-arg from-end start end key)
     (declare (explicit-check sequence-arg))
@@ -2738,6 +2757,17 @@ many elements are copied."
   (when (and test-p test-not-p)
     ;; Use the same wording as EFFECTIVE-FIND-POSITION-TEST
     (error "can't specify both :TEST and :TEST-NOT"))
+  ;; Bits are counted a word at a time
+  (when (and (bit-vector-p sequence)
+             (typep item 'bit)
+             (not key)
+             (not test-p)
+             (not test-not-p))
+    (return-from count
+      (with-array-data ((data sequence) (start start) (end end)
+                        :check-fill-pointer t)
+        (let ((ones (%bit-count data start end)))
+          (if (eql item 1) ones (- end start ones))))))
   (let ((test (or test-not test)))
     (seq-dispatch-checking sequence
         (let ((end (or end length)))
@@ -31,7 +31,8 @@
   bogus)
 (declaim (freeze-type handler))
 
-(defstruct (pollfds (:constructor make-pollfds (list))
+(defstruct (pollfds (:constructor make-pollfds
+                        (list #+linux &aux #+linux (n-handlers (length list))))
                     (:copier nil))
   (list)
   ;; If using poll() we maintain, in addition to a list of HANDLER,
@@ -44,7 +45,24 @@
   ;; which is created potentially oversized.
   #+os-provides-poll (n-fds)
   ;; map from index in LIST to index into alien FDS
-  #+os-provides-poll (map))
+  #+os-provides-poll (map)
+  ;; With many handlers, building the C array and scanning all of it on each
+  ;; wakeup is the dominant cost, so on Linux the descriptors are instead kept
+  ;; registered with an epoll instance. EPFD is its descriptor, or NIL when
+  ;; using poll(), or :OFF if the kernel refused and poll() should be used
+  ;; from now on. The remaining slots are used only when EPFD is a descriptor.
+  #+linux (n-handlers 0 :type index)
+  #+linux (epfd nil)
+  ;; map from descriptor to the list of its handlers
+  #+linux (by-fd nil)
+  ;; map from descriptor to the event mask registered for it, or :UNPOLLABLE
+  ;; if epoll can't wait on it, or :BAD if it wasn't a valid descriptor
+  #+linux (registered nil)
+  ;; descriptors which are :UNPOLLABLE or :BAD
+  #+linux (odd nil)
+  ;; descriptors whose handlers were added, removed, or marked bogus since
+  ;; the kernel was last told, possibly with duplicates
+  #+linux (dirty nil))
 (declaim (freeze-type pollfds))
 
 (defmethod print-object ((handler handler) stream)
@@ -79,6 +97,180 @@
           (pollfds-n-fds it) nil
           (pollfds-map it) nil)))
 
+#+linux
+(progn
+;;; The number of handlers at which SUB-SUB-SERVE-EVENT starts to use epoll.
+;;; It goes back to poll() below half as many, so that handlers coming and
+;;; going near the threshold don't make it flip back and forth.
+(declaim (type index *epoll-threshold*))
+(defvar *epoll-threshold* 128)
+
+(defun epoll-stop (holder)
+  (let ((epfd (pollfds-epfd holder)))
+    (when (integerp epfd)
+      (sb-unix:unix-close epfd)
+      (setf (pollfds-epfd holder) nil
+            (pollfds-by-fd holder) nil
+            (pollfds-registered holder) nil
+            (pollfds-odd holder) nil
+            (pollfds-dirty holder) nil))))
+
+(defun epoll-start (holder)
+  (let ((epfd (sb-unix:unix-epoll-create)))
+    (cond ((not epfd)
+           (setf (pollfds-epfd holder) :off))
+          (t
+           (deallocate-pollfds)
+           (let ((by-fd (make-hash-table)))
+             (dolist (handler (pollfds-list holder))
+               (push handler (gethash (handler-descriptor handler) by-fd)))
+             (setf (pollfds-epfd holder) epfd
+                   (pollfds-by-fd holder) by-fd
+                   (pollfds-registered holder) (make-hash-table)
+                   (pollfds-odd holder) nil
+                   (pollfds-dirty holder)
+                   (loop for fd being each hash-key of by-fd collect fd)))))))
+
+;;; Record that the set of usable handlers of FD may have changed.
+(defun epoll-note-fd (holder fd)
+  (when (integerp (pollfds-epfd holder))
+    (push fd (pollfds-dirty holder))))
+
+(defun epoll-note-bogus (handlers)
+  (with-descriptor-handlers
+    (awhen *descriptor-handlers*
+      (dolist (handler handlers)
+        (epoll-note-fd it (handler-descriptor handler))))))
+
+(defun epoll-add-handler (holder handler)
+  (incf (pollfds-n-handlers holder))
+  (when (integerp (pollfds-epfd holder))
+    (push handler (gethash (handler-descriptor handler) (pollfds-by-fd holder)))
+    (epoll-note-fd holder (handler-descriptor handler))))
+
+(defun epoll-forget-handler (holder handler)
+  (when (integerp (pollfds-epfd holder))
+    (let* ((fd (handler-descriptor handler))
+           (by-fd (pollfds-by-fd holder))
+           (remaining (delete handler (gethash fd by-fd))))
+      (if remaining
+          (setf (gethash fd by-fd) remaining)
+          (remhash fd by-fd))
+      (epoll-note-fd holder fd))))
+
+;;; Tell the kernel about each dirty descriptor. The registration is redone
+;;; even if the event mask didn't change, because the descriptor may have
+;;; been closed and reused, which the kernel does not forgive.
+(defun epoll-sync (holder)
+  (let ((epfd (pollfds-epfd holder))
+        (by-fd (pollfds-by-fd holder))
+        (registered (pollfds-registered holder)))
+    (dolist (fd (shiftf (pollfds-dirty holder) nil))
+      (let ((mask 0)
+            (old (gethash fd registered)))
+        (dolist (handler (gethash fd by-fd))
+          (unless (handler-bogus handler)
+            (setq mask (logior mask (ecase (handler-direction handler)
+                                      (:input 1)
+                                      (:output 2))))))
+        (when (member old '(:unpollable :bad))
+          (setf (pollfds-odd holder) (delete fd (pollfds-odd holder))))
+        (cond ((zerop mask)
+               (when old
+                 (when (integerp old)
+                   ;; this fails harmlessly if FD was closed already
+                   (sb-unix:unix-epoll-set epfd fd 0))
+                 (remhash fd registered)))
+              (t
+               (multiple-value-bind (result errno)
+                   (sb-unix:unix-epoll-set epfd fd mask)
+                 (let ((new (case result
+                              (0 mask)
+                              (1 :unpollable)
+                              (t (if (eql errno sb-unix:ebadf) :bad)))))
+                   (unless new
+                     ;; Out of watches, perhaps. poll() will do.
+                     (epoll-stop holder)
+                     (setf (pollfds-epfd holder) :off)
+                     (return-from epoll-sync))
+                   (setf (gethash fd registered) new)
+                   (unless (integerp new)
+                     (push fd (pollfds-odd holder)))))))))))
+
+;;; Called from SUB-SUB-SERVE-EVENT within WITH-DESCRIPTOR-HANDLERS.
+;;; Switch between poll() and epoll as needed, and return true if using epoll.
+(defun epoll-prepare (holder)
+  (let ((n (pollfds-n-handlers holder))
+        (epfd (pollfds-epfd holder)))
+    (cond ((and (not epfd) (>= n *epoll-threshold*))
+           (epoll-start holder))
+          ((and (integerp epfd) (< n (floor *epoll-threshold* 2)))
+           (epoll-stop holder)))
+    (when (integerp (pollfds-epfd holder))
+      (epoll-sync holder)
+      (integerp (pollfds-epfd holder)))))
+
+;;; The epoll counterpart of the poll() code in SUB-SUB-SERVE-EVENT.
+(defun epoll-serve-event (holder to-msec)
+  (let ((epfd (pollfds-epfd holder)))
+    (when (pollfds-odd holder)
+      ;; Like poll(), don't wait if there are files that are always ready
+      ;; or descriptors to complain about.
+      (setq to-msec 0))
+    (with-alien ((fds (array int 256))
+                 (events (array int 256)))
+      (multiple-value-bind (value err)
+          (sb-unix:unix-epoll-wait epfd (alien-sap fds) (alien-sap events)
+                                   256 to-msec)
+        (cond ((not value)
+               (if (member err '(#.sb-unix:eintr #.sb-unix:eagain))
+                   t
+                   (with-simple-restart (continue "Ignore failure and continue.")
+                     (simple-perror "Unix system call epoll_wait() failed"
+                                    :errno err))))
+              (t
+               (let (good bad)
+                 (with-descriptor-handlers
+                   ;; A handler run by an interrupt during the wait could
+                   ;; have removed enough handlers to stop using epoll.
+                   (unless (eql (pollfds-epfd holder) epfd)
+                     (return-from epoll-serve-event t))
+                   (let ((by-fd (pollfds-by-fd holder))
+                         (registered (pollfds-registered holder)))
+                     (flet ((ready (handler mask)
+                              (when (and (not (handler-bogus handler))
+                                         (logtest mask
+                                                  (ecase (handler-direction handler)
+                                                    (:input 1)
+                                                    (:output 2))))
+                                (push handler good))))
+                       (dotimes (i value)
+                         (let ((fd (deref fds i)))
+                           (if (integerp (gethash fd registered))
+                               (dolist (handler (gethash fd by-fd))
+                                 (ready handler (deref events i)))
+                               ;; Not ours any more, but it stays in the
+                               ;; epoll set if its file was dup'ed before
+                               ;; the descriptor was closed. Start afresh
+                               ;; if it can't be removed.
+                               (unless (sb-unix:unix-epoll-set epfd fd 0)
+                                 (epoll-stop holder)
+                                 (return-from epoll-serve-event t)))))
+                       (dolist (fd (pollfds-odd holder))
+                         (dolist (handler (gethash fd by-fd))
+                           (if (eq (gethash fd registered) :bad)
+                               (unless (handler-bogus handler)
+                                 (push handler bad))
+                               (ready handler 3)))))))
+                 (cond (bad
+                        (handler-descriptors-error bad))
+                       (good
+                        (dolist (handler good t)
+                          (invoke-handler handler)))
+                       (t
+                        (plusp value))))))))))
+) ; end PROGN
+
 (defun list-all-descriptor-handlers ()
   (with-descriptor-handlers
     (awhen *descriptor-handlers*
@@ -109,34 +301,42 @@
       (let ((handlers *descriptor-handlers*))
         (if (not handlers)
             (setf *descriptor-handlers* (make-pollfds (list handler)))
-            (push handler (pollfds-list handlers)))))
+            (progn
+              (push handler (pollfds-list handlers))
+              #+linux (epoll-add-handler handlers handler)))))
     handler))
 
-(macrolet ((filter-handlers (newval-form)
+;;; Delete the handlers H for which TEST-FORM is true.
+(macrolet ((filter-handlers (test-form)
              `(with-descriptor-handlers
                 (deallocate-pollfds)
-                (let* ((holder *descriptor-handlers*)
-                       (handlers (if holder (pollfds-list holder)))
-                       (list ,newval-form))
-                  ;; The case of "no handlers" is *DESCRIPTOR-HANDLERS* = NIL,
-                  ;; like it starts as. So we set it back to NIL rather than
-                  ;; an empty struct if no handlers remain.
-                  (if list
-                      ;; Since this macro is only for deletion of handlers,
-                      ;; if LIST is not nil then HOLDER was too.
-                      (setf (pollfds-list holder) list)
-                      (setf *descriptor-handlers* nil))))))
+                (let ((holder *descriptor-handlers*))
+                  (when holder
+                    (let ((list (delete-if (lambda (h)
+                                             (when ,test-form
+                                               #+linux (epoll-forget-handler holder h)
+                                               t))
+                                           (pollfds-list holder))))
+                      ;; The case of "no handlers" is *DESCRIPTOR-HANDLERS* = NIL,
+                      ;; like it starts as. So we set it back to NIL rather than
+                      ;; an empty struct if no handlers remain.
+                      (cond (list
+                             (setf (pollfds-list holder) list)
+                             #+linux (setf (pollfds-n-handlers holder) (length list)))
+                            (t
+                             #+linux (epoll-stop holder)
+                             (setf *descriptor-handlers* nil)))))))))
 
 ;;; Remove an old handler from *descriptor-handlers*.
 (defun remove-fd-handler (handler)
   "Removes HANDLER from the list of active handlers."
-  (filter-handlers (delete handler handlers)))
+  (filter-handlers (eq h handler)))
 
 ;;; Search *descriptor-handlers* for any reference to fd, and nuke 'em.
 (defun invalidate-descriptor (fd)
   "Remove any handlers referring to FD. This should only be used when attempting
   to recover from a detected inconsistency."
-  (filter-handlers (delete fd handlers :key #'handler-descriptor)))
+  (filter-handlers (eql (handler-descriptor h) fd)))
 
 ;;; Add the handler to *descriptor-handlers* for the duration of BODY.
 ;;; Note: this makes the poll() interface not super efficient because
@@ -175,16 +375,18 @@
                     (sb-unix:unix-fstat (handler-descriptor handler)))
           (setf (handler-bogus handler) t)
           (push handler bogus-handlers))))
+  #+linux (epoll-note-bogus bogus-handlers)
   (when bogus-handlers
       (restart-case (error "~S ~[have~;has a~:;have~] bad file descriptor~:P."
                            bogus-handlers (length bogus-handlers))
         (remove-them ()
           :report "Remove bogus handlers."
-          (filter-handlers (delete-if #'handler-bogus handlers)))
+          (filter-handlers (handler-bogus h)))
         (retry-them ()
           :report "Retry bogus handlers."
           (dolist (handler bogus-handlers)
-            (setf (handler-bogus handler) nil)))
+            (setf (handler-bogus handler) nil))
+          #+linux (epoll-note-bogus bogus-handlers))
         (continue ()
           :report "Go on, leaving handlers marked as bogus.")))
   nil))
@@ -258,14 +460,10 @@ waiting."
              (loop for to-msec = (if (and to-sec to-usec)
                                      (+ (* 1000 to-sec) (truncate to-usec 1000))
                                      -1)
-                   when (or #+win32 (eq direction :output)
-                            #+win32 (sb-win32:handle-listen fd (or to-sec 0) (or to-usec 0))
-                            #-win32
-                            (sb-unix:unix-simple-poll fd direction to-msec))
+                   when (sb-unix:unix-simple-poll fd direction to-msec)
                    do (return-from wait-until-fd-usable t)
                    else
-                   do (when to-sec (maybe-update-timeout))
-                   #+win32 (sb-thread:thread-yield)))))))
+                   do (when to-sec (maybe-update-timeout))))))))
 
 ;;; Wait for up to timeout seconds for an event to happen. Make sure all
 ;;; pending events are processed before returning.
@@ -342,7 +540,6 @@ happens. Server returns T if something happened and NIL otherwise. Timeout
                                     (addr read-fds)
                                     (addr write-fds)
                                     nil to-sec to-usec)
-        (declare (ignorable err)) ; unused if win32
         ;; Now see what it was (if anything)
         (cond ((not value)
                ;; Interrupted or one of the file descriptors is bad.
@@ -359,7 +556,9 @@ happens. Server returns T if something happened and NIL otherwise. Timeout
                     (simple-perror "Unix system call select() failed"
                                    :errno err))))
                #+win32
-               (handler-descriptors-error))
+               (if (eql err sb-unix:eintr)
+                   t
+                   (handler-descriptors-error)))
               ((plusp value)
                ;; Got something. Call file descriptor handlers
                ;; according to the readable and writable masks
@@ -447,15 +646,16 @@ happens. Server returns T if something happened and NIL otherwise. Timeout
 ;;; true if something of interest happened.
 #+os-provides-poll
 (defun sub-sub-serve-event (to-sec to-usec)
-  (let (list fds count map)
+  (let (list fds count map #+linux epoll)
     (with-descriptor-handlers
       (let ((handlers *descriptor-handlers*))
         (when handlers
+          #+linux (when (epoll-prepare handlers) (setq epoll handlers))
           (setq list  (pollfds-list handlers)
                 fds   (pollfds-fds handlers)
                 count (pollfds-n-fds handlers)
                 map   (pollfds-map handlers))
-          (when (and list (not fds)) ; make the C array
+          (when (and list (not fds) #+linux (not epoll)) ; make the C array
             (multiple-value-setq (fds count map) (compute-pollfds list))
             (setf (pollfds-fds handlers)   fds
                   (pollfds-n-fds handlers) count
@@ -465,6 +665,10 @@ happens. Server returns T if something happened and NIL otherwise. Timeout
            (if (or (null to-sec) (null to-usec))
                -1
                (ceiling (+ (* to-sec 1000000) to-usec) 1000))))
+      #+linux
+      (when epoll
+        (return-from sub-sub-serve-event
+          (epoll-serve-event epoll to-millisec)))
       ;; Next, wait for something to happen.
       (multiple-value-bind (value err)
           (if list
@@ -52,3 +52,105 @@
         (when verbose
           (format t "~&Dropped ~D symbols~%" n-dropped))
         (force-output)))))
+
+;;;; Shaking the tree for SAVE-LISP-AND-DIE :TREE-SHAKE
+
+(define-load-time-global *heap-categories*
+    #("code" "debug info" "symbols" "strings" "other vectors" "conses"
+      "instances" "functions" "other"))
+
+;;; Return a vector of the bytes occupied by the objects of each of
+;;; *HEAP-CATEGORIES* in dynamic and immobile space.
+(defun heap-usage-by-category ()
+  (gc :full t)
+  (let ((totals (make-array (length *heap-categories*) :initial-element 0)))
+    (sb-vm:map-allocated-objects
+     (lambda (obj widetag size)
+       (incf (svref totals
+                    (cond ((= widetag sb-vm:code-header-widetag) 0)
+                          ((typep obj '(or sb-c::debug-info sb-c::debug-fun
+                                        sb-c::debug-source))
+                           1)
+                          ((symbolp obj) 2)
+                          ((stringp obj) 3)
+                          ((vectorp obj) 4)
+                          ((consp obj) 5)
+                          ((%instancep obj) 6)
+                          ((functionp obj) 7)
+                          (t 8)))
+             size))
+     :dynamic #+immobile-space :immobile)
+    totals))
+
+(defun print-heap-usage-report (before after &optional (stream *standard-output*))
+  (format stream "~&~15A ~15@A ~15@A~%" "Bytes of" "before" "after")
+  (loop for name across *heap-categories*
+        for old across before
+        for new across after
+        do (format stream "~15A ~15:D ~15:D~%" name old new))
+  (format stream "~15A ~15:D ~15:D~%"
+          "total" (reduce #'+ before) (reduce #'+ after))
+  (force-output stream))
+
+;;; Drop the documentation strings of everything, the source forms of
+;;; all functions, and the debug information about the variables and
+;;; blocks of all functions but what the debugger needs to show the
+;;; arguments of external entry points.
+(defun drop-documentation-and-debug-info ()
+  (let ((names))
+    (call-with-each-globaldb-name (lambda (name) (push name names)))
+    (dolist (name names)
+      (clear-info :variable :documentation name)
+      (clear-info :type :documentation name)
+      (clear-info :typed-structure :documentation name)
+      (clear-info :random-documentation :stuff name)
+      (when (and (legal-fun-name-p name) (fboundp name))
+        (let ((fun (fdefinition name)))
+          (when (typep fun 'generic-function)
+            (setf (slot-value fun 'sb-pcl::%documentation) nil)
+            (dolist (method (sb-mop:generic-function-methods fun))
+              (when (slot-exists-p method 'sb-pcl::%documentation)
+                (setf (slot-value method 'sb-pcl::%documentation) nil))))))
+      (let ((class (and (symbolp name) (find-class name nil))))
+        (when (and class (slot-exists-p class 'sb-pcl::%documentation))
+          (setf (slot-value class 'sb-pcl::%documentation) nil)))))
+  (dolist (package (list-all-packages))
+    (setf (package-doc-string package) nil))
+  (clrhash sb-di::*compiled-debug-funs*)
+  (sb-vm:map-allocated-objects
+   (lambda (obj widetag size)
+     (declare (ignore size))
+     (case widetag
+       (#.sb-vm:code-header-widetag
+        (dotimes (i (code-n-entries obj))
+          (setf (%simple-fun-source (%code-entry-point obj i)) nil)))
+       (#.sb-vm:instance-widetag
+        (when (typep obj 'sb-c::compiled-debug-fun)
+          (setf (sb-c::compiled-debug-fun-blocks obj) nil)
+          (unless (or (eq (sb-c::compiled-debug-fun-arguments obj) :minimal)
+                      (eq (sb-c::compiled-debug-fun-kind obj) :external))
+            (setf (sb-c::compiled-debug-fun-vars obj) nil
+                  (sb-c::compiled-debug-fun-arguments obj) nil))))))
+   :all))
+
+;;; Drop what can't be reached from ROOTS, which are T or a list:
+;;; the symbols in it are kept, the packages in it keep all their
+;;; symbols, and any other object is kept with what it refers to. The
+;;; caller holds on to the toplevel function. Symbols of the COMMON-LISP
+;;; package are all kept.
+(defun shake-tree (roots &key (report t))
+  (let ((roots (if (listp roots) roots '()))
+        (before (and report (heap-usage-by-category))))
+    ;; Forget the forms and values that the REPL remembers, as DEINIT
+    ;; would later, so that they don't keep anything.
+    (setf * nil ** nil *** nil
+          - nil + nil ++ nil +++ nil
+          /// nil // nil / nil)
+    (drop-documentation-and-debug-info)
+    (shake-packages (lambda (symbol accessibility)
+                      (declare (ignore accessibility))
+                      (or (memq symbol roots)
+                          (memq (symbol-package symbol) roots)))
+                    :verbose report)
+    (when report
+      (print-heap-usage-report before (heap-usage-by-category)))))
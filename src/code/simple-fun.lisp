@@ -316,16 +316,25 @@
   (let ((function (awhen (find-fdefn name) (fdefn-fun it))))
     (if (not function)
         (specifier-type 'function)
-        ;; Never signal the PARSE-UNKNOWN-TYPE condition.
-        ;; This affects 2 regression tests, both very contrived:
-        ;;  - in defstruct.impure ASSERT-ERROR (BUG127--FOO (MAKE-BUG127-E :FOO 3))
-        ;;  - in compiler.impure at :IDENTIFY-SUSPECT-VOPS
-        (let* ((ftype (%fun-ftype function))
-               (context
-                (sb-kernel::make-type-context
-                 ftype nil sb-kernel::+type-parse-signal-inhibit+)))
-          (declare (truly-dynamic-extent context))
-          (values (sb-kernel::basic-parse-typespec ftype context))))))
+        ;; The compiler asks for this at each reference from each
+        ;; toplevel form, so remember the answer for the rest of the
+        ;; compilation unless it may still change.
+        (let ((cache (and (boundp 'sb-c::*compilation*)
+                          (sb-c::fdefn-ftypes sb-c::*compilation*))))
+          (or (and cache (gethash function cache))
+              ;; Never signal the PARSE-UNKNOWN-TYPE condition.
+              ;; This affects 2 regression tests, both very contrived:
+              ;;  - in defstruct.impure ASSERT-ERROR (BUG127--FOO (MAKE-BUG127-E :FOO 3))
+              ;;  - in compiler.impure at :IDENTIFY-SUSPECT-VOPS
+              (let* ((ftype (%fun-ftype function))
+                     (context
+                      (sb-kernel::make-type-context
+                       ftype nil sb-kernel::+type-parse-signal-inhibit+))
+                     (ctype (sb-kernel::basic-parse-typespec ftype context)))
+                (declare (truly-dynamic-extent context))
+                (when (and cache (not (contains-unknown-type-p ctype)))
+                  (setf (gethash function cache) ctype))
+                ctype))))))
 
 ;;; Return the lambda expression for SIMPLE-FUN if compiled to memory
 ;;; and rentention of forms was enabled via the EVAL-STORE-SOURCE-FORM policy
@@ -35,7 +35,9 @@
                           (start)
                           (end)
                           :check-fill-pointer t)
-          (sort-vector vector start end predicate-fun key-fun-or-nil))
+          (unless (numeric-sort-vector vector start end
+                                       predicate-fun key-fun-or-nil)
+            (sort-vector vector start end predicate-fun key-fun-or-nil)))
         sequence)
       (apply #'sb-sequence:sort sequence predicate args))))
 
@@ -334,10 +336,372 @@
            (type (or null function) key))
   (declare (explicit-check))
   (declare (dynamic-extent pred key))
-  (if (<= (length vector) 1) ; avoid consing
-      vector
-      (vector-merge-sort vector pred key aref)))
+  (cond ((<= (length vector) 1) ; avoid consing
+         vector)
+        ((with-array-data ((data (the vector vector)) (start) (end)
+                           :check-fill-pointer t)
+           (numeric-sort-vector data start end pred key))
+         vector)
+        (t
+         (vector-merge-sort vector pred key aref))))
 
+;;;; parallel sorting of numeric vectors
+
+;;; A specialized vector of reals compared by #'< or #'> is sorted
+;;; without calling any user code, so large ones can be divided among
+;;; several threads. Each thread sorts a contiguous piece with a stable
+;;; merge sort specialized on the element type. Pieces are then merged
+;;; pairwise, with every merge again split by output position among all
+;;; the threads, so that each round does an equal share of work per
+;;; thread. The result is stable, so it serves SORT and STABLE-SORT alike.
+
+(defvar *parallel-sort-threshold* 1000000
+  "Specialized vectors of numbers at least this long are sorted by #'< or #'>
+in several threads, one per processor. NIL means to always sort in the
+calling thread.")
+
+(eval-when (:compile-toplevel :execute)
+
+;;; Merge SRC[A0,A1) and SRC[B0,B1) into DST starting at D. On ties the
+;;; element from the first run goes first.
+(sb-xc:defmacro merge-numeric-runs (pred src dst a0 a1 b0 b1 d)
+  `(let ((i ,a0) (j ,b0) (k ,d))
+     (declare (index i j k))
+     (loop while (and (< i ,a1) (< j ,b1))
+           do (let ((x (aref ,src i)) (y (aref ,src j)))
+                (cond ((,pred y x) (setf (aref ,dst k) y) (incf j))
+                      (t (setf (aref ,dst k) x) (incf i)))
+                (incf k)))
+     (loop while (< i ,a1)
+           do (setf (aref ,dst k) (aref ,src i)) (incf i) (incf k))
+     (loop while (< j ,b1)
+           do (setf (aref ,dst k) (aref ,src j)) (incf j) (incf k))))
+
+;;; Define the two kernels for one element type and predicate:
+;;; RUN sorts VECTOR[START,END) using TEMP[START,END) as scratch space,
+;;; unless that range holds a NaN, in which case it returns T at once.
+;;; PART writes output positions [M0,M1) of the merge of SRC[A0,A1) and
+;;; SRC[A1,A2) into DST[A0+M0,A0+M1).
+(sb-xc:defmacro define-numeric-sort-kernels (run part type pred)
+  `(progn
+     (defun ,run (vector temp start end)
+       (declare (type (simple-array ,type (*)) vector temp)
+                (index start end)
+                (optimize speed (safety 0)))
+       ,@(when (member type '(single-float double-float))
+           `((loop for i from start below end
+                   do (let ((x (aref vector i)))
+                        (when (/= x x) (return-from ,run t))))))
+       (loop for lo of-type index from start below end by 16
+             do (let ((hi (min end (+ lo 16))))
+                  (loop for i of-type index from (1+ lo) below hi
+                        do (let ((x (aref vector i))
+                                 (j i))
+                             (declare (index j))
+                             (loop while (and (> j lo) (,pred x (aref vector (1- j))))
+                                   do (setf (aref vector j) (aref vector (1- j)))
+                                      (decf j))
+                             (setf (aref vector j) x)))))
+       (let ((src vector) (dst temp))
+         (declare (type (simple-array ,type (*)) src dst))
+         (loop for width of-type index = 16 then (* width 2)
+               while (< width (- end start))
+               do (loop for lo of-type index from start below end by (* 2 width)
+                        do (let* ((mid (min end (+ lo width)))
+                                  (hi (min end (+ mid width))))
+                             (merge-numeric-runs ,pred src dst lo mid mid hi lo)))
+                  (rotatef src dst))
+         (unless (eq src vector)
+           (replace vector src :start1 start :end1 end :start2 start)))
+       nil)
+     (defun ,part (src dst a0 a1 a2 m0 m1)
+       (declare (type (simple-array ,type (*)) src dst)
+                (index a0 a1 a2 m0 m1)
+                (optimize speed (safety 0)))
+       (flet ((co-rank (m)
+                ;; The number of elements of the first run among the
+                ;; first M elements of the merged output
+                (declare (index m))
+                (let ((lo (max 0 (- m (- a2 a1))))
+                      (hi (min m (- a1 a0))))
+                  (declare (index lo hi))
+                  (loop while (< lo hi)
+                        do (let* ((i (ash (+ lo hi) -1))
+                                  (j (- m i)))
+                             (if (and (< i (- a1 a0)) (> j 0)
+                                      (not (,pred (aref src (+ a1 j -1))
+                                                  (aref src (+ a0 i)))))
+                                 (setf lo (1+ i))
+                                 (setf hi i))))
+                  lo)))
+         (let ((i0 (co-rank m0))
+               (i1 (co-rank m1)))
+           (merge-numeric-runs ,pred src dst
+                               (+ a0 i0) (+ a0 i1)
+                               (+ a1 (- m0 i0)) (+ a1 (- m1 i1))
+                               (+ a0 m0)))))))
+) ; EVAL-WHEN
+
+(macrolet ((def (&rest types)
+             (let ((kernels
+                    (loop for type in types
+                          collect (list type
+                                        (symbolicate "%SORT-RUN-" type "-<")
+                                        (symbolicate "%SORT-PART-" type "-<")
+                                        (symbolicate "%SORT-RUN-" type "->")
+                                        (symbolicate "%SORT-PART-" type "->")))))
+               `(progn
+                  ,@(loop for (type run< part< run> part>) in kernels
+                          collect `(define-numeric-sort-kernels ,run< ,part< ,type <)
+                          collect `(define-numeric-sort-kernels ,run> ,part> ,type >))
+                  ;; Return the kernels for sorting VECTOR by PREDICATE,
+                  ;; or NIL if there are none
+                  (defun numeric-sort-kernels (vector predicate)
+                    (let ((direction (cond ((eq predicate #'<) 0)
+                                           ((eq predicate #'>) 1))))
+                      (when direction
+                        (typecase vector
+                          ,@(loop for (type run< part< run> part>) in kernels
+                                  collect `((simple-array ,type (*))
+                                            (if (eql direction 0)
+                                                (values #',run< #',part<)
+                                                (values #',run> #',part>))))))))))))
+  (def double-float single-float fixnum sb-vm:signed-word word))
+
+;;; Call each of TASKS, all but the first in new threads, and wait for
+;;; all of them. A task that can't get a thread runs in this one.
+(defun run-parallel-sort-tasks (tasks)
+  (let ((threads '()))
+    (unwind-protect
+         (progn
+           (dolist (task (rest tasks))
+             (let ((thread (handler-case
+                               (sb-thread:make-thread task :name "parallel sort")
+                             (error () nil))))
+               (if thread
+                   (push thread threads)
+                   (funcall (the function task)))))
+           (funcall (the function (first tasks))))
+      (dolist (thread threads)
+        (sb-thread:join-thread thread :default nil)))))
+
+(defun %parallel-sort (vector start end run part n-threads)
+  (declare (type (simple-array * (*)) vector)
+           (index start end)
+           (function run part)
+           (type (integer 2 64) n-threads))
+  (let ((temp (make-array end :element-type (array-element-type vector)))
+        (n (- end start)))
+    (flet ((bound (i)
+             (+ start (floor (* i n) n-threads)))
+           (tasks (fun)
+             (loop for i below n-threads
+                   collect (let ((i i)) (lambda () (funcall fun i))))))
+      (let ((nan (make-array n-threads :initial-element nil)))
+        (run-parallel-sort-tasks
+         (tasks (lambda (i)
+                  (setf (svref nan i)
+                        (funcall run vector temp (bound i) (bound (1+ i)))))))
+        ;; NaNs are unordered, which would make the merges below lose
+        ;; elements; let the caller sort the whole range.
+        (when (find t nan)
+          (return-from %parallel-sort nil)))
+      (let ((src vector) (dst temp))
+        (loop for width = 1 then (* width 2)
+              while (< width n-threads)
+              do (run-parallel-sort-tasks
+                  (tasks (lambda (i)
+                           ;; Runs of WIDTH pieces are merged in pairs, and
+                           ;; each merge is shared by (* 2 WIDTH) threads.
+                           (multiple-value-bind (pair share) (floor i (* 2 width))
+                             (let* ((first (* pair 2 width))
+                                    (a0 (bound first))
+                                    (a1 (bound (+ first width)))
+                                    (a2 (bound (+ first width width)))
+                                    (length (- a2 a0)))
+                               (funcall part src dst a0 a1 a2
+                                        (floor (* share length) (* 2 width))
+                                        (floor (* (1+ share) length) (* 2 width))))))))
+                 (rotatef src dst))
+        (unless (eq src vector)
+          (run-parallel-sort-tasks
+           (tasks (lambda (i)
+                    (replace vector temp :start1 (bound i) :end1 (bound (1+ i))
+                                         :start2 (bound i))))))))
+    t))
+
+;;; Sort VECTOR[START,END) in several threads if it is a large enough
+;;; specialized vector of numbers ordered by #'< or #'>, and return T.
+;;; Otherwise, or if there are NaNs or only one processor, return NIL
+;;; having left the elements in some permutation of their original order.
+(defun parallel-sort-vector (vector start end predicate key)
+  (declare (type (simple-array * (*)) vector)
+           (index start end)
+           (function predicate)
+           (type (or null function) key))
+  #-sb-thread (declare (ignore vector start end predicate key))
+  #+sb-thread
+  (let ((threshold *parallel-sort-threshold*)
+        (n (- end start)))
+    (when (and threshold
+               (>= n (max threshold 2))
+               (or (null key) (eq key #'identity))
+               (not *gc-inhibit*))
+      (multiple-value-bind (run part) (numeric-sort-kernels vector predicate)
+        (when run
+          (let ((n-threads (min (alien-funcall
+                                 (extern-alien "sb_online_processor_count"
+                                               (function int)))
+                                64
+                                (floor n 16384))))
+            (when (>= n-threads 2)
+              ;; A power of two, so that pieces pair off evenly
+              (%parallel-sort vector start end run part
+                              (ash 1 (1- (integer-length n-threads))))))))))
+  #-sb-thread nil)
+
+;;;; radix sorting of numeric vectors
+
+;;; A vector of integers or double-floats compared by #'< or #'> is
+;;; sorted by an LSD radix sort on an unsigned key derived from each
+;;; element, one octet per pass, through a scratch vector. Passes on an
+;;; octet which is the same in every key are skipped, so small integers
+;;; cost only as many passes as they have octets. The sort is stable:
+;;; -0.0 and 0.0 get the same key, as < can't tell them apart. Keys are
+;;; complemented to sort by #'>.
+
+(eval-when (:compile-toplevel :execute)
+
+;;; Define NAME as a function of VECTOR, START, END and DESCENDING that
+;;; sorts VECTOR[START,END) by the (UNSIGNED-BYTE KEY-BITS) that KEY
+;;; computes from an element.
+(sb-xc:defmacro define-radix-sort (name type key-bits key)
+  (let ((n-digits (ceiling key-bits 8)))
+    `(defun ,name (vector start end descending)
+       (declare (type (simple-array ,type (*)) vector)
+                (index start end)
+                (optimize speed (safety 0)))
+       (let ((n (- end start))
+             (mask (if descending ,(1- (ash 1 key-bits)) 0)))
+         (declare (type (unsigned-byte ,key-bits) mask))
+         (flet ((key (x)
+                  (logxor (the (unsigned-byte ,key-bits) (,key x)) mask)))
+           (declare (inline key))
+           (when (< n 64)
+             ;; Not worth counting for
+             (loop for i of-type index from (1+ start) below end
+                   do (let* ((x (aref vector i))
+                             (k (key x))
+                             (j i))
+                        (declare (index j))
+                        (loop while (and (> j start)
+                                         (< k (key (aref vector (1- j)))))
+                              do (setf (aref vector j) (aref vector (1- j)))
+                                 (decf j))
+                        (setf (aref vector j) x)))
+             (return-from ,name vector))
+           (let ((counts (make-array ,(* n-digits 256) :element-type 'index
+                                                        :initial-element 0)))
+             (declare (dynamic-extent counts))
+             (loop for i of-type index from start below end
+                   do (let ((k (key (aref vector i))))
+                        ,@(loop for d below n-digits
+                                collect `(incf (aref counts (+ ,(* d 256)
+                                                               (ldb (byte 8 ,(* d 8)) k)))))))
+             (let ((temp (make-array n :element-type ',type))
+                   (src vector) (src-start start)
+                   (dst nil) (dst-start 0))
+               (declare (type (simple-array ,type (*)) temp src)
+                        (index src-start dst-start))
+               (dotimes (d ,n-digits)
+                 (let ((base (* d 256))
+                       (shift (* d 8)))
+                   (declare (index base shift))
+                   ;; All keys having the same digit leave the order as is
+                   (unless (= (aref counts
+                                    (+ base (ldb (byte 8 shift)
+                                                 (key (aref src src-start)))))
+                              n)
+                     (let ((sum 0))
+                       (declare (index sum))
+                       (dotimes (b 256)
+                         (let ((count (aref counts (+ base b))))
+                           (setf (aref counts (+ base b)) sum)
+                           (incf sum count))))
+                     (if (eq src vector)
+                         (setf dst temp dst-start 0)
+                         (setf dst vector dst-start start))
+                     (let ((dst dst))
+                       (declare (type (simple-array ,type (*)) dst))
+                       (loop for i of-type index
+                             from src-start below (+ src-start n)
+                             do (let* ((x (aref src i))
+                                       (b (+ base (ldb (byte 8 shift) (key x))))
+                                       (pos (aref counts b)))
+                                  (setf (aref dst (+ dst-start pos)) x
+                                        (aref counts b) (1+ pos))))
+                       (setf src dst src-start dst-start)))))
+               (unless (eq src vector)
+                 (replace vector temp :start1 start :end1 end))))
+           vector)))))
+) ; EVAL-WHEN
+
+(define-radix-sort %radix-sort-ub32 (unsigned-byte 32) 32 identity)
+#+64-bit
+(progn
+  (declaim (inline fixnum-sort-key double-float-sort-key))
+  (defun fixnum-sort-key (x)
+    (declare (fixnum x))
+    (logand (- x most-negative-fixnum) most-positive-word))
+  (defun double-float-sort-key (x)
+    (declare (double-float x))
+    (let ((bits (double-float-bits x)))
+      (cond ((= bits (ash -1 63)) ; -0.0
+             (ash 1 63))
+            ((minusp bits)
+             (logand (lognot bits) most-positive-word))
+            (t
+             (logior bits (ash 1 63))))))
+  (define-radix-sort %radix-sort-fixnum fixnum #.sb-vm:n-fixnum-bits
+    fixnum-sort-key)
+  (define-radix-sort %radix-sort-double-float double-float 64
+    double-float-sort-key))
+
+;;; Radix sort VECTOR[START,END) and return T if VECTOR is a specialized
+;;; vector which that applies to, and PREDICATE is #'< or #'> with no KEY.
+(defun radix-sort-vector (vector start end predicate key)
+  (declare (type (simple-array * (*)) vector)
+           (index start end)
+           (function predicate)
+           (type (or null function) key))
+  (let ((descending (cond ((eq predicate #'<) nil)
+                          ((eq predicate #'>) t)
+                          (t (return-from radix-sort-vector nil)))))
+    (when (and (or (null key) (eq key #'identity))
+               (< start end))
+      (typecase vector
+        ((simple-array (unsigned-byte 32) (*))
+         (%radix-sort-ub32 vector start end descending)
+         t)
+        #+64-bit
+        ((simple-array fixnum (*))
+         (%radix-sort-fixnum vector start end descending)
+         t)
+        #+64-bit
+        ((simple-array double-float (*))
+         (%radix-sort-double-float vector start end descending)
+         t)))))
+
+;;; Sort VECTOR[START,END) by one of the methods above and return T,
+;;; or return NIL if none of them applies
+(defun numeric-sort-vector (vector start end predicate key)
+  (declare (type (simple-array * (*)) vector)
+           (index start end)
+           (function predicate)
+           (type (or null function) key))
+  (or (parallel-sort-vector vector start end predicate key)
+      (radix-sort-vector vector start end predicate key)))
+
 ;;;; merging
 
 (eval-when (:compile-toplevel :execute)
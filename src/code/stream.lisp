@@ -1407,8 +1407,9 @@
                   (declare (optimize (sb-c:insert-array-bounds-checks 0)))
                   (when (= pointer (length buffer))
                     ;; The usual doubling technique: the new buffer shall hold as many
-                    ;; characters as were already emplaced.
-                    (setf buffer (string-output-stream-new-buffer stream index)
+                    ;; characters as were already emplaced, up to the chunk size.
+                    (setf buffer (string-output-stream-new-buffer
+                                  stream (min index +string-output-chunk-length+) t)
                           pointer 0))
                   (setf (aref (truly-the (simple-array ,elt-type (*)) buffer) pointer)
                         char
@@ -1540,21 +1541,59 @@ benefit of the function GET-OUTPUT-STREAM-STRING."
   (pointer 0 :type index))
 (declaim (freeze-type finite-base-string-output-stream))
 
+;;; Buffers stop doubling at this many characters. From then on each
+;;; new buffer is a chunk of this length, unless a single write needs
+;;; more, so that a long output is a list of chunks rather than of ever
+;;; larger strings. Chunks are recycled through *STRING-OUTPUT-CHUNKS*
+;;; once their characters have been extracted.
+(defconstant +string-output-chunk-length+ 16384)
+
+;;; Chunks free for any string output stream to use: base-strings
+;;; in the first half, character strings in the second. Keeping only a
+;;; few bounds the memory that a stream which once produced a long
+;;; string can hold on to.
+(define-load-time-global *string-output-chunks* (make-array 16 :initial-element nil))
+(declaim (simple-vector *string-output-chunks*))
+
+(defun get-string-output-chunk (base-p)
+  (let ((chunks *string-output-chunks*)
+        (start (if base-p 0 8)))
+    (loop for i from start below (+ start 8)
+          do (let ((chunk (svref chunks i)))
+               (when (and chunk (eq (cas (svref chunks i) chunk nil) chunk))
+                 (return chunk))))))
+
+(defun release-string-output-chunks (buffers)
+  (let ((chunks *string-output-chunks*))
+    (dolist (buffer buffers)
+      (when (= (length (the simple-string buffer)) +string-output-chunk-length+)
+        (let ((start (if (simple-base-string-p buffer) 0 8)))
+          (loop for i from start below (+ start 8)
+                when (and (null (svref chunks i))
+                          (null (cas (svref chunks i) nil buffer)))
+                return nil))))))
+
 ;;; Pushes the current segment onto the prev-list, and either pops
-;;; or allocates a new one.
-(defun string-output-stream-new-buffer (stream size)
+;;; or allocates a new one. A chunk may come from the pool only if
+;;; FROM-POOL is true, because it isn't filled with #\Nul, which
+;;; SET-STRING-OUTPUT-STREAM-FILE-POSITION relies on.
+(defun string-output-stream-new-buffer (stream size &optional from-pool)
   (declare (index size))
   (declare (string-output-stream stream))
   (push (string-output-stream-buffer stream)
         (string-output-stream-prev stream))
   (setf (string-output-stream-buffer stream)
-        (or (pop (string-output-stream-next stream))
-            ;; FIXME: This would be the correct place to detect that
-            ;; more than FIXNUM characters are being written to the
-            ;; stream, and do something about it.
-            (if (member (string-output-stream-element-type stream) '(base-char nil))
-                (make-array size :element-type 'base-char)
-                (make-array size :element-type 'character)))))
+        (let ((base-p (member (string-output-stream-element-type stream) '(base-char nil))))
+          (or (pop (string-output-stream-next stream))
+              (and from-pool
+                   (= size +string-output-chunk-length+)
+                   (get-string-output-chunk base-p))
+              ;; FIXME: This would be the correct place to detect that
+              ;; more than FIXNUM characters are being written to the
+              ;; stream, and do something about it.
+              (if base-p
+                  (make-array size :element-type 'base-char)
+                  (make-array size :element-type 'character))))))
 
 ;;; Moves to the end of the next segment or the current one if there are
 ;;; no more segments. Returns true as long as there are next segments.
@@ -1622,7 +1661,9 @@ benefit of the function GET-OUTPUT-STREAM-STRING."
                ;;  - another WRITE-STRING with 62 characters. 61 copied, 1 overflow.
                ;;  - then new BUFFER length is (MAX OVERFLOW INDEX) = 2
                buffer (string-output-stream-new-buffer
-                       stream (max overflow (string-output-stream-index stream)))
+                       stream (max overflow (min (string-output-stream-index stream)
+                                                 +string-output-chunk-length+))
+                       t)
                pointer 0
                space (length buffer)
                here (min space length)
@@ -1719,6 +1760,23 @@ benefit of the function GET-OUTPUT-STREAM-STRING."
        (if (eq et :default) 'character et)))
     (:element-mode 'character)))
 
+;;; Empty STREAM, keeping only its current buffer.
+(defun reset-string-output-stream (stream)
+  (declare (type string-output-stream stream))
+  (setf (string-output-stream-index stream) 0
+        (string-output-stream-index-cache stream) 0
+        (string-output-stream-pointer stream) 0
+        ;; throw them away for simplicity's sake: this way the rest of the
+        ;; implementation can assume that the greater of INDEX and INDEX-CACHE
+        ;; is always within the last buffer.
+        (string-output-stream-prev stream) nil
+        (string-output-stream-next stream) nil)
+
+  ;; Reset UNICODE-P unless it was :IGNORE or element-type is CHARACTER.
+  (when (and (eq (string-output-stream-element-type stream) :default)
+             (eq (string-output-stream-unicode-p stream) t))
+    (call-ansi-stream-misc stream :reset-unicode-p)))
+
 ;;; Return a string of all the characters sent to a stream made by
 ;;; MAKE-STRING-OUTPUT-STREAM since the last call to this function.
 (defun get-output-stream-string (stream)
@@ -1728,81 +1786,109 @@ benefit of the function GET-OUTPUT-STREAM-STRING."
          (prev (nreverse (string-output-stream-prev stream)))
          (this (string-output-stream-buffer stream))
          (next (string-output-stream-next stream))
-         (base-string-p (neq (string-output-stream-unicode-p stream) t))
-         ;; This used to contain a FIXME about not allocating a result string,
-         ;; instead shrinking the final buffer down to size. But given the likelihood
-         ;; of a Unicode buffer and ASCII result, that seems inapplicable nowadays.
-         ;; Also, how it impacts setting FILE-POSITION on a string stream is unclear.
-         ;; (See https://bugs.launchpad.net/sbcl/+bug/1839040)
-         (result (if base-string-p
-                     (make-string length :element-type 'base-char)
-                     (make-string length))))
-
-    (setf (string-output-stream-index stream) 0
-          (string-output-stream-index-cache stream) 0
-          (string-output-stream-pointer stream) 0
-          ;; throw them away for simplicity's sake: this way the rest of the
-          ;; implementation can assume that the greater of INDEX and INDEX-CACHE
-          ;; is always within the last buffer.
-          (string-output-stream-prev stream) nil
-          (string-output-stream-next stream) nil)
-
-    ;; Reset UNICODE-P unless it was :IGNORE or element-type is CHARACTER.
-    (when (and (eq (string-output-stream-element-type stream) :default)
-               (eq (string-output-stream-unicode-p stream) t))
-      (call-ansi-stream-misc stream :reset-unicode-p))
-
-    ;; There are exactly 3 cases that we have to deal with when copying:
-    ;;  CHARACTER-STRING into BASE-STRING (without type-checking per character)
-    ;;  CHARACTER-STRING into CHARACTER-STRING
-    ;;  BASE-STRING into BASE-STRING
-    ;; BASE-STRING copied into CHARACTER-STRING is not possible.
-    ;; Strings with element type NIL are not possible.
-    ;; The first case occurs when and only when the element type is :DEFAULT and
-    ;; only base characters were written. The other two cases can be handled
-    ;; using BYTE-BLT with indices multiplied by either 1 or 4.
-    (flet ((copy (fun extra)
-             (let ((start 0)) ; index into RESULT
-               (declare (index start))
-               (dolist (buffer prev)
-                 ;; It doesn't look as though we should have to pass RESULT
-                 ;; in to FUN to avoid closure consing, but indeed we do.
-                 (funcall fun result buffer start extra)
-                 (incf start (length buffer)))
-               (funcall fun result this start extra)
-               (incf start (length this))
-               (dolist (buffer next)
-                 (funcall fun result buffer start extra)
-                 (incf start (length buffer))))))
-      (if (and (eq (string-output-stream-element-type stream) :default)
-               base-string-p)
-          ;; This is the most common case, arising from WRITE-TO-STRING,
-          ;; PRINx-TO-STRING, (FORMAT NIL ...), and many other constructs.
-          ;; REPLACE will elide the type test per compilation policy
-          ;; which is fine because we've already checked that it'll work.
-          (copy (lambda (result source start dummy)
-                  (declare (optimize speed (sb-c::type-check 0)))
-                  (declare (ignore dummy))
-                  (replace (the simple-base-string result)
-                           (the simple-character-string source)
-                           :start1 start))
-                0)
-          (with-pinned-objects (result)
-              ;; BYTE-BLT doesn't know that it could use memcpy rather then memmove,
-              ;; but it nonetheless should be faster than REPLACE.
-              (copy (lambda (result source start scale)
-                      (declare (index start))
-                      (let* ((length (min (- (length result) start) (length source)))
-                             (end (+ start length)))
-                        (declare (index length end))
-                        (with-pinned-objects (source)
-                          (%byte-blt (vector-sap source)
-                                     0
-                                     (vector-sap result)
-                                     (truly-the index (ash start scale))
-                                     (truly-the index (ash end scale))))))
-                    (if base-string-p 0 2)))))
-    result))
+         (base-string-p (neq (string-output-stream-unicode-p stream) t)))
+    (reset-string-output-stream stream)
+
+    ;; When all of the output is in one buffer of the type of the result,
+    ;; that buffer becomes the result, and the stream gets a new one.
+    ;; Not if the buffer is the one that WITH-OUTPUT-TO-STRING allocated
+    ;; on the stack, though.
+    (when (and (null prev) (null next) (plusp length)
+               (eq (simple-base-string-p this) base-string-p)
+               (eq (heap-allocated-p this) :dynamic))
+      (setf (string-output-stream-buffer stream)
+            (if base-string-p
+                (make-array 63 :element-type 'base-char)
+                (make-array 32 :element-type 'character)))
+      (return-from get-output-stream-string (%shrink-vector this length)))
+
+    (let ((result (if base-string-p
+                      (make-string length :element-type 'base-char)
+                      (make-string length))))
+
+      ;; There are exactly 3 cases that we have to deal with when copying:
+      ;;  CHARACTER-STRING into BASE-STRING (without type-checking per character)
+      ;;  CHARACTER-STRING into CHARACTER-STRING
+      ;;  BASE-STRING into BASE-STRING
+      ;; BASE-STRING copied into CHARACTER-STRING is not possible.
+      ;; Strings with element type NIL are not possible.
+      ;; The first case occurs when and only when the element type is :DEFAULT and
+      ;; only base characters were written. The other two cases can be handled
+      ;; using BYTE-BLT with indices multiplied by either 1 or 4.
+      (flet ((copy (fun extra)
+               (let ((start 0)) ; index into RESULT
+                 (declare (index start))
+                 (dolist (buffer prev)
+                   ;; It doesn't look as though we should have to pass RESULT
+                   ;; in to FUN to avoid closure consing, but indeed we do.
+                   (funcall fun result buffer start extra)
+                   (incf start (length buffer)))
+                 (funcall fun result this start extra)
+                 (incf start (length this))
+                 (dolist (buffer next)
+                   (funcall fun result buffer start extra)
+                   (incf start (length buffer))))))
+        (if (and (eq (string-output-stream-element-type stream) :default)
+                 base-string-p)
+            ;; This is the most common case, arising from WRITE-TO-STRING,
+            ;; PRINx-TO-STRING, (FORMAT NIL ...), and many other constructs.
+            ;; REPLACE will elide the type test per compilation policy
+            ;; which is fine because we've already checked that it'll work.
+            (copy (lambda (result source start dummy)
+                    (declare (optimize speed (sb-c::type-check 0)))
+                    (declare (ignore dummy))
+                    (replace (the simple-base-string result)
+                             (the simple-character-string source)
+                             :start1 start))
+                  0)
+            (with-pinned-objects (result)
+                ;; BYTE-BLT doesn't know that it could use memcpy rather then memmove,
+                ;; but it nonetheless should be faster than REPLACE.
+                (copy (lambda (result source start scale)
+                        (declare (index start))
+                        (let* ((length (min (- (length result) start) (length source)))
+                               (end (+ start length)))
+                          (declare (index length end))
+                          (with-pinned-objects (source)
+                            (%byte-blt (vector-sap source)
+                                       0
+                                       (vector-sap result)
+                                       (truly-the index (ash start scale))
+                                       (truly-the index (ash end scale))))))
+                      (if base-string-p 0 2)))))
+    (release-string-output-chunks prev)
+    (release-string-output-chunks next)
+    result)))
+
+(defun write-output-stream-string (stream destination)
+  "Write the characters sent to STREAM, a stream made by
+MAKE-STRING-OUTPUT-STREAM or WITH-OUTPUT-TO-STRING, to DESTINATION, and
+empty STREAM as GET-OUTPUT-STREAM-STRING would, but without making a
+string of them. The buffers of STREAM are written one after the other,
+so that an FD-STREAM encodes them straight into its own buffers."
+  (declare (type string-output-stream stream))
+  (let* ((end (max (string-output-stream-index stream)
+                   (string-output-stream-index-cache stream)))
+         (prev (nreverse (string-output-stream-prev stream)))
+         (this (string-output-stream-buffer stream))
+         (next (string-output-stream-next stream))
+         (destination (out-stream-from-designator destination))
+         (start 0))
+    (declare (index start))
+    (reset-string-output-stream stream)
+    (flet ((out (buffer)
+             (let ((n (min (length buffer) (- end start))))
+               (write-string buffer destination :end n)
+               (incf start n))))
+      (declare (inline out))
+      (dolist (buffer prev)
+        (out buffer))
+      (out this)
+      (dolist (buffer next)
+        (out buffer)))
+    (release-string-output-chunks prev)
+    (release-string-output-chunks next)
+    nil))
 
 (defun finite-base-string-ouch (stream character)
   (declare (optimize (sb-c:insert-array-bounds-checks 0)))
@@ -2632,7 +2718,8 @@ benefit of the function GET-OUTPUT-STREAM-STRING."
   ;; before we're ready (or after we think it's been deinitialized).
   ;; This uses the internal %MAKUNBOUND because the CL: function would
   ;; rightly complain that *AVAILABLE-BUFFERS* is proclaimed always bound.
-  (%makunbound '*available-buffers*))
+  (%makunbound '*available-buffers*)
+  (fill *string-output-chunks* nil))
 
 (defvar *streams-closed-by-slad*)
 
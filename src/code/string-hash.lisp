@@ -14,30 +14,69 @@
 ;;;; Note that this operation is used in compiler symbol table
 ;;;; lookups, so we'd like it to be fast.
 ;;;;
-;;;; As of 2004-03-10, we implement the one-at-a-time algorithm
-;;;; designed by Bob Jenkins (see
-;;;; <http://burtleburtle.net/bob/hash/doobs.html> for some more
-;;;; information).
+;;;; Characters are taken as 32-bit codes, packed N-WORD-BITS/32 to a
+;;;; word, and each pair of words is folded into the state with one
+;;;; full-width multiplication, in the manner of wyhash. The result
+;;;; depends only on the character codes, so a base string hashes the
+;;;; same as an EQUAL character string, and it must not depend on the
+;;;; CPU: symbol hashes are computed by the cross-compiler and saved in
+;;;; cores. sxhash_simple_string() in hopscotch.c computes the same.
+
+(defconstant string-hash-k1 (logand #xa0761d6478bd642f most-positive-word))
+(defconstant string-hash-k2 (logand #xe7037ed1a0b428db most-positive-word))
+(defconstant string-hash-k3 (logand #x8ebc6af09c88c6e3 most-positive-word))
+(defconstant string-hash-seed (logand #x589965cc75374cc3 most-positive-word))
+(defconstant string-hash-chars-per-word (floor sb-vm:n-word-bits 32))
+
+;;; Return the XOR of the high and low words of the product of X and Y.
+(declaim (inline string-hash-mum))
+(defun string-hash-mum (x y)
+  (declare (type word x y))
+  #+sb-xc-host
+  (let ((product (* x y)))
+    (logxor (ldb (byte sb-vm:n-word-bits 0) product)
+            (ash product (- sb-vm:n-word-bits))))
+  #-sb-xc-host
+  (multiple-value-bind (hi lo) (sb-bignum:%multiply x y)
+    (logxor hi lo)))
 
 #-sb-xc-host (declaim (inline %sxhash-simple-substring))
 (defun %sxhash-simple-substring (string start end)
-  ;; FIXME: As in MIX above, we wouldn't need (SAFETY 0) here if the
-  ;; cross-compiler were smarter about ASH, but we need it for
-  ;; sbcl-0.5.0m.  (probably no longer true?  We might need SAFETY 0
-  ;; to elide some type checks, but then again if this is inlined in
-  ;; all the critical places, we might not -- CSR, 2004-03-10)
-
   ;; Never decrease safety in the cross-compiler. It's not worth the headache
   ;; of tracking down insidious host/target compatibility bugs.
   #-sb-xc-host (declare (optimize (speed 3) (safety 0)))
   (macrolet ((guts ()
-               `(loop for i of-type index from start below end do
-                  (set-result (+ result (char-code (aref string i))))
-                  (set-result (+ result (ash result 10)))
-                  (set-result (logxor result (ash result -6)))))
-             (set-result (form)
-               `(setf result (ldb (byte #.sb-vm:n-word-bits 0) ,form))))
-    (let ((result 238625159)) ; (logandc2 most-positive-fixnum (sxhash #\S)) on 32 bits
+               `(let ((i start))
+                  (declare (type index i))
+                  ;; whole pairs of words
+                  (loop while (<= (+ i (* 2 string-hash-chars-per-word)) end)
+                        do (mix-words (word-at i)
+                                      (word-at (+ i string-hash-chars-per-word)))
+                           (incf i (* 2 string-hash-chars-per-word)))
+                  ;; and the rest, padded with zeros
+                  (when (< i end)
+                    (let ((w0 0) (w1 0))
+                      (declare (type word w0 w1))
+                      (loop for j of-type index from 0
+                            for k of-type index from i below end
+                            do (multiple-value-bind (w shift)
+                                   (floor j string-hash-chars-per-word)
+                                 (let ((bits (ash (char-code (aref string k))
+                                                  (* 32 shift))))
+                                   (if (zerop w)
+                                       (setf w0 (logior w0 bits))
+                                       (setf w1 (logior w1 bits))))))
+                      (mix-words w0 w1)))))
+             (word-at (i)
+               (if (= string-hash-chars-per-word 1)
+                   `(char-code (aref string ,i))
+                   `(let ((i ,i))
+                      (logior (char-code (aref string i))
+                              (ash (char-code (aref string (1+ i))) 32)))))
+             (mix-words (w0 w1)
+               `(setf result (string-hash-mum (logxor ,w0 string-hash-k1)
+                                              (logxor ,w1 result)))))
+    (let ((result string-hash-seed))
       (declare (type word result))
       ;; Avoid accessing elements of a (simple-array nil (*)).
       ;; The expansion of STRING-DISPATCH involves ETYPECASE,
@@ -50,9 +89,8 @@
       ;; just do it, don't care about loop unswitching or simple-ness of the string.
       #+sb-xc-host (guts)
 
-      (set-result (+ result (ash result 3)))
-      (set-result (logxor result (ash result -11)))
-      (set-result (logxor result (ash result 15)))
+      (setf result (string-hash-mum (logxor result string-hash-k2)
+                                    (logxor (- end start) string-hash-k3)))
       (logand result most-positive-fixnum))))
 ;;; test:
 ;;;   (let ((ht (make-hash-table :test 'equal)))
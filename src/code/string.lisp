@@ -148,14 +148,17 @@
                               (unless (char= (schar string1 index1)
                                              (schar string2 index2))
                                 (return nil)))))))
-            (cond #+(or x86 x86-64)
+            (cond #+(or x86 x86-64 arm64)
                   ;; The cost of WITH-PINNED-OBJECTS is near nothing on x86,
                   ;; and memcmp() is much faster except below a cutoff point.
                   ;; The threshold is higher on x86-32 because the overhead
                   ;; of a foreign call is higher due to FPU stack save/restore.
+                  ;; On ARM64 pinning takes a binding, but the C library's
+                  ;; memcmp() compares 16 bytes at a time with NEON.
                   ((and (= widetag1 widetag2)
                         (>= len #+x86 16
-                                #+x86-64 8))
+                                #+x86-64 8
+                                #+arm64 32))
                    (let ((shift (case widetag1
                                   (#.sb-vm:simple-base-string-widetag 0)
                                   (#.sb-vm:simple-character-string-widetag 2))))
@@ -183,9 +186,10 @@
       (let ((len (- end1 start1)))
         (cond ((/= len (- end2 start2))
                nil)
-              #+(or x86 x86-64)
+              #+(or x86 x86-64 arm64)
               ((>= len #+x86 16
-                       #+x86-64 8)
+                       #+x86-64 8
+                       #+arm64 32)
                (memcmp 0))
               (t
                (char-loop base-char base-char))))))
@@ -196,9 +200,10 @@
       (let ((len (- end1 start1)))
         (cond ((/= len (- end2 start2))
                nil)
-              #+(or x86 x86-64)
+              #+(or x86 x86-64 arm64)
               ((>= len #+x86 16
-                       #+x86-64 8)
+                       #+x86-64 8
+                       #+arm64 32)
                (memcmp 2))
               (t
                (char-loop character character)))))))
@@ -295,6 +300,74 @@
 (defun two-arg-string/= (string1 string2)
   (string/=* string1 string2 0 nil 0 nil))
 
+;;;; ASCII a word at a time
+;;;
+;;; With #+sb-unicode a base string holds only octets below 128, so
+;;; adding #x80 - LOW to each octet of a word of them sets its high bit
+;;; just when the octet is at least LOW, and carries into nothing. That
+;;; finds the letters among a word of octets at once, to change their
+;;; case or to fold them when comparing, instead of looking each one up
+;;; in the case tables. Words are read unaligned, as these CPUs allow.
+#+(and sb-unicode (or x86 x86-64 arm64))
+(progn
+(defmacro ascii-case-bits (word low high)
+  (let ((ones (floor most-positive-word #xff)))
+    `(let ((word ,word))
+       (ash (logand (logand (+ word ,(* ones (- #x80 low))) most-positive-word)
+                    (lognot (logand (+ word ,(* ones (- #x7f high))) most-positive-word))
+                    ,(* ones #x80))
+            -2))))
+
+(macrolet ((def (name low high)
+             `(defun ,name (string start end)
+                (declare (type simple-base-string string) (type index start end)
+                         (optimize speed (sb-c:insert-array-bounds-checks 0)))
+                (with-pinned-objects (string)
+                  (let ((sap (vector-sap string)))
+                    (loop while (<= (+ start sb-vm:n-word-bytes) end)
+                          do (let ((word (sap-ref-word sap start)))
+                               (setf (sap-ref-word sap start)
+                                     (logxor word (ascii-case-bits word ,low ,high))))
+                             (incf start sb-vm:n-word-bytes))
+                    (loop while (< start end)
+                          do (let ((octet (sap-ref-8 sap start)))
+                               (when (<= ,low octet ,high)
+                                 (setf (sap-ref-8 sap start) (logxor octet #x20))))
+                             (incf start))))
+                string)))
+  (def base-string-upcase #x61 #x7a)
+  (def base-string-downcase #x41 #x5a))
+
+;;; Whether two base strings have the same octets but for case
+(defun base-string-equal (string1 start1 string2 start2 length)
+  (declare (type simple-base-string string1 string2) (type index start1 start2 length)
+           (optimize speed (sb-c:insert-array-bounds-checks 0)))
+  (with-pinned-objects (string1 string2)
+    (let ((sap1 (vector-sap string1))
+          (sap2 (vector-sap string2))
+          (end1 (+ start1 length)))
+      (flet ((fold (word)
+               (logxor word (ascii-case-bits word #x41 #x5a))))
+        (declare (inline fold))
+        (loop while (<= (+ start1 sb-vm:n-word-bytes) end1)
+              do (let ((word1 (sap-ref-word sap1 start1))
+                       (word2 (sap-ref-word sap2 start2)))
+                   (unless (or (= word1 word2) (= (fold word1) (fold word2)))
+                     (return-from base-string-equal nil)))
+                 (incf start1 sb-vm:n-word-bytes)
+                 (incf start2 sb-vm:n-word-bytes))
+        (loop while (< start1 end1)
+              do (let ((octet1 (sap-ref-8 sap1 start1))
+                       (octet2 (sap-ref-8 sap2 start2)))
+                   (unless (or (= octet1 octet2)
+                               (and (= (logxor octet1 octet2) #x20)
+                                    (<= #x61 (logior octet1 #x20) #x7a)))
+                     (return-from base-string-equal nil)))
+                 (incf start1)
+                 (incf start2))
+        t))))
+) ; #+(and sb-unicode (or x86 x86-64 arm64))
+
 ;;; STRING-NOT-EQUAL-LOOP is used to generate character comparison loops for
 ;;; STRING-EQUAL and STRING-NOT-EQUAL.
 (defmacro string-not-equal-loop (end end-value
@@ -330,6 +403,10 @@
       (declare (fixnum slen1 slen2))
       (when (= slen1 slen2)
         ;;return NIL immediately if lengths aren't equal.
+        #+(and sb-unicode (or x86 x86-64 arm64))
+        (when (and (simple-base-string-p string1) (simple-base-string-p string2))
+          (return-from string-equal
+            (base-string-equal string1 start1 string2 start2 slen1)))
         (string-not-equal-loop 1 t nil)))))
 
 (defun two-arg-string-equal (string1 string2)
@@ -338,6 +415,10 @@
           (slen2 (- (the fixnum end2) start2)))
       (declare (fixnum slen1 slen2))
       (when (= slen1 slen2)
+        #+(and sb-unicode (or x86 x86-64 arm64))
+        (when (and (simple-base-string-p string1) (simple-base-string-p string2))
+          (return-from two-arg-string-equal
+            (base-string-equal string1 start1 string2 start2 slen1)))
         (string-not-equal-loop 1 t nil)))))
 
 (defun string-not-equal (string1 string2 &key (start1 0) end1 (start2 0) end2)
@@ -514,17 +595,25 @@ new string COUNT long filled with the fill character."
                         (array character (*)))
                     string))
         (with-one-string (string start end)
+          #+(and sb-unicode (or x86 x86-64 arm64))
+          (when (simple-base-string-p string)
+            (base-string-upcase string start end)
+            (setq start end))
           (do ((index start (1+ index))
                (cases +character-cases+))
               ((>= index end))
             (declare (optimize (sb-c:insert-array-bounds-checks 0)))
-            (let ((char (schar string index)))
-              (with-case-info (char case-index cases
-                               :cases cases)
-                (let ((code (aref cases (1+ case-index))))
-                  (unless (zerop code)
-                    (setf (schar string index)
-                          (code-char (truly-the char-code code)))))))))
+            (let* ((char (schar string index))
+                   (code (char-code char)))
+              (if (< code 128)
+                  (when (<= (char-code #\a) code (char-code #\z))
+                    (setf (schar string index) (code-char (logxor code #x20))))
+                  (with-case-info (char case-index cases
+                                   :cases cases)
+                    (let ((code (aref cases (1+ case-index))))
+                      (unless (zerop code)
+                        (setf (schar string index)
+                              (code-char (truly-the char-code code))))))))))
         string)))
 
 (defun string-upcase (string &key (start 0) end)
@@ -544,20 +633,28 @@ new string COUNT long filled with the fill character."
                         (array character (*)))
                     string))
         (with-one-string (string start end)
+          #+(and sb-unicode (or x86 x86-64 arm64))
+          (when (simple-base-string-p string)
+            (base-string-downcase string start end)
+            (setq start end))
           (do ((index start (1+ index))
                (cases #.+character-cases+))
               ((>= index end))
             (declare (optimize (sb-c:insert-array-bounds-checks 0)))
-            (let ((char (schar (truly-the (or simple-base-string
-                                              simple-character-string)
-                                          string)
-                               index)))
-              (with-case-info (char case-index cases
-                               :cases cases)
-                (let ((code (aref cases case-index)))
-                  (unless (zerop code)
-                    (setf (schar string index)
-                          (code-char (truly-the char-code code)))))))))
+            (let* ((char (schar (truly-the (or simple-base-string
+                                               simple-character-string)
+                                           string)
+                                index))
+                   (code (char-code char)))
+              (if (< code 128)
+                  (when (<= (char-code #\A) code (char-code #\Z))
+                    (setf (schar string index) (code-char (logxor code #x20))))
+                  (with-case-info (char case-index cases
+                                   :cases cases)
+                    (let ((code (aref cases case-index)))
+                      (unless (zerop code)
+                        (setf (schar string index)
+                              (code-char (truly-the char-code code))))))))))
         string)))
 
 (defun string-downcase (string &key (start 0) end)
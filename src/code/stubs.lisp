@@ -140,6 +140,15 @@
   #+compare-and-swap-vops
   (def* (%array-atomic-incf/word (array index diff))
         (%raw-instance-atomic-incf/word (instance index diff)))
+  #+x86-64
+  (def* (%array-atomic-incf/ub32 (array index diff))
+        (%array-atomic-incf/fixnum (array index diff))
+        (%vector-cas/word (vector index old new))
+        (%vector-cas/ub32 (vector index old new))
+        (%vector-cas/fixnum (vector index old new))
+        (%vector-xchg/word (vector index new))
+        (%vector-xchg/ub32 (vector index new))
+        (%vector-xchg/fixnum (vector index new)))
 
   #+sb-simd-pack
   (def* (%make-simd-pack (tag low high))
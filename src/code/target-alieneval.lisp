@@ -738,7 +738,8 @@ Also automatically DECLAIM the FTYPE of the defined function.
 NAME may be either a string, a symbol, or a list of the form (string symbol).
 
 RETURN-TYPE is the alien type for the function return value. VOID may be
-used to specify a function with no result.
+used to specify a function with no result. It may also be a list of options
+followed by the type, as in the RESULT-TYPE of a FUNCTION alien type.
 
 The remaining forms specify individual arguments that are passed to the
 routine. ARG-NAME is a symbol that names the argument, primarily for
@@ -773,17 +774,22 @@ way that the argument is passed.
              ;;   (define-alien-routine "kill" int (pid int) (sig int))
              ;; which, if we didn't hide the local name, would get:
              ;;  "Attempt to bind a constant variable with SYMBOL-MACROLET: KILL"
-             (local-name (copy-symbol lisp-name)))
+             (local-name (copy-symbol lisp-name))
+             ;; without any leading options such as :LEAF
+             (bare-result-type (if (and (consp result-type)
+                                        (keywordp (car result-type)))
+                                   (car (last result-type))
+                                   result-type)))
     (collect ((docs) (lisp-args) (lisp-arg-types)
               (lisp-result-types
-               (cond ((eql result-type 'void)
+               (cond ((eql bare-result-type 'void)
                       ;; What values does a function return, if it
                       ;; returns no values? Exactly one - NIL. -- APD,
                       ;; 2003-03-02
                       (list 'null))
                      (t
                       ;; FIXME: Check for VALUES.
-                      (list `(alien ,result-type)))))
+                      (list `(alien ,bare-result-type)))))
               (arg-types) (alien-vars)
               (alien-args) (results))
       (dolist (arg args)
@@ -837,7 +843,7 @@ way that the argument is passed.
             ((,local-name (function ,result-type ,@(arg-types))
                          :extern ,alien-name)
              ,@(alien-vars))
-             ,@(if (eq 'void result-type)
+             ,@(if (eq 'void bare-result-type)
                    `((alien-funcall ,local-name ,@(alien-args))
                      (values nil ,@(results)))
                    `((values (alien-funcall ,local-name ,@(alien-args))
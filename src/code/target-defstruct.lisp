@@ -414,7 +414,9 @@
 ;;    i.e. was required to perform a check. This is a feature, not a bug.
 (macrolet ((access (dsd)
              `(let ((i (dsd-index ,dsd)))
-                (acond ((dsd-raw-slot-data ,dsd)
+                (acond ((dsd-packed-p ,dsd)
+                        (packed-slot-value ,dsd (%raw-instance-ref/word structure i)))
+                       ((dsd-raw-slot-data ,dsd)
                         (funcall (raw-slot-data-accessor-fun it) structure i))
                        (t
                         (%instance-ref structure i))))))
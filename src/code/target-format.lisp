@@ -113,27 +113,107 @@
 (defun %format (stream string-or-fun orig-args &optional (args orig-args))
   (if (and (functionp string-or-fun) (not (typep string-or-fun 'fmt-control)))
       (apply string-or-fun stream args)
-      (catch 'up-and-out
-        (let* ((string (etypecase string-or-fun
-                         (simple-string
-                          string-or-fun)
-                         (string
-                          (coerce string-or-fun 'simple-string))
-                         (fmt-control
-                          (fmt-control-string string-or-fun))))
-               (*default-format-error-control-string* string)
-               (*logical-block-popper* nil)
-               (tokens
-                (if (functionp string-or-fun)
-                    (or (fmt-control-memo string-or-fun)
-                        ;; Memoize the parse back into the object
-                        (setf (fmt-control-memo string-or-fun)
-                              (%tokenize-control-string
-                               string 0 (length string)
-                               (fmt-control-symbols string-or-fun))))
-                    (tokenize-control-string string))))
-          (interpret-directive-list stream tokens orig-args args)))))
-
+      (let ((compiled (and (simple-string-p string-or-fun)
+                           (eq args orig-args)
+                           (compiled-format string-or-fun))))
+        (if compiled
+            (apply compiled stream args)
+            (catch 'up-and-out
+              (let* ((string (etypecase string-or-fun
+                               (simple-string
+                                string-or-fun)
+                               (string
+                                (coerce string-or-fun 'simple-string))
+                               (fmt-control
+                                (fmt-control-string string-or-fun))))
+                     (*default-format-error-control-string* string)
+                     (*logical-block-popper* nil)
+                     (tokens
+                      (if (functionp string-or-fun)
+                          (or (fmt-control-memo string-or-fun)
+                              ;; Memoize the parse back into the object
+                              (setf (fmt-control-memo string-or-fun)
+                                    (%tokenize-control-string
+                                     string 0 (length string)
+                                     (fmt-control-symbols string-or-fun))))
+                          (tokenize-control-string string))))
+                (interpret-directive-list stream tokens orig-args args)))))))
+
+;;;; Compiling control strings
+
+;;; A control string that isn't known at compile time is interpreted, but
+;;; one that %FORMAT sees often enough is compiled as by FORMATTER. The
+;;; functions are kept by the contents of their strings in a table of
+;;; bounded size, which makes room by dropping the least recently used.
+;;; Each entry is (FUN . STAMP), where FUN is the function, or the number
+;;; of uses so far, or NIL if the string couldn't be compiled.
+(defconstant compile-format-threshold 10)
+(defconstant compiled-format-cache-size 128)
+(declaim (type (or null hash-table) *compiled-formats*)
+         (type fixnum *compiled-format-clock*))
+(define-load-time-global *compiled-formats* nil)
+(define-load-time-global *compiled-format-clock* 0)
+
+;;; The function must signal the same errors as the interpreter would,
+;;; whatever the global policy. A ~/ directive names a function in the
+;;; package current at each call, so its string is left alone.
+(defun compile-format (string)
+  (unless (find #\/ string)
+    (handler-case
+        (destructuring-bind (named-lambda name lambda-list &body body)
+            (%formatter string)
+          (multiple-value-bind (fun warnings-p failure-p)
+              (handler-bind (((or warning compiler-note) #'muffle-warning))
+                (sb-c:compile-in-lexenv
+                 `(,named-lambda ,name ,lambda-list
+                    (declare (optimize (safety 1) (debug 0) (speed 1)))
+                    ,@body)
+                 (make-null-lexenv) nil nil nil nil nil))
+            (declare (ignore warnings-p))
+            (unless failure-p fun)))
+      (error () nil))))
+
+;;; Return the compiled function for STRING, or NIL to interpret it.
+;;; Literal strings are left to the cache of TOKENIZE-CONTROL-STRING.
+;;; The compiler isn't ready until GC is, and isn't invoked where
+;;; interrupts are disabled, as while a system lock is held.
+(defun compiled-format (string)
+  (declare (simple-string string))
+  (when (or *gc-inhibit*
+            (not sb-sys:*interrupts-enabled*)
+            (logtest (get-header-data string)
+                     (ash (logior sb-vm:+vector-shareable+
+                                  sb-vm:+vector-shareable-nonstd+)
+                          sb-vm:array-flags-data-position)))
+    (return-from compiled-format nil))
+  (let* ((table (or *compiled-formats*
+                    (setq *compiled-formats*
+                          (make-hash-table :test 'equal :synchronized t))))
+         (stamp (setq *compiled-format-clock*
+                      (logand (1+ *compiled-format-clock*) most-positive-fixnum)))
+         (entry (gethash string table)))
+    (cond
+      ((not entry)
+       (with-locked-hash-table (table)
+         (when (>= (hash-table-count table) compiled-format-cache-size)
+           (let ((oldest nil) (oldest-stamp most-positive-fixnum))
+             (maphash (lambda (key entry)
+                        (when (< (cdr entry) oldest-stamp)
+                          (setq oldest key oldest-stamp (cdr entry))))
+                      table)
+             (remhash oldest table)))
+         (setf (gethash (copy-seq string) table) (cons 1 stamp)))
+       nil)
+      (t
+       (setf (cdr entry) stamp)
+       (let ((fun (car entry)))
+         (cond ((not (fixnump fun)) fun)
+               ((< (setf (car entry) (1+ fun)) compile-format-threshold) nil)
+               (t
+                ;; Interpret it meanwhile, including when formatting
+                ;; something for the compiler.
+                (setf (car entry) nil)
+                (setf (car entry) (compile-format string)))))))))
 
 (!begin-collecting-cold-init-forms)
 (define-load-time-global *format-directive-interpreters* nil)
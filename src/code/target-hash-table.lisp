@@ -52,21 +52,19 @@
   (and (hash-table-weak-p ht)
        (decode-hash-table-weakness (ht-flags-weakness (hash-table-flags ht)))))
 
-(declaim (inline eq-hash))
-(defun eq-hash (key)
+(declaim (inline address-hash))
+(defun address-hash (key)
   (declare (values fixnum (member t nil)))
-  ;; I think it would be ok to pick off SYMBOL here and use its hash slot
-  ;; as far as semantics are concerned, but EQ-hash is supposed to be
-  ;; the lightest-weight in terms of speed, so I'm letting everything use
-  ;; address-based hashing, unlike the other standard hash-table hash functions
-  ;; which try use the hash slot of certain objects.
-  ;; Note also that as we add logic into the EQ-HASH function to decide whether
-  ;; the hash is address-based, we either have to replicate that logic into
-  ;; rehashing, or else actually call EQ-HASH to decide for us.
   (values (pointer-hash key)
           (sb-vm:is-lisp-pointer (get-lisp-obj-address key))))
 
-(declaim (inline eql-hash eql-hash-no-memoize))
+;;; EQ and EQL tables hash alike: numbers and symbols by their contents,
+;;; instances by their stable hash, and everything else by address.
+;;; Keys of the first kinds can move without invalidating the table, which
+;;; matters to large tables whose keys are mostly symbols and instances.
+;;; GC knows which keys are which without a hash vector, and REHASH
+;;; decides it by calling EQL-HASH-NO-MEMOIZE.
+(declaim (inline eq-hash eq-hash-no-memoize eql-hash eql-hash-no-memoize))
 (macrolet
     ((define-eql-hash (name symbol-hash-fun)
        `(defun ,name (key)
@@ -94,8 +92,11 @@
                           (,symbol-hash-fun (truly-the symbol key))
                           (number-sxhash (truly-the number key)))
                       nil)
-              ;; Consider picking off %INSTANCEP too before using EQ-HASH ?
-              (eq-hash key)))))
+              (if (%instancep key)
+                  (values (instance-sxhash key) nil)
+                  (address-hash key))))))
+  (define-eql-hash eq-hash sxhash)
+  (define-eql-hash eq-hash-no-memoize symbol-hash)
   (define-eql-hash eql-hash sxhash) ; via transform
   ;; For GETHASH we should never compute a symbol-hash. If it hasn't been
   ;; computed, KEY won't be found, and it doesn't matter what the hash is.
@@ -116,12 +117,12 @@
     ;; for (sxhash symbol) without an explicit THE form.
     (symbol (values (sxhash (the symbol key)) nil)) ; transformed
     (instance (values (instance-sxhash key) nil))
-    ;; Otherwise use an EQ hash, rather than SXHASH, since the values
+    ;; Otherwise use an address-based hash, rather than SXHASH, since the values
     ;; of SXHASH will be extremely badly distributed due to the
     ;; requirements of the spec fitting badly with our implementation
     ;; strategy.
     (t
-     (eq-hash key))))
+     (address-hash key))))
 
 ;;; Basically the same as EQUAL hash, but do not use the stable hash on instances
 ;;; so that we do not cause all structures (in the worst case) to grow a new slot.
@@ -135,7 +136,7 @@
   (declare (values fixnum (member t nil)))
   (if (typep key '(or string cons number bit-vector pathname symbol))
       (values (sxhash key) nil)
-      (eq-hash key)))
+      (address-hash key)))
 
 (defun equalp-hash (key)
   (declare (values fixnum (member t nil)))
@@ -150,7 +151,7 @@
     ;; since STRUCTURE-OBJECT is recursed into by PSXHASH.
     (instance (values (instance-sxhash key) nil))
     (t
-     (eq-hash key))))
+     (address-hash key))))
 
 (declaim (inline prefuzz-hash))
 (defun prefuzz-hash (hash)
@@ -172,6 +173,18 @@
 (defun pointer-hash->bucket (hash mask)
   (declare (fixnum hash) (hash-code mask))
   (truly-the index (logand mask (prefuzz-hash hash))))
+;;; Return the bucket of HASH in a table that may be partway through an
+;;; incremental doubling of its INDEX-VECTOR. The first UNSPLIT buckets of the
+;;; lower half still chain the entries of their upper half partners too.
+;;; UNSPLIT is 0 except in non-weak tables that recently grew.
+(declaim (inline hash-table-bucket))
+(defun hash-table-bucket (hash index-vector unsplit)
+  (declare (type (simple-array hash-table-index (*)) index-vector)
+           (index unsplit))
+  (let* ((mask (1- (length index-vector)))
+         (bucket (mask-hash hash mask))
+         (low (logand bucket (ash mask -1))))
+    (if (< low unsplit) low bucket)))
 
 ;;;; user-defined hash table tests
 
@@ -536,7 +549,7 @@ Examples:
                               (make-array (1+ size) :element-type 'hash-table-index))))
            ((getter setter remover)
             (if weakp
-                (values #'gethash/weak #'puthash/weak #'remhash/weak)
+                (values #'gethash/weak/lockfree #'puthash/weak #'remhash/weak)
                 (pick-table-methods (logtest flags hash-table-synchronized-flag)
                                     (if userfunp -1 table-kind))))
            (table
@@ -560,7 +573,7 @@ Examples:
              (setf (kv-vector-supplement kv-vector)
                    (if weakp
                        table
-                       (or hash-vector (= table-kind hash-table-kind-eql))))
+                       (or hash-vector (<= table-kind hash-table-kind-eql))))
              (when weakp
                (logior-array-flags kv-vector (logior sb-vm:vector-hashing-flag
                                                   sb-vm:vector-weak-flag)))))
@@ -755,7 +768,8 @@ multiple threads accessing the same hash-table without locking."
                 ;; are explicitly pinned.
                 (logior-array-flags kv-vector sb-vm:vector-addr-hashing-flag)
                 (push-in-chain (pointer-hash->bucket (pointer-hash key) mask)))))))
-    ((= (ht-flags-kind (hash-table-flags table)) hash-table-kind-eql)
+    (t
+     ;; No hash vector, so it's an EQ or EQL table, which hash alike.
      ;; There's a very tricky issue here with using EQL-HASH - you can't just
      ;; call it and then decide to set the address-sensitivity bit if the secondary
      ;; result is T. Normally we call the hash function with the key pinned,
@@ -785,17 +799,7 @@ multiple threads accessing the same hash-table without locking."
                 (multiple-value-bind (hash address-based) (eql-hash-no-memoize key)
                   (when address-based
                     (logior-array-flags kv-vector sb-vm:vector-addr-hashing-flag))
-                  (push-in-chain (mask-hash (prefuzz-hash hash) mask)))))))))
-    (t
-      (do ((i hwm (1- i))) ((zerop i))
-        (declare (type index/2 i))
-        (with-pair (key val)
-         (cond ((and (empty-ht-slot-p key) (empty-ht-slot-p val))
-                (setf (aref next-vector i) next-free next-free i))
-               (t
-                (when (sb-vm:is-lisp-pointer (get-lisp-obj-address key))
-                  (logior-array-flags kv-vector sb-vm:vector-addr-hashing-flag))
-                (push-in-chain (pointer-hash->bucket (pointer-hash key) mask))))))))
+                  (push-in-chain (mask-hash (prefuzz-hash hash) mask))))))))))
   ;; This is identical to the calculation of next-free-kv in INSERT-AT.
   (cond ((/= next-free 0) next-free)
         ((= hwm (hash-table-pairs-capacity kv-vector)) 0)
@@ -838,7 +842,7 @@ multiple threads accessing the same hash-table without locking."
      ;; rehash into them and CAS them in, but the advantage would be minimal-
      ;; obsolete chains could only work for a possibly-empty subset of keys.
      (let* ((index-vector (fill (hash-table-index-vector table) 0))
-            (mask (1- (length index-vector)))
+            (unsplit (hash-table-unsplit-buckets table))
             (hwm (kv-vector-high-water-mark kv-vector))
             (result 0))
        (declare (optimize (sb-c:insert-array-bounds-checks 0)))
@@ -851,13 +855,16 @@ multiple threads accessing the same hash-table without locking."
               ;; due to key movement can not possibly affect that chain.
               (unless (empty-ht-slot-p pair-key)
                 (cond ((/= (aref hash-vector i) +magic-hash-vector-value+)
-                       (push-in-chain (mask-hash (aref hash-vector i) mask)))
+                       (push-in-chain (hash-table-bucket (aref hash-vector i)
+                                                         index-vector unsplit)))
                       (t
                        (logior-array-flags kv-vector sb-vm:vector-addr-hashing-flag)
-                       (push-in-chain (pointer-hash->bucket
-                                       (pointer-hash pair-key) mask))))
+                       (push-in-chain (hash-table-bucket
+                                       (prefuzz-hash (pointer-hash pair-key))
+                                       index-vector unsplit))))
                 (when (eq pair-key key) (setq result key-index))))))
-         ((= (ht-flags-kind (hash-table-flags table)) hash-table-kind-eql)
+         (t
+          ;; No hash vector, so it's an EQ or EQL table
           (sb-vm::with-pinned-object-iterator (pin-object)
            (do ((i hwm (1- i))) ((zerop i))
              (declare (type index/2 i))
@@ -867,25 +874,75 @@ multiple threads accessing the same hash-table without locking."
                  (multiple-value-bind (hash address-based) (eql-hash-no-memoize pair-key)
                    (when address-based
                      (logior-array-flags kv-vector sb-vm:vector-addr-hashing-flag))
-                   (push-in-chain (mask-hash (prefuzz-hash hash) mask)))
-                (when (eq pair-key key) (setq result key-index)))))))
-         (t
-           ;; No hash vector and not an EQL table, so it's an EQ table
-           (do ((i hwm (1- i))) ((zerop i))
-             (declare (type index/2 i))
-             (with-pair (pair-key)
-              (unless (empty-ht-slot-p pair-key)
-                (when (sb-vm:is-lisp-pointer (get-lisp-obj-address pair-key))
-                  (logior-array-flags kv-vector sb-vm:vector-addr-hashing-flag))
-                (push-in-chain (pointer-hash->bucket
-                                (pointer-hash pair-key) mask))
-                (when (eq pair-key key) (setq result key-index)))))))
+                   (push-in-chain (hash-table-bucket (prefuzz-hash hash)
+                                                     index-vector unsplit)))
+                (when (eq pair-key key) (setq result key-index))))))))
        (done-rehashing kv-vector epoch)
        (unless (eql result 0)
          (setf (hash-table-cache table) result))
        result))))
 ) ; end MACROLET
 
+;;; Split up to N of the buckets that incremental growth left unsplit,
+;;; starting from the highest one. Each entry of a split bucket either stays
+;;; or moves to the partner bucket in the upper half of the index vector,
+;;; depending on the bit of its hash that the lower half does not look at.
+;;; The relative order of entries within each chain is preserved.
+(defun split-hash-table-buckets (table n)
+  (declare (hash-table table) (index n))
+  (let* ((kv-vector (hash-table-pairs table))
+         (index-vector (hash-table-index-vector table))
+         (next-vector (hash-table-next-vector table))
+         (hash-vector (hash-table-hash-vector table))
+         (half (ash (length index-vector) -1)))
+    (declare (optimize (sb-c:insert-array-bounds-checks 0)))
+    (aver (= (ash (length kv-vector) -1) (length next-vector)))
+    ;; Address-based hashes are computed from the current address of each key,
+    ;; which is right as long as the key doesn't move later. If it does,
+    ;; the vector is already flagged as address-sensitive, so GC will mark
+    ;; it as needing to be rehashed. EQL-HASH wants the key pinned regardless.
+    (sb-vm::with-pinned-object-iterator (pin-object)
+      (loop repeat n
+            for low of-type fixnum = (1- (hash-table-unsplit-buckets table))
+            while (>= low 0)
+            do (let ((this (aref index-vector low))
+                     (low-tail 0)
+                     (high-tail 0))
+                 (declare (type index/2 this low-tail high-tail))
+                 (setf (aref index-vector low) 0)
+                 (loop until (zerop this)
+                       do (let* ((key (aref kv-vector (* 2 this)))
+                                 (hash (cond (hash-vector
+                                              (let ((hash (aref hash-vector this)))
+                                                (if (= hash +magic-hash-vector-value+)
+                                                    (prefuzz-hash (pointer-hash key))
+                                                    hash)))
+                                             (t
+                                              (pin-object key)
+                                              (prefuzz-hash (eql-hash-no-memoize key)))))
+                                 (next (aref next-vector this)))
+                            (setf (aref next-vector this) 0)
+                            (cond ((logtest hash half)
+                                   (if (zerop high-tail)
+                                       (setf (aref index-vector (+ low half)) this)
+                                       (setf (aref next-vector high-tail) this))
+                                   (setq high-tail this))
+                                  (t
+                                   (if (zerop low-tail)
+                                       (setf (aref index-vector low) this)
+                                       (setf (aref next-vector low-tail) this))
+                                   (setq low-tail this)))
+                            (setq this next))))
+               (setf (hash-table-unsplit-buckets table) low)))))
+
+;;; Non-weak tables with at least this many buckets grow without rehashing.
+;;; Their pairs keep their indices in the new vectors, so the chains can be
+;;; copied as they are. If the number of buckets doubles, each bucket is split
+;;; later by SPLIT-HASH-TABLE-BUCKETS, a few at a time on each insertion.
+;;; Smaller tables are rehashed all at once, which leaves their chains in
+;;; ascending index order.
+(defconstant incremental-growth-min-buckets 16384)
+
 ;;; Enlarge TABLE.  If it is weak, then both the old and new vectors are temporarily
 ;;; made non-weak so that we don't have to deal with GC-related shenanigans.
 (defun grow-hash-table (table)
@@ -902,16 +959,24 @@ multiple threads accessing the same hash-table without locking."
            (hash-vector (when (hash-table-hash-vector table)
                           (make-array (1+ size) :element-type 'hash-table-index))))
       (setf (kv-vector-supplement kv-vector) (or hash-vector
-                                                 (eq (hash-table-test table) 'eql))
+                                                 (<= (ht-flags-kind (hash-table-flags table))
+                                                     hash-table-kind-eql))
             (hash-table-pairs table) kv-vector
             (hash-table-index-vector table) index-vector
+            (hash-table-unsplit-buckets table) 0
             (hash-table-next-vector table) next-vector
             (hash-table-hash-vector table) hash-vector)
       (return-from grow-hash-table 1)))
   (binding* (((new-kv-vector new-next-vector new-hash-vector new-index-vector)
               (hash-table-new-vectors table))
              (old-kv-vector (hash-table-pairs table))
-             (hwm (kv-vector-high-water-mark old-kv-vector)))
+             (old-index-vector (hash-table-index-vector table))
+             (hwm (kv-vector-high-water-mark old-kv-vector))
+             (incremental
+              (and (not (hash-table-weak-p table))
+                   (>= (length old-index-vector) incremental-growth-min-buckets)
+                   (or (= (length new-index-vector) (length old-index-vector))
+                       (= (length new-index-vector) (* 2 (length old-index-vector)))))))
 
     (declare (type simple-vector new-kv-vector)
              (type (simple-array hash-table-index (*)) new-next-vector new-index-vector)
@@ -925,6 +990,10 @@ multiple threads accessing the same hash-table without locking."
       ;; If the table is not weak, then every cell pair has to be in use
       ;; as a precondition to resizing. If weak, this might not be true.
       (signal-corrupt-hash-table table))
+    ;; Chains can only be copied once every entry is in its final bucket
+    ;; with respect to the current index vector.
+    (when incremental
+      (split-hash-table-buckets table (hash-table-unsplit-buckets table)))
 
     ;; Copy over the hash-vector,
     ;; This is done early because when GC scans the new vector, it needs to see
@@ -939,8 +1008,15 @@ multiple threads accessing the same hash-table without locking."
     ;; for rehash (it's going to be zeroed out).
     ;; Clearing the weakness causes all entries to stay alive.
     ;; Furthermore, clearing both makes the trailing metadata ignorable.
-    (assign-vector-flags old-kv-vector sb-vm:vector-hashing-flag)
-    (setf (kv-vector-supplement old-kv-vector) nil)
+    ;; When the chains are copied rather than recomputed, address-sensitivity
+    ;; has to carry over to the new vector before the keys do, and the old
+    ;; vector keeps it until the keys are copied, so that GC flags at least
+    ;; one of them if it moves a key whose bucket depends on its address.
+    (cond ((not incremental)
+           (assign-vector-flags old-kv-vector sb-vm:vector-hashing-flag)
+           (setf (kv-vector-supplement old-kv-vector) nil))
+          ((logtest sb-vm:vector-addr-hashing-flag (get-header-data old-kv-vector))
+           (logior-array-flags new-kv-vector sb-vm:vector-addr-hashing-flag)))
 
     ;; The high-water-mark remains unchanged.
     ;; Set this before copying pairs, otherwise they would not be seen
@@ -957,17 +1033,36 @@ multiple threads accessing the same hash-table without locking."
     ;; for example.
     (setf (kv-vector-supplement new-kv-vector)
           (or new-hash-vector
-              (= (ht-flags-kind (hash-table-flags table)) hash-table-kind-eql)))
+              (<= (ht-flags-kind (hash-table-flags table)) hash-table-kind-eql)))
 
     ;; Copy the k/v pairs excluding leading and trailing metadata.
     (replace new-kv-vector old-kv-vector
              :start1 2 :start2 2 :end2 (* 2 (1+ hwm)))
 
-    (let ((next-free (rehash new-kv-vector new-hash-vector
-                             new-index-vector new-next-vector table)))
+    (when incremental
+      ;; Chains that were stale in the old vector are stale in the new one.
+      (when (oddp (kv-vector-rehash-stamp old-kv-vector))
+        (setf (kv-vector-rehash-stamp new-kv-vector) 1))
+      (assign-vector-flags old-kv-vector sb-vm:vector-hashing-flag)
+      (setf (kv-vector-supplement old-kv-vector) nil)
+      ;; Every pair is in use, so the chains are all there is to copy,
+      ;; and the free list consists of the cells above the high-water-mark.
+      (replace new-next-vector (hash-table-next-vector table)
+               :start1 1 :start2 1 :end2 (1+ hwm))
+      (replace new-index-vector old-index-vector))
+
+    (let ((next-free (if incremental
+                         (1+ hwm)
+                         (rehash new-kv-vector new-hash-vector
+                                 new-index-vector new-next-vector table))))
       (setf (hash-table-pairs table)        new-kv-vector
             (hash-table-hash-vector table)  new-hash-vector
             (hash-table-index-vector table) new-index-vector
+            (hash-table-unsplit-buckets table)
+            (if (and incremental
+                     (/= (length new-index-vector) (length old-index-vector)))
+                (length old-index-vector)
+                0)
             (hash-table-next-vector table)  new-next-vector
             (hash-table-next-free-kv table) next-free)
 
@@ -1033,11 +1128,12 @@ if there is no such entry. Entries can be added using SETF."
            ;; so many warnings about generic SXHASH - who cares
            (locally (declare (muffle-conditions compiler-note))
              ,(case std-fn
-                (eql
-                 ;; GETHASH in an EQL table doesn't need to compute and writeback
-                 ;; a hash into a symbol that didn't already have a hash.
+                ((eq eql)
+                 ;; GETHASH in an EQ or EQL table doesn't need to compute and
+                 ;; writeback a hash into a symbol that didn't already have a hash.
                  ;; So the hash computation is a touch shorter by avoiding that.
-                 `(,(if (eq caller 'gethash) 'eql-hash-no-memoize 'eql-hash) key))
+                 `(,(symbolicate std-fn (if (eq caller 'gethash) "-HASH-NO-MEMOIZE" "-HASH"))
+                   key))
                 (equal
                  ;; EQUAL tables can opt out of using the stable instance hash
                  ;; to avoid increasing the length of all structures.
@@ -1055,7 +1151,8 @@ if there is no such entry. Entries can be added using SETF."
   (defun ht-probe-setup (std-fn &optional more-bindings)
     `((index-vector (hash-table-index-vector hash-table))
       ;; BUCKET is the masked hash code which acts as the index into index-vector
-      (bucket (mask-hash hash (1- (length index-vector))))
+      (bucket (hash-table-bucket hash index-vector
+                                 (hash-table-unsplit-buckets hash-table)))
       ;; INDEX is the index into the pairs vector obtained from the index-vector
       (index (aref index-vector bucket))
       (next-vector (hash-table-next-vector hash-table))
@@ -1306,6 +1403,24 @@ nnnn 1_    any       linear scan
                                (t ; stamp changed
                                 (retry stamp)))))))))))))
 
+;;; Run BODY, which must be executed with TABLE's lock held, so that it
+;;; appears as one write to lock-free readers. Nested writes, as when
+;;; WITH-LOCKED-HASH-TABLE encloses REMHASH, count as part of the outer one.
+(defmacro with-hash-table-write ((table) &body body)
+  (with-unique-names (ht version)
+    `(let* ((,ht ,table)
+            (,version (hash-table-%write-version ,ht)))
+       (if (oddp ,version)
+           (progn ,@body)
+           (unwind-protect
+                (progn
+                  (setf (hash-table-%write-version ,ht) (sb-vm::+-modfx ,version 1))
+                  (sb-thread:barrier (:write))
+                  ,@body)
+             (sb-thread:barrier (:write))
+             (setf (hash-table-%write-version ,ht)
+                   (sb-vm::+-modfx ,version 2)))))))
+
 ;;;; Weak table variant.
 
 ;;; A single function acts as the core of all operations on weak tables.
@@ -1343,9 +1458,6 @@ nnnn 1_    any       linear scan
                          (setq predecessor next)))))
                (cond
                  ((or (eq (hash-table-test hash-table) 'eq) address-based-p)
-                  ;; Everything in an EQ table is address-based - though this is subject
-                  ;; to change, as we could stably hash symbols, because why not -
-                  ;; but the hash fun's second value is NIL on immediate objects.
                   (probing-loop (eq key probed-key)))
                  ((eq (hash-table-test hash-table) 'eql)
                   ;; similar to EQ except for the different comparator
@@ -1357,8 +1469,9 @@ nnnn 1_    any       linear scan
                   (probing-loop (and (not (empty-ht-slot-p probed-key))
                                      (= hash (aref hash-vector next))
                                      (funcall test-fun key probed-key)))))))))
-      ;; Weak tables disallow concurrent GETHASH therefore we can't
-      ;; be in the midst of fixing up obsolete address-based hashes.
+      ;; Lock-free readers of weak tables don't rehash, and anything else
+      ;; holds the lock, therefore we can't be in the midst of fixing up
+      ;; obsolete address-based hashes.
       (aver (not (logtest initial-stamp kv-vector-rehashing)))
       (multiple-value-bind (probed-val probed-key physical-index predecessor)
           (hash-search)
@@ -1369,8 +1482,9 @@ nnnn 1_    any       linear scan
            (values probed-val probed-key physical-index predecessor))
           (t ; invalid hashes at start, and key's hash was address-based
            (without-interrupts
+            (with-hash-table-write (hash-table)
              ;; set the stamp to rehashing. There should be no concurrent
-             ;; access, but use CAS to be sure.
+             ;; writer, but use CAS to be sure.
              (aver (eql (cas (svref kv-vector rehash-stamp-elt) initial-stamp
                              (1+ initial-stamp)) initial-stamp))
              ;; Remove weakness and address-sensitivity.
@@ -1390,10 +1504,10 @@ nnnn 1_    any       linear scan
              (setf (hash-table-smashed-cells hash-table) nil)
              ;; Re-enable weakness
              (logior-array-flags kv-vector sb-vm:vector-weak-flag)
-             (done-rehashing kv-vector initial-stamp))
+             (done-rehashing kv-vector initial-stamp)))
            ;; One more try gives the definitive answer even if the hashes are
            ;; obsolete again.  KEY's hash can't have changed, and there
-           ;; are no concurrent readers to potentially mess up the chains.
+           ;; are no concurrent writers to potentially mess up the chains.
            (hash-search)))))))
 
 (defmacro with-weak-hash-table-entry (&body body)
@@ -1440,6 +1554,167 @@ nnnn 1_    any       linear scan
 (define-ht-getter gethash/equalp equalp)
 (define-ht-getter gethash/any nil)
 
+;;;; Reading synchronized tables without the lock
+
+;;; A writer to a synchronized table holds the lock, and makes the table's
+;;; %WRITE-VERSION odd while it changes anything. GETHASH on a synchronized
+;;; table with a standard test doesn't take the lock: it searches, then
+;;; accepts the answer if the version was even and is unchanged, and for
+;;; a miss, if the rehash stamp says that the search was sound. Failing
+;;; that, it asks again under the lock. WITH-HASH-TABLE-WRITE, above,
+;;; brackets the writes. Weak tables are read the same way, since GC culling a pair only
+;;; empties its cells in place and leaves the chains alone, so a reader
+;;; need only take an empty value for a miss. A writer may replace the vectors
+;;; between any two reads, so every index followed is checked against the
+;;; vector it indexes, and a search that goes wrong gives up instead of
+;;; signaling. Readers don't store into the table, not even its CACHE,
+;;; so they don't contend for its cache lines.
+
+(defmacro define-ht-lockfree-getter (name std-fn locked-getter)
+  `(defun ,name (key table default
+                     &aux (hash-table (truly-the hash-table table)))
+     (declare (optimize speed (sb-c:verify-arg-count 0)))
+     (flet ((locked ()
+              (sb-thread::with-recursive-system-lock
+                  ((hash-table-%lock hash-table))
+                (,locked-getter key hash-table default))))
+       (let ((version (hash-table-%write-version hash-table)))
+         (when (oddp version)
+           (return-from ,name (locked)))
+         (sb-thread:barrier (:read))
+         (let* ((kv-vector (hash-table-pairs hash-table))
+                (initial-stamp (kv-vector-rehash-stamp kv-vector)))
+           (flet ((unchanged-p ()
+                    (sb-thread:barrier (:read))
+                    (eq (hash-table-%write-version hash-table) version)))
+             (declare (inline unchanged-p))
+             (when (logtest initial-stamp kv-vector-rehashing)
+               (return-from ,name (locked)))
+             (let ((cache (hash-table-cache hash-table)))
+               (when (and (< (1+ cache) (length kv-vector))
+                          (eq (aref kv-vector cache) key)
+                          (/= cache 0))
+                 (let ((value (aref kv-vector (1+ cache))))
+                   (return-from ,name
+                     (if (unchanged-p) (values value t) (locked))))))
+             (with-pinned-objects (key)
+               (binding* (,@(ht-hash-setup std-fn 'gethash)
+                          (eq-test ,(ht-probing-should-use-eq std-fn))
+                          (index-vector (hash-table-index-vector hash-table))
+                          (next-vector (hash-table-next-vector hash-table))
+                          ,@(unless (member std-fn '(eq eql))
+                              '((hash-vector (hash-table-hash-vector hash-table))))
+                          (probe-limit (length next-vector))
+                          (index (aref index-vector
+                                       (hash-table-bucket
+                                        hash index-vector
+                                        (hash-table-unsplit-buckets hash-table)))))
+                 (declare (fixnum hash0 probe-limit) (index index))
+                 (loop
+                   (when (eql index 0)
+                     (return))
+                   (when (or (>= index (length next-vector))
+                             (>= (1+ (* 2 index)) (length kv-vector))
+                             ,@(unless (member std-fn '(eq eql))
+                                 '((>= index (length hash-vector))))
+                             (minusp (decf probe-limit)))
+                     (return-from ,name (locked)))
+                   (when (if eq-test
+                             (eq key (aref kv-vector (* 2 index)))
+                             ,(if (eq std-fn 'eq)
+                                  nil
+                                  (ht-key-compare std-fn 'index)))
+                     (let ((value (aref kv-vector (1+ (* 2 index)))))
+                       (return-from ,name
+                         (if (unchanged-p) (values value t) (locked)))))
+                   (setq index (aref next-vector index)))
+                 ;; A miss
+                 (let ((stamp (kv-vector-rehash-stamp kv-vector)))
+                   (if (and (unchanged-p)
+                            (if (evenp initial-stamp)
+                                ;; Only the 'rehash' bit may have been set since
+                                (zerop (logandc2 (logxor stamp initial-stamp) 1))
+                                ;; Address-based hashes were invalid all along
+                                (and (= stamp initial-stamp) (not address-based-p))))
+                       (values default nil)
+                       (locked)))))))))))
+
+(define-ht-lockfree-getter gethash/eq/lockfree eq gethash/eq)
+(define-ht-lockfree-getter gethash/eql/lockfree eql gethash/eql)
+(define-ht-lockfree-getter gethash/equal/lockfree equal gethash/equal)
+(define-ht-lockfree-getter gethash/equalp/lockfree equalp gethash/equalp)
+
+;;; The same for weak tables, with the comparisons of FINDHASH-WEAK. A pair
+;;; whose key matched but whose value is empty was culled in the meantime.
+(defun gethash/weak/lockfree (key table default
+                              &aux (hash-table (truly-the hash-table table)))
+  (declare (optimize speed (sb-c:verify-arg-count 0)))
+  (flet ((locked ()
+           (gethash/weak key hash-table default)))
+    (let ((version (hash-table-%write-version hash-table)))
+      (when (oddp version)
+        (return-from gethash/weak/lockfree (locked)))
+      (sb-thread:barrier (:read))
+      (let* ((kv-vector (hash-table-pairs hash-table))
+             (initial-stamp (kv-vector-rehash-stamp kv-vector)))
+        (flet ((unchanged-p ()
+                 (sb-thread:barrier (:read))
+                 (eq (hash-table-%write-version hash-table) version)))
+          (declare (inline unchanged-p))
+          (when (logtest initial-stamp kv-vector-rehashing)
+            (return-from gethash/weak/lockfree (locked)))
+          (with-pinned-objects (key)
+            (binding* (((hash0 address-based-p)
+                        (funcall (hash-table-hash-fun hash-table) key))
+                       (address-based-p
+                        (unless (logtest (hash-table-flags hash-table)
+                                         hash-table-userfun-flag)
+                          address-based-p))
+                       (hash (prefuzz-hash (the fixnum hash0)))
+                       (test (hash-table-test hash-table))
+                       (test-fun (hash-table-test-fun hash-table))
+                       (index-vector (hash-table-index-vector hash-table))
+                       (next-vector (hash-table-next-vector hash-table))
+                       (hash-vector (hash-table-hash-vector hash-table))
+                       (probe-limit (length next-vector))
+                       (index (aref index-vector
+                                    (hash-table-bucket
+                                     hash index-vector
+                                     (hash-table-unsplit-buckets hash-table)))))
+              (declare (fixnum probe-limit) (index index))
+              (loop
+                (when (eql index 0)
+                  (return))
+                (when (or (>= index (length next-vector))
+                          (>= (1+ (* 2 index)) (length kv-vector))
+                          (and hash-vector (>= index (length hash-vector)))
+                          (minusp (decf probe-limit)))
+                  (return-from gethash/weak/lockfree (locked)))
+                (let ((probed-key (aref kv-vector (* 2 index))))
+                  (when (cond ((or (eq test 'eq) address-based-p)
+                               (eq key probed-key))
+                              ((eq test 'eql)
+                               (%eql key probed-key))
+                              (t
+                               (and (not (empty-ht-slot-p probed-key))
+                                    hash-vector
+                                    (= hash (aref hash-vector index))
+                                    (funcall test-fun key probed-key))))
+                    (let ((value (aref kv-vector (1+ (* 2 index)))))
+                      (return-from gethash/weak/lockfree
+                        (cond ((not (unchanged-p)) (locked))
+                              ((empty-ht-slot-p value) (values default nil))
+                              (t (values value t)))))))
+                (setq index (aref next-vector index)))
+              ;; A miss
+              (let ((stamp (kv-vector-rehash-stamp kv-vector)))
+                (if (and (unchanged-p)
+                         (if (evenp initial-stamp)
+                             (zerop (logandc2 (logxor stamp initial-stamp) 1))
+                             (and (= stamp initial-stamp) (not address-based-p))))
+                    (values default nil)
+                    (locked))))))))))
+
 ;;; In lieu of racing to rehash in multiple threads due to GC key movement,
 ;;; or blocking on a mutex to rehash, threads can perform just the FIND
 ;;; aspect of %REHASH-AND-FIND which is obviously less work than rehashing.
@@ -1495,24 +1770,29 @@ nnnn 1_    any       linear scan
               ;; into these methods
               ;; Use the private slot accessor, because we know that the mutex
               ;; has been constructed.
-              `(values (named-lambda ,(symbolicate getter "/LOCK") (key table default)
-                         (declare (optimize speed (sb-c:verify-arg-count 0)))
-                         (truly-the (values t t &optional)
-                           (sb-thread::with-recursive-system-lock
-                               ((hash-table-%lock (truly-the hash-table table)))
-                             (,getter key table default))))
+              `(values ,(if (eq getter 'gethash/any)
+                            `(named-lambda ,(symbolicate getter "/LOCK") (key table default)
+                               (declare (optimize speed (sb-c:verify-arg-count 0)))
+                               (truly-the (values t t &optional)
+                                 (sb-thread::with-recursive-system-lock
+                                     ((hash-table-%lock (truly-the hash-table table)))
+                                   (,getter key table default))))
+                            ;; Standard tests can be read without the lock
+                            `#',(symbolicate getter "/LOCKFREE"))
                        (named-lambda ,(symbolicate setter "/LOCK") (key table value)
                          (declare (optimize speed (sb-c:verify-arg-count 0)))
                          (truly-the (values t &optional)
                            (sb-thread::with-recursive-system-lock
                                ((hash-table-%lock (truly-the hash-table table)))
-                             (,setter key table value))))
+                             (with-hash-table-write (table)
+                               (,setter key table value)))))
                        (named-lambda ,(symbolicate remover "/LOCK") (key table)
                          (declare (optimize speed (sb-c:verify-arg-count 0)))
                          (truly-the (values t &optional)
                            (sb-thread::with-recursive-system-lock
                                ((hash-table-%lock (truly-the hash-table table)))
-                             (,remover key table))))))
+                             (with-hash-table-write (table)
+                               (,remover key table)))))))
              (methods (getter setter remover)
               `(values #',getter #',setter #',remover)))
     (if synchronized
@@ -1688,27 +1968,34 @@ nnnn 1_    any       linear scan
              (setf (aref kv-vector i) key (aref kv-vector (1+ i)) value))
            ;; Push this slot onto the front of the chain for its bucket.
            (let* ((index-vector (hash-table-index-vector hash-table))
-                  (bucket (mask-hash hash (1- (length index-vector)))))
+                  (bucket (hash-table-bucket hash index-vector
+                                             (hash-table-unsplit-buckets hash-table))))
              (setf (aref next-vector index) (aref index-vector bucket)
                    (aref index-vector bucket) index)))
          (incf (hash-table-%count hash-table))
+         ;; With the default rehash-size, 4 buckets per insertion are enough
+         ;; to finish before the table grows again. Otherwise the rest are
+         ;; split by GROW-HASH-TABLE.
+         (when (plusp (hash-table-unsplit-buckets hash-table))
+           (split-hash-table-buckets hash-table 4))
          value))
 
   (defun puthash/weak (key hash-table value)
     (declare (type hash-table hash-table) (optimize speed))
     (with-weak-hash-table-entry
       (declare (ignore predecessor))
-      (cond ((= physical-index 0)
-             ;; There are two kinds of freelists. Prefer a smashed cell
-             ;; so that we might shorten the chain it belonged to.
-             (insert-at (or (hash-table-next-smashed-kv hash-table)
-                            (hash-table-next-free-kv hash-table))
-                        hash-table key hash address-sensitive-p value))
-            ((or (empty-ht-slot-p (cas (svref kv-vector (1+ physical-index))
-                                       probed-value value))
-                 (neq (svref kv-vector physical-index) probed-key))
-             (signal-corrupt-hash-table hash-table))
-            (t value))))
+      (with-hash-table-write (hash-table)
+        (cond ((= physical-index 0)
+               ;; There are two kinds of freelists. Prefer a smashed cell
+               ;; so that we might shorten the chain it belonged to.
+               (insert-at (or (hash-table-next-smashed-kv hash-table)
+                              (hash-table-next-free-kv hash-table))
+                          hash-table key hash address-sensitive-p value))
+              ((or (empty-ht-slot-p (cas (svref kv-vector (1+ physical-index))
+                                         probed-value value))
+                   (neq (svref kv-vector physical-index) probed-key))
+               (signal-corrupt-hash-table hash-table))
+              (t value)))))
   (define-ht-setter puthash/eq eq)
   (define-ht-setter puthash/eql eql)
   (define-ht-setter puthash/equal equal)
@@ -1773,6 +2060,7 @@ nnnn 1_    any       linear scan
 (defun remhash/weak (key hash-table)
   (declare (type hash-table hash-table) (optimize speed))
   (with-weak-hash-table-entry
+      (with-hash-table-write (hash-table)
         (unless (eql physical-index 0)
           ;; Mark slot as empty.
           (if (or (empty-ht-slot-p (cas (svref kv-vector (1+ physical-index))
@@ -1794,7 +2082,7 @@ nnnn 1_    any       linear scan
                 (setf (aref next-vector index) (hash-table-next-free-kv hash-table)
                       (hash-table-next-free-kv hash-table) index)
                 (decf (hash-table-%count hash-table))
-                t)))))
+                t))))))
 
 (labels ((clear-slot (index hash-table kv-vector next-vector)
            (declare (type index/2 index))
@@ -1925,9 +2213,12 @@ table itself."
                   (when (typep hash-table 'general-hash-table)
                     (setf (hash-table-smashed-cells hash-table) nil))
                   (setf (hash-table-next-free-kv hash-table) 1
+                        (hash-table-unsplit-buckets hash-table) 0
                         (kv-vector-high-water-mark kv-vector) 0))))
       (if (hash-table-synchronized-p hash-table)
-          (sb-thread::call-with-recursive-system-lock #'clear (hash-table-%lock hash-table))
+          (sb-thread::with-recursive-system-lock ((hash-table-%lock hash-table))
+            (with-hash-table-write (hash-table)
+              (clear)))
           (clear))))
   hash-table)
 
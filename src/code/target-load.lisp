@@ -311,6 +311,52 @@
                                                   :class 'form-tracking-stream)
                    (load-stream stream nil)))))))))
 
+(defun load-files (files &key (verbose *load-verbose*) (print *load-print*)
+                              threads)
+  "Load each of FILES, a list, as if by LOAD with the other keyword
+arguments, in the order given, and return T. Meanwhile up to THREADS
+threads, by default the number of online processors, read the files
+after the one being loaded, so that the loading seldom waits for the
+disk. The loading itself happens in the calling thread, since what a
+file contains, such as symbols of packages or instances of classes,
+may have to be defined by the files before it."
+  (let* ((files (coerce files 'simple-vector))
+         (n (length files))
+         (next (list 0))
+         (done nil))
+    (declare (index n) (ignorable next done threads))
+    (flet ((read-ahead ()
+             (let ((buffer (make-array 65536 :element-type '(unsigned-byte 8))))
+               (loop for i of-type index = (atomic-incf (car next))
+                     while (and (< i n) (not done))
+                     do (ignore-errors
+                         (with-open-file (stream (svref files i)
+                                                 :element-type '(unsigned-byte 8)
+                                                 :if-does-not-exist nil)
+                           (when stream
+                             (loop until (< (read-sequence buffer stream)
+                                            (length buffer))))))))))
+      (declare (ignorable #'read-ahead))
+      (let ((workers
+              #+sb-thread
+              (loop repeat (min (1- n)
+                                (or threads
+                                    (alien-funcall
+                                     (extern-alien "sb_online_processor_count"
+                                                   (function int)))))
+                    collect (sb-thread:make-thread #'read-ahead
+                                                   :name "load read-ahead"))))
+        ;; The first file is about to be read anyway.
+        (atomic-incf (car next))
+        (unwind-protect
+             (loop for file across files
+                   do (load file :verbose verbose :print print))
+          (setq done t)
+          #+sb-thread
+          (dolist (worker workers)
+            (sb-thread:join-thread worker :default nil)))))
+    t))
+
 ;; This implements the defaulting SBCL seems to have inherited from
 ;; CMU.  This routine does not try to perform any loading; all it does
 ;; is return the pathname (not the truename) of a file to be loaded,
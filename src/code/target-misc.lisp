@@ -162,6 +162,11 @@ the file system."
     (handler-bind (((satisfies sb-c::handle-condition-p)
                      #'sb-c::handle-condition-handler))
       (warn 'redefinition-with-defun :name name :new-function def)))
+  ;; Callers compiled to use the companion of the old definition keep
+  ;; working, at the cost of boxing, unless the new one replaces it.
+  (let ((kind (info :function :unboxed-return name)))
+    (when kind
+      (setf (fdefinition `(unboxed-return ,name)) (unboxed-return-fallback name kind))))
   (sb-c:%compiler-defun name nil inline-lambda extra-info)
   (setf (fdefinition name) def)
   ;; %COMPILER-DEFUN doesn't do this except at compile-time, when it
@@ -172,6 +177,24 @@ the file system."
   (sb-c::note-name-defined name :function)
   name)
 
+;;; The companion of the function NAME for when the current definition
+;;; of NAME doesn't have one.
+(defun unboxed-return-fallback (name kind)
+  (ecase kind
+    (double-float
+     (lambda (&rest args)
+       (let ((result (apply name args)))
+         (values (double-float-high-bits result) (double-float-low-bits result)))))
+    (word
+     (lambda (&rest args)
+       (let ((result (apply name args)))
+         (declare (type word result))
+         (values (ldb (byte 32 32) result) (ldb (byte 32 0) result)))))))
+
+(defun %define-unboxed-return (name kind)
+  (setf (info :function :unboxed-return name) kind)
+  name)
+
 (in-package "SB-C")
 
 (defun split-version-string (string)
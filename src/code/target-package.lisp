@@ -38,6 +38,15 @@
 ;;;; the latter is only held over operations guaranteed to terminate in finite
 ;;;; time.
 ;;;;
+;;;; FIND-SYMBOL, and INTERN of an existing symbol, take no lock at all.
+;;;; Writers keep them safe by never making a partly built vector visible:
+;;;; a symbol is fully initialized before it is stored into its cell, the
+;;;; cells of a resized table and the tables of a package are always
+;;;; fresh vectors, and each of those is published after a write barrier.
+;;;; A reader racing with a writer finds either the old or the new state.
+;;;; Readers also avoid writing to the package in the common case, so that
+;;;; threads reading the same packages don't contend for its cache line.
+;;;;
 ;;;; Errors may be signalled while holding on to the *PACKAGE-GRAPH-LOCK*,
 ;;;; which can still lead to pretty damned inconvenient situations -- but
 ;;;; since FIND-PACKAGE, FIND-SYMBOL from other threads isn't blocked by this,
@@ -342,6 +351,7 @@ of :INHERITED :EXTERNAL :INTERNAL."
     (dovector (sym (package-hashtable-cells table))
       (when (pkg-symbol-valid-p sym)
         (add-symbol temp-table sym)))
+    (sb-thread:barrier (:write))
     (setf (package-hashtable-cells table) (package-hashtable-cells temp-table)
           (package-hashtable-size table) (package-hashtable-size temp-table)
           (package-hashtable-free table) (package-hashtable-free temp-table)
@@ -826,6 +836,9 @@ Experimental: interface subject to change."
          ;; so it's not really useful to be lock-free here,
          ;; even though we could be. (We're already inside a mutex)
          (let ((old (svref symvec i)))
+           ;; Make the name, hash and package of SYMBOL visible to
+           ;; readers before SYMBOL itself.
+           (sb-thread:barrier (:write))
            (setf (svref symvec i) symbol)
            (if (eql old 0)
                (decf (package-hashtable-free table)) ; unused
@@ -1235,7 +1248,8 @@ implementation it is ~S." *!default-package-use-list*)
            (with-symbol ((symbol) (locally (declare (optimize (safety 0)))
                                     (svref tables i))
                          string length hash)
-             (setf (package-mru-table-index package) i)
+             (unless (eql i mru)
+               (setf (package-mru-table-index package) i))
              (return-from %find-symbol (values symbol :inherited)))
            (if (< (decf i) 0) (setq i (1- n)))
            (if (= i start) (return)))))))
@@ -1775,11 +1789,12 @@ PACKAGE."
                        (name-conflict package 'use-package pkg sym s)))))))
 
             (push pkg (package-%use-list package))
-            (setf (package-tables package)
-                  (let ((tbls (package-tables package)))
-                    (replace (make-array (1+ (length tbls))
-                              :initial-element (package-external-symbols pkg))
-                             tbls)))
+            (let* ((tbls (package-tables package))
+                   (new (replace (make-array (1+ (length tbls))
+                                             :initial-element (package-external-symbols pkg))
+                                 tbls)))
+              (sb-thread:barrier (:write))
+              (setf (package-tables package) new))
             (push package (package-%used-by-list pkg)))))))
   t)
 
@@ -1795,9 +1810,11 @@ PACKAGE."
                                      (length packages) packages))
           (setf (package-%use-list package)
                 (remove p (the list (package-%use-list package))))
-          (setf (package-tables package)
-                (delete (package-external-symbols p)
-                        (package-tables package)))
+          ;; REMOVE, not DELETE: FIND-SYMBOL may be walking the old vector.
+          (let ((new (remove (package-external-symbols p)
+                             (package-tables package))))
+            (sb-thread:barrier (:write))
+            (setf (package-tables package) new))
           (setf (package-%used-by-list p)
                 (remove package (the list (package-%used-by-list p))))))
       t)))
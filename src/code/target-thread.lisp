@@ -456,7 +456,24 @@ See also: RETURN-FROM-THREAD and SB-EXT:EXIT."
                                     long unsigned-long)
                           :extern "futex_wait"))
         (with-interrupts
-          (alien-funcall %wait word-addr oldval to-sec to-usec))))))
+          (alien-funcall %wait word-addr oldval to-sec to-usec))))
+
+    ;; Like FUTEX-WAIT but with an absolute timeout STOP-SEC, STOP-USEC
+    ;; as returned by DECODE-TIMEOUT. Where the kernel can take an absolute
+    ;; timeout, spurious wakeups don't then cost a clock read per retry.
+    (declaim (inline futex-wait-until))
+    (defun futex-wait-until (word-addr oldval stop-sec stop-usec)
+      #+linux
+      (with-alien ((%wait (function int unsigned (unsigned 32) long unsigned-long)
+                          :extern "futex_wait_until"))
+        (with-interrupts
+          (alien-funcall %wait word-addr oldval stop-sec stop-usec)))
+      #-linux
+      (multiple-value-bind (to-sec to-usec)
+          (sb-impl::relative-decoded-times stop-sec stop-usec)
+        (if (and (zerop to-sec) (zerop to-usec))
+            1 ; ETIMEDOUT
+            (futex-wait word-addr oldval to-sec to-usec))))))
 
 (defmacro with-deadlocks ((thread lock &optional (timeout nil timeoutp)) &body forms)
   (with-unique-names (n-thread n-lock new n-timeout)
@@ -691,6 +708,121 @@ returns NIL each time."
                 (zerop (sb-ext:compare-and-swap (mutex-%owner mutex) 0
                                                 (current-vmthread-id))))))))
 
+;;; Upper bound on the number of times %%WAIT-FOR-MUTEX spins on a contested
+;;; mutex before sleeping. Setting it to 0 disables spinning.
+#+sb-futex
+(progn
+  (sb-ext:define-load-time-global *mutex-spin-limit* 100)
+  (declaim (fixnum *mutex-spin-limit*)))
+
+;;;; Mutex contention profiling
+;;;
+;;; When enabled, each GRAB-MUTEX that does not acquire the mutex immediately
+;;; records which function was waiting and for how long. The waiter is the
+;;; innermost frame outside of the mutex implementation. Uncontested
+;;; acquisitions never get this far, so the cost when nobody is waiting is a
+;;; load of *MUTEX-CONTENTION*, and only when %TRY-MUTEX has failed.
+;;;
+;;; Samples are accumulated in an open-addressed table keyed by
+;;; (MUTEX . WAITER) that is updated without locking: a key cell is claimed
+;;; by CAS, and its count and total wait are atomically incremented.
+;;; If the table fills up, samples for new keys are dropped.
+
+#+sb-thread
+(progn
+  ;; NIL, or a cons of a SIMPLE-VECTOR of keys and a vector of
+  ;; (count, microseconds) pairs
+  (sb-ext:define-load-time-global *mutex-contention* nil)
+  (defvar *noting-mutex-contention* nil)
+
+  (export '(start-mutex-contention-profiling stop-mutex-contention-profiling
+            report-mutex-contention))
+
+  (defun start-mutex-contention-profiling (&key (max-entries 1024))
+    "Start recording who waits for contested mutexes and for how long,
+discarding any previously collected data. MAX-ENTRIES bounds the number
+of distinct (mutex, waiter) pairs recorded."
+    (let ((n (power-of-two-ceiling (max max-entries 16))))
+      (setq *mutex-contention*
+            (cons (make-array n :initial-element 0)
+                  (make-array (* 2 n) :element-type 'sb-vm:word :initial-element 0))))
+    t)
+
+  (defun stop-mutex-contention-profiling ()
+    "Stop recording mutex contention. Returns the data collected so far in
+the format of REPORT-MUTEX-CONTENTION, which can no longer report it."
+    (prog1 (report-mutex-contention :stream nil)
+      (setq *mutex-contention* nil)))
+
+  (defun mutex-contention-waiter ()
+    (let ((package (symbol-package 'grab-mutex)))
+      (do ((frame (sb-di:top-frame) (sb-di:frame-down frame)))
+          ((null frame) nil)
+        (let ((name (sb-di:debug-fun-name (sb-di:frame-debug-fun frame))))
+          (unless (and (symbolp name)
+                       (eq (symbol-package name) package)
+                       (or (member name '(mutex-contention-waiter
+                                          start-noting-mutex-contention
+                                          %wait-for-mutex grab-mutex get-mutex
+                                          %condition-wait condition-wait))
+                           (eql (search "CALL-WITH-" (string name)) 0)))
+            (return name))))))
+
+  (defun start-noting-mutex-contention ()
+    (let ((waiter (let ((*noting-mutex-contention* t))
+                    (mutex-contention-waiter))))
+      (cons waiter (get-internal-real-time))))
+
+  (defun note-mutex-contention (mutex contention)
+    (let ((table *mutex-contention*)
+          (waiter (car contention))
+          (usec (truncate (* (max (- (get-internal-real-time) (cdr contention)) 0)
+                             1000000)
+                          internal-time-units-per-second)))
+      (when table
+        (let* ((keys (car table))
+               (counts (cdr table))
+               (mask (1- (length keys)))
+               (start (logand (sxhash waiter) mask)))
+          (declare (simple-vector keys) (type (simple-array sb-vm:word (*)) counts))
+          (dotimes (probe (length keys))
+            (let* ((i (logand (+ start probe) mask))
+                   (key (svref keys i)))
+              (when (eql key 0)
+                (let* ((new (cons mutex waiter))
+                       (old (sb-ext:cas (svref keys i) 0 new)))
+                  (setq key (if (eql old 0) new old))))
+              (when (and (eq (car key) mutex) (equal (cdr key) waiter))
+                (sb-ext:atomic-incf (aref counts (* 2 i)))
+                (sb-ext:atomic-incf (aref counts (1+ (* 2 i)))
+                                    (logand usec sb-ext:most-positive-word))
+                (return))))))))
+
+  (defun report-mutex-contention (&key (stream *standard-output*) (max 20))
+    "Print the mutexes that threads waited for most, in decreasing order of
+total waiting time, with the function that waited. Returns a list of
+(MUTEX WAITER COUNT MICROSECONDS) for every recorded pair."
+    (let ((table *mutex-contention*) (rows))
+      (when table
+        (let ((keys (car table)) (counts (cdr table)))
+          (dotimes (i (length keys))
+            (let ((key (svref keys i)))
+              (unless (eql key 0)
+                (push (list (car key) (cdr key)
+                            (aref counts (* 2 i)) (aref counts (1+ (* 2 i))))
+                      rows))))))
+      (setq rows (sort rows #'> :key #'fourth))
+      (when stream
+        (format stream "~&~9@A ~12@A ~10@A  ~A~%~A~%"
+                "Count" "Total (ms)" "Avg (us)" "Mutex / Waiter"
+                (make-string 78 :initial-element #\-))
+        (loop for (mutex waiter count usec) in rows
+              repeat max
+              do (format stream "~9D ~12,3F ~10D  ~A / ~S~%"
+                         count (/ usec 1000.0) (if (plusp count) (round usec count) 0)
+                         (or (mutex-name mutex) mutex) waiter)))
+      rows)))
+
 #+sb-thread
 (defun %%wait-for-mutex (mutex to-sec to-usec stop-sec stop-usec)
   (declare (type mutex mutex) (optimize (speed 3)))
@@ -711,8 +843,26 @@ returns NIL each time."
     ;;    } while ((c = cmpxchg(val, 0, 2)) != 0);
     ;; }
     ;;
+    ;;
+    ;; Before sleeping, spin for a while in the hope that the owner releases
+    ;; the mutex soon. The number of spins is bounded by twice the moving
+    ;; average of what it took recently, so a mutex that is held only briefly
+    ;; is usually acquired without a system call, and one that is held for a
+    ;; long time does not waste much CPU. This is the adaptive scheme of
+    ;; glibc's PTHREAD_MUTEX_ADAPTIVE_NP.
     (symbol-macrolet ((val (mutex-state mutex)))
       (let ((c (sb-ext:cas val 0 1))) ; available -> taken
+        (unless (or (= c 0) (<= *mutex-spin-limit* 0))
+          (let* ((spins (mutex-spins mutex))
+                 (limit (min *mutex-spin-limit* (+ (* 2 spins) 10)))
+                 (n 0))
+            (declare (fixnum n))
+            (loop (sb-ext:spin-loop-hint)
+                  (incf n)
+                  (when (and (= val 0) (= (setq c (sb-ext:cas val 0 1)) 0))
+                    (return))
+                  (when (>= n limit) (return)))
+            (setf (mutex-spins mutex) (+ spins (truncate (- n spins) 8)))))
         (unless (= c 0) ; Got it right off the bat?
           (nlx-protect
            (if (not stop-sec)
@@ -726,16 +876,14 @@ returns NIL each time."
                (loop             ; same as above but check for timeout
                      (when (or (eql c 2) (/= 0 (sb-ext:cas val 1 2)))
                        (if (eql 1 (with-pinned-objects (mutex)
-                                    (futex-wait (mutex-state-address mutex) 2 to-sec to-usec)))
+                                    (futex-wait-until (mutex-state-address mutex) 2
+                                                      stop-sec stop-usec)))
                            ;; -1 = EWOULDBLOCK, possibly spurious wakeup
                            ;;  0 = normal wakeup
                            ;;  1 = ETIMEDOUT ***DONE***
                            ;;  2 = EINTR, a spurious wakeup
                            (return-from %%wait-for-mutex nil)))
-                     (when (= 0 (setq c (sb-ext:cas val 0 2))) (return)) ; win
-                     ;; Update timeout
-                     (setf (values to-sec to-usec)
-                           (sb-impl::relative-decoded-times stop-sec stop-usec))))
+                     (when (= 0 (setq c (sb-ext:cas val 0 2))) (return)))) ; win
            ;; Unwinding because futex-wait allows interrupts, wake up another futex
            (with-pinned-objects (mutex)
              (futex-wake (mutex-state-address mutex) 1)))))
@@ -837,18 +985,22 @@ returns NIL each time."
 (defun %wait-for-mutex (mutex timeout to-sec to-usec stop-sec stop-usec deadlinep
                         &aux (self *current-thread*))
   (declare (sb-ext:muffle-conditions sb-ext:compiler-note))
-  (with-deadlocks (self mutex timeout)
-    (with-interrupts (check-deadlock))
-    (tagbody
-     :again
-       (return-from %wait-for-mutex
-         (or (%%wait-for-mutex mutex to-sec to-usec stop-sec stop-usec)
-             (when deadlinep
-               (signal-deadline)
-               ;; FIXME: substract elapsed time from timeout...
-               (setf (values to-sec to-usec stop-sec stop-usec deadlinep)
-                     (decode-timeout timeout))
-               (go :again)))))))
+  (let ((contention (when (and *mutex-contention* (not *noting-mutex-contention*))
+                      (start-noting-mutex-contention))))
+    (with-deadlocks (self mutex timeout)
+      (with-interrupts (check-deadlock))
+      (tagbody
+       :again
+         (return-from %wait-for-mutex
+           (or (when (%%wait-for-mutex mutex to-sec to-usec stop-sec stop-usec)
+                 (when contention (note-mutex-contention mutex contention))
+                 t)
+               (when deadlinep
+                 (signal-deadline)
+                 ;; FIXME: substract elapsed time from timeout...
+                 (setf (values to-sec to-usec stop-sec stop-usec deadlinep)
+                       (decode-timeout timeout))
+                 (go :again))))))))
 
 (define-deprecated-function :early "1.0.37.33" get-mutex (grab-mutex)
     (mutex &optional new-owner (waitp t) (timeout nil))
@@ -940,6 +1092,132 @@ IF-NOT-OWNER is :FORCE)."
       nil)))
 
 
+;;;; Reader-writer locks
+
+;;; A reader increments its counter and then looks for a writer. A writer
+;;; announces itself and then waits for every reader counter to be zero.
+;;; With a full barrier between the store and the load on each side, at
+;;; least one of them sees the other: the reader then backs off, or the
+;;; writer waits. A reader that leaves while a writer is present bumps
+;;; the DRAIN word, which the writer sleeps on, and readers that back
+;;; off sleep on the WRITER word until the writer is done.
+
+#+sb-futex
+(progn
+  (locally (declare (sb-ext:muffle-conditions sb-ext:compiler-note))
+    (define-structure-slot-addressor rwlock-writer-address
+      :structure rwlock
+      :slot writer
+      :byte-offset (+ #+(and 64-bit big-endian) 4))
+    (define-structure-slot-addressor rwlock-drain-address
+      :structure rwlock
+      :slot drain
+      :byte-offset (+ #+(and 64-bit big-endian) 4))))
+
+(defmacro rwlock-wait (rwlock addressor expected)
+  (declare (ignorable rwlock addressor expected))
+  #+sb-futex
+  `(with-pinned-objects (,rwlock)
+     (futex-wait (,addressor ,rwlock) (logand ,expected #xffffffff) -1 0))
+  #-sb-futex
+  '(thread-yield))
+
+(defmacro rwlock-wake (rwlock addressor n)
+  (declare (ignorable rwlock addressor n))
+  #+sb-futex
+  `(with-pinned-objects (,rwlock)
+     (futex-wake (,addressor ,rwlock) ,n))
+  #-sb-futex
+  nil)
+
+(declaim (inline rwlock-reader-index))
+(defun rwlock-reader-index ()
+  ;; Thread structures are aligned to a large power of 2, so the low bits
+  ;; of the address need to be mixed in with the others
+  (declare (inline #+64-bit sb-impl::murmur3-fmix64 #-64-bit sb-impl::murmur3-fmix32))
+  (* (logand (#+64-bit sb-impl::murmur3-fmix64 #-64-bit sb-impl::murmur3-fmix32
+              (logand (current-thread-sap-int) sb-ext:most-positive-word))
+             (1- +rwlock-stripes+))
+     +rwlock-stripe-words+))
+
+(defun rwlock-reader-exit (rwlock index)
+  (declare (type rwlock rwlock))
+  (sb-ext:atomic-decf (aref (rwlock-readers rwlock) index))
+  (barrier (:memory))
+  (unless (= (rwlock-writer rwlock) 0)
+    (sb-ext:atomic-incf (rwlock-drain rwlock))
+    (rwlock-wake rwlock rwlock-drain-address 1)))
+
+(defun grab-rwlock-read (rwlock)
+  "Acquire RWLOCK for reading, waiting while a thread holds it or waits to
+hold it for writing. Like GRAB-MUTEX, this is not interrupt safe; it is
+better to use WITH-RWLOCK-READ."
+  (declare (type rwlock rwlock))
+  (let ((readers (rwlock-readers rwlock))
+        (index (rwlock-reader-index)))
+    (loop
+      (sb-ext:atomic-incf (aref readers index))
+      (barrier (:memory))
+      (when (= (rwlock-writer rwlock) 0)
+        (return t))
+      ;; Get out of the writer's way
+      (rwlock-reader-exit rwlock index)
+      (loop until (= (rwlock-writer rwlock) 0)
+            do (rwlock-wait rwlock rwlock-writer-address 1)))))
+
+(defun release-rwlock-read (rwlock)
+  "Release RWLOCK, which the current thread holds for reading."
+  (declare (type rwlock rwlock))
+  (rwlock-reader-exit rwlock (rwlock-reader-index))
+  nil)
+
+(defun %release-rwlock-write (rwlock)
+  (setf (rwlock-writer rwlock) 0)
+  (barrier (:memory))
+  (rwlock-wake rwlock rwlock-writer-address #x7fffffff)
+  (release-mutex (rwlock-mutex rwlock)))
+
+(defun grab-rwlock-write (rwlock)
+  "Acquire RWLOCK for writing, waiting until no other thread holds it.
+Like GRAB-MUTEX, this is not interrupt safe; it is better to use
+WITH-RWLOCK-WRITE."
+  (declare (type rwlock rwlock))
+  (grab-mutex (rwlock-mutex rwlock))
+  (setf (rwlock-writer rwlock) 1)
+  (barrier (:memory))
+  (let ((readers (rwlock-readers rwlock))
+        (done nil))
+    (unwind-protect
+         (loop
+           (let ((drain (rwlock-drain rwlock)))
+             (barrier (:read))
+             (when (loop for i below (length readers) by +rwlock-stripe-words+
+                         always (= (aref readers i) 0))
+               (return (setq done t)))
+             (rwlock-wait rwlock rwlock-drain-address drain)))
+      (unless done
+        (%release-rwlock-write rwlock)))))
+
+(defun release-rwlock-write (rwlock)
+  "Release RWLOCK, which the current thread holds for writing."
+  (declare (type rwlock rwlock))
+  (%release-rwlock-write rwlock)
+  nil)
+
+(macrolet ((def (name grab release)
+             `(defun ,name (function rwlock)
+                (declare (function function))
+                (declare (dynamic-extent function))
+                (let ((got-it nil))
+                  (without-interrupts
+                    (unwind-protect
+                         (when (setq got-it (allow-with-interrupts (,grab rwlock)))
+                           (with-local-interrupts (funcall function)))
+                      (when got-it
+                        (,release rwlock))))))))
+  (def call-with-rwlock-read grab-rwlock-read release-rwlock-read)
+  (def call-with-rwlock-write grab-rwlock-write release-rwlock-write))
+
 ;;;; Waitqueues/condition variables
 
 #+(and sb-thread (not sb-futex))
@@ -1037,12 +1315,12 @@ IF-NOT-OWNER is :FORCE)."
                    ;; wakeup. We may get spurious wakeups, but that's ok.
                    (setf status
                          (case (allow-with-interrupts
-                                 (futex-wait (waitqueue-token-address queue)
-                                             (my-kernel-thread-id)
-                                             ;; our way of saying "no
-                                             ;; timeout":
-                                             (or to-sec -1)
-                                             (or to-usec 0)))
+                                 (if stop-sec
+                                     (futex-wait-until (waitqueue-token-address queue)
+                                                       (my-kernel-thread-id)
+                                                       stop-sec stop-usec)
+                                     (futex-wait (waitqueue-token-address queue)
+                                                 (my-kernel-thread-id) -1 0)))
                            ((1)
                             ;;  1 = ETIMEDOUT
                             :timeout)
@@ -1603,6 +1881,10 @@ on this semaphore, then N of them is woken up."
               (abort-thread :allow-exit t)))
       (dolist (thread (list-all-threads))
         (cond ((eq thread current))
+              ;; It's in foreign code almost all the time, with nothing to
+              ;; unwind to, and the OS-EXIT will take it away anyway.
+              ((and (typep thread 'foreign-thread)
+                    (thread-kept-attached-p thread)))
               ((main-thread-p thread)
                (setf main thread))
               (t
@@ -1803,7 +2085,7 @@ session."
   `(alien-funcall (extern-alien "free_thread_struct" (function void system-area-pointer))
                  ,memory))
 
-(defun primitive-join (thread dispose)
+(defun primitive-join (thread)
   ;; It's safe to read from the other thread's memory, because the current thread
   ;; has ownership of that memory now. And we can't call this on a FOREIGN-THREAD.
   (let ((c-thread (descriptor-sap (thread-startup-info thread))))
@@ -1814,11 +2096,10 @@ session."
     (alien-funcall (extern-alien "pthread_join" (function int unsigned unsigned))
                    (thread-os-thread thread) 0) ; no result pointer
     (setf (thread-os-thread thread) 0)
-    (cond (dispose
-           (free-thread-struct c-thread)
-           nil)
-          (t ; Return the originally mapped address
-           (sap-ref-sap c-thread (ash sb-vm::thread-os-address-slot sb-vm:word-shift))))))
+    ;; Return the memory to the thread struct pool, or unmap it if the pool is full
+    (alien-funcall (extern-alien "put_recyclebin_item" (function void system-area-pointer))
+                   c-thread)
+    nil))
 
 ;;; Helper for SB-POSIX:FORK so that the child starts with no joinable threads.
 ;;; It might work to just set *JOINABLE-THREADS* to NIL in the child, but it's better to prune
@@ -1831,11 +2112,12 @@ session."
 (defun join-pthread-joinables (heuristic)
   (loop (unless (funcall heuristic *joinable-threads*) (return))
         (let ((item (sb-ext:atomic-pop *joinable-threads*)))
-          (if item (primitive-join item t) (return)))))
+          (if item (primitive-join item) (return)))))
 
 ;;; Allocate lisp thread memory, attempting first to join any exited
-;;; threads, freeing their memory. Possibly reuse the memory from one of
-;;; the exited threads,
+;;; threads, which returns their memory to the pool of thread structs
+;;; maintained by the C runtime. Memory taken from the pool has its guard
+;;; pages protected and its stack pages already faulted in.
 ;;; Why do it this way instead of having JOIN-THREAD just defer to pthread_join() ?
 ;;; Because the interface would be less lispy. e.g. what happens if you don't join
 ;;; a thread - do you leak the memory?; That's bad. GC doesn't clean up threads.
@@ -1848,28 +2130,29 @@ session."
 ;;; Ours has the meaning of "get result if done, otherwise wait"
 ;;; which is not the same as deallocation of the thread's OS resources.
 (defun allocate-thread-memory ()
-  (let ((reuse (let ((corpse (sb-ext:atomic-pop *joinable-threads*)))
-                 (when corpse (primitive-join corpse nil)))))
-    ;; If there is more than 1 more joinable, join all but 1.
-    ;; Two threads could both find > 1 thread to join, and both do
-    ;; a join, leaving 0 to join. That's ok.
-    (join-pthread-joinables #'cdr)
-    (let ((thread-sap (alien-funcall (extern-alien "alloc_thread_struct"
-                                                   (function system-area-pointer
-                                                             system-area-pointer unsigned))
-                                     (or reuse (int-sap 0))
-                                     sb-vm:no-tls-value-marker-widetag)))
-      (when (and (not reuse) (/= (sap-int thread-sap) 0))
-        ;; these would have been done already if reusing the memory
-        ;; of a completed thread.
-        (macrolet ((prot (fun)
-                     `(alien-funcall (extern-alien ,fun (function void int
-                                                                  system-area-pointer))
-                                     1 thread-sap)))
-          (prot "protect_control_stack_guard_page")
-          (prot "protect_binding_stack_guard_page")
-          (prot "protect_alien_stack_guard_page")))
-      (unless (= (sap-int thread-sap) 0) thread-sap))))
+  (let ((corpse (sb-ext:atomic-pop *joinable-threads*)))
+    (when corpse (primitive-join corpse)))
+  ;; If there is more than 1 more joinable, join all but 1.
+  ;; Two threads could both find > 1 thread to join, and both do
+  ;; a join, leaving 0 to join. That's ok.
+  (join-pthread-joinables #'cdr)
+  (let* ((reuse (alien-funcall (extern-alien "get_recyclebin_item"
+                                             (function system-area-pointer))))
+         (thread-sap (alien-funcall (extern-alien "alloc_thread_struct"
+                                                  (function system-area-pointer
+                                                            system-area-pointer unsigned))
+                                    reuse
+                                    sb-vm:no-tls-value-marker-widetag)))
+    (when (and (= (sap-int reuse) 0) (/= (sap-int thread-sap) 0))
+      ;; these would have been done already if reusing pooled memory
+      (macrolet ((prot (fun)
+                   `(alien-funcall (extern-alien ,fun (function void int
+                                                                system-area-pointer))
+                                   1 thread-sap)))
+        (prot "protect_control_stack_guard_page")
+        (prot "protect_binding_stack_guard_page")
+        (prot "protect_alien_stack_guard_page")))
+    (unless (= (sap-int thread-sap) 0) thread-sap)))
 
 (defmacro thread-trampoline-defining-macro (&body body) ; NEW WAY
   `(defun run ()
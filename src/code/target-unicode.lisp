@@ -517,6 +517,12 @@ only characters for which it returns T are collected."
   (etypecase string
     (base-string string)
     ((array character (*))
+     (when (and (not filter)
+                ;; ASCII is in every normalization form.
+                (sb-kernel:with-array-data ((data string) (start) (end) :check-fill-pointer t)
+                  (loop for i from start below end
+                        always (< (char-code (schar data i)) 128))))
+       (return-from normalize-string (subseq string 0)))
      (coerce
       (ecase form
         ((:nfc)
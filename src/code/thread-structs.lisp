@@ -38,7 +38,31 @@
   ;; cast as fixnum when read - avoids consing on 32-bit builds, and also not all of them
   ;; implement RAW-INSTANCE-CAS which would be otherwise needed.
   (%owner 0 :type #+64-bit sb-vm:word
-                  #-64-bit fixnum))
+                  #-64-bit fixnum)
+  ;; Moving average of the number of spins it took to acquire this mutex in
+  ;; %%WAIT-FOR-MUTEX before falling back to sleeping on the futex.
+  #+sb-futex (spins 0 :type sb-vm:word))
+
+;;; A reader-writer lock with writer preference. Readers announce themselves
+;;; in one of several counters, each on its own cache line, chosen by a hash
+;;; of the reading thread, so that concurrent readers don't all write to the
+;;; same line. Writers are serialized by MUTEX.
+(defconstant +rwlock-stripes+ 16)
+(defconstant +rwlock-stripe-words+ (/ 64 sb-vm:n-word-bytes))
+(sb-xc:defstruct (rwlock (:constructor make-rwlock (&key name))
+                         (:copier nil))
+  "Reader-writer lock type."
+  ;; Nonzero while a writer holds or waits for the lock. Readers sleep
+  ;; on this futex word while it is nonzero.
+  (writer 0 :type sb-vm:word)
+  (name nil :type (or null simple-string))
+  ;; Bumped by each reader that leaves while a writer is present, so that
+  ;; a writer waiting for readers to drain can sleep on it.
+  (drain 0 :type sb-vm:word)
+  (readers (make-array (* +rwlock-stripes+ +rwlock-stripe-words+)
+                       :element-type 'sb-vm:word :initial-element 0)
+           :type (simple-array sb-vm:word (*)) :read-only t)
+  (mutex (make-mutex :name "rwlock writer") :type mutex :read-only t))
 
 (sb-xc:defstruct (waitqueue (:copier nil) (:constructor make-waitqueue (&key name)))
   "Waitqueue type."
@@ -159,10 +183,13 @@ in future versions."
 (sb-xc:defstruct (foreign-thread
                   (:copier nil)
                   (:include thread (name "callback"))
-                  (:constructor make-foreign-thread ())
+                  (:constructor make-foreign-thread (&optional kept-attached-p))
                   (:conc-name "THREAD-"))
   "Type of native threads which are attached to the runtime as Lisp threads
-temporarily.")
+temporarily."
+  ;; True if the runtime keeps the thread attached between callbacks,
+  ;; in which case hardly any of its time is spent in Lisp.
+  (kept-attached-p nil :type boolean :read-only t))
 
 (declaim (sb-ext:freeze-type mutex thread))
 #-sb-xc-host
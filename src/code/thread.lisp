@@ -207,6 +207,21 @@ held mutex, WITH-RECURSIVE-LOCK allows recursive lock attempts to succeed."
       ,wait-p
       ,timeout)))
 
+(defmacro with-rwlock-read ((rwlock) &body body)
+  "Acquire RWLOCK for reading for the dynamic scope of BODY. Any number of
+threads can hold it for reading at once, but not while a thread holds it for
+writing. RWLOCK is not recursive: a thread holding it in either mode must not
+try to acquire it again, because a waiting writer takes precedence."
+  `(dx-flet ((with-rwlock-thunk () ,@body))
+     (call-with-rwlock-read #'with-rwlock-thunk ,rwlock)))
+
+(defmacro with-rwlock-write ((rwlock) &body body)
+  "Acquire RWLOCK for writing for the dynamic scope of BODY, waiting until
+no other thread holds it. Threads waiting to write take precedence over
+threads waiting to read."
+  `(dx-flet ((with-rwlock-thunk () ,@body))
+     (call-with-rwlock-write #'with-rwlock-thunk ,rwlock)))
+
 (macrolet ((def (name &optional variant)
              `(defun ,(if variant (symbolicate name "/" variant) name)
                   (function mutex)
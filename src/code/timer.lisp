@@ -24,8 +24,16 @@
 (defun heap-right (i)
   (+ 2 (ash i 1)))
 
-(defun heapify (heap start &key (key #'identity) (test #'>=))
-  (declare (function key test))
+;;; The default POSITION function of the heap operations. A POSITION
+;;; function is called with an item and its new index whenever an item
+;;; is placed in the heap, and with NIL as the index when it is removed,
+;;; so that items can be removed from the middle without searching.
+(defun ignore-heap-position (item index)
+  (declare (ignore item index)))
+
+(defun heapify (heap start &key (key #'identity) (test #'>=)
+                                (position #'ignore-heap-position))
+  (declare (function key test position))
   (flet ((key (obj) (funcall key obj))
          (ge (i j) (funcall test i j)))
     (let ((l (heap-left start))
@@ -43,52 +51,80 @@
         (setf largest r))
       (when (/= largest start)
         (rotatef (aref heap largest) (aref heap start))
-        (heapify heap largest :key key :test test)))
+        (funcall position (aref heap start) start)
+        (funcall position (aref heap largest) largest)
+        (heapify heap largest :key key :test test :position position)))
     heap))
 
-(defun heap-insert (heap new-item &key (key #'identity) (test #'>=))
-  (declare (function key test))
-  (flet ((key (obj) (funcall key obj))
-         (ge (i j) (funcall test i j)))
-    (vector-push-extend nil heap)
-    (loop for i = (1- (length heap)) then parent-i
-          for parent-i = (heap-parent i)
-          while (and (> i 0)
-                     (not (ge (key (aref heap parent-i))
-                              (key new-item))))
-          do (setf (aref heap i) (aref heap parent-i))
-          finally (setf (aref heap i) new-item)
-          (return-from heap-insert i))))
+;;; Store ITEM at index I of HEAP, or further up if it belongs there,
+;;; moving down the items that it goes past. Return its index.
+(defun heap-sift-up (heap i item key test position)
+  (declare (function key test position) (index i))
+  (loop for parent-i = (heap-parent i)
+        while (and (> i 0)
+                   (not (funcall test (funcall key (aref heap parent-i))
+                                 (funcall key item))))
+        do (setf (aref heap i) (aref heap parent-i))
+           (funcall position (aref heap i) i)
+           (setf i parent-i))
+  (setf (aref heap i) item)
+  (funcall position item i)
+  i)
+
+(defun heap-insert (heap new-item &key (key #'identity) (test #'>=)
+                                       (position #'ignore-heap-position))
+  (vector-push-extend nil heap)
+  (heap-sift-up heap (1- (length heap)) new-item key test position))
 
 (defun heap-maximum (heap)
   (unless (zerop (length heap))
     (aref heap 0)))
 
-(defun heap-extract (heap i &key (key #'identity) (test #'>=))
+(defun heap-extract (heap i &key (key #'identity) (test #'>=)
+                                 (position #'ignore-heap-position))
+  (declare (function key test position))
   (unless (> (length heap) i)
     (error "Heap underflow"))
-  (prog1
-      (aref heap i)
-    (setf (aref heap i) (aref heap (1- (length heap))))
-    (decf (fill-pointer heap))
-    (heapify heap i :key key :test test)))
-
-(defun heap-extract-maximum (heap &key (key #'identity) (test #'>=))
-  (heap-extract heap 0 :key key :test test))
+  (let ((item (aref heap i))
+        (last (1- (length heap))))
+    (funcall position item nil)
+    (when (< i last)
+      ;; The last item fills the hole. Coming from another branch,
+      ;; it may belong above it as well as below.
+      (let ((moved (aref heap last)))
+        (decf (fill-pointer heap))
+        (if (and (> i 0)
+                 (not (funcall test (funcall key (aref heap (heap-parent i)))
+                               (funcall key moved))))
+            (heap-sift-up heap i moved key test position)
+            (progn (setf (aref heap i) moved)
+                   (funcall position moved i)
+                   (heapify heap i :key key :test test :position position)))))
+    (when (= i last)
+      (decf (fill-pointer heap)))
+    item))
+
+(defun heap-extract-maximum (heap &key (key #'identity) (test #'>=)
+                                       (position #'ignore-heap-position))
+  (heap-extract heap 0 :key key :test test :position position))
 
 ;;; Priority queue
 
 (defstruct (priority-queue
              (:conc-name %pqueue-)
              (:constructor make-priority-queue
-               (&key ((:key keyfun) #'identity) (element-type t)
+               (&key ((:key keyfun) #'identity)
+                     ((:position positionfun) #'ignore-heap-position)
+                     (element-type t)
                 &aux (contents (make-array 100
                                            :adjustable t
                                            :fill-pointer 0
                                            :element-type element-type))))
              (:copier nil))
-  (contents nil :type vector   :read-only t)
-  (keyfun   nil :type function :read-only t))
+  (contents    nil :type vector   :read-only t)
+  (keyfun      nil :type function :read-only t)
+  ;; Told the index of each item, see IGNORE-HEAP-POSITION
+  (positionfun nil :type function :read-only t))
 (declaim (freeze-type priority-queue))
 
 (defmethod print-object ((object priority-queue) stream)
@@ -105,15 +141,19 @@
 (defun priority-queue-extract-maximum (priority-queue)
   "Remove and return the item in PRIORITY-QUEUE with the largest key."
   (symbol-macrolet ((contents (%pqueue-contents priority-queue))
-                    (keyfun (%pqueue-keyfun priority-queue)))
+                    (keyfun (%pqueue-keyfun priority-queue))
+                    (positionfun (%pqueue-positionfun priority-queue)))
     (unless (zerop (length contents))
-      (heap-extract-maximum contents :key keyfun :test #'<=))))
+      (heap-extract-maximum contents :key keyfun :test #'<=
+                                     :position positionfun))))
 
 (defun priority-queue-insert (priority-queue new-item)
   "Add NEW-ITEM to PRIORITY-QUEUE."
   (symbol-macrolet ((contents (%pqueue-contents priority-queue))
-                    (keyfun (%pqueue-keyfun priority-queue)))
-    (heap-insert contents new-item :key keyfun :test #'<=)))
+                    (keyfun (%pqueue-keyfun priority-queue))
+                    (positionfun (%pqueue-positionfun priority-queue)))
+    (heap-insert contents new-item :key keyfun :test #'<=
+                                   :position positionfun)))
 
 (defun priority-queue-empty-p (priority-queue)
   (zerop (length (%pqueue-contents priority-queue))))
@@ -124,9 +164,18 @@
                     (keyfun (%pqueue-keyfun priority-queue)))
     (let ((i (position item contents :test test)))
       (when i
-        (heap-extract contents i :key keyfun :test #'<=)
+        (priority-queue-remove-at priority-queue i)
         i))))
 
+(defun priority-queue-remove-at (priority-queue i)
+  "Remove and return the item at index I of PRIORITY-QUEUE, as told to
+its POSITION function."
+  (symbol-macrolet ((contents (%pqueue-contents priority-queue))
+                    (keyfun (%pqueue-keyfun priority-queue))
+                    (positionfun (%pqueue-positionfun priority-queue)))
+    (heap-extract contents i :key keyfun :test #'<=
+                             :position positionfun)))
+
 ;;; timers
 
 (defstruct (timer
@@ -144,7 +193,9 @@ future versions."
   (catch-up           nil :type boolean)
   (thread             nil :type (or sb-thread:thread boolean))
   (interrupt-function nil :type (or null function))
-  (cancel-function    nil :type (or null function)))
+  (cancel-function    nil :type (or null function))
+  ;; The index of this timer in *SCHEDULE*, or NIL if it isn't there
+  (schedule-index     nil :type (or null index)))
 (declaim (freeze-type timer))
 
 (defmethod print-object ((timer timer) stream)
@@ -194,7 +245,20 @@ from now. For timers with a repeat interval it returns true."
 (defun under-scheduler-lock-p ()
   (sb-thread:holding-mutex-p *scheduler-lock*))
 
-(define-load-time-global *schedule* (make-priority-queue :key #'%timer-expire-time))
+;;; Each timer knows its index, so that it can be unscheduled in
+;;; logarithmic rather than linear time.
+(define-load-time-global *schedule*
+    (make-priority-queue :key #'%timer-expire-time
+                         :position (lambda (timer index)
+                                     (setf (%timer-schedule-index timer) index))))
+
+;;; Remove TIMER from *SCHEDULE* and return its index, or return NIL if
+;;; it wasn't there
+(defun unschedule-timer-index (timer)
+  (let ((index (%timer-schedule-index timer)))
+    (when index
+      (priority-queue-remove-at *schedule* index)
+      index)))
 
 (defun peek-schedule ()
   (priority-queue-maximum *schedule*))
@@ -235,7 +299,7 @@ from now. For timers with a repeat interval it returns true."
 
 (defun %schedule-timer (timer)
   (let ((changed-p nil)
-        (old-position (priority-queue-remove *schedule* timer)))
+        (old-position (unschedule-timer-index timer)))
     ;; Make sure interruptors are cancelled even if this timer was
     ;; scheduled again since our last attempt.
     (when old-position
@@ -296,7 +360,7 @@ triggers."
   (with-scheduler-lock ()
     (setf (%timer-expire-time timer) nil
           (%timer-repeat-interval timer) nil)
-    (let ((old-position (priority-queue-remove *schedule* timer)))
+    (let ((old-position (unschedule-timer-index timer)))
       ;; Don't use cancel-function as the %timer-cancel-function
       ;; may have changed before we got the scheduler lock.
       (when old-position
@@ -173,7 +173,11 @@
   "Find roots keeping the targets of WEAK-POINTERS alive.
 
 WEAK-POINTERS must be a single SB-EXT:WEAK-POINTER or a list of those,
-pointing to objects for which roots should be searched.
+pointing to objects for which roots should be searched. Passing many
+weak pointers at once is much faster than one at a time, since the heap
+is scanned only once. A path that reaches an object on a path already
+found for another target is completed from that path, so it is not
+necessarily the shortest one.
 
 GC controls whether the search is performed in the context of a
 garbage collection, that is with all Lisp threads stopped. Possible
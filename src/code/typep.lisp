@@ -259,10 +259,17 @@
     ;; FIXME: if LAYOUT is for a structure, use the STRUCTURE-IS-A test
     ;; which avoids iterating.
     (or (eq obj-layout layout)
-        (let ((obj-inherits (wrapper-inherits obj-layout)))
-          (dotimes (i (length obj-inherits) nil)
-            (when (eq (svref obj-inherits i) layout)
-              (return t)))))))
+        (let ((obj-inherits (wrapper-inherits obj-layout))
+              (depth (length (wrapper-inherits layout))))
+          ;; The inherits of a class are its ancestors from the root
+          ;; down, so from a class down a chain of single inheritance,
+          ;; it comes right after its own ancestors: that is the place
+          ;; to look first. Mixins shift it further along.
+          (or (and (< depth (length obj-inherits))
+                   (eq (svref obj-inherits depth) layout))
+              (dotimes (i (length obj-inherits) nil)
+                (when (eq (svref obj-inherits i) layout)
+                  (return t))))))))
 
 (declaim (end-block))
 
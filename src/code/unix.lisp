@@ -348,6 +348,20 @@ corresponds to NAME, or NIL if there is none."
       (system-area-pointer
        (%write buf)))))
 
+;;; UNIX-WRITEV writes the N buffers described by the array of
+;;; (struct iovec) at IOV in one system call, returning the number of
+;;; bytes written.
+#-win32
+(progn
+  (define-alien-type nil
+      (struct iovec
+              (iov-base system-area-pointer)
+              (iov-len  size-t)))
+
+  (defun unix-writev (fd iov n)
+    (declare (type unix-fd fd) (type index n))
+    (int-syscall ("writev" int system-area-pointer int) fd iov n)))
+
 ;;; Set up a unix-piping mechanism consisting of an input pipe and an
 ;;; output pipe. Return two values: if no error occurred the first
 ;;; value is the pipe to be read from and the second is can be written
@@ -646,6 +660,44 @@ avoiding atexit(3) hooks, etc. Otherwise exit(2) is called."
                     (logtest pollhup revents)))
               (error "Syscall poll(2) failed: ~A" (strerror))))))))
 
+;;;; sys/epoll.h
+;;;
+;;; These go through wrappers in wrap.c, which take care of the layout of
+;;; 'struct epoll_event'. Event masks have bit 0 for input and bit 1 for
+;;; output.
+#+linux
+(progn
+  (defun unix-epoll-create ()
+    (int-syscall ("sb_epoll_create")))
+
+  ;; Return 0 on success, and 1 if FD can't be waited on by epoll
+  (defun unix-epoll-set (epfd fd events)
+    (declare (type unix-fd epfd fd) (type (mod 4) events))
+    (int-syscall ("sb_epoll_set" int int int) epfd fd events))
+
+  (declaim (inline unix-epoll-wait))
+  (defun unix-epoll-wait (epfd fds events max to-msec)
+    (declare (type unix-fd epfd) (fixnum max to-msec))
+    (when (and (minusp to-msec) (not *interrupts-enabled*))
+      (note-dangerous-wait "epoll_wait(2)"))
+    (int-syscall ("sb_epoll_wait" int (* int) (* int) int int)
+                 epfd fds events max to-msec)))
+
+;;; Have the kernel move up to LEN bytes from IN to OUT, by
+;;; copy_file_range() if HOW is 0, sendfile() if 1, or splice() if 2.
+;;; Return the count, or NIL and the errno, or :UNSUPPORTED if that way
+;;; can't be used with these descriptors.
+#+linux
+(defun unix-copy-fd-range (in out len how)
+  (declare (type unix-fd in out) (type (unsigned-byte 30) len) (type (mod 3) how))
+  (let ((result (alien-funcall (extern-alien "sb_copy_fd_range"
+                                             (function int int int int int))
+                               in out len how)))
+    (case result
+      (-2 :unsupported)
+      (-1 (values nil (get-errno)))
+      (t result))))
+
 ;;;; sys/select.h
 
 (defmacro with-fd-setsize ((n) &body body)
@@ -797,6 +849,9 @@ avoiding atexit(3) hooks, etc. Otherwise exit(2) is called."
         ((1) t)
         ((0) nil)
         (otherwise
+         ;; Interrupted, which WITH-RESTARTED-SYSCALL doesn't retry on
+         ;; win32. The caller waits again.
+         #+win32 (when (eql errno eintr) (return-from unix-simple-poll nil))
          (error "Syscall select(2) failed on fd ~D: ~A" fd (strerror)))))))
 
 ;;;; sys/stat.h
@@ -895,6 +950,57 @@ avoiding atexit(3) hooks, etc. Otherwise exit(2) is called."
                 fd (addr buf))))
    fd))
 
+;;; The stat(2) family again, storing the fields into a vector of at
+;;; least STAT-WORDS (UNSIGNED-BYTE 64) at the indices below rather than
+;;; returning them, for callers that stat many files and don't want to
+;;; cons for each. NAME can be a string, which is encoded as for
+;;; C-STRING, or a NUL-terminated octet vector, which is passed as is.
+;;; Times are in seconds and nanoseconds since the epoch, the seconds in
+;;; two's complement.
+#-win32
+(progn
+(defconstant stat-words 16)
+(macrolet ((def (&rest names)
+             `(progn ,@(loop for name in names for i from 0
+                             collect `(defconstant ,name ,i)))))
+  (def stat-word-dev stat-word-ino stat-word-mode stat-word-nlink
+       stat-word-uid stat-word-gid stat-word-rdev stat-word-size
+       stat-word-blksize stat-word-blocks
+       stat-word-atime stat-word-atime-nsec stat-word-mtime stat-word-mtime-nsec
+       stat-word-ctime stat-word-ctime-nsec))
+
+(declaim (inline check-stat-words))
+(defun check-stat-words (buffer)
+  (declare (type (simple-array (unsigned-byte 64) (*)) buffer))
+  (when (< (length buffer) stat-words)
+    (error "~S is shorter than ~D words." buffer stat-words)))
+
+(macrolet ((def (name c-name)
+             `(defun ,name (name buffer)
+                (declare (type (or unix-pathname (simple-array (unsigned-byte 8) (*)))
+                               name)
+                         (type (simple-array (unsigned-byte 64) (*)) buffer))
+                (check-stat-words buffer)
+                (let ((name (if (stringp name)
+                                (sb-alien::string-to-c-string
+                                 name (sb-alien::default-c-string-external-format))
+                                name)))
+                  (unless (find 0 name)
+                    (error "~S is not NUL-terminated." name))
+                  (with-pinned-objects (name buffer)
+                    (syscall (,c-name system-area-pointer system-area-pointer)
+                             t (vector-sap name) (vector-sap buffer)))))))
+  (def unix-stat-words "stat_words")
+  (def unix-lstat-words "lstat_words"))
+
+(defun unix-fstat-words (fd buffer)
+  (declare (type unix-fd fd)
+           (type (simple-array (unsigned-byte 64) (*)) buffer))
+  (check-stat-words buffer)
+  (with-pinned-objects (buffer)
+    (syscall ("fstat_words" int system-area-pointer)
+             t fd (vector-sap buffer)))))
+
 #-win32
 (defun fd-type (fd)
   (declare (type unix-fd fd))
@@ -935,6 +1041,10 @@ avoiding atexit(3) hooks, etc. Otherwise exit(2) is called."
   ;; KLUDGE: the runtime `boolean' is defined as `int', but the alien
   ;; type is N-WORD-BITS wide.
   (daylight-savings-p (boolean 32) :out))
+;;; GET-TIMEZONE reads the zone once, and again only when TZ changes.
+;;; Call this after the file of the zone, or /etc/localtime, changes.
+#-win32
+(define-alien-routine ("reset_timezone_cache" reset-timezone-cache) void)
 #-win32
 (defun nanosleep (secs nsecs)
   (alien-funcall (extern-alien "sb_nanosleep" (function int time-t int))
@@ -1053,7 +1163,7 @@ avoiding atexit(3) hooks, etc. Otherwise exit(2) is called."
     (declare (type (signed-byte 32) clockid))
     (with-alien ((ts (struct timespec)))
       (alien-funcall (extern-alien #.(libc-name-for "sb_clock_gettime")
-                                   (function int int (* (struct timespec))))
+                                   (function (:leaf int) int (* (struct timespec))))
                      clockid (addr ts))
       ;; 'seconds' is definitely a fixnum for 64-bit, because most-positive-fixnum
       ;; can express 1E11 years in seconds.
@@ -1061,6 +1171,18 @@ avoiding atexit(3) hooks, etc. Otherwise exit(2) is called."
               #-64-bit (slot ts 'tv-sec)
               (truly-the (integer 0 #.(expt 10 9)) (slot ts 'tv-nsec)))))
 
+  (declaim (inline get-monotonic-nanoseconds))
+  (defun get-monotonic-nanoseconds ()
+    "Return the number of nanoseconds since an arbitrary point in the past, from
+a clock which is not affected by changes to the system time. On 64-bit
+platforms the result is a fixnum, and this does not cons."
+    (multiple-value-bind (sec nsec) (clock-gettime clock-monotonic)
+      #+64-bit
+      (locally (declare (optimize (sb-c::type-check 0)))
+        (the fixnum (+ (the fixnum (* sec 1000000000)) nsec)))
+      #-64-bit
+      (+ (* sec 1000000000) nsec)))
+
   (declaim (inline get-time-of-day))
   (defun get-time-of-day ()
     "Return the number of seconds and microseconds since the beginning of
@@ -1151,7 +1273,7 @@ the UNIX epoch (January 1st 1970.)"
   (multiple-value-bind (sec usec) (get-time-of-day)
     (values t sec usec nil nil)))
 
-;;;; opendir, readdir, closedir, and dirent-name
+;;;; opendir, readdir, readdir-batch, closedir, and dirent-name
 
 (declaim (inline unix-opendir))
 (defun unix-opendir (namestring &optional (errorp t))
@@ -1181,6 +1303,27 @@ the UNIX epoch (January 1st 1970.)"
            :errno errno))
         ent)))
 
+#-win32
+(progn
+;;; Fill BUFFER, an (UNSIGNED-BYTE 8) vector, with entries read from
+;;; DIR as sb_readdir_batch does, and return the number of octets used,
+;;; which is 0 at the end of the directory, or NIL on error.
+(declaim (inline unix-readdir-batch))
+(defun unix-readdir-batch (dir buffer &optional (errorp t) namestring)
+  (declare (type (simple-array (unsigned-byte 8) (*)) buffer))
+  (let ((n (with-pinned-objects (buffer)
+             (alien-funcall
+              (extern-alien "sb_readdir_batch"
+                            (function int system-area-pointer
+                                      system-area-pointer int))
+              dir (vector-sap buffer) (length buffer)))))
+    (if (minusp n)
+        (when errorp
+          (simple-perror
+           (format nil "Error reading directory entries~@[ from ~S~]"
+                   namestring)))
+        n))))
+
 (declaim (inline unix-closedir))
 (defun unix-closedir (dir &optional (errorp t) namestring)
   (let ((r (alien-funcall
@@ -399,6 +399,9 @@
                   (addr system-time)))
        epoch)))
 
+(defun get-monotonic-nanoseconds ()
+  (* (get-internal-real-time) 100ns-per-internal-time-unit 100))
+
 (declaim (inline system-internal-run-time))
 (defun system-internal-run-time ()
   (with-process-times (creation-time exit-time kernel-time user-time)
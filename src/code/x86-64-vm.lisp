@@ -389,6 +389,25 @@
 (define-load-time-global *static-linker-lock* (sb-thread:make-mutex :name "static linker"))
 
 (define-load-time-global *never-statically-link* '(find-package))
+
+;;; A weak hash table from each FDEFN whose static callers were unlinked
+;;; because it was redefined to the INTERNAL-REAL-TIME of the last time,
+;;; made by REMOVE-STATIC-LINKS when first needed.
+(define-load-time-global *static-unlink-times* nil)
+;;; While this is a number of seconds, STATICALLY-LINK-CODE-OBJ leaves alone
+;;; the calls through fdefns that were unlinked less than that long ago, so
+;;; that a function being redefined over and over isn't relinked each time.
+(defvar *static-link-quiet-period* nil)
+
+(defun recently-unlinked-p (fdefn)
+  (let ((period *static-link-quiet-period*)
+        (times *static-unlink-times*))
+    (when (and period times)
+      (let ((time (gethash fdefn times)))
+        (and time
+             (< (- (get-internal-real-time) time)
+                (* period internal-time-units-per-second)))))))
+
 ;;; Remove calls via fdefns from CODE. This is called after compiling
 ;;; to memory, or when saving a core.
 ;;; Do not replace globally notinline functions, because notinline has
@@ -422,7 +441,8 @@
         (when (and (immobile-space-obj-p fun)
                    (not (fun-requires-simplifying-trampoline-p fun))
                    (not (member (fdefn-name fdefn) *never-statically-link* :test 'equal))
-                   (neq (info :function :inlinep (fdefn-name fdefn)) 'notinline))
+                   (neq (info :function :inlinep (fdefn-name fdefn)) 'notinline)
+                   (not (recently-unlinked-p fdefn)))
           (setf any-replacements t (aref replacements i) fun))))
     (dotimes (i fdefns-count)
       (when (and (aref replacements i)
@@ -469,9 +489,13 @@
                 ;; Change the machine instruction
                 ;; %CLOSURE-CALLEE reads the entry addresss word of any
                 ;; kind of function, but as if it were a tagged fixnum.
+                ;; The code may be running already when it is relinked, so
+                ;; the displacement is swapped in atomically as by
+                ;; REMOVE-STATIC-LINKS.
                 (let ((entry (descriptor-sap (%closure-callee fun))))
-                  (setf (signed-sap-ref-32 insts offset)
-                        (sap- entry (sap+ insts (+ offset 4))))))))
+                  (cas (sap-ref-32 insts offset)
+                       (sap-ref-32 insts offset)
+                       (ldb (byte 32 0) (sap- entry (sap+ insts (+ offset 4)))))))))
           ;; Replace ambiguous elements of the code header while still holding the lock
           (dotimes (i fdefns-count)
             (when (= (bit ambiguous i) 1)
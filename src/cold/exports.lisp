@@ -97,9 +97,18 @@ interface stability.")
    "UNIX-ISATTY" "UNIX-LSEEK" "UNIX-LSTAT" "UNIX-MKDIR"
    "UNIX-OPEN" "UNIX-OPENDIR" "UNIX-PATHNAME" "UNIX-PID"
    "UNIX-PIPE" "UNIX-POLL" "UNIX-SIMPLE-POLL"
+   "UNIX-EPOLL-CREATE" "UNIX-EPOLL-SET" "UNIX-EPOLL-WAIT"
+   "UNIX-COPY-FD-RANGE"
    "UNIX-READ" "UNIX-READDIR" "UNIX-READLINK" "UNIX-REALPATH"
    "UNIX-RENAME" "UNIX-SELECT" "UNIX-STAT" "UNIX-UID"
-   "UNIX-UNLINK" "UNIX-WRITE"
+   "UNIX-STAT-WORDS" "UNIX-LSTAT-WORDS" "UNIX-FSTAT-WORDS"
+   "STAT-WORDS" "STAT-WORD-DEV" "STAT-WORD-INO" "STAT-WORD-MODE"
+   "STAT-WORD-NLINK" "STAT-WORD-UID" "STAT-WORD-GID" "STAT-WORD-RDEV"
+   "STAT-WORD-SIZE" "STAT-WORD-BLKSIZE" "STAT-WORD-BLOCKS"
+   "STAT-WORD-ATIME" "STAT-WORD-ATIME-NSEC" "STAT-WORD-MTIME"
+   "STAT-WORD-MTIME-NSEC" "STAT-WORD-CTIME" "STAT-WORD-CTIME-NSEC"
+   "UNIX-UNLINK" "UNIX-WRITE" "UNIX-WRITEV"
+   "IOVEC" "IOV-BASE" "IOV-LEN"
    "WCONTINUED" "WNOHANG" "WUNTRACED"
    "W_OK" "X_OK"
    "SC-NPROCESSORS-ONLN"
@@ -439,6 +448,7 @@ structure representations")
            "GENCGC-PAGE-BYTES"
            "GENCGC-ALLOC-GRANULARITY"
            "GENCGC-RELEASE-GRANULARITY"
+           #+gencgc "GC-CENSUS" #+gencgc "GC-CENSUS-ENABLED"
            #+(or arm64 ppc ppc64 sparc riscv) "PSEUDO-ATOMIC-INTERRUPTED-FLAG"
            #+(or arm64 ppc ppc64 sparc riscv) "PSEUDO-ATOMIC-FLAG"
            #+sb-safepoint "GLOBAL-SAFEPOINT-TRAP"
@@ -721,6 +731,7 @@ like *STACK-TOP-HINT* and unsupported stuff like *TRACED-FUN-LIST*.")
            "INTERNAL-DEBUG" "VAR"
            "*STACK-TOP-HINT*"
            "*TRACE-ENCAPSULATE-DEFAULT*"
+           "*TRACE-BUFFER-LENGTH*" "TRACE-BUFFER-EVENTS"
            "FRAME-HAS-DEBUG-TAG-P"
            "UNWIND-TO-FRAME-AND-CALL"
            ;; Deprecated
@@ -761,6 +772,8 @@ like *STACK-TOP-HINT* and unsupported stuff like *TRACED-FUN-LIST*.")
    "ATOMIC-UPDATE"
    "ATOMIC-PUSH"
    "ATOMIC-POP"
+   "ATOMIC-EXCHANGE"
+   "ATOMIC-LOAD"
    "WORD"
    "MOST-POSITIVE-WORD"
 
@@ -775,16 +788,18 @@ like *STACK-TOP-HINT* and unsupported stuff like *TRACED-FUN-LIST*.")
    ;; Time related things
 
    "CALL-WITH-TIMING"
+   "GET-MONOTONIC-NANOSECONDS"
    "GET-TIME-OF-DAY"
 
    ;; People have various good reasons to mess with the GC.
 
    "HEAP-ALLOCATED-P"
    "STACK-ALLOCATED-P"
-   "*AFTER-GC-HOOKS*"
+   "*AFTER-GC-HOOKS*" "*MEMORY-PRESSURE-HOOKS*"
    "BYTES-CONSED-BETWEEN-GCS"
    "GC" "GET-BYTES-CONSED"
    "*GC-RUN-TIME*"
+   "GC-PAUSE-HISTOGRAM" "GC-STOP-OFFENDERS"
    "PURIFY"
    "DYNAMIC-SPACE-SIZE"
    ;; Gencgc only, but symbols exist for manual building
@@ -796,7 +811,10 @@ like *STACK-TOP-HINT* and unsupported stuff like *TRACED-FUN-LIST*.")
    "GENERATION-MINIMUM-AGE-BEFORE-GC"
    "GENERATION-NUMBER-OF-GCS"
    "GENERATION-NUMBER-OF-GCS-BEFORE-PROMOTION"
+   "SOFT-HEAP-LIMIT"
    "GC-LOGFILE"
+   "WRITE-HEAP-DUMP"
+   "ARENA" "ARENA-P" "MAKE-ARENA" "DESTROY-ARENA" "REWIND-ARENA" "WITH-ARENA"
 
    ;; Stack allocation control
 
@@ -823,6 +841,19 @@ like *STACK-TOP-HINT* and unsupported stuff like *TRACED-FUN-LIST*.")
 
    "*COMPILE-PROGRESS*"
 
+   ;; Compiling independent files in several threads at once.
+
+   "COMPILE-FILES-IN-PARALLEL"
+
+   ;; Loading files in order while other threads read ahead.
+
+   "LOAD-FILES"
+
+   ;; Compiling cheaply at first, and again at full policy once the
+   ;; result has been called often enough.
+
+   "*TIERED-COMPILE-THRESHOLD*"
+
    ;; The default behavior for block compilation.
 
    "*BLOCK-COMPILE-DEFAULT*"
@@ -1586,6 +1617,7 @@ SB-KERNEL) have been undone, but probably more remain.")
    "BREAKPOINT-ERROR"
    "CANCEL-DEADLINE"
    "CLOSE-SHARED-OBJECTS"
+   "COPY-STREAM"
    "DEADLINE-TIMEOUT"
    "DEALLOCATE-SYSTEM-MEMORY"
    "DECODE-TIMEOUT"
@@ -1613,6 +1645,7 @@ SB-KERNEL) have been undone, but probably more remain.")
    "MACRO" "MAKE-FD-STREAM"
    "MEMORY-FAULT-ERROR"
    "MEMMOVE"
+   #+x86-64 "BULK-COPY" #+x86-64 "BULK-FILL-WORDS"
    "NLX-PROTECT"
    "OS-EXIT"
    "OS-COLD-INIT-OR-REINIT" "OS-DEINIT"
@@ -1647,7 +1680,8 @@ SB-KERNEL) have been undone, but probably more remain.")
    "WITH-INTERRUPTS" "WITH-LOCAL-INTERRUPTS"
    "WITH-PINNED-OBJECTS" "WITHOUT-GCING"
    "WITHOUT-INTERRUPTS"
-   "WITH-INTERRUPT-BINDINGS"))
+   "WITH-INTERRUPT-BINDINGS"
+   "WRITE-OUTPUT-STREAM-STRING"))
 
 (defpackage* "SB-ALIEN"
   (:documentation "public: the ALIEN foreign function interface (If you're
@@ -1818,6 +1852,7 @@ is a good idea, but see SB-SYS re. blurring of boundaries.")
            "%ARRAY-RANK" "%ARRAY-RANK="
            "SIMPLE-ARRAY-HEADER-OF-RANK-P"
            "%ARRAY-ATOMIC-INCF/WORD"
+           #+x86-64 "%ARRAY-ATOMIC-INCF/UB32" #+x86-64 "%ARRAY-ATOMIC-INCF/FIXNUM"
            "%ASH/RIGHT"
            "%ASSOC"
            "%ASSOC-EQ"
@@ -1917,6 +1952,10 @@ is a good idea, but see SB-SYS re. blurring of boundaries.")
            "%RASSOC-TEST"
            "%RASSOC-TEST-NOT"
            "%VECTOR-RAW-BITS"
+           #+x86-64 "%VECTOR-CAS/WORD" #+x86-64 "%VECTOR-CAS/UB32"
+           #+x86-64 "%VECTOR-CAS/FIXNUM"
+           #+x86-64 "%VECTOR-XCHG/WORD" #+x86-64 "%VECTOR-XCHG/UB32"
+           #+x86-64 "%VECTOR-XCHG/FIXNUM"
            "%SCALB" "%SCALBN"
            "%RAW-INSTANCE-ATOMIC-INCF/WORD"
            "%RAW-INSTANCE-CAS/WORD" "%RAW-INSTANCE-XCHG/WORD"
@@ -2415,6 +2454,10 @@ is a good idea, but see SB-SYS re. blurring of boundaries.")
            "%BIT-POSITION" "%BIT-POS-FWD" "%BIT-POS-REV"
            "%BIT-POSITION/0" "%BIT-POS-FWD/0" "%BIT-POS-REV/0"
            "%BIT-POSITION/1" "%BIT-POS-FWD/1" "%BIT-POS-REV/1"
+           ;; counting bits, and bit-wise operations by the C runtime
+           "%BIT-COUNT" "%BIT-VECTOR-OP"
+           ;; and for octets in octet vectors and base-strings
+           "%OCTET-POSITION" "%OCTET-POS-FWD" "%OCTET-POS-REV"
 
            ;; SIMPLE-FUN type and accessors
 
@@ -2777,6 +2820,17 @@ is a good idea, but see SB-SYS re. blurring of boundaries.")
            "RELEASE-MUTEX"
            "WITH-MUTEX"
            "WITH-RECURSIVE-LOCK"
+           ;; Reader-writer locks
+
+           "GRAB-RWLOCK-READ"
+           "GRAB-RWLOCK-WRITE"
+           "MAKE-RWLOCK"
+           "RELEASE-RWLOCK-READ"
+           "RELEASE-RWLOCK-WRITE"
+           "RWLOCK"
+           "RWLOCK-NAME"
+           "WITH-RWLOCK-READ"
+           "WITH-RWLOCK-WRITE"
            ;; Condition variables
 
            "CONDITION-BROADCAST"
@@ -718,7 +718,13 @@
               (reference-tn-list (remove-if-not #'tn-p (flatten-list arg-tns)) nil))
              (result-operands
               (reference-tn-list (remove-if-not #'tn-p result-tns) t)))
-        (cond #+#.(cl:if (sb-c::vop-existsp :named sb-vm::call-out-named) '(and) '(or))
+        (cond #+#.(cl:if (sb-c::vop-existsp :named sb-vm::call-out-named-leaf) '(and) '(or))
+              ((and (constant-lvar-p function) (stringp (lvar-value function))
+                    (sb-alien::alien-fun-type-leaf type))
+               (vop* call-out-named-leaf call block (arg-operands) (result-operands)
+                     (lvar-value function)
+                     (sb-alien::alien-fun-type-varargs type)))
+              #+#.(cl:if (sb-c::vop-existsp :named sb-vm::call-out-named) '(and) '(or))
               ((and (constant-lvar-p function) (stringp (lvar-value function)))
                (vop* call-out-named call block (arg-operands) (result-operands)
                      (lvar-value function)
@@ -577,13 +577,16 @@
                                other-pointer-lowtag))
     (inst add lip object offset)
 
-    (inst dsb)
-    LOOP
-    (inst ldxr result lip)
-    (inst add sum result diff)
-    (inst stlxr tmp-tn sum lip)
-    (inst cbnz tmp-tn LOOP)
-    (inst dmb)))
+    (choose-atomics
+     (inst ldaddal diff result lip)
+     (assemble ()
+       (inst dmb :ish)
+       LOOP
+       (inst ldxr result lip)
+       (inst add sum result diff)
+       (inst stlxr tmp-tn sum lip)
+       (inst cbnz tmp-tn LOOP)
+       (inst dmb :ish)))))
 
 (define-vop (array-atomic-incf/word-v8.1)
   (:translate %array-atomic-incf/word)
@@ -41,21 +41,20 @@
   (:results (result :scs (descriptor-reg any-reg) :from :load))
   (:generator 5
     (inst add-sub lip object (- (* offset n-word-bytes) lowtag))
-    (cond ((member :arm-v8.1 *backend-subfeatures*)
-           (move result old)
-           (inst casal result new lip))
-          (t
-           (assemble ()
-             (inst dsb)
-             LOOP
-             (inst ldxr result lip)
-             (inst cmp result old)
-             (inst b :ne EXIT)
-             (inst stlxr tmp-tn new lip)
-             (inst cbnz tmp-tn LOOP)
-             EXIT
-             (inst clrex)
-             (inst dmb))))))
+    (choose-atomics
+     (progn (move result old)
+            (inst casal result new lip))
+     (assemble ()
+       (inst dmb :ish)
+       LOOP
+       (inst ldxr result lip)
+       (inst cmp result old)
+       (inst b :ne EXIT)
+       (inst stlxr tmp-tn new lip)
+       (inst cbnz tmp-tn LOOP)
+       EXIT
+       (inst clrex)
+       (inst dmb :ish)))))
 
 ;;;; Symbol hacking VOPs:
 
@@ -242,7 +241,6 @@
   (:policy :fast-safe)
   (:vop-var vop)
   (:generator 15
-    (inst dsb)
     #+sb-thread
     (assemble ()
       (inst ldr (32-bit-reg tls-index) (tls-index-of symbol))
@@ -257,18 +255,22 @@
       (inst b :ne CHECK-UNBOUND))
     (inst add-sub lip symbol (- (* symbol-value-slot n-word-bytes)
                                 other-pointer-lowtag))
-    LOOP
-    (inst ldxr result lip)
-    (inst cmp result old)
-    (inst b :ne CLEAR)
-    (inst stlxr tmp-tn new lip)
-    (inst cbnz tmp-tn LOOP)
-
-    CLEAR
-    (inst clrex)
+    (choose-atomics
+     (progn (move result old)
+            (inst casal result new lip))
+     (assemble ()
+       (inst dmb :ish)
+       LOOP
+       (inst ldxr result lip)
+       (inst cmp result old)
+       (inst b :ne CLEAR)
+       (inst stlxr tmp-tn new lip)
+       (inst cbnz tmp-tn LOOP)
+       CLEAR
+       (inst clrex)
+       (inst dmb :ish)))
 
     CHECK-UNBOUND
-    (inst dmb)
     (inst cmp result unbound-marker-widetag)
     (inst b :eq (generate-error-code vop 'unbound-symbol-error symbol))))
 
@@ -672,13 +674,16 @@
                             n-word-bytes)
                          instance-pointer-lowtag))
 
-    (inst dsb)
-    LOOP
-    (inst ldxr result lip)
-    (inst add sum result diff)
-    (inst stlxr tmp-tn sum lip)
-    (inst cbnz tmp-tn LOOP)
-    (inst dmb)))
+    (choose-atomics
+     (inst ldaddal diff result lip)
+     (assemble ()
+       (inst dmb :ish)
+       LOOP
+       (inst ldxr result lip)
+       (inst add sum result diff)
+       (inst stlxr tmp-tn sum lip)
+       (inst cbnz tmp-tn LOOP)
+       (inst dmb :ish)))))
 
 (define-vop (raw-instance-atomic-incf/word-v8.1)
   (:translate %raw-instance-atomic-incf/word)
@@ -321,8 +321,10 @@
            (load-symbol-value ,flag-tn *pseudo-atomic-interrupted*))
          #+sb-thread
          (progn
+           ;; The stores that initialize the object must be seen by other
+           ;; threads before any store that publishes it.
            (when ,sync
-            (inst dmb))
+            (inst dmb :ishst))
            (inst str (32-bit-reg zr-tn)
                  (@ thread-tn
                     (* n-word-bytes thread-pseudo-atomic-bits-slot)))
@@ -334,6 +336,27 @@
            (inst brk pending-interrupt-trap)
            (emit-label not-interrputed))))))
 
+;;; Emit LSE, the single-instruction atomics of ARMv8.1, where the target
+;;; is known to have them. Otherwise emit both LSE and LL/SC, the
+;;; load-exclusive/store-exclusive loop that every ARMv8 has, choosing
+;;; between them by "lse_atomics_supported", which the runtime sets at
+;;; startup. The test clobbers TMP-TN, which LL/SC uses as its status
+;;; register anyway.
+(defmacro choose-atomics (lse ll/sc)
+  `(if (member :arm-v8.1 *backend-subfeatures*)
+       ,lse
+       (let ((ll/sc (gen-label))
+             (done (gen-label)))
+         (load-inline-constant tmp-tn '(:fixup "lse_atomics_supported" :foreign-dataref))
+         (inst ldr tmp-tn (@ tmp-tn))
+         (inst ldr (32-bit-reg tmp-tn) (@ tmp-tn)) ; 4-byte int
+         (inst cbz (32-bit-reg tmp-tn) ll/sc)
+         ,lse
+         (inst b done)
+         (emit-label ll/sc)
+         ,ll/sc
+         (emit-label done))))
+
 ;;;; memory accessor vop generators
 
 (defmacro define-full-reffer (name type offset lowtag scs el-type
@@ -46,22 +46,22 @@
   (:generator 5
     (inst add lip object (lsl index (- word-shift n-fixnum-tag-bits)))
     (inst add-sub lip lip (- (* offset n-word-bytes) lowtag))
-    (cond ((member :arm-v8.1 *backend-subfeatures*)
-           (move result old-value)
-           (inst casal result new-value lip))
-          (t
-           (assemble ()
-             (inst dsb)
-             LOOP
-             ;; If this were 'ldaxr' instead of 'ldxr' maybe we wouldn't need the 'dsb' ?
-             (inst ldxr result lip)
-             (inst cmp result old-value)
-             (inst b :ne EXIT)
-             (inst stlxr tmp-tn new-value lip)
-             (inst cbnz (32-bit-reg tmp-tn) LOOP)
-             EXIT
-             (inst clrex)
-             (inst dmb))))))
+    (choose-atomics
+     (progn (move result old-value)
+            (inst casal result new-value lip))
+     (assemble ()
+       ;; An ordering barrier is enough around the loop, as with CASAL:
+       ;; nothing here waits for memory accesses to complete, as DSB would
+       (inst dmb :ish)
+       LOOP
+       (inst ldxr result lip)
+       (inst cmp result old-value)
+       (inst b :ne EXIT)
+       (inst stlxr tmp-tn new-value lip)
+       (inst cbnz (32-bit-reg tmp-tn) LOOP)
+       EXIT
+       (inst clrex)
+       (inst dmb :ish)))))
 
 (define-vop (set-instance-hashed)
   (:args (object :scs (descriptor-reg)))
@@ -69,12 +69,12 @@
   (:temporary (:sc unsigned-reg) baseptr header)
   (:generator 5
     (inst sub baseptr object instance-pointer-lowtag)
-    LOOP
-    (cond ((member :arm-v8.1 *backend-subfeatures*)
-           (inst movz header (ash 1 stable-hash-required-flag))
-           (inst ldset header header baseptr))
-          (t
-           (inst ldaxr header baseptr)
-           (inst orr header header (ash 1 stable-hash-required-flag))
-           (inst stlxr tmp-tn header baseptr)
-           (inst cbnz (32-bit-reg tmp-tn) LOOP)))))
+    (choose-atomics
+     (progn (inst movz header (ash 1 stable-hash-required-flag))
+            (inst ldset header header baseptr))
+     (assemble ()
+       LOOP
+       (inst ldaxr header baseptr)
+       (inst orr header header (ash 1 stable-hash-required-flag))
+       (inst stlxr tmp-tn header baseptr)
+       (inst cbnz (32-bit-reg tmp-tn) LOOP)))))
@@ -1564,6 +1564,58 @@
                `(logtest (get-header-data array)
                          (ash sb-vm:+array-fill-pointer-p+ sb-vm:array-flags-data-position)))))))
 
+;;; If the principal use of LVAR adds a constant integer to, or subtracts
+;;; one from, an lvar that satisfies OPERAND-P, return the integer that
+;;; the operand is offset by.
+(defun lvar-constant-offset (lvar operand-p)
+  (let ((use (principal-lvar-use lvar)))
+    (when (combination-p use)
+      (flet ((constant (lvar)
+               (and (constant-lvar-p lvar)
+                    (integerp (lvar-value lvar))
+                    (lvar-value lvar))))
+        (let ((args (combination-args use))
+              (fun (combination-fun use)))
+          (cond ((lvar-fun-is fun '(1- 1+))
+                 (and (singleton-p args)
+                      (funcall operand-p (first args))
+                      (if (lvar-fun-is fun '(1-)) -1 1)))
+                ((/= (length args) 2)
+                 nil)
+                ((lvar-fun-is fun '(-))
+                 (and (funcall operand-p (first args))
+                      (awhen (constant (second args)) (- it))))
+                ((lvar-fun-is fun '(+))
+                 (cond ((funcall operand-p (first args)) (constant (second args)))
+                       ((funcall operand-p (second args)) (constant (first args)))))))))))
+
+;;; True if INDEX-VAR starts out below the VECTOR-LENGTH of ARRAY-VAR and
+;;; is only ever decremented, as by (LOOP FOR I FROM (1- (LENGTH V)) DOWNTO 0),
+;;; so that it stays below the length by induction. Whether it also stays
+;;; at or above zero is left to the type check that %CHECK-BOUND keeps.
+(defun decreasing-index-below-length-p (index-var array-var)
+  (flet ((index-p (lvar)
+           (let ((use (principal-lvar-use lvar)))
+             (and (ref-p use) (eq (ref-leaf use) index-var))))
+         (length-p (lvar)
+           (let ((use (principal-lvar-ref-use lvar)))
+             (and (combination-p use)
+                  (lvar-fun-is (combination-fun use) '(vector-length))
+                  (let ((array (principal-lvar-use (first (combination-args use)))))
+                    (and (ref-p array) (eq (ref-leaf array) array-var)))))))
+    (and (lambda-var-p index-var)
+         (lambda-var-sets index-var)
+         (lambda-var-p array-var)
+         (not (lambda-var-sets array-var))
+         (functional-letlike-p (lambda-var-home index-var))
+         (every (lambda (set)
+                  (let ((offset (lvar-constant-offset (set-value set) #'index-p)))
+                    (and offset (<= offset 0))))
+                (lambda-var-sets index-var))
+         (let ((offset (lvar-constant-offset (let-var-initial-value index-var)
+                                             #'length-p)))
+           (and offset (< offset 0))))))
+
 (deftransform %check-bound ((array dimension index) ((simple-array * (*)) t t))
   (let ((array-ref (lvar-uses array))
         (index-ref (lvar-uses index)))
@@ -1571,6 +1623,8 @@
              (ref-p array-ref)
              (ref-p index-ref)
              (or
+              (decreasing-index-below-length-p (ref-leaf index-ref)
+                                               (ref-leaf array-ref))
               (let* ((index-leaf (ref-leaf index-ref))
                      (index-value (and (constant-p index-leaf)
                                        (constant-value index-leaf)))
@@ -128,103 +128,39 @@
   (defun copy-conset (conset) (copy-sset conset))
   (defun conset-member (constraint conset) (sset-member constraint conset))
   (defun conset-adjoin (constraint conset) (sset-adjoin constraint conset))
-  (defun conset= (conset1 conset2) (sset= conset1 conset2))
-  ;; Note: CP doesn't ever care whether union, intersection, and
-  ;; difference change the first set.  (This is an important degree of
-  ;; freedom, since some ways of implementing sets lose a great deal
-  ;; when these operations are required to track changes.)
-  (defun conset-union (conset1 conset2)
-    (sset-union conset1 conset2) (values))
-  (defun conset-intersection (conset1 conset2)
-    (sset-intersection conset1 conset2) (values))
-  (defun conset-difference (conset1 conset2)
-    (sset-difference conset1 conset2) (values)))
-
-(locally
-    ;; This is performance critical for the compiler, and benefits
-    ;; from the following declarations.  Probably you'll want to
-    ;; disable these declarations when debugging consets.
-    (declare #-sb-xc-host (optimize (speed 3) (safety 0) (space 0)))
-  (declaim (inline %constraint-number))
-  (defun %constraint-number (constraint)
-    (sset-element-number constraint))
-  (defstruct (conset
-              (:constructor make-conset ())
-              (:copier %copy-conset))
-    (vector (make-array
-             (power-of-two-ceiling (length *constraint-universe*))
-             :element-type 'bit :initial-element 0)
-            :type simple-bit-vector)
-    ;; Bit-vectors win over lightweight hashes for copy, union,
-    ;; intersection, difference, but lose for iteration if you iterate
-    ;; over the whole vector.  Tracking extrema helps a bit.
-    (min 0 :type fixnum)
-    (max 0 :type fixnum))
-
-  (defun conset-empty (conset)
-    (or (= (conset-min conset) (conset-max conset))
-        (not (find 1 (conset-vector conset)
-                   :start (conset-min conset)
-                   :end (conset-max conset)))))
-
-  (defun copy-conset (conset)
-    (let ((ret (%copy-conset conset)))
-      (setf (conset-vector ret) (copy-seq (conset-vector conset)))
-      ret))
-
-  (defun %conset-grow (conset new-size)
-    (declare (type index new-size))
-    (setf (conset-vector conset)
-          (replace (the simple-bit-vector
-                      (make-array
-                       (power-of-two-ceiling new-size)
-                      :element-type 'bit
-                      :initial-element 0))
-                   (the simple-bit-vector
-                     (conset-vector conset)))))
-
-  (declaim (inline conset-grow))
-  (defun conset-grow (conset new-size)
-    (declare (type index new-size))
-    (when (< (length (conset-vector conset)) new-size)
-      (%conset-grow conset new-size))
-    (values))
-
-  (defun conset-member (constraint conset)
-    (let ((number (%constraint-number constraint))
-          (vector (conset-vector conset)))
-      (when (< number (length vector))
-        (plusp (sbit vector number)))))
-
-  (defun conset-adjoin (constraint conset)
-    (let ((number (%constraint-number constraint)))
-      (conset-grow conset (1+ number))
-      (setf (sbit (conset-vector conset) number) 1)
-      (setf (conset-min conset) (min number (conset-min conset)))
-      (when (>= number (conset-max conset))
-        (setf (conset-max conset) (1+ number))))
-    conset)
-
+  ;; No bit is set outside of [MIN, MAX), so only the union of the
+  ;; two ranges needs comparing, however large the universe has grown.
   (defun conset= (conset1 conset2)
     (let* ((vector1 (conset-vector conset1))
            (vector2 (conset-vector conset2))
-           (length1 (length vector1))
-           (length2 (length vector2)))
-      (if (= length1 length2)
-          ;; When the lengths are the same, we can rely on EQUAL being
-          ;; nicely optimized on bit-vectors.
-          (equal vector1 vector2)
-          (multiple-value-bind (shorter longer)
-              (if (< length1 length2)
-                  (values vector1 vector2)
-                  (values vector2 vector1))
-            ;; FIXME: make MISMATCH fast on bit-vectors.
-            (dotimes (index (length shorter))
-              (when (/= (sbit vector1 index) (sbit vector2 index))
-                (return-from conset= nil)))
-            (if (find 1 longer :start (length shorter))
-                nil
-                t)))))
+           (start (min (conset-min conset1) (conset-min conset2)))
+           (end (max (conset-max conset1) (conset-max conset2)))
+           (common-end (min end (length vector1) (length vector2))))
+      (and (or (>= start common-end)
+               #+sb-xc-host
+               (not (mismatch vector1 vector2
+                              :start1 start :end1 common-end
+                              :start2 start :end2 common-end))
+               #-sb-xc-host
+               ;; Whole words first. Bits of those words outside the
+               ;; range are clear in both vectors anyway.
+               (let ((end-word (floor common-end sb-vm:n-word-bits)))
+                 (and (loop for i from (floor start sb-vm:n-word-bits)
+                              below end-word
+                            always (= (%vector-raw-bits vector1 i)
+                                      (%vector-raw-bits vector2 i)))
+                      (loop for i from (max start (* end-word sb-vm:n-word-bits))
+                              below common-end
+                            always (= (sbit vector1 i) (sbit vector2 i))))))
+           ;; Past the end of the shorter vector, the longer one must
+           ;; have no bits set.
+           (multiple-value-bind (shorter longer)
+               (if (< (length vector1) (length vector2))
+                   (values vector1 vector2)
+                   (values vector2 vector1))
+             (or (<= end (length shorter))
+                 (not (find 1 longer :start (max start (length shorter))
+                                     :end end)))))))
 
   (macrolet
       ((defconsetop (name bit-op)
@@ -1442,25 +1378,31 @@
               (rest-of-blocks block)))))
     (values (leading-blocks) (rest-of-blocks))))
 
-;;; Append OBJ to the end of LIST as if by NCONC but only if it is not
-;;; a member already.
-(defun nconc-new (obj list)
-  (do ((x list (cdr x))
-       (prev nil x))
-      ((endp x) (if prev
-                    (progn
-                      (setf (cdr prev) (list obj))
-                      list)
-                    (list obj)))
-    (when (eql (car x) obj)
-      (return-from nconc-new list))))
-
+;;; The blocks waiting for propagation are kept in a FIFO queue, as a
+;;; list with a pointer to its last cons. Since a block that is already
+;;; waiting need not be queued again, it is marked with a BLOCK-FLAG of
+;;; :QUEUED until it is dequeued. This keeps ENQUEUE constant-time in
+;;; components with thousands of blocks. The flags are only a hint:
+;;; if something else clears one, the block may be queued twice, which
+;;; merely costs an UPDATE-BLOCK-IN that finds nothing new.
 (defun find-and-propagate-constraints (component)
-  (let ((blocks-to-process ()))
+  (let ((head ())
+        (tail ()))
     (flet ((enqueue (blocks)
              (dolist (block blocks)
-               (when (block-type-check block)
-                 (setq blocks-to-process (nconc-new block blocks-to-process))))))
+               (when (and (block-type-check block)
+                          (neq (block-flag block) :queued))
+                 (setf (block-flag block) :queued)
+                 (let ((new (list block)))
+                   (if head
+                       (setf (cdr tail) new)
+                       (setf head new))
+                   (setq tail new)))))
+           (dequeue ()
+             (let ((block (pop head)))
+               (when block
+                 (setf (block-flag block) nil))
+               block)))
       (clear-flags component)
       (multiple-value-bind (leading-blocks rest-of-blocks)
           (leading-component-blocks component)
@@ -1480,14 +1422,14 @@
         ;; done, hence any inherited type constraints from such
         ;; constraints will be wrong as well.
         (dolist (join-types-p '(nil t))
-          (setq blocks-to-process (copy-list rest-of-blocks))
+          (enqueue rest-of-blocks)
           ;; The rest of the blocks.
           (dolist (block rest-of-blocks)
-            (aver (eq block (pop blocks-to-process)))
+            (aver (eq block (dequeue)))
             (setf (block-in block) (compute-block-in block join-types-p))
             (enqueue (find-block-type-constraints block nil)))
           ;; Propagate constraints
-          (loop for block = (pop blocks-to-process)
+          (loop for block = (dequeue)
                 while block do
                   (unless (eq block (component-tail component))
                     (when (update-block-in block join-types-p)
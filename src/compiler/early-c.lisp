@@ -111,6 +111,14 @@ possible. Potentially long (over one page in size) vectors are, however, not
 stack allocated except in zero SAFETY code, as such a vector could overflow
 the stack without triggering overflow protection.")
 
+;;; A hash table from the names of global functions that took a large
+;;; share of the samples of a profile, as loaded by SB-SPROF:LOAD-PROFILE,
+;;; to that share, or NIL. Calls from those functions to functions with
+;;; inline expansions are inlined unless SPACE is 2 or more, and their
+;;; code is placed first in immobile space by SAVE-LISP-AND-DIE.
+(defvar *hot-functions* nil)
+(declaim (type (or null hash-table) *hot-functions*))
+
 ;;; *BLOCK-COMPILE-ARGUMENT* holds the original value of the :BLOCK-COMPILE
 ;;; argument, which overrides any internal declarations.
 (defvar *block-compile-argument*)
@@ -252,6 +260,10 @@ the stack without triggering overflow protection.")
   (coverage-metadata nil :type (or (cons hash-table hash-table) null) :read-only t)
   (msan-unpoison nil :read-only t)
   (sset-counter 1 :type fixnum)
+  ;; function -> parsed FTYPE-FROM-FDEFN of it, for the global functions
+  ;; that have no type in globaldb, whose declared type would otherwise
+  ;; be reparsed at every reference
+  (fdefn-ftypes (make-hash-table :test 'eq) :read-only t :type hash-table)
   ;; if emitting a cfasl, the fasl stream to that
   (compile-toplevel-object nil :read-only t)
   ;; The current block compilation state.  These are initialized to
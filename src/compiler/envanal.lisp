@@ -417,7 +417,9 @@
                              (setf (lvar-dynamic-extent real) cleanup)
                              (pushnew real real-dx-lvars))))
                         (t
-                         (note-no-stack-allocation lvar)
+                         ;; Nobody asked for it
+                         (unless (eq dx 'non-escaping)
+                           (note-no-stack-allocation lvar))
                          (setf (lvar-dynamic-extent lvar) nil)))))
               (setf (cleanup-nlx-info cleanup) real-dx-lvars)
               (setf (component-dx-lvars component)
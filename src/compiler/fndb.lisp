@@ -790,6 +790,18 @@
 (defknown (%bit-pos-fwd %bit-pos-rev) (t simple-bit-vector index index)
   (or (mod #.(1- array-dimension-limit)) null)
   (foldable flushable no-verify-arg-count))
+(defknown %bit-count (simple-bit-vector index index) index
+  (flushable no-verify-arg-count))
+(defknown (%octet-pos-fwd %octet-pos-rev)
+  ((unsigned-byte 8) (or (simple-array (unsigned-byte 8) (*)) simple-base-string)
+   index index)
+  (or (mod #.(1- array-dimension-limit)) null)
+  (foldable flushable no-verify-arg-count))
+(defknown %octet-position
+  ((unsigned-byte 8) (or (simple-array (unsigned-byte 8) (*)) simple-base-string)
+   t index index)
+  (or (mod #.(1- array-dimension-limit)) null)
+  (foldable flushable no-verify-arg-count))
 
 (defknown count
   (t proper-sequence &rest t &key
@@ -845,6 +857,11 @@
   vector
   (call no-verify-arg-count))
 
+(defknown sb-impl::numeric-sort-vector
+  ((simple-array * (*)) index index function (or function null))
+  boolean
+  (call no-verify-arg-count))
+
 (defknown sb-impl::stable-sort-simple-vector
   (simple-vector function (or function null))
   simple-vector
@@ -2115,6 +2132,7 @@
 ;;; the CAS functions are transformed to something else rather than "translated".
 ;;; either way, they should not be called.
 (defknown (cas svref) (t t simple-vector index) t (always-translatable))
+(defknown (cas aref) (t t vector index) t ())
 (defknown (cas symbol-value) (t t symbol) t (always-translatable))
 (defknown %compare-and-swap-svref (simple-vector index t t) t
     ())
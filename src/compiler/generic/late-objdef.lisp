@@ -255,8 +255,14 @@ static inline lispobj compute_lispobj(lispobj* base_addr) {
 ;;; working, and I'm reluctant to create yet another 'something-thread' file to
 ;;; put this in, not to mention that SB-THREAD is the wrong package anyway.
 (in-package "SB-THREAD")
-(sb-xc:defstruct (avlnode (:constructor avlnode (key data left right)))
+(sb-xc:defstruct (avlnode (:constructor avlnode
+                              (key data left right
+                               &aux (height (1+ (max (if left (avlnode-height left) 0)
+                                                     (if right (avlnode-height right) 0)))))))
   (left  nil :read-only t)
   (right nil :read-only t)
   (key   0   :read-only t :type sb-vm:word)
-  data)
+  data
+  ;; The number of nodes on the longest path down from this one, so that
+  ;; rebalancing needn't walk the subtrees to find it
+  (height 1  :read-only t :type (unsigned-byte 8)))
@@ -166,7 +166,9 @@
     #+win32 sb-kernel::handle-win32-exception
     #+sb-safepoint sb-thread::run-interruption
     enter-alien-callback
-    #+sb-thread sb-thread::enter-foreign-callback)
+    #+sb-thread sb-thread::enter-foreign-callback
+    #+(and sb-thread (not sb-safepoint)) sb-thread::attach-foreign-thread
+    #+(and sb-thread (not sb-safepoint)) sb-thread::detach-foreign-thread)
   #'equal)
 
 ;;; (potentially) static symbols that C code must be able to set/get
@@ -198,6 +198,7 @@
                            (- (get-lisp-obj-address code) sb-vm:other-pointer-lowtag)
                            (- (get-lisp-obj-address copy) sb-vm:other-pointer-lowtag))
       (assign-simple-fun-self (%code-entry-point copy 0)))
+    (sb-fasl::note-code-for-perf-map copy)
     copy))
 
 ;;; Note the existence of FUNCTION.
@@ -379,6 +380,7 @@
                  (setf (code-header-ref code-obj index) referent)))))))
     (when named-call-fixups
       (sb-vm::statically-link-code-obj code-obj named-call-fixups))
+    (sb-fasl::note-code-for-perf-map code-obj)
     (when sb-fasl::*show-new-code*
       (let ((*print-pretty* nil))
         (format t "~&New code(~Db,core): ~A~%" (code-object-size code-obj) code-obj)))
@@ -146,6 +146,15 @@
   (no-verify-arg-count)
   :result-arg 0)
 
+;;; Store (OP (AREF A I) (AREF B I)) into (AREF RESULT I) for each I
+;;; below COUNT, where the three are vectors of floats of one format.
+#+x86-64
+(defknown sb-vm::%float-vector-op
+    ((member + - *) (simple-array * (*)) (simple-array * (*)) (simple-array * (*))
+     index)
+    (values)
+  (always-translatable))
+
 ;;; Return the length of VECTOR.
 ;;; Ordinary code should prefer to use (LENGTH (THE VECTOR FOO)) instead.
 (defknown vector-length (vector) index (flushable dx-safe))
@@ -268,6 +277,26 @@
 #+compare-and-swap-vops
 (defknown %array-atomic-incf/word (t index sb-vm:word) sb-vm:word
   (always-translatable))
+#+x86-64
+(progn
+(defknown %array-atomic-incf/ub32 (t index sb-vm:word) (unsigned-byte 32)
+  (always-translatable))
+(defknown %array-atomic-incf/fixnum (t index sb-vm:word) fixnum
+  (always-translatable))
+(defknown %vector-cas/word ((simple-array sb-vm:word (*)) index sb-vm:word sb-vm:word)
+  sb-vm:word (always-translatable))
+(defknown %vector-cas/ub32 ((simple-array (unsigned-byte 32) (*)) index
+                            (unsigned-byte 32) (unsigned-byte 32))
+  (unsigned-byte 32) (always-translatable))
+(defknown %vector-cas/fixnum ((simple-array fixnum (*)) index fixnum fixnum)
+  fixnum (always-translatable))
+(defknown %vector-xchg/word ((simple-array sb-vm:word (*)) index sb-vm:word)
+  sb-vm:word (always-translatable))
+(defknown %vector-xchg/ub32 ((simple-array (unsigned-byte 32) (*)) index
+                             (unsigned-byte 32))
+  (unsigned-byte 32) (always-translatable))
+(defknown %vector-xchg/fixnum ((simple-array fixnum (*)) index fixnum)
+  fixnum (always-translatable)))
 
 ;;; These two are mostly used for bit-bashing operations.
 (defknown %vector-raw-bits (t index) sb-vm:word
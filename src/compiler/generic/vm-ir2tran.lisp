@@ -359,7 +359,7 @@
              '#.(list (sb-vm:saetp-typecode (find-saetp 't))
                       (sb-vm:saetp-typecode (find-saetp 'fixnum))))
      (or (eq dx 'truly-dynamic-extent)
-         (zerop (policy node safety))
+         (and (zerop (policy node safety)) (neq dx 'non-escaping))
          ;; a vector object should fit in one page -- otherwise it might go past
          ;; stack guard pages.
          (values-subtypep (lvar-derived-type words)
@@ -416,7 +416,7 @@
   (defoptimizer (%make-list stack-allocate-result) ((length element) node dx)
     (declare (ignore element))
     (or (eq dx 'truly-dynamic-extent)
-        (zerop (policy node safety))
+        (and (zerop (policy node safety)) (neq dx 'non-escaping))
         ;; At most one page (this is more paranoid than %listify-rest-args).
         ;; Really what you want to do is decrement the stack pointer by one page
         ;; at a time, filling in CDR pointers downward. Then this restriction
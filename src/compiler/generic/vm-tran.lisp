@@ -778,3 +778,16 @@
 (deftransform (cas svref) ((old new vector index))
   '(let ((v (the simple-vector vector)))
     (%compare-and-swap-svref v (check-bound v (length v) index) old new)))
+
+(deftransform (cas aref) ((old new vector index) (t t simple-vector t))
+  '(%compare-and-swap-svref vector (check-bound vector (length vector) index)
+    old new))
+#+x86-64
+(macrolet ((def (element-type casser)
+             `(deftransform (cas aref) ((old new vector index)
+                                        (t t (simple-array ,element-type (*)) t))
+                '(,casser vector (check-bound vector (length vector) index)
+                  (the ,element-type old) (the ,element-type new)))))
+  (def sb-vm:word %vector-cas/word)
+  (def (unsigned-byte 32) %vector-cas/ub32)
+  (def fixnum %vector-cas/fixnum))
@@ -360,6 +360,11 @@
 (define-info-type (:function :source-transform)
   :type-spec (or function null (cons atom atom)))
 
+;;; DOUBLE-FLOAT or WORD if this function has a companion which returns
+;;; its result unboxed. See UNBOXED-RETURN-CALL-TRANSFORM.
+(define-info-type (:function :unboxed-return)
+  :type-spec (member nil double-float word))
+
 ;;; the macroexpansion function for this macro
 (define-info-type (:function :macro-function) :type-spec (or function null))
 
@@ -1317,6 +1317,16 @@
                      (mark-for-deletion succ)))))
         t))))
 
+;;; True if CALL is in a function, or nested in one, that *HOT-FUNCTIONS*
+;;; names, and SPACE doesn't forbid inlining into it.
+(defun hot-call-p (call)
+  (let ((hot *hot-functions*))
+    (when (and hot (policy call (< space 2)))
+      (do ((fun (lexenv-lambda (node-lexenv call)) (lambda-parent fun)))
+          ((null fun) nil)
+        (when (gethash (functional-debug-name fun) hot)
+          (return t))))))
+
 ;;; This is called both by IR1 conversion and IR1 optimization when
 ;;; they have verified the type signature for the call, and are
 ;;; wondering if something should be done to special-case the call. If
@@ -1360,7 +1370,8 @@
             (ecase inlinep
               (inline t)
               (no-chance nil)
-              ((nil maybe-inline) (policy call (zerop space))))
+              ((nil maybe-inline) (or (policy call (zerop space))
+                                      (hot-call-p call))))
             (defined-fun-p leaf)
             (defined-fun-inline-expansion leaf)
             (inline-expansion-ok call leaf))
@@ -1445,6 +1445,8 @@ is potentially harmful to any already-compiled callers using (SAFETY 0)."
       (%set-inline-expansion name defined-fun inline-lambda extra-info))
 
     (become-defined-fun-name name)
+    ;; DEFUN says again if the new definition has a companion.
+    (clear-info :function :unboxed-return name)
 
     ;;
     ;; If there is a type from a previous definition, blast it, since it is
@@ -1084,6 +1084,52 @@
         (setf (combination-args node) (arg-lvars))))
     node))
 
+;;; A function of a call form and a lexenv, like a source transform,
+;;; which PCL installs to expand calls to generic functions when
+;;; GENERIC-FUNCTION-INLINE-CACHES is enabled.
+(define-load-time-global *generic-function-call-transform* nil)
+
+;;; A function whose result is a DOUBLE-FLOAT or a WORD too big to be a
+;;; FIXNUM can have a companion (SB-IMPL::UNBOXED-RETURN NAME) which
+;;; returns the bits of the result as two 32-bit halves, which are
+;;; FIXNUMs, so that a caller which knows of it and uses the result
+;;; unboxed never has it allocated on the heap. DEFUN defines the pair
+;;; when the proclaimed FTYPE allows; see SB-IMPL::UNBOXED-RETURN-KIND.
+(defun unboxed-return-split-form (kind result)
+  (ecase kind
+    (double-float
+     `(values (double-float-high-bits ,result) (double-float-low-bits ,result)))
+    (word
+     `(values (ldb (byte 32 32) ,result) (ldb (byte 32 0) ,result)))))
+
+(defun unboxed-return-join-form (kind high low)
+  (ecase kind
+    (double-float `(make-double-float ,high ,low))
+    (word `(logior (ash ,high 32) ,low))))
+
+(defun unboxed-return-values-type (kind)
+  (ecase kind
+    (double-float '(values (signed-byte 32) (unsigned-byte 32) &optional))
+    (word '(values (unsigned-byte 32) (unsigned-byte 32) &optional))))
+
+;;; Call the companion of a function which has one. Calls with the
+;;; wrong number of arguments are left alone to be warned about.
+(defun unboxed-return-call-transform (form lexenv)
+  (declare (ignore lexenv))
+  (let* ((name (car form))
+         (kind (info :function :unboxed-return name))
+         (ftype (global-ftype name)))
+    (if (and kind
+             (fun-type-p ftype)
+             (proper-list-p (cdr form))
+             (= (length (cdr form)) (length (fun-type-required ftype))))
+        (let ((high (gensym "HIGH"))
+              (low (gensym "LOW")))
+          `(multiple-value-bind (,high ,low)
+               (funcall #'(sb-impl::unboxed-return ,name) ,@(cdr form))
+             ,(unboxed-return-join-form kind high low)))
+        (values nil t))))
+
 ;;; Convert a call to a global function. If not NOTINLINE, then we do
 ;;; source transforms and try out any inline expansion. If there is no
 ;;; expansion, but is INLINE, then give an efficiency note (unless a
@@ -1097,7 +1143,13 @@
                    (defined-fun-inlinep var))))
     (if (eq inlinep 'notinline)
         (ir1-convert-combination start next result form var)
-        (let ((transform (info :function :source-transform name)))
+        (let ((transform
+                (or (info :function :source-transform name)
+                    (and (info :function :unboxed-return name)
+                         #'unboxed-return-call-transform)
+                    (and (eq (leaf-where-from var) :defined-method)
+                         (policy *lexenv* (> generic-function-inline-caches 1))
+                         *generic-function-call-transform*))))
           (if transform
               (multiple-value-bind (transformed pass)
                   (if (functionp transform)
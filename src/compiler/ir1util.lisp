@@ -977,12 +977,21 @@
                 (handle-nested-dynamic-extent-lvars
                  dx (cast-value use)))
                (combination
-                (loop for arg in (combination-args use)
-                      ;; deleted args show up as NIL here
-                      when (and arg
-                                (lvar-good-for-dx-p arg dx))
-                      append (handle-nested-dynamic-extent-lvars
-                              dx arg)))
+                (if (eq dx 'non-escaping)
+                    ;; Only the object itself didn't escape, not the ones that
+                    ;; it was made from: those are given back by accessors.
+                    (let* ((info (and (eq (combination-kind use) :known)
+                                      (combination-fun-info use)))
+                           (arg (awhen (and info (fun-info-result-arg info))
+                                  (nth it (combination-args use)))))
+                      (when (and arg (lvar-good-for-dx-p arg dx))
+                        (handle-nested-dynamic-extent-lvars dx arg)))
+                    (loop for arg in (combination-args use)
+                          ;; deleted args show up as NIL here
+                          when (and arg
+                                    (lvar-good-for-dx-p arg dx))
+                          append (handle-nested-dynamic-extent-lvars
+                                  dx arg))))
                (ref
                 (let* ((other (trivial-lambda-var-ref-lvar use)))
                   (unless (eq other lvar)
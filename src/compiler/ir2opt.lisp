@@ -22,17 +22,18 @@
 (defmacro ir2block-predecessors (x) `(car (gethash (the ir2-block ,x) *2block-info*)))
 (defmacro ir2block-successors (x) `(cdr (gethash (the ir2-block ,x) *2block-info*)))
 
+(defun block-last-2block (block)
+  (declare (type cblock block))
+  (do ((2block (block-info block)
+               (ir2-block-next 2block)))
+      (nil)
+    (let ((next (ir2-block-next 2block)))
+      (when (or (null next)
+                (neq block (ir2-block-block next)))
+        (return 2block)))))
+
 (defun initialize-ir2-blocks-flow-info (component)
-  (labels ((block-last-2block (block)
-             (declare (type cblock block))
-             (do ((2block (block-info block)
-                          (ir2-block-next 2block)))
-                 (nil)
-               (let ((next (ir2-block-next 2block)))
-                 (when (or (null next)
-                           (neq block (ir2-block-block next)))
-                   (return 2block)))))
-           (link-2blocks (pred succ)
+  (labels ((link-2blocks (pred succ)
              (declare (type ir2-block pred succ))
              (pushnew pred (car (ensure-gethash succ *2block-info*
                                                 (cons '() '()))))
@@ -1191,6 +1192,28 @@
             (unless pairs (return)))
       new)))
 
+;;; Replace consecutive BINDs, as from a LET of several specials, with
+;;; one BIND-N.
+(defun merge-bind-vops (vop)
+  (let ((binds (list vop)))
+    (loop (let ((next (vop-next (car binds))))
+            (unless (and next (eq (vop-name next) 'bind))
+              (return))
+            (push next binds)))
+    (unless (cdr binds) ; if at least 2
+      (return-from merge-bind-vops nil))
+    (setq binds (nreverse binds))
+    (let ((new (emit-and-insert-vop
+                (vop-node vop) (vop-block vop)
+                (template-or-lose 'sb-vm::bind-n)
+                (reference-tn-list (mapcar (lambda (bind) (tn-ref-tn (vop-args bind)))
+                                           binds)
+                                   nil)
+                nil vop (list (mapcar (lambda (bind) (car (vop-codegen-info bind)))
+                                      binds)))))
+      (mapc #'delete-vop binds)
+      new)))
+
 (defun ir2-optimize-stores (component)
   ;; This runs after representation selection. It's the same as RUN-VOP-OPTIMIZERS,
   ;; but with hardcoded vop names and function to call.
@@ -1203,10 +1226,142 @@
                      (sb-vm::instance-index-set
                       (when (gethash 'sb-vm::instance-set-multiple
                                      *backend-parsed-vops*)
-                        'merge-instance-set-vops)))))
+                        'merge-instance-set-vops))
+                     (bind
+                      (when (gethash 'sb-vm::bind-n *backend-parsed-vops*)
+                        'merge-bind-vops)))))
               (setq vop (or (awhen optimizer (funcall it vop))
                             (vop-next vop))))))))
 
+;;;; Loop-invariant code motion
+
+;;; Functions whose translating vops depend only on their arguments and
+;;; can't trap, so that they can be run ahead of the loop they are in,
+;;; even when the loop wouldn't have reached them.
+(define-load-time-global *loop-invariant-funs*
+  '(+ - * logand logior logxor logeqv lognot ash))
+
+;;; Functions that read the header of a multi-dimensional array, which
+;;; isn't changed after it is made unless the array is adjustable.
+;;; These are invariant if their first argument is a variable of a
+;;; simple array type that isn't a vector, which has such a header
+;;; whether or not the loop would have reached the read.
+(define-load-time-global *loop-invariant-array-header-funs*
+  '(%array-data %array-dimension))
+
+;;; True if TN is the TN of a variable whose type says it always holds
+;;; an array with a header that doesn't change.
+(defun simple-array-header-tn-p (tn)
+  (let ((leaf (tn-leaf tn)))
+    (and (lambda-var-p leaf)
+         (csubtypep (leaf-type leaf)
+                    (specifier-type '(and simple-array (not vector)))))))
+
+;;; True if BLOCK is in LOOP or in a loop nested in it.
+(defun block-in-loop-p (block loop)
+  (do ((l (block-loop block) (loop-superior l)))
+      ((null l) nil)
+    (when (eq l loop)
+      (return t))))
+
+;;; Return the only block outside LOOP that leads to its head, if it
+;;; leads nowhere else and is in the same environment.
+(defun loop-preheader (loop)
+  (let* ((head (loop-head loop))
+         (outside (remove-if (lambda (pred) (block-in-loop-p pred loop))
+                             (block-pred head)))
+         (pred (first outside)))
+    (when (and (singleton-p outside)
+               (equal (block-succ pred) (list head))
+               (block-info pred)
+               (eq (block-environment pred) (block-environment head)))
+      pred)))
+
+;;; Move the vops in the natural loops of COMPONENT that compute one of
+;;; *LOOP-INVARIANT-FUNS*, or one of *LOOP-INVARIANT-ARRAY-HEADER-FUNS*
+;;; of a simple array, from TNs that the loop doesn't write to the end
+;;; of the loop's preheader, inner loops first so that what is invariant
+;;; in the outer loop too moves out again. The result TNs must be written
+;;; by the vop alone, and every write of the arguments must be in the
+;;; preheader's last IR2 block or in a block that dominates the preheader,
+;;; so that the arguments have the same values at the end of the
+;;; preheader as throughout the loop.
+(defun hoist-loop-invariant-vops (component)
+  (labels ((invariant-tn-p (tn loop preheader 2preheader)
+             (case (tn-kind tn)
+               (:constant t)
+               (:normal
+                (let ((writes (tn-writes tn)))
+                  (and writes
+                       (do ((ref writes (tn-ref-next ref)))
+                           ((null ref) t)
+                         (let* ((2block (vop-block (tn-ref-vop ref)))
+                                (block (ir2-block-block 2block)))
+                           (unless (or (eq 2block 2preheader)
+                                       (and (neq block preheader)
+                                            (not (block-in-loop-p block loop))
+                                            (dominates-p block preheader)))
+                             (return nil)))))))))
+           (hoistable-p (vop loop preheader 2preheader)
+             (let ((node (vop-node vop))
+                   (info (vop-info vop)))
+               (and (combination-p node)
+                    (eq (combination-kind node) :known)
+                    (policy node (> speed compilation-speed))
+                    (not (vop-info-save-p info))
+                    (let ((name (lvar-fun-name (combination-fun node))))
+                      (or (memq name *loop-invariant-funs*)
+                          (and (memq name *loop-invariant-array-header-funs*)
+                               (vop-args vop)
+                               (simple-array-header-tn-p
+                                (tn-ref-tn (vop-args vop))))))
+                    (let ((fun-info (combination-fun-info node)))
+                      (and fun-info (memq info (fun-info-templates fun-info))))
+                    (vop-results vop)
+                    (do ((ref (vop-results vop) (tn-ref-across ref)))
+                        ((null ref) t)
+                      (let ((tn (tn-ref-tn ref)))
+                        (unless (and (eq (tn-kind tn) :normal)
+                                     (eq (tn-writes tn) ref)
+                                     (null (tn-ref-next ref)))
+                          (return nil))))
+                    (do ((ref (vop-args vop) (tn-ref-across ref)))
+                        ((null ref) t)
+                      (unless (invariant-tn-p (tn-ref-tn ref)
+                                              loop preheader 2preheader)
+                        (return nil))))))
+           (tns (refs)
+             (loop for ref = refs then (tn-ref-across ref)
+                   while ref
+                   collect (tn-ref-tn ref)))
+           (hoist (vop 2preheader)
+             (let ((last (ir2-block-last-vop 2preheader)))
+               (emit-and-insert-vop (vop-node vop) 2preheader (vop-info vop)
+                                    (reference-tn-list (tns (vop-args vop)) nil)
+                                    (reference-tn-list (tns (vop-results vop)) t)
+                                    (and last (eq (vop-name last) 'branch) last)
+                                    (vop-codegen-info vop))
+               (delete-vop vop)))
+           (hoist-from-loop (loop)
+             (mapc #'hoist-from-loop (loop-inferiors loop))
+             (let ((preheader (and (eq (loop-kind loop) :natural)
+                                   (loop-preheader loop))))
+               (when preheader
+                 (let ((2preheader (block-last-2block preheader)))
+                   (do-ir2-blocks (2block component)
+                     (when (block-in-loop-p (ir2-block-block 2block) loop)
+                       (do ((vop (ir2-block-start-vop 2block) next)
+                            (next))
+                           ((null vop))
+                         (setq next (vop-next vop))
+                         (when (hoistable-p vop loop preheader 2preheader)
+                           (hoist vop 2preheader))))))))))
+    (let ((outer (component-outer-loop component)))
+      (when (loop-inferiors outer)
+        (find-dominators component)
+        (hoist-from-loop outer)
+        (clear-dominators component)))))
+
 (defun ir2-optimize (component)
   (let ((*2block-info* (make-hash-table :test #'eq)))
     (initialize-ir2-blocks-flow-info component)
@@ -1219,6 +1374,8 @@
         (print-ir2-blocks component)))
     ;; Look for if/else chains before cmovs, because a cmov
     ;; affects whether the last if/else is recognizable.
+    (when *loop-analyze*
+      (hoist-loop-invariant-vops component))
     #+(or ppc ppc64 x86 x86-64) (convert-if-else-chains component)
     (run-vop-optimizers component)
     (delete-unused-ir2-blocks component))
@@ -54,6 +54,112 @@
              (setf (car args) nil)))
   (values))
 
+;;;; automatic stack allocation
+;;;;
+;;;; An argument of a local call that is a fresh list, vector or
+;;;; structure can be stack-allocated as if its variable were declared
+;;;; DYNAMIC-EXTENT if nothing can reference it after the call returns.
+;;;; This is conservative: each reference to the variable has to be an
+;;;; argument of a function known not to keep it, or to be bound to a
+;;;; variable that is itself used only so, and the object's own
+;;;; arguments are left on the heap, since accessors return them.
+
+;;; How the function named NAME treats an object passed to it as the
+;;; argument at POSITION: :READ if it keeps no reference to it and
+;;; returns none of its storage, :TAIL if it keeps no reference to it
+;;; but may return part of its storage, else NIL.
+(defun non-escaping-arg-use (name position)
+  (case name
+    ((car length vector-length endp null not consp listp atom
+      simple-vector-p vectorp arrayp sequencep %instancep %instance-layout
+      %instance-length array-dimension array-total-size array-rank
+      array-has-fill-pointer-p fill-pointer layout-of typep %instance-typep
+      structure-typep eq eql equal equalp svref aref row-major-aref schar
+      char bit sbit elt nth %instance-ref data-vector-ref
+      hairy-data-vector-ref %check-bound check-bound)
+     :read)
+    ((cdr last)
+     :tail)
+    (nthcdr
+     (when (eql position 1) :tail))
+    ;; Storing into the object, but not the object itself
+    ((%rplaca %rplacd %svset %instance-set data-vector-set
+      hairy-data-vector-set)
+     (when (eql position 0) :read))
+    ((setf aref)
+     (when (eql position 1) :read))))
+
+;;; True if NODE can only run while the body of FUN does: it is in FUN,
+;;; or in lambdas that are called only from there.
+(defun node-within-extent-p (node fun)
+  (let ((lexenv (node-lexenv node)))
+    (loop
+      (let ((lambda (lexenv-lambda lexenv)))
+        (cond ((eq lambda fun) (return t))
+              ((null lambda) (return nil))
+              ((member (functional-kind lambda) '(:let :mv-let))
+               (setq lexenv (lambda-call-lexenv lambda)))
+              (t
+               (let* ((refs (leaf-refs lambda))
+                      (lvar (and refs (null (cdr refs)) (ref-lvar (first refs))))
+                      (call (and lvar (lvar-dest lvar))))
+                 (unless (and (combination-p call) (eq (combination-fun call) lvar))
+                   (return nil))
+                 (setq lexenv (node-lexenv call)))))))))
+
+;;; True if no reference to the object that LVAR holds, or to the part
+;;; of its storage that LVAR holds, can survive FUN.
+(defun non-escaping-lvar-p (lvar fun depth)
+  (let ((dest (lvar-dest lvar)))
+    (typecase dest
+      (null t)
+      (cif t)
+      (cast
+       (let ((lvar (node-lvar dest)))
+         (or (not lvar) (non-escaping-lvar-p lvar fun depth))))
+      (combination
+       (let* ((args (combination-args dest))
+              (position (position lvar args))
+              (callee (let ((use (principal-lvar-use (combination-fun dest))))
+                        (when (ref-p use) (ref-leaf use)))))
+         (cond ((not position) nil)
+               ((lambda-p callee)
+                (let ((var (nth position (lambda-vars callee))))
+                  (and var (= (length args) (length (lambda-vars callee)))
+                       (non-escaping-var-p var fun (1+ depth)))))
+               (t
+                (case (non-escaping-arg-use (lvar-fun-name (combination-fun dest))
+                                            position)
+                  (:read t)
+                  (:tail (let ((lvar (node-lvar dest)))
+                           (or (not lvar) (non-escaping-lvar-p lvar fun depth)))))))))
+      (t nil))))
+
+(defun non-escaping-var-p (var fun depth)
+  (and (< depth 8)
+       (lambda-var-p var)
+       (not (lambda-var-sets var))
+       (null (leaf-extent var))
+       (dolist (ref (leaf-refs var) t)
+         (unless (and (node-within-extent-p ref fun)
+                      (let ((lvar (ref-lvar ref)))
+                        (or (not lvar) (non-escaping-lvar-p lvar fun depth))))
+           (return nil)))))
+
+;;; If ARG, the argument of CALL for VAR of FUN, can be stack-allocated
+;;; without a declaration, return the extent to treat it as having.
+(defun non-escaping-arg-extent (call fun var arg)
+  (when (and *stack-allocate-dynamic-extent*
+             (policy call (> stack-allocate-non-escaping 1)))
+    (let ((use (principal-lvar-use arg)))
+      (when (and (combination-p use)
+                 (or (lvar-good-for-dx-p arg 'non-escaping)
+                     ;; Not yet transformed into an allocation
+                     (member (lvar-fun-name (combination-fun use))
+                             '(make-array vector make-list)))
+                 (non-escaping-var-p var fun 0))
+        'non-escaping))))
+
 ;;; Given a local call CALL to FUN, find the associated argument LVARs
 ;;; of CALL corresponding to declared dynamic extent LAMBDA-VARs and
 ;;; note them as dynamic extent LVARs. This operation is transitive,
@@ -70,7 +176,8 @@
     (let ((dx-lvars
             (loop for arg in (basic-combination-args call)
                   for var in (lambda-vars fun)
-                  for dx = (leaf-dynamic-extent var)
+                  for dx = (or (leaf-dynamic-extent var)
+                               (and arg (non-escaping-arg-extent call fun var arg)))
                   when (and dx arg (not (lvar-dynamic-extent arg)))
                     append (handle-nested-dynamic-extent-lvars dx arg))))
       (when dx-lvars
@@ -62,6 +62,164 @@
   (when *compile-progress*
     (apply #'compiler-mumble foo)))
 
+;;;; compiler profiling
+
+;;; If a hash-table, the time spent in some of the costlier phases of
+;;; the compiler is accumulated into it, in internal real time units
+;;; keyed by phase name, for as long as it remains bound:
+;;;   (let ((sb-c::*compile-phase-times* (make-hash-table)))
+;;;     (compile nil form)
+;;;     sb-c::*compile-phase-times*)
+(defvar *compile-phase-times* nil)
+(declaim (type (or hash-table null) *compile-phase-times*))
+
+;;; A more detailed record of the same phases, which WITH-COMPILE-PROFILE
+;;; collects over any amount of compilation, such as a whole system
+;;; build. It is not shared with the threads of COMPILE-FILES-IN-PARALLEL.
+(defstruct (compile-profile (:constructor make-compile-profile ())
+                            (:copier nil)
+                            (:predicate nil))
+  (start (get-internal-real-time) :type unsigned-byte :read-only t)
+  ;; phase name -> (real time . bytes consed), summed
+  (phases (make-hash-table :test 'eq) :type hash-table :read-only t)
+  ;; component name -> (real time . bytes consed), summed
+  (functions (make-hash-table :test 'equal) :type hash-table :read-only t)
+  ;; (phase component-name start real-time bytes), most recent first
+  (events () :type list))
+(defvar *compile-profile* nil)
+(declaim (type (or compile-profile null) *compile-profile*))
+
+(declaim (inline bytes-consed-for-profile))
+(defun bytes-consed-for-profile ()
+  #+sb-xc-host 0
+  #-sb-xc-host (get-bytes-consed))
+
+(defun call-with-compile-phase-timing (phase fun)
+  (declare (type keyword phase) (type function fun))
+  (let ((start (get-internal-real-time))
+        (start-bytes (bytes-consed-for-profile)))
+    (multiple-value-prog1 (funcall fun)
+      (let ((time (- (get-internal-real-time) start))
+            (bytes (- (bytes-consed-for-profile) start-bytes))
+            (times *compile-phase-times*)
+            (profile *compile-profile*))
+        (when times
+          (incf (gethash phase times 0) time))
+        (when profile
+          (let ((name (and (boundp '*component-being-compiled*)
+                           *component-being-compiled*
+                           (component-name *component-being-compiled*))))
+            (flet ((add (key table)
+                     (let ((totals (or (gethash key table)
+                                       (setf (gethash key table)
+                                             (cons 0 0)))))
+                       (incf (car totals) time)
+                       (incf (cdr totals) bytes))))
+              ;; :COMPONENT is the whole of COMPILE-COMPONENT, which
+              ;; contains the other phases.
+              (if (eq phase :component)
+                  (add name (compile-profile-functions profile))
+                  (add phase (compile-profile-phases profile))))
+            (push (list phase name start time bytes)
+                  (compile-profile-events profile))))))))
+
+;;; Execute BODY as the compiler phase PHASE, for *COMPILE-PHASE-TIMES*
+;;; and *COMPILE-PROFILE*.
+(defmacro with-compile-phase-timing ((phase) &body body)
+  (let ((fun (gensym "PHASE")))
+    `(dx-flet ((,fun () ,@body))
+       (if (or *compile-phase-times* *compile-profile*)
+           (call-with-compile-phase-timing ',phase #',fun)
+           (,fun)))))
+
+;;; Print the phases and the costliest functions of PROFILE to STREAM.
+(defun print-compile-profile (profile stream &key (functions 20))
+  (let ((elapsed (- (get-internal-real-time) (compile-profile-start profile)))
+        (phases '())
+        (slowest '()))
+    (maphash (lambda (phase totals) (push (cons phase totals) phases))
+             (compile-profile-phases profile))
+    (maphash (lambda (name totals) (push (cons name totals) slowest))
+             (compile-profile-functions profile))
+    (flet ((seconds (time) (/ time (float internal-time-units-per-second))))
+      (format stream "~&; compiler profile: ~,3F s elapsed, ~D component~:P~%"
+              (seconds elapsed) (length slowest))
+      (format stream ";   ~18A ~10@A ~7@A ~16@A~%"
+              "phase" "seconds" "%" "bytes consed")
+      (loop for (phase time . bytes) in (sort phases #'> :key #'cadr)
+            do (format stream ";   ~18A ~10,3F ~6,1F% ~16:D~%"
+                       (string-downcase phase) (seconds time)
+                       (if (plusp elapsed) (* 100 (/ time elapsed)) 0)
+                       bytes))
+      (when slowest
+        (format stream ";   slowest functions:~%")
+        (loop for (name time . bytes) in (sort slowest #'> :key #'cadr)
+              repeat functions
+              do (format stream ";   ~10,3F s ~16:D bytes  ~A~%"
+                         (seconds time) bytes name)))))
+  (values))
+
+;;; Write the events of PROFILE to FILE in the Trace Event Format
+;;; understood by chrome://tracing and similar viewers. Components
+;;; appear as enclosing events, with their phases inside.
+(defun write-compile-profile-trace (profile file)
+  (let ((start (compile-profile-start profile))
+        (scale (/ 1000000 internal-time-units-per-second)))
+    (flet ((write-json-string (string stream)
+             (write-char #\" stream)
+             (loop for char across string
+                   do (case char
+                        ((#\" #\\) (write-char #\\ stream) (write-char char stream))
+                        (t (if (< (char-code char) 32)
+                               (format stream "\\u~4,'0X" (char-code char))
+                               (write-char char stream)))))
+             (write-char #\" stream)))
+      (with-open-file (stream file :direction :output :if-exists :supersede)
+        (write-string "{\"traceEvents\":[" stream)
+        (loop for (phase name time duration bytes)
+                in (reverse (compile-profile-events profile))
+              for first = t then nil
+              do (unless first (write-char #\, stream))
+                 (terpri stream)
+                 (write-string "{\"name\":" stream)
+                 (write-json-string (if (eq phase :component)
+                                        (princ-to-string name)
+                                        (string-downcase phase))
+                                    stream)
+                 (format stream ",\"cat\":\"~A\",\"ph\":\"X\",\"ts\":~D,\"dur\":~D,~
+                                 \"pid\":1,\"tid\":1,\"args\":{\"bytes\":~D"
+                         (if (eq phase :component) "function" "phase")
+                         (round (* (- time start) scale))
+                         (round (* duration scale))
+                         bytes)
+                 (when (and name (neq phase :component))
+                   (write-string ",\"function\":" stream)
+                   (write-json-string (princ-to-string name) stream))
+                 (write-string "}}" stream))
+        (format stream "~%]}~%")
+        (truename stream)))))
+
+(defun call-with-compile-profile (fun &key (summary *standard-output*)
+                                           trace-file)
+  (let ((profile (make-compile-profile)))
+    (multiple-value-prog1 (let ((*compile-profile* profile))
+                            (funcall fun))
+      (when summary
+        (print-compile-profile profile summary))
+      (when trace-file
+        (write-compile-profile-trace profile trace-file)))))
+
+;;; Execute BODY, recording the real time and bytes consed by each
+;;; phase of every compilation in it. Afterwards print a summary to
+;;; SUMMARY, a stream or NIL, and if TRACE-FILE is given, write the
+;;; individual events to it for chrome://tracing. For example:
+;;;   (sb-c::with-compile-profile (:trace-file "/tmp/build.json")
+;;;     (asdf:load-system :foo :force t))
+(defmacro with-compile-profile ((&rest keys &key summary trace-file)
+                                &body body)
+  (declare (ignore summary trace-file))
+  `(dx-flet ((profiled () ,@body))
+     (call-with-compile-profile #'profiled ,@keys)))
 
 (deftype object () '(or fasl-output core-object null))
 (declaim (type object *compile-object*))
@@ -413,7 +571,8 @@ necessary, since type inference may take arbitrarily long to converge.")
               cleared-reanalyze t
               (component-reanalyze component) nil))
       (setf (component-reoptimize component) nil)
-      (ir1-optimize component fastp)
+      (with-compile-phase-timing (:ir1-optimize)
+        (ir1-optimize component fastp))
       (cond ((component-reoptimize component)
              (incf count)
              (when (and (>= count *max-optimize-iterations*)
@@ -475,7 +634,8 @@ necessary, since type inference may take arbitrarily long to converge.")
         (dfo-as-needed component)
         (when *constraint-propagate*
           (maybe-mumble "Constraint ")
-          (constraint-propagate component)
+          (with-compile-phase-timing (:constraint)
+            (constraint-propagate component))
           (when (retry-delayed-ir1-transforms :constraint)
             (setf loop-count 0) ;; otherwise nothing may get retried
             (maybe-mumble "Rtran ")))
@@ -565,9 +725,11 @@ necessary, since type inference may take arbitrarily long to converge.")
 (defun %compile-component (component)
   (let ((*adjustable-vectors* nil)) ; Needed both by codegen and fasl writer
     (maybe-mumble "GTN ")
-    (gtn-analyze component)
+    (with-compile-phase-timing (:gtn)
+      (gtn-analyze component))
     (maybe-mumble "LTN ")
-    (ltn-analyze component)
+    (with-compile-phase-timing (:ltn)
+      (ltn-analyze component))
     (dfo-as-needed component)
 
     (maybe-mumble "Control ")
@@ -596,7 +758,8 @@ necessary, since type inference may take arbitrarily long to converge.")
     ;; computed results may be stale.
     (clear-dominators component)
 
-    (ir2-convert component)
+    (with-compile-phase-timing (:ir2-convert)
+      (ir2-convert component))
 
     (when (policy *lexenv* (>= speed compilation-speed))
       (maybe-mumble "Copy ")
@@ -605,7 +768,7 @@ necessary, since type inference may take arbitrarily long to converge.")
     (ir2-optimize component)
 
     (select-representations component)
-    ;; Try to combine consecutive uses of %INSTANCE-SET.
+    ;; Try to combine consecutive uses of %INSTANCE-SET, and of BIND.
     ;; This can't be done prior to selecting representations
     ;; because SELECT-REPRESENTATIONS might insert some
     ;; things like MOVE-FROM-DOUBLE which makes the
@@ -619,7 +782,8 @@ necessary, since type inference may take arbitrarily long to converge.")
     (delete-unreferenced-tns component)
 
     (maybe-mumble "Life ")
-    (lifetime-analyze component)
+    (with-compile-phase-timing (:life)
+      (lifetime-analyze component))
 
     (when *compile-progress*
       (compiler-mumble "")            ; Sync before doing more output.
@@ -630,7 +794,8 @@ necessary, since type inference may take arbitrarily long to converge.")
       (check-life-consistency component))
 
     (maybe-mumble "Pack ")
-    (sb-regalloc:pack component)
+    (with-compile-phase-timing (:pack)
+      (sb-regalloc:pack component))
 
     (when *check-consistency*
       (maybe-mumble "CheckP ")
@@ -651,7 +816,8 @@ necessary, since type inference may take arbitrarily long to converge.")
         (let ((*compiler-trace-output*
                 (and (memq :vop *compile-trace-targets*)
                      *compiler-trace-output*)))
-          (generate-code component))
+          (with-compile-phase-timing (:code)
+            (generate-code component)))
       (declare (ignorable text-length fun-table))
 
       (let ((bytes (sb-assem:segment-contents-as-vector segment))
@@ -673,15 +839,16 @@ necessary, since type inference may take arbitrarily long to converge.")
             (sb-disassem:disassemble-assem-segment
              bytes ranges *compiler-trace-output*)))
 
-        (funcall (etypecase object
-                   (fasl-output (maybe-mumble "FASL") #'fasl-dump-component)
-                   #-sb-xc-host         ; no compiling to core
-                   (core-object (maybe-mumble "Core") #'make-core-component)
-                   (null (lambda (&rest dummies)
-                           (declare (ignore dummies)))))
-                 component segment (length bytes)
-                 fixup-notes alloc-points
-                 object))))
+        (with-compile-phase-timing (:dump)
+          (funcall (etypecase object
+                     (fasl-output (maybe-mumble "FASL") #'fasl-dump-component)
+                     #-sb-xc-host         ; no compiling to core
+                     (core-object (maybe-mumble "Core") #'make-core-component)
+                     (null (lambda (&rest dummies)
+                             (declare (ignore dummies)))))
+                   component segment (length bytes)
+                   fixup-notes alloc-points
+                   object)))))
 
   ;; We're done, so don't bother keeping anything around.
   (setf (component-info component) :dead)
@@ -724,57 +891,57 @@ necessary, since type inference may take arbitrarily long to converge.")
     (aver (eql (node-component (lambda-bind lambda)) component)))
 
   (let* ((*component-being-compiled* component))
+    (with-compile-phase-timing (:component)
+      (when *compile-progress*
+        (compiler-mumble "~&")
+        (pprint-logical-block (*standard-output* nil :per-line-prefix "; ")
+          (compiler-mumble "Compiling ~A: " (component-name component))))
 
-    (when *compile-progress*
-      (compiler-mumble "~&")
-      (pprint-logical-block (*standard-output* nil :per-line-prefix "; ")
-        (compiler-mumble "Compiling ~A: " (component-name component))))
-
-    ;; Record xref information before optimization. This way the
-    ;; stored xref data reflects the real source as closely as
-    ;; possible.
-    (record-component-xrefs component)
+      ;; Record xref information before optimization. This way the
+      ;; stored xref data reflects the real source as closely as
+      ;; possible.
+      (record-component-xrefs component)
 
-    (ir1-phases component)
+      (ir1-phases component)
 
-    ;; This should happen at some point before ENVIRONMENT-ANALYZE,
-    ;; and after RECORD-COMPONENT-XREFS.  Beyond that, I haven't
-    ;; really thought things through.  -- AJB, 2014-Jun-08
-    (eliminate-dead-code component)
+      ;; This should happen at some point before ENVIRONMENT-ANALYZE,
+      ;; and after RECORD-COMPONENT-XREFS.  Beyond that, I haven't
+      ;; really thought things through.  -- AJB, 2014-Jun-08
+      (eliminate-dead-code component)
 
-    (when *loop-analyze*
+      (when *loop-analyze*
+        (dfo-as-needed component)
+        (maybe-mumble "Dom ")
+        (find-dominators component)
+        (maybe-mumble "Loop ")
+        (loop-analyze component))
+
+      #|
+      (when (and *loop-analyze* *compiler-trace-output*)
+        (labels ((print-blocks (block)
+                   (format *compiler-trace-output* "    ~A~%" block)
+                   (when (block-loop-next block)
+                     (print-blocks (block-loop-next block))))
+                 (print-loop (loop)
+                   (format *compiler-trace-output* "loop=~A~%" loop)
+                   (print-blocks (loop-blocks loop))
+                   (dolist (l (loop-inferiors loop))
+                     (print-loop l))))
+          (print-loop (component-outer-loop component))))
+      |#
+
+      (maybe-mumble "Env ")
+      (environment-analyze component)
       (dfo-as-needed component)
-      (maybe-mumble "Dom ")
-      (find-dominators component)
-      (maybe-mumble "Loop ")
-      (loop-analyze component))
-
-    #|
-    (when (and *loop-analyze* *compiler-trace-output*)
-      (labels ((print-blocks (block)
-                 (format *compiler-trace-output* "    ~A~%" block)
-                 (when (block-loop-next block)
-                   (print-blocks (block-loop-next block))))
-               (print-loop (loop)
-                 (format *compiler-trace-output* "loop=~A~%" loop)
-                 (print-blocks (loop-blocks loop))
-                 (dolist (l (loop-inferiors loop))
-                   (print-loop l))))
-        (print-loop (component-outer-loop component))))
-    |#
-
-    (maybe-mumble "Env ")
-    (environment-analyze component)
-    (dfo-as-needed component)
 
-    (delete-if-no-entries component)
+      (delete-if-no-entries component)
 
-    (if (eq (block-next (component-head component))
-            (component-tail component))
-        (report-code-deletion)
-        (%compile-component component))
-    (when *compile-component-hook*
-      (funcall *compile-component-hook* component)))
+      (if (eq (block-next (component-head component))
+              (component-tail component))
+          (report-code-deletion)
+          (%compile-component component))
+      (when *compile-component-hook*
+        (funcall *compile-component-hook* component))))
 
   (clear-constant-info)
   (values))
@@ -1068,7 +1235,8 @@ necessary, since type inference may take arbitrarily long to converge.")
                           :policy *policy*
                           :handled-conditions *handled-conditions*
                           :disabled-package-locks *disabled-package-locks*))
-               (tll (ir1-toplevel form path nil)))
+               (tll (with-compile-phase-timing (:ir1-convert)
+                      (ir1-toplevel form path nil))))
           (if (eq (block-compile *compilation*) t)
               (push tll (toplevel-lambdas *compilation*))
               (compile-toplevel (list tll) nil))
@@ -1255,9 +1423,10 @@ necessary, since type inference may take arbitrarily long to converge.")
                       :policy *policy*
                       :handled-conditions *handled-conditions*
                       :disabled-package-locks *disabled-package-locks*))
-           (fun (make-functional-from-toplevel-lambda lambda-expression
-                                                      :name name
-                                                      :path path)))
+           (fun (with-compile-phase-timing (:ir1-convert)
+                  (make-functional-from-toplevel-lambda lambda-expression
+                                                        :name name
+                                                        :path path))))
 
       ;; FIXME: The compile-it code from here on is sort of a
       ;; twisted version of the code in COMPILE-TOPLEVEL. It'd be
@@ -1745,10 +1914,13 @@ necessary, since type inference may take arbitrarily long to converge.")
                          (lexenv-handled-conditions *lexenv*))))
       (and ctype (handle-p condition (car ctype))))))
 
-;;; Read all forms from INFO and compile them, with output to
+;;; Read all forms from each of INFOS and compile them, with output to
 ;;; *COMPILE-OBJECT*. Return (VALUES ABORT-P WARNINGS-P FAILURE-P).
-(defun sub-compile-file (info cfasl)
-  (declare (type source-info info))
+;;; The files share one compilation, so that block compilation spans
+;;; them, but each sees the reader and compiler variables as they were
+;;; at the start, as if by its own COMPILE-FILE.
+(defun sub-compile-file (infos cfasl)
+  (declare (type list infos))
   (let ((*package* (sane-package))
         (*readtable* *readtable*)
         (*compile-file-pathname* nil) ; set by GET-SOURCE-STREAM
@@ -1787,29 +1959,39 @@ necessary, since type inference may take arbitrarily long to converge.")
         (handler-bind (((satisfies handle-condition-p) #'handle-condition-handler))
           (with-compilation-values
             (with-compilation-unit ()
-                (setf (sb-fasl::fasl-output-source-info *compile-object*)
-                      (debug-source-for-info info))
                 (with-ir1-namespace
-                  (do-forms-from-info ((form current-index) info
-                                       'input-error-in-compile-file)
-                    (with-source-paths
-                      (find-source-paths form current-index)
-                      (let ((*gensym-counter* 0))
-                        (when *compile-print*
-                          (note-top-level-form form))
-                        (process-toplevel-form
-                         form `(original-source-start 0 ,current-index) nil))))
-                  (let ((*source-info* info))
+                  (dolist (info infos)
+                    (let ((*package* *package*)
+                          (*readtable* *readtable*)
+                          (*policy* *policy*)
+                          (*macro-policy* *macro-policy*)
+                          (*handled-conditions* *handled-conditions*)
+                          (*disabled-package-locks* *disabled-package-locks*))
+                      (setf (sb-fasl::fasl-output-source-info *compile-object*)
+                            (debug-source-for-info info))
+                      (do-forms-from-info ((form current-index) info
+                                           'input-error-in-compile-file)
+                        (with-source-paths
+                          (find-source-paths form current-index)
+                          (let ((*gensym-counter* 0))
+                            (when *compile-print*
+                              (note-top-level-form form))
+                            (process-toplevel-form
+                             form `(original-source-start 0 ,current-index) nil))))
+                      (let ((code-coverage-records
+                              (code-coverage-records (coverage-metadata *compilation*))))
+                        (unless (zerop (hash-table-count code-coverage-records))
+                          ;; Dump the code coverage records of this file into the fasl.
+                          (sb-fasl::dump-code-coverage-records
+                           (namestring *compile-file-pathname*)
+                           (loop for k being each hash-key of code-coverage-records
+                                 collect (cons k +code-coverage-unmarked+))
+                           *compile-object*)
+                          (clrhash code-coverage-records)))))
+                  ;; What is left of a block spanning several files is attributed
+                  ;; to the last of them.
+                  (let ((*source-info* (car (last infos))))
                     (finish-block-compilation)))
-                (let ((code-coverage-records
-                       (code-coverage-records (coverage-metadata *compilation*))))
-                  (unless (zerop (hash-table-count code-coverage-records))
-                    ;; Dump the code coverage records into the fasl.
-                    (sb-fasl::dump-code-coverage-records
-                     (namestring *compile-file-pathname*)
-                     (loop for k being each hash-key of code-coverage-records
-                           collect (cons k +code-coverage-unmarked+))
-                     *compile-object*)))
                 nil)))
       ;; Some errors are sufficiently bewildering that we just fail
       ;; immediately, without trying to recover and compile more of
@@ -1957,8 +2139,83 @@ returning its filename.
                  ((:block-compile *block-compile-argument*) *block-compile-default*)
                  ((:entry-points *entry-points-argument*) nil)
                  (emit-cfasl *emit-cfasl*))
+  "Compile the files in INPUTS, a list, one after another into one fasl,
+named after the first file unless :OUTPUT-FILE is given. The keyword
+arguments are as for COMPILE-FILE. With :BLOCK-COMPILE T the files are
+compiled as a unit, so that a call from one file to a function defined
+in another, such as between the files of a system, can be a local call.
+:ENTRY-POINTS then names the functions of all the files which get
+global definitions."
   (%compile-files inputs external-format output-file-p output-file trace-file emit-cfasl))
 
+#-sb-xc-host
+(defun compile-files-in-parallel (inputs &rest args &key threads &allow-other-keys)
+  "Compile each file in INPUTS as if by COMPILE-FILE with the other keyword
+arguments, in up to THREADS threads at once. THREADS defaults to the number
+of online processors. Return a list of the output truenames in the order of
+INPUTS, and whether any file had warnings and whether any file failed, as in
+the second and third values of COMPILE-FILE.
+
+The files must not depend on one another at compile time: a macro, package
+or type defined by one of them is seen by another only by chance. Each file
+is compiled in its own compilation unit, with the values of the reader and
+compiler variables that are current in the caller. What each compilation
+writes to *STANDARD-OUTPUT* or *ERROR-OUTPUT* is collected and written to
+*STANDARD-OUTPUT* in the order of INPUTS once all files are done. An error
+signaled out of COMPILE-FILE does not stop the other files. The first such
+error is signaled again afterwards."
+  (when (get-properties args '(:output-file))
+    (error "~S can't be used with ~S." :output-file 'compile-files-in-parallel))
+  (let* ((inputs (coerce inputs 'simple-vector))
+         (n (length inputs))
+         (args (let ((args (copy-list args))) (remf args :threads) args))
+         (results (make-array n :initial-element nil))
+         (outputs (make-array n :initial-element ""))
+         (next (list 0))
+         (variables '(*package* *readtable* *default-pathname-defaults*
+                      *features* *read-base* *read-default-float-format* *read-eval*
+                      *compile-verbose* *compile-print* *compile-progress*
+                      *block-compile-default* *evaluator-mode*
+                      *policy* *handled-conditions* *disabled-package-locks*))
+         (bindings (mapcar #'symbol-value variables)))
+    (declare (index n))
+    (flet ((work ()
+             (progv variables bindings
+               (loop for i of-type index = (atomic-incf (car next))
+                     while (< i n)
+                     do (let ((stream (make-string-output-stream)))
+                          (setf (svref results i)
+                                (let ((*standard-output* stream)
+                                      (*error-output* stream))
+                                  (handler-case
+                                      (multiple-value-list
+                                       (apply #'compile-file (svref inputs i) args))
+                                    (error (condition) condition)))
+                                (svref outputs i)
+                                (get-output-stream-string stream)))))))
+      (let ((n-threads (min n (or threads
+                                  (alien-funcall
+                                   (extern-alien "sb_online_processor_count"
+                                                 (function int)))))))
+        (declare (ignorable n-threads))
+        #+sb-thread
+        (if (> n-threads 1)
+            (mapc (lambda (thread) (sb-thread:join-thread thread :default nil))
+                  (loop repeat n-threads
+                        collect (sb-thread:make-thread #'work
+                                                       :name "compile-file worker")))
+            (work))
+        #-sb-thread
+        (work)))
+    (loop for output across outputs do (write-string output))
+    (let ((condition (find-if (lambda (result) (typep result 'condition)) results)))
+      (when condition
+        (error condition)))
+    ;; A NIL result means a worker thread died while compiling that file.
+    (values (map 'list #'car results)
+            (some #'second results)
+            (some (lambda (result) (or (null result) (third result))) results))))
+
 (defun %compile-files (inputs external-format output-file-p output-file
                        trace-file emit-cfasl)
   (let* ((output-file-pathname nil)
@@ -2003,9 +2260,13 @@ returning its filename.
 
           (let ((*compile-object* fasl-output))
             (setf abort-p nil failure-p nil)
-            (dolist (source-info source-infos)
+            ;; With :BLOCK-COMPILE T, calls between the files can be local
+            ;; calls, so they are compiled together.
+            (dolist (infos (if (eq *block-compile-argument* t)
+                               (list source-infos)
+                               (mapcar #'list source-infos)))
               (multiple-value-bind (sub-abort-p sub-warnings-p sub-failure-p)
-                  (sub-compile-file source-info cfasl-output)
+                  (sub-compile-file infos cfasl-output)
                 (setf abort-p (or abort-p sub-abort-p)
                       warnings-p (or warnings-p sub-warnings-p)
                       failure-p (or failure-p sub-failure-p))))))
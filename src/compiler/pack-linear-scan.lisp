@@ -0,0 +1,243 @@
+;;;; This file contains a linear-scan register allocator, used instead
+;;;; of the greedy or the iterative packer when compilation speed
+;;;; matters more than the quality of the allocation, such as for huge
+;;;; machine-generated functions.
+
+;;;; This software is part of the SBCL system. See the README file for
+;;;; more information.
+;;;;
+;;;; This software is derived from the CMU CL system, which was
+;;;; written at Carnegie Mellon University and released into the
+;;;; public domain. The software is in the public domain and is
+;;;; provided with absolutely no warranty. See the COPYING and CREDITS
+;;;; files for more information.
+
+(in-package "SB-REGALLOC")
+
+;;;; live intervals
+
+;;; Number the TN-REFs of COMPONENT in reference order, and return a
+;;; hash-table mapping each referenced or live TN to a cons (START .
+;;; END) of the smallest interval of those numbers covering its
+;;; lifetime, as computed by lifetime analysis.
+;;; -- A global TN covers every block it appears in the global
+;;;    conflicts of, from the start to the end of the block, whatever
+;;;    the kind of the conflict.
+;;; -- A local TN covers its references. A write may be live until the
+;;;    end of its VOP (see ENSURE-RESULTS-LIVE), so a write extends
+;;;    the interval at least to there. VOP-REFS runs in reverse order
+;;;    of reference, so the same order that CONFLICT-ANALYZE-1-BLOCK
+;;;    uses to decide which operands of a VOP conflict.
+;;; -- A :COMPONENT TN covers everything.
+;;;
+;;; Since blocks are numbered one after another, two TNs whose
+;;; intervals are disjoint never conflict, in whatever order the
+;;; blocks are executed. The converse does not hold: an interval can
+;;; have holes, so this is more conservative than CONFLICTS-IN-SC.
+(defun compute-live-intervals (component)
+  (declare (type component component))
+  (let ((intervals (make-hash-table :test 'eq))
+        (time 0))
+    (declare (type index time))
+    (flet ((note (tn start end)
+             (declare (type index start end))
+             (let ((interval (gethash tn intervals)))
+               (if interval
+                   (setf (car interval) (min (the index (car interval)) start)
+                         (cdr interval) (max (the index (cdr interval)) end))
+                   (setf (gethash tn intervals) (cons start end))))))
+      (do-ir2-blocks (block component)
+        (let ((block-start (incf time)))
+          (do ((vop (ir2-block-start-vop block) (vop-next vop)))
+              ((null vop))
+            (let ((vop-end (+ time (do ((ref (vop-refs vop) (tn-ref-next-ref ref))
+                                        (count 1 (1+ count)))
+                                       ((null ref) count)
+                                     (declare (type index count))))))
+              (do ((ref (vop-refs vop) (tn-ref-next-ref ref))
+                   (ref-time (1- vop-end) (1- ref-time)))
+                  ((null ref))
+                (declare (type index ref-time))
+                (let ((tn (tn-ref-tn ref)))
+                  (unless (tn-global-conflicts tn)
+                    (note tn ref-time (if (tn-ref-write-p ref) vop-end ref-time)))))
+              (setf time vop-end)))
+          (do ((conf (ir2-block-global-tns block)
+                     (global-conflicts-next-blockwise conf)))
+              ((null conf))
+            (note (global-conflicts-tn conf) block-start time)))))
+    (maphash (lambda (tn interval)
+               (when (eq (tn-kind tn) :component)
+                 (setf (car interval) 0
+                       (cdr interval) time)))
+             intervals)
+    intervals))
+
+;;;; location bookkeeping
+
+;;; What the scan knows about the locations of a :FINITE SB.
+(defstruct (scan-sb (:constructor make-scan-sb
+                        (sb &aux (size (sb-size sb))
+                                 (free-after (make-array size
+                                                         :element-type 'fixnum
+                                                         :initial-element -1))
+                                 (fixed (map-into (make-array size)
+                                                  (lambda () (list nil))))))
+                    (:copier nil)
+                    (:predicate nil))
+  (sb nil :type storage-base :read-only t)
+  ;; the end of the last interval the scan itself packed in each
+  ;; location. As intervals are packed in order of their start, a new
+  ;; interval overlaps one of those iff it starts no later than this.
+  (free-after nil :type (simple-array fixnum (*)) :read-only t)
+  ;; for each location, a header cons followed by the intervals of the
+  ;; TNs packed there before the scan, sorted by start. Intervals that
+  ;; have ended are dropped as the scan passes them.
+  (fixed nil :type simple-vector :read-only t))
+
+;;; Return true if the interval from START to END overlaps an
+;;; interval in FIXED, a header cons as in SCAN-SB-FIXED.
+(defun fixed-interval-conflict-p (fixed start end)
+  (declare (type cons fixed) (type index start end))
+  (let ((prev fixed))
+    (loop
+      (let ((rest (cdr prev)))
+        (when (null rest)
+          (return nil))
+        (let ((interval (car rest)))
+          (cond ((> (the index (car interval)) end)
+                 (return nil))
+                ((>= (the index (cdr interval)) start)
+                 (return t))
+                (t
+                 ;; Ended before START, so before anything that the
+                 ;; scan will ask about from now on.
+                 (setf (cdr prev) (cdr rest)))))))))
+
+;;; Return true if SIZE locations from OFFSET are free over the
+;;; interval from START to END.
+(defun scan-locations-free-p (scan-sb offset size start end)
+  (declare (type scan-sb scan-sb) (type index offset size start end))
+  (let ((free-after (scan-sb-free-after scan-sb))
+        (fixed (scan-sb-fixed scan-sb)))
+    (loop for i from offset below (+ offset size)
+          always (and (< (aref free-after i) start)
+                      (not (fixed-interval-conflict-p (svref fixed i)
+                                                      start end))))))
+
+;;;; the scan
+
+;;; Pack wired and restricted TNs as usual, then walk the normal TNs
+;;; in order of the start of their live interval, and give each one
+;;; the first location (preferring that of a target TN) which is free
+;;; over the whole interval. A TN for which there is no such location
+;;; is left for the final pass in PACK, which packs it with precise
+;;; conflicts, likely on the stack.
+;;;
+;;; This never looks at the conflict bit-vectors, except to record
+;;; the TNs it packs in them for the packing of load TNs, so its cost
+;;; is linear in the size of the component. The price is that TNs
+;;; with long intervals full of holes, such as loop variables, keep
+;;; their register over the holes, and that the order of packing
+;;; ignores TN costs.
+(defun pack-linear-scan (component 2comp)
+  (declare (type component component) (type ir2-component 2comp))
+  (do ((tn (ir2-component-wired-tns 2comp) (tn-next tn)))
+      ((null tn))
+    (unless (eq (tn-kind tn) :arg-pass)
+      (pack-wired-tn tn)))
+  (collect ((component)
+            (normal))
+    (do ((tn (ir2-component-restricted-tns 2comp) (tn-next tn)))
+        ((null tn))
+      (unless (or (tn-offset tn) (unbounded-tn-p tn))
+        (if (eq :component (tn-kind tn))
+            (component tn)
+            (normal tn))))
+    (flet ((pack-tns (tns)
+             (dolist (tn (stable-sort tns #'> :key #'tn-cost))
+               (pack-tn tn t))))
+      (pack-tns (component))
+      (pack-tns (normal))))
+
+  (let ((intervals (compute-live-intervals component))
+        (scan-sbs '())
+        (fixed '())
+        (candidates '()))
+    (flet ((find-scan-sb (sb)
+             (or (find sb scan-sbs :key #'scan-sb-sb)
+                 (car (push (make-scan-sb sb) scan-sbs)))))
+      ;; Collect the intervals of the TNs already packed in registers,
+      ;; and the TNs left for the scan.
+      (flet ((collect-tns (head)
+               (do ((tn head (tn-next tn)))
+                   ((null tn))
+                 (let ((interval (gethash tn intervals)))
+                   (when interval
+                     (cond ((tn-offset tn)
+                            (when (and (eq (sb-kind (sc-sb (tn-sc tn))) :finite)
+                                       (neq (tn-kind tn) :arg-pass))
+                              (push (cons interval tn) fixed)))
+                           ((and (eq (tn-kind tn) :normal)
+                                 (not (unbounded-tn-p tn)))
+                            (push (cons interval tn) candidates))))))))
+        (collect-tns (ir2-component-wired-tns 2comp))
+        (collect-tns (ir2-component-restricted-tns 2comp))
+        (collect-tns (ir2-component-normal-tns 2comp)))
+      ;; Sorting by decreasing start and pushing leaves each list of
+      ;; fixed intervals sorted by increasing start.
+      (dolist (entry (sort fixed #'> :key #'caar))
+        (destructuring-bind (interval . tn) entry
+          (let* ((sc (tn-sc tn))
+                 (locations (scan-sb-fixed (find-scan-sb (sc-sb sc)))))
+            (loop for i from (tn-offset tn)
+                  repeat (sc-element-size sc)
+                  do (push interval (cdr (svref locations i)))))))
+
+      (dolist (entry (stable-sort (nreverse candidates) #'< :key #'caar))
+        (destructuring-bind ((start . end) . tn) entry
+          (flet ((try-sc (sc)
+                   (let* ((sb (sc-sb sc))
+                          (scan-sb (find-scan-sb sb))
+                          (size (sc-element-size sc)))
+                     (flet ((free-p (offset)
+                              (scan-locations-free-p scan-sb offset size
+                                                     start end)))
+                       (or (do-target-tns (target tn)
+                             (let ((offset (tn-offset target)))
+                               (when (and offset
+                                          (neq (tn-kind target) :arg-pass)
+                                          (eq (sc-sb (tn-sc target)) sb)
+                                          (sc-locations-member offset
+                                                               (sc-locations sc))
+                                          (= (sc-element-size (tn-sc target))
+                                             size)
+                                          (free-p offset))
+                                 (return-from try-sc offset))))
+                           (let* ((locations (sc-locations sc))
+                                  (wired (logandc2 (finite-sb-wired-map sb)
+                                                   (sc-reserve-locations sc))))
+                             (do-sc-locations (offset (logandc2 locations wired)
+                                                      nil size)
+                               (when (free-p offset)
+                                 (return-from try-sc offset)))
+                             (do-sc-locations (offset (logand locations wired)
+                                                      nil size)
+                               (when (free-p offset)
+                                 (return-from try-sc offset)))))))))
+            (do ((sc (tn-sc tn) (pop alternates))
+                 (alternates (sc-alternate-scs (tn-sc tn))))
+                ((null sc))
+              (when (and (eq (sb-kind (sc-sb sc)) :finite)
+                         (not (and (minusp (tn-cost tn)) (sc-save-p sc))))
+                (let ((offset (try-sc sc)))
+                  (when offset
+                    (let ((free-after (scan-sb-free-after
+                                        (find-scan-sb (sc-sb sc)))))
+                      (loop for i from offset
+                            repeat (sc-element-size sc)
+                            do (setf (aref free-after i) end)))
+                    (add-location-conflicts tn sc offset)
+                    (setf (tn-sc tn) sc
+                          (tn-offset tn) offset)
+                    (return)))))))))))
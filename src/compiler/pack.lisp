@@ -1570,16 +1570,17 @@
           most-positive-fixnum
           (length path)))))
 
-(declaim (type (member :iterative :greedy :adaptive)
+(declaim (type (member :iterative :greedy :linear-scan :adaptive)
                *register-allocation-method*))
 (defvar *register-allocation-method* :adaptive)
 
-(declaim (ftype function pack-greedy pack-iterative))
+(declaim (ftype function pack-greedy pack-iterative pack-linear-scan))
 
 (defun pack (component)
   (unwind-protect
        (let ((optimize nil)
              (speed-3 nil)
+             (linear-scan nil)
              (2comp (component-info component)))
          (init-sb-vectors component)
 
@@ -1590,6 +1591,8 @@
          ;; Also, determine if any such block also declares (speed 3),
          ;; in which case :adaptive register allocation will switch to
          ;; the iterative Chaitin-Briggs spilling/coloring algorithm.
+         ;; A block asking for LINEAR-SCAN-REGISTER-ALLOCATION overrides
+         ;; that, in favour of the cheapest allocator.
          ;;
          ;; FIXME: This means that a declaration can have a minor
          ;; effect even outside its scope, and as the packing is done
@@ -1603,8 +1606,9 @@
              (when (policy block (> speed compilation-speed))
                (setf optimize t)
                (when (policy block (= speed 3))
-                 (setf speed-3 t)
-                 (return)))))
+                 (setf speed-3 t)))
+             (when (policy block (> sb-c::linear-scan-register-allocation 1))
+               (setf linear-scan t))))
 
          ;; Assign costs to normal TNs so we know which ones should always
          ;; be packed on the stack, and which are important not to spill.
@@ -1619,7 +1623,10 @@
          (funcall (ecase *register-allocation-method*
                     (:greedy #'pack-greedy)
                     (:iterative #'pack-iterative)
-                    (:adaptive (if speed-3 #'pack-iterative #'pack-greedy)))
+                    (:linear-scan #'pack-linear-scan)
+                    (:adaptive (cond (linear-scan #'pack-linear-scan)
+                                     (speed-3 #'pack-iterative)
+                                     (t #'pack-greedy))))
                   component 2comp)
 
          ;; Pack any leftover normal/restricted TN that is not already
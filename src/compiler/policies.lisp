@@ -158,6 +158,28 @@ this declaration does not prevent out-of-line function calls, which
 will encounter safepoints unless the target function has also been
 compiled with this declaration in effect.")
 
+(define-optimization-quality linear-scan-register-allocation
+    0
+  ("no" "no" "yes" "yes")
+  "When enabled, registers are allocated in a single linear scan over
+the live ranges of the TNs. This is much faster than the default for
+very large functions, but generates worse code.")
+
+(define-optimization-quality generic-function-inline-caches
+    0
+  ("no" "no" "yes" "yes")
+  "When enabled, a call to a function known to be generic checks the
+class of its first argument against the few classes seen at that call
+site before falling back to the discriminating function.")
+
+(define-optimization-quality stack-allocate-non-escaping
+    (if (> speed (max space debug 1)) 3 0)
+  ("no" "no" "yes" "yes")
+  "When enabled, a list, vector or structure made for a LET variable
+or a local function's argument is allocated on the stack, as if the
+variable were declared DYNAMIC-EXTENT, if the compiler can prove that
+nothing refers to it once the variable goes out of scope.")
+
 (define-optimization-quality store-closure-debug-pointer
     0
   ("no" "no" "yes" "yes"))
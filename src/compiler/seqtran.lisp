@@ -383,6 +383,29 @@
             (t
              (%give-up))))))
 
+;;; Element-wise +, - or * of two vectors of floats into a third, of
+;;; the same format, is done by the backend several elements at a time.
+;;; Being defined after the general transform, this one is tried first.
+#+x86-64
+(macrolet ((def (type)
+             `(deftransform map-into ((result fun a b)
+                                      ((simple-array ,type (*)) t
+                                       (simple-array ,type (*))
+                                       (simple-array ,type (*)))
+                                      * :policy (> speed space))
+                "use packed float arithmetic"
+                (let ((op (find-if (lambda (name) (lvar-fun-is fun (list name)))
+                                   '(+ - *))))
+                  (unless op
+                    (give-up-ir1-transform))
+                  `(progn
+                     (sb-vm::%float-vector-op ',op result a b
+                                              (min (length result) (length a)
+                                                   (length b)))
+                     result)))))
+  (def single-float)
+  (def double-float))
+
 
 ;;; FIXME: once the confusion over doing transforms with known-complex
 ;;; arrays is over, we should also transform the calls to (AND (ARRAY
@@ -2286,6 +2309,36 @@
                (values item (the index (- (truly-the index p) offset)))
                (values nil nil))))))
 
+;;; Search octet vectors and base-strings a word at a time
+(macrolet ((def (type item-type code)
+             `(deftransform %find-position ((item sequence from-end start end key test)
+                                            (t ,type t t t t t)
+                                            * :node node)
+                (when (and test (lvar-fun-is test '(eq eql equal)))
+                  (setf test nil))
+                (when (and key (lvar-fun-is key '(identity)))
+                  (setf key nil))
+                (when (or test key)
+                  (delay-ir1-transform node :optimize)
+                  (give-up-ir1-transform "non-trivial :KEY or :TEST"))
+                (let ((from-end (cond ((not (constant-lvar-p from-end)) 'from-end)
+                                      ((lvar-value from-end) t))))
+                  `(if (typep item ',',item-type)
+                       (with-array-data ((data sequence :offset-var offset)
+                                         (start start)
+                                         (end end)
+                                         :check-fill-pointer t)
+                         (let ((p ,(case from-end
+                                     ((t) `(%octet-pos-rev ,',code data start end))
+                                     ((nil) `(%octet-pos-fwd ,',code data start end))
+                                     (t `(%octet-position ,',code data from-end start end)))))
+                           (if p
+                               (values item (the index (- (truly-the index p) offset)))
+                               (values nil nil))))
+                       (values nil nil))))))
+  (def (vector (unsigned-byte 8)) (unsigned-byte 8) item)
+  (def base-string base-char (char-code item)))
+
 (deftransform %find-position ((item sequence from-end start end key test)
                               (character string t t t function function)
                               *
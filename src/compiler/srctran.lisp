@@ -4981,6 +4981,24 @@
                               (%coerce-callable-to-fun predicate)
                               (if key (%coerce-callable-to-fun key) #'identity)))
 
+;;; Vectors that SB-IMPL::RADIX-SORT-VECTOR handles are passed straight
+;;; to the out-of-line numeric sorters instead of the inline heapsort.
+(deftransform sort ((sequence predicate &key key)
+                    ((or (simple-array (unsigned-byte 32) (*))
+                         #+64-bit (simple-array fixnum (*))
+                         #+64-bit (simple-array double-float (*)))
+                     t &rest t))
+  (unless (and (lvar-fun-is predicate '(< >))
+               (or (not key)
+                   (lvar-fun-is key '(identity))
+                   (and (constant-lvar-p key) (null (lvar-value key)))))
+    (give-up-ir1-transform))
+  ;; It always sorts these, unless there is nothing to sort.
+  `(progn
+     (sb-impl::numeric-sort-vector sequence 0 (length sequence)
+                                   (%coerce-callable-to-fun predicate) nil)
+     sequence))
+
 (deftransform stable-sort ((sequence predicate &key key)
                            ((or vector list) t))
   (let ((sequence-type (lvar-type sequence)))
@@ -115,6 +115,199 @@
                               :message message
                               :source source)))))))))))
 
+;;;; persistent compilation cache
+
+(declaim (type (or null pathname string) *compile-cache-directory*))
+(defvar *compile-cache-directory* nil
+  "If not NIL, the pathname of a directory in which (COMPILE NIL LAMBDA)
+keeps a fasl of each lambda expression it compiles, so that compiling
+the same expression again, in this process or another, loads the fasl
+instead. Expressions are the same if they print the same readably,
+under the same policy and version of SBCL, and the global functions and
+variables which they name have the same kinds, declared types, constant
+values and inline expansions. Changes to macros go unnoticed: delete
+the fasls after changing a macro which cached expressions use.
+Expressions with constants which don't print readably aren't cached.")
+
+;;; Set by loading a fasl of the cache to the key, a string, and the
+;;; function
+(defvar *compile-cache-entry*)
+
+;;; For temporary names that no other thread uses
+(define-load-time-global *compile-cache-counter* (list 0))
+
+;;; What the global environment says about the names in FORM which
+;;; could change the code compiled for it, other than those in CL,
+;;; which can't be redefined.
+(defun compile-cache-global-state (form)
+  (let ((seen (make-hash-table :test 'eq))
+        (state nil))
+    (labels ((walk (x)
+               (cond ((gethash x seen))
+                     ((consp x)
+                      (setf (gethash x seen) t)
+                      (walk (car x))
+                      (walk (cdr x)))
+                     ((and (symbolp x) x
+                           (symbol-package x)
+                           (not (eq (symbol-package x) *cl-package*))
+                           (not (eq (symbol-package x) *keyword-package*)))
+                      (setf (gethash x seen) t)
+                      (let ((fun-kind (info :function :kind x))
+                            (var-kind (info :variable :kind x)))
+                        (when (or fun-kind (neq var-kind :unknown))
+                          (push (list x fun-kind
+                                      (when (eq (info :function :where-from x) :declared)
+                                        (type-specifier (global-ftype x)))
+                                      (info :function :inlinep x)
+                                      (fun-name-inline-expansion x)
+                                      var-kind
+                                      (type-specifier (info :variable :type x))
+                                      (when (eq var-kind :constant)
+                                        (symbol-value x)))
+                                state)))))))
+      (walk form))
+    state))
+
+;;; The key of FORM in the cache, or NIL if FORM can't be cached
+(defun compile-cache-key (form)
+  (handler-case
+      (with-standard-io-syntax
+        (let ((*package* *keyword-package*)
+              (*print-circle* t))
+          (prin1-to-string
+           (list (lisp-implementation-version)
+                 sb-fasl::+fasl-file-version+
+                 (policy-to-decl-spec *policy*)
+                 form
+                 (compile-cache-global-state form)))))
+    (print-not-readable () nil)))
+
+;;; Compile FORM in the null lexical environment, from the cache if it
+;;; has FORM. A miss compiles FORM as usual, for the conditions and the
+;;; function to return, and then with COMPILE-FILE, quietly, to fill the
+;;; cache. Fasls are written under a temporary name and renamed, so that
+;;; other processes sharing the directory never load one that isn't
+;;; complete.
+(defun compile-cached (form)
+  (let* ((key (compile-cache-key form))
+         (fasl (when key
+                 (merge-pathnames (make-pathname :name (format nil "~36R" (sxhash key))
+                                                 :type "fasl")
+                                  *compile-cache-directory*))))
+    (flet ((compile-it ()
+             (compile-in-lexenv form (make-null-lexenv) nil nil nil nil nil)))
+      (unless fasl
+        (return-from compile-cached (compile-it)))
+      (when (probe-file fasl)
+        (let ((entry
+                (let ((*compile-cache-entry* nil))
+                  (handler-case
+                      (progn (load fasl :verbose nil :print nil)
+                             *compile-cache-entry*)
+                    (error () nil)))))
+          (when (and (consp entry) (equal (car entry) key) (functionp (cdr entry)))
+            (return-from compile-cached (values (cdr entry) nil nil)))))
+      (multiple-value-bind (fun warnings-p failure-p) (compile-it)
+        (unless failure-p
+          (let* ((temp (format nil "~A-~D-~D" (pathname-name fasl)
+                               (sb-unix:unix-getpid)
+                               (atomic-incf (car *compile-cache-counter*))))
+                 (source (make-pathname :name temp :type "lisp" :defaults fasl))
+                 (output (make-pathname :name temp :type "tmp" :defaults fasl)))
+            (unwind-protect
+                 (ignore-errors
+                  (ensure-directories-exist fasl)
+                  (with-open-file (stream source :direction :output
+                                                 :if-exists :supersede)
+                    (with-standard-io-syntax
+                      (let ((*package* *keyword-package*)
+                            (*print-circle* t))
+                        (prin1 `(setq *compile-cache-entry*
+                                      (cons ,key (function ,form)))
+                               stream))))
+                  (when (handler-bind ((warning #'muffle-warning))
+                          (let ((*readtable* sb-impl::*standard-readtable*)
+                                (*error-output* (make-broadcast-stream))
+                                (*standard-output* (make-broadcast-stream)))
+                            (compile-file source :output-file output
+                                                 :verbose nil :print nil)))
+                    (rename-file output fasl)))
+              (when (probe-file source) (delete-file source))
+              (when (probe-file output) (delete-file output)))))
+        (values fun warnings-p failure-p)))))
+
+;;;; tiered compilation
+
+(declaim (type (or null (integer 1)) *tiered-compile-threshold*))
+(defvar *tiered-compile-threshold* nil
+  "If NIL, the default, COMPILE compiles with the current policy. If an
+integer, COMPILE first compiles a function cheaply, favouring compilation
+speed, and returns a function which compiles it again with the policy in
+effect at the call to COMPILE once it has been called this many times.
+Calls continue to the cheap version until that compilation is done,
+which happens in a new thread if threads are supported. Warnings are
+reported by the first compilation only.")
+
+;;; The function returned by COMPILE when tiering. Its funcallable
+;;; instance function is a closure counting calls to the cheap version,
+;;; until it is replaced by the fully compiled one.
+(sb-kernel:!defstruct-with-alternate-metaclass tiered-function
+  :slot-names (name form lexenv)
+  :constructor %make-tiered-function
+  :superclass-name function
+  :metaclass-name static-classoid
+  :metaclass-constructor make-static-classoid
+  :dd-type funcallable-structure)
+
+(defmethod print-object ((fun tiered-function) stream)
+  (print-unreadable-object (fun stream :type t :identity t)
+    (prin1 (tiered-function-name fun) stream)))
+
+(defun compile-tiered (form lexenv name threshold)
+  (multiple-value-bind (quick warnings-p failure-p)
+      (compile-in-lexenv form
+                         (make-lexenv
+                          :default lexenv
+                          :policy (process-optimize-decl
+                                   '(optimize (compilation-speed 3) (speed 0)
+                                     (linear-scan-register-allocation 3))
+                                   (lexenv-policy lexenv)))
+                         name nil nil nil nil)
+    (if failure-p
+        (values quick warnings-p failure-p)
+        (let ((fun (%make-tiered-function name form lexenv))
+              (calls 0)
+              (claimed (list nil)))
+          (declare (type fixnum calls))
+          (flet ((recompile ()
+                   ;; The cheap compilation already reported everything
+                   ;; worth reporting.
+                   (multiple-value-bind (full warnings-p failure-p)
+                       (handler-bind ((warning #'muffle-warning))
+                         (let ((*error-output* (make-broadcast-stream)))
+                           (compile-in-lexenv form lexenv name
+                                              nil nil nil nil)))
+                     (declare (ignore warnings-p))
+                     (unless failure-p
+                       (setf (%funcallable-instance-fun fun) full)))))
+            (setf (%funcallable-instance-fun fun)
+                  (lambda (&rest args)
+                    (when (and (>= (setq calls (1+ (min calls threshold)))
+                                   threshold)
+                               (not (cas (car claimed) nil t)))
+                      #+sb-thread
+                      (let ((package *package*))
+                        (sb-thread:make-thread
+                         (lambda ()
+                           (let ((*package* package))
+                             (recompile)))
+                         :name "tiered compilation"))
+                      #-sb-thread
+                      (recompile))
+                    (apply quick args))))
+          (values fun warnings-p failure-p)))))
+
 (defun compile (name &optional (definition (or (and (symbolp name)
                                                     (macro-function name))
                                                (fdefinition name))))
@@ -146,7 +339,15 @@ not STYLE-WARNINGs occur during compilation, and NIL otherwise.
                   (values (the cons definition) (make-null-lexenv))
                   #+(or sb-eval sb-fasteval)
                   (prepare-for-compile definition))
-            (compile-in-lexenv sexpr lexenv name nil nil nil nil)))
+            (cond ((and *tiered-compile-threshold*
+                        (not (and (symbolp name) (macro-function name))))
+                   (compile-tiered sexpr lexenv name *tiered-compile-threshold*))
+                  ((and *compile-cache-directory*
+                        (not name)
+                        (not (typep definition 'interpreted-function)))
+                   (compile-cached sexpr))
+                  (t
+                   (compile-in-lexenv sexpr lexenv name nil nil nil nil)))))
     (values (cond (name
                    (if (and (symbolp name) (macro-function name))
                        (setf (macro-function name) compiled-definition)
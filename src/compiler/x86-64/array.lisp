@@ -1065,6 +1065,65 @@
 (define-full-setter set-vector-raw-bits * vector-data-offset other-pointer-lowtag
   (unsigned-reg) unsigned-num %set-vector-raw-bits)
 
+;;;; element-wise float arithmetic
+
+;;; As many elements at a time as fit in an XMM register, then the
+;;; rest one at a time.
+(macrolet ((def (name type sc n-bytes move-packed move-scalar ops)
+             (let ((n-elements (floor 16 n-bytes)))
+               `(define-vop (,name)
+                  (:translate %float-vector-op)
+                  (:policy :fast-safe)
+                  (:args (result :scs (descriptor-reg))
+                         (a :scs (descriptor-reg))
+                         (b :scs (descriptor-reg))
+                         (count :scs (unsigned-reg)))
+                  (:info op)
+                  (:arg-types (:constant (member + - *)) ,type ,type ,type
+                              positive-fixnum)
+                  (:temporary (:sc unsigned-reg) i end)
+                  (:temporary (:sc ,sc) x y)
+                  (:generator 40
+                   (let ((packed (gen-label))
+                         (test (gen-label))
+                         (scalar (gen-label))
+                         (done (gen-label)))
+                     (flet ((elt-ea (vector)
+                              (ea (- (* vector-data-offset n-word-bytes)
+                                     other-pointer-lowtag)
+                                  vector i ,n-bytes)))
+                       (zeroize i)
+                       (move end count)
+                       (inst and end ,(- n-elements))
+                       (inst jmp test)
+                       (emit-label packed)
+                       (inst ,move-packed x (elt-ea a))
+                       (inst ,move-packed y (elt-ea b))
+                       (ecase op
+                         ,@(loop for (fun packed) in ops
+                                 collect `(,fun (inst ,packed x y))))
+                       (inst ,move-packed (elt-ea result) x)
+                       (inst add i ,n-elements)
+                       (emit-label test)
+                       (inst cmp i end)
+                       (inst jmp :b packed)
+                       (emit-label scalar)
+                       (inst cmp i count)
+                       (inst jmp :ae done)
+                       (inst ,move-scalar x (elt-ea a))
+                       (inst ,move-scalar y (elt-ea b))
+                       (ecase op
+                         ,@(loop for (fun nil scalar) in ops
+                                 collect `(,fun (inst ,scalar x y))))
+                       (inst ,move-scalar (elt-ea result) x)
+                       (inst inc i)
+                       (inst jmp scalar)
+                       (emit-label done))))))))
+  (def float-vector-op/double-float simple-array-double-float double-reg 8
+    movupd movsd ((+ addpd addsd) (- subpd subsd) (* mulpd mulsd)))
+  (def float-vector-op/single-float simple-array-single-float single-reg 4
+    movups movss ((+ addps addss) (- subps subss) (* mulps mulss))))
+
 ;;;; ATOMIC-INCF for arrays
 
 (define-vop (array-atomic-incf/word)
@@ -1082,3 +1141,71 @@
               array index (ash 1 (- word-shift n-fixnum-tag-bits)))
           diff)
     (move result diff)))
+
+;;;; COMPARE-AND-SWAP, exchange and ATOMIC-INCF on elements of specialized
+;;;; vectors. Every locked instruction, and XCHG with memory, is a full
+;;;; barrier, so these are sequentially consistent whatever order is asked for.
+
+(macrolet ((def ((cas xchg incf) type sc primtype size n-bytes
+              &aux (elt-ea `(ea (- (* vector-data-offset n-word-bytes) other-pointer-lowtag)
+                                vector index ,(ash n-bytes (- n-fixnum-tag-bits)))))
+             `(progn
+                (define-vop ()
+                  (:translate ,cas)
+                  (:policy :fast-safe)
+                  (:args (vector :scs (descriptor-reg) :to :eval)
+                         (index :scs (any-reg) :to :eval)
+                         (old :scs (,sc))
+                         (new :scs (,sc)))
+                  (:arg-types ,type positive-fixnum ,primtype ,primtype)
+                  (:temporary (:sc ,sc :offset rax-offset :to :result :target result) rax)
+                  (:results (result :scs (,sc)))
+                  (:result-types ,primtype)
+                  (:generator 5
+                    (move rax old)
+                    (inst cmpxchg :lock ,size ,elt-ea new)
+                    (move result rax)))
+                (define-vop ()
+                  (:translate ,xchg)
+                  (:policy :fast-safe)
+                  (:args (vector :scs (descriptor-reg))
+                         (index :scs (any-reg))
+                         (new :scs (,sc) :target result))
+                  (:arg-types ,type positive-fixnum ,primtype)
+                  (:temporary (:sc ,sc) temp)
+                  (:results (result :scs (,sc)))
+                  (:result-types ,primtype)
+                  (:generator 3
+                    ;; Exchange through RESULT, unless doing so would
+                    ;; clobber the address
+                    (let ((source (if (or (location= result vector) (location= result index))
+                                      temp
+                                      result)))
+                      (move source new)
+                      (inst xchg ,size ,elt-ea source)
+                      (move result source))))
+                ,@(when incf
+                    `((define-vop ()
+                        (:translate ,incf)
+                        (:policy :fast-safe)
+                        (:args (vector :scs (descriptor-reg))
+                               (index :scs (any-reg))
+                               (diff :scs (unsigned-reg)))
+                        (:arg-types * positive-fixnum unsigned-num)
+                        (:temporary (:sc unsigned-reg) temp)
+                        (:results (result :scs (,sc)))
+                        (:result-types ,primtype)
+                        (:generator 4
+                          (move temp diff)
+                          ;; A fixnum is incremented as its tagged word,
+                          ;; which wraps around modulo the fixnums
+                          ,@(when (eq sc 'any-reg)
+                              '((inst shl temp n-fixnum-tag-bits)))
+                          (inst xadd :lock ,size ,elt-ea temp)
+                          (move result temp))))))))
+  (def (%vector-cas/word %vector-xchg/word nil)
+    simple-array-unsigned-byte-64 unsigned-reg unsigned-num :qword 8)
+  (def (%vector-cas/ub32 %vector-xchg/ub32 %array-atomic-incf/ub32)
+    simple-array-unsigned-byte-32 unsigned-reg unsigned-num :dword 4)
+  (def (%vector-cas/fixnum %vector-xchg/fixnum %array-atomic-incf/fixnum)
+    simple-array-fixnum any-reg tagged-num :qword 8))
@@ -179,6 +179,7 @@
                           (%alien-funcall function
                                           ',(make-alien-fun-type
                                              :arg-types (new-arg-types)
+                                             :leaf (sb-alien::alien-fun-type-leaf type)
                                              :result-type new-result-type)
                                           ,@(new-args))
                         (logior low (ash high 64))))))
@@ -188,6 +189,7 @@
                     (%alien-funcall function
                                     ',(make-alien-fun-type
                                        :arg-types (new-arg-types)
+                                       :leaf (sb-alien::alien-fun-type-leaf type)
                                        :result-type result-type)
                                     ,@(new-args))))))
         (sb-c::give-up-ir1-transform))))
@@ -250,25 +252,26 @@
 (defconstant thread-saved-csp-offset (- (1+ sb-vm::thread-header-slots)))
 
 (eval-when (#-sb-xc :compile-toplevel :load-toplevel :execute)
-  (defun destroyed-c-registers ()
+  (defun destroyed-c-registers (&optional leafp)
+    (declare (ignorable leafp))
     ;; Safepoints do not save interrupt contexts to be scanned during
     ;; GCing, it only looks at the stack, so if a register isn't
-    ;; spilled it won't be visible to the GC.
-    #+sb-safepoint
-    '((:save-p t))
-    #-sb-safepoint
-    (let ((gprs (list rcx-offset rdx-offset
-                      #-win32 rsi-offset #-win32 rdi-offset
-                      r8-offset r9-offset r10-offset r11-offset))
-          (vars))
-      (append
-       (loop for gpr in gprs
-             collect `(:temporary (:sc any-reg :offset ,gpr :from :eval :to :result)
-                                  ,(car (push (sb-xc:gensym) vars))))
-       (loop for float to 15
-             collect `(:temporary (:sc single-reg :offset ,float :from :eval :to :result)
-                                  ,(car (push (sb-xc:gensym) vars))))
-       `((:ignore ,@vars))))))
+    ;; spilled it won't be visible to the GC. That's moot if GC can't
+    ;; happen during the call.
+    (if #+sb-safepoint (not leafp) #-sb-safepoint nil
+        '((:save-p t))
+        (let ((gprs (list rcx-offset rdx-offset
+                          #-win32 rsi-offset #-win32 rdi-offset
+                          r8-offset r9-offset r10-offset r11-offset))
+              (vars))
+          (append
+           (loop for gpr in gprs
+                 collect `(:temporary (:sc any-reg :offset ,gpr :from :eval :to :result)
+                                      ,(car (push (sb-xc:gensym) vars))))
+           (loop for float to 15
+                 collect `(:temporary (:sc single-reg :offset ,float :from :eval :to :result)
+                                      ,(car (push (sb-xc:gensym) vars))))
+           `((:ignore ,@vars)))))))
 
 (define-vop (call-out)
   (:args (function :scs (sap-reg)
@@ -317,6 +320,29 @@
                  #+win32 rbx))
   . #.(destroyed-c-registers))
 
+;;; A call to a function declared :LEAF, which promises not to block
+;;; or to call back into Lisp: GC can't stop this thread until the call
+;;; returns, so with safepoints there's no need to publish the stack
+;;; pointer, or to spill the registers that C preserves.
+(define-vop (call-out-named-leaf)
+  (:args (args :more t))
+  (:results (results :more t))
+  (:info c-symbol varargsp)
+  (:temporary (:sc unsigned-reg :offset rax-offset :to :result) rax)
+  #+win32
+  (:temporary (:sc unsigned-reg :offset r15-offset :from :eval :to :result) r15)
+  #+win32
+  (:ignore r15)
+  #+win32
+  (:temporary (:sc unsigned-reg :offset rbx-offset :from :eval :to :result) rbx)
+  (:ignore results)
+  (:vop-var vop)
+  (:generator 0
+    (emit-c-call vop rax c-symbol args varargsp
+                 #+sb-safepoint nil
+                 #+win32 rbx))
+  . #.(destroyed-c-registers t))
+
 #+win32
 (defconstant win64-seh-direct-thunk-addr win64-seh-data-addr)
 #+win32
@@ -327,15 +353,16 @@
   ;; Current PC - don't rely on function to keep it in a form that
   ;; GC understands
   #+sb-safepoint
-  (let ((label (gen-label)))
-    ;; This looks unnecessary. GC can look at the stack word physically below
-    ;; the CSP-around-foreign-call, which must be a PC pointing into the lisp caller.
-    ;; A more interesting question would arise if we had callee-saved registers
-    ;; within lisp code, which we don't at the moment. If we did, those
-    ;; wouldn't be anywhere on the stack unless C code decides to save them.
-    (inst lea rax (rip-relative-ea label))
-    (emit-label label)
-    (move pc-save rax))
+  (when pc-save
+    (let ((label (gen-label)))
+      ;; This looks unnecessary. GC can look at the stack word physically below
+      ;; the CSP-around-foreign-call, which must be a PC pointing into the lisp caller.
+      ;; A more interesting question would arise if we had callee-saved registers
+      ;; within lisp code, which we don't at the moment. If we did, those
+      ;; wouldn't be anywhere on the stack unless C code decides to save them.
+      (inst lea rax (rip-relative-ea label))
+      (emit-label label)
+      (move pc-save rax)))
   (when (sb-c:msan-unpoison sb-c:*compilation*)
     (inst mov rax (thread-slot-ea thread-msan-param-tls-slot))
     ;; Unpoison parameters
@@ -355,8 +382,9 @@
                                     'float-registers))))
 
   ;; Store SP in thread struct, unless the enclosing block says not to
+  ;; or the callee is a leaf
   #+sb-safepoint
-  (when (policy (sb-c::vop-node vop) (/= sb-c:insert-safepoints 0))
+  (when (and pc-save (policy (sb-c::vop-node vop) (/= sb-c:insert-safepoints 0)))
     (inst mov (thread-slot-ea thread-saved-csp-offset) rsp-tn))
 
   #+win32 (inst sub rsp-tn #x20)       ;MS_ABI: shadow zone
@@ -390,7 +418,7 @@
 
   ;; Zero the saved CSP, unless this code shouldn't ever stop for GC
   #+sb-safepoint
-  (when (policy (sb-c::vop-node vop) (/= sb-c:insert-safepoints 0))
+  (when (and pc-save (policy (sb-c::vop-node vop) (/= sb-c:insert-safepoints 0)))
     (inst xor (thread-slot-ea thread-saved-csp-offset) rsp-tn)))
 
 (define-vop (alloc-number-stack-space)
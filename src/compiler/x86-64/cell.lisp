@@ -587,7 +587,35 @@
       ;; Indices are small enough to be written as :DWORDs which avoids
       ;; a REX prefix if 'bsp' happens to be any of the low 8 registers.
       (inst mov :dword (ea (ash binding-symbol-slot word-shift) bsp) tls-index)
-      (inst mov :qword tls-cell (encode-value-if-immediate val))))))
+      (inst mov :qword tls-cell (encode-value-if-immediate val)))))
+
+;;; Bind several known symbols, as consecutive BINDs would, but bump the
+;;; binding stack pointer only once. An interrupt after the bump sees the
+;;; entries not yet written as empty, since the stack above the pointer
+;;; is kept zeroed. IR2-OPTIMIZE-STORES makes these from BINDs.
+(define-vop (bind-n)
+  (:args (values :more t :scs (any-reg descriptor-reg constant immediate)))
+  (:temporary (:sc unsigned-reg) bsp tmp)
+  (:info symbols)
+  (:generator 10
+    (inst mov bsp (* binding-size n-word-bytes (length symbols)))
+    (inst xadd (thread-slot-ea thread-binding-stack-pointer-slot) bsp)
+    (loop for symbol in symbols
+          for value = values then (tn-ref-across value)
+          for offset from 0 by (* binding-size n-word-bytes)
+          do (let* ((val (tn-ref-tn value))
+                    (tls-index (load-time-tls-offset symbol))
+                    (tls-cell (thread-tls-ea tls-index)))
+               (inst mov tmp tls-cell)
+               (inst mov (ea (+ offset (ash binding-value-slot word-shift)) bsp) tmp)
+               (inst mov :dword (ea (+ offset (ash binding-symbol-slot word-shift)) bsp)
+                     tls-index)
+               (cond ((stack-tn-p val)
+                      (inst mov tmp val)
+                      (inst mov tls-cell tmp))
+                     (t
+                      (gen-cell-set tls-cell val tmp)))))))
+)
 
 #-sb-thread
 (define-vop (dynbind)
@@ -3378,15 +3378,22 @@
 
 ;;; Coverage support
 
+(defun coverage-mark-ea (segment mark-index)
+  (rip-relative-ea (segment-origin segment)
+                   ;; skip over jump table word and entries
+                   (+ (* (1+ (component-n-jump-table-entries))
+                         n-word-bytes)
+                      mark-index)))
+
 (define-instruction store-coverage-mark (segment mark-index)
   (:emitter
    (assemble (segment)
-     (inst mov :byte (rip-relative-ea (segment-origin segment)
-                                      ;; skip over jump table word and entries
-                                      (+ (* (1+ (component-n-jump-table-entries))
-                                            n-word-bytes)
-                                         mark-index))
-           1))))
+     (inst mov :byte (coverage-mark-ea segment mark-index) 1))))
+
+(define-instruction test-coverage-mark (segment mark-index)
+  (:emitter
+   (assemble (segment)
+     (inst cmp :byte (coverage-mark-ea segment mark-index) 0))))
 
 (defun sb-assem::%mark-used-labels (operand)
   (when (typep operand 'ea)
@@ -147,8 +147,14 @@
 (defvar *binding-stack-pointer*)
 
 ;;; Bit indices into *CPU-FEATURE-BITS*
-(defconstant cpu-has-ymm-registers   0)
+(defconstant cpu-has-ymm-registers   0) ; AVX2, despite the name
 (defconstant cpu-has-popcnt          1)
+(defconstant cpu-has-bmi2            2)
+(defconstant cpu-has-erms            3) ; enhanced REP MOVSB/STOSB
+(defconstant cpu-has-fsrm            4) ; fast short REP MOVSB
+(defconstant cpu-has-avx512          5) ; AVX-512F, enabled by the OS
+(defconstant cpu-has-avx             6)
+(defconstant cpu-has-sse42           7) ; CRC32 and the string instructions
 
 (defconstant-eqx +static-symbols+
  `#(,@+common-static-symbols+
@@ -448,6 +448,25 @@
      (move lo eax)
      (move hi edx)))
 
+;;; The cycle counter as one word, without serializing: for measuring
+;;; intervals long enough that the instructions in flight don't matter,
+;;; where CPUID would cost more than the interval, as it can under
+;;; virtualization.
+(defknown %read-cycle-counter-word () word (flushable))
+
+(define-vop (%read-cycle-counter-word)
+  (:policy :fast-safe)
+  (:translate %read-cycle-counter-word)
+  (:temporary (:sc unsigned-reg :offset rax-offset) eax)
+  (:temporary (:sc unsigned-reg :offset rdx-offset) edx)
+  (:results (res :scs (unsigned-reg)))
+  (:result-types unsigned-num)
+  (:generator 3
+     (inst rdtsc)
+     (inst shl edx 32)
+     (inst or edx eax)
+     (move res edx)))
+
 (defmacro with-cycle-counter (&body body)
   "Returns the primary value of BODY as the primary value, and the
 number of CPU cycles elapsed as secondary value. EXPERIMENTAL."
@@ -564,4 +583,11 @@ number of CPU cycles elapsed as secondary value. EXPERIMENTAL."
  (:generator 1
    ;; Can't convert index to a code-relative index until the boxed header length
    ;; has been determined.
-   (inst store-coverage-mark index)))
+   ;; Store the mark only if it isn't set yet: storing it each time would
+   ;; make the cache line of the marks bounce between the cores running
+   ;; threads of the same code, whereas reading it leaves the line shared.
+   (let ((done (gen-label)))
+     (inst test-coverage-mark index)
+     (inst jmp :ne done)
+     (inst store-coverage-mark index)
+     (emit-label done))))
@@ -199,6 +199,59 @@
                     (digest-global-call fname (cdr form) env)))
           (%dispatch sexpr env))))))
 
+;;; EVAL in the null lexical environment descends the form anew each time,
+;;; whereas a SEXPR digests each subform once, resolving its lexical
+;;; variables to frame slots and its operator to a handler. So a form which
+;;; is EVALed repeatedly, as by a scripting layer that keeps the forms it
+;;; runs, gets a SEXPR once it has been seen +HOT-FORM-THRESHOLD+ times.
+;;; The conses of the form are copied at that point so that the SEXPR can
+;;; be discarded if the form is later modified; forms with more than
+;;; +HOT-FORM-MAX-CONSES+ conses, or circular ones, are never cached.
+;;; Each value in the table is either (COUNT) or (SEXPR . COPY).
+(define-load-time-global *hot-forms*
+    (make-hash-table :test 'eq :weakness :key :synchronized t))
+(defconstant +hot-form-threshold+ 3)
+(defconstant +hot-form-max-conses+ 1000)
+
+(defun copy-form-conses (form)
+  (let ((budget +hot-form-max-conses+))
+    (declare (fixnum budget))
+    (labels ((copy (x)
+               (cond ((atom x) x)
+                     ((minusp (decf budget))
+                      (return-from copy-form-conses nil))
+                     (t (cons (copy (car x)) (copy (cdr x)))))))
+      (copy form))))
+
+(defun form-unchanged-p (form copy)
+  (loop (cond ((atom copy) (return (eq form copy)))
+              ((or (atom form) (not (form-unchanged-p (car form) (car copy))))
+               (return nil))
+              (t (setq form (cdr form) copy (cdr copy))))))
+
+;;; Return the SEXPR for FORM if it is hot, or NIL to EVAL it the usual way.
+(defun hot-form-sexpr (form)
+  (declare (cons form))
+  (let ((entry (gethash form *hot-forms*)))
+    (cond ((not entry)
+           (setf (gethash form *hot-forms*) (list 1))
+           nil)
+          ((sexpr-p (car entry))
+           (if (form-unchanged-p form (cdr entry))
+               (car entry)
+               (progn (setf (gethash form *hot-forms*) (list 1)) nil)))
+          ((not (fixnump (car entry))) nil) ; too big to copy
+          ((< (incf (car entry)) +hot-form-threshold+) nil)
+          (t
+           (let ((copy (copy-form-conses form))
+                 (sexpr (%sexpr form)))
+             (cond ((and copy (sexpr-p sexpr))
+                    (setf (gethash form *hot-forms*) (cons sexpr copy))
+                    sexpr)
+                   (t
+                    (setf (car entry) :never)
+                    nil)))))))
+
 (fmakunbound 'eval-in-environment)
 (defun eval-in-environment (form env)
   (incf *eval-calls*)
@@ -235,7 +288,15 @@
         ;; But if we do capture the policy up front, then we _fail_ to see
         ;; any changes that are made by PROCLAIM because those _don't_
         ;; affect the policy in an interpreter environment.
-        (%eval form interpreter-env))))
+        (let ((sexpr (and (not interpreter-env)
+                          (consp form)
+                          (eq sb-ext:*evaluator-mode* :interpret)
+                          (not *applyhook*)
+                          (not *eval-verbose*)
+                          (hot-form-sexpr form))))
+          (if sexpr
+              (%dispatch sexpr nil)
+              (%eval form interpreter-env))))))
 
 (push
   (let ((this-pkg (find-package "SB-INTERPRETER")))
@@ -1180,6 +1180,68 @@
             (when matchp
               (return (apply ctor ctor-args)))))))))
 
+;;; A MAKE-INSTANCE call whose class or initarg keys are only known at
+;;; runtime, such as (APPLY #'MAKE-INSTANCE CLASS INITARGS), gets a ctor
+;;; of its own once the same class has been instantiated
+;;; +RUNTIME-CTOR-THRESHOLD+ times with the same keys in the same order.
+;;; The ctor takes the values of all the initargs as parameters, and
+;;; MAYBE-CALL-CTOR finds it from then on if it could be optimized.
+;;; Class redefinition resets it like any other ctor. The
+;;; RUNTIME-CTORS plist entry of the class holds (KEYS . COUNT) or
+;;; (KEYS . CTOR) for up to +CTOR-LIST-MAX-SIZE+ lists of keys, which
+;;; also keeps the ctors alive. Thread safe like the inline caches:
+;;; lost updates only delay the ctor.
+(defconstant +runtime-ctor-threshold+ 4)
+
+(defun runtime-ctor-keys-match-p (keys initargs)
+  (loop
+    (cond ((null keys)
+           (return (null initargs)))
+          ((or (null initargs) (neq (car keys) (car initargs)))
+           (return nil)))
+    (setf keys (cdr keys)
+          initargs (cddr initargs))))
+
+(defun maybe-call-runtime-ctor (class initargs)
+  (when (and (eq **boot-state** 'complete)
+             (evenp (length initargs))
+             (loop for key in initargs by #'cddr
+                   always (and (symbolp key) (neq key :allow-other-keys))))
+    (let* ((entries (plist-value class 'runtime-ctors))
+           (entry (find-if (lambda (entry)
+                             (runtime-ctor-keys-match-p (car entry) initargs))
+                           entries)))
+      (flet ((call-if-optimized (ctor)
+               ;; Only optimized ones: a fallback ctor may call
+               ;; MAKE-INSTANCE, and the methods on it, a second time.
+               (when (eq (ctor-state ctor) 'initial)
+                 (install-optimized-constructor ctor))
+               (when (eq (ctor-state ctor) 'optimized)
+                 (apply ctor (plist-values initargs)))))
+        (let ((ctor-or-count (cdr entry)))
+          (etypecase ctor-or-count
+            (null
+             (when (< (length entries) +ctor-list-max-size+)
+               (setf (plist-value class 'runtime-ctors)
+                     (acons (plist-keys initargs) 1 entries)))
+             nil)
+            (ctor
+             (call-if-optimized ctor-or-count))
+            (fixnum
+             (if (< ctor-or-count (1- +runtime-ctor-threshold+))
+                 (progn (setf (cdr entry) (1+ ctor-or-count))
+                        nil)
+                 (let* ((ctor-initargs
+                          (loop for key in (car entry)
+                                for i from 0
+                                collect key
+                                collect (format-symbol *pcl-package* ".P~D." i)))
+                        (ctor (ensure-ctor (make-ctor-function-name
+                                            class ctor-initargs t)
+                                           class ctor-initargs t)))
+                   (setf (cdr entry) ctor)
+                   (call-if-optimized ctor))))))))))
+
 ;;; FIXME: CHECK-FOO-INITARGS share most of their bodies.
 (defun check-mi-initargs (class initargs)
   (let* ((class-proto (class-prototype class))
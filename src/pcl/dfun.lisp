@@ -1824,3 +1824,117 @@ Except see also BREAK-VICIOUS-METACIRCLE.  -- CSR, 2003-05-28
                                              type)
                                    (push gf gf-list))))
     gf-list))
+
+;;;; call-site caches
+
+;;; When the GENERIC-FUNCTION-INLINE-CACHES policy is enabled, a call
+;;; (FOO X Y) to a generic function is compiled to look the wrapper
+;;; of X up in a small cache of the call site, and to invoke the
+;;; effective method found there directly. Only a miss goes through
+;;; the discriminating function of FOO.
+;;;
+;;; The cache is a CONS of the FDEFN of FOO and a store, which is NIL
+;;; or an immutable vector
+;;;   #(gf dfun-state wrapper0 emf0 wrapper1 emf1 ...)
+;;; The entries are copied from the cache of a CACHING or CHECKING
+;;; dfun. They remain valid for as long as GF is the definition of FOO
+;;; and its dfun state is the same object: SET-DFUN makes a new state
+;;; whenever the methods, and with them the effective methods, change,
+;;; and once a wrapper is invalidated its hash is 0. A store without
+;;; entries means that the site is not cached for that state, because
+;;; the generic function dispatches on other arguments than the first,
+;;; takes other than NARGS required arguments, or has been seen with
+;;; more than +CALL-SITE-CACHE-SIZE+ classes at this site.
+;;;
+;;; Thread safe in the same way as the inline caches of ctors: a
+;;; store is never modified, only replaced, and a lost update just
+;;; costs another miss.
+(defconstant +call-site-cache-size+ 4)
+
+(defun make-call-site-cache (name)
+  (cons (find-or-create-fdefn name) nil))
+
+(declaim (inline call-site-cache-lookup))
+(defun call-site-cache-lookup (cache arg)
+  (declare (type cons cache))
+  (let ((store (cdr cache)))
+    (when store
+      (let* ((store (truly-the simple-vector store))
+             (gf (svref store 0)))
+        (when (and (eq gf (fdefn-fun (truly-the fdefn (car cache))))
+                   (eq (svref store 1)
+                       (clos-slots-ref (fsc-instance-slots gf)
+                                       +sgf-dfun-state-index+)))
+          (let ((wrapper (wrapper-of arg)))
+            (unless (eql (wrapper-clos-hash wrapper) 0)
+              (loop for i from 2 below (length store) by 2
+                    when (eq (svref store i) wrapper)
+                      return (svref store (1+ i))))))))))
+
+;;; Return the effective method that the dfun state STATE of GF uses
+;;; for a call with NARGS arguments, the first of which is ARG, if the
+;;; call site can cache it.
+(defun call-site-emf (gf state arg nargs)
+  (when (consp state)
+    (multiple-value-bind (nreq applyp metatypes) (get-generic-fun-info gf)
+      (when (and (= nreq nargs)
+                 (not applyp)
+                 (neq (car metatypes) t)
+                 (every (lambda (metatype) (eq metatype t)) (cdr metatypes)))
+        (let ((cache (cadr state))
+              (info (cddr state)))
+          (when cache
+            (multiple-value-bind (hit value) (probe-cache cache (wrapper-of arg))
+              (when hit
+                (let ((emf (typecase info
+                             (caching value)
+                             (checking (checking-function info)))))
+                  (when (typep emf '(or fast-method-call method-call function))
+                    emf))))))))))
+
+(defun update-call-site-cache (cache gf arg nargs)
+  (when (eq (class-of gf) *the-class-standard-generic-function*)
+    (let* ((state (clos-slots-ref (fsc-instance-slots gf)
+                                  +sgf-dfun-state-index+))
+           (old (cdr cache))
+           (entries (if (and old (eq (svref old 0) gf) (eq (svref old 1) state))
+                        (subseq old 2)
+                        #()))
+           (wrapper (wrapper-of arg)))
+      (unless (or (and old (eq (svref old 1) state) (zerop (length entries)))
+                  (find wrapper entries))
+        (let ((emf (call-site-emf gf state arg nargs)))
+          (cond ((and emf (< (length entries) (* 2 +call-site-cache-size+)))
+                 (setf (cdr cache)
+                       (concatenate 'simple-vector
+                                    (vector gf state wrapper emf) entries)))
+                ((or emf (zerop (length entries)))
+                 (setf (cdr cache) (vector gf state)))))))))
+
+(defun call-site-cache-miss (cache &rest args)
+  (declare (dynamic-extent args))
+  (let* ((fdefn (car cache))
+         (gf (fdefn-fun fdefn)))
+    (multiple-value-prog1
+        (apply (or gf (fdefinition (fdefn-name fdefn))) args)
+      (when gf
+        (update-call-site-cache cache gf (car args) (length args))))))
+
+(defun generic-function-call-transform (form env)
+  (declare (ignore env))
+  (let ((name (car form))
+        (args (cdr form)))
+    (if (and (symbolp name) args (proper-list-p args))
+        (let ((temps (make-gensym-list (length args)))
+              (cache (gensym "CACHE"))
+              (emf (gensym "EMF")))
+          `(let* (,@(mapcar #'list temps args)
+                  (,cache (load-time-value (make-call-site-cache ',name) t))
+                  (,emf (call-site-cache-lookup ,cache ,(first temps))))
+             (if ,emf
+                 (invoke-narrow-effective-method-function
+                  ,emf nil :required-args ,temps)
+                 (call-site-cache-miss ,cache ,@temps))))
+        (values nil t))))
+
+(setf sb-c::*generic-function-call-transform* #'generic-function-call-transform)
@@ -30,7 +30,8 @@
 
 (defmethod make-instance ((class class) &rest initargs)
   (declare (inline ensure-class-finalized))
-  (let ((instance-or-nil (maybe-call-ctor class initargs)))
+  (let ((instance-or-nil (or (maybe-call-ctor class initargs)
+                             (maybe-call-runtime-ctor class initargs))))
     (when instance-or-nil
       (return-from make-instance instance-or-nil)))
   (ensure-class-finalized class)
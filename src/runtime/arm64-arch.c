@@ -9,6 +9,10 @@
  * files for more information.
  */
 #include <stdio.h>
+#include <arm_neon.h>
+#ifdef LISP_FEATURE_LINUX
+#include <sys/auxv.h>
+#endif
 
 #include "sbcl.h"
 #include "runtime.h"
@@ -25,6 +29,74 @@
 #include "monitor.h"
 #include "pseudo-atomic.h"
 
+/* Nonzero if the CPU has the ARMv8.1 LSE atomics (CAS, LDADD and so on).
+ * Compiled code tests it to choose them over load/store-exclusive loops,
+ * unless built for :ARM-V8.1, in which case it uses them unconditionally */
+int lse_atomics_supported;
+
+void tune_asm_routines_for_microarch(void)
+{
+#if defined LISP_FEATURE_LINUX
+#ifndef HWCAP_ATOMICS
+#define HWCAP_ATOMICS (1 << 8)
+#endif
+    lse_atomics_supported = (getauxval(AT_HWCAP) & HWCAP_ATOMICS) != 0;
+#elif defined LISP_FEATURE_DARWIN
+    lse_atomics_supported = 1; // Every Apple CPU has them
+#endif
+}
+
+/* The operations of BIT-AND and its kin on whole words, in the order of
+ * BIT-VECTOR-OP-CODE in Lisp, two words to a NEON register. DST may be
+ * the same as A or B. */
+void bit_vector_op(int op, uword_t *dst, uword_t *a, uword_t *b, uword_t nwords)
+{
+    const uint64x2_t ones = vdupq_n_u64(~(uint64_t)0);
+    uword_t i, pairs = nwords & ~(uword_t)1;
+#define BIT_VECTOR_OP_LOOP(vexpr, expr)                                 \
+    for (i = 0 ; i < pairs ; i += 2) {                                  \
+        uint64x2_t x = vld1q_u64((uint64_t*)(a + i)),                   \
+            y = vld1q_u64((uint64_t*)(b + i));                          \
+        vst1q_u64((uint64_t*)(dst + i), (vexpr));                       \
+    }                                                                   \
+    if (i < nwords) dst[i] = (expr);                                    \
+    break
+    switch (op) {
+    case 0: BIT_VECTOR_OP_LOOP(vandq_u64(x, y), a[i] & b[i]);
+    case 1: BIT_VECTOR_OP_LOOP(vorrq_u64(x, y), a[i] | b[i]);
+    case 2: BIT_VECTOR_OP_LOOP(veorq_u64(x, y), a[i] ^ b[i]);
+    case 3: BIT_VECTOR_OP_LOOP(veorq_u64(veorq_u64(x, y), ones), ~(a[i] ^ b[i]));
+    case 4: BIT_VECTOR_OP_LOOP(veorq_u64(vandq_u64(x, y), ones), ~(a[i] & b[i]));
+    case 5: BIT_VECTOR_OP_LOOP(veorq_u64(vorrq_u64(x, y), ones), ~(a[i] | b[i]));
+    case 6: BIT_VECTOR_OP_LOOP(vbicq_u64(y, x), ~a[i] & b[i]);
+    case 7: BIT_VECTOR_OP_LOOP(vbicq_u64(x, y), a[i] & ~b[i]);
+    case 8: BIT_VECTOR_OP_LOOP(vornq_u64(y, x), ~a[i] | b[i]);
+    case 9: BIT_VECTOR_OP_LOOP(vornq_u64(x, y), a[i] | ~b[i]);
+    }
+#undef BIT_VECTOR_OP_LOOP
+}
+
+/* The number of bits set in NWORDS words from WORDS, for COUNT of bits on
+ * the interior words of a bit vector. CNT counts the bits of each octet,
+ * and the counts add up in octets for 31 rounds at most before they are
+ * widened into the total. */
+uword_t bit_vector_count(uword_t *words, uword_t nwords)
+{
+    uint64x2_t total = vdupq_n_u64(0);
+    uword_t i = 0;
+    while (nwords - i >= 2) {
+        uint8x16_t octets = vdupq_n_u8(0);
+        int round;
+        for (round = 0 ; round < 31 && nwords - i >= 2 ; ++round, i += 2)
+            octets = vaddq_u8(octets, vcntq_u8(vld1q_u8((uint8_t*)(words + i))));
+        total = vpadalq_u32(total, vpaddlq_u16(vpaddlq_u8(octets)));
+    }
+    uword_t count = vaddvq_u64(total);
+    if (i < nwords)
+        count += vaddv_u8(vcnt_u8(vcreate_u8(words[i])));
+    return count;
+}
+
 os_vm_address_t arch_get_bad_addr(int sig, siginfo_t *code, os_context_t *context)
 {
     return (os_vm_address_t)code->si_addr;
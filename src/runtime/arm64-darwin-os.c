@@ -19,6 +19,8 @@ void set_thread_stack(void *address) {
     }
 }
 
+__thread int jit_write_depth;
+
 void jit_patch(lispobj* address, lispobj value) {
     THREAD_JIT(0);
     *address = value;
@@ -55,6 +57,16 @@ void jit_patch_code(lispobj code, lispobj value, unsigned long index) {
     native_pointer(code)[index] = value;
     THREAD_JIT(1);
 }
+/* Store N words from VALUES into the boxed words of CODE from INDEX
+ * with one change of the protection, instead of one per word. */
+void jit_copy_code_constants(lispobj code, lispobj* values,
+                             unsigned long index, unsigned long n) {
+    THREAD_JIT(0);
+    gc_card_mark[addr_to_card_index(code)] = 1; // CARD_MARKED
+    SET_WRITTEN_FLAG(native_pointer(code));
+    memcpy(native_pointer(code) + index, values, n * N_WORD_BYTES);
+    THREAD_JIT(1);
+}
 
 
 void
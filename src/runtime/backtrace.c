@@ -18,6 +18,8 @@
 
 #include <stdio.h>
 #include <signal.h>
+#include <string.h>
+#include <unistd.h>
 #include "sbcl.h"
 #include "runtime.h"
 #include "globals.h"
@@ -51,8 +53,9 @@ int df_decode_locs(lispobj encoded, int *offset, int *elsewhere)
     return varint_unpack(&unpacker, offset) && varint_unpack(&unpacker, elsewhere);
 }
 
-struct compiled_debug_fun *
-debug_function_from_pc (struct code* code, void *pc)
+/* Return the first compiled-debug-fun of 'code', or NULL if it has none */
+static struct compiled_debug_fun *
+code_debug_funs (struct code* code)
 {
     struct compiled_debug_info *di;
 
@@ -66,11 +69,26 @@ debug_function_from_pc (struct code* code, void *pc)
     if (!instancep(di->fun_map))
         return NULL;
 
-    struct compiled_debug_fun *df = (struct compiled_debug_fun*)native_pointer(di->fun_map);
+    return (struct compiled_debug_fun*)native_pointer(di->fun_map);
+}
+
+/* Find the debug-fun of 'code' whose ranges contain 'offset' by decoding
+ * the locations of each one in turn. On success, if 'bounds' is
+ * supplied, store the ranges into it */
+struct df_bounds {
+    struct code* code;
+    struct compiled_debug_fun* df;
+    int begin, end, elsewhere_begin, elsewhere_end;
+};
+static struct compiled_debug_fun *
+search_debug_funs (struct code* code, sword_t offset, struct df_bounds* bounds)
+{
+    struct compiled_debug_fun *df = code_debug_funs(code);
+    if (!df)
+        return NULL;
     int begin, end, elsewhere_begin, elsewhere_end;
     if (!df_decode_locs(df->encoded_locs, &begin, &elsewhere_begin))
         return NULL;
-    sword_t offset = (char*)pc - code_text_start(code);
     while (df) {
         struct compiled_debug_fun *next;
         if (df->next != NIL) {
@@ -82,8 +100,17 @@ debug_function_from_pc (struct code* code, void *pc)
             end = elsewhere_end = code_text_size(code);
         }
         if ((begin <= offset && offset < end) ||
-            (elsewhere_begin <= offset && offset < elsewhere_end))
+            (elsewhere_begin <= offset && offset < elsewhere_end)) {
+            if (bounds) {
+                bounds->code = code;
+                bounds->df = df;
+                bounds->begin = begin;
+                bounds->end = end;
+                bounds->elsewhere_begin = elsewhere_begin;
+                bounds->elsewhere_end = elsewhere_end;
+            }
             return df;
+        }
         begin = end;
         elsewhere_begin = elsewhere_end;
         df = next;
@@ -92,6 +119,62 @@ debug_function_from_pc (struct code* code, void *pc)
     return NULL;
 }
 
+/* Every frame of a backtrace, and every sample taken by sb-sprof, needs
+ * the debug-fun of some PC, and finding it means decoding the varint
+ * locations of all preceding debug-funs of the code. So remember the
+ * decoded bounds of recently found debug-funs, a few per code object.
+ * GC can move code and its debug-info, so the cache is emptied by each
+ * collection (lazily, by bumping the epoch). This may be called from a
+ * signal handler on any thread, so each set has a try-lock, and a
+ * contested set is simply bypassed. */
+#define DF_CACHE_SETS 256
+#define DF_CACHE_WAYS 4
+static struct df_cache_set {
+    int lock;
+    unsigned int epoch;
+    unsigned int victim;
+    struct df_bounds way[DF_CACHE_WAYS];
+} df_cache[DF_CACHE_SETS];
+static unsigned int df_cache_epoch = 1;
+
+/* Called at the end of each GC */
+void df_cache_invalidate() { ++df_cache_epoch; }
+
+static inline int df_cache_index(struct code* code) {
+    uword_t key = (uword_t)code >> N_LOWTAG_BITS;
+    return (key ^ (key >> 8) ^ (key >> 16)) & (DF_CACHE_SETS-1);
+}
+
+struct compiled_debug_fun *
+debug_function_from_pc (struct code* code, void *pc)
+{
+    sword_t offset = (char*)pc - code_text_start(code);
+    struct df_cache_set* set = &df_cache[df_cache_index(code)];
+    if (!__sync_bool_compare_and_swap(&set->lock, 0, 1))
+        return search_debug_funs(code, offset, 0);
+    if (set->epoch != df_cache_epoch) {
+        memset(set->way, 0, sizeof set->way);
+        set->epoch = df_cache_epoch;
+    }
+    struct compiled_debug_fun *df;
+    int i;
+    for (i = 0; i < DF_CACHE_WAYS; ++i) {
+        struct df_bounds* way = &set->way[i];
+        if (way->code == code &&
+            ((way->begin <= offset && offset < way->end) ||
+             (way->elsewhere_begin <= offset && offset < way->elsewhere_end))) {
+            df = way->df;
+            goto done;
+        }
+    }
+    struct df_bounds* victim = &set->way[set->victim++ % DF_CACHE_WAYS];
+    if (!(df = search_debug_funs(code, offset, victim)))
+        victim->code = 0;
+ done:
+    __sync_lock_release(&set->lock);
+    return df;
+}
+
 static void
 print_string (struct vector *vector, FILE *f)
 {
@@ -212,6 +295,85 @@ print_entry_points (struct code *code, FILE *f)
     });
 }
 
+#if defined LISP_FEATURE_LINUX && defined LISP_FEATURE_GENCGC
+/* "perf report" and other tools following the same convention symbolize
+ * samples in code that no ELF file describes by reading /tmp/perf-<pid>.map,
+ * in which each line is "START SIZE NAME" with START and SIZE in hex.
+ * With --perf-map, a line is appended for each compiled debug fun of
+ * every code object when the core is loaded, when Lisp finishes making
+ * a code object, and when GC moves one. Nothing is ever removed, so lines
+ * for addresses which have since been reused by other code stay behind.
+ *
+ * The file is written by Lisp threads from inside WITHOUT-GCING and by
+ * the collector with the world stopped, so no thread can be stopped for
+ * GC while it holds the stream lock. The stream has a static buffer so
+ * that writing to it never calls malloc() */
+int perf_map_enabled;
+static FILE* perf_map;
+static char perf_map_buffer[BUFSIZ];
+
+static void perf_map_write_range(struct code* code, int begin, int end, lispobj name)
+{
+    if (begin >= end) return;
+    fprintf(perf_map, "%lx %x ", (unsigned long)(code_text_start(code) + begin),
+            end - begin);
+    print_entry_name(name, perf_map);
+    putc('\n', perf_map);
+}
+
+void perf_map_note_code(struct code* code)
+{
+    if (!perf_map || !code_text_size(code)) return;
+    flockfile(perf_map);
+    struct compiled_debug_fun *df = code_debug_funs(code);
+    int begin, end, elsewhere_begin, elsewhere_end;
+    if (!df || !df_decode_locs(df->encoded_locs, &begin, &elsewhere_begin)) {
+        // Without debug info, name the whole object after its first entry point
+        if (code_n_funs(code))
+            perf_map_write_range(code, 0, code_text_size(code), code->constants[0]);
+        df = 0;
+    }
+    while (df) {
+        struct compiled_debug_fun *next;
+        if (df->next != NIL) {
+            next = (struct compiled_debug_fun*) native_pointer(df->next);
+            if (!df_decode_locs(next->encoded_locs, &end, &elsewhere_end))
+                break;
+        } else {
+            next = 0;
+            end = elsewhere_end = code_text_size(code);
+        }
+        perf_map_write_range(code, begin, end, df->name);
+        perf_map_write_range(code, elsewhere_begin, elsewhere_end, df->name);
+        begin = end;
+        elsewhere_begin = elsewhere_end;
+        df = next;
+    }
+    fflush(perf_map);
+    funlockfile(perf_map);
+}
+
+extern void perf_map_note_code_pages(generation_index_t);
+void perf_map_init()
+{
+    char path[64];
+    snprintf(path, sizeof path, "/tmp/perf-%d.map", (int)getpid());
+    if (!(perf_map = fopen(path, "a"))) {
+        perror(path);
+        perf_map_enabled = 0;
+        return;
+    }
+    setvbuf(perf_map, perf_map_buffer, _IOFBF, sizeof perf_map_buffer);
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+    lispobj* where = (lispobj*)VARYOBJ_SPACE_START;
+    for ( ; where < varyobj_free_pointer ; where += sizetab[widetag_of(where)](where))
+        if (widetag_of(where) == CODE_HEADER_WIDETAG)
+            perf_map_note_code((struct code*)where);
+#endif
+    perf_map_note_code_pages(-1);
+}
+#endif
+
 
 #if !(defined(LISP_FEATURE_X86) || defined(LISP_FEATURE_X86_64))
 
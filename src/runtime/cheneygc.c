@@ -235,6 +235,8 @@ collect_garbage(generation_index_t ignore)
 #endif
     scrub_control_stack();
     set_auto_gc_trigger(size_retained+bytes_consed_between_gcs);
+    extern void df_cache_invalidate(void);
+    df_cache_invalidate(); // all code has moved
     thread_sigmask(SIG_SETMASK, &old, 0);
 
     gc_active_p = 0;
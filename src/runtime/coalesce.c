@@ -17,6 +17,9 @@
 #include "gc.h"
 #include "gc-internal.h"
 #include "gc-private.h"
+#ifdef LISP_FEATURE_GENCGC
+#include "gencgc-private.h"
+#endif
 #include "genesis/vector.h"
 #include "genesis/gc-tables.h"
 // FIXME: cheneygc needs layout.h but gencgc doesn't,
@@ -77,6 +80,53 @@ static boolean vector_isevery(boolean (*pred)(lispobj), struct vector* v)
     return 1;
 }
 
+/* Coalescing is done either in one pass over the heap with a private table,
+ * or when there are GC helper threads, with the passes over dynamic space
+ * divided among them and a table that they share. A simple-vector can only
+ * be compared once its elements have been coalesced, so in parallel there
+ * are two rounds: first everything else, then simple-vectors. Each round
+ * has two passes. The first elects a representative of each class of similar
+ * objects, the second points every reference to the class at it. Electing the
+ * object not managed by the collector if any, and otherwise the one at the
+ * lowest address, makes the result the same however the heap was divided. */
+struct coalesce_pass {
+    struct hopscotch_table* table;          // if serial
+    struct hopscotch_striped_table* shared; // if parallel
+    char round;    // 1 for all but simple-vectors, 2 for those
+    char electing; // or else replacing
+};
+
+/* Return 1 if the object at 'obj' may be coalesced with similar ones,
+ * 2 if the object is a simple-vector that may be, or 0 */
+static int coalescible_kind(lispobj* obj)
+{
+    extern char gc_coalesce_string_literals;
+    // gc_coalesce_string_literals represents the "aggressiveness" level.
+    // If 1, then we share vectors tagged as +VECTOR-SHAREABLE+,
+    // but if >1, those and also +VECTOR-SHAREABLE-NONSTD+.
+    int mask = gc_coalesce_string_literals > 1
+      ? (VECTOR_SHAREABLE|VECTOR_SHAREABLE_NONSTD)<<ARRAY_FLAGS_POSITION
+      : (VECTOR_SHAREABLE                        )<<ARRAY_FLAGS_POSITION;
+    lispobj header = *obj;
+    int widetag = header_widetag(header);
+
+    if ((header & mask) != 0) { // optimistically assume it's a vector
+        if (widetag == SIMPLE_VECTOR_WIDETAG)
+            return vector_isevery(eql_comparable_p, (struct vector*)obj) ? 2 : 0;
+        if (specialized_vector_widetag_p(widetag)) return 1;
+    }
+    return coalescible_number_p(obj);
+}
+
+/* The preference for 'obj' as representative, lower being better:
+ * the address, as words are aligned, under a high bit for gcable objects */
+static inline uword_t coalesce_rank(lispobj* obj)
+{
+    return ((uword_t)gcable_pointer_p((lispobj)obj) << (N_WORD_BITS-1))
+        | ((uword_t)obj >> 1);
+}
+#define ranked_object(rank) ((lispobj*)((uword_t)(rank) << 1))
+
 /* FIXME: we should actually be even more careful about coalescing objects
  * that appear as keys in hash-tables.  While we do take the precaution of
  * updating the need-to-rehash indicator, we might create keys that compare
@@ -84,48 +134,45 @@ static boolean vector_isevery(boolean (*pred)(lispobj), struct vector* v)
  * cause various kinds of weirdness in some applications. Nobody has reported
  * misbehavior in the 3 years or so that coalescing has been the default,
  * so it doesn't seem horribly bad, but does seem a bit broken */
-static void coalesce_obj(lispobj* where, struct hopscotch_table* ht)
+static void coalesce_obj(lispobj* where, struct coalesce_pass* pass)
 {
     lispobj ptr = *where;
     if (lowtag_of(ptr) != OTHER_POINTER_LOWTAG || !gc_managed_heap_space_p(ptr))
         return;
 
-    extern char gc_coalesce_string_literals;
-    // gc_coalesce_string_literals represents the "aggressiveness" level.
-    // If 1, then we share vectors tagged as +VECTOR-SHAREABLE+,
-    // but if >1, those and also +VECTOR-SHAREABLE-NONSTD+.
-    int mask = gc_coalesce_string_literals > 1
-      ? (VECTOR_SHAREABLE|VECTOR_SHAREABLE_NONSTD)<<ARRAY_FLAGS_POSITION
-      : (VECTOR_SHAREABLE                        )<<ARRAY_FLAGS_POSITION;
-
     lispobj* obj = native_pointer(ptr);
-    lispobj header = *obj;
-    int widetag = header_widetag(header);
+    int kind = coalescible_kind(obj);
+    if (!kind) return;
 
-    if ((((header & mask) != 0) // optimistically assume it's a vector
-         && ((widetag == SIMPLE_VECTOR_WIDETAG
-              && vector_isevery(eql_comparable_p, (struct vector*)obj))
-             || specialized_vector_widetag_p(widetag)))
-        || coalescible_number_p(obj)) {
-        if (widetag == SIMPLE_VECTOR_WIDETAG) {
+    if (pass->shared) {
+        if (kind != pass->round) return;
+        if (pass->electing) {
+            hopscotch_striped_insert_min(pass->shared, (uword_t)obj, coalesce_rank(obj));
+            return;
+        }
+        lispobj* rep = ranked_object(hopscotch_striped_get(pass->shared, (uword_t)obj, 0));
+        if (!rep || rep == obj) return;
+        ptr = make_lispobj(rep, OTHER_POINTER_LOWTAG);
+    } else {
+        struct hopscotch_table* ht = pass->table;
+        if (kind == 2) {
             struct vector* v = (void*)obj;
             sword_t n_elts = vector_len(v), i;
-            for (i = 0 ; i < n_elts ; ++i) coalesce_obj(v->data+i, ht);
+            for (i = 0 ; i < n_elts ; ++i) coalesce_obj(v->data+i, pass);
         }
         int index = hopscotch_get(ht, (uword_t)obj, 0);
-        if (!index) // Not found
+        if (!index) { // Not found
             hopscotch_insert(ht, (uword_t)obj, 1);
-        else {
-            ptr = make_lispobj((void*)ht->keys[index-1],
-                               OTHER_POINTER_LOWTAG);
-            // Check for no read-only to dynamic-space pointer
-            if ((uintptr_t)where >= READ_ONLY_SPACE_START &&
-                (uintptr_t)where < READ_ONLY_SPACE_END &&
-                gcable_pointer_p(ptr))
-                lose("Coalesce produced RO->DS ptr");
-            *where = ptr;
+            return;
         }
+        ptr = make_lispobj((void*)ht->keys[index-1], OTHER_POINTER_LOWTAG);
     }
+    // Check for no read-only to dynamic-space pointer
+    if ((uintptr_t)where >= READ_ONLY_SPACE_START &&
+        (uintptr_t)where < READ_ONLY_SPACE_END &&
+        gcable_pointer_p(ptr))
+        lose("Coalesce produced RO->DS ptr");
+    *where = ptr;
 }
 
 /* FIXME: there are 10+ variants of the skeleton of an object traverser.
@@ -152,7 +199,7 @@ static void coalesce_obj(lispobj* where, struct hopscotch_table* ht)
 
 static uword_t coalesce_range(lispobj* where, lispobj* limit, uword_t arg)
 {
-    struct hopscotch_table* ht = (struct hopscotch_table*)arg;
+    struct coalesce_pass* pass = (struct coalesce_pass*)arg;
     lispobj *next;
     sword_t nwords, i;
 
@@ -166,7 +213,7 @@ static uword_t coalesce_range(lispobj* where, lispobj* limit, uword_t arg)
                 lispobj layout = layout_of(where);
                 struct bitmap bitmap = get_layout_bitmap(LAYOUT(layout));
                 for (i=0; i<(nwords-1); ++i)
-                    if (bitmap_logbitp(i, bitmap)) coalesce_obj(where+1+i, ht);
+                    if (bitmap_logbitp(i, bitmap)) coalesce_obj(where+1+i, pass);
                 continue;
             }
             switch (widetag) {
@@ -175,7 +222,7 @@ static uword_t coalesce_range(lispobj* where, lispobj* limit, uword_t arg)
             {
                 struct symbol* symbol = (void*)where;
                 lispobj name = decode_symbol_name(symbol->name);
-                coalesce_obj(&name, ht);
+                coalesce_obj(&name, pass);
                 set_symbol_name(symbol, name);
                 continue;
             }
@@ -188,25 +235,20 @@ static uword_t coalesce_range(lispobj* where, lispobj* limit, uword_t arg)
                     continue; // Ignore this object.
             }
             for(i=1; i<nwords; ++i)
-                coalesce_obj(where+i, ht);
+                coalesce_obj(where+i, pass);
         } else {
-            coalesce_obj(where+0, ht);
-            coalesce_obj(where+1, ht);
+            coalesce_obj(where+0, pass);
+            coalesce_obj(where+1, pass);
             next = where + 2;
         }
     }
     return 0;
 }
 
-/* Do as good as job as we can to de-duplicate strings
- * This doesn't need to scan stacks or anything fancy.
- * It's not wrong to fail to coalesce things that could have been */
-void coalesce_similar_objects()
+static void coalesce_spaces(struct coalesce_pass* pass)
 {
-    struct hopscotch_table ht;
-    uword_t arg = (uword_t)&ht;
+    uword_t arg = (uword_t)pass;
 
-    hopscotch_create(&ht, HOPSCOTCH_VECTOR_HASH, 0, 1<<17, 0);
     coalesce_range((lispobj*)READ_ONLY_SPACE_START,
                    (lispobj*)READ_ONLY_SPACE_END,
                    arg);
@@ -219,9 +261,44 @@ void coalesce_similar_objects()
     coalesce_range((lispobj*)VARYOBJ_SPACE_START, varyobj_free_pointer, arg);
 #endif
 #ifdef LISP_FEATURE_GENCGC
-    walk_generation(coalesce_range, -1, arg);
+    if (pass->shared) {
+        // Each helper writes only within the blocks it is given
+        uword_t args[GC_MAX_THREADS];
+        int i;
+        for (i = 0; i < GC_MAX_THREADS; ++i) args[i] = arg;
+        walk_generation_parallel(coalesce_range, -1, args);
+    } else
+        walk_generation(coalesce_range, -1, arg);
 #else
     coalesce_range(current_dynamic_space, get_alloc_pointer(), arg);
 #endif
+}
+
+/* Do as good as job as we can to de-duplicate strings
+ * This doesn't need to scan stacks or anything fancy.
+ * It's not wrong to fail to coalesce things that could have been */
+void coalesce_similar_objects()
+{
+#ifdef LISP_FEATURE_GENCGC
+    if (gc_n_threads > 1) {
+        struct hopscotch_striped_table table;
+        struct coalesce_pass pass = { 0, &table, 0, 0 };
+        hopscotch_striped_create(&table, HOPSCOTCH_VECTOR_HASH, N_WORD_BYTES, 1<<17, 0);
+        for (pass.round = 1; pass.round <= 2; ++pass.round) {
+            pass.electing = 1;
+            coalesce_spaces(&pass);
+            pass.electing = 0;
+            coalesce_spaces(&pass);
+            hopscotch_striped_reset(&table);
+        }
+        hopscotch_striped_destroy(&table);
+        return;
+    }
+#endif
+    struct hopscotch_table ht;
+    struct coalesce_pass pass = { &ht, 0, 0, 0 };
+
+    hopscotch_create(&ht, HOPSCOTCH_VECTOR_HASH, 0, 1<<17, 0);
+    coalesce_spaces(&pass);
     hopscotch_destroy(&ht);
 }
@@ -26,6 +26,41 @@ struct ndir_entry {
 };
 #define NDIR_ENTRY_LENGTH (sizeof (struct ndir_entry)/sizeof (core_entry_elt_t))
 
+/* A space saved with zstd is cut into chunks of ZSTD_CORE_CHUNK_BYTES (the last
+ * one possibly shorter) that are compressed independently, so that saving and
+ * loading can both work on several chunks at once. The data start with a
+ * uint64_t chunk size and chunk count, then the uint64_t compressed size of
+ * each chunk, then the chunks back to back */
+#define ZSTD_CORE_CHUNK_BYTES (4*1024*1024)
+
+/* Helper threads for saving and loading cores (see coreparse.c) */
+#define CORE_MAX_WORKER_THREADS 16
+extern void run_core_workers(void* (*fun)(void*), void* arg);
+
+/* A delta core names its base core in a BASE_CORE entry that precedes the
+ * directory. A space flagged with DELTA_CORE_SPACE_ID_FLAG begins with a
+ * struct delta_space_header and a bitmap with a bit per page, padded to a
+ * page. The pages whose bits are set follow, and the rest are mapped from
+ * the same space in the base core, which has to be uncompressed */
+#if defined LISP_FEATURE_GENCGC && !defined LISP_FEATURE_WIN32 \
+    && !defined LISP_FEATURE_DARWIN_JIT
+#define DELTA_CORES 1
+#endif
+struct delta_space_header {
+    uint64_t base_offset; // file offset of the space in the base core
+    uint64_t base_npages; // how many pages may come from the base core
+    uint64_t n_changed;
+    uint64_t header_bytes; // including the bitmap and padding
+};
+/* What a delta core checks to know that its base core didn't change */
+static inline uint32_t core_header_fingerprint(unsigned char *bytes, size_t n)
+{
+    uint32_t hash = 2166136261U; // FNV-1a
+    size_t i;
+    for (i = 0; i < n; ++i) hash = (hash ^ bytes[i]) * 16777619U;
+    return hash;
+}
+
 #define RUNTIME_OPTIONS_MAGIC 0x31EBF355
 /* 1 for magic, 1 for core entry size in words, 3 for struct memsize_options fields
  * excluding the 'present_in_core' field */
@@ -47,6 +47,13 @@
 #ifdef LISP_FEATURE_SB_CORE_COMPRESSION
 # include <zlib.h>
 #endif
+#ifdef LISP_FEATURE_SB_CORE_ZSTD
+# include <zstd.h>
+#endif
+#if defined LISP_FEATURE_SB_THREAD && !defined LISP_FEATURE_WIN32
+# include <pthread.h>
+# include <signal.h>
+#endif
 
 /* build_id must match between the C code and .core file because a core
  * is only guaranteed to be compatible with the C runtime that created it.
@@ -167,6 +174,31 @@ lose:
     return core_start;
 }
 
+/* Run 'fun' on 'arg' in as many threads as there are processors, up to
+ * CORE_MAX_WORKER_THREADS and counting the calling thread, and wait for all
+ * of them. This is for work on a core being saved or loaded, when the GC
+ * thread pool isn't running. The helpers block all signals, since they
+ * aren't Lisp threads */
+void run_core_workers(void* (*fun)(void*), void* arg)
+{
+#if defined LISP_FEATURE_SB_THREAD && !defined LISP_FEATURE_WIN32
+    pthread_t threads[CORE_MAX_WORKER_THREADS];
+    long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int i, n_started = 0;
+    if (n_threads > CORE_MAX_WORKER_THREADS) n_threads = CORE_MAX_WORKER_THREADS;
+    sigset_t all, old;
+    sigfillset(&all);
+    thread_sigmask(SIG_BLOCK, &all, &old);
+    for (i = 1; i < n_threads; ++i)
+        if (!pthread_create(&threads[n_started], 0, fun, arg)) ++n_started;
+    thread_sigmask(SIG_SETMASK, &old, 0);
+    fun(arg);
+    for (i = 0; i < n_started; ++i) pthread_join(threads[i], 0);
+#else
+    fun(arg);
+#endif
+}
+
 #ifndef LISP_FEATURE_SB_CORE_COMPRESSION
 # define inflate_core_bytes(fd,offset,addr,len) \
     lose("This runtime was not built with zlib-compressed core support... aborting")
@@ -239,6 +271,148 @@ static void inflate_core_bytes(int fd, os_vm_offset_t offset,
 # undef ZLIB_BUFFER_SIZE
 #endif
 
+#ifndef LISP_FEATURE_SB_CORE_ZSTD
+# define zstd_decompress_core_bytes(fd,offset,addr,len) \
+    lose("This runtime was not built with zstd-compressed core support... aborting")
+#else
+struct zstd_load_job {
+    int fd;
+    char *addr;
+    uword_t len;
+    uint64_t chunk_bytes;
+    uint64_t n_chunks;
+    uint64_t *sizes;
+    os_vm_offset_t *offsets; // file offset of each chunk
+    int next_chunk; // claimed by atomic increment
+};
+
+static void* decompress_zstd_chunks(void* arg)
+{
+    struct zstd_load_job *job = arg;
+    void *buf = 0;
+    uint64_t buf_size = 0, i;
+    while ((i = __sync_fetch_and_add(&job->next_chunk, 1)) < job->n_chunks) {
+        if (job->sizes[i] > buf_size) {
+            free(buf);
+            buf = successful_malloc(buf_size = job->sizes[i]);
+        }
+        if (pread(job->fd, buf, job->sizes[i], job->offsets[i]) != (ssize_t)job->sizes[i])
+            lose("unable to read core file (errno = %i)", errno);
+        uword_t start = i * job->chunk_bytes;
+        uword_t expected = (job->len - start < job->chunk_bytes)
+                           ? job->len - start : job->chunk_bytes;
+        size_t result = ZSTD_decompress(job->addr + start, expected, buf, job->sizes[i]);
+        if (ZSTD_isError(result))
+            lose("zstd decompression error: %s", ZSTD_getErrorName(result));
+        if (result != expected)
+            lose("zstd-compressed core chunk %d has %lu bytes, expected %lu",
+                 (int)i, (unsigned long)result, (unsigned long)expected);
+    }
+    free(buf);
+    return 0;
+}
+
+/* Decompress a space saved in the chunked format described in core.h,
+ * directly into its memory, reading and decompressing chunks in parallel */
+static void zstd_decompress_core_bytes(int fd, os_vm_offset_t offset,
+                                       os_vm_address_t addr, uword_t len)
+{
+    uint64_t header[2];
+    if (pread(fd, header, sizeof header, offset) != sizeof header)
+        lose("unable to read core file (errno = %i)", errno);
+    struct zstd_load_job job = { fd, (char*)addr, len, header[0], header[1], 0, 0, 0 };
+    if (job.chunk_bytes == 0 || job.n_chunks == 0
+        || (job.n_chunks - 1) * job.chunk_bytes >= len
+        || job.n_chunks * job.chunk_bytes < len)
+        lose("corrupt zstd-compressed core directory... aborting");
+    job.sizes = successful_malloc(job.n_chunks * sizeof (uint64_t));
+    job.offsets = successful_malloc(job.n_chunks * sizeof (os_vm_offset_t));
+    ssize_t table_bytes = job.n_chunks * sizeof (uint64_t);
+    if (pread(fd, job.sizes, table_bytes, offset + sizeof header) != table_bytes)
+        lose("unable to read core file (errno = %i)", errno);
+    os_vm_offset_t chunk_offset = offset + sizeof header + table_bytes;
+    uint64_t i;
+    for (i = 0; i < job.n_chunks; ++i) {
+        job.offsets[i] = chunk_offset;
+        chunk_offset += job.sizes[i];
+    }
+    run_core_workers(decompress_zstd_chunks, &job);
+    free(job.offsets);
+    free(job.sizes);
+}
+#endif
+
+#ifndef DELTA_CORES
+# define load_delta_core_bytes(fd,offset,addr,len,execute) \
+    lose("This runtime can't load delta cores... aborting")
+#else
+static int base_core_fd = -1;
+
+/* Open the base core named by the BASE_CORE entry at 'ptr',
+ * and make sure it is the same file that the delta was saved against */
+static void open_base_core(core_entry_elt_t *ptr)
+{
+    os_vm_offset_t size = ptr[0], start = ptr[1];
+    uint32_t fingerprint = ptr[2];
+    int stringlen = ptr[3];
+    char *path = successful_malloc(stringlen + 1);
+    memcpy(path, ptr + 4, stringlen);
+    path[stringlen] = 0;
+    int fd = open_binary(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        lose("can't open base core %s", path);
+    }
+    struct stat st;
+    unsigned char *header = successful_malloc(os_vm_page_size);
+    if (fstat(fd, &st) != 0 || st.st_size != (off_t)size
+        || pread(fd, header, os_vm_page_size, start) != (ssize_t)os_vm_page_size
+        || core_header_fingerprint(header, os_vm_page_size) != fingerprint)
+        lose("base core %s has changed since the delta core was saved", path);
+    free(header);
+    free(path);
+    base_core_fd = fd;
+}
+
+/* Map the pages of a delta space that are unchanged from the base core,
+ * then the changed pages over them */
+static void load_delta_core_bytes(int fd, os_vm_offset_t offset,
+                                  os_vm_address_t addr, uword_t len, int execute)
+{
+    struct delta_space_header header;
+    uword_t npages = len / os_vm_page_size, i, j, n_changed = 0;
+    size_t bitmap_bytes = ALIGN_UP(npages, N_WORD_BITS) / 8;
+    if (base_core_fd < 0)
+        lose("delta core space without a base core");
+    if (pread(fd, &header, sizeof header, offset) != sizeof header)
+        lose("unable to read core file (errno = %i)", errno);
+    if (header.base_npages > npages || header.header_bytes < sizeof header + bitmap_bytes)
+        lose("corrupt delta core space header");
+    uword_t *bitmap = successful_malloc(bitmap_bytes ? bitmap_bytes : 1);
+    if (pread(fd, bitmap, bitmap_bytes, offset + sizeof header) != (ssize_t)bitmap_bytes)
+        lose("unable to read core file (errno = %i)", errno);
+    if (header.base_npages)
+        load_core_bytes(base_core_fd, header.base_offset, addr,
+                        header.base_npages * os_vm_page_size, execute);
+    os_vm_offset_t data = offset + header.header_bytes;
+#define changed(page) ((bitmap[(page) / N_WORD_BITS] >> ((page) % N_WORD_BITS)) & 1)
+    for (i = 0; i < npages; i = j) {
+        j = i + 1;
+        if (!changed(i)) continue;
+        while (j < npages && changed(j)) ++j;
+        load_core_bytes(fd, data, addr + i * os_vm_page_size,
+                        (j - i) * os_vm_page_size, execute);
+        data += (j - i) * os_vm_page_size;
+        n_changed += j - i;
+    }
+#undef changed
+    if (n_changed != header.n_changed)
+        lose("corrupt delta core space: %lu changed pages, expected %lu",
+             (unsigned long)n_changed, (unsigned long)header.n_changed);
+    free(bitmap);
+}
+#endif
+
 #define DYNAMIC_SPACE_ADJ_INDEX 0
 struct heap_adjust {
     /* range[0] is dynamic space, ranges[1] and [2] are immobile spaces */
@@ -249,6 +423,8 @@ struct heap_adjust {
     int n_ranges;
     int n_relocs_abs; // absolute
     int n_relocs_rel; // relative
+    uint32_t *reloc_map; // from the core file, if it has one
+    uword_t reloc_map_npages;
 };
 
 #include "genesis/gc-tables.h"
@@ -592,6 +768,141 @@ static void relocate_space(uword_t start, lispobj* end, struct heap_adjust* adj)
 #endif
 }
 
+#ifdef LISP_FEATURE_GENCGC
+/* A relocation map has one entry per page of dynamic space: the word offset
+ * of the first object starting on the page that might need adjustment if
+ * any space moves, or RELOC_MAP_SKIP_PAGE if there is none. A page with no
+ * such object, because it holds only unboxed data or pointers to spaces
+ * that never move, is neither read nor written by relocation, so it stays
+ * shared with the mapped core file.
+ * This has to agree with relocate_space() about what can need adjustment */
+#define RELOC_MAP_SKIP_PAGE 0xFFFFFFFF
+
+static boolean relocatable_pointer_p(lispobj word)
+{
+    return is_lisp_pointer(word) && (find_page_index((void*)word) >= 0
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+                                     || immobile_space_p(word)
+#endif
+        );
+}
+
+static boolean may_need_relocation_p(lispobj* where)
+{
+    lispobj word = *where;
+    if (!is_header(word))
+        return relocatable_pointer_p(where[0]) || relocatable_pointer_p(where[1]);
+    int widetag = header_widetag(word);
+    sword_t nwords, i;
+    switch (widetag) {
+    case SIMPLE_VECTOR_WIDETAG:
+        if (vector_flagp(word, VectorAddrHashing)) return 1;
+        /* FALLTHROUGH */
+    case SIMPLE_ARRAY_WIDETAG:
+#ifdef COMPLEX_CHARACTER_STRING_WIDETAG
+    case COMPLEX_CHARACTER_STRING_WIDETAG:
+#endif
+    case COMPLEX_BASE_STRING_WIDETAG:
+    case COMPLEX_BIT_VECTOR_WIDETAG:
+    case COMPLEX_VECTOR_WIDETAG:
+    case COMPLEX_ARRAY_WIDETAG:
+    case VALUE_CELL_WIDETAG:
+    case WEAK_POINTER_WIDETAG:
+    case RATIO_WIDETAG:
+    case COMPLEX_WIDETAG:
+        // relocate_space() adjusts only the tagged pointers in these
+        nwords = sizetab[widetag](where);
+        for (i = 1; i < nwords; ++i)
+            if (relocatable_pointer_p(where[i])) return 1;
+        return 0;
+    case BIGNUM_WIDETAG:
+#ifndef LISP_FEATURE_64_BIT
+    case SINGLE_FLOAT_WIDETAG:
+#endif
+    case DOUBLE_FLOAT_WIDETAG:
+    case COMPLEX_SINGLE_FLOAT_WIDETAG:
+    case COMPLEX_DOUBLE_FLOAT_WIDETAG:
+#ifdef SIMD_PACK_WIDETAG
+    case SIMD_PACK_WIDETAG:
+#endif
+#ifdef SIMD_PACK_256_WIDETAG
+    case SIMD_PACK_256_WIDETAG:
+#endif
+    case FILLER_WIDETAG:
+        return 0;
+    default:
+        // Anything with untagged or encoded references (instances, symbols,
+        // code, fdefns, closures, SAPs) is assumed to need adjustment
+        return !(other_immediate_lowtag_p(widetag)
+                 && specialized_vector_widetag_p(widetag));
+    }
+}
+
+static uword_t note_relocatable_objects(lispobj* where, lispobj* end, uword_t arg)
+{
+    uint32_t *map = (uint32_t*)arg;
+    for ( ; where < end ; where += OBJECT_SIZE(*where, where) ) {
+        page_index_t page = find_page_index(where);
+        if (map[page] == RELOC_MAP_SKIP_PAGE && may_need_relocation_p(where))
+            map[page] = where - (lispobj*)page_address(page);
+    }
+    return 0;
+}
+
+/* Fill in the relocation map of the heap about to be saved,
+ * which has 'next_free_page' entries */
+void gc_store_relocation_map(uint32_t *map)
+{
+    page_index_t page;
+    for (page = 0; page < next_free_page; ++page) map[page] = RELOC_MAP_SKIP_PAGE;
+    walk_generation(note_relocatable_objects, -1, (uword_t)map);
+}
+
+/* With a relocation map, every object is processed by whoever handles the
+ * page it starts on, and processing it writes only the object itself,
+ * so the pages can be divided among threads */
+#define RELOCATION_CHUNK_PAGES 64
+struct relocation_job {
+    struct heap_adjust *adj;
+    page_index_t next_page; // claimed by atomic increment
+};
+
+static void* relocate_dynamic_space_pages(void* arg)
+{
+    struct relocation_job *job = arg;
+    // A private copy, because relocate_space() updates the counters
+    struct heap_adjust adj = *job->adj;
+    page_index_t page, end;
+    while ((page = __sync_fetch_and_add(&job->next_page, RELOCATION_CHUNK_PAGES))
+           < next_free_page) {
+        end = page + RELOCATION_CHUNK_PAGES;
+        if (end > next_free_page) end = next_free_page;
+        for ( ; page < end ; ++page ) {
+            uint32_t offset = adj.reloc_map[page];
+            if (offset == RELOC_MAP_SKIP_PAGE) continue;
+            lispobj *page_base = (lispobj*)page_address(page);
+            // Process the objects that start on this page; the last may extend beyond it
+            relocate_space((uword_t)(page_base + offset), page_base + GENCGC_PAGE_WORDS, &adj);
+        }
+    }
+    return 0;
+}
+
+static void relocate_dynamic_space(struct heap_adjust* adj)
+{
+    lispobj *end = (lispobj*)dynamic_space_highwatermark();
+    if (!adj->reloc_map || adj->reloc_map_npages != (uword_t)next_free_page) {
+        relocate_space(DYNAMIC_SPACE_START, end, adj);
+        return;
+    }
+    struct relocation_job job = { adj, 0 };
+    if (next_free_page < 2 * RELOCATION_CHUNK_PAGES) // not worth any threads
+        relocate_dynamic_space_pages(&job);
+    else
+        run_core_workers(relocate_dynamic_space_pages, &job);
+}
+#endif
+
 static void relocate_heap(struct heap_adjust* adj)
 {
     if (!lisp_startup_options.noinform && SHOW_SPACE_RELOCATION) {
@@ -612,8 +923,7 @@ static void relocate_heap(struct heap_adjust* adj)
 #ifdef LISP_FEATURE_CHENEYGC
     relocate_space(DYNAMIC_0_SPACE_START, (lispobj*)get_alloc_pointer(), adj);
 #else
-    relocate_space(DYNAMIC_SPACE_START, (lispobj*)dynamic_space_highwatermark(),
-                   adj);
+    relocate_dynamic_space(adj);
 #endif
 #ifdef LISP_FEATURE_IMMOBILE_SPACE
     // Pointers within varyobj space to varyobj space do not need adjustment
@@ -821,8 +1131,9 @@ process_directory(int count, struct ndir_entry *entry,
                (int)id, addr, (int)entry->data_page, (int)entry->page_count,
                entry->nwords);
 #endif
-        int compressed = id & DEFLATED_CORE_SPACE_ID_FLAG;
-        id -= compressed;
+        int compressed = id & (DEFLATED_CORE_SPACE_ID_FLAG | ZSTD_CORE_SPACE_ID_FLAG);
+        int delta = id & DELTA_CORE_SPACE_ID_FLAG;
+        id -= compressed | delta;
         if (id < 1 || id > MAX_CORE_SPACE_ID)
             lose("unknown space ID %ld addr %p", id, (void*)addr);
 
@@ -869,6 +1180,10 @@ process_directory(int count, struct ndir_entry *entry,
                 // would be obtained by a constant offset from fixedobj space
                 addr = FIXEDOBJ_SPACE_START + FIXEDOBJ_SPACE_SIZE;
             else
+#endif
+#ifdef LISP_FEATURE_GENCGC
+            // Allow for aligning the start up to a huge page
+            if (id == DYNAMIC_CORE_SPACE_ID && gencgc_huge_pages) request += HUGE_PAGE_BYTES;
 #endif
             if (request) {
 #ifdef LISP_FEATURE_WIN32
@@ -925,7 +1240,9 @@ process_directory(int count, struct ndir_entry *entry,
                 uword_t aligned_start = ALIGN_UP(addr, GENCGC_PAGE_BYTES);
                 /* Misalignment can happen only if card size exceeds OS page.
                  * Drop one card to avoid overrunning the allocated space */
-                if (aligned_start > addr) // not card-aligned
+                if (gencgc_huge_pages) // the request was padded
+                    aligned_start = ALIGN_UP(addr, HUGE_PAGE_BYTES);
+                else if (aligned_start > addr) // not card-aligned
                     dynamic_space_size -= GENCGC_PAGE_BYTES;
                 DYNAMIC_SPACE_START = addr = aligned_start;
                 check_dynamic_space_addr_ok(addr, dynamic_space_size);
@@ -940,7 +1257,13 @@ process_directory(int count, struct ndir_entry *entry,
                 if (id == READ_ONLY_CORE_SPACE_ID)
                     os_protect((os_vm_address_t)addr, len, OS_VM_PROT_WRITE);
 #endif
-                inflate_core_bytes(fd, offset + file_offset, (os_vm_address_t)addr, len);
+                startup_trace_mark("map-core-spaces");
+                if (compressed & ZSTD_CORE_SPACE_ID_FLAG)
+                    zstd_decompress_core_bytes(fd, offset + file_offset,
+                                               (os_vm_address_t)addr, len);
+                else
+                    inflate_core_bytes(fd, offset + file_offset, (os_vm_address_t)addr, len);
+                startup_trace_mark("inflate-core-bytes");
 
 #ifdef LISP_FEATURE_DARWIN_JIT
                 if (id == READ_ONLY_CORE_SPACE_ID)
@@ -948,6 +1271,9 @@ process_directory(int count, struct ndir_entry *entry,
 #endif
 
             }
+            else if (delta)
+                load_delta_core_bytes(fd, offset + file_offset, (os_vm_address_t)addr, len,
+                                      id == READ_ONLY_CORE_SPACE_ID);
             else
 #ifdef LISP_FEATURE_DARWIN_JIT
             if (id == DYNAMIC_CORE_SPACE_ID || id == STATIC_CODE_CORE_SPACE_ID) {
@@ -959,6 +1285,12 @@ process_directory(int count, struct ndir_entry *entry,
             }
         }
 
+#if defined LISP_FEATURE_GENCGC && defined MADV_HUGEPAGE
+        if (id == DYNAMIC_CORE_SPACE_ID && gencgc_huge_pages)
+            // The whole space, not just the part that the core occupies.
+            // Advising only select ranges would split the mapping into many.
+            madvise((void*)addr, dynamic_space_size, MADV_HUGEPAGE);
+#endif
 #ifdef MADV_MERGEABLE
         if ((merge_core_pages == 1)
             || ((merge_core_pages == -1) && compressed)) {
@@ -987,6 +1319,7 @@ process_directory(int count, struct ndir_entry *entry,
             anon_dynamic_space_start = (os_vm_address_t)(addr + len);
         }
     }
+    startup_trace_mark("map-core-spaces");
 
     calc_asm_routine_bounds();
 #  ifdef LISP_FEATURE_GENCGC
@@ -1012,6 +1345,7 @@ process_directory(int count, struct ndir_entry *entry,
 #  endif // LISP_FEATURE_GENCGC
     if (adj->range[0].delta | adj->range[1].delta | adj->range[2].delta) {
         relocate_heap(adj);
+        startup_trace_mark("relocate-heap");
     }
 
 #ifdef LISP_FEATURE_IMMOBILE_SPACE
@@ -1023,8 +1357,9 @@ process_directory(int count, struct ndir_entry *entry,
                              spaces[IMMOBILE_VARYOBJ_CORE_SPACE_ID].len);
     calc_immobile_space_bounds();
 #endif
-#ifdef LISP_FEATURE_X86_64
+#if defined LISP_FEATURE_X86_64 || defined LISP_FEATURE_ARM64
     tune_asm_routines_for_microarch(); // before WPing immobile space
+    startup_trace_mark("tune-asm-routines");
 #endif
 #ifdef LISP_FEATURE_DARWIN_JIT
     if (!static_code_space_free_pointer)
@@ -1097,10 +1432,33 @@ load_core_file(char *file, os_vm_offset_t file_offset, int merge_core_pages)
             process_directory(remaining_len / NDIR_ENTRY_LENGTH,
                               (struct ndir_entry*)ptr, fd, file_offset,
                               merge_core_pages, &adj);
+            free(adj.reloc_map);
+            adj.reloc_map = 0;
+            break;
+        case RELOCATION_MAP_CORE_ENTRY_TYPE_CODE:
+            // Must precede the directory, which performs any relocation
+            adj.reloc_map_npages = ptr[0];
+            adj.reloc_map = successful_malloc(ptr[1]);
+            if (
+#if defined(LISP_FEATURE_WIN32) && defined(LISP_FEATURE_64_BIT)
+                _lseeki64
+#else
+                lseek
+#endif
+                (fd, file_offset + (ptr[2] + 1) * os_vm_page_size, SEEK_SET) < 0
+                || read(fd, adj.reloc_map, ptr[1]) != (ssize_t)ptr[1])
+                lose("failed to read relocation map");
+            break;
+        case BASE_CORE_ENTRY_TYPE_CODE:
+#ifdef DELTA_CORES
+            // Must precede the directory, which maps pages from the base core
+            open_base_core(ptr);
+#endif
             break;
         case PAGE_TABLE_CORE_ENTRY_TYPE_CODE:
             gc_load_corefile_ptes(ptr[0], ptr[1], ptr[2],
                                   file_offset + (ptr[3] + 1) * os_vm_page_size, fd);
+            startup_trace_mark("gc-load-corefile-ptes");
             break;
         case INITIAL_FUN_CORE_ENTRY_TYPE_CODE:
             initial_function = adjust_word(&adj, (lispobj)*ptr);
@@ -1108,6 +1466,10 @@ load_core_file(char *file, os_vm_offset_t file_offset, int merge_core_pages)
         case END_CORE_ENTRY_TYPE_CODE:
             free(header);
             close(fd);
+#ifdef DELTA_CORES
+            if (base_core_fd >= 0) close(base_core_fd);
+            base_core_fd = -1;
+#endif
 #ifdef LISP_FEATURE_SB_THREAD
             if ((int)SymbolValue(FREE_TLS_INDEX,0) >= dynamic_values_bytes) {
                 dynamic_values_bytes = (int)SymbolValue(FREE_TLS_INDEX,0) * 2;
@@ -9,7 +9,13 @@
 static off_t lisp_rel_section_offset;
 static ssize_t lisp_rel_section_size;
 
-// Return the offset to a file section named 'lisp.core' if there is one
+// Return the offset to a file section named 'lisp.core' if there is one.
+// The section is not loaded by the kernel. Its spaces are page-aligned in the
+// file, so load_core_bytes() maps them from it with MAP_PRIVATE, which is as
+// lazy and as shared through the page cache as a PT_LOAD segment would be.
+// What a PT_LOAD segment can't do is leave dynamic space to the GC: the space
+// has to be reserved at its full size, which is usually far more than the part
+// in the file, and be moved elsewhere when its preferred address is taken.
 off_t search_for_elf_core(int fd)
 {
     Elf64_Ehdr ehdr;
@@ -41,6 +41,13 @@ forwarding_pointer_value(lispobj *pointer) {
     return pointer[0];
 #endif
 }
+#ifdef LISP_FEATURE_GENCGC
+/* While weak triggers are pending, note the page of each transported object
+ * so that only the triggers on those pages need to be tested again */
+extern boolean gc_track_forwarded_pages;
+extern void note_forwarded_object(lispobj*);
+#endif
+
 static inline void set_forwarding_pointer(lispobj *addr, lispobj newspace_copy) {
   // The object at 'addr' might already have been forwarded,
   // but that's ok. Such occurs primarily when dealing with
@@ -52,6 +59,7 @@ static inline void set_forwarding_pointer(lispobj *addr, lispobj newspace_copy)
   // that we're operating on a not-yet-forwarded object here.
 #ifdef LISP_FEATURE_GENCGC
     gc_dcheck(compacting_p());
+    if (gc_track_forwarded_pages) note_forwarded_object(addr);
     addr[0] = FORWARDING_HEADER;
     addr[1] = newspace_copy;
 #else
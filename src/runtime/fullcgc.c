@@ -426,30 +426,10 @@ void prepare_for_full_mark_phase()
     gc_assert(!scav_queue.head_block->count);
 }
 
-void execute_full_mark_phase()
+/* Trace everything reachable from the queue, including objects which become
+ * live by way of weak hash-table triggers, until the queue stays empty. */
+static void drain_scav_queue()
 {
-#if HAVE_GETRUSAGE
-    struct rusage before, after;
-    getrusage(RUSAGE_SELF, &before);
-#endif
-    trace_object((lispobj*)NIL_SYMBOL_SLOTS_START);
-    lispobj* where = (lispobj*)STATIC_SPACE_OBJECTS_START;
-    lispobj* end = static_space_free_pointer;
-    while (where < end) {
-        lispobj obj = compute_lispobj(where);
-        gc_enqueue(obj);
-        where += listp(obj) ? 2 : sizetab[widetag_of(where)](where);
-    }
-#ifdef LISP_FEATURE_METASPACE
-    where = (lispobj*)METASPACE_START;
-    end = (lispobj*)READ_ONLY_SPACE_END;
-    while (where < end) {
-        lispobj obj = compute_lispobj(where);
-        gc_enqueue(obj);
-        where += listp(obj) ? 2 : sizetab[widetag_of(where)](where);
-    }
-#endif
-    gc_mark_obj(lisp_package_vector);
     do {
         lispobj ptr = gc_dequeue();
         gc_dcheck(ptr != 0);
@@ -460,6 +440,50 @@ void execute_full_mark_phase()
     } while (scav_queue.head_block->count ||
              (test_weak_triggers(pointer_survived_gc_yet, gc_mark_obj) &&
               scav_queue.head_block->count));
+}
+
+/* The mark phase runs with the world stopped, start to finish.
+ * Letting it run concurrently with Lisp threads, with only a final remark
+ * stopping the world, would require at least the following:
+ *  - Mark bits kept out of line. Header mark bits can not coexist with
+ *    Lisp threads doing unsynchronized read-modify-write of header bits
+ *    (hash flags of symbols and instances, for example).
+ *  - Objects allocated during the mark being treated as marked. Otherwise
+ *    the sweep erases them, because nothing traced them. That means either
+ *    closing every thread's allocation region at the start of the mark, or
+ *    having the allocator know that a mark is in progress.
+ *  - A remark that rescans the cards dirtied since the mark began. Soft
+ *    card marks record stores to boxed pages, but the mark needs its own
+ *    copy of them, because the generational collector clears them.
+ *    Physical page protection gives no blocking-free way to do this.
+ *  - Weak objects and weak hash-table triggers resolved only during the
+ *    remark, since a mutator could resurrect something that was judged dead.
+ * So the mark stays stop-the-world, and drain_scav_queue() is kept separate
+ * so that a remark step could reuse it. */
+/* Enqueue every object from 'where' to 'end', which are roots */
+static void enqueue_range(lispobj* where, lispobj* end)
+{
+    while (where < end) {
+        lispobj obj = compute_lispobj(where);
+        gc_enqueue(obj);
+        where += listp(obj) ? 2 : sizetab[widetag_of(where)](where);
+    }
+}
+
+void execute_full_mark_phase()
+{
+#if HAVE_GETRUSAGE
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+#endif
+    trace_object((lispobj*)NIL_SYMBOL_SLOTS_START);
+    enqueue_range((lispobj*)STATIC_SPACE_OBJECTS_START, static_space_free_pointer);
+#ifdef LISP_FEATURE_METASPACE
+    enqueue_range((lispobj*)METASPACE_START, (lispobj*)READ_ONLY_SPACE_END);
+#endif
+    walk_arenas(enqueue_range);
+    gc_mark_obj(lisp_package_vector);
+    drain_scav_queue();
 
 #if HAVE_GETRUSAGE
     getrusage(RUSAGE_SELF, &after);
@@ -653,7 +677,21 @@ void execute_full_sweep_phase()
           (uword_t)words_zeroed);
 #endif
     if (sweeplog) fprintf(sweeplog, "-- dynamic space --\n");
-    walk_generation(sweep, -1, (uword_t)words_zeroed);
+    if (sweep_mode & 2 || gc_n_threads <= 1)
+        walk_generation(sweep, -1, (uword_t)words_zeroed);
+    else {
+        /* Sweeping an object writes only to that object, so blocks can be
+         * swept independently, each helper keeping its own tally.
+         * (Not so when printing the garbage, which is done serially) */
+        long tallies[GC_MAX_THREADS][1+PSEUDO_STATIC_GENERATION];
+        uword_t args[GC_MAX_THREADS];
+        int i, j;
+        memset(tallies, 0, sizeof tallies);
+        for (i = 0; i < gc_n_threads; ++i) args[i] = (uword_t)tallies[i];
+        walk_generation_parallel(sweep, -1, args);
+        for (i = 0; i < gc_n_threads; ++i)
+            for (j = 0; j <= PSEUDO_STATIC_GENERATION; ++j) words_zeroed[j] += tallies[i][j];
+    }
     if (gencgc_verbose) {
         fprintf(stderr, "[Sweep phase: ");
         int i;
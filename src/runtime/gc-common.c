@@ -28,7 +28,11 @@
 #include <stdio.h>
 #include <signal.h>
 #include <string.h>
+#include <time.h>
 #include "sbcl.h"
+#ifdef LISP_FEATURE_LINUX
+#include <sys/mman.h>
+#endif
 #include "runtime.h"
 #include "os.h"
 #include "interr.h"
@@ -47,6 +51,9 @@
 #define WANT_SCAV_TRANS_SIZE_TABLES
 #include "gc-internal.h"
 #include "gc-private.h"
+#ifdef LISP_FEATURE_GENCGC
+#include "gencgc-private.h"
+#endif
 #include "forwarding-ptr.h"
 #include "var-io.h"
 #include "search.h"
@@ -88,6 +95,44 @@ struct cons *weak_vectors;
 
 os_vm_size_t bytes_consed_between_gcs = 12*1024*1024;
 
+uint64_t gc_monotonic_nsec()
+{
+#if defined LISP_FEATURE_WIN32 && defined LISP_FEATURE_64_BIT
+    extern uword_t get_monotonic_time(); // microseconds
+    return (uint64_t)get_monotonic_time() * 1000;
+#elif defined LISP_FEATURE_WIN32
+    return 0;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+uword_t gc_pause_histogram[GC_N_PHASES][GC_HISTOGRAM_BUCKETS];
+void gc_record_pause(enum gc_pause_phase phase, long nsec)
+{
+    uword_t usec = nsec > 0 ? nsec / 1000 : 0;
+    int bucket = 0;
+    while (usec && bucket < GC_HISTOGRAM_BUCKETS-1) { ++bucket; usec >>= 1; }
+    // Relaxed, because readers don't need a consistent snapshot
+    __atomic_store_n(&gc_pause_histogram[phase][bucket],
+                     gc_pause_histogram[phase][bucket] + 1, __ATOMIC_RELAXED);
+}
+
+struct stop_offender gc_stop_offenders[N_STOP_OFFENDERS];
+void gc_note_stop_offender(uword_t nsec, uword_t pc, uword_t os_kernel_tid)
+{
+    int i = N_STOP_OFFENDERS - 1;
+    if (nsec <= gc_stop_offenders[i].nsec) return;
+    // Insertion sort from the end, dropping the least bad entry
+    for ( ; i > 0 && gc_stop_offenders[i-1].nsec < nsec ; --i)
+        gc_stop_offenders[i] = gc_stop_offenders[i-1];
+    gc_stop_offenders[i].nsec = nsec;
+    gc_stop_offenders[i].pc = pc;
+    gc_stop_offenders[i].os_kernel_tid = os_kernel_tid;
+}
+
 #ifdef LISP_FEATURE_PPC64
 // unevenly spaced pointer lowtags
 static void (*scav_ptr[16])(lispobj *where, lispobj object); /* forward decl */
@@ -132,8 +177,12 @@ static inline void scav1(lispobj* addr, lispobj object)
         if (page_table[page].gen == from_space) {
             if (forwarding_pointer_p(native_pointer(object)))
                 *addr = forwarding_pointer_value(native_pointer(object));
-            else if (!pinned_p(object, page))
-                scav_ptr[PTR_SCAVTAB_INDEX(object)](addr, object);
+            else if (!pinned_p(object, page)) {
+                if (mark_in_place_p(page))
+                    gc_mark_in_place(object);
+                else
+                    scav_ptr[PTR_SCAVTAB_INDEX(object)](addr, object);
+            }
         }
     }
 #ifdef LISP_FEATURE_IMMOBILE_SPACE
@@ -255,7 +304,10 @@ int descriptors_scavenge(lispobj *start, lispobj* end,
                     if (forwarding_pointer_p(native_pointer(ptr))) {
                         *where = forwarding_pointer_value(native_pointer(ptr));
                     } else if (!pinned_p(ptr, page)) {
-                        scav_ptr[PTR_SCAVTAB_INDEX(ptr)](where, ptr);
+                        if (mark_in_place_p(page))
+                            gc_mark_in_place(ptr);
+                        else
+                            scav_ptr[PTR_SCAVTAB_INDEX(ptr)](where, ptr);
                     }
                 }
             }
@@ -399,6 +451,11 @@ trans_code(struct code *code)
     /* Cheneygc doesn't need this os_flush_icache, it flushes the whole
        spaces once when all copying is done. */
     os_flush_icache(code_text_start(new_code), code_text_size(new_code));
+#ifdef LISP_FEATURE_LINUX
+    extern int perf_map_enabled;
+    extern void perf_map_note_moved_code(struct code*);
+    if (perf_map_enabled) perf_map_note_moved_code(new_code);
+#endif
 #endif
     return new_code;
 }
@@ -553,6 +610,13 @@ static inline lispobj copy_instance(lispobj object)
                  (layout_flags(layout) & STRICTLY_BOXED_FLAG))
             page_type = PAGE_TYPE_BOXED, region = boxed_region;
     }
+    if (page_type == PAGE_TYPE_SMALL_MIXED && gencgc_size_class_pages) {
+        // This is the size allocated below, including any added hash slot
+        int length = original_length;
+        if (((header >> 8) & 3) == 1) length += length & 1;
+        int nwords = 1 + (length|1);
+        if (nwords <= SIZE_CLASS_MAX_NWORDS) region = size_class_region_for(nwords);
+    }
 #endif
 
     lispobj copy;
@@ -1190,32 +1254,81 @@ static lispobj trans_weakptr(lispobj object) {
 }
 static sword_t size_weakptr(lispobj *where) { return WEAKPTR_SIZE(where); }
 
+static void smash_weak_pointer(struct weak_pointer* wp)
+{
+    lispobj val = wp->value;
+    /* A weak pointer is placed onto the list only if it points to an object
+     * that could potentially die. So first of all, 'val' must be a pointer,
+     * and secondly it must not be in the assumed live set, which is checked
+     * below by way of falling into lose(), which shouldn't happen */
+    gc_assert(is_lisp_pointer(val));
+
+    /* Now, we need to check whether the object has been forwarded. If
+     * it has been, the weak pointer is still good and needs to be
+     * updated. Otherwise, the weak pointer needs to be broken. */
+    TEST_WEAK_CELL(wp->value, val, UNBOUND_MARKER_WIDETAG)
+#ifdef LISP_FEATURE_GENCGC
+    // Large objects are "moved" by touching the page table gen field.
+    // Do nothing if the target of this weak pointer had that happen.
+    else if (new_space_p(val)) { }
+#endif
+    else
+        lose("unbreakable pointer %p", wp);
+}
+
+#ifdef LISP_FEATURE_GENCGC
+/* With GC helper threads, the chain is copied into an array which the
+ * workers split between them. Following the chain has to be done serially,
+ * but it reads only the weak pointers themselves, which were mostly copied
+ * next to each other, while testing each pointee for a forwarding pointer
+ * is a cache miss that the workers can take in parallel */
+static struct weak_pointer** smashable_weak_pointers;
+static sword_t n_smashable_weak_pointers, smashable_weak_pointers_capacity;
+static sword_t smash_cursor;
+#define WEAK_SMASH_CHUNK 4096
+
+static void smash_weak_pointers_task(int __attribute__((unused)) worker,
+                                     void __attribute__((unused)) *arg)
+{
+    sword_t start, end, i;
+    while ((start = __sync_fetch_and_add(&smash_cursor, WEAK_SMASH_CHUNK))
+           < n_smashable_weak_pointers) {
+        end = start + WEAK_SMASH_CHUNK;
+        if (end > n_smashable_weak_pointers) end = n_smashable_weak_pointers;
+        for (i = start; i < end; ++i)
+            smash_weak_pointer(smashable_weak_pointers[i]);
+    }
+}
+#endif
+
 void smash_weak_pointers(void)
 {
     struct weak_pointer *wp, *next_wp;
+#ifdef LISP_FEATURE_GENCGC
+    if (gc_n_threads > 1) {
+        sword_t n = 0;
+        for (wp = weak_pointer_chain; wp != WEAK_POINTER_CHAIN_END; wp = next_wp) {
+            gc_assert(widetag_of(&wp->header) == WEAK_POINTER_WIDETAG);
+            next_wp = get_weak_pointer_next(wp);
+            reset_weak_pointer_next(wp);
+            smashable_weak_pointers =
+                grow_gc_array(smashable_weak_pointers, &smashable_weak_pointers_capacity,
+                              n, n + 1, sizeof (struct weak_pointer*));
+            smashable_weak_pointers[n++] = wp;
+        }
+        n_smashable_weak_pointers = n;
+        smash_cursor = 0;
+        if (n >= 16 * WEAK_SMASH_CHUNK)
+            gc_run_on_thread_pool(smash_weak_pointers_task, 0);
+        else
+            smash_weak_pointers_task(0, 0);
+    } else
+#endif
     for (wp = weak_pointer_chain; wp != WEAK_POINTER_CHAIN_END; wp = next_wp) {
         gc_assert(widetag_of(&wp->header) == WEAK_POINTER_WIDETAG);
         next_wp = get_weak_pointer_next(wp);
         reset_weak_pointer_next(wp);
-
-        lispobj val = wp->value;
-        /* A weak pointer is placed onto the list only if it points to an object
-         * that could potentially die. So first of all, 'val' must be a pointer,
-         * and secondly it must not be in the assumed live set, which is checked
-         * below by way of falling into lose(), which shouldn't happen */
-        gc_assert(is_lisp_pointer(val));
-
-        /* Now, we need to check whether the object has been forwarded. If
-         * it has been, the weak pointer is still good and needs to be
-         * updated. Otherwise, the weak pointer needs to be broken. */
-        TEST_WEAK_CELL(wp->value, val, UNBOUND_MARKER_WIDETAG)
-#ifdef LISP_FEATURE_GENCGC
-        // Large objects are "moved" by touching the page table gen field.
-        // Do nothing if the target of this weak pointer had that happen.
-        else if (new_space_p(val)) { }
-#endif
-        else
-            lose("unbreakable pointer %p", wp);
+        smash_weak_pointer(wp);
     }
     weak_pointer_chain = WEAK_POINTER_CHAIN_END;
 
@@ -1251,6 +1364,25 @@ void smash_weak_pointers(void)
  * target-hash-table.lisp.  */
 #define EQ_HASH(key) ((key) & EQ_HASH_MASK)
 
+/* Return 'array' grown to hold at least 'needed' elements of 'size' bytes,
+ * updating '*capacity' and preserving the first 'used' elements */
+void* grow_gc_array(void* array, sword_t* capacity, sword_t used,
+                           sword_t needed, size_t size)
+{
+    if (needed <= *capacity) return array;
+    sword_t new_capacity = *capacity ? *capacity : 16;
+    while (new_capacity < needed) new_capacity *= 2;
+    new_capacity = ALIGN_UP(new_capacity * size, os_reported_page_size) / size;
+    void* new_array = os_allocate(new_capacity * size);
+    if (!new_array) lose("Can't allocate %ld bytes for GC", (long)(new_capacity * size));
+    if (array) {
+        memcpy(new_array, array, used * size);
+        os_deallocate(array, *capacity * size);
+    }
+    *capacity = new_capacity;
+    return new_array;
+}
+
 /* List of weak hash tables chained through their NEXT-WEAK-HASH-TABLE
  * slot. Set to NULL at the end of a collection.
  *
@@ -1261,6 +1393,30 @@ void smash_weak_pointers(void)
 struct hash_table *weak_hash_tables = NULL;
 struct hopscotch_table weak_objects; // other than weak pointers
 
+/* Testing weak triggers and culling weak tables are each split into a pass
+ * that only tests liveness and can run on the GC helper threads, and a pass
+ * that acts on what the first one found, run by the collecting thread.
+ * The first pass of each saves its findings in its worker's list */
+#ifdef LISP_FEATURE_GENCGC
+#define N_WEAK_WORKERS GC_MAX_THREADS
+#define run_weak_task(task, arg, n_chunks) \
+    (n_chunks >= 16 ? gc_run_on_thread_pool(task, arg) : task(0, arg))
+#else
+#define N_WEAK_WORKERS 1
+#define run_weak_task(task, arg, n_chunks) task(0, arg)
+#endif
+static struct weak_worklist {
+    void* items;
+    sword_t count, capacity;
+} weak_worklists[N_WEAK_WORKERS];
+
+static inline void* weak_worklist_push(struct weak_worklist* list, size_t size)
+{
+    list->items = grow_gc_array(list->items, &list->capacity, list->count,
+                                list->count + 1, size);
+    return (char*)list->items + size * list->count++;
+}
+
 /* Return true if OBJ has already survived the current GC. */
 static inline int pointer_survived_gc_yet(lispobj obj)
 {
@@ -1312,13 +1468,124 @@ void add_to_weak_vector_list(lispobj* vector, lispobj header)
     }
 }
 
+#ifdef LISP_FEATURE_GENCGC
+/* When compacting, each triggering object is also listed under the page that
+ * it starts on, or in 'other_space_triggers' if not in dynamic space.
+ * While any trigger is pending, transporting an object or promoting a large one
+ * flags its pages, so test_weak_triggers() has to look only at the objects
+ * on flagged pages and in other spaces. Its cost is then proportional
+ * to what was transported since the previous test, and not to the
+ * number of triggers times the number of tests */
+boolean gc_track_forwarded_pages;
+static struct hopscotch_table trigger_pages; // 1 + page index -> list of objects
+static struct cons* other_space_triggers;
+static unsigned char* forwarded_page_flags;
+static page_index_t* forwarded_pages;
+static sword_t n_forwarded_pages, forwarded_pages_capacity;
+
+void note_forwarded_pages(page_index_t page, page_index_t npages)
+{
+    if (!forwarded_page_flags)
+        forwarded_page_flags = (void*)os_allocate(ALIGN_UP(page_table_pages, os_reported_page_size));
+    for ( ; npages > 0 ; --npages, ++page )
+        if (!forwarded_page_flags[page]) {
+            forwarded_page_flags[page] = 1;
+            forwarded_pages = grow_gc_array(forwarded_pages, &forwarded_pages_capacity,
+                                            n_forwarded_pages, n_forwarded_pages + 1,
+                                            sizeof (page_index_t));
+            forwarded_pages[n_forwarded_pages++] = page;
+        }
+}
+
+void note_forwarded_object(lispobj* addr)
+{
+    page_index_t page = find_page_index(addr);
+    if (page >= 0 && !(forwarded_page_flags && forwarded_page_flags[page]))
+        note_forwarded_pages(page, 1);
+}
+
+static void index_trigger(lispobj triggering_object)
+{
+    page_index_t page = find_page_index(native_pointer(triggering_object));
+    if (page < 0) {
+        other_space_triggers = (struct cons*)
+            gc_private_cons(triggering_object, (uword_t)other_space_triggers);
+    } else {
+        if (!trigger_pages.keys)
+            hopscotch_create(&trigger_pages, HOPSCOTCH_HASH_FUN_DEFAULT, N_WORD_BYTES,
+                             32 /* logical bin count */, 0 /* default range */);
+        hopscotch_put(&trigger_pages, 1 + page,
+                      gc_private_cons(triggering_object,
+                                      hopscotch_get(&trigger_pages, 1 + page, 0)));
+    }
+    gc_track_forwarded_pages = 1;
+}
+
+static void reset_trigger_index()
+{
+    sword_t i;
+    for (i = 0; i < n_forwarded_pages; ++i) forwarded_page_flags[forwarded_pages[i]] = 0;
+    n_forwarded_pages = 0;
+    if (trigger_pages.count) hopscotch_reset(&trigger_pages);
+    other_space_triggers = 0;
+    gc_track_forwarded_pages = 0;
+}
+
+/* Append to 'fired' the objects in 'list' whose triggers are pending and that
+ * survived, and return the rest of the list */
+static struct cons* find_fired_indexed_triggers(struct cons* list, struct weak_worklist* fired)
+{
+    extern void gc_private_free(struct cons*);
+    struct cons* keep = 0;
+    while (list) {
+        struct cons* next = (struct cons*)list->cdr;
+        lispobj trigger_obj = list->car;
+        if (!hopscotch_containsp(&weak_objects, trigger_obj)) { // fired already
+            list->cdr = 0;
+            gc_private_free(list);
+        } else if (pointer_survived_gc_yet(trigger_obj)) {
+            *(lispobj*)weak_worklist_push(fired, sizeof (lispobj)) = trigger_obj;
+            list->cdr = 0;
+            gc_private_free(list);
+        } else {
+            list->cdr = (uword_t)keep;
+            keep = list;
+        }
+        list = next;
+    }
+    return keep;
+}
+
+/* Find the pending triggers that fired by looking only at the flagged pages */
+static void find_fired_triggers_incrementally(struct weak_worklist* fired)
+{
+    other_space_triggers = find_fired_indexed_triggers(other_space_triggers, fired);
+    sword_t i;
+    for (i = 0; i < n_forwarded_pages; ++i) {
+        page_index_t page = forwarded_pages[i];
+        forwarded_page_flags[page] = 0;
+        struct cons* list = (struct cons*)hopscotch_get(&trigger_pages, 1 + page, 0);
+        if (!list) continue;
+        list = find_fired_indexed_triggers(list, fired);
+        if (list)
+            hopscotch_put(&trigger_pages, 1 + page, (uword_t)list);
+        else
+            hopscotch_delete(&trigger_pages, 1 + page);
+    }
+    n_forwarded_pages = 0;
+}
+#endif
+
 static inline void add_trigger(lispobj triggering_object, lispobj* plivened_object)
 {
-    if (is_lisp_pointer(*plivened_object)) // Nonpointer objects are ignored
+    if (is_lisp_pointer(*plivened_object)) { // Nonpointer objects are ignored
+        uword_t chain = hopscotch_get(&weak_objects, triggering_object, 0);
+#ifdef LISP_FEATURE_GENCGC
+        if (!chain && compacting_p()) index_trigger(triggering_object);
+#endif
         hopscotch_put(&weak_objects, triggering_object,
-                      gc_private_cons((uword_t)plivened_object,
-                                       hopscotch_get(&weak_objects,
-                                                     triggering_object, 0)));
+                      gc_private_cons((uword_t)plivened_object, chain));
+    }
 }
 
 int debug_weak_ht = 0;
@@ -1355,38 +1622,77 @@ static inline void add_kv_triggers(lispobj* pair, int weakness)
  * fixes the scaling problem in a huge way, it's not an important question.
  */
 
+struct trigger_test {
+    sword_t cursor, limit;
+    int (*predicate)(lispobj);
+};
+#define TRIGGER_TEST_CHUNK 8192 /* hopscotch cells */
+
+static void find_fired_triggers(int worker, void* arg)
+{
+    struct trigger_test* state = arg;
+    struct weak_worklist* fired = &weak_worklists[worker];
+    sword_t start, end, index;
+    while ((start = __sync_fetch_and_add(&state->cursor, TRIGGER_TEST_CHUNK))
+           < state->limit) {
+        end = start + TRIGGER_TEST_CHUNK;
+        if (end > state->limit) end = state->limit;
+        for (index = start; index < end; ++index) {
+            lispobj trigger_obj = weak_objects.keys[index];
+            if (!trigger_obj) continue;
+            gc_assert(is_lisp_pointer(trigger_obj));
+            if (state->predicate(trigger_obj))
+                *(lispobj*)weak_worklist_push(fired, sizeof (lispobj)) = trigger_obj;
+            else if (debug_weak_ht)
+                fprintf(stderr, "weak object %"OBJ_FMTX" still dead\n", trigger_obj);
+        }
+    }
+}
+
 /* Call 'predicate' on each triggering object, and if it returns 1, then call
- * 'mark' on each livened object, or use scav1() if 'mark' is null */
+ * 'mark' on each livened object, or use scav1() if 'mark' is null.
+ * Only the objects not yet known to be live are tested again on each call,
+ * because a trigger is removed once it fires */
 boolean test_weak_triggers(int (*predicate)(lispobj), void (*mark)(lispobj))
 {
     extern void gc_private_free(struct cons*);
     int old_count = weak_objects.count;
-    int index;
-    lispobj trigger_obj;
 
     if (!old_count) return 0;
     if (debug_weak_ht)
         printf("begin scan_weak_pairs: count=%d\n", old_count);
 
-    struct cons **values = (struct cons**)weak_objects.values;
-    if (!predicate)
-        predicate = pointer_survived_gc_yet;
+#ifdef LISP_FEATURE_GENCGC
+    if (!predicate && gc_track_forwarded_pages)
+        find_fired_triggers_incrementally(&weak_worklists[0]);
+    else
+#endif
+    {
+        struct trigger_test state = { 0, hopscotch_max_key_index(weak_objects) + 1,
+                                      predicate ? predicate : pointer_survived_gc_yet };
+        run_weak_task(find_fired_triggers, &state, state.limit / TRIGGER_TEST_CHUNK);
+    }
 
-    for_each_hopscotch_key(index, trigger_obj, weak_objects) {
-        gc_assert(is_lisp_pointer(trigger_obj));
-        if (predicate(trigger_obj)) {
-            struct cons* chain;
+    int worker;
+    for (worker = 0; worker < N_WEAK_WORKERS; ++worker) {
+        struct weak_worklist* fired = &weak_worklists[worker];
+        sword_t i;
+        for (i = 0; i < fired->count; ++i) {
+            lispobj trigger_obj = ((lispobj*)fired->items)[i];
+            // Look the object up again: livening can insert into the table
+            struct cons* chain = (struct cons*)hopscotch_get(&weak_objects, trigger_obj, 0);
+            gc_assert(chain);
             if (debug_weak_ht) {
+                struct cons* c;
                 fprintf(stderr, "weak object %"OBJ_FMTX" livens", trigger_obj);
-                for ( chain = values[index] ; chain ; chain = (struct cons*)chain->cdr )
+                for ( c = chain ; c ; c = (struct cons*)c->cdr )
                     fprintf(stderr, " *%"OBJ_FMTX"=%"OBJ_FMTX,
-                            chain->car, *(lispobj*)chain->car);
+                            c->car, *(lispobj*)c->car);
                 fputc('\n', stderr);
             }
-            chain = values[index];
-            gc_assert(chain);
-            for ( ; chain ; chain = (struct cons*)chain->cdr ) {
-                lispobj *plivened_obj = (lispobj*)chain->car;
+            struct cons* c;
+            for ( c = chain ; c ; c = (struct cons*)c->cdr ) {
+                lispobj *plivened_obj = (lispobj*)c->car;
                 // Don't scavenge the cell in place! We lack the information
                 // required to set the rehash flag on address-sensitive keys.
                 lispobj livened_obj = *plivened_obj;
@@ -1395,19 +1701,19 @@ boolean test_weak_triggers(int (*predicate)(lispobj), void (*mark)(lispobj))
                 else
                     scav1(&livened_obj, livened_obj);
             }
-            gc_private_free(values[index]);
+            gc_private_free(chain);
             hopscotch_delete(&weak_objects, trigger_obj);
-            if (!weak_objects.count) {
-                hopscotch_reset(&weak_objects);
-                if (debug_weak_ht)
-                    fprintf(stderr, "no more weak pairs\n");
-                return 1;
-            }
-            gc_assert(weak_objects.count > 0);
-        } else {
-            if (debug_weak_ht)
-                fprintf(stderr, "weak object %"OBJ_FMTX" still dead\n", trigger_obj);
         }
+        fired->count = 0;
+    }
+    if (!weak_objects.count) {
+        hopscotch_reset(&weak_objects);
+#ifdef LISP_FEATURE_GENCGC
+        reset_trigger_index();
+#endif
+        if (debug_weak_ht)
+            fprintf(stderr, "no more weak pairs\n");
+        return 1;
     }
     if (debug_weak_ht)
         printf("end scan_weak_pairs: count=%d\n", weak_objects.count);
@@ -1415,18 +1721,29 @@ boolean test_weak_triggers(int (*predicate)(lispobj), void (*mark)(lispobj))
 }
 
 int finalizer_thread_runflag = 1;
+/* Set by the collector when it queues the cells of dead objects that have
+ * finalizers. Whichever thread restarts the world then wakes the finalizer
+ * thread, whether or not the thread that collected is able to run POST-GC.
+ * Wakeups are counted so that one which arrives while the finalizer thread
+ * is running finalizers is not lost */
+int finalizers_queued;
 #ifdef LISP_FEATURE_SB_THREAD
+static unsigned int finalizer_wakeups, finalizer_wakeups_seen;
 #ifdef LISP_FEATURE_WIN32
 CRITICAL_SECTION finalizer_mutex;
 CONDITION_VARIABLE finalizer_condvar;
 void finalizer_thread_wait () {
     EnterCriticalSection(&finalizer_mutex);
-    if (finalizer_thread_runflag)
+    if (finalizer_thread_runflag && finalizer_wakeups == finalizer_wakeups_seen)
         SleepConditionVariableCS(&finalizer_condvar, &finalizer_mutex, INFINITE);
+    finalizer_wakeups_seen = finalizer_wakeups;
     LeaveCriticalSection(&finalizer_mutex);
 }
 void finalizer_thread_wake () {
+    EnterCriticalSection(&finalizer_mutex);
+    ++finalizer_wakeups;
     WakeAllConditionVariable(&finalizer_condvar);
+    LeaveCriticalSection(&finalizer_mutex);
 }
 void finalizer_thread_stop () {
     EnterCriticalSection(&finalizer_mutex);
@@ -1439,12 +1756,16 @@ pthread_mutex_t finalizer_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t finalizer_condvar = PTHREAD_COND_INITIALIZER;
 void finalizer_thread_wait () {
     ignore_value(mutex_acquire(&finalizer_mutex));
-    if (finalizer_thread_runflag)
+    if (finalizer_thread_runflag && finalizer_wakeups == finalizer_wakeups_seen)
         pthread_cond_wait(&finalizer_condvar, &finalizer_mutex);
+    finalizer_wakeups_seen = finalizer_wakeups;
     ignore_value(mutex_release(&finalizer_mutex));
 }
 void finalizer_thread_wake() {
+    ignore_value(mutex_acquire(&finalizer_mutex));
+    ++finalizer_wakeups;
     pthread_cond_broadcast(&finalizer_condvar);
+    ignore_value(mutex_release(&finalizer_mutex));
 }
 void finalizer_thread_stop() {
     ignore_value(mutex_acquire(&finalizer_mutex));
@@ -1453,6 +1774,14 @@ void finalizer_thread_stop() {
     ignore_value(mutex_release(&finalizer_mutex));
 }
 #endif
+/* Called after the world is restarted */
+void finalizer_thread_wake_if_queued()
+{
+    if (finalizers_queued) {
+        finalizers_queued = 0;
+        finalizer_thread_wake();
+    }
+}
 #endif
 
 void gc_common_init()
@@ -1466,20 +1795,22 @@ void gc_common_init()
                      32 /* logical bin count */, 0 /* default range */);
 }
 
+/* Numbers and symbols are hashed by their contents in EQ and EQL tables,
+ * and instances by their stable hash, which survives their moving. */
 static inline boolean stable_eql_hash_p(lispobj obj)
 {
-    return lowtag_of(obj) == OTHER_POINTER_LOWTAG
-        && widetag_of((lispobj*)(obj-OTHER_POINTER_LOWTAG)) <= SYMBOL_WIDETAG;
+    return (lowtag_of(obj) == OTHER_POINTER_LOWTAG
+            && widetag_of((lispobj*)(obj-OTHER_POINTER_LOWTAG)) <= SYMBOL_WIDETAG)
+        || lowtag_of(obj) == INSTANCE_POINTER_LOWTAG;
 }
 
 /* EQUAL and EQUALP tables always have hash vectors, so GC always knows
  * for any given key whether it was hashed by address.
- * EQ never has a hash vector (except if there is a user-defined hash function)
- * but always hashes by the pointer bits (which could be an address or immediate).
- * EQL never has a hash vector (same exception), but can hash some objects
- * by their contents, not their address. This macro determines for a key whether
- * its pointer bits force a rehash. In the case where we would call
- * stable_eql_hash_p(), skip the call if 'rehash' is already 1.
+ * EQ and EQL never have a hash vector (except if there is a user-defined
+ * hash function), but hash some objects by their contents, not their address.
+ * This macro determines for a key whether its pointer bits force a rehash.
+ * In the case where we would call stable_eql_hash_p(), skip the call if
+ * 'rehash' is already 1.
  */
 #define SHOULD_REHASH(oldkey, newkey, hashvec, hv_index) \
   ((newkey != oldkey) && \
@@ -1513,6 +1844,32 @@ static inline boolean stable_eql_hash_p(lispobj obj)
     if (rehash) \
       NON_FAULTING_STORE(KV_PAIRS_REHASH(data) |= make_fixnum(1), &data[1])
 
+/* Return the hash vector data of an address-sensitive KV vector, or 0 if it has
+ * none, and store into *eql_hashing whether the table is an EQ or EQL table.
+ * Read the hash vector (or NIL) from the last element. If the last element
+ * satisfies instancep() then this vector belongs to a weak table,
+ * and the KV vector has had its weakness removed temporarily to simplify
+ * rehashing, which occurs only when rehashing without growing.
+ * When growing a weak table, the KV vector is not created as weak initially;
+ * its last element points to the hash-vector as for any strong KV vector. */
+static uint32_t* kv_vector_hashvals(struct vector *kv_vector, boolean *eql_hashing)
+{
+    sword_t kv_length = vector_len(kv_vector);
+    lispobj kv_supplement = kv_vector->data[kv_length-1];
+    *eql_hashing = 0;
+    if (instancep(kv_supplement)) {
+        struct hash_table* ht = (struct hash_table*)native_pointer(kv_supplement);
+        *eql_hashing = hashtable_kind(ht) <= 1;
+        kv_supplement = ht->hash_vector;
+    } else if (kv_supplement == T) { // EQ or EQL hashing on a non-weak table
+        *eql_hashing = 1;
+        kv_supplement = NIL;
+    }
+    if (kv_supplement == NIL) return 0;
+    gc_assert(2 * vector_len(VECTOR(kv_supplement)) + 1 == kv_length);
+    return get_array_data(kv_supplement, SIMPLE_ARRAY_UNSIGNED_BYTE_32_WIDETAG);
+}
+
 static void scan_nonweak_kv_vector(struct vector *kv_vector, void (*scav_entry)(lispobj*))
 {
     lispobj* data = kv_vector->data;
@@ -1521,30 +1878,60 @@ static void scan_nonweak_kv_vector(struct vector *kv_vector, void (*scav_entry)(
         // All keys were hashed address-insensitively
         return (void)scavenge(data + 2, KV_PAIRS_HIGH_WATER_MARK(data) * 2);
     }
-    // Read the hash vector (or NIL) from the last element. If the last element
-    // satisfies instancep() then this vector belongs to a weak table,
-    // and the KV vector has had its weakness removed temporarily to simplify
-    // rehashing, which occurs only when rehashing without growing.
-    // When growing a weak table, the KV vector is not created as weak initially;
-    // its last element points to the hash-vector as for any strong KV vector.
-    sword_t kv_length = vector_len(kv_vector);
-    lispobj kv_supplement = data[kv_length-1];
-    boolean eql_hashing = 0; // whether this table is an EQL table
-    if (instancep(kv_supplement)) {
-        struct hash_table* ht = (struct hash_table*)native_pointer(kv_supplement);
-        eql_hashing = hashtable_kind(ht) == 1;
-        kv_supplement = ht->hash_vector;
-    } else if (kv_supplement == T) { // EQL hashing on a non-weak table
-        eql_hashing = 1;
-        kv_supplement = NIL;
+    boolean eql_hashing; // whether this table is an EQ or EQL table
+    uint32_t *hashvals = kv_vector_hashvals(kv_vector, &eql_hashing);
+    SCAV_ENTRIES(1, );
+}
+
+#ifdef LISP_FEATURE_GENCGC
+/* Return 1 if the non-weak address-sensitive KV vector can be scanned one card
+ * at a time as a root. The objects which determine how its keys were hashed
+ * must not move while the cards are scavenged, else we could read a stale
+ * hash vector through a forwarded pointer */
+boolean kv_vector_cardwise_scannable_p(struct vector *kv_vector)
+{
+    lispobj supplement = kv_vector->data[vector_len(kv_vector)-1];
+    if (is_lisp_pointer(supplement) && from_space_p(supplement)) return 0;
+    if (instancep(supplement)) {
+        lispobj hv = ((struct hash_table*)native_pointer(supplement))->hash_vector;
+        if (is_lisp_pointer(hv) && from_space_p(hv)) return 0;
     }
-    uint32_t *hashvals = 0;
-    if (kv_supplement != NIL) {
-        hashvals = get_array_data(kv_supplement, SIMPLE_ARRAY_UNSIGNED_BYTE_32_WIDETAG);
-        gc_assert(2 * vector_len(VECTOR(kv_supplement)) + 1 == kv_length);
+    return 1;
+}
+
+/* Scavenge the words in [start,end) of a root KV vector that satisfied
+ * kv_vector_cardwise_scannable_p(), setting the vector's rehash flag if any
+ * key that was hashed by address moved. 'start' and 'end' are card bounds,
+ * which can not split a pair because pairs are 2-word aligned.
+ * Return the value as with descriptors_scavenge() */
+int kv_vector_descriptors_scavenge(struct vector *kv_vector,
+                                   lispobj *start, lispobj *end,
+                                   generation_index_t gen, int dirty)
+{
+    lispobj* data = kv_vector->data;
+    lispobj* pairs_start = data + 2;
+    lispobj* pairs_end = pairs_start + 2 * KV_PAIRS_HIGH_WATER_MARK(data);
+    lispobj* lo = start > pairs_start ? start : pairs_start;
+    lispobj* hi = end < pairs_end ? end : pairs_end;
+    if (lo >= hi) return descriptors_scavenge(start, end, gen, dirty);
+
+    boolean eql_hashing;
+    uint32_t *hashvals = kv_vector_hashvals(kv_vector, &eql_hashing);
+    boolean rehash = 0;
+    dirty = descriptors_scavenge(start, lo, gen, dirty);
+    lispobj* pair;
+    for (pair = lo; pair < hi; pair += 2) {
+        lispobj key = pair[0];
+        if (!at_least_one_pointer_p(key, pair[1])) continue;
+        dirty = descriptors_scavenge(pair, pair + 2, gen, dirty);
+        if (SHOULD_REHASH(key, pair[0], hashvals, (pair - data) >> 1)) rehash = 1;
     }
-    SCAV_ENTRIES(1, );
+    dirty = descriptors_scavenge(hi, end, gen, dirty);
+    if (rehash)
+        NON_FAULTING_STORE(KV_PAIRS_REHASH(data) |= make_fixnum(1), &data[1]);
+    return dirty;
 }
+#endif
 
 boolean scan_weak_hashtable(struct hash_table *hash_table,
                             int (*predicate)(lispobj,lispobj),
@@ -1570,7 +1957,7 @@ boolean scan_weak_hashtable(struct hash_table *hash_table,
     gc_assert(2 * vector_len(VECTOR(hash_table->next_vector)) + 1 == kv_length);
 
     int weakness = hashtable_weakness(hash_table);
-    boolean eql_hashing = hashtable_kind(hash_table) == 1;
+    boolean eql_hashing = hashtable_kind(hash_table) <= 1;
     /* Work through the KV vector. */
     SCAV_ENTRIES(predicate(key, value), add_kv_triggers(&data[2*i], weakness));
     if (!any_deferred && debug_weak_ht)
@@ -1678,9 +2065,7 @@ scav_vector_t(lispobj *where, lispobj header)
     return (ALIGN_UP(length + 2, 2));
 }
 
-/* Walk through the chain whose first element is *FIRST and remove
- * dead weak entries.
- * Return the new value for 'should rehash'.
+/* Remove the dead entry at 'index' of 'bucket' from a weak hash table.
  *
  * This operation might have to touch a hash-table that is currently
  * on a write-protected page, as follows:
@@ -1698,128 +2083,136 @@ scav_vector_t(lispobj *where, lispobj header)
  * except that it's potentially a lot more unprotects and reprotects.
  * Better to just get it done once.
  */
-static inline boolean
-cull_weak_hash_table_bucket(struct hash_table *hash_table,
-                            uint32_t bucket, uint32_t index,
-                            lispobj *kv_vector,
-                            uint32_t *next_vector, uint32_t *hash_vector,
-                            int (*alivep_test)(lispobj,lispobj),
-                            void (*fix_pointers)(lispobj[2]),
-                            boolean save_culled_values,
-                            boolean rehash)
+static void
+cull_weak_hash_table_entry(struct hash_table *hash_table,
+                           uint32_t bucket, uint32_t index)
 {
     const lispobj empty_symbol = UNBOUND_MARKER_WIDETAG;
-    int eql_hashing = hashtable_kind(hash_table) == 1;
-    for ( ; index ; index = next_vector[index] ) {
-        lispobj key = kv_vector[2 * index];
-        lispobj value = kv_vector[2 * index + 1];
-        // Lisp might not have gotten around to pruning a chain
-        // containing previously culled items.
-        if (key == empty_symbol && value == empty_symbol) continue;
-        // If the pair doesn't have both halves empty,
-        // then it mustn't have either half empty.
-        // FIXME: this looks like a potential data race - do we definitely store
-        // the key and value before inserting into a chain? Probably.
-        gc_assert(key != empty_symbol);
-        gc_assert(value != empty_symbol);
-        if (!alivep_test(key, value)) {
-            gc_assert(hash_table->_count > 0);
-            if (save_culled_values) {
-                lispobj val = kv_vector[2 * index + 1];
-                gc_assert(!is_lisp_pointer(val));
-                struct cons *cons = (struct cons*)
-                  gc_general_alloc(cons_region, sizeof(struct cons), PAGE_TYPE_CONS);
-                // Lisp code which manipulates the culled_values slot must use
-                // compare-and-swap, but C code need not, because GC runs in one
-                // thread and has stopped the Lisp world.
-                cons->cdr = hash_table->culled_values;
-                cons->car = val;
-                lispobj list = make_lispobj(cons, LIST_POINTER_LOWTAG);
-                notice_pointer_store(&hash_table->culled_values);
-                hash_table->culled_values = list;
-                // ensure this cons doesn't get smashed into (0 . 0) by full gc
-                if (!compacting_p()) gc_mark_obj(list);
-            }
-            kv_vector[2 * index] = empty_symbol;
-            kv_vector[2 * index + 1] = empty_symbol;
-            ensure_non_ptr_word_writable(&hash_table->_count);
-            hash_table->_count -= make_fixnum(1);
-
-            // Push (index . bucket) onto the table's GC culled cell list.
-            // If each of 'index' and 'bucket' can be represented in 14 bits,
-            // then pack them in a fixnum. Otherwise a cons. This makes the code
-            // essentially identical regardless of word size while in most cases
-            // consuming only 1 cons per culled item.
-            struct cons *cons;
-            if ((index & ~0x3FFF) | (bucket & ~0x3FFF)) { // large values
-                cons = (struct cons*)
-                  gc_general_alloc(cons_region, 2 * sizeof(struct cons), PAGE_TYPE_CONS);
-                cons->car = make_lispobj(cons + 1, LIST_POINTER_LOWTAG);
-                cons[1].car = make_fixnum(index);  // which cell became free
-                cons[1].cdr = make_fixnum(bucket); // which chain was it in
-                if (!compacting_p()) gc_mark_obj(cons->car);
-            } else { // small values
-                cons = (struct cons*)
-                  gc_general_alloc(cons_region, sizeof(struct cons), PAGE_TYPE_CONS);
-                cons->car = ((index << 14) | bucket) << N_FIXNUM_TAG_BITS;
-            }
-            cons->cdr = hash_table->smashed_cells;
-            // Lisp code must atomically pop the list whereas this C code
-            // always wins and does not need compare-and-swap.
-            notice_pointer_store(&hash_table->smashed_cells);
-            hash_table->smashed_cells = make_lispobj(cons, LIST_POINTER_LOWTAG);
-            // ensure this cons doesn't get smashed into (0 . 0) by full gc
-            if (!compacting_p()) gc_mark_obj(hash_table->smashed_cells);
+    lispobj *kv_vector = get_array_data(hash_table->pairs, SIMPLE_VECTOR_WIDETAG);
+    boolean save_culled_values = (hash_table->flags & make_fixnum(4)) != 0;
 
-        } else {
-            if (fix_pointers) { // Follow FPs as necessary
-                lispobj key = kv_vector[2 * index];
-                fix_pointers(&kv_vector[2 * index]);
+    gc_assert(hash_table->_count > 0);
+    if (save_culled_values) {
+        lispobj val = kv_vector[2 * index + 1];
+        gc_assert(!is_lisp_pointer(val));
+        struct cons *cons = (struct cons*)
+          gc_general_alloc(cons_region, sizeof(struct cons), PAGE_TYPE_CONS);
+        // Lisp code which manipulates the culled_values slot must use
+        // compare-and-swap, but C code need not, because GC runs in one
+        // thread and has stopped the Lisp world.
+        cons->cdr = hash_table->culled_values;
+        cons->car = val;
+        lispobj list = make_lispobj(cons, LIST_POINTER_LOWTAG);
+        notice_pointer_store(&hash_table->culled_values);
+        hash_table->culled_values = list;
+        // ensure this cons doesn't get smashed into (0 . 0) by full gc
+        if (!compacting_p()) gc_mark_obj(list);
+        finalizers_queued = 1;
+    }
+    kv_vector[2 * index] = empty_symbol;
+    kv_vector[2 * index + 1] = empty_symbol;
+    ensure_non_ptr_word_writable(&hash_table->_count);
+    hash_table->_count -= make_fixnum(1);
+
+    // Push (index . bucket) onto the table's GC culled cell list.
+    // If each of 'index' and 'bucket' can be represented in 14 bits,
+    // then pack them in a fixnum. Otherwise a cons. This makes the code
+    // essentially identical regardless of word size while in most cases
+    // consuming only 1 cons per culled item.
+    struct cons *cons;
+    if ((index & ~0x3FFF) | (bucket & ~0x3FFF)) { // large values
+        cons = (struct cons*)
+          gc_general_alloc(cons_region, 2 * sizeof(struct cons), PAGE_TYPE_CONS);
+        cons->car = make_lispobj(cons + 1, LIST_POINTER_LOWTAG);
+        cons[1].car = make_fixnum(index);  // which cell became free
+        cons[1].cdr = make_fixnum(bucket); // which chain was it in
+        if (!compacting_p()) gc_mark_obj(cons->car);
+    } else { // small values
+        cons = (struct cons*)
+          gc_general_alloc(cons_region, sizeof(struct cons), PAGE_TYPE_CONS);
+        cons->car = ((index << 14) | bucket) << N_FIXNUM_TAG_BITS;
+    }
+    cons->cdr = hash_table->smashed_cells;
+    // Lisp code must atomically pop the list whereas this C code
+    // always wins and does not need compare-and-swap.
+    notice_pointer_store(&hash_table->smashed_cells);
+    hash_table->smashed_cells = make_lispobj(cons, LIST_POINTER_LOWTAG);
+    // ensure this cons doesn't get smashed into (0 . 0) by full gc
+    if (!compacting_p()) gc_mark_obj(hash_table->smashed_cells);
+}
+
+/* Weak tables are culled a range of buckets at a time. The liveness test of
+ * each entry in a range, and following forwarding pointers in the live ones,
+ * writes only to the pairs in that range's chains, so ranges can be processed
+ * by any number of threads. Removing the dead entries allocates, so those are
+ * saved in the worker's list and removed by the collecting thread afterwards.
+ * Usually few entries die, so nearly all of the work is in the first part. */
+struct cull_chunk {
+    struct hash_table* table;
+    uint32_t start, end; // range of buckets
+    boolean rehash;
+};
+struct dead_entry {
+    struct hash_table* table;
+    uint32_t bucket, index;
+};
+struct cull_state {
+    sword_t n_chunks, cursor;
+    int (**alivep)(lispobj,lispobj);
+    void (*fix_pointers)(lispobj[2]);
+};
+#define CULL_CHUNK_BUCKETS 4096
+static struct cull_chunk* cull_chunks;
+static sword_t cull_chunks_capacity;
+
+static void find_dead_weak_entries(int worker, void* arg)
+{
+    const lispobj empty_symbol = UNBOUND_MARKER_WIDETAG;
+    struct cull_state* state = arg;
+    struct weak_worklist* dead = &weak_worklists[worker];
+    sword_t i;
+    while ((i = __sync_fetch_and_add(&state->cursor, 1)) < state->n_chunks) {
+        struct cull_chunk* chunk = &cull_chunks[i];
+        struct hash_table* hash_table = chunk->table;
+        int (*alivep_test)(lispobj,lispobj) = state->alivep[hashtable_weakness(hash_table)];
+        lispobj *kv_vector = get_array_data(hash_table->pairs, SIMPLE_VECTOR_WIDETAG);
+        uint32_t *index_vector = get_array_data(hash_table->index_vector,
+                                                SIMPLE_ARRAY_UNSIGNED_BYTE_32_WIDETAG);
+        uint32_t *next_vector = get_array_data(hash_table->next_vector,
+                                               SIMPLE_ARRAY_UNSIGNED_BYTE_32_WIDETAG);
+        uint32_t *hash_vector = 0;
+        if (hash_table->hash_vector != NIL)
+            hash_vector = get_array_data(hash_table->hash_vector,
+                                         SIMPLE_ARRAY_UNSIGNED_BYTE_32_WIDETAG);
+        int eql_hashing = hashtable_kind(hash_table) <= 1;
+        boolean rehash = 0;
+        uint32_t bucket, index;
+        for (bucket = chunk->start; bucket < chunk->end; ++bucket)
+        for (index = index_vector[bucket] ; index ; index = next_vector[index] ) {
+            lispobj key = kv_vector[2 * index];
+            lispobj value = kv_vector[2 * index + 1];
+            // Lisp might not have gotten around to pruning a chain
+            // containing previously culled items.
+            if (key == empty_symbol && value == empty_symbol) continue;
+            // If the pair doesn't have both halves empty,
+            // then it mustn't have either half empty.
+            // FIXME: this looks like a potential data race - do we definitely store
+            // the key and value before inserting into a chain? Probably.
+            gc_assert(key != empty_symbol);
+            gc_assert(value != empty_symbol);
+            if (!alivep_test(key, value)) {
+                struct dead_entry* entry = weak_worklist_push(dead, sizeof (struct dead_entry));
+                entry->table = hash_table;
+                entry->bucket = bucket;
+                entry->index = index;
+            } else if (state->fix_pointers) { // Follow FPs as necessary
+                state->fix_pointers(&kv_vector[2 * index]);
                 if (SHOULD_REHASH(key, kv_vector[2 * index], hash_vector, index))
                     rehash = 1;
             }
         }
+        chunk->rehash = rehash;
     }
-    return rehash;
-}
-
-static void
-cull_weak_hash_table (struct hash_table *hash_table,
-                      int (*alivep_test)(lispobj,lispobj),
-                      void (*fix_pointers)(lispobj[2]))
-{
-    sword_t i;
-
-    lispobj *kv_vector = get_array_data(hash_table->pairs, SIMPLE_VECTOR_WIDETAG);
-    uint32_t *index_vector = get_array_data(hash_table->index_vector,
-                                            SIMPLE_ARRAY_UNSIGNED_BYTE_32_WIDETAG);
-    sword_t n_buckets = vector_len(VECTOR(hash_table->index_vector));
-    uint32_t *next_vector = get_array_data(hash_table->next_vector,
-                                           SIMPLE_ARRAY_UNSIGNED_BYTE_32_WIDETAG);
-    uint32_t *hash_vector = 0;
-    if (hash_table->hash_vector != NIL)
-        hash_vector = get_array_data(hash_table->hash_vector,
-                                     SIMPLE_ARRAY_UNSIGNED_BYTE_32_WIDETAG);
-
-    boolean rehash = 0;
-    boolean save_culled_values = (hash_table->flags & make_fixnum(4)) != 0;
-    // I'm slightly confused as to why we can't (or don't) compute the
-    // 'should rehash' flag while scavenging the weak k/v vector.
-    // I believe the explanation is this: for weak-key-AND-value tables, the vector
-    // is never scavenged. It just ends up here after all other scavenging is done.
-    // We then need to fix the still-live pointers, which entails possibly setting the
-    // 'rehash' flag. It would not make sense to treat the other 3 flavors of
-    // weakness any differently.
-    for (i = 0; i < n_buckets; i++) {
-        if (cull_weak_hash_table_bucket(hash_table, i, index_vector[i],
-                                        kv_vector, next_vector, hash_vector,
-                                        alivep_test, fix_pointers,
-                                        save_culled_values, rehash))
-            rehash = 1;
-    }
-    /* If an EQ-based key has moved, mark the hash-table for rehash */
-    if (rehash)
-        NON_FAULTING_STORE(KV_PAIRS_REHASH(kv_vector) |= make_fixnum(1), &kv_vector[1]);
 }
 
 /* Fix one <k,v> pair in a weak hashtable.
@@ -1851,16 +2244,54 @@ static void pair_follow_fps(lispobj ht_entry[2])
 void cull_weak_hash_tables(int (*alivep[4])(lispobj,lispobj))
 {
     struct hash_table *table, *next;
+    sword_t n_chunks = 0, i;
 
     for (table = weak_hash_tables; table != NULL; table = next) {
         next = (struct hash_table *)table->next_weak_hash_table;
         NON_FAULTING_STORE(table->next_weak_hash_table = NIL,
                            &table->next_weak_hash_table);
-        int weakness = hashtable_weakness(table);
-        gc_assert((weakness & ~3) == 0);
-        cull_weak_hash_table(table, alivep[weakness], compacting_p() ? pair_follow_fps : 0);
+        gc_assert((hashtable_weakness(table) & ~3) == 0);
+        uint32_t n_buckets = vector_len(VECTOR(table->index_vector)), start;
+        for (start = 0; start < n_buckets; start += CULL_CHUNK_BUCKETS) {
+            cull_chunks = grow_gc_array(cull_chunks, &cull_chunks_capacity, n_chunks,
+                                        n_chunks + 1, sizeof (struct cull_chunk));
+            struct cull_chunk* chunk = &cull_chunks[n_chunks++];
+            chunk->table = table;
+            chunk->start = start;
+            chunk->end = (n_buckets - start > CULL_CHUNK_BUCKETS) ?
+              start + CULL_CHUNK_BUCKETS : n_buckets;
+            chunk->rehash = 0;
+        }
     }
     weak_hash_tables = NULL;
+
+    // I'm slightly confused as to why we can't (or don't) compute the
+    // 'should rehash' flag while scavenging the weak k/v vector.
+    // I believe the explanation is this: for weak-key-AND-value tables, the vector
+    // is never scavenged. It just ends up here after all other scavenging is done.
+    // We then need to fix the still-live pointers, which entails possibly setting the
+    // 'rehash' flag. It would not make sense to treat the other 3 flavors of
+    // weakness any differently.
+    struct cull_state state = { n_chunks, 0, alivep,
+                                compacting_p() ? pair_follow_fps : 0 };
+    run_weak_task(find_dead_weak_entries, &state, n_chunks);
+
+    int worker;
+    for (worker = 0; worker < N_WEAK_WORKERS; ++worker) {
+        struct weak_worklist* dead = &weak_worklists[worker];
+        struct dead_entry* entries = dead->items;
+        for (i = 0; i < dead->count; ++i)
+            cull_weak_hash_table_entry(entries[i].table, entries[i].bucket,
+                                       entries[i].index);
+        dead->count = 0;
+    }
+    /* If an EQ-based key has moved, mark the hash-table for rehash */
+    for (i = 0; i < n_chunks; ++i)
+        if (cull_chunks[i].rehash) {
+            lispobj *kv_vector = get_array_data(cull_chunks[i].table->pairs,
+                                                SIMPLE_VECTOR_WIDETAG);
+            NON_FAULTING_STORE(KV_PAIRS_REHASH(kv_vector) |= make_fixnum(1), &kv_vector[1]);
+        }
     /* Reset weak_objects only if the count is nonzero.
      * If test_weak_triggers() caused the count to hit zero, then it already
      * performed a reset. Consecutive resets with no intervening insert are
@@ -1868,6 +2299,9 @@ void cull_weak_hash_tables(int (*alivep[4])(lispobj,lispobj))
      * which is what an extra reset would do if it saw no inserts. */
     if (weak_objects.count)
         hopscotch_reset(&weak_objects);
+#ifdef LISP_FEATURE_GENCGC
+    reset_trigger_index();
+#endif
 #ifdef LISP_FEATURE_GENCGC
     // Close the region used when pushing items to the finalizer queue
     ensure_region_closed(cons_region, PAGE_TYPE_CONS);
@@ -2274,10 +2708,30 @@ maybe_gc(os_context_t *context)
  * BYTES_ZERO_BEFORE_END bytes are zero the rest are also zero. This
  * may be what the "lame" adjective in the above comment is for. In
  * this case, exact gc may lose badly. */
+#if defined LISP_FEATURE_LINUX && defined LISP_FEATURE_C_STACK_IS_CONTROL_STACK
+/* Pages of the control stack more than this many bytes beyond the current
+ * frame are given back to the OS by scrub_control_stack(), or none if 0 */
+os_vm_size_t thread_stack_release_slack = 256*1024;
+#endif
+
 void
 scrub_control_stack()
 {
-    scrub_thread_control_stack(get_sb_vm_thread());
+    struct thread *th = get_sb_vm_thread();
+    scrub_thread_control_stack(th);
+#if defined LISP_FEATURE_LINUX && defined LISP_FEATURE_C_STACK_IS_CONTROL_STACK
+    /* After deep recursion, the stack keeps memory that it might never use
+     * again. Linux zero-fills released pages when they are next touched,
+     * which leaves them no less scrubbed. The stack grows downward here,
+     * and this frame must be on it, not on a signal stack. */
+    char *frame = __builtin_frame_address(0);
+    if (thread_stack_release_slack
+        && frame > (char*)th->control_stack_start && frame < (char*)th->control_stack_end) {
+        char *start = (char*)CONTROL_STACK_RETURN_GUARD_PAGE(th) + os_vm_page_size;
+        char *end = PTR_ALIGN_DOWN(frame - thread_stack_release_slack, os_vm_page_size);
+        if (end > start) madvise(start, end - start, MADV_DONTNEED);
+    }
+#endif
 }
 
 void
@@ -142,4 +142,6 @@ extern int simple_fun_index(struct code*, struct simple_fun*);
 extern lispobj fdefn_callee_lispobj(struct fdefn *fdefn);
 extern void gc_close_thread_regions(struct thread*);
 extern void gc_close_collector_regions();
+extern void* grow_gc_array(void* array, sword_t* capacity, sword_t used,
+                           sword_t needed, size_t size);
 #endif /* _GC_INTERNAL_H_ */
@@ -21,6 +21,16 @@
 #include "code.h"
 
 #ifdef LISP_FEATURE_GENCGC
+/* If not null, one bit per doubleword of dynamic space, set wherever the
+ * collector places an object. See object_start_from_bits() in gencgc */
+extern uword_t* gc_object_start_bits;
+static inline void gc_note_object_start(void* addr)
+{
+    if (gc_object_start_bits) {
+        uword_t bit = ((uword_t)addr - DYNAMIC_SPACE_START) >> (1+WORD_SHIFT);
+        gc_object_start_bits[bit / N_WORD_BITS] |= (uword_t)1 << (bit % N_WORD_BITS);
+    }
+}
 void *collector_alloc_fallback(struct alloc_region*,sword_t,int);
 static inline void* __attribute__((unused))
 gc_general_alloc(struct alloc_region* region, sword_t nbytes, int page_type)
@@ -30,9 +40,11 @@ gc_general_alloc(struct alloc_region* region, sword_t nbytes, int page_type)
     // Large objects will never fit in a region, so we automatically dtrt
     if (new_free_pointer <= region->end_addr) {
         region->free_pointer = new_free_pointer;
-        return new_obj;
+    } else {
+        new_obj = collector_alloc_fallback(region, nbytes, page_type);
     }
-    return collector_alloc_fallback(region, nbytes, page_type);
+    gc_note_object_start(new_obj);
+    return new_obj;
 }
 lispobj copy_possibly_large_object(lispobj object, sword_t nwords,
                                    struct alloc_region*, int page_type);
@@ -53,15 +65,27 @@ lispobj copy_possibly_large_object(lispobj object, sword_t nwords,
 
 #define GC_LOGGING 0
 
+/* Count 'obj', which survives the current GC, in the census of survivors
+ * if one is being taken. See gc_census_note() */
+#ifdef LISP_FEATURE_GENCGC
+extern int gc_census_enabled;
+void gc_census_note(lispobj obj, sword_t nwords);
+#define NOTE_CENSUS(obj, nwords) \
+    do { if (gc_census_enabled) gc_census_note(obj, nwords); } while (0)
+#else
+#define NOTE_CENSUS(obj, nwords) /* do nothing */
+#endif
+
 /* For debugging purposes, you can make this macro as complicated as you like,
  * such as checking various other aspects of the object in 'old' */
 #if GC_LOGGING
 #define NOTE_TRANSPORTING(old, new, nwords) really_note_transporting(old,new,nwords)
 void really_note_transporting(lispobj old,void*new,sword_t nwords);
 #elif defined COLLECT_GC_STATS && COLLECT_GC_STATS
-#define NOTE_TRANSPORTING(old, new, nwords) gc_copied_nwords += nwords
+#define NOTE_TRANSPORTING(old, new, nwords) \
+    do { gc_copied_nwords += nwords; NOTE_CENSUS(old, nwords); } while (0)
 #else
-#define NOTE_TRANSPORTING(old, new, nwords) /* do nothing */
+#define NOTE_TRANSPORTING(old, new, nwords) NOTE_CENSUS(old, nwords)
 #endif
 
 extern uword_t gc_copied_nwords;
@@ -333,6 +357,9 @@ extern unsigned char* gc_card_mark;
 // functions in "genesis/cardmarks.h" for the use-case.
 #define CARD_MARKED 0
 #define STICKY_MARK 2
+// Marked, but the collector has a list of the card's old->young slots
+// and need not scan the rest of it. Any store by Lisp replaces this mark.
+#define REMEMBERED_MARK 4
 #define CARD_UNMARKED 0xff
 #define MARK_BYTE_MASK 0xff
 
@@ -392,8 +419,9 @@ static inline void unprotect_page(void* addr, unsigned char mark)
 static inline void notice_pointer_store(void* addr) {
 #ifdef LISP_FEATURE_SOFT_CARD_MARKS
     int card = addr_to_card_index(addr);
-    // STICKY is stronger than MARKED. Only change if UNMARKED.
-    if (gc_card_mark[card] == CARD_UNMARKED) gc_card_mark[card] = CARD_MARKED;
+    // STICKY is stronger than MARKED. Only change if UNMARKED or REMEMBERED.
+    if (gc_card_mark[card] == CARD_UNMARKED || gc_card_mark[card] == REMEMBERED_MARK)
+        gc_card_mark[card] = CARD_MARKED;
 #else
     page_index_t index = find_page_index(addr);
     gc_assert(index >= 0);
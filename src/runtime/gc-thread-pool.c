@@ -0,0 +1,130 @@
+/*
+ * This software is part of the SBCL system. See the README file for
+ * more information.
+ *
+ * This software is derived from the CMU CL system, which was
+ * written at Carnegie Mellon University and released into the
+ * public domain. The software is in the public domain and is
+ * provided with absolutely no warranty. See the COPYING and CREDITS
+ * files for more information.
+ */
+
+/* A small pool of helper threads that the collector can hand
+ * embarrassingly parallel work to while the world is stopped.
+ *
+ * The helpers are not Lisp threads: they have no 'struct thread', never
+ * touch the Lisp heap except as directed by the task they are given,
+ * and run with every signal blocked. They are created once at startup
+ * because creating threads from inside GC could deadlock on a libc lock
+ * held by a thread that was stopped for the world-stop.
+ *
+ * A task is a function of (worker-index, argument). gc_run_on_thread_pool()
+ * runs it on every worker, with the calling thread acting as worker 0,
+ * and returns after all workers have finished. Tasks divide their work
+ * by claiming chunks from a shared cursor with gc_claim_chunk().
+ * If the pool is disabled (the default, or #-sb-thread), the caller
+ * simply runs the task as the only worker. */
+
+#include <stdio.h>
+#include "sbcl.h"
+#ifdef LISP_FEATURE_GENCGC
+#include "runtime.h"
+#include "gc.h"
+#include "gc-internal.h"
+#include "gencgc-private.h"
+#include "interr.h"
+
+int gc_n_threads; // counting the collecting thread. 0 or 1 means no helpers
+
+#if defined LISP_FEATURE_SB_THREAD && !defined LISP_FEATURE_WIN32
+#include <pthread.h>
+#include <signal.h>
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static void (*pool_task)(int, void*);
+static void* pool_task_arg;
+static unsigned int pool_epoch; // incremented once per task
+static int pool_n_busy;
+
+static void* gc_worker_main(void* arg)
+{
+    int index = (int)(uword_t)arg;
+    unsigned int seen_epoch = 0;
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (pool_epoch == seen_epoch) pthread_cond_wait(&pool_wakeup, &pool_lock);
+        seen_epoch = pool_epoch;
+        void (*task)(int, void*) = pool_task;
+        void* task_arg = pool_task_arg;
+        pthread_mutex_unlock(&pool_lock);
+        task(index, task_arg);
+        pthread_mutex_lock(&pool_lock);
+        if (--pool_n_busy == 0) pthread_cond_signal(&pool_done);
+    }
+    return 0;
+}
+
+void gc_start_worker_threads()
+{
+    if (gc_n_threads > GC_MAX_THREADS) gc_n_threads = GC_MAX_THREADS;
+    if (gc_n_threads <= 1) { gc_n_threads = 0; return; }
+    sigset_t all, old;
+    sigfillset(&all);
+    thread_sigmask(SIG_BLOCK, &all, &old);
+    int i;
+    for (i = 1; i < gc_n_threads; ++i) {
+        pthread_t tid;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        // The tasks are leaf loops with no deep recursion
+        pthread_attr_setstacksize(&attr, 256*1024);
+        int err = pthread_create(&tid, &attr, gc_worker_main, (void*)(uword_t)i);
+        pthread_attr_destroy(&attr);
+        if (err) {
+            // Not fatal: run with however many helpers we got
+            fprintf(stderr, "WARNING: could only create %d GC threads\n", i);
+            break;
+        }
+        pthread_detach(tid);
+    }
+    thread_sigmask(SIG_SETMASK, &old, 0);
+    gc_n_threads = (i > 1) ? i : 0;
+}
+
+void gc_run_on_thread_pool(void (*task)(int, void*), void* arg)
+{
+    if (gc_n_threads <= 1) { task(0, arg); return; }
+    pthread_mutex_lock(&pool_lock);
+    pool_task = task;
+    pool_task_arg = arg;
+    pool_n_busy = gc_n_threads - 1;
+    ++pool_epoch;
+    pthread_cond_broadcast(&pool_wakeup);
+    pthread_mutex_unlock(&pool_lock);
+    task(0, arg);
+    pthread_mutex_lock(&pool_lock);
+    while (pool_n_busy) pthread_cond_wait(&pool_done, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+#else
+
+void gc_start_worker_threads() { gc_n_threads = 0; }
+void gc_run_on_thread_pool(void (*task)(int, void*), void* arg) { task(0, arg); }
+
+#endif
+
+/* Atomically claim the next 'chunk' items below 'limit' from '*cursor'.
+ * Return the first claimed item, storing one past the last into '*end',
+ * or return -1 if everything is taken */
+page_index_t gc_claim_chunk(page_index_t* cursor, page_index_t chunk,
+                            page_index_t limit, page_index_t* end)
+{
+    page_index_t start = __sync_fetch_and_add(cursor, chunk);
+    if (start >= limit) return -1;
+    *end = (start + chunk > limit) ? limit : start + chunk;
+    return start;
+}
+#endif
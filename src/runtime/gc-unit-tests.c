@@ -40,7 +40,7 @@ void test_find_freeish()
             if (page_table[j].type & OPEN_REGION_PAGE_FLAG) ++count_open_region_pages;
         gc_assert(count_open_region_pages == 1);
         ensure_region_closed(&r, PAGE_TYPE_BOXED);
-        gc_assert(bytes_allocated == tot_bytes);
+        gc_assert(dynamic_usage() == (os_vm_size_t)tot_bytes);
     }
     free(page_table);
     page_table = 0;
@@ -38,6 +38,42 @@ extern boolean gc_active_p;
 extern int sb_sprof_enabled;
 
 extern os_vm_size_t bytes_consed_between_gcs;
+extern int gc_n_threads;
+/* If nonzero, dynamic space is aligned to and advised for transparent huge pages */
+extern int gencgc_huge_pages;
+#define HUGE_PAGE_BYTES (2*1024*1024)
+
+/* Histograms of stop-the-world times, always collected. Bucket 0 counts
+ * samples under 1 microsecond, bucket i>0 those from 2^(i-1) to 2^i.
+ * SAFEPOINT has one sample per thread stopped, being the time from the
+ * start of the stop until that thread was seen to be stopped. PAUSE is the
+ * whole time the world was stopped. STOP has one sample per stop, the time
+ * until all other threads were stopped, whether by signals or safepoints.
+ * The other phases have one sample per collection, summed over the
+ * generations collected. SAFEPOINT is only sampled when stopping by signal.
+ * Only the thread stopping the world writes these. Lisp reads them with
+ * SB-EXT:GC-PAUSE-HISTOGRAM, which knows this layout */
+enum gc_pause_phase { GC_PHASE_SAFEPOINT, GC_PHASE_ROOTS, GC_PHASE_SCAVENGE,
+                      GC_PHASE_WEAK, GC_PHASE_FREE, GC_PHASE_PAUSE,
+                      GC_PHASE_STOP, GC_N_PHASES };
+#define GC_HISTOGRAM_BUCKETS 32
+extern uword_t gc_pause_histogram[GC_N_PHASES][GC_HISTOGRAM_BUCKETS];
+extern void gc_record_pause(enum gc_pause_phase, long nsec);
+/* For each stop of the world, the thread that held it up longest, keeping
+ * the N_STOP_OFFENDERS worst in order of decreasing 'nsec', which is the
+ * time from the start of the stop until that thread was seen stopped.
+ * 'pc' is where the thread took the signal that stopped it, or 0 if unknown.
+ * Lisp reads these with SB-EXT:GC-STOP-OFFENDERS */
+struct stop_offender { uword_t nsec, pc, os_kernel_tid; };
+#define N_STOP_OFFENDERS 16
+extern struct stop_offender gc_stop_offenders[N_STOP_OFFENDERS];
+extern void gc_note_stop_offender(uword_t nsec, uword_t pc, uword_t os_kernel_tid);
+/* A monotonic clock in nanoseconds for timing GC, or 0 if there is none */
+extern uint64_t gc_monotonic_nsec(void);
+#ifdef LISP_FEATURE_SB_THREAD
+/* Wake the finalizer thread if the last GC found objects to finalize */
+extern void finalizer_thread_wake_if_queued(void);
+#endif
 
 #define VERIFY_VERBOSE    1
 #define VERIFY_PRE_GC     2
@@ -65,6 +101,9 @@ extern os_vm_size_t bytes_consed_between_gcs;
  * but rather a range of pointers such as a binding stack, TLS,
  * lisp signal handler array, or other similar array */
 #define VERIFYING_UNFORMATTED 512
+/* CONCURRENTLY implies that Lisp threads are running, so young pages
+ * can change and the thread list can not be examined */
+#define VERIFYING_CONCURRENTLY 1024
 
 #ifdef LISP_FEATURE_GENCGC
 #define MAX_ERR_OBJS 5
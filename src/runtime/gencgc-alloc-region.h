@@ -21,6 +21,22 @@ struct alloc_region {
     void  *start_addr;
 };
 
+/* A few free pages that one thread has claimed for its own TLAB regions,
+ * so that it can open a region on one of them, and retire the previous
+ * region, without taking 'free_pages_lock'. See refill_page_cache() */
+#if defined LISP_FEATURE_SB_THREAD && !defined LISP_FEATURE_DARWIN_JIT
+#define THREAD_PAGE_CACHE_SIZE 8
+struct thread_page_cache {
+    int n_free, n_retired;
+    int region_from_cache; // whether the open TLAB region is on a claimed page
+    int depth_shift; // log2 of how many pages the next refill may claim
+    page_index_t free_pages[THREAD_PAGE_CACHE_SIZE];
+    char need_zero[THREAD_PAGE_CACHE_SIZE];
+    // Filled regions on claimed pages, not yet closed
+    struct alloc_region retired[THREAD_PAGE_CACHE_SIZE];
+};
+#endif
+
 // One region for each of page type.
 // These indices have no correlation to PAGE_TYPE constants.
 // MIXED has to always be at array index 0 because lisp accesses
@@ -33,6 +49,17 @@ extern struct alloc_region  gc_alloc_region[6];
 #define boxed_region   (&gc_alloc_region[4])
 #define cons_region    (&gc_alloc_region[5])
 
+/* The collector moves instances of up to SIZE_CLASS_MAX_NWORDS words into
+ * SMALL_MIXED pages that each hold only one size, with one region per size.
+ * Because objects on those pages never span cards, the start of the object
+ * containing an address can be computed instead of searched for.
+ * See copy_instance() and size_class_object_start() */
+#define SIZE_CLASS_MAX_NWORDS 10
+#define N_SIZE_CLASSES (SIZE_CLASS_MAX_NWORDS/2)
+extern struct alloc_region size_class_region[N_SIZE_CLASSES];
+#define size_class_region_for(nwords) (&size_class_region[((nwords)>>1)-1])
+extern int gencgc_size_class_pages;
+
 extern generation_index_t from_space, new_space;
 extern int gencgc_alloc_profiler;
 
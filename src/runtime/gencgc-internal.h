@@ -236,6 +236,7 @@ extern page_index_t page_table_pages;
 /* forward declarations */
 
 void gc_close_region(struct alloc_region *alloc_region, int page_type);
+os_vm_size_t dynamic_usage(void);
 static inline void ensure_region_closed(struct alloc_region *alloc_region,
                                         int page_type)
 {
@@ -283,22 +284,31 @@ find_page_index(void *addr)
 
 #define page_single_obj_p(page) ((page_table[page].type & SINGLE_OBJECT_FLAG)!=0)
 
+/* Return true if 'obj' was pinned by setting its bit in gc_pin_bits.
+ * That is done for every pinned object on a multi-object page except code */
+static inline boolean pin_bit_p(lispobj obj)
+{
+    extern uword_t* gc_pin_bits;
+    uword_t bit = (obj - DYNAMIC_SPACE_START) >> (1+WORD_SHIFT);
+    return (gc_pin_bits[bit / N_WORD_BITS] >> (bit % N_WORD_BITS)) & 1;
+}
+
 static inline boolean pinned_p(lispobj obj, page_index_t page)
 {
-    extern struct hopscotch_table pinned_objects;
-    // Single-object pages can be pinned, but the object doesn't go
-    // in the hashtable. I'm a little surprised that the return value
+    // Single-object pages can be pinned, but the object doesn't get
+    // a pin bit. I'm a little surprised that the return value
     // should be 0 in such case, but I think this never gets called
     // on large objects because they've all been "moved" to newspace
     // by adjusting the page table. Perhaps this should do:
     //   gc_assert(!page_single_obj_p(page))
     if (!page_table[page].pinned || page_single_obj_p(page)) return 0;
+    if (pin_bit_p(obj)) return 1;
 #ifdef RETURN_PC_WIDETAG
-    if (widetag_of(native_pointer(obj)) == RETURN_PC_WIDETAG)
-        obj = make_lispobj(fun_code_header(native_pointer(obj)),
-                           OTHER_POINTER_LOWTAG);
+    if ((page_table[page].type & PAGE_TYPE_MASK) == PAGE_TYPE_CODE
+        && widetag_of(native_pointer(obj)) == RETURN_PC_WIDETAG)
+        return pin_bit_p((lispobj)fun_code_header(native_pointer(obj)));
 #endif
-    return hopscotch_containsp(&pinned_objects, obj);
+    return 0;
 }
 
 // Return true only if 'obj' must be *physically* transported to survive gc.
@@ -328,7 +338,7 @@ struct fixedobj_page { // 12 bytes per page
       struct {
         unsigned char flags;
         unsigned char obj_align; // object spacing expressed in lisp words
-        unsigned char unused1;
+        unsigned char owned; // set while a thread allocates on the page
         /* Which generations have data on this page */
         unsigned char gens_; // a bitmap
       } parts;
@@ -347,6 +357,9 @@ extern page_index_t next_free_page;
 extern uword_t
 walk_generation(uword_t (*proc)(lispobj*,lispobj*,uword_t),
                 generation_index_t generation, uword_t extra);
+extern void
+walk_generation_parallel(uword_t (*proc)(lispobj*,lispobj*,uword_t),
+                         generation_index_t generation, uword_t* extra);
 
 generation_index_t gc_gen_of(lispobj obj, int defaultval);
 
@@ -14,6 +14,21 @@
 
 void zero_dirty_pages(page_index_t start, page_index_t end, int page_type);
 
+/* GC helper threads (gc-thread-pool.c) */
+#define GC_MAX_THREADS 64
+void gc_start_worker_threads(void);
+void gc_run_on_thread_pool(void (*task)(int, void*), void* arg);
+page_index_t gc_claim_chunk(page_index_t* cursor, page_index_t chunk,
+                            page_index_t limit, page_index_t* end);
+
+void note_forwarded_pages(page_index_t page, page_index_t npages);
+
+/* Arenas (gencgc.c) */
+void walk_arenas(void (*fun)(lispobj*, lispobj*));
+#ifdef DEBUG
+int destroyed_arena_pointer_p(lispobj);
+#endif
+
 typedef unsigned int page_bytes_t;
 #define page_words_used(index) page_table[index].words_used_
 #define page_bytes_used(index) ((page_bytes_t)page_table[index].words_used_<<WORD_SHIFT)
@@ -86,8 +101,66 @@ static os_vm_size_t  __attribute__((unused)) page_scan_start_offset(page_index_t
 
 #endif
 
+/* True if the page starts a contiguous block. */
+static inline boolean
+page_starts_contiguous_block_p(page_index_t page_index)
+{
+    // Don't use the preprocessor macro: 0 means 0.
+    return page_table[page_index].scan_start_offset_ == 0;
+}
+
+/* True if the page is the last page in a contiguous block. */
+static inline boolean
+page_ends_contiguous_block_p(page_index_t page_index,
+                             generation_index_t __attribute__((unused)) gen)
+{
+    /* Re. this next test: git rev c769dd53 said that there was a bug when we don't
+     * test page_bytes_used, but I fail to see how 'page_starts_contiguous_block_p'
+     * on the next page is not a STRONGER condition, i.e. it should imply that
+     * 'page_index' ends a block without regard for the number of bytes used.
+     * Apparently at some point I understood this and now I don't again.
+     * That's what comments are for, damnit.
+     * Anyway, I *think* the issue was, at some point, as follows:
+     * |   page             |     page   |
+     *        pinned-obj
+     *     <------------------- scan-start
+     * where the first of the two pages had a small object pinned. This used to
+     * adjust the bytes used to account _only_ for the pins.  That was wrong -
+     * the page has to be counted as if it is completely full.
+     * So _maybe_ both these conditions do not need to be present now ?
+     */
+    // There is *always* a next page in the page table.
+    boolean answer = page_words_used(page_index) < GENCGC_PAGE_WORDS
+                  || page_starts_contiguous_block_p(page_index+1);
+#ifdef DEBUG
+    boolean safe_answer =
+           (/* page doesn't fill block */
+            (page_words_used(page_index) < GENCGC_PAGE_WORDS)
+            /* page is last allocated page */
+            || ((page_index + 1) >= next_free_page)
+            /* next page contains no data */
+            || !page_words_used(page_index + 1)
+            /* next page is in different generation */
+            || (page_table[page_index + 1].gen != gen)
+            /* next page starts its own contiguous block */
+            || (page_starts_contiguous_block_p(page_index + 1)));
+    gc_assert(answer == safe_answer);
+#endif
+    return answer;
+}
+
 #define is_code(type) ((type & PAGE_TYPE_MASK) == PAGE_TYPE_CODE)
 
+/* When enough of from_space is pinned, reachable unpinned objects on
+ * pinned pages other than code are marked where they are instead of being
+ * transported (see gc_mark_in_place). This returns true if a from_space
+ * object on 'page' that is neither pinned nor forwarded should be marked */
+extern boolean gc_pin_inplace;
+void gc_mark_in_place(lispobj object);
+static inline boolean mark_in_place_p(page_index_t page) {
+    return gc_pin_inplace && page_table[page].pinned && !is_code(page_table[page].type);
+}
+
 // If *all* pages use soft card marks, then protection_mode() is not a thing.
 // Otherwise, only pages of code use soft card marks; return an enum indicating
 // whether the page protection for the specified page is applied in harware.
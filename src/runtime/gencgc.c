@@ -27,6 +27,7 @@
 #include <errno.h>
 #include <string.h>
 #include <inttypes.h>
+#include <math.h>
 #include "sbcl.h"
 #ifndef LISP_FEATURE_WIN32
 #include <signal.h>
@@ -61,6 +62,7 @@
 #include "forwarding-ptr.h"
 #include "lispregs.h"
 #include "var-io.h"
+#include "murmur_hash.h"
 
 /* forward declarations */
 extern FILE *gc_activitylog();
@@ -161,13 +163,67 @@ page_index_t page_table_pages;
 struct page *page_table;
 unsigned char *gc_card_mark;
 lispobj gc_object_watcher;
+extern char* gc_heap_dump_pathname;
 int gc_traceroot_criterion;
 // Filtered pins include code but not simple-funs,
 // and must not include invalid pointers.
 lispobj* gc_filtered_pins;
 static int pins_alloc_size;
 int gc_pin_count;
-struct hopscotch_table pinned_objects;
+
+/* Pins are recorded in 'gc_pin_bits', which like gc_object_start_bits has
+ * one bit per double-lispword of dynamic space. It is allocated with
+ * os_allocate(), so memory is committed only for the parts of dynamic space
+ * that have ever had a pin. Pinning an exact root costs a bit test and set,
+ * and so does pinned_p(). A code object pins the bits of its simple-funs
+ * too, so that pinned_p() never has to find the code from a function.
+ * The objects whose bits are set are listed in 'pin_bit_objects', so that
+ * refine_ambiguous_roots() can use them without validating or deduplicating,
+ * and so that the bits can be cleared before the next GC.
+ * An ambiguous pointer that conservative_root_p() could not resolve to an
+ * object start also sets its bit, and is listed in 'ambiguous_pins' instead
+ * until refine_ambiguous_roots() has either found the object or cleared the bit.
+ * Only a real object start is ever tested by pinned_p(), and at most one
+ * object starts in a double-lispword, so that can't confuse things meanwhile */
+uword_t* gc_pin_bits;
+static lispobj* pin_bit_objects;
+static sword_t n_pin_bit_objects, pin_bit_objects_capacity;
+static lispobj* ambiguous_pins;
+static sword_t n_ambiguous_pins, ambiguous_pins_capacity;
+
+static void set_pin_bit(lispobj object)
+{
+    uword_t bit = (object - DYNAMIC_SPACE_START) >> (1+WORD_SHIFT);
+    gc_pin_bits[bit / N_WORD_BITS] |= (uword_t)1 << (bit % N_WORD_BITS);
+    pin_bit_objects = grow_gc_array(pin_bit_objects, &pin_bit_objects_capacity,
+                                    n_pin_bit_objects, n_pin_bit_objects + 1,
+                                    sizeof (lispobj));
+    pin_bit_objects[n_pin_bit_objects++] = object;
+}
+
+static void set_ambiguous_pin(lispobj word)
+{
+    uword_t bit = (word - DYNAMIC_SPACE_START) >> (1+WORD_SHIFT);
+    gc_pin_bits[bit / N_WORD_BITS] |= (uword_t)1 << (bit % N_WORD_BITS);
+    ambiguous_pins = grow_gc_array(ambiguous_pins, &ambiguous_pins_capacity,
+                                   n_ambiguous_pins, n_ambiguous_pins + 1,
+                                   sizeof (lispobj));
+    ambiguous_pins[n_ambiguous_pins++] = word;
+}
+
+static inline void clear_pin_bit(lispobj word)
+{
+    uword_t bit = (word - DYNAMIC_SPACE_START) >> (1+WORD_SHIFT);
+    gc_pin_bits[bit / N_WORD_BITS] &= ~((uword_t)1 << (bit % N_WORD_BITS));
+}
+
+static void clear_pin_bits()
+{
+    sword_t i;
+    for (i = 0; i < n_pin_bit_objects; ++i) clear_pin_bit(pin_bit_objects[i]);
+    for (i = 0; i < n_ambiguous_pins; ++i) clear_pin_bit(ambiguous_pins[i]);
+    n_pin_bit_objects = n_ambiguous_pins = 0;
+}
 
 /* This is always 0 except during gc_and_save() */
 lispobj lisp_init_function;
@@ -206,59 +262,60 @@ page_scan_start(page_index_t page_index)
     return page_address(page_index)-page_scan_start_offset(page_index);
 }
 
-/* True if the page starts a contiguous block. */
-static inline boolean
-page_starts_contiguous_block_p(page_index_t page_index)
-{
-    // Don't use the preprocessor macro: 0 means 0.
-    return page_table[page_index].scan_start_offset_ == 0;
-}
-
-/* True if the page is the last page in a contiguous block. */
-static inline boolean
-page_ends_contiguous_block_p(page_index_t page_index,
-                             generation_index_t __attribute__((unused)) gen)
-{
-    /* Re. this next test: git rev c769dd53 said that there was a bug when we don't
-     * test page_bytes_used, but I fail to see how 'page_starts_contiguous_block_p'
-     * on the next page is not a STRONGER condition, i.e. it should imply that
-     * 'page_index' ends a block without regard for the number of bytes used.
-     * Apparently at some point I understood this and now I don't again.
-     * That's what comments are for, damnit.
-     * Anyway, I *think* the issue was, at some point, as follows:
-     * |   page             |     page   |
-     *        pinned-obj
-     *     <------------------- scan-start
-     * where the first of the two pages had a small object pinned. This used to
-     * adjust the bytes used to account _only_ for the pins.  That was wrong -
-     * the page has to be counted as if it is completely full.
-     * So _maybe_ both these conditions do not need to be present now ?
-     */
-    // There is *always* a next page in the page table.
-    boolean answer = page_words_used(page_index) < GENCGC_PAGE_WORDS
-                  || page_starts_contiguous_block_p(page_index+1);
-#ifdef DEBUG
-    boolean safe_answer =
-           (/* page doesn't fill block */
-            (page_words_used(page_index) < GENCGC_PAGE_WORDS)
-            /* page is last allocated page */
-            || ((page_index + 1) >= next_free_page)
-            /* next page contains no data */
-            || !page_words_used(page_index + 1)
-            /* next page is in different generation */
-            || (page_table[page_index + 1].gen != gen)
-            /* next page starts its own contiguous block */
-            || (page_starts_contiguous_block_p(page_index + 1)));
-    gc_assert(answer == safe_answer);
-#endif
-    return answer;
-}
-
 /* We maintain the invariant that pages with FREE_PAGE_FLAG have
  * scan_start of zero, to optimize page_ends_contiguous_block_p().
  * Clear all the flags that don't pertain to a free page.
  * Particularly the 'need_zerofill' bit has to remain unchanged */
+/* With 'gencgc_lazy_zeroing', the collector does not zero-fill pages of MIXED
+ * objects that it allocates to generation 0, though Lisp may later extend its
+ * allocation regions onto the unused part of the last such page.
+ * Instead the page is noted in this bitmap, and the unused part gets zeroed
+ * in gc_alloc_new_region() when Lisp claims it, moving the work out of the pause.
+ * Wholly free pages need no bit, as 'need_zerofill' already covers them. */
+int gencgc_lazy_zeroing;
+static uword_t* deferred_zero_bits;
+#define deferred_zero_p(page) ((deferred_zero_bits[(page)/N_WORD_BITS] >> ((page)%N_WORD_BITS)) & 1)
+#define set_deferred_zero(page) deferred_zero_bits[(page)/N_WORD_BITS] |= (uword_t)1<<((page)%N_WORD_BITS)
+#define clear_deferred_zero(page) deferred_zero_bits[(page)/N_WORD_BITS] &= ~((uword_t)1<<((page)%N_WORD_BITS))
+
+/* NUMA partitioning of dynamic space. See gc_alloc_new_region() */
+int gencgc_numa_nodes; // 0 = disabled. Set to nonzero to request
+#define MAX_NUMA_NODES 8
+static page_index_t numa_node_first_page[MAX_NUMA_NODES];
+static page_index_t numa_alloc_start_pages[MAX_NUMA_NODES];
+
+/* For each page opened by a size-class region, half the size in words of
+ * every object on it; 0 for all other pages. Object starts on such a page
+ * are at multiples of that size from the start of each card, except that
+ * the final object on a card may be a shorter filler */
+int gencgc_size_class_pages = 1;
+static unsigned char* page_size_class;
+
+/* With 'gencgc_object_start_bitmap', gc_object_start_bits records the start
+ * of each object that the collector places (see gc_general_alloc), as well as
+ * fillers it creates. The bits for a page are trustworthy only if the page was
+ * empty when a collector region was opened on it and Lisp has not since
+ * allocated on it; 'object_starts_valid_bits' has one bit per page for that. */
+int gencgc_object_start_bitmap;
+uword_t* gc_object_start_bits;
+static uword_t* object_starts_valid_bits;
+#define START_BITS_PER_PAGE (GENCGC_PAGE_BYTES >> (1+WORD_SHIFT))
+#define object_starts_valid_p(page) ((object_starts_valid_bits[(page)/N_WORD_BITS] >> ((page)%N_WORD_BITS)) & 1)
+#define set_object_starts_valid(page) object_starts_valid_bits[(page)/N_WORD_BITS] |= (uword_t)1<<((page)%N_WORD_BITS)
+#define clear_object_starts_valid(page) object_starts_valid_bits[(page)/N_WORD_BITS] &= ~((uword_t)1<<((page)%N_WORD_BITS))
+
+/* 'root_candidate_bits' has one bit per page, set at the start of each GC for
+ * the pages that an ambiguous root can pin: the pages of from_space holding
+ * anything, or every page holding anything if not compacting. Most words on
+ * a stack that look like heap addresses point into older generations, and one
+ * load from this rejects them without touching the page table. */
+static uword_t* root_candidate_bits;
+#define root_candidate_p(page) ((root_candidate_bits[(page)/N_WORD_BITS] >> ((page)%N_WORD_BITS)) & 1)
+
 static inline void reset_page_flags(page_index_t page) {
+    clear_deferred_zero(page);
+    page_size_class[page] = 0;
+    clear_object_starts_valid(page);
     page_table[page].scan_start_offset_ = 0;
     page_table[page].type = 0;
     page_table[page].pinned = 0;
@@ -310,6 +367,56 @@ addr_diff(void *x, void *y)
  * generation is temporarily raised then lowered. */
 struct generation generations[NUM_GENERATIONS];
 
+/* A mutator thread does not add each nursery region it closes into
+ * 'bytes_allocated' and generations[0] right away: with many threads
+ * refilling their regions, those two words would be written by every
+ * thread on every refill. Instead the bytes go to one of a few counters
+ * on separate cache lines, chosen by thread, and are added into the totals
+ * when the counter reaches ALLOCATION_FLUSH_BYTES or when GC begins.
+ * So the totals lag by at most N_ALLOCATION_SHARDS * ALLOCATION_FLUSH_BYTES,
+ * which delays the GC trigger by at most as much. DYNAMIC-USAGE adds in the
+ * unflushed bytes; see dynamic_usage().
+ * The counters, like the totals, are only written with 'free_pages_lock'
+ * held or with the world stopped. */
+#define N_ALLOCATION_SHARDS 16
+#define ALLOCATION_FLUSH_BYTES (8*GENCGC_PAGE_BYTES)
+static struct {
+    os_vm_size_t unflushed;
+} __attribute__((aligned(64))) allocation_shards[N_ALLOCATION_SHARDS];
+
+static inline int allocation_shard_index(struct thread* th)
+{
+#ifdef LISP_FEATURE_64_BIT
+    return murmur3_fmix64((uword_t)th) % N_ALLOCATION_SHARDS;
+#else
+    return murmur3_fmix32((uword_t)th) % N_ALLOCATION_SHARDS;
+#endif
+}
+
+static void flush_allocation_shard(int index)
+{
+    os_vm_size_t n = allocation_shards[index].unflushed;
+    allocation_shards[index].unflushed = 0;
+    bytes_allocated += n;
+    generations[0].bytes_allocated += n;
+}
+
+/* This needs no lock. Without one the sum can be stale, as can
+ * 'bytes_allocated' itself, by whatever is being allocated concurrently */
+static os_vm_size_t unflushed_bytes_allocated()
+{
+    os_vm_size_t sum = 0;
+    int i;
+    for (i = 0; i < N_ALLOCATION_SHARDS; ++i) sum += allocation_shards[i].unflushed;
+    return sum;
+}
+
+/* DYNAMIC-USAGE */
+os_vm_size_t dynamic_usage()
+{
+    return bytes_allocated + unflushed_bytes_allocated();
+}
+
 /* the oldest generation that is will currently be GCed by default.
  * Valid values are: 0, 1, ... HIGHEST_NORMAL_GENERATION
  *
@@ -346,6 +453,8 @@ os_vm_size_t gencgc_release_granularity = GENCGC_RELEASE_GRANULARITY;
 extern os_vm_size_t gencgc_alloc_granularity;
 os_vm_size_t gencgc_alloc_granularity = GENCGC_ALLOC_GRANULARITY;
 
+int gencgc_huge_pages;
+
 
 /*
  * miscellaneous heap functions
@@ -388,7 +497,8 @@ static void show_pinnedobj_count()
     }
     fprintf(stderr,
             "/pinned objects(g%d): large=%d (%d words), small=%d\n",
-            from_space, n_pinned_largeobj, nwords, pinned_objects.count);
+            from_space, n_pinned_largeobj, nwords,
+            (int)(n_ambiguous_pins + n_pin_bit_objects));
 }
 
 /* Work through the pages and add up the number of bytes used for the
@@ -439,10 +549,12 @@ write_generation_stats(FILE *file)
             "Gen  Boxed   Cons    Raw   Code  SmMix  Mixed  LgRaw LgCode  LgMix"
             " Waste%%       Alloc        Trig   Dirty GCs Mem-age\n");
 
+    os_vm_size_t unflushed = unflushed_bytes_allocated();
+    os_vm_size_t total_bytes = bytes_allocated + unflushed;
     generation_index_t gen_num, begin, end;
     // Print from the lowest gen that has any allocated pages.
     for (begin = 0; begin <= PSEUDO_STATIC_GENERATION; ++begin)
-        if (generations[begin].bytes_allocated) break;
+        if (generations[begin].bytes_allocated || (begin == 0 && unflushed)) break;
     // Print up to and including the highest gen that has any allocated pages.
     for (end = SCRATCH_GENERATION; end >= 0; --end)
         if (generations[end].bytes_allocated) break;
@@ -473,10 +585,11 @@ write_generation_stats(FILE *file)
                 coltot[column]++;
             }
         struct generation* gen = &generations[gen_num];
-        gc_assert(gen->bytes_allocated == count_generation_bytes_allocated(gen_num));
+        os_vm_size_t gen_bytes = gen->bytes_allocated + (gen_num == 0 ? unflushed : 0);
+        gc_assert(gen_bytes == count_generation_bytes_allocated(gen_num));
         page_index_t tot_pages, n_dirty;
         tot_pages = count_generation_pages(gen_num, &n_dirty);
-        uword_t waste = npage_bytes(tot_pages) - generations[gen_num].bytes_allocated;
+        uword_t waste = npage_bytes(tot_pages) - gen_bytes;
         double pct_waste = tot_pages > 0 ?
           (double)waste / (double)npage_bytes(tot_pages) * 100 : 0.0;
         fprintf(file,
@@ -486,7 +599,7 @@ write_generation_stats(FILE *file)
                 gen_num,
                 pagect[0], pagect[1], pagect[2], pagect[3], pagect[4], pagect[5],
                 pagect[6], pagect[7], pagect[8],
-                pct_waste, (uintptr_t)gen->bytes_allocated,
+                pct_waste, (uintptr_t)gen_bytes,
                 (uintptr_t)gen->gc_trigger);
         // gen0 pages are never WPed
         fprintf(file, gen_num==0?"       -" : " %7"PAGE_INDEX_FMT, n_dirty);
@@ -494,9 +607,9 @@ write_generation_stats(FILE *file)
     }
     page_index_t tot_pages = coltot[0] + coltot[1] + coltot[2] + coltot[3] + coltot[4] +
                              coltot[5] + coltot[6] + coltot[7] + coltot[8];
-    uword_t waste = npage_bytes(tot_pages) - bytes_allocated;
+    uword_t waste = npage_bytes(tot_pages) - total_bytes;
     double pct_waste = (double)waste / (double)npage_bytes(tot_pages) * 100;
-    double heap_use_frac = 100 * (double)bytes_allocated / (double)dynamic_space_size;
+    double heap_use_frac = 100 * (double)total_bytes / (double)dynamic_space_size;
     fprintf(file,
             "-- %7"PAGE_INDEX_FMT"%7"PAGE_INDEX_FMT"%7"PAGE_INDEX_FMT"%7"PAGE_INDEX_FMT
             "%7"PAGE_INDEX_FMT"%7"PAGE_INDEX_FMT"%7"PAGE_INDEX_FMT"%7"PAGE_INDEX_FMT
@@ -504,7 +617,29 @@ write_generation_stats(FILE *file)
             " [%.1f%% of %"OS_VM_SIZE_FMT" max]\n",
             coltot[0], coltot[1], coltot[2], coltot[3], coltot[4], coltot[5], coltot[6],
             coltot[7], coltot[8], pct_waste,
-            (uintptr_t)bytes_allocated, heap_use_frac, (uintptr_t)dynamic_space_size);
+            (uintptr_t)total_bytes, heap_use_frac, (uintptr_t)dynamic_space_size);
+
+    /* Report the zeroing that Lisp will do when it next claims deferred pages */
+    page_index_t page, n_deferred = 0;
+    uword_t deferred_bytes = 0;
+    for (page = 0; page < next_free_page; ++page)
+        if (deferred_zero_p(page) && !page_free_p(page)) {
+            ++n_deferred;
+            deferred_bytes += GENCGC_PAGE_BYTES - page_bytes_used(page);
+        }
+    if (n_deferred)
+        fprintf(file, "   Deferred zeroing: %"PAGE_INDEX_FMT" pages, %"OS_VM_SIZE_FMT" bytes\n",
+                n_deferred, (uintptr_t)deferred_bytes);
+    int node;
+    for (node = 0; node < gencgc_numa_nodes; ++node) {
+        page_index_t end = node+1 < gencgc_numa_nodes ? numa_node_first_page[node+1]
+                           : page_table_pages;
+        page_index_t used = 0;
+        for (page = numa_node_first_page[node]; page < end && page < next_free_page; ++page)
+            if (!page_free_p(page)) ++used;
+        fprintf(file, "   Node %d: %"PAGE_INDEX_FMT" of %"PAGE_INDEX_FMT" pages used\n",
+                node, used, end - numa_node_first_page[node]);
+    }
 
 #ifdef LISP_FEATURE_X86
     fpu_restore(fpu_state);
@@ -732,6 +867,16 @@ void zero_dirty_pages(page_index_t start, page_index_t end, int page_type) {
         (page_type == PAGE_TYPE_MIXED && usable_by_lisp) || page_type == 0;
 #endif
 
+#ifndef LISP_FEATURE_DARWIN_JIT
+    if (must_zero && gencgc_lazy_zeroing && gc_active_p && page_type == PAGE_TYPE_MIXED) {
+        // The collector doesn't need zeroed memory. Defer to when Lisp needs it.
+        for (i = start; i <= end; i++) {
+            if (page_need_to_zero(i)) set_deferred_zero(i);
+            set_page_need_to_zero(i, 1);
+        }
+        return;
+    }
+#endif
     if (must_zero) {
         // look for contiguous ranges. This is probably without merit, since bzero
         // does not go significantly faster for 2 pages than for 1 page and 1 page.
@@ -746,10 +891,26 @@ void zero_dirty_pages(page_index_t start, page_index_t end, int page_type) {
     }
 
     for (i = start; i <= end; i++) {
+        if (must_zero) clear_deferred_zero(i);
         set_page_need_to_zero(i, 1);
     }
 }
 
+/* Zero the unused part of every page that had its zeroing deferred */
+static void zero_deferred_pages()
+{
+    page_index_t page;
+    for (page = 0; page < next_free_page; ++page)
+        if (deferred_zero_p(page)) {
+            if (page_words_used(page))
+                zero_range(page_address(page) + page_bytes_used(page),
+                           page_address(page+1));
+            else
+                set_page_need_to_zero(page, 1);
+            clear_deferred_zero(page);
+        }
+}
+
 
 /*
  * To support quick and inline allocation, regions of memory can be
@@ -799,10 +960,17 @@ void zero_dirty_pages(page_index_t start, page_index_t end, int page_type) {
 
 /* We use five regions for the current newspace generation. */
 struct alloc_region gc_alloc_region[6];
+struct alloc_region size_class_region[N_SIZE_CLASSES];
 
 static page_index_t
   alloc_start_pages[8], // one for each value of PAGE_TYPE_x
   gencgc_alloc_start_page; // initializer for the preceding array
+static page_index_t size_class_start_pages[N_SIZE_CLASSES];
+static void reset_size_class_start_pages() {
+    int i;
+    for (i = 0; i < N_SIZE_CLASSES; ++i)
+        size_class_start_pages[i] = gencgc_alloc_start_page;
+}
 
 #define RESET_ALLOC_START_PAGES() \
         alloc_start_pages[0] = gencgc_alloc_start_page; \
@@ -812,7 +980,8 @@ static page_index_t
         alloc_start_pages[4] = gencgc_alloc_start_page; \
         alloc_start_pages[5] = gencgc_alloc_start_page; \
         alloc_start_pages[6] = gencgc_alloc_start_page; \
-        alloc_start_pages[7] = gencgc_alloc_start_page;
+        alloc_start_pages[7] = gencgc_alloc_start_page; \
+        reset_size_class_start_pages();
 
 static inline page_index_t
 alloc_start_page(unsigned int page_type, int large)
@@ -911,10 +1080,12 @@ void gc_heap_exhausted_error_or_lose (sword_t available, sword_t requested) neve
  * - a region can't be extended from one page to the next
  *   (implied by the preceding restriction).
  * SMALL_MIXED is similar to cons, but all bytes of the page can be used
- * for storing objects, subject to the non-card-spaning constraint. */
-static page_index_t find_single_page(int page_type, sword_t nbytes, generation_index_t gen)
+ * for storing objects, subject to the non-card-spaning constraint.
+ * A partially used page is acceptable only if its 'page_size_class' is
+ * 'size_class', so size-class pages never receive objects of other sizes. */
+static page_index_t find_single_page(int page_type, sword_t nbytes, generation_index_t gen,
+                                     page_index_t page, int size_class, boolean may_fail)
 {
-    page_index_t page = alloc_start_pages[page_type];;
     // Compute the max words that could already be used while satisfying the request.
     page_words_t usage_allowance =
         usage_allowance = GENCGC_PAGE_BYTES/N_WORD_BYTES - (nbytes>>WORD_SHIFT);
@@ -924,8 +1095,11 @@ static page_index_t find_single_page(int page_type, sword_t nbytes, generation_i
     }
     for ( ; page < page_table_pages ; ++page) {
         if (page_words_used(page) <= usage_allowance
-            && (page_free_p(page) || page_extensible_p(page, gen, page_type))) return page;
+            && (page_free_p(page) ||
+                (page_extensible_p(page, gen, page_type)
+                 && page_size_class[page] == size_class))) return page;
     }
+    if (may_fail) return -1;
     /* Compute the "available" space for the lossage message. This is kept out of the
      * search loop because it's needless overhead. Any free page would have been returned,
      * so we just have to find the least full page meeting the gen+type criteria */
@@ -947,9 +1121,70 @@ static page_index_t find_single_page(int page_type, sword_t nbytes, generation_i
     gc_heap_exhausted_error_or_lose(bytes_avail, nbytes);
 }
 
+/* Maintain the validity of object start bits for pages 'first' through
+ * 'last' of 'region' being opened, the first of which may be partially used.
+ * Only the collector's own regions allocate through gc_general_alloc() */
+static void note_region_object_starts(page_index_t first, page_index_t last,
+                                      struct alloc_region* region)
+{
+    boolean collector =
+        gc_active_p && ((region >= gc_alloc_region && region < gc_alloc_region + 6)
+                        || (region >= size_class_region
+                            && region < size_class_region + N_SIZE_CLASSES));
+    page_index_t page;
+    for (page = first; page <= last; ++page) {
+        if (!collector)
+            clear_object_starts_valid(page);
+        else if (page_words_used(page) == 0) {
+            memset(gc_object_start_bits + page * (START_BITS_PER_PAGE / N_WORD_BITS),
+                   0, START_BITS_PER_PAGE / 8);
+            set_object_starts_valid(page);
+        }
+    }
+}
+
+/* Optional NUMA awareness: dynamic space is divided evenly among the nodes,
+ * each part preferring to have its memory on its node, and a Lisp thread
+ * opening an allocation region searches for pages first in the part that
+ * belongs to the node it is running on, falling back to the usual search.
+ * The collector itself allocates without regard to nodes. */
+static page_index_t find_freeish_pages(page_index_t*, sword_t, int, generation_index_t, boolean);
+#ifdef LISP_FEATURE_LINUX
+static void numa_init()
+{
+    if (!gencgc_numa_nodes) return;
+    int n = os_numa_node_count();
+    if (n > MAX_NUMA_NODES) n = MAX_NUMA_NODES;
+    gencgc_numa_nodes = n > 1 ? n : 0;
+    if (!gencgc_numa_nodes) return;
+    int node;
+    for (node = 0; node < n; ++node)
+        numa_node_first_page[node] = numa_alloc_start_pages[node] =
+            ((uword_t)page_table_pages * node) / n;
+    for (node = 0; node < n; ++node) {
+        page_index_t end = node+1 < n ? numa_node_first_page[node+1] : page_table_pages;
+        os_numa_prefer_node(page_address(numa_node_first_page[node]),
+                            npage_bytes(end - numa_node_first_page[node]), node);
+    }
+}
+static inline int current_numa_node() {
+    int node = os_current_numa_node();
+    return node < gencgc_numa_nodes ? node : 0;
+}
+#else
+#define numa_init() gencgc_numa_nodes = 0
+#define current_numa_node() 0
+#endif
+static void reset_numa_alloc_start_pages() {
+    int node;
+    for (node = 0; node < gencgc_numa_nodes; ++node)
+        numa_alloc_start_pages[node] = numa_node_first_page[node];
+}
+
 static void*
 gc_alloc_new_region(sword_t nbytes, int page_type, struct alloc_region *alloc_region, int unlock)
 {
+    int numa_node = (gencgc_numa_nodes && !gc_active_p) ? current_numa_node() : -1;
     /* Check that the region is in a reset state. */
     gc_dcheck(region_closed_p(alloc_region));
 
@@ -958,10 +1193,29 @@ gc_alloc_new_region(sword_t nbytes, int page_type, struct alloc_region *alloc_re
         //   - not called from Lisp, as in the SMALL_MIXED case
         //   - called from lisp_alloc() which does its own unlock
         gc_dcheck(!unlock);
-        page_index_t page;
-        INSTRUMENTING(page = find_single_page(page_type, nbytes, gc_alloc_generation),
-                      et_find_freeish_page);
+        page_index_t page = -1;
+        int size_class = 0;
+        if (alloc_region >= size_class_region
+            && alloc_region < size_class_region + N_SIZE_CLASSES) {
+            size_class = 1 + (alloc_region - size_class_region);
+            INSTRUMENTING(page = find_single_page(page_type, nbytes, gc_alloc_generation,
+                                                  size_class_start_pages[size_class-1],
+                                                  size_class, 0),
+                          et_find_freeish_page);
+            size_class_start_pages[size_class-1] = page;
+        } else if (numa_node >= 0) {
+            page = find_single_page(page_type, nbytes, gc_alloc_generation,
+                                    numa_alloc_start_pages[numa_node], 0, 1);
+            if (page >= 0) numa_alloc_start_pages[numa_node] = page;
+        }
+        if (page < 0)
+            INSTRUMENTING(page = find_single_page(page_type, nbytes, gc_alloc_generation,
+                                                  alloc_start_pages[page_type], 0, 0),
+                          et_find_freeish_page);
         if (page+1 > next_free_page) next_free_page = page+1;
+        gc_dcheck(page_words_used(page) == 0 || page_size_class[page] == size_class);
+        page_size_class[page] = size_class;
+        if (gc_object_start_bits) note_region_object_starts(page, page, alloc_region);
         page_table[page].gen = gc_alloc_generation;
         page_table[page].type = OPEN_REGION_PAGE_FLAG | page_type;
 #ifdef LISP_FEATURE_DARWIN_JIT
@@ -993,20 +1247,28 @@ gc_alloc_new_region(sword_t nbytes, int page_type, struct alloc_region *alloc_re
         return alloc_region->free_pointer;
     }
 
-    page_index_t first_page = alloc_start_page(page_type, 0), last_page;
+    page_index_t first_page = alloc_start_page(page_type, 0), last_page = -1;
+    int search_type = ((nbytes >= (sword_t)GENCGC_PAGE_BYTES) ? SINGLE_OBJECT_FLAG : 0)
+                      | page_type;
 
-    INSTRUMENTING(
-    last_page = gc_find_freeish_pages(&first_page, nbytes,
-                                      ((nbytes >= (sword_t)GENCGC_PAGE_BYTES) ?
-                                       SINGLE_OBJECT_FLAG : 0) | page_type,
-                                      gc_alloc_generation),
-    et_find_freeish_page);
+    if (numa_node >= 0) {
+        page_index_t node_page = numa_alloc_start_pages[numa_node];
+        last_page = find_freeish_pages(&node_page, nbytes, search_type,
+                                       gc_alloc_generation, 1);
+        if (last_page >= 0) numa_alloc_start_pages[numa_node] = first_page = node_page;
+    }
+    if (last_page < 0)
+        INSTRUMENTING(
+        last_page = gc_find_freeish_pages(&first_page, nbytes, search_type,
+                                          gc_alloc_generation),
+        et_find_freeish_page);
 
     /* Set up the alloc_region. */
     alloc_region->start_addr = page_address(first_page) + page_bytes_used(first_page);
     alloc_region->free_pointer = alloc_region->start_addr;
     alloc_region->end_addr = page_address(last_page+1);
     gc_assert(find_page_index(alloc_region->start_addr) == first_page);
+    if (gc_object_start_bits) note_region_object_starts(first_page, last_page, alloc_region);
 
     /* Set up the pages. */
 
@@ -1034,9 +1296,15 @@ gc_alloc_new_region(sword_t nbytes, int page_type, struct alloc_region *alloc_re
 
     /* If the first page was only partial, don't check whether it's
      * zeroed (it won't be) and don't zero it (since the parts that
-     * we're interested in are guaranteed to be zeroed).
+     * we're interested in are guaranteed to be zeroed),
+     * unless its zeroing was deferred by the collector.
      */
     if (page_words_used(first_page)) {
+        if (deferred_zero_p(first_page) && !(gencgc_lazy_zeroing && gc_active_p)) {
+            INSTRUMENTING(zero_range(alloc_region->start_addr, page_address(first_page+1)),
+                          et_bzeroing);
+            clear_deferred_zero(first_page);
+        }
         first_page++;
     }
 
@@ -1139,10 +1407,15 @@ add_new_area(page_index_t first_page, size_t offset, size_t size)
  * This is the internal implementation of ensure_region_closed(),
  * and not to be invoked as the interface to closing a region.
  */
+static void arena_close_region(struct alloc_region*);
 void
 gc_close_region(struct alloc_region *alloc_region, int page_type)
 {
     page_index_t first_page = find_page_index(alloc_region->start_addr);
+    if (first_page < 0) { // not in dynamic space, so it is carved from an arena
+        arena_close_region(alloc_region);
+        return;
+    }
     page_index_t next_page = first_page+1;
     char *page_base = page_address(first_page);
     char *free_pointer = alloc_region->free_pointer;
@@ -1203,9 +1476,16 @@ gc_close_region(struct alloc_region *alloc_region, int page_type)
 
         // Now 'next_page' is 1 page beyond those fully accounted for.
         gc_assert(addr_diff(free_pointer, alloc_region->start_addr) == region_size);
-        // Update the global totals
-        bytes_allocated += region_size;
-        generations[gc_alloc_generation].bytes_allocated += region_size;
+        // Update the totals. A mutator adds only to its shard
+        struct thread* self = gc_active_p ? 0 : get_sb_vm_thread();
+        if (self && gc_alloc_generation == 0) {
+            int shard = allocation_shard_index(self);
+            if ((allocation_shards[shard].unflushed += region_size) >= ALLOCATION_FLUSH_BYTES)
+                flush_allocation_shard(shard);
+        } else {
+            bytes_allocated += region_size;
+            generations[gc_alloc_generation].bytes_allocated += region_size;
+        }
 
         /* Set the alloc restart page to the last page of the region. */
         set_alloc_start_page(page_type, 0, next_page-1);
@@ -1229,6 +1509,91 @@ gc_close_region(struct alloc_region *alloc_region, int page_type)
     gc_set_region_empty(alloc_region);
 }
 
+/* Runs of free pages long enough for a large object, as seen by the last
+ * GC after which large objects were being allocated, in buckets by the
+ * floor of log2 of their length. gc_alloc_large() takes a run from here
+ * instead of searching the page table. Other allocations don't update the
+ * index, so a run is checked before use and shortened if no longer free.
+ * Pages freed since the index was built are found by the usual search. */
+#define FREE_EXTENT_MIN_PAGES (LARGE_OBJECT_SIZE/GENCGC_PAGE_BYTES)
+#define N_FREE_EXTENT_BUCKETS N_WORD_BITS
+struct free_extent { page_index_t start, npages; sword_t next; };
+static struct free_extent* free_extents;
+static sword_t n_free_extent_slots, free_extent_fill, free_extent_freelist;
+static sword_t free_extent_bucket[N_FREE_EXTENT_BUCKETS]; // -1 means empty
+
+static inline int free_extent_bucket_of(page_index_t npages) {
+    return N_WORD_BITS - 1 - __builtin_clzl((uword_t)npages);
+}
+
+static void add_free_extent(page_index_t start, page_index_t npages)
+{
+    sword_t i;
+    if (npages < FREE_EXTENT_MIN_PAGES) return;
+    if (free_extent_freelist >= 0) {
+        i = free_extent_freelist;
+        free_extent_freelist = free_extents[i].next;
+    } else if (free_extent_fill < n_free_extent_slots)
+        i = free_extent_fill++;
+    else
+        return;
+    int bucket = free_extent_bucket_of(npages);
+    free_extents[i].start = start;
+    free_extents[i].npages = npages;
+    free_extents[i].next = free_extent_bucket[bucket];
+    free_extent_bucket[bucket] = i;
+}
+
+static void reset_free_extents()
+{
+    int i;
+    for (i = 0; i < N_FREE_EXTENT_BUCKETS; ++i) free_extent_bucket[i] = -1;
+    free_extent_fill = 0;
+    free_extent_freelist = -1;
+}
+
+/* Index every run of free pages. Everything from next_free_page up is free */
+static void rebuild_free_extents()
+{
+    reset_free_extents();
+    page_index_t page = 0, start, tail = next_free_page;
+    while (page < next_free_page) {
+        if (!page_free_p(page)) { ++page; continue; }
+        for (start = page; page < next_free_page && page_free_p(page); ++page) ;
+        if (page == next_free_page) tail = start; // joins the free space above
+        else add_free_extent(start, page - start);
+    }
+    add_free_extent(tail, page_table_pages - tail);
+}
+
+/* Return the first page of 'npages' free pages, or -1 if the index has none */
+static page_index_t take_free_extent(page_index_t npages)
+{
+    int bucket;
+    for (bucket = free_extent_bucket_of(npages); bucket < N_FREE_EXTENT_BUCKETS; ++bucket) {
+        sword_t* link = &free_extent_bucket[bucket];
+        int tries = 0;
+        // Runs in the first bucket may be too short. Don't look at many
+        while (*link >= 0 && tries++ < 8) {
+            sword_t i = *link;
+            struct free_extent* extent = &free_extents[i];
+            if (extent->npages < npages) { link = &extent->next; continue; }
+            page_index_t start = extent->start, end = start + extent->npages, page;
+            *link = extent->next;
+            extent->next = free_extent_freelist;
+            free_extent_freelist = i;
+            for (page = start; page < start + npages && page_free_p(page); ++page) ;
+            if (page == start + npages) {
+                add_free_extent(page, end - page);
+                return start;
+            }
+            // Something was allocated in the run. Keep what follows it
+            add_free_extent(page + 1, end - (page + 1));
+        }
+    }
+    return -1;
+}
+
 /* Allocate a possibly large object. */
 void *
 gc_alloc_large(sword_t nbytes, int page_type, struct alloc_region *alloc_region, int unlock)
@@ -1247,11 +1612,19 @@ gc_alloc_large(sword_t nbytes, int page_type, struct alloc_region *alloc_region,
     page_index_t min = find_page_index(alloc_region->end_addr);
     if (first_page < min) first_page = min;
 
+    page_index_t npages = ALIGN_UP(nbytes, GENCGC_PAGE_BYTES) / GENCGC_PAGE_BYTES;
+    page_index_t found = take_free_extent(npages);
+    if (found >= 0) {
+        first_page = found;
+        last_page = found + npages - 1;
+        if (last_page >= next_free_page) next_free_page = last_page + 1;
+    } else {
     INSTRUMENTING(
     last_page = gc_find_freeish_pages(&first_page, nbytes,
                                       SINGLE_OBJECT_FLAG | page_type,
                                       gc_alloc_generation),
     et_find_freeish_page);
+    }
 
     // FIXME: Should this be 1+last_page ?
     // (Doesn't matter too much since it'll be skipped on restart if unusable)
@@ -1276,11 +1649,9 @@ gc_alloc_large(sword_t nbytes, int page_type, struct alloc_region *alloc_region,
     // Anyway it's best if the new page resembles a valid object ASAP.
     uword_t nwords = nbytes >> WORD_SHIFT;
     lispobj* addr = (lispobj*)page_address(first_page);
-    if (unlock)
-        THREAD_JIT(0);
+    THREAD_JIT(0); // nests within the GC's own
     *addr = (nwords - 1) << N_WIDETAG_BITS | FILLER_WIDETAG;
-    if (unlock) // avoid enabling while GCing
-        THREAD_JIT(1);
+    THREAD_JIT(1);
 
     os_vm_size_t scan_start_offset = 0;
     for (page = first_page; page < last_page; ++page) {
@@ -1364,9 +1735,9 @@ gc_heap_exhausted_error_or_lose (sword_t available, sword_t requested)
  * The found space is guaranteed to be page-aligned if the SINGLE_OBJECT_FLAG
  * bit is set in page_type.
  */
-page_index_t
-gc_find_freeish_pages(page_index_t *restart_page_ptr, sword_t nbytes,
-                      int page_type, generation_index_t gen)
+static page_index_t
+find_freeish_pages(page_index_t *restart_page_ptr, sword_t nbytes,
+                   int page_type, generation_index_t gen, boolean may_fail)
 {
     page_index_t most_bytes_found_from = 0, most_bytes_found_to = 0;
     page_index_t first_page, last_page, restart_page = *restart_page_ptr;
@@ -1449,6 +1820,7 @@ gc_find_freeish_pages(page_index_t *restart_page_ptr, sword_t nbytes,
     /* Check for a failure */
     if (bytes_found < nbytes) {
         gc_assert(restart_page >= page_table_pages);
+        if (may_fail) return -1;
         gc_heap_exhausted_error_or_lose(most_bytes_found, nbytes);
     }
 
@@ -1459,6 +1831,12 @@ gc_find_freeish_pages(page_index_t *restart_page_ptr, sword_t nbytes,
     *restart_page_ptr = most_bytes_found_from;
     return most_bytes_found_to-1;
 }
+page_index_t
+gc_find_freeish_pages(page_index_t *restart_page_ptr, sword_t nbytes,
+                      int page_type, generation_index_t gen)
+{
+    return find_freeish_pages(restart_page_ptr, nbytes, page_type, gen, 0);
+}
 
 /* Allocate bytes.  The fast path of gc_general_alloc() calls this
  * when it can't fit in the open region.
@@ -1546,6 +1924,7 @@ void *collector_alloc_fallback(struct alloc_region* region, sword_t nbytes, int
                 return new_region(mixed_region, nbytes, PAGE_TYPE_MIXED);
             *(lispobj*)region->free_pointer =
                 (fill_nwords - 1) << N_WIDETAG_BITS | FILLER_WIDETAG;
+            gc_note_object_start(region->free_pointer);
         }
         region->free_pointer = next_card;
         region->end_addr = next_card + GENCGC_CARD_BYTES;
@@ -1717,6 +2096,9 @@ copy_possibly_large_object(lispobj object, sword_t nwords,
         // Large BOXED would serve no purpose beyond MIXED, and "small large" is illogical.
         if (page_type == PAGE_TYPE_BOXED || page_type == PAGE_TYPE_SMALL_MIXED)
             page_type = PAGE_TYPE_MIXED;
+        // A weak trigger may be on any page of the object if it is code
+        if (gc_track_forwarded_pages)
+            note_forwarded_pages(first_page, rounded / GENCGC_PAGE_BYTES);
         os_vm_size_t bytes_freed =
           adjust_obj_ptes(first_page, nwords, new_space,
                           SINGLE_OBJECT_FLAG | page_type);
@@ -1728,6 +2110,7 @@ copy_possibly_large_object(lispobj object, sword_t nwords,
         /* Add the region to the new_areas if requested. */
         if (boxed_type_p(page_type)) add_new_area(first_page, 0, nbytes);
 
+        NOTE_CENSUS(object, nwords);
         return object;
     }
     return gc_copy_object(object, nwords, region, page_type);
@@ -1742,6 +2125,41 @@ copy_unboxed_object(lispobj object, sword_t nwords)
 
 /* This will NOT reliably work for objects in a currently open allocation region,
  * because page_words_used() is not sync'ed to the free pointer until closing */
+/* Return the start of the object containing 'addr' on a size-class page,
+ * which must be below the page's bytes used */
+static inline lispobj* size_class_object_start(page_index_t page, void* addr)
+{
+    uword_t card_base = ALIGN_DOWN((uword_t)addr, GENCGC_CARD_BYTES);
+    unsigned int obj_bytes = page_size_class[page] << (1+WORD_SHIFT);
+    return (lispobj*)(card_base + ((uword_t)addr - card_base) / obj_bytes * obj_bytes);
+}
+/* Return the highest object start at or below 'addr' according to the start
+ * bits, or 0 if that would involve a page whose bits are not valid.
+ * The search need not go below the page's scan start */
+static lispobj* object_start_from_bits(page_index_t page, void* addr)
+{
+    uword_t bit = ((uword_t)addr - DYNAMIC_SPACE_START) >> (1+WORD_SHIFT);
+    sword_t index = bit / N_WORD_BITS;
+    uword_t word = gc_object_start_bits[index] & (~(uword_t)0 >> (N_WORD_BITS-1 - bit % N_WORD_BITS));
+    sword_t limit = (((uword_t)page_scan_start(page) - DYNAMIC_SPACE_START) >> (1+WORD_SHIFT))
+                    / N_WORD_BITS;
+    while (!word) {
+        if (--index < limit) return 0;
+        if ((index + 1) % (START_BITS_PER_PAGE / N_WORD_BITS) == 0 // stepped onto the prior page
+            && !object_starts_valid_p(--page)) return 0;
+        word = gc_object_start_bits[index];
+    }
+    bit = index * N_WORD_BITS + (63 - __builtin_clzll((unsigned long long)word));
+    return (lispobj*)(DYNAMIC_SPACE_START + (bit << (1+WORD_SHIFT)));
+}
+/* Return the start of the object containing 'addr' if it can be found without
+ * walking the heap, otherwise 0. 'addr' must be below the page's bytes used */
+static lispobj* computed_object_start(page_index_t page, void* addr)
+{
+    if (page_size_class[page]) return size_class_object_start(page, addr);
+    if (object_starts_valid_p(page)) return object_start_from_bits(page, addr);
+    return 0;
+}
 lispobj *search_dynamic_space(void *pointer)
 {
     page_index_t page_index = find_page_index(pointer);
@@ -1764,6 +2182,10 @@ lispobj *search_dynamic_space(void *pointer)
     } else {
         start = (lispobj *)page_scan_start(page_index);
     }
+    if ((char*)pointer < page_address(page_index)+page_bytes_used(page_index)) {
+        lispobj* found = computed_object_start(page_index, pointer);
+        if (found) return found;
+    }
     return gc_search_space(start, pointer);
 }
 
@@ -1917,6 +2339,10 @@ static lispobj conservative_root_p(lispobj addr, page_index_t addr_page_index)
         return 0;
     }
 
+    /* If the object start is known, the pointer has to be to it */
+    lispobj* known_start = computed_object_start(addr_page_index, (void*)addr);
+    if (known_start && known_start != native_pointer(addr)) return 0;
+
     /* For non-code, the pointer's lowtag and widetag must correspond.
      * The putative object header can safely be read even if it turns out
      * that the pointer is not valid, because 'addr' was in bounds for the page.
@@ -2021,30 +2447,29 @@ static void refine_ambiguous_roots()
 {
     void gc_heapsort_uwords(uword_t*, int);
 
-    int pre_deletion_count = pinned_objects.count;
+    int pre_deletion_count = n_ambiguous_pins + n_pin_bit_objects;
     gc_pin_count = pre_deletion_count;
     if (pre_deletion_count == 0) return;
 
-    /* We need a place to sort the keys of pinned_objects. If the key count is small,
-     * use the small_pins vector; otherwise grab some memory via mmap */
+    /* We need a place to sort the ambiguous pins. If the key count is small,
+     * use the small_pins vector; otherwise grab some memory via mmap.
+     * Objects from the pin bits are sorted beyond the end of the merged result */
+    int workspace_size = pre_deletion_count + n_pin_bit_objects;
     lispobj* workspace;
-    if (pre_deletion_count < SMALL_MAX_PINS) { // leave room for sentinel at end
+    if (workspace_size < SMALL_MAX_PINS) { // leave room for sentinel at end
         workspace = small_pins_vector;
     } else {
-        pins_alloc_size = ALIGN_UP((pre_deletion_count+1)*N_WORD_BYTES, BACKEND_PAGE_BYTES);
+        pins_alloc_size = ALIGN_UP((workspace_size+1)*N_WORD_BYTES, BACKEND_PAGE_BYTES);
         workspace = (lispobj*)os_allocate(pins_alloc_size);
         gc_assert(workspace);
     }
     gc_filtered_pins = workspace; // needed for obliterate_nonpinned_words
     lispobj key;
-    int count = 0, index;
-    for_each_hopscotch_key(index, key, pinned_objects) {
-        gc_assert(is_lisp_pointer(key));
-        // Preserve only the object base addresses, including any "false" pointers.
-        if (listp(key) || widetag_of(native_pointer(key)) != SIMPLE_FUN_WIDETAG)
-            workspace[count++] = key;
+    int count = n_ambiguous_pins, index;
+    if (count) {
+        memcpy(workspace, ambiguous_pins, count * N_WORD_BYTES);
+        gc_heapsort_uwords(workspace, count);
     }
-    gc_heapsort_uwords(workspace, count);
     /* Algorithm:
      * for each group of keys with the same page_scan_start
      *   - scan the heap at the indicated start address
@@ -2057,7 +2482,10 @@ static void refine_ambiguous_roots()
     int removed = 0;
     for (index = 0 ; index < count ; ++index) {
         lispobj* key = native_pointer(workspace[index]);
-        lispobj* scan_start = page_scan_start(find_page_index(key));
+        page_index_t key_page = find_page_index(key);
+        // Keys whose object start was computable were already checked
+        if (computed_object_start(key_page, key) == key) continue;
+        lispobj* scan_start = page_scan_start(key_page);
         if (scan_start != previous_scan_start) where = previous_scan_start = scan_start;
         /* Scan forward from 'where'. This does not need a termination test based
          * on page_bytes_used because we know that 'key' was in-bounds for its page.
@@ -2070,6 +2498,7 @@ static void refine_ambiguous_roots()
             } else if (where == key) {
                 break;
             } else { // 'where' went past the key, so the key is bad
+                clear_pin_bit(workspace[index]);
                 workspace[index] = 0;
                 removed = 1;
                 break;
@@ -2086,6 +2515,23 @@ static void refine_ambiguous_roots()
         gc_assert(new_index < count);
         count = new_index;
     }
+    if (n_pin_bit_objects) {
+        /* Merge in the objects from the pin bits, except for the simple-funs
+         * of pinned code. They are known to be valid and distinct, so they
+         * need only to be sorted */
+        lispobj* sorted = workspace + pre_deletion_count;
+        int n_sorted = 0;
+        for (index = 0; index < n_pin_bit_objects; ++index) {
+            key = pin_bit_objects[index];
+            if (!functionp(key) || widetag_of(native_pointer(key)) != SIMPLE_FUN_WIDETAG)
+                sorted[n_sorted++] = key;
+        }
+        gc_heapsort_uwords(sorted, n_sorted);
+        int i = count - 1, j = n_sorted - 1, k;
+        for (k = count + n_sorted - 1; j >= 0; --k)
+            workspace[k] = (i >= 0 && workspace[i] > sorted[j]) ? workspace[i--] : sorted[j--];
+        count += n_sorted;
+    }
     gc_pin_count = count;
 #if 0
     fprintf(stderr, "Sorted pin list (%d):\n", count);
@@ -2125,6 +2571,105 @@ scavenge_pinned_ranges()
     gc_pinned_nwords = nwords;
 }
 
+/* Mark-in-place mode. A pinned page retains every byte up to its last pin,
+ * while the live unpinned objects on it are copied elsewhere. When most of
+ * from_space is pinned, as with many threads parked holding references,
+ * that can nearly double the space used by the survivors. So if the pinned
+ * fraction of the small-object pages other than code reaches
+ * 'gencgc_pin_inplace_threshold' percent (0 meaning never), the objects
+ * found to be reachable on pinned pages are marked where they are instead.
+ * The mark is the object's pin bit, so from_space_p() and everything
+ * that tests liveness treat a marked object as pinned, and marked objects
+ * are scavenged from a list from within the scavenge_newspace() loop.
+ * Once scavenging is done the list is merged into the pins, and
+ * obliterate_nonpinned_words() sweeps the unmarked objects into filler.
+ * Objects reached by a path that transports them without going through
+ * scav1() (such as the CDR chain of a list) are simply copied as usual */
+int gencgc_pin_inplace_threshold;
+boolean gc_pin_inplace;
+static lispobj* inplace_marks;
+static sword_t n_inplace_marks, inplace_marks_capacity, n_inplace_marks_scanned;
+
+/* Copying needs free space for the survivors, which for a large old
+ * generation can be about as much as the rest of the heap holds. So when
+ * 'gencgc_inplace_when_short' is nonzero and the free dynamic space is less
+ * than from_space occupies, every small-object page of from_space other than
+ * code is treated as pinned, and all the survivors on them are marked in place.
+ * Pages left with no survivors are freed as usual. The others keep their
+ * dead objects as filler until a collection that can afford to copy */
+int gencgc_inplace_when_short = 1;
+
+static void choose_inplace_marking()
+{
+    page_index_t page, n_pages = 0, n_pinned = 0;
+    gc_pin_inplace = 0;
+    if (gencgc_inplace_when_short
+        && dynamic_space_size - bytes_allocated < generations[from_space].bytes_allocated) {
+        for (page = 0; page < next_free_page; ++page)
+            if (page_table[page].gen == from_space && page_words_used(page)
+                && !page_single_obj_p(page) && !is_code(page_table[page].type))
+                page_table[page].pinned = 1;
+        gc_pin_inplace = 1;
+        return;
+    }
+    if (!gencgc_pin_inplace_threshold || !gc_pin_count) return;
+    for (page = 0; page < next_free_page; ++page)
+        if (page_table[page].gen == from_space && page_words_used(page)
+            && !page_single_obj_p(page) && !is_code(page_table[page].type)) {
+            ++n_pages;
+            if (page_table[page].pinned) ++n_pinned;
+        }
+    gc_pin_inplace = n_pinned && n_pinned * 100 >= n_pages * gencgc_pin_inplace_threshold;
+}
+
+void gc_mark_in_place(lispobj object)
+{
+    set_pin_bit(object);
+    // An object that survives without moving has to be seen by the incremental
+    // trigger test just as if it had been transported.
+    if (gc_track_forwarded_pages) note_forwarded_object(native_pointer(object));
+    inplace_marks = grow_gc_array(inplace_marks, &inplace_marks_capacity,
+                                  n_inplace_marks, n_inplace_marks + 1, sizeof (lispobj));
+    inplace_marks[n_inplace_marks++] = object;
+}
+
+/* Scavenge the objects marked since the last call */
+static void scavenge_marked_in_place()
+{
+    // Scavenging can mark more objects, which may reallocate the list
+    while (n_inplace_marks_scanned < n_inplace_marks) {
+        lispobj object = inplace_marks[n_inplace_marks_scanned++];
+        lispobj* obj = native_pointer(object);
+        if (listp(object))
+            scavenge(obj, 2);
+        else
+            scavtab[header_widetag(*obj)](obj, *obj);
+    }
+}
+
+/* Add the marked objects to the sorted pins so that obliterate_nonpinned_words()
+ * keeps them, and turn marking off for the rest of this GC */
+static void merge_marked_in_place()
+{
+    void gc_heapsort_uwords(uword_t*, int);
+
+    gc_pin_inplace = 0;
+    if (!n_inplace_marks) return;
+    gc_assert(n_inplace_marks_scanned == n_inplace_marks);
+    int count = gc_pin_count + n_inplace_marks;
+    int alloc_size = ALIGN_UP((count+1)*N_WORD_BYTES, BACKEND_PAGE_BYTES);
+    lispobj* keys = (lispobj*)os_allocate(alloc_size);
+    gc_assert(keys);
+    if (gc_pin_count) memcpy(keys, gc_filtered_pins, gc_pin_count*N_WORD_BYTES);
+    memcpy(keys + gc_pin_count, inplace_marks, n_inplace_marks*N_WORD_BYTES);
+    gc_heapsort_uwords(keys, count);
+    if (pins_alloc_size) os_deallocate((char*)gc_filtered_pins, pins_alloc_size);
+    gc_filtered_pins = keys;
+    pins_alloc_size = alloc_size;
+    gc_pin_count = count;
+    n_inplace_marks = n_inplace_marks_scanned = 0;
+}
+
 /* visit_freed_objects() was designed to support post-GC actions such as
  * recycling of unused symbol TLS indices. However, I could not make this work
  * as claimed at the time that it gets called, so at best this is reserved
@@ -2213,6 +2758,16 @@ static void deposit_filler(uword_t addr, sword_t nbytes) {
     gc_assert((nwords - 1) <= 0x7FFFFF);
     *(lispobj*)addr = (nwords - 1) << N_WIDETAG_BITS | FILLER_WIDETAG;
     page_index_t page = find_page_index((void*)addr);
+    // The filler may cover several objects, so starts are no longer computable
+    page_size_class[page] = 0;
+    if (gc_object_start_bits) {
+        uword_t a;
+        for (a = addr + 2*N_WORD_BYTES; a < addr + nbytes; a += 2*N_WORD_BYTES) {
+            uword_t bit = (a - DYNAMIC_SPACE_START) >> (1+WORD_SHIFT);
+            gc_object_start_bits[bit / N_WORD_BITS] &= ~((uword_t)1 << (bit % N_WORD_BITS));
+        }
+        gc_note_object_start((void*)addr);
+    }
     // - MIXED does not need this because we always scan by object
     // - SMALL_MIXED does because obliterate_nonpinned_words() uses as
     //   few fillers as it can to cover all non-live ranges on a page.
@@ -2293,6 +2848,7 @@ static void obliterate_nonpinned_words()
         // ensure that those pages' scan_starts point at the same address
         // that this page's scan start does, which could be this page or earlier.
         size_t nwords = OBJECT_SIZE(*obj, obj);
+        NOTE_CENSUS(keys[i], nwords);
         uword_t obj_end = (uword_t)(obj + nwords); // non-inclusive address bound
         page_index_t end_page_index = find_page_index((char*)obj_end - 1); // inclusive bound
 
@@ -2336,8 +2892,8 @@ static void obliterate_nonpinned_words()
     }
 }
 
-/* Add 'object' to the hashtable, and if the object is a code component,
- * then also add all of the embedded simple-funs.
+/* Set the pin bit of 'object', and if the object is a code component,
+ * then also those of all of the embedded simple-funs.
  * It is OK to call this function on an object which is already pinned-
  * it will do nothing.
  * But it is not OK to call this if the object is not one which merits
@@ -2356,7 +2912,7 @@ static void obliterate_nonpinned_words()
  * Experimentation bears out that this is the better technique.
  * Also, we wouldn't often expect code components in the collected generation
  * so the extra work here is quite minimal, even if it can generally add to
- * the number of keys in the hashtable.
+ * the number of objects listed with pin bits.
  */
 static void pin_object(lispobj object)
 {
@@ -2378,17 +2934,19 @@ static void pin_object(lispobj object)
         if (page_table[page].pinned) return;
         sword_t nwords = OBJECT_SIZE(*object_start, object_start);
         maybe_adjust_large_object(object_start, page, nwords);
+        NOTE_CENSUS(object, nwords);
         page_index_t last_page = find_page_index(object_start + nwords - 1);
         while (page <= last_page) page_table[page++].pinned = 1;
         return;
     }
 
-    // Multi-object page (the usual case) - presence in the hash table is the pinned criterion.
-    // The 'pinned' bit is a coarse-grained test of whether to bother looking in the table.
-    if (hopscotch_containsp(&pinned_objects, object)) return;
-
-    hopscotch_insert(&pinned_objects, object, 1);
+    // Multi-object page (the usual case) - the pin bit is the pinned criterion.
+    // The 'pinned' bit in the PTE is a coarse-grained test of whether to bother
+    // looking at it.
+    if (pin_bit_p(object)) return;
+    set_pin_bit(object);
     page_table[page].pinned = 1;
+    if (!is_code(page_table[page].type)) return;
     struct code* maybe_code = (struct code*)native_pointer(object);
     // Avoid iterating over embedded simple-funs until the debug info is set.
     // Prior to that, the unboxed payload will contain random bytes.
@@ -2396,11 +2954,11 @@ static void pin_object(lispobj object)
     // until the object is fully constructed.
     if (widetag_of(&maybe_code->header) == CODE_HEADER_WIDETAG && maybe_code->debug_info) {
         for_each_simple_fun(i, fun, maybe_code, 0, {
-            hopscotch_insert(&pinned_objects, make_lispobj(fun, FUN_POINTER_LOWTAG), 1);
+            set_pin_bit(make_lispobj(fun, FUN_POINTER_LOWTAG));
             page_table[find_page_index(fun)].pinned = 1;
         })
 #ifdef RETURN_PC_WIDETAG
-        /* Return PCs can't go in the hash-table, because there's no way to find them.
+        /* Return PCs can't have pin bits, because there's no way to find them.
          * But from_space_p() has to return false on return PCs in pinned code.
          * pinned_p is mostly OK, but it needs to see the 'pinned' bit on for the page
          * having the return PC. There's a chance that we would not set it properly
@@ -2413,6 +2971,17 @@ static void pin_object(lispobj object)
 }
 
 #if !GENCGC_IS_PRECISE || defined LISP_FEATURE_MIPS || defined LISP_FEATURE_PPC64
+static void compute_root_candidate_bits()
+{
+    static page_index_t limit; // bits at or above this are already clear
+    page_index_t i;
+    memset(root_candidate_bits, 0, ALIGN_UP(limit, N_WORD_BITS)/N_WORD_BITS * sizeof (uword_t));
+    for (i = 0; i < next_free_page; ++i)
+        if (page_words_used(i) && (!compacting_p() || page_table[i].gen == from_space))
+            root_candidate_bits[i/N_WORD_BITS] |= (uword_t)1 << (i%N_WORD_BITS);
+    limit = next_free_page;
+}
+
 /* Take a possible pointer to a Lisp object and mark its page in the
  * page_table so that it will not be relocated during a GC.
  *
@@ -2452,6 +3021,7 @@ static boolean NO_SANITIZE_MEMORY preserve_pointer(uword_t word)
 #endif
         return 0;
     }
+    if (!root_candidate_p(page)) return 0;
     lispobj object = conservative_root_p(word, page);
     if (!object) return 0;
     if (object != AMBIGUOUS_POINTER) {
@@ -2460,8 +3030,8 @@ static boolean NO_SANITIZE_MEMORY preserve_pointer(uword_t word)
     }
     // It's a non-large non-code ambiguous pointer.
     if (compacting_p()) {
-        if (!hopscotch_containsp(&pinned_objects, word)) {
-            hopscotch_insert(&pinned_objects, word, 1);
+        if (!pin_bit_p(word)) {
+            set_ambiguous_pin(word);
             page_table[page].pinned = 1;
         }
         return 1;
@@ -2536,7 +3106,7 @@ static void sticky_preserve_pointer(os_context_register_t register_word)
 
 /* Pin an unambiguous descriptor object which may or may not be a pointer.
  * Ignore immediate objects, and heuristically skip some objects that are
- * known to be pinned without looking in pinned_objects.
+ * known to be pinned without looking at their pin bits.
  * pin_object() will always do the right thing and ignore multiple
  * calls with the same object in the same collection pass.
  */
@@ -2801,6 +3371,26 @@ static inline boolean large_scannable_vector_p(page_index_t page) {
     return 0;
 }
 
+#ifdef LISP_FEATURE_SOFT_CARD_MARKS
+extern boolean kv_vector_cardwise_scannable_p(struct vector*);
+extern int kv_vector_descriptors_scavenge(struct vector*, lispobj*, lispobj*,
+                                          generation_index_t, int);
+/* Decide if this single-object page holds a large non-weak k/v vector
+ * with keys hashed by address. Those are scanned card-by-card too, but must
+ * note any address-sensitive key that moves. */
+static inline boolean large_addr_hashing_kv_vector_p(page_index_t page) {
+    lispobj header = *(lispobj *)page_address(page);
+    if (header_widetag(header) != SIMPLE_VECTOR_WIDETAG
+        || !vector_flagp(header, VectorHashing)
+        || !vector_flagp(header, VectorAddrHashing)
+        || vector_flagp(header, VectorWeak))
+        return 0;
+    struct vector* v = (struct vector*)page_address(page);
+    return KV_PAIRS_HIGH_WATER_MARK(v->data) >= (int)(GENCGC_PAGE_BYTES/N_WORD_BYTES)
+        && kv_vector_cardwise_scannable_p(v);
+}
+#endif
+
 /* Attempt to re-protect code from first_page to last_page inclusive.
  * The object bounds are 'start' and 'limit', the former being redundant
  * with page_address(first_page).
@@ -2905,6 +3495,110 @@ static page_index_t scan_boxed_root_cards_spanning(page_index_t page, generation
     return page;
 }
 
+#ifdef LISP_FEATURE_SOFT_CARD_MARKS
+/* Return 1 if the word at *where is a pointer that the root scan has to act upon
+ * or that makes its card dirty. Skip over the payload of a filler */
+static inline int young_root_word_p(lispobj** where, generation_index_t gen)
+{
+    lispobj ptr = **where;
+    int pointee_gen;
+    if (is_lisp_pointer(ptr)) {
+        page_index_t page = find_page_index((void*)ptr);
+        if (page >= 0)
+            pointee_gen = page_table[page].gen;
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+        else if (immobile_space_p(ptr)) {
+          immobile_obj:
+            pointee_gen = immobile_obj_gen_bits(base_pointer(ptr)) & 0xf;
+        }
+#endif
+        else
+            return 0;
+    }
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+    else if (instanceoid_widetag_p(ptr & WIDETAG_MASK) && ((ptr >>= 32) != 0))
+        goto immobile_obj;
+#endif
+    else {
+        if (header_widetag(ptr) == FILLER_WIDETAG) *where += ptr >> N_WIDETAG_BITS;
+        return 0;
+    }
+    return pointee_gen == from_space || pointee_gen < gen
+        || pointee_gen == (1+PSEUDO_STATIC_GENERATION);
+}
+
+/* Remembered-set mode. When 'gencgc_remembered_set' is nonzero, a dirty card
+ * of a root page on which Lisp marks the exact card it stores into (conses and
+ * large simple-vectors) and that still holds just a few old->young pointers after
+ * being scanned is given REMEMBERED_MARK, and the offsets of those pointers are
+ * saved. If Lisp doesn't store into the card before the next GC, that GC visits
+ * only the saved slots. The lists are rebuilt by every root scan in address order,
+ * so the previous lists are consumed with a cursor that moves along with the scan.
+ * Each list is a card number (counted from the start of dynamic space, which
+ * unlike the mark index does not wrap), a count, and that many word offsets */
+int gencgc_remembered_set;
+#define REMEMBERED_SLOTS_MAX (WORDS_PER_CARD/8)
+#define remset_card_number(addr) (((uword_t)(addr) - DYNAMIC_SPACE_START) >> GENCGC_CARD_SHIFT)
+static struct remembered_set {
+    uint32_t* data;
+    sword_t used, capacity;
+} remsets[2];
+static int remset_current; // lists being built by the root scan in progress
+static sword_t remset_cursor; // position in the other lists
+
+static void rotate_remembered_sets()
+{
+    remset_current ^= 1;
+    remsets[remset_current].used = 0;
+    remset_cursor = 0;
+}
+
+static uint32_t* find_remembered_card(lispobj* card_start)
+{
+    struct remembered_set* rs = &remsets[remset_current ^ 1];
+    uint32_t number = remset_card_number(card_start);
+    while (remset_cursor < rs->used && rs->data[remset_cursor] < number)
+        remset_cursor += 2 + rs->data[remset_cursor+1];
+    if (remset_cursor < rs->used && rs->data[remset_cursor] == number)
+        return rs->data + remset_cursor;
+    return 0;
+}
+
+/* Save the offsets of the young slots of the card at 'start', considering
+ * either all words below 'end' or only those in the card's previous list.
+ * Return 1 if there are few enough for the card to be REMEMBERED_MARKed */
+static int remember_card_slots(lispobj* start, lispobj* end, uint32_t* previous,
+                               generation_index_t gen)
+{
+    struct remembered_set* rs = &remsets[remset_current];
+    rs->data = grow_gc_array(rs->data, &rs->capacity, rs->used,
+                             rs->used + 2 + REMEMBERED_SLOTS_MAX, sizeof (uint32_t));
+    uint32_t* list = rs->data + rs->used;
+    int n = 0;
+    if (previous) {
+        uint32_t i;
+        for (i = 0; i < previous[1]; ++i) {
+            lispobj* where = start + previous[2+i];
+            if (young_root_word_p(&where, gen)) list[2 + n++] = previous[2+i];
+        }
+    } else {
+        lispobj* where;
+        for (where = start; where < end; ++where) {
+            lispobj* slot = where;
+            if (young_root_word_p(&where, gen)) {
+                if (n == REMEMBERED_SLOTS_MAX) return 0;
+                list[2 + n++] = slot - start;
+            }
+        }
+    }
+    if (!n) return 0;
+    list[0] = remset_card_number(start);
+    list[1] = n;
+    rs->used += 2 + n;
+    return 1;
+}
+#endif
+
 /* Large simple-vectors and pages of conses are even easier than strictly boxed root pages
  * because individual cons cells can't span cards, and vectors always mark the card of a
  * specific element. So there is no looking back 1 card to check for a marked header */
@@ -2927,8 +3621,57 @@ static page_index_t scan_boxed_root_cards_non_spanning(page_index_t page, genera
                 if (card_dirtyp(card)) {
                     lispobj* end = start + WORDS_PER_CARD;
                     if (end > limit) end = limit;
-                    int dirty = descriptors_scavenge(start, end, gen,
+                    uint32_t* previous = 0;
+                    int dirty = 0;
+                    if (gc_card_mark[card] == REMEMBERED_MARK
+                        && (previous = find_remembered_card(start)) != 0) {
+                        uint32_t k;
+                        for (k = 0; k < previous[1]; ++k) {
+                            lispobj* slot = start + previous[2+k];
+                            dirty = descriptors_scavenge(slot, slot + 1, gen, dirty);
+                        }
+                        root_vector_words_scanned += previous[1];
+                    } else {
+                        dirty = descriptors_scavenge(start, end, gen,
                                                      card_stickymarked_p(card));
+                        root_vector_words_scanned += end - start;
+                    }
+                    if (!dirty)
+                        gc_card_mark[card] = CARD_UNMARKED;
+                    else if (!card_stickymarked_p(card))
+                        gc_card_mark[card] =
+                            (gencgc_remembered_set &&
+                             remember_card_slots(start, end, previous, gen))
+                            ? REMEMBERED_MARK : CARD_MARKED;
+                }
+            }
+        }
+        ++page;
+    } while (!page_ends_contiguous_block_p(page-1, gen));
+    return page;
+#endif
+}
+
+#ifdef LISP_FEATURE_SOFT_CARD_MARKS
+/* A large hash-table k/v vector is scanned like any other large simple-vector,
+ * except that a card's pairs are checked for keys that moved, so that only
+ * the dirty cards are visited instead of the whole vector */
+static page_index_t scan_kv_vector_root_cards(page_index_t page, generation_index_t gen)
+{
+    struct vector* kv_vector = (void*)page_address(page);
+    do {
+        lispobj* start = (void*)page_address(page);
+        long card = addr_to_card_index(start);
+        if (cardseq_any_marked(card)) {
+            if (GC_LOGGING) fprintf(gc_activitylog(), "scan_roots k/v vector %p\n", page_address(page));
+            lispobj* limit = start + page_words_used(page);
+            int j;
+            for (j=0; j<CARDS_PER_PAGE; ++j, ++card, start += WORDS_PER_CARD) {
+                if (card_dirtyp(card)) {
+                    lispobj* end = start + WORDS_PER_CARD;
+                    if (end > limit) end = limit;
+                    int dirty = kv_vector_descriptors_scavenge(kv_vector, start, end, gen,
+                                                               card_stickymarked_p(card));
                     root_vector_words_scanned += end - start;
                     if (!dirty) gc_card_mark[card] = CARD_UNMARKED;
                 }
@@ -2937,8 +3680,8 @@ static page_index_t scan_boxed_root_cards_non_spanning(page_index_t page, genera
         ++page;
     } while (!page_ends_contiguous_block_p(page-1, gen));
     return page;
-#endif
 }
+#endif
 
 #ifdef LISP_FEATURE_SOFT_CARD_MARKS
 /* PAGE_TYPE_SMALL_MIXED roots are walked object-by-object to avoid affecting any raw word.
@@ -2972,6 +3715,88 @@ static page_index_t scan_mixed_root_cards(page_index_t page, generation_index_t
 }
 #endif
 
+#ifdef LISP_FEATURE_SOFT_CARD_MARKS
+/* When there are GC helper threads, the marked cards of strictly boxed root pages
+ * are first examined in parallel, and any card which holds no pointer that
+ * descriptors_scavenge() would have to act upon is unmarked, so that the serial
+ * root scan skips it. This pass only reads the heap - nothing is forwarded or
+ * enlivened - so the outcome is the same as if the serial scan had visited the card
+ * itself. Most marked cards on old pages were written with a pointer that is not
+ * young, so this offloads the bulk of the root scan when many cards are dirty. */
+static int root_card_needs_scan_p(lispobj* start, lispobj* end, generation_index_t gen)
+{
+    lispobj* where;
+    for (where = start; where < end; where++)
+        if (young_root_word_p(&where, gen)) return 1;
+    return 0;
+}
+
+struct root_card_prefilter {
+    page_index_t cursor, limit;
+    generation_index_t from;
+};
+#define ROOT_PREFILTER_CHUNK 64 /* pages */
+
+static void unstick_card_marks(__attribute__((unused)) int worker, void* arg)
+{
+    struct root_card_prefilter* state = arg;
+    page_index_t page, end;
+    while ((page = gc_claim_chunk(&state->cursor, ROOT_PREFILTER_CHUNK,
+                                  state->limit, &end)) >= 0)
+    for ( ; page < end ; ++page) {
+        long card = page_to_card_index(page);
+        int j;
+        for (j=0; j<CARDS_PER_PAGE; ++j, ++card)
+            if (gc_card_mark[card] == STICKY_MARK) gc_card_mark[card] = CARD_MARKED;
+    }
+}
+
+static void prefilter_root_cards(__attribute__((unused)) int worker, void* arg)
+{
+    struct root_card_prefilter* state = arg;
+    page_index_t page, end;
+    while ((page = gc_claim_chunk(&state->cursor, ROOT_PREFILTER_CHUNK,
+                                  state->limit, &end)) >= 0)
+    for ( ; page < end ; ++page) {
+        generation_index_t gen = page_table[page].gen;
+        if (gen < state->from || gen == SCRATCH_GENERATION
+            || !page_boxed_p(page) || !page_words_used(page))
+            continue;
+        int spanning;
+        if (page_table[page].type == PAGE_TYPE_BOXED)
+            spanning = 1;
+        else if (page_table[page].type == PAGE_TYPE_CONS)
+            spanning = 0;
+        else if (page_single_obj_p(page)) {
+            page_index_t first = find_page_index(page_scan_start(page));
+            if (!large_scannable_vector_p(first) && !large_addr_hashing_kv_vector_p(first))
+                continue;
+            spanning = 0;
+        }
+        else
+            continue;
+        long card = page_to_card_index(page);
+        if (!cardseq_any_marked(card)) continue;
+        lispobj* start = (void*)page_address(page);
+        lispobj* limit = start + page_words_used(page);
+        int j;
+        for (j=0; j<CARDS_PER_PAGE; ++j, ++card, start += WORDS_PER_CARD) {
+            if (gc_card_mark[card] != CARD_MARKED) continue; // sticky or unmarked
+            lispobj* card_end = start + WORDS_PER_CARD;
+            if (spanning) {
+                /* The serial scan looks 1 card beyond a marked card on these pages,
+                 * so that card must be clean too. If it is on the next page,
+                 * don't bother unless the contiguous block ends here */
+                if (j < CARDS_PER_PAGE-1) card_end += WORDS_PER_CARD;
+                else if (!page_ends_contiguous_block_p(page, gen)) continue;
+            }
+            if (card_end > limit) card_end = limit;
+            if (!root_card_needs_scan_p(start, card_end, gen)) gc_card_mark[card] = CARD_UNMARKED;
+        }
+    }
+}
+#endif
+
 /* Scavenge all generations greater than or equal to FROM.
  *
  * Under the current scheme when a generation is GCed, the generations
@@ -2995,6 +3820,14 @@ scavenge_root_gens(generation_index_t from)
     page_index_t limit = next_free_page;
     gc_dcheck(compacting_p());
 
+#ifdef LISP_FEATURE_SOFT_CARD_MARKS
+    rotate_remembered_sets();
+    if (gc_n_threads > 1) {
+        struct root_card_prefilter state = { 0, limit, from };
+        gc_run_on_thread_pool(prefilter_root_cards, &state);
+    }
+#endif
+
     while (i < limit) {
         generation_index_t generation = page_table[i].gen;
         if (generation < from || generation == SCRATCH_GENERATION
@@ -3016,6 +3849,8 @@ scavenge_root_gens(generation_index_t from)
 #ifdef LISP_FEATURE_SOFT_CARD_MARKS
         } else if (page_table[i].type == PAGE_TYPE_SMALL_MIXED) {
             i = scan_mixed_root_cards(i, generation);
+        } else if (page_single_obj_p(i) && large_addr_hashing_kv_vector_p(i)) {
+            i = scan_kv_vector_root_cards(i, generation);
 #endif
         } else {
             page_index_t last_page;
@@ -3114,6 +3949,9 @@ void gc_close_collector_regions()
     ensure_region_closed(mixed_region, PAGE_TYPE_MIXED);
     ensure_region_closed(small_mixed_region, PAGE_TYPE_SMALL_MIXED);
     ensure_region_closed(cons_region, PAGE_TYPE_CONS);
+    int i;
+    for (i = 0; i < N_SIZE_CLASSES; ++i)
+        ensure_region_closed(&size_class_region[i], PAGE_TYPE_SMALL_MIXED);
 }
 
 /* Do a complete scavenge of the newspace generation. */
@@ -3136,7 +3974,8 @@ scavenge_newspace(generation_index_t generation)
 
     while (1) {
         if (GC_LOGGING) fprintf(gc_activitylog(), "newspace loop\n");
-        if (!new_areas_index && !immobile_scav_queue_count) { // possible stopping point
+        if (!new_areas_index && !immobile_scav_queue_count
+            && n_inplace_marks_scanned == n_inplace_marks) { // possible stopping point
             if (!test_weak_triggers(0, 0))
                 break; // no work to do
             // testing of triggers can't detect whether any triggering object
@@ -3144,7 +3983,8 @@ scavenge_newspace(generation_index_t generation)
             // from the pending list. So check again if allocations occurred,
             // which is only if not all triggers referenced already-live objects.
             gc_close_collector_regions(); // update new_areas from regions
-            if (!new_areas_index && !immobile_scav_queue_count)
+            if (!new_areas_index && !immobile_scav_queue_count
+                && n_inplace_marks_scanned == n_inplace_marks)
                 break; // still no work to do
         }
         /* Move the current to the previous new areas */
@@ -3159,6 +3999,7 @@ scavenge_newspace(generation_index_t generation)
         new_areas_index = 0;
 
         scavenge_immobile_newspace();
+        scavenge_marked_in_place();
         /* Check whether previous_new_areas had overflowed. */
         if (previous_new_areas_index >= NUM_NEW_AREAS) {
 
@@ -3282,15 +4123,33 @@ unprotect_oldspace(void)
     }
 }
 
-/* Work through all the pages and free any in from_space. This
- * assumes that all objects have been copied or promoted to an older
- * generation. Bytes_allocated and the generation bytes_allocated
+/* If nonzero, free_oldspace() gives the memory of every run of dead large
+ * objects of at least this many bytes back to the OS straight away, instead
+ * of leaving it to be zeroed by the next allocation there or released by
+ * the next big GC. Large objects are never copied, so for huge buffers this
+ * makes their whole life cycle free of work proportional to their size,
+ * save for the OS supplying zeroed pages when the space is reused.
+ * Not with TRAVERSE_FREED_OBJECTS, which reads the freed memory. */
+os_vm_size_t gencgc_release_large_object_bytes;
+static void remap_page_range(page_index_t, page_index_t);
+static void release_dead_large_objects(page_index_t from, page_index_t to)
+{
+#ifndef TRAVERSE_FREED_OBJECTS
+    if (npage_bytes(1+to-from) >= gencgc_release_large_object_bytes)
+        remap_page_range(from, to);
+#endif
+}
+
+/* Work through all the pages and free any in from_space. This
+ * assumes that all objects have been copied or promoted to an older
+ * generation. Bytes_allocated and the generation bytes_allocated
  * counter are updated. The number of bytes freed is returned. */
 static uword_t
 free_oldspace(void)
 {
     uword_t bytes_freed = 0;
     page_index_t first_page, last_page;
+    page_index_t large_from = -1; // start of a run of large object pages
 
     first_page = 0;
 
@@ -3309,6 +4168,12 @@ free_oldspace(void)
 
         page_bytes_t last_page_bytes;
         do {
+            if (gencgc_release_large_object_bytes && page_single_obj_p(last_page)) {
+                if (large_from < 0) large_from = last_page;
+            } else if (large_from >= 0) {
+                release_dead_large_objects(large_from, last_page-1);
+                large_from = -1;
+            }
             /* Free the page. */
             last_page_bytes = page_bytes_used(last_page);
             bytes_freed += last_page_bytes;
@@ -3321,6 +4186,10 @@ free_oldspace(void)
         while ((last_page < next_free_page)
                && page_table[last_page].gen == from_space
                && page_words_used(last_page));
+        if (large_from >= 0) {
+            release_dead_large_objects(large_from, last_page-1);
+            large_from = -1;
+        }
 
         /* 'last_page' is the exclusive upper bound on the page range starting
          * at 'first'page'. We have an accurate count of the bytes in use on
@@ -3377,6 +4246,136 @@ walk_generation(uword_t (*proc)(lispobj*,lispobj*,uword_t),
     return 0;
 }
 
+#ifdef LISP_FEATURE_LINUX
+extern int perf_map_enabled;
+extern void perf_map_note_code(struct code*);
+
+/* Append every code object on code pages of 'generation' (or of all
+ * generations if negative) to the perf map. See perf_map_note_code() */
+void perf_map_note_code_pages(generation_index_t generation)
+{
+    int genmask = generation >= 0 ? 1 << generation : ~0;
+    page_index_t i, last_page;
+    for (i = 0; i < next_free_page; i = last_page + 1) {
+        last_page = i;
+        if (!page_words_used(i) || !is_code(page_table[i].type)
+            || !((1 << page_table[i].gen) & genmask))
+            continue;
+        while (!page_ends_contiguous_block_p(last_page, page_table[i].gen))
+            ++last_page;
+        lispobj* where = (lispobj*)page_address(i);
+        lispobj* limit = (lispobj*)page_address(last_page) + page_words_used(last_page);
+        for ( ; where < limit ; where += sizetab[widetag_of(where)](where))
+            if (widetag_of(where) == CODE_HEADER_WIDETAG)
+                perf_map_note_code((struct code*)where);
+    }
+}
+
+/* Code objects transported by the current GC. If there are too many
+ * to remember, all of new_space code is written out instead */
+#define PERF_MAP_MOVED_MAX 512
+static struct code* perf_map_moved[PERF_MAP_MOVED_MAX];
+static int perf_map_n_moved;
+
+void perf_map_note_moved_code(struct code* code)
+{
+    if (perf_map_n_moved < PERF_MAP_MOVED_MAX)
+        perf_map_moved[perf_map_n_moved] = code;
+    ++perf_map_n_moved;
+}
+
+static void perf_map_write_moved_code()
+{
+    if (perf_map_n_moved > PERF_MAP_MOVED_MAX)
+        perf_map_note_code_pages(new_space);
+    else {
+        int i;
+        for (i = 0; i < perf_map_n_moved; ++i)
+            perf_map_note_code(perf_map_moved[i]);
+    }
+    perf_map_n_moved = 0;
+}
+#endif
+
+/* Like walk_generation(), but divide the contiguous blocks among the GC helper
+ * threads. 'proc' must not touch anything outside the range it was given
+ * except through its argument, which is taken from 'extra' by worker index.
+ * The return value of 'proc' is ignored. */
+struct generation_walk {
+    uword_t (*proc)(lispobj*,lispobj*,uword_t);
+    int genmask;
+    uword_t* extra;
+    page_index_t cursor;
+};
+#define WALK_CHUNK 256 /* pages */
+static void walk_generation_task(int worker, void* arg)
+{
+    struct generation_walk* walk = arg;
+    page_index_t i, end;
+    while ((i = gc_claim_chunk(&walk->cursor, WALK_CHUNK, next_free_page, &end)) >= 0)
+    for ( ; i < end ; ++i) {
+        /* Each block is walked by whichever worker claimed its first page */
+        if (page_words_used(i) != 0 && ((1 << page_table[i].gen) & walk->genmask)
+            && page_starts_contiguous_block_p(i)) {
+            page_index_t last_page = i;
+            while (!page_ends_contiguous_block_p(last_page, page_table[i].gen)) ++last_page;
+            walk->proc((lispobj*)page_address(i),
+                       (lispobj*)page_address(last_page) + page_words_used(last_page),
+                       walk->extra[worker]);
+        }
+    }
+}
+void walk_generation_parallel(uword_t (*proc)(lispobj*,lispobj*,uword_t),
+                              generation_index_t generation, uword_t* extra)
+{
+    struct generation_walk walk = {
+        proc, generation >= 0 ? 1 << generation : ~0, extra, 0 };
+    gc_run_on_thread_pool(walk_generation_task, &walk);
+}
+
+/* Count the objects and words of dynamic space by widetag into 'result',
+ * an array of 256 pairs, for ROOM. Conses are counted as LIST_POINTER_LOWTAG
+ * and fillers not at all, as in MAP-ALLOCATED-OBJECTS. The blocks are divided
+ * among the GC helper threads, each of which has a tally of its own, so that
+ * a census of a large heap doesn't take one thread walking all of it.
+ * The caller must prevent GC, and the census may miss what other threads
+ * allocate during it. */
+struct heap_census_count { uword_t count, nwords; };
+static uword_t heap_census_range(lispobj* where, lispobj* limit, uword_t arg)
+{
+    struct heap_census_count* counts = (void*)arg;
+    while (where < limit) {
+        lispobj header = *where;
+        sword_t nwords = OBJECT_SIZE(header, where);
+        int type = is_header(header) ? header_widetag(header) : LIST_POINTER_LOWTAG;
+        if (type != FILLER_WIDETAG) {
+            counts[type].count++;
+            counts[type].nwords += nwords;
+        }
+        where += nwords;
+    }
+    return 0;
+}
+void heap_census(struct heap_census_count* result)
+{
+    int n_workers = gc_n_threads > 1 ? gc_n_threads : 1;
+    struct heap_census_count (*tallies)[256] = calloc(n_workers, sizeof *tallies);
+    if (!tallies) {
+        walk_generation(heap_census_range, -1, (uword_t)result);
+        return;
+    }
+    uword_t args[GC_MAX_THREADS];
+    int i, j;
+    for (i = 0; i < n_workers; ++i) args[i] = (uword_t)tallies[i];
+    walk_generation_parallel(heap_census_range, -1, args);
+    for (i = 0; i < n_workers; ++i)
+        for (j = 0; j < 256; ++j) {
+            result[j].count += tallies[i][j].count;
+            result[j].nwords += tallies[i][j].nwords;
+        }
+    free(tallies);
+}
+
 
 /* Write-protect all the dynamic boxed pages in the given generation. */
 static void
@@ -3641,10 +4640,128 @@ static void pin_call_chain_and_boxed_registers(struct thread* th) {
 #endif
 
 #if !GENCGC_IS_PRECISE
+/* With 'gencgc_incremental_stack_scan', the collector keeps a copy of each
+ * control stack as it was at the previous GC, indexed from the cold end,
+ * along with the positions in it of words that point into some heap space.
+ * The stack words preceding the first difference from the copy are exactly
+ * as seen last time, so instead of examining every one of them again, only
+ * the recorded heap pointers among them are passed to preserve_pointer().
+ * This is exact, since roots depend only on the word values: whether a
+ * word points into a heap space doesn't depend on the state of the heap.
+ * Snapshots are keyed by the stack's end address, not by thread, so a
+ * reused stack at most causes a quick mismatch.
+ * Finding the watermark still reads the unchanged words, but comparing
+ * against the copy is much cheaper than the tests in preserve_pointer() */
+int gencgc_incremental_stack_scan;
+struct stack_snapshot {
+    lispobj* stack_end;   // the key
+    uword_t* words;       // words[k] is the word at stack_end[-1-k]
+    uword_t* roots;       // increasing 'k' of words that point into a heap space
+    sword_t n_words, n_roots, words_capacity, roots_capacity;
+    int seen;             // visited by this GC
+};
+static struct stack_snapshot* stack_snapshots;
+static sword_t n_stack_snapshots, stack_snapshots_capacity;
+static struct hopscotch_table stack_snapshot_index; // stack_end -> 1 + array index
+
+static inline boolean heap_space_pointer_p(uword_t word)
+{
+    return find_page_index((void*)word) >= 0 || immobile_space_p(word)
+#ifdef LISP_FEATURE_METASPACE
+        || (word >= METASPACE_START && word < READ_ONLY_SPACE_END)
+#endif
+        ;
+}
+
+static struct stack_snapshot* find_stack_snapshot(lispobj* stack_end)
+{
+    if (!stack_snapshot_index.keys)
+        hopscotch_create(&stack_snapshot_index, HOPSCOTCH_HASH_FUN_MIX, 4, 64, 0);
+    sword_t index = hopscotch_get(&stack_snapshot_index, (uword_t)stack_end, 0) - 1;
+    if (index < 0) {
+        stack_snapshots = grow_gc_array(stack_snapshots, &stack_snapshots_capacity,
+                                        n_stack_snapshots, n_stack_snapshots + 1,
+                                        sizeof (struct stack_snapshot));
+        index = n_stack_snapshots++;
+        memset(&stack_snapshots[index], 0, sizeof (struct stack_snapshot));
+        stack_snapshots[index].stack_end = stack_end;
+        hopscotch_insert(&stack_snapshot_index, (uword_t)stack_end, index + 1);
+    }
+    return &stack_snapshots[index];
+}
+
 static void NO_SANITIZE_ADDRESS NO_SANITIZE_MEMORY
+incremental_stack_scan(struct thread* th, lispobj* esp)
+{
+    struct stack_snapshot* snap = find_stack_snapshot(th->control_stack_end);
+    lispobj* end = th->control_stack_end;
+    sword_t n_words = end - esp;
+    sword_t limit = n_words < snap->n_words ? n_words : snap->n_words;
+    sword_t k, n_unchanged = 0;
+    while (n_unchanged < limit && end[-1-n_unchanged] == snap->words[n_unchanged])
+        ++n_unchanged;
+    snap->seen = 1;
+
+    // Heap pointers in the unchanged part are the same as last time
+    sword_t n_roots = 0;
+    while (n_roots < snap->n_roots && snap->roots[n_roots] < (uword_t)n_unchanged)
+        preserve_pointer(end[-1-snap->roots[n_roots++]]);
+
+    // Scan the rest as usual, updating the snapshot as we go
+    snap->words = grow_gc_array(snap->words, &snap->words_capacity,
+                                n_unchanged, n_words, N_WORD_BYTES);
+#ifdef LISP_FEATURE_UNIX
+    lispobj exclude_from = (lispobj)th->control_stack_start;
+    lispobj exclude_to = (lispobj)th + dynamic_values_bytes;
+#define potential_heap_pointer(word) !(exclude_from <= word && word < exclude_to)
+#else
+#define potential_heap_pointer(word) 1
+#endif
+    for (k = n_unchanged; k < n_words; ++k) {
+        lispobj word = end[-1-k];
+        snap->words[k] = word;
+        if (word >= BACKEND_PAGE_BYTES && potential_heap_pointer(word)) {
+            preserve_pointer(word);
+            if (heap_space_pointer_p(word)) {
+                if (n_roots == snap->roots_capacity)
+                    snap->roots = grow_gc_array(snap->roots, &snap->roots_capacity,
+                                                n_roots, n_roots + 1, N_WORD_BYTES);
+                snap->roots[n_roots++] = k;
+            }
+        }
+    }
+#undef potential_heap_pointer
+    snap->n_words = n_words;
+    snap->n_roots = n_roots;
+}
+
+/* Drop the snapshots of stacks that no thread has any more */
+static void sweep_stack_snapshots()
+{
+    sword_t i, n = 0;
+    hopscotch_reset(&stack_snapshot_index);
+    for (i = 0; i < n_stack_snapshots; ++i) {
+        struct stack_snapshot* snap = &stack_snapshots[i];
+        if (!snap->seen) {
+            if (snap->words) os_deallocate((void*)snap->words, snap->words_capacity * N_WORD_BYTES);
+            if (snap->roots) os_deallocate((void*)snap->roots, snap->roots_capacity * N_WORD_BYTES);
+            continue;
+        }
+        snap->seen = 0;
+        if (n != i) stack_snapshots[n] = *snap;
+        hopscotch_insert(&stack_snapshot_index, (uword_t)stack_snapshots[n].stack_end, n + 1);
+        ++n;
+    }
+    n_stack_snapshots = n;
+}
+
+/* Preserve the registers in each interrupt context of 'th' and then,
+ * if 'scan_words', every word of its control stack.
+ * Return the lowest stack address that needs to be scanned */
+static lispobj* NO_SANITIZE_ADDRESS NO_SANITIZE_MEMORY
 conservative_stack_scan(struct thread* th,
                         __attribute__((unused)) generation_index_t gen,
-                        void* stack_hot_end)
+                        void* stack_hot_end, boolean scan_words)
 {
     /* there are potentially two stacks for each thread: the main
      * stack, which may contain Lisp pointers, and the alternate stack.
@@ -3712,6 +4829,11 @@ conservative_stack_scan(struct thread* th,
 # endif
     if (!esp || esp == (void*) -1)
         UNKNOWN_STACK_POINTER_ERROR("garbage_collect", th);
+    if (!scan_words) return esp;
+    if (gencgc_incremental_stack_scan) {
+        incremental_stack_scan(th, esp);
+        return esp;
+    }
 
     // Words on the stack which point into the stack are likely
     // frame pointers or alien or DX object pointers. In any case
@@ -3739,6 +4861,109 @@ conservative_stack_scan(struct thread* th,
             preserve_pointer(word);
         }
     }
+    return esp;
+#undef potential_heap_pointer
+}
+
+/* With many threads, most of the time in conservative_stack_scan() is spent
+ * rejecting words that can't be roots. That part is read-only, so several
+ * GC threads filter the stacks, each into its own buffer, and the collecting
+ * thread then calls preserve_pointer() on what passed. Interrupt contexts
+ * are few and are done up front by the collecting thread. */
+struct stack_scan_buffer { uword_t* words; sword_t count, capacity; };
+static struct stack_scan_buffer stack_scan_buffers[GC_MAX_THREADS];
+struct stack_range { struct thread* th; lispobj* start; };
+static struct stack_range* stack_ranges;
+static sword_t stack_ranges_capacity;
+struct parallel_stack_scan { struct stack_range* ranges; page_index_t cursor, limit; };
+
+static void grow_stack_scan_buffer(struct stack_scan_buffer* buffer)
+{
+    sword_t capacity = buffer->capacity ? 2 * buffer->capacity : 4096;
+    uword_t* words = (uword_t*)os_allocate(capacity * N_WORD_BYTES);
+    if (!words) lose("Can't allocate stack scan buffer");
+    if (buffer->words) {
+        memcpy(words, buffer->words, buffer->count * N_WORD_BYTES);
+        os_deallocate((void*)buffer->words, buffer->capacity * N_WORD_BYTES);
+    }
+    buffer->words = words;
+    buffer->capacity = capacity;
+}
+
+/* The tests of preserve_pointer() and conservative_root_p() that don't
+ * read the heap or modify anything */
+static inline boolean plausible_stack_root_p(uword_t word)
+{
+    page_index_t page = find_page_index((void*)word);
+    if (page < 0)
+        return immobile_space_p(word)
+#ifdef LISP_FEATURE_METASPACE
+            || (word >= METASPACE_START && word < READ_ONLY_SPACE_END)
+#endif
+            ;
+    return root_candidate_p(page)
+        && (word & (GENCGC_PAGE_BYTES - 1)) < page_bytes_used(page);
+}
+
+static void NO_SANITIZE_ADDRESS NO_SANITIZE_MEMORY
+filter_stacks(int worker, void* arg)
+{
+    struct parallel_stack_scan* state = arg;
+    struct stack_scan_buffer* buffer = &stack_scan_buffers[worker];
+    page_index_t i, end;
+    buffer->count = 0;
+    while ((i = gc_claim_chunk(&state->cursor, 1, state->limit, &end)) >= 0) {
+        struct thread* th = state->ranges[i].th;
+#ifdef LISP_FEATURE_UNIX
+        lispobj exclude_from = (lispobj)th->control_stack_start;
+        lispobj exclude_to = (lispobj)th + dynamic_values_bytes;
+#define potential_heap_pointer(word) !(exclude_from <= word && word < exclude_to)
+#else
+#define potential_heap_pointer(word) 1
+#endif
+        lispobj* ptr;
+        for (ptr = state->ranges[i].start; ptr < th->control_stack_end; ptr++) {
+            lispobj word = *ptr;
+            if (word >= BACKEND_PAGE_BYTES && potential_heap_pointer(word)
+                && plausible_stack_root_p(word)) {
+                if (buffer->count == buffer->capacity) grow_stack_scan_buffer(buffer);
+                buffer->words[buffer->count++] = word;
+            }
+        }
+#undef potential_heap_pointer
+    }
+}
+
+static void scan_explicit_pins(struct thread*);
+static void parallel_conservative_stack_scan(generation_index_t gen, void* stack_hot_end)
+{
+    struct thread* th;
+    sword_t n = 0;
+    for_each_thread(th) ++n;
+    if (n > stack_ranges_capacity) {
+        if (stack_ranges)
+            os_deallocate((void*)stack_ranges, stack_ranges_capacity * sizeof *stack_ranges);
+        stack_ranges_capacity = ALIGN_UP(n * sizeof *stack_ranges, os_reported_page_size)
+            / sizeof *stack_ranges;
+        stack_ranges = (void*)os_allocate(stack_ranges_capacity * sizeof *stack_ranges);
+        if (!stack_ranges) lose("Can't allocate stack scan ranges");
+    }
+    n = 0;
+    for_each_thread(th) {
+        if (th->state_word.state == STATE_DEAD) continue;
+        scan_explicit_pins(th);
+        stack_ranges[n].th = th;
+        stack_ranges[n].start = conservative_stack_scan(th, gen, stack_hot_end, 0);
+        ++n;
+    }
+    struct parallel_stack_scan state = { stack_ranges, 0, n };
+    gc_run_on_thread_pool(filter_stacks, &state);
+    int worker;
+    for (worker = 0; worker < gc_n_threads; ++worker) {
+        struct stack_scan_buffer* buffer = &stack_scan_buffers[worker];
+        sword_t i;
+        for (i = 0; i < buffer->count; ++i) preserve_pointer(buffer->words[i]);
+    }
 }
 #endif
 
@@ -3782,6 +5007,107 @@ __attribute__((unused)) static void check_contiguity()
 }
 
 int show_gc_generation_throughput = 0;
+/* Time spent in each phase during the current collect_garbage(),
+ * which enters it in gc_pause_histogram when done */
+static long gc_phase_nsec[GC_N_PHASES];
+static uint64_t gc_phase_start;
+static void end_gc_phase(enum gc_pause_phase phase)
+{
+    uint64_t now = gc_monotonic_nsec();
+    gc_phase_nsec[phase] += now - gc_phase_start;
+    gc_phase_start = now;
+}
+
+/* The census of survivors.
+ * While gc_census_enabled is set, each collect_garbage() counts the objects
+ * which survive it in the generations that it collects, by widetag and, for
+ * instances and funcallable instances, by layout. It costs one test per
+ * object moved when disabled, and no extra pass over the heap when enabled:
+ * objects are counted as they are transported, as large objects are moved
+ * by changing their page table entries, and as pins are processed.
+ * After a full GC this describes all of dynamic space, so taking one now and
+ * then is a cheap way to watch for leaks. Pages of code that are pinned
+ * wholesale, and mark-and-sweep collections, are not counted.
+ * Lisp reads the result out of gc_census after the GC */
+int gc_census_enabled;
+#define GC_CENSUS_LAYOUTS 4096 // must be a power of 2
+struct gc_census_count { uword_t count, nwords; };
+struct gc_census_entry { lispobj layout; struct gc_census_count total; };
+struct gc_census {
+    // Indexed by widetag, or by LIST_POINTER_LOWTAG for conses
+    struct gc_census_count by_widetag[256];
+    // An open-addressed table. An entry is in use if its layout is nonzero
+    struct gc_census_entry by_layout[GC_CENSUS_LAYOUTS];
+    int n_layouts;
+} gc_census;
+
+static struct gc_census_count* census_layout_entry(lispobj layout)
+{
+#ifdef LISP_FEATURE_64_BIT
+    unsigned int index = (unsigned int)murmur3_fmix64(layout) & (GC_CENSUS_LAYOUTS-1);
+#else
+    unsigned int index = murmur3_fmix32(layout) & (GC_CENSUS_LAYOUTS-1);
+#endif
+    for (;;) {
+        struct gc_census_entry* e = &gc_census.by_layout[index];
+        if (e->layout == layout) return &e->total;
+        if (!e->layout) {
+            // Keep the table sparse enough to probe quickly. Instances whose
+            // layouts don't fit are still counted by widetag.
+            if (gc_census.n_layouts >= GC_CENSUS_LAYOUTS*3/4) return 0;
+            ++gc_census.n_layouts;
+            e->layout = layout;
+            return &e->total;
+        }
+        index = (index + 1) & (GC_CENSUS_LAYOUTS-1);
+    }
+}
+
+void gc_census_note(lispobj obj, sword_t nwords)
+{
+    lispobj* base = native_pointer(obj);
+    int widetag = listp(obj) ? LIST_POINTER_LOWTAG : widetag_of(base);
+    gc_census.by_widetag[widetag].count++;
+    gc_census.by_widetag[widetag].nwords += nwords;
+    lispobj layout = widetag == INSTANCE_WIDETAG ? instance_layout(base)
+        : widetag == FUNCALLABLE_INSTANCE_WIDETAG ? funinstance_layout(base) : 0;
+    if (layout) {
+        struct gc_census_count* c = census_layout_entry(layout);
+        if (c) { c->count++; c->nwords += nwords; }
+    }
+}
+
+/* Layouts in dynamic space can move during the GC, so the same layout may
+ * have been entered under both its old and its new address. Merge them while
+ * the forwarding pointers are still intact */
+static void gc_census_forward_layouts()
+{
+    static struct gc_census_entry entries[GC_CENSUS_LAYOUTS];
+    int i, n = 0, n_moved = 0;
+    for (i = 0; i < GC_CENSUS_LAYOUTS; ++i) {
+        struct gc_census_entry e = gc_census.by_layout[i];
+        if (!e.layout) continue;
+        // A layout that a surviving instance uses survived too
+        if (from_space_p(e.layout) && forwarding_pointer_p(native_pointer(e.layout))) {
+            e.layout = forwarding_pointer_value(native_pointer(e.layout));
+            ++n_moved;
+        }
+        entries[n++] = e;
+    }
+    if (!n_moved) return;
+    // Rebuild the table, combining the entries for old and new addresses
+    memset(gc_census.by_layout, 0, sizeof gc_census.by_layout);
+    gc_census.n_layouts = 0;
+    for (i = 0; i < n; ++i) {
+        struct gc_census_count* c = census_layout_entry(entries[i].layout);
+        if (c) { c->count += entries[i].total.count; c->nwords += entries[i].total.nwords; }
+    }
+}
+
+static void scavenge_immutable_roots();
+extern int alloc_sampled_objects_ct;
+static void cull_alloc_sampled_objects();
+
 /* Garbage collect a generation. If raise is 0 then the remains of the
  * generation are not raised to the next generation. */
 void NO_SANITIZE_ADDRESS NO_SANITIZE_MEMORY
@@ -3792,6 +5118,7 @@ garbage_collect_generation(generation_index_t generation, int raise,
     struct thread *th;
 
     if (gencgc_verbose > 2) fprintf(stderr, "BEGIN gc_gen(%d,%d)\n", generation, raise);
+    gc_phase_start = gc_monotonic_nsec();
 
 #ifdef COLLECT_GC_STATS
     struct timespec t0;
@@ -3817,7 +5144,7 @@ garbage_collect_generation(generation_index_t generation, int raise,
          gc_assert(generations[SCRATCH_GENERATION].bytes_allocated == 0);
     }
 
-    hopscotch_reset(&pinned_objects);
+    clear_pin_bits();
 
 #ifdef LISP_FEATURE_SB_THREAD
     pin_all_dynamic_space_code = 0;
@@ -3893,6 +5220,15 @@ garbage_collect_generation(generation_index_t generation, int raise,
     /* Possibly pin stack roots and/or *PINNED-OBJECTS*, unless saving a core.
      * Scavenging (fixing up pointers) will occur later on */
 
+#if !GENCGC_IS_PRECISE || defined LISP_FEATURE_MIPS || defined LISP_FEATURE_PPC64
+    compute_root_candidate_bits();
+#endif
+
+#if !GENCGC_IS_PRECISE
+    if (conservative_stack && gc_n_threads > 1 && !gencgc_incremental_stack_scan) {
+        parallel_conservative_stack_scan(generation, approximate_stackptr);
+    } else
+#endif
     if (conservative_stack) {
         for_each_thread(th) {
             if (th->state_word.state == STATE_DEAD) continue;
@@ -3901,7 +5237,7 @@ garbage_collect_generation(generation_index_t generation, int raise,
             /* Pin everything in fromspace with a stack root, and also set the
              * sticky card mark on any page (in any generation)
              * referenced from the stack. */
-            conservative_stack_scan(th, generation, approximate_stackptr);
+            conservative_stack_scan(th, generation, approximate_stackptr, 1);
 #elif defined LISP_FEATURE_MIPS || defined LISP_FEATURE_PPC64
             // Pin code if needed
             semiconservative_pin_stack(th, generation);
@@ -3911,6 +5247,9 @@ garbage_collect_generation(generation_index_t generation, int raise,
             pin_call_chain_and_boxed_registers(th);
 #endif
         }
+#if !GENCGC_IS_PRECISE
+        if (gencgc_incremental_stack_scan) sweep_stack_snapshots();
+#endif
     }
 
     // Thread creation optionally no longer synchronizes the creating and
@@ -3966,7 +5305,7 @@ garbage_collect_generation(generation_index_t generation, int raise,
     }
 #endif
 
-    /* Remove any key from pinned_objects this does not identify an object.
+    /* Remove any ambiguous pin that does not identify an object.
      * This is done more efficiently by delaying until after all keys are
      * inserted rather than at each insertion */
     refine_ambiguous_roots();
@@ -3978,8 +5317,11 @@ garbage_collect_generation(generation_index_t generation, int raise,
      * before we start to scavenge (and thus relocate) objects,
      * relocate the pinned pages to newspace, so that the scavenger
      * will not attempt to relocate their contents. */
-    if (compacting_p())
+    if (compacting_p()) {
         move_pinned_pages_to_newspace();
+        choose_inplace_marking();
+        scavenge_immutable_roots();
+    }
 
     /* Scavenge all the rest of the roots. */
 
@@ -4043,14 +5385,21 @@ garbage_collect_generation(generation_index_t generation, int raise,
     if (!compacting_p()) {
         extern void execute_full_mark_phase();
         extern void execute_full_sweep_phase();
+        // Liveness of the sampled allocations isn't tracked across a full
+        // mark-and-sweep, which can free them in place. Forget them all.
+        alloc_sampled_objects_ct = 0;
+        end_gc_phase(GC_PHASE_ROOTS);
         execute_full_mark_phase();
+        end_gc_phase(GC_PHASE_SCAVENGE);
         execute_full_sweep_phase();
+        end_gc_phase(GC_PHASE_FREE);
         goto maybe_verify;
     }
 
     if (GC_LOGGING) fprintf(gc_activitylog(), "begin scavenge static roots\n");
     heap_scavenge((lispobj*)NIL_SYMBOL_SLOTS_START, (lispobj*)NIL_SYMBOL_SLOTS_END);
     heap_scavenge((lispobj*)STATIC_SPACE_OBJECTS_START, static_space_free_pointer);
+    walk_arenas(heap_scavenge);
 
     /* All generations but the generation being GCed need to be
      * scavenged. The new_space generation needs special handling as
@@ -4134,10 +5483,13 @@ garbage_collect_generation(generation_index_t generation, int raise,
 
     /* Finally scavenge the new_space generation. Keep going until no
      * more objects are moved into the new generation */
+    end_gc_phase(GC_PHASE_ROOTS);
     scavenge_newspace(new_space);
+    end_gc_phase(GC_PHASE_SCAVENGE);
 
     scan_binding_stack();
     smash_weak_pointers();
+    if (alloc_sampled_objects_ct) cull_alloc_sampled_objects();
 #ifdef LISP_FEATURE_METASPACE
     // *PRIMITIVE-OBJECT-LAYOUTS* (in readonly space) is a root, but it only points
     // to other objects in readonly space; however, those other objects (above
@@ -4164,7 +5516,9 @@ garbage_collect_generation(generation_index_t generation, int raise,
     /* Return private-use pages to the general pool so that Lisp can have them */
     gc_dispose_private_pages();
     cull_weak_hash_tables(weak_ht_alivep_funs);
+    end_gc_phase(GC_PHASE_WEAK);
 
+    merge_marked_in_place();
     obliterate_nonpinned_words();
     // Do this last, because until obliterate_nonpinned_words() happens,
     // not all page table entries have the 'gen' value updated,
@@ -4172,10 +5526,14 @@ garbage_collect_generation(generation_index_t generation, int raise,
     sweep_immobile_space(raise);
 
     ASSERT_REGIONS_CLOSED();
-    hopscotch_log_stats(&pinned_objects, "pins");
+    if (gc_census_enabled) gc_census_forward_layouts();
 
     /* Free the pages in oldspace, but not those marked pinned. */
     free_oldspace();
+    end_gc_phase(GC_PHASE_FREE);
+#ifdef LISP_FEATURE_LINUX
+    if (perf_map_enabled && perf_map_n_moved) perf_map_write_moved_code();
+#endif
 
     /* If the GC is not raising the age then lower the generation back
      * to its normal generation number */
@@ -4241,6 +5599,7 @@ garbage_collect_generation(generation_index_t generation, int raise,
 
     /* Reset the alloc_start_page for generation. */
     RESET_ALLOC_START_PAGES();
+    reset_numa_alloc_start_pages();
 
     /* Set the new gc trigger for the GCed generation. */
     g->gc_trigger = g->bytes_allocated + g->bytes_consed_between_gc;
@@ -4337,8 +5696,159 @@ remap_free_pages (page_index_t from, page_index_t to)
     }
 }
 
+/* Optionally, a background thread performs remap_free_pages() after a
+ * large collection instead of the collector doing it with the world stopped.
+ * The thread works on small batches of pages, each under 'free_pages_lock',
+ * so that it never races with allocation: a page that gets allocated before
+ * the thread reaches it is simply no longer free, and is skipped.
+ * It stops working while a collection is in progress. */
+int gencgc_release_in_background;
+#if defined LISP_FEATURE_SB_THREAD && !defined LISP_FEATURE_WIN32
+static pthread_mutex_t release_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t release_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t release_idle = PTHREAD_COND_INITIALIZER;
+static page_index_t release_cursor, release_limit;
+static int release_paused, release_busy;
+#define RELEASE_BATCH_PAGES 128 /* max pages to examine while holding free_pages_lock */
+
+static void* page_release_thread(__attribute__((unused)) void* arg)
+{
+    pthread_mutex_lock(&release_lock);
+    for (;;) {
+        while (release_paused || release_cursor >= release_limit)
+            pthread_cond_wait(&release_work, &release_lock);
+        page_index_t first = release_cursor;
+        page_index_t limit = release_limit;
+        if (limit - first > RELEASE_BATCH_PAGES) limit = first + RELEASE_BATCH_PAGES;
+        release_cursor = limit;
+        release_busy = 1;
+        pthread_mutex_unlock(&release_lock);
+        int __attribute__((unused)) ret = mutex_acquire(&free_pages_lock);
+        gc_assert(ret);
+        remap_free_pages(first, limit-1);
+        ret = mutex_release(&free_pages_lock);
+        gc_assert(ret);
+        pthread_mutex_lock(&release_lock);
+        release_busy = 0;
+        if (release_paused) pthread_cond_broadcast(&release_idle);
+    }
+    return 0;
+}
+
+/* Wait for the release thread to finish its current batch, and keep it idle */
+static void pause_page_release()
+{
+    if (!gencgc_release_in_background) return;
+    pthread_mutex_lock(&release_lock);
+    release_paused = 1;
+    while (release_busy) pthread_cond_wait(&release_idle, &release_lock);
+    pthread_mutex_unlock(&release_lock);
+}
+
+/* Resume, with the pages below 'limit' (re)queued if 'limit' is nonzero */
+static void resume_page_release(page_index_t limit)
+{
+    if (!gencgc_release_in_background) return;
+    pthread_mutex_lock(&release_lock);
+    if (limit) { release_cursor = 0; release_limit = limit; }
+    release_paused = 0;
+    pthread_cond_signal(&release_work);
+    pthread_mutex_unlock(&release_lock);
+}
+
+/* The child of fork() has no release thread, so do the work synchronously.
+ * The prepare handler ensures that the lock is not held mid-batch */
+static void release_atfork_prepare() { pause_page_release(); }
+static void release_atfork_parent() { resume_page_release(0); }
+static void release_atfork_child() {
+    gencgc_release_in_background = 0;
+    pthread_mutex_init(&release_lock, 0);
+    pthread_cond_init(&release_work, 0);
+    pthread_cond_init(&release_idle, 0);
+    release_paused = release_busy = 0;
+}
+
+static void start_page_release_thread()
+{
+    if (!gencgc_release_in_background) return;
+    pthread_t tid;
+    sigset_t all, old;
+    sigfillset(&all);
+    thread_sigmask(SIG_BLOCK, &all, &old);
+    if (pthread_create(&tid, 0, page_release_thread, 0)) {
+        fprintf(stderr, "WARNING: can't create page release thread\n");
+        gencgc_release_in_background = 0;
+    } else {
+        pthread_detach(tid);
+        pthread_atfork(release_atfork_prepare, release_atfork_parent, release_atfork_child);
+    }
+    thread_sigmask(SIG_SETMASK, &old, 0);
+}
+#else
+#define pause_page_release()
+#define resume_page_release(limit)
+#define start_page_release_thread() gencgc_release_in_background = 0
+#endif
+
+/* The concurrent heap verifier is in verify.inc */
+extern int gencgc_verify_concurrently;
+#if defined LISP_FEATURE_SB_THREAD && !defined LISP_FEATURE_WIN32
+static void pause_concurrent_verify(void);
+static void resume_concurrent_verify(void);
+static void start_concurrent_verify_thread(void);
+#else
+#define pause_concurrent_verify()
+#define resume_concurrent_verify()
+#define start_concurrent_verify_thread() gencgc_verify_concurrently = -1
+#endif
+
 generation_index_t small_generation_limit = 1;
 
+/* Pause-time target. If 'gencgc_pause_target_ms' is nonzero, each collection
+ * of only generation 0 is timed, and the nursery size (bytes_consed_between_gcs)
+ * and the number of GCs that generation 0 survives before promotion are steered
+ * toward keeping such pauses within the target. Minor pauses are dominated by
+ * copying the survivors, which scales with the nursery size, and by recopying
+ * objects that stay in the nursery, which earlier promotion avoids.
+ * Collections of older generations are not governed by the nursery, so they
+ * are ignored here. */
+unsigned int gencgc_pause_target_ms;
+static int max_gcs_before_promotion = -1; // as configured when first adapted
+
+static void adapt_to_pause_target(long pause_nsec, os_vm_size_t nursery_bytes,
+                                  os_vm_size_t survived_bytes)
+{
+    struct generation* nursery = &generations[0];
+    long target_nsec = (long)gencgc_pause_target_ms * 1000000;
+    os_vm_size_t min_size = 1024*1024, max_size = dynamic_space_size / 8;
+    double survival = nursery_bytes ? (double)survived_bytes / nursery_bytes : 0;
+    os_vm_size_t size = bytes_consed_between_gcs;
+
+    if (max_gcs_before_promotion < 0)
+        max_gcs_before_promotion = nursery->number_of_gcs_before_promotion;
+    if (pause_nsec > target_nsec) {
+        // Shrink in proportion to the overshoot, but by at most half
+        double scale = (double)target_nsec / pause_nsec;
+        size = (os_vm_size_t)(size * (scale < 0.5 ? 0.5 : scale * 0.9));
+        // A lot of survivors favors moving them out of the nursery sooner
+        if (survival > 0.1 && nursery->number_of_gcs_before_promotion > 0)
+            --nursery->number_of_gcs_before_promotion;
+    } else if (pause_nsec < target_nsec / 2) {
+        size += size / 4;
+        if (survival < 0.05
+            && nursery->number_of_gcs_before_promotion < max_gcs_before_promotion)
+            ++nursery->number_of_gcs_before_promotion;
+    }
+    if (size < min_size) size = min_size;
+    if (size > max_size) size = max_size;
+    if (gencgc_verbose)
+        fprintf(stderr, "GC pause %ld.%03ldms, survival %.1f%%: nursery = %"OS_VM_SIZE_FMT
+                " bytes, promotion after %d GCs\n",
+                pause_nsec / 1000000, (pause_nsec / 1000) % 1000, survival * 100,
+                (uintptr_t)size, nursery->number_of_gcs_before_promotion);
+    bytes_consed_between_gcs = size;
+}
+
 // one pair of counters per widetag, though we're only tracking code as yet
 int n_scav_calls[64], n_scav_skipped[64];
 extern int finalizer_thread_runflag;
@@ -4352,6 +5862,174 @@ extern int finalizer_thread_runflag;
 #define main_thread_boxed_region (2+main_thread_mixed_region)
 #endif
 
+#ifdef THREAD_PAGE_CACHE_SIZE
+/* Opening a TLAB region normally takes 'free_pages_lock' to search the
+ * page table, and closing the previous region takes it to update the PTEs.
+ * To take the lock less often, each thread claims free pages a few at a time
+ * for its mixed TLAB and for its cons TLAB. A claimed page is marked as an
+ * open region page of generation 0, so neither the page table search nor any
+ * other thread will touch it. While the thread has claimed pages left, a
+ * refill opens the new region on the next one, and if the previous region
+ * was also on a claimed page, merely remembers it as retired.
+ * Retired regions are closed and the cache is refilled the next time the
+ * thread has to take the lock. At the start of GC, at thread exit, and
+ * before walking the heap, the retired regions are closed and the unused
+ * claimed pages are freed, so the collector never sees a cache.
+ * Until a retired region is closed, its bytes are not in 'bytes_allocated',
+ * which delays the GC trigger by at most THREAD_PAGE_CACHE_SIZE pages per
+ * thread. Mutators only ever open these regions on free pages, so they
+ * no longer fill in the tails of partially used pages.
+ * A refill claims one page after a GC, then twice as many as the time
+ * before, up to THREAD_PAGE_CACHE_SIZE. So a thread never has many more
+ * pages claimed but unused than it has used since the GC, and with
+ * thousands of mostly idle threads, the memory held in caches grows with
+ * the number of threads that allocate a lot, rather than the number of
+ * threads. */
+static inline struct thread_page_cache*
+tlab_page_cache(struct thread* th, struct alloc_region* region)
+{
+    if (region == &th->mixed_tlab) return &thread_extra_data(th)->page_cache[0];
+    if (region == &th->cons_tlab) return &thread_extra_data(th)->page_cache[1];
+    return 0;
+}
+
+/* Caller must hold 'free_pages_lock' or have stopped the world */
+static void close_retired_regions(struct thread_page_cache* cache, int page_type)
+{
+    int i;
+    for (i = 0; i < cache->n_retired; ++i)
+        gc_close_region(&cache->retired[i], page_type);
+    cache->n_retired = 0;
+}
+
+/* Caller must hold 'free_pages_lock' or have stopped the world */
+static void release_page_caches(struct thread* th)
+{
+    int i, j;
+    for (i = 0; i < 2; ++i) {
+        struct thread_page_cache* cache = &thread_extra_data(th)->page_cache[i];
+        close_retired_regions(cache, i ? PAGE_TYPE_CONS : PAGE_TYPE_MIXED);
+        for (j = 0; j < cache->n_free; ++j) reset_page_flags(cache->free_pages[j]);
+        cache->n_free = 0;
+        cache->depth_shift = 0;
+    }
+}
+
+/* Close 'region' and any retired regions, and claim enough free pages to
+ * fill the cache. Return the number of claimed pages now in the cache.
+ * Caller must hold 'free_pages_lock' */
+static int refill_page_cache(struct thread_page_cache* cache,
+                             struct alloc_region* region, int page_type)
+{
+    ensure_region_closed(region, page_type);
+    cache->region_from_cache = 0;
+    close_retired_regions(cache, page_type);
+    int numa_node = gencgc_numa_nodes ? current_numa_node() : -1;
+    page_index_t page =
+        numa_node >= 0 ? numa_alloc_start_pages[numa_node] : alloc_start_page(page_type, 0);
+    page_index_t claimed[THREAD_PAGE_CACHE_SIZE];
+    int n = 0, i, depth = 1 << cache->depth_shift;
+    if (depth < THREAD_PAGE_CACHE_SIZE) ++cache->depth_shift;
+    for ( ; page < page_table_pages && cache->n_free + n < depth ; ++page)
+        if (page_free_p(page)) claimed[n++] = page;
+    if (!n) return cache->n_free;
+    if (numa_node >= 0)
+        numa_alloc_start_pages[numa_node] = claimed[n-1];
+    else
+        set_alloc_start_page(page_type, 0, claimed[n-1]);
+    if (claimed[n-1]+1 > next_free_page) next_free_page = claimed[n-1]+1;
+    // Push in reverse so that the lowest page is used first
+    for (i = n-1; i >= 0; --i) {
+        page = claimed[i];
+        cache->free_pages[cache->n_free] = page;
+        cache->need_zero[cache->n_free] = page_need_to_zero(page) || deferred_zero_p(page);
+        ++cache->n_free;
+        clear_deferred_zero(page);
+        set_page_need_to_zero(page, 1);
+        page_size_class[page] = 0;
+        if (gc_object_start_bits) note_region_object_starts(page, page, region);
+        page_table[page].gen = 0;
+        page_table[page].type = OPEN_REGION_PAGE_FLAG | page_type;
+    }
+    return cache->n_free;
+}
+
+/* Open 'region' on a claimed page, retiring the region if it is open.
+ * This needs no lock, since nothing else touches claimed pages. */
+static void* open_region_from_cache(struct thread_page_cache* cache,
+                                    struct alloc_region* region, int page_type)
+{
+    if (!region_closed_p(region)) {
+        gc_assert(cache->region_from_cache && cache->n_retired < THREAD_PAGE_CACHE_SIZE);
+        cache->retired[cache->n_retired++] = *region;
+    }
+    int i = --cache->n_free;
+    page_index_t page = cache->free_pages[i];
+    char* base = page_address(page);
+    if (page_type == PAGE_TYPE_CONS) {
+        if (cache->need_zero[i]) // Zero the trailing data (the cons cell mark bits)
+            memset(base + CONS_PAGE_USABLE_BYTES, 0, GENCGC_PAGE_BYTES - CONS_PAGE_USABLE_BYTES);
+        region->end_addr = base + CONS_PAGE_USABLE_BYTES;
+    } else {
+        if (cache->need_zero[i]) zero_pages(page, page);
+        region->end_addr = base + GENCGC_PAGE_BYTES;
+    }
+    region->start_addr = region->free_pointer = base;
+    cache->region_from_cache = 1;
+    return base;
+}
+#endif
+
+/* Soft heap limit. A container can kill the process for exceeding its memory
+ * limit long before dynamic space is full. So as the bytes in use approach
+ * 'gencgc_soft_heap_limit' (0 meaning none), collections are triggered sooner.
+ * A collection that starts above the limit goes through the oldest generation.
+ * While usage stays near the limit, free pages go back to the OS after every
+ * collection, and 'gc_memory_pressure' tells Lisp to run
+ * SB-EXT:*MEMORY-PRESSURE-HOOKS* so that caches can shed entries. Unless
+ * --soft-heap-limit sets it, the limit is 3/4 of the cgroup v2 "memory.max" of
+ * the process on Linux, leaving the rest to everything besides dynamic space */
+os_vm_size_t gencgc_soft_heap_limit;
+int gc_memory_pressure;
+#define soft_limit_approached(bytes) \
+    (gencgc_soft_heap_limit && (bytes) >= gencgc_soft_heap_limit / 8 * 7)
+
+#ifdef LISP_FEATURE_LINUX
+static os_vm_size_t read_memory_max(char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+    char buf[32];
+    os_vm_size_t limit = 0;
+    // The file holds "max" when there is no limit
+    if (fgets(buf, sizeof buf, f) && strncmp(buf, "max", 3))
+        limit = strtoull(buf, 0, 10);
+    fclose(f);
+    return limit;
+}
+
+/* Return the "memory.max" of the cgroup of this process, or 0 if none */
+static os_vm_size_t cgroup_memory_max()
+{
+    char line[512], path[600];
+    os_vm_size_t limit = 0;
+    // The cgroup v2 hierarchy is the one on the line "0::<path>"
+    FILE* f = fopen("/proc/self/cgroup", "r");
+    if (f) {
+        while (fgets(line, sizeof line, f))
+            if (!strncmp(line, "0::", 3)) {
+                line[strcspn(line, "\n")] = 0;
+                snprintf(path, sizeof path, "/sys/fs/cgroup%s/memory.max", line + 3);
+                limit = read_memory_max(path);
+                break;
+            }
+        fclose(f);
+    }
+    // Inside a cgroup namespace, the mounted hierarchy may start at our own group
+    return limit ? limit : read_memory_max("/sys/fs/cgroup/memory.max");
+}
+#endif
+
 /* GC all generations newer than last_gen, raising the objects in each
  * to the next older generation - we finish when all generations below
  * last_gen are empty.  Then if last_gen is due for a GC, or if
@@ -4373,14 +6051,23 @@ collect_garbage(generation_index_t last_gen)
     /* The largest value of next_free_page seen since the time
      * remap_free_pages was called. */
     static page_index_t high_water_mark = 0;
+    /* What was left after the last collection forced by the soft limit */
+    static os_vm_size_t bytes_after_soft_limit_gc = 0;
+    boolean soft_limit_gc = 0;
+    os_vm_size_t nursery_bytes = 0, bytes_before_gc = 0;
 
+    uint64_t gc_start_nsec = gencgc_pause_target_ms ? gc_monotonic_nsec() : 0;
 #ifdef COLLECT_GC_STATS
     struct timespec t_gc_start;
     clock_gettime(CLOCK_MONOTONIC, &t_gc_start);
 #endif
     log_generation_stats(gc_logfile, "=== GC Start ===");
 
+    pause_page_release();
+    pause_concurrent_verify();
     gc_active_p = 1;
+    memset(gc_phase_nsec, 0, sizeof gc_phase_nsec);
+    if (gc_census_enabled) memset(&gc_census, 0, sizeof gc_census);
 
     if (last_gen == 1+PSEUDO_STATIC_GENERATION) {
         // Pseudostatic space undergoes a non-moving collection
@@ -4408,9 +6095,18 @@ collect_garbage(generation_index_t last_gen)
     for_each_thread(th) {
         ensure_region_closed(THREAD_ALLOC_REGION(th,mixed), PAGE_TYPE_MIXED);
         ensure_region_closed(THREAD_ALLOC_REGION(th,cons), PAGE_TYPE_CONS);
+#ifdef THREAD_PAGE_CACHE_SIZE
+        release_page_caches(th);
+#endif
+#ifdef LISP_FEATURE_SB_THREAD
+        thread_extra_data(th)->code_chunk_free = thread_extra_data(th)->code_chunk_end = 0;
+#endif
     }
     gc_close_collector_regions();
+    for (i = 0; i < N_ALLOCATION_SHARDS; ++i) flush_allocation_shard(i);
     if (gencgc_verbose > 2) fprintf(stderr, "[%d] BEGIN gc(%d)\n", n_gcs, last_gen);
+    nursery_bytes = generations[0].bytes_allocated;
+    bytes_before_gc = bytes_allocated;
 
     /* Immobile space generation bits are lazily updated for gen0
        (not touched on every object allocation) so do it now */
@@ -4428,6 +6124,15 @@ collect_garbage(generation_index_t last_gen)
         goto finish;
     }
 
+    /* Above the soft limit, go through the oldest generation, unless the last
+     * time that was done it didn't help and not much has been consed since */
+    if (gencgc_soft_heap_limit && bytes_allocated >= gencgc_soft_heap_limit
+        && bytes_allocated >= bytes_after_soft_limit_gc + bytes_consed_between_gcs
+        && last_gen < gencgc_oldest_gen_to_gc) {
+        last_gen = gencgc_oldest_gen_to_gc;
+        soft_limit_gc = 1;
+    }
+
     do {
         /* Collect the generation. */
 
@@ -4511,13 +6216,8 @@ collect_garbage(generation_index_t last_gen)
 #ifdef LISP_FEATURE_SOFT_CARD_MARKS
     {
     // Turn sticky cards marks to the regular mark.
-    page_index_t page;
-    for (page=0; page<next_free_page; ++page) {
-        long card = page_to_card_index(page);
-        int j;
-        for (j=0; j<CARDS_PER_PAGE; ++j, ++card)
-            if (gc_card_mark[card] == STICKY_MARK) gc_card_mark[card] = CARD_MARKED;
-    }
+    struct root_card_prefilter state = { 0, next_free_page, 0 };
+    gc_run_on_thread_pool(unstick_card_marks, &state);
     }
 #endif
 
@@ -4533,12 +6233,30 @@ collect_garbage(generation_index_t last_gen)
 
     next_free_page = find_next_free_page();
 
+    // 'gen' is now the number of generations collected
+    if (gencgc_pause_target_ms && gc_start_nsec && gen == 1) {
+        long nsec = gc_monotonic_nsec() - gc_start_nsec;
+        os_vm_size_t freed = bytes_before_gc - bytes_allocated;
+        adapt_to_pause_target(nsec, nursery_bytes,
+                              nursery_bytes > freed ? nursery_bytes - freed : 0);
+    }
+
     /* Update auto_gc_trigger. Make sure we trigger the next GC before
      * running out of heap! */
     if (bytes_consed_between_gcs <= (dynamic_space_size - bytes_allocated))
         auto_gc_trigger = bytes_allocated + bytes_consed_between_gcs;
     else
         auto_gc_trigger = bytes_allocated + (dynamic_space_size - bytes_allocated)/2;
+    /* Near the soft limit, trigger at the latest halfway to it, but not so
+     * soon that collections come back to back */
+    if (gencgc_soft_heap_limit && auto_gc_trigger > gencgc_soft_heap_limit) {
+        os_vm_size_t step = gencgc_soft_heap_limit > bytes_allocated
+            ? (gencgc_soft_heap_limit - bytes_allocated) / 2 : 0;
+        if (step < bytes_consed_between_gcs / 8) step = bytes_consed_between_gcs / 8;
+        if (bytes_allocated + step < auto_gc_trigger) auto_gc_trigger = bytes_allocated + step;
+    }
+    if (soft_limit_gc) bytes_after_soft_limit_gc = bytes_allocated;
+    gc_memory_pressure = soft_limit_approached(bytes_allocated);
 
     if(gencgc_verbose) {
 #define MESSAGE ("Next gc when %"OS_VM_SIZE_FMT" bytes have been consed\n")
@@ -4551,20 +6269,35 @@ collect_garbage(generation_index_t last_gen)
 #undef MESSAGE
     }
 
-    /* If we did a big GC (arbitrarily defined as gen > 1), release memory
-     * back to the OS.
+    /* If we did a big GC (arbitrarily defined as gen > 1), or are near the
+     * soft limit, release memory back to the OS.
      */
-    if (gen > small_generation_limit) {
+    if (gen > small_generation_limit || gc_memory_pressure) {
         if (next_free_page > high_water_mark)
             high_water_mark = next_free_page;
-        remap_free_pages(0, high_water_mark);
+        if (gencgc_release_in_background)
+            resume_page_release(high_water_mark);
+        else
+            remap_free_pages(0, high_water_mark);
         high_water_mark = 0;
     }
 
+    /* Index the free space for the next large allocations, if there
+     * were any since the last GC. Otherwise it's not worth the pass */
+    if (large_allocation >= LARGE_OBJECT_SIZE) rebuild_free_extents();
+
     large_allocation = 0;
  finish:
     write_protect_immobile_space();
+    extern void df_cache_invalidate(void);
+    df_cache_invalidate(); // code may have moved
     gc_active_p = 0;
+    resume_page_release(0);
+    resume_concurrent_verify();
+    gc_record_pause(GC_PHASE_ROOTS, gc_phase_nsec[GC_PHASE_ROOTS]);
+    gc_record_pause(GC_PHASE_SCAVENGE, gc_phase_nsec[GC_PHASE_SCAVENGE]);
+    gc_record_pause(GC_PHASE_WEAK, gc_phase_nsec[GC_PHASE_WEAK]);
+    gc_record_pause(GC_PHASE_FREE, gc_phase_nsec[GC_PHASE_FREE]);
 
     if (gc_object_watcher) {
         extern void gc_prove_liveness(void(*)(), lispobj, int, uword_t*, int);
@@ -4578,6 +6311,15 @@ collect_garbage(generation_index_t last_gen)
 #endif
     }
 
+    if (gc_heap_dump_pathname) {
+        extern void gc_write_heap_dump(void(*)(), char*);
+#ifdef LISP_FEATURE_C_STACK_IS_CONTROL_STACK
+        gc_write_heap_dump(preserve_context_registers, gc_heap_dump_pathname);
+#else
+        gc_write_heap_dump(0, gc_heap_dump_pathname);
+#endif
+    }
+
 #ifdef COLLECT_GC_STATS
     struct timespec t_gc_done;
     clock_gettime(CLOCK_MONOTONIC, &t_gc_done);
@@ -4614,6 +6356,9 @@ gc_init(void)
     extern void safepoint_init(void);
     safepoint_init();
 #endif
+    gc_start_worker_threads();
+    start_page_release_thread();
+    start_concurrent_verify_thread();
 }
 
 int gc_card_table_nbits;
@@ -4633,13 +6378,14 @@ static void __attribute__((unused)) gcbarrier_patch_code_range(uword_t start, vo
             skip_data_stream(&unpacker);
             skip_data_stream(&unpacker);
             char* instructions = code_text_start(code);
-            int prev_loc = 0, loc;
-            while (varint_unpack(&unpacker, &loc) && loc != 0) {
-                loc += prev_loc;
-                prev_loc = loc;
-                void* patch_where = instructions + loc;
-                gcbarrier_patch_code(patch_where, gc_card_table_nbits);
-            }
+            int loc = 0, deltas[VARINT_STREAM_BATCH], n, i;
+            do {
+                n = varint_unpack_stream(&unpacker, deltas, VARINT_STREAM_BATCH);
+                for (i = 0; i < n; ++i) {
+                    loc += deltas[i];
+                    gcbarrier_patch_code(instructions + loc, gc_card_table_nbits);
+                }
+            } while (n == VARINT_STREAM_BATCH);
         }
         where += OBJECT_SIZE(*where, where);
     }
@@ -4658,6 +6404,10 @@ void gc_allocate_ptes()
     bytes_consed_between_gcs = dynamic_space_size/(os_vm_size_t)20;
     if (bytes_consed_between_gcs < (1024*1024))
         bytes_consed_between_gcs = 1024*1024;
+#ifdef LISP_FEATURE_LINUX
+    if (!gencgc_soft_heap_limit)
+        gencgc_soft_heap_limit = cgroup_memory_max() / 4 * 3;
+#endif
 
     /* The page_table is allocated using "calloc" to zero-initialize it.
      * The C library typically implements this efficiently with mmap() if the
@@ -4675,6 +6425,34 @@ void gc_allocate_ptes()
      */
     page_table = calloc(1+page_table_pages, sizeof(struct page));
     gc_assert(page_table);
+    /* Release only whole huge pages to the OS. Anything less would fragment
+     * a huge page for the sake of returning a few small pages */
+    if (gencgc_huge_pages && gencgc_release_granularity < HUGE_PAGE_BYTES)
+        gencgc_release_granularity = HUGE_PAGE_BYTES;
+    numa_init();
+    page_size_class = calloc(1+page_table_pages, 1);
+    gc_assert(page_size_class);
+    object_starts_valid_bits = calloc(ALIGN_UP(1+page_table_pages, N_WORD_BITS)/N_WORD_BITS,
+                                      sizeof (uword_t));
+    gc_assert(object_starts_valid_bits);
+    gc_pin_bits = (uword_t*)os_allocate(page_table_pages * START_BITS_PER_PAGE / 8);
+    if (!gc_pin_bits) lose("Can't allocate pin bitmap");
+    if (gencgc_object_start_bitmap) {
+        // os_allocate() memory is zero-filled and committed only as touched
+        gc_object_start_bits = (uword_t*)os_allocate(page_table_pages * START_BITS_PER_PAGE / 8);
+        if (!gc_object_start_bits) lose("Can't allocate object start bitmap");
+    }
+    deferred_zero_bits = calloc(ALIGN_UP(1+page_table_pages, N_WORD_BITS)/N_WORD_BITS,
+                                sizeof (uword_t));
+    gc_assert(deferred_zero_bits);
+    root_candidate_bits = calloc(ALIGN_UP(1+page_table_pages, N_WORD_BITS)/N_WORD_BITS,
+                                 sizeof (uword_t));
+    gc_assert(root_candidate_bits);
+    // Runs are separated by at least one used page
+    n_free_extent_slots = page_table_pages / (FREE_EXTENT_MIN_PAGES + 1) + 1;
+    free_extents = calloc(n_free_extent_slots, sizeof (struct free_extent));
+    gc_assert(free_extents);
+    reset_free_extents();
 
     // The card table size is a power of 2 at *least* as large
     // as the number of cards. These are the default values.
@@ -4687,15 +6465,18 @@ void gc_allocate_ptes()
     // 2 Gigacards should suffice for now. That would span 2TiB of memory
     // using 1Kb card size, or more if larger card size.
     gc_assert(nbits < 32);
-    // If the space size is less than or equal to the number of cards
-    // that 'gc_card_table_nbits' cover, we're fine. Otherwise, problem.
-    // 'nbits' is what we need, 'gc_card_table_nbits' is what the core was compiled for.
-    if (nbits > gc_card_table_nbits) {
+    // 'nbits' is what the space size calls for, 'gc_card_table_nbits' is what the
+    // core was compiled or last saved for. Too few bits would alias distinct cards
+    // onto one mark, and too many would spread the marks of a small heap thinly
+    // over a table larger than it needs, so the table is always sized to fit.
+    if (nbits != gc_card_table_nbits) {
         gc_card_table_nbits = nbits;
 #if defined LISP_FEATURE_MIPS || defined LISP_FEATURE_PPC64 \
   || defined LISP_FEATURE_X86 || defined LISP_FEATURE_X86_64
-        // The value needed based on dynamic space size exceeds the value that the
-        // core was compiled for, so we need to patch all code blobs.
+        // The mask is an immediate operand in the barrier of these backends,
+        // so we need to patch all code blobs. Code loaded later is fixed up with
+        // the current value (see :GC-BARRIER in target-core), and the others
+        // load 'gc_card_table_mask' from memory.
         gcbarrier_patch_code_range(READ_ONLY_SPACE_START, read_only_space_free_pointer);
         gcbarrier_patch_code_range(STATIC_SPACE_START, static_space_free_pointer);
         gcbarrier_patch_code_range(DYNAMIC_SPACE_START, (lispobj*)dynamic_space_highwatermark());
@@ -4704,9 +6485,7 @@ void gc_allocate_ptes()
 #endif
 #endif
     }
-    // Regardless of the mask implied by space size, it has to be gc_card_table_nbits wide
-    // even if that is excessive - when the core is restarted using a _smaller_ dynamic space
-    // size than saved at - otherwise lisp could overrun the mark table.
+    // Every barrier now agrees with 'gc_card_table_nbits'
     num_gc_cards = 1L << gc_card_table_nbits;
 
     gc_card_table_mask =  num_gc_cards - 1;
@@ -4718,8 +6497,6 @@ void gc_allocate_ptes()
     memset(gc_card_mark, CARD_MARKED, num_gc_cards);
 
     gc_common_init();
-    hopscotch_create(&pinned_objects, HOPSCOTCH_HASH_FUN_DEFAULT, 0 /* hashset */,
-                     32 /* logical bin count */, 0 /* default range */);
 
     bytes_allocated = 0;
 
@@ -4760,6 +6537,316 @@ void gc_allocate_ptes()
  * region is full, so in most cases it's not needed. */
 
 int gencgc_alloc_profiler;
+
+/* If gencgc_alloc_sample_bytes is 0, the allocation profiler records a trace
+ * at each call to lisp_alloc(), which is mostly once per refilled region.
+ * Otherwise it samples the allocated bytes at random, once per that many
+ * bytes on average: the distance to the next sample is drawn from an
+ * exponential distribution, and a refill counts the entire new region as
+ * allocated by the caller that needed it. One allocation can use up several
+ * samples, which is recorded as the weight of its trace, so that each sample
+ * stands for the same number of bytes no matter how big the regions and
+ * objects are.
+ *
+ * The object allocated at each sample is remembered along with the hash of
+ * its trace. Garbage collection forgets the objects that die and updates the
+ * ones that move, so the entries that have survived a GC describe the live
+ * data by allocation site */
+uword_t gencgc_alloc_sample_bytes;
+struct alloc_sampled_object {
+    lispobj* base;
+    uint32_t trace_hash;
+    uint16_t weight; // number of samples
+    uint16_t n_gcs;  // number of GCs survived
+};
+#define MAX_ALLOC_SAMPLED_OBJECTS 65536
+struct alloc_sampled_object alloc_sampled_objects[MAX_ALLOC_SAMPLED_OBJECTS];
+int alloc_sampled_objects_ct;
+
+static sword_t next_alloc_sample_distance(struct extra_thread_data* ed, uword_t mean)
+{
+    // xorshift64*, seeded from the thread's address
+    uint64_t x = ed->alloc_sample_rng;
+    if (!x) x = (uword_t)ed ^ 0x9E3779B97F4A7C15ULL;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    ed->alloc_sample_rng = x;
+    // a uniform deviate in (0,1]
+    double u = (double)(((x * 0x2545F4914F6CDD1DULL) >> 11) + 1) / 9007199254740992.0;
+    double distance = -log(u) * (double)mean;
+    if (distance < 1.0) return 1;
+    if (distance > (double)((uword_t)1 << (N_WORD_BITS-2))) return (sword_t)1 << (N_WORD_BITS-2);
+    return (sword_t)distance;
+}
+
+/* Charge 'nbytes' to 'thread' and return how many samples they contain */
+static int alloc_samples_due(struct thread* thread, sword_t nbytes)
+{
+    struct extra_thread_data* ed = thread_extra_data(thread);
+    uword_t mean = gencgc_alloc_sample_bytes;
+    if (ed->alloc_sample_mean != mean) { // first time, or a new mean
+        ed->alloc_sample_mean = mean;
+        ed->alloc_sample_countdown = next_alloc_sample_distance(ed, mean);
+    }
+    int n = 0;
+    ed->alloc_sample_countdown -= nbytes;
+    while (ed->alloc_sample_countdown <= 0) {
+        ++n;
+        ed->alloc_sample_countdown += next_alloc_sample_distance(ed, mean);
+    }
+    return n;
+}
+
+static void note_alloc_sampled_object(void* obj, int weight, uint32_t trace_hash)
+{
+    if (!trace_hash) return; // the trace was not recorded
+    int index;
+    do {
+        index = alloc_sampled_objects_ct;
+        if (index >= MAX_ALLOC_SAMPLED_OBJECTS) return;
+    } while (!__sync_bool_compare_and_swap(&alloc_sampled_objects_ct, index, index+1));
+    struct alloc_sampled_object* s = &alloc_sampled_objects[index];
+    s->trace_hash = trace_hash;
+    s->weight = weight > 0xffff ? 0xffff : weight;
+    s->n_gcs = 0;
+    s->base = obj;
+}
+
+/* Drop the sampled objects which did not survive this GC, and update the
+ * addresses of those which moved. Called with the world stopped, after the
+ * liveness of everything in from_space is known */
+static void cull_alloc_sampled_objects()
+{
+    int n = alloc_sampled_objects_ct, i, kept = 0;
+    for (i = 0; i < n; ++i) {
+        struct alloc_sampled_object s = alloc_sampled_objects[i];
+        page_index_t page = find_page_index(s.base);
+        if (page >= 0 && page_table[page].gen == from_space) {
+            if (forwarding_pointer_p(s.base))
+                s.base = native_pointer(forwarding_pointer_value(s.base));
+            else if (!pinned_p(compute_lispobj(s.base), page))
+                continue; // dead
+        }
+        if (s.n_gcs < 0xffff) ++s.n_gcs;
+        alloc_sampled_objects[kept++] = s;
+    }
+    alloc_sampled_objects_ct = kept;
+}
+
+/* Arenas
+ *
+ * An arena is memory outside of the dynamic space from which a thread's
+ * mixed and cons TLABs get their regions while the thread is switched to it,
+ * so that what it allocates in the meantime is freed all at once when the
+ * arena is destroyed, without being collected. Nothing keeps track of
+ * pointers into an arena: the contract is that none survive its destruction.
+ * The GC treats the contents of every arena like static space, scavenging
+ * them as roots and never moving or freeing them. With DEBUG, the memory of
+ * a destroyed arena is protected instead of unmapped, so that dereferencing a
+ * dangling pointer faults, and the heap verifier reports pointers into it.
+ *
+ * Arenas and their blocks are created and destroyed, and regions carved out of
+ * the blocks and closed, holding 'free_pages_lock' or with the world stopped */
+struct arena_block {
+    struct arena_block* next;
+    lispobj *start, *free_pointer, *end;
+};
+struct arena {
+    struct arena* next;
+    struct arena_block* blocks; // newest first
+    uword_t block_size;
+    int n_users; // dynamic extents of WITH-ARENA in effect for it
+};
+static struct arena* all_arenas;
+#ifdef DEBUG
+static struct arena* destroyed_arenas;
+#endif
+/* Regions are carved out of an arena block in chunks of this many bytes, or
+ * however many are left in the block */
+#define ARENA_CHUNK_BYTES GENCGC_PAGE_BYTES
+
+static struct arena_block* arena_block_of(struct arena* list, void* addr)
+{
+    struct arena* arena;
+    struct arena_block* block;
+    for (arena = list ; arena ; arena = arena->next)
+        for (block = arena->blocks ; block ; block = block->next)
+            if ((lispobj*)addr >= block->start && (lispobj*)addr < block->end)
+                return block;
+    return 0;
+}
+
+/* Give back to the block what 'region' did not use if nothing was carved out
+ * after it, else fill the rest of it so that the block stays walkable */
+static void arena_close_region(struct alloc_region* region)
+{
+    struct arena_block* block = arena_block_of(all_arenas, region->start_addr);
+    gc_assert(block);
+    lispobj* free_pointer = region->free_pointer;
+    if ((lispobj*)region->end_addr == block->free_pointer)
+        block->free_pointer = free_pointer;
+    else if ((lispobj*)region->end_addr > free_pointer) {
+        sword_t nwords = (lispobj*)region->end_addr - free_pointer;
+        *free_pointer = (nwords - 1) << N_WIDETAG_BITS | FILLER_WIDETAG;
+    }
+    gc_set_region_empty(region);
+}
+
+/* Return 'nbytes' of arena memory, and unless 'largep' make 'region' the rest
+ * of a new chunk. Caller must hold 'free_pages_lock' */
+static lispobj* arena_alloc(struct arena* arena, int largep, struct alloc_region* region,
+                            sword_t nbytes, int page_type)
+{
+    ensure_region_closed(region, page_type);
+    struct arena_block* block = arena->blocks;
+    if (!block || (char*)block->end - (char*)block->free_pointer < nbytes) {
+        uword_t size = ALIGN_UP(nbytes, os_vm_page_size);
+        if (size < arena->block_size) size = arena->block_size;
+        block = calloc(1, sizeof (struct arena_block));
+        if (!block) lose("arena_alloc: can't allocate a block header");
+        block->start = block->free_pointer = (lispobj*)os_allocate(size);
+        if (!block->start) lose("arena_alloc: can't allocate %"OBJ_FMTX" bytes", size);
+        block->end = (lispobj*)((char*)block->start + size);
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    lispobj* new_obj = block->free_pointer;
+    if (largep) {
+        block->free_pointer = (lispobj*)((char*)new_obj + nbytes);
+        return new_obj;
+    }
+    sword_t chunk = nbytes > ARENA_CHUNK_BYTES ? nbytes : ARENA_CHUNK_BYTES;
+    if (chunk > (char*)block->end - (char*)new_obj)
+        chunk = (char*)block->end - (char*)new_obj;
+    block->free_pointer = (lispobj*)((char*)new_obj + chunk);
+    region->start_addr = new_obj;
+    region->free_pointer = (char*)new_obj + nbytes;
+    region->end_addr = block->free_pointer;
+    return new_obj;
+}
+
+/* Create an arena whose blocks are 'block_size' bytes, or as many as the
+ * largest object in them needs. The memory is mapped on first use */
+struct arena* arena_create(uword_t block_size)
+{
+    struct arena* arena = calloc(1, sizeof (struct arena));
+    if (!arena) return 0;
+    arena->block_size = block_size ? ALIGN_UP(block_size, os_vm_page_size) : os_vm_page_size;
+    int __attribute__((unused)) ret = mutex_acquire(&free_pages_lock);
+    gc_assert(ret);
+    arena->next = all_arenas;
+    all_arenas = arena;
+    ret = mutex_release(&free_pages_lock);
+    gc_assert(ret);
+    return arena;
+}
+
+/* Make the current thread's TLABs allocate from 'arena', or from the heap if
+ * 0, on entry to a dynamic extent if 'enter', else on exit from the extent
+ * of the arena in use. Called from Lisp inside WITHOUT-GCING */
+void arena_switch(struct arena* arena, int enter)
+{
+    struct thread* self = get_sb_vm_thread();
+    struct extra_thread_data* ed = thread_extra_data(self);
+    int __attribute__((unused)) ret = mutex_acquire(&free_pages_lock);
+    gc_assert(ret);
+    if (!enter) { if (ed->arena) --ed->arena->n_users; }
+    else if (arena) ++arena->n_users;
+    ed->arena = arena;
+    ret = mutex_release(&free_pages_lock);
+    gc_assert(ret);
+    // Whichever regions are open belong to what was allocated from before
+    close_current_thread_tlab();
+}
+
+/* Free the memory of 'arena' and return 1, or return 0 if it is in use by
+ * some thread, even if only outside a nested extent */
+int arena_destroy(struct arena* arena)
+{
+    int __attribute__((unused)) ret = mutex_acquire(&free_pages_lock);
+    gc_assert(ret);
+    if (arena->n_users) {
+        ret = mutex_release(&free_pages_lock);
+        gc_assert(ret);
+        return 0;
+    }
+    struct arena** prev = &all_arenas;
+    while (*prev != arena) prev = &(*prev)->next;
+    *prev = arena->next;
+#ifdef DEBUG
+    struct arena_block* block;
+    for (block = arena->blocks ; block ; block = block->next)
+        os_protect((os_vm_address_t)block->start,
+                   (char*)block->end - (char*)block->start, OS_VM_PROT_NONE);
+    arena->next = destroyed_arenas;
+    destroyed_arenas = arena;
+#endif
+    ret = mutex_release(&free_pages_lock);
+    gc_assert(ret);
+#ifndef DEBUG
+    while (arena->blocks) {
+        struct arena_block* block = arena->blocks;
+        arena->blocks = block->next;
+        os_deallocate((os_vm_address_t)block->start,
+                      (char*)block->end - (char*)block->start);
+        free(block);
+    }
+    free(arena);
+#endif
+    return 1;
+}
+
+/* Free everything allocated in 'arena' but keep its oldest block for reuse,
+ * and return 1, or return 0 if it is in use by some thread. This reclaims
+ * what one thread allocated there without stopping the others. Called from
+ * Lisp inside WITHOUT-GCING */
+int arena_rewind(struct arena* arena)
+{
+    int __attribute__((unused)) ret = mutex_acquire(&free_pages_lock);
+    gc_assert(ret);
+    if (arena->n_users) {
+        ret = mutex_release(&free_pages_lock);
+        gc_assert(ret);
+        return 0;
+    }
+    struct arena_block* block = arena->blocks;
+    if (block) {
+        while (block->next) {
+            struct arena_block* next = block->next;
+            os_deallocate((os_vm_address_t)block->start,
+                          (char*)block->end - (char*)block->start);
+            free(block);
+            block = next;
+        }
+        // Allocation expects zeroed memory, as fresh pages are
+        memset(block->start, 0, (char*)block->free_pointer - (char*)block->start);
+        block->free_pointer = block->start;
+        arena->blocks = block;
+    }
+    ret = mutex_release(&free_pages_lock);
+    gc_assert(ret);
+    return 1;
+}
+
+/* Call 'fun' on the range of objects in each block of every arena.
+ * The thread regions must have been closed */
+void walk_arenas(void (*fun)(lispobj*, lispobj*))
+{
+    struct arena* arena;
+    struct arena_block* block;
+    for (arena = all_arenas ; arena ; arena = arena->next)
+        for (block = arena->blocks ; block ; block = block->next)
+            if (block->free_pointer > block->start) fun(block->start, block->free_pointer);
+}
+
+#ifdef DEBUG
+int destroyed_arena_pointer_p(lispobj ptr)
+{
+    return arena_block_of(destroyed_arenas, (void*)ptr) != 0;
+}
+#endif
+
 static NO_SANITIZE_MEMORY lispobj*
 lisp_alloc(int largep, struct alloc_region *region, sword_t nbytes,
            int page_type, struct thread *thread)
@@ -4800,6 +6887,18 @@ lisp_alloc(int largep, struct alloc_region *region, sword_t nbytes,
         return(new_obj);        /* yup */
     }
 
+    /* Arena memory counts for nothing toward the GC trigger */
+    struct arena* arena = thread_extra_data(thread)->arena;
+    if (arena && (region == THREAD_ALLOC_REGION(thread,mixed)
+                  || region == THREAD_ALLOC_REGION(thread,cons))) {
+        int __attribute__((unused)) ret = mutex_acquire(&free_pages_lock);
+        gc_assert(ret);
+        new_obj = arena_alloc(arena, largep, region, nbytes, page_type);
+        ret = mutex_release(&free_pages_lock);
+        gc_assert(ret);
+        return new_obj;
+    }
+
     /* We don't want to count nbytes against auto_gc_trigger unless we
      * have to: it speeds up the tenuring of objects and slows down
      * allocation. However, unless we do so when allocating _very_
@@ -4839,33 +6938,53 @@ lisp_alloc(int largep, struct alloc_region *region, sword_t nbytes,
             }
         }
     }
-    int __attribute__((unused)) ret = mutex_acquire(&free_pages_lock);
-    gc_assert(ret);
-    if (largep)
-        new_obj = gc_alloc_large(nbytes, page_type, region, 1);
-    else {
-        ensure_region_closed(region, page_type);
-        // hold the lock after alloc_new_region if a cons page
-        int release = page_type != PAGE_TYPE_CONS;
-        new_obj = gc_alloc_new_region(nbytes, page_type, region, release);
+#ifdef THREAD_PAGE_CACHE_SIZE
+    struct thread_page_cache* cache = 0;
+    if (!largep && nbytes <= (sword_t)CONS_PAGE_USABLE_BYTES)
+        cache = tlab_page_cache(thread, region);
+    if (cache && cache->n_free && (region_closed_p(region) || cache->region_from_cache)) {
+        // No lock needed
+        new_obj = open_region_from_cache(cache, region, page_type);
         region->free_pointer = (char*)new_obj + nbytes;
-        // addr_diff asserts that 'end' >= 'free_pointer'
-        int remaining = addr_diff(region->end_addr, region->free_pointer);
-        // Try to avoid the next Lisp -> C -> Lisp round-trip by possibly
-        // requesting yet another region.
-        if (page_type == PAGE_TYPE_CONS) {
-            if (remaining <= CONS_SIZE * N_WORD_BYTES) { // Refill now if <= 1 more cons to go
-                gc_close_region(region, page_type);
-                // Request > 2 words, forcing a new page to be claimed.
-                gc_alloc_new_region(4 * N_WORD_BYTES, page_type, region, 0); // don't release
-            }
+    } else
+#endif
+    {
+        int __attribute__((unused)) ret = mutex_acquire(&free_pages_lock);
+        gc_assert(ret);
+        if (largep)
+            new_obj = gc_alloc_large(nbytes, page_type, region, 1);
+#ifdef THREAD_PAGE_CACHE_SIZE
+        else if (cache && refill_page_cache(cache, region, page_type)) {
             ret = mutex_release(&free_pages_lock);
             gc_assert(ret);
-        } else if (remaining <= 4 * N_WORD_BYTES
-                   && TryEnterCriticalSection(&free_pages_lock)) {
-            gc_close_region(region, page_type);
-            // Request > 4 words, forcing a new page to be claimed.
-            gc_alloc_new_region(6 * N_WORD_BYTES, page_type, region, 1); // do release
+            new_obj = open_region_from_cache(cache, region, page_type);
+            region->free_pointer = (char*)new_obj + nbytes;
+        }
+#endif
+        else {
+            ensure_region_closed(region, page_type);
+            // hold the lock after alloc_new_region if a cons page
+            int release = page_type != PAGE_TYPE_CONS;
+            new_obj = gc_alloc_new_region(nbytes, page_type, region, release);
+            region->free_pointer = (char*)new_obj + nbytes;
+            // addr_diff asserts that 'end' >= 'free_pointer'
+            int remaining = addr_diff(region->end_addr, region->free_pointer);
+            // Try to avoid the next Lisp -> C -> Lisp round-trip by possibly
+            // requesting yet another region.
+            if (page_type == PAGE_TYPE_CONS) {
+                if (remaining <= CONS_SIZE * N_WORD_BYTES) { // Refill now if <= 1 more cons to go
+                    gc_close_region(region, page_type);
+                    // Request > 2 words, forcing a new page to be claimed.
+                    gc_alloc_new_region(4 * N_WORD_BYTES, page_type, region, 0); // don't release
+                }
+                ret = mutex_release(&free_pages_lock);
+                gc_assert(ret);
+            } else if (remaining <= 4 * N_WORD_BYTES
+                       && TryEnterCriticalSection(&free_pages_lock)) {
+                gc_close_region(region, page_type);
+                // Request > 4 words, forcing a new page to be claimed.
+                gc_alloc_new_region(6 * N_WORD_BYTES, page_type, region, 1); // do release
+            }
         }
     }
 
@@ -4876,9 +6995,21 @@ lisp_alloc(int largep, struct alloc_region *region, sword_t nbytes,
     // That's reliable, but access_control_frame_pointer(thread) isn't.
     // x86[-64] use the ABI frame pointer register which seems not to work
     // for win32, but sb-sprof never did work there anyway.
-    extern void allocator_record_backtrace(void*, struct thread*);
-    if (gencgc_alloc_profiler && thread->state_word.sprof_enable)
-        allocator_record_backtrace(__builtin_frame_address(0), thread);
+    extern uint32_t allocator_record_backtrace(void*, struct thread*, int);
+    if (gencgc_alloc_profiler && thread->state_word.sprof_enable) {
+        if (!gencgc_alloc_sample_bytes)
+            allocator_record_backtrace(__builtin_frame_address(0), thread, 1);
+        else {
+            // The rest of a newly opened region is charged here too
+            sword_t charge = largep ? nbytes
+                : nbytes + addr_diff(region->end_addr, region->free_pointer);
+            int n = alloc_samples_due(thread, charge);
+            if (n)
+                note_alloc_sampled_object(new_obj, n,
+                                          allocator_record_backtrace(__builtin_frame_address(0),
+                                                                     thread, n));
+        }
+    }
 #endif
 
     return (new_obj);
@@ -4907,6 +7038,30 @@ DEFINE_LISP_ENTRYPOINT(alloc_list, 0, cons, PAGE_TYPE_CONS)
 DEFINE_LISP_ENTRYPOINT(alloc_list, 0, mixed, PAGE_TYPE_MIXED)
 #endif
 
+static void* alloc_from_code_region(sword_t nbytes, struct thread* th)
+{
+    /* Allocations in the code region are all serialized. We might also acquire
+     * free_pages_lock depending on availability of space in the region */
+    int result = mutex_acquire(&code_allocator_lock);
+    gc_assert(result);
+    void* mem = lisp_alloc(nbytes >= LARGE_OBJECT_SIZE, code_region, nbytes, PAGE_TYPE_CODE, th);
+    result = mutex_release(&code_allocator_lock);
+    gc_assert(result);
+    return mem;
+}
+
+#ifdef LISP_FEATURE_SB_THREAD
+/* Code objects of up to a quarter of CODE_CHUNK_BYTES are carved out of a
+ * chunk of that size that the thread takes from the code region, so that
+ * threads compiling or loading fasls at once mostly don't contend for
+ * the lock. The unused rest of a chunk is always covered by a filler, which
+ * heap walks and GC treat like any other filler on a code page. GC makes
+ * every thread forget its chunk, because the pages under it can be freed or
+ * reused; the allocating thread is pseudo-atomic (or WITHOUT-GCING) from
+ * taking space through writing the filler, so GC never sees it half done. */
+#define CODE_CHUNK_BYTES (GENCGC_PAGE_BYTES/2)
+#endif
+
 lispobj AMD64_SYSV_ABI alloc_code_object(unsigned total_words)
 {
     struct thread *th = get_sb_vm_thread();
@@ -4917,15 +7072,28 @@ lispobj AMD64_SYSV_ABI alloc_code_object(unsigned total_words)
 #endif
 
     sword_t nbytes = total_words * N_WORD_BYTES;
-    /* Allocations of code are all serialized. We might also acquire
-     * free_pages_lock depending on availability of space in the region */
-    int result = mutex_acquire(&code_allocator_lock);
-    gc_assert(result);
-    struct code *code =
-        (void*)lisp_alloc(nbytes >= LARGE_OBJECT_SIZE, code_region, nbytes, PAGE_TYPE_CODE, th);
-    result = mutex_release(&code_allocator_lock);
-    gc_assert(result);
+    struct code *code;
+#ifdef LISP_FEATURE_SB_THREAD
+    struct extra_thread_data* data = thread_extra_data(th);
+    char* chunk_end = 0;
+    if (nbytes <= CODE_CHUNK_BYTES/4) {
+        if (data->code_chunk_end - data->code_chunk_free < nbytes) {
+            data->code_chunk_free = alloc_from_code_region(CODE_CHUNK_BYTES, th);
+            data->code_chunk_end = data->code_chunk_free + CODE_CHUNK_BYTES;
+        }
+        code = (void*)data->code_chunk_free;
+        data->code_chunk_free += nbytes;
+        chunk_end = data->code_chunk_end;
+    } else
+#endif
+    code = alloc_from_code_region(nbytes, th);
     THREAD_JIT(0);
+#ifdef LISP_FEATURE_SB_THREAD
+    if (chunk_end > data->code_chunk_free) {
+        sword_t fill_nwords = (chunk_end - data->code_chunk_free) >> WORD_SHIFT;
+        *(lispobj*)data->code_chunk_free = (fill_nwords - 1) << N_WIDETAG_BITS | FILLER_WIDETAG;
+    }
+#endif
 
     code->header = ((uword_t)total_words << CODE_HEADER_SIZE_SHIFT) | CODE_HEADER_WIDETAG;
     // Code pages are not prezeroed, so these assignments are essential to prevent GC
@@ -5053,14 +7221,14 @@ NO_SANITIZE_MEMORY lispobj listify_rest_arg(lispobj* context, sword_t context_by
 }
 #endif
 
-void sync_close_regions(int block_signals,
+void sync_close_regions(int block_signals, __attribute__((unused)) struct thread* th,
                         struct alloc_region *region_1, int page_type_1,
                         struct alloc_region *region_2, int page_type_2)
 {
-    sigset_t savedmask;
-    int result;
+    int result, lazy = 0;
     int need_code_lock = (page_type_1 == PAGE_TYPE_CODE || page_type_2 == PAGE_TYPE_CODE);
-    if (block_signals) block_blockable_signals(&savedmask);
+    /* Nothing in here can run Lisp code or stop for GC */
+    if (block_signals) lazy = lazy_block_signals();
     if (need_code_lock) {
         result = mutex_acquire(&code_allocator_lock);
         gc_assert(result);
@@ -5069,13 +7237,16 @@ void sync_close_regions(int block_signals,
     gc_assert(result);
     if (region_1) ensure_region_closed(region_1, page_type_1);
     if (region_2) ensure_region_closed(region_2, page_type_2);
+#ifdef THREAD_PAGE_CACHE_SIZE
+    if (th) release_page_caches(th);
+#endif
     result = mutex_release(&free_pages_lock);
     gc_assert(result);
     if (need_code_lock) {
         result = mutex_release(&code_allocator_lock);
         gc_assert(result);
     }
-    if (block_signals) thread_sigmask(SIG_SETMASK, &savedmask, 0);
+    if (block_signals) lazy_unblock_signals(lazy);
 }
 /* These two exported "close_x" functions are called from Lisp prior to
  * heap-walking. They must never get interrupted by STOP_FOR_GC while holding
@@ -5084,15 +7255,15 @@ void sync_close_regions(int block_signals,
  * these are plain foreign calls without aid of a vop. */
 void close_current_thread_tlab() {
     __attribute__((unused)) struct thread *self = get_sb_vm_thread();
-    sync_close_regions(1, THREAD_ALLOC_REGION(self,mixed), PAGE_TYPE_MIXED,
+    sync_close_regions(1, self, THREAD_ALLOC_REGION(self,mixed), PAGE_TYPE_MIXED,
                           THREAD_ALLOC_REGION(self,cons), PAGE_TYPE_CONS);
 }
 void close_code_region() {
-    sync_close_regions(1, code_region, PAGE_TYPE_CODE, 0, 0);
+    sync_close_regions(1, 0, code_region, PAGE_TYPE_CODE, 0, 0);
 }
 /* This is called by unregister_thread() with STOP_FOR_GC blocked */
 void gc_close_thread_regions(struct thread* th) {
-    sync_close_regions(0, &th->mixed_tlab, PAGE_TYPE_MIXED,
+    sync_close_regions(0, th, &th->mixed_tlab, PAGE_TYPE_MIXED,
                           &th->cons_tlab, PAGE_TYPE_CONS);
 }
 
@@ -5286,6 +7457,79 @@ prepare_for_final_gc ()
  * plus literal strings in code compiled to memory. */
 char gc_coalesce_string_literals = 0;
 
+/* Set this switch to 1 to have the final GC of SAVE-LISP-AND-DIE copy
+ * symbol names and the debug-info of code ahead of everything else.
+ * Being transported first, they pack densely into the lowest pages of
+ * dynamic space instead of being interleaved with symbols, hash tables
+ * and other objects that a running program mutates. Pages that are never
+ * written after startup stay shared among all processes which map the
+ * same core file, so this reduces the private memory of each process. */
+char gc_segregate_immutable_data = 0;
+
+/* If 0, SAVE-LISP-AND-DIE does one collection where it normally does two.
+ * The survivors stay wherever the collection puts them instead of being
+ * copied back down into the lowest pages, and nothing is coalesced, since
+ * the replaced objects would be saved as garbage. The core can be larger,
+ * but saving takes about half as long. Set from the :COMPACT argument */
+char gc_save_compact = 1;
+static lispobj* immutable_roots;
+static sword_t n_immutable_roots;
+
+static uword_t note_immutable_roots(lispobj* where, lispobj* limit, uword_t arg)
+{
+    boolean count_only = !immutable_roots;
+    for ( ; where < limit ; where += object_size(where) ) {
+        lispobj obj;
+        switch (widetag_of(where)) {
+        case SYMBOL_WIDETAG:
+            obj = decode_symbol_name(((struct symbol*)where)->name); break;
+        case CODE_HEADER_WIDETAG:
+            obj = ((struct code*)where)->debug_info; break;
+        default: continue;
+        }
+        if (!is_lisp_pointer(obj) || find_page_index((void*)obj) < 0) continue;
+        if (!count_only) immutable_roots[n_immutable_roots] = obj;
+        ++n_immutable_roots;
+    }
+    return arg;
+}
+
+/* Remember which objects to transport first in the final GC.
+ * This runs after the penultimate GC and coalescing, so every holder
+ * is live and no garbage gets retained by being listed here. The list
+ * holds copies of the slot values; the slots themselves are fixed up
+ * as usual when their holder is scavenged. */
+static void collect_immutable_roots()
+{
+    int pass;
+    for (pass = 0; pass < 2; ++pass) {
+        if (pass) {
+            immutable_roots = calloc(n_immutable_roots ? n_immutable_roots : 1,
+                                     N_WORD_BYTES);
+            if (!immutable_roots) return;
+            n_immutable_roots = 0;
+        }
+        note_immutable_roots((lispobj*)STATIC_SPACE_OBJECTS_START,
+                             static_space_free_pointer, 0);
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+        note_immutable_roots((lispobj*)FIXEDOBJ_SPACE_START, fixedobj_free_pointer, 0);
+        note_immutable_roots((lispobj*)VARYOBJ_SPACE_START, varyobj_free_pointer, 0);
+#endif
+        walk_generation(note_immutable_roots, -1, 0);
+    }
+}
+
+/* Called from garbage_collect_generation() before any other root is
+ * scavenged, so that the closure of the noted objects is allocated at
+ * the start of newspace. This happens in each generation's collection,
+ * which also keeps the list pointing to the current copies. */
+static void scavenge_immutable_roots()
+{
+    if (!immutable_roots) return;
+    scavenge(immutable_roots, n_immutable_roots);
+    scavenge_newspace(new_space);
+}
+
 /* Do a non-conservative GC, and then save a core with the initial
  * function being set to the value of 'lisp_init_function' */
 void
@@ -5298,6 +7542,7 @@ gc_and_save(char *filename, boolean prepend_runtime,
     size_t runtime_size;
     extern void coalesce_similar_objects();
     boolean verbose = !lisp_startup_options.noinform;
+    uint64_t t_start = gc_monotonic_nsec(), t_gc, t_coalesce, t_final_gc;
 
     file = prepare_to_save(filename, prepend_runtime, &runtime_bytes,
                            &runtime_size);
@@ -5308,6 +7553,15 @@ gc_and_save(char *filename, boolean prepend_runtime,
      * non-conservative GC. */
     filename = strdup(filename);
 
+    /* Pages in the saved core must not have nonzero bytes past their usage */
+    gencgc_lazy_zeroing = 0;
+    /* Keep the release thread out of the way from here on */
+    pause_page_release();
+    gencgc_release_in_background = 0;
+    pause_concurrent_verify();
+    gencgc_verify_concurrently = -1;
+    zero_deferred_pages();
+
     /* We're committed to process death at this point, and interrupts can not
      * possibly be handled in Lisp. Let the installed handler closures become
      * garbage, since new ones will be made by ENABLE-INTERRUPT on restart */
@@ -5364,43 +7618,60 @@ gc_and_save(char *filename, boolean prepend_runtime,
     // in Lisp if something goes wrong during GC.
     prepare_for_final_gc();
     unwind_binding_stack();
-    gencgc_alloc_start_page = next_free_page;
+    gencgc_alloc_start_page = gc_save_compact ? next_free_page : 0;
+    if (!gc_save_compact && verbose) { printf("[performing final GC..."); fflush(stdout); }
     collect_garbage(HIGHEST_NORMAL_GENERATION+1);
+    t_gc = gc_monotonic_nsec();
 
     THREAD_JIT(0);
 
-    // We always coalesce copyable numbers. Additional coalescing is done
-    // only on request, in which case a message is shown (unless verbose=0).
-    if (gc_coalesce_string_literals && verbose) {
-        printf("[coalescing similar vectors... ");
-        fflush(stdout);
-    }
-    /* FIXME: add comment explaining why coalescing is deferred until
-     * after the penultimate GC. Must it wait ? */
-    coalesce_similar_objects();
-    if (gc_coalesce_string_literals && verbose)
-        printf("done]\n");
-
-    /* FIXME: now that relocate_heap() works, can we just memmove() everything
-     * down and perform a relocation instead of a collection? */
-    if (verbose) { printf("[performing final GC..."); fflush(stdout); }
-    prepare_for_final_gc();
-    gencgc_alloc_start_page = 0;
-    collect_garbage(HIGHEST_NORMAL_GENERATION+1);
+    if (gc_save_compact) {
+        // We always coalesce copyable numbers. Additional coalescing is done
+        // only on request, in which case a message is shown (unless verbose=0).
+        if (gc_coalesce_string_literals && verbose) {
+            printf("[coalescing similar vectors... ");
+            fflush(stdout);
+        }
+        /* FIXME: add comment explaining why coalescing is deferred until
+         * after the penultimate GC. Must it wait ? */
+        coalesce_similar_objects();
+        if (gc_coalesce_string_literals && verbose)
+            printf("done]\n");
+        t_coalesce = gc_monotonic_nsec();
+
+        /* FIXME: now that relocate_heap() works, can we just memmove() everything
+         * down and perform a relocation instead of a collection? */
+        if (verbose) { printf("[performing final GC..."); fflush(stdout); }
+        prepare_for_final_gc();
+        if (gc_segregate_immutable_data) collect_immutable_roots();
+        gencgc_alloc_start_page = 0;
+        collect_garbage(HIGHEST_NORMAL_GENERATION+1);
+        free(immutable_roots);
+        immutable_roots = 0;
+        t_final_gc = gc_monotonic_nsec();
+    } else {
+        t_coalesce = t_final_gc = t_gc;
+    }
+
     /* All global allocation regions should be empty */
     ASSERT_REGIONS_CLOSED();
     // Enforce (rather, warn for lack of) self-containedness of the heap
     verify_heap(VERIFY_FINAL | VERIFY_QUICK);
     if (verbose)
         printf(" done]\n");
-
-    THREAD_JIT(0);
     // Scrub remaining garbage
     zero_all_free_ranges();
     // Assert that defrag will not move the init_function
     gc_assert(!immobile_space_p(lisp_init_function));
     // Defragment and set all objects' generations to pseudo-static
     prepare_immobile_space_for_save(verbose);
+    if (verbose) {
+        // So that it can be seen where the time to save goes
+        uint64_t t_end = gc_monotonic_nsec();
+        printf("[seconds: GC %.3f, coalescing %.3f, final GC %.3f, immobile space %.3f]\n",
+               (t_gc - t_start) / 1e9, (t_coalesce - t_gc) / 1e9,
+               (t_final_gc - t_coalesce) / 1e9, (t_end - t_final_gc) / 1e9);
+    }
 
 #ifdef LISP_FEATURE_X86_64
     untune_asm_routines_for_microarch();
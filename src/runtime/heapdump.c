@@ -0,0 +1,499 @@
+/*
+ * This software is part of the SBCL system. See the README file for
+ * more information.
+ *
+ * This software is derived from the CMU CL system, which was
+ * written at Carnegie Mellon University and released into the
+ * public domain. The software is in the public domain and is
+ * provided with absolutely no warranty. See the COPYING and CREDITS
+ * files for more information.
+ */
+
+/* A writer of heap dumps for offline analysis of the object graph.
+ *
+ * While gc_heap_dump_pathname is set, collect_garbage() writes every object
+ * in the heap, what each one references, and the roots, to that file once it
+ * has finished collecting and before it lets the world go. SB-EXT:WRITE-HEAP-DUMP
+ * sets it around a full GC so that the dump contains only live objects.
+ * Dynamic space is written in parallel by the GC thread pool, each worker
+ * taking a range of pages and appending whole records to the file when its
+ * buffer fills. The records are therefore in no particular order.
+ *
+ * The file starts with the 8 bytes "SBCLHEAP", then one byte each of
+ * format version (1), bytes per word, and the generation number of
+ * pseudo-static space, and a zero byte. Then come records, each a tag byte
+ * followed by fields, the last being an END record. Unless said otherwise,
+ * fields are unsigned LEB128 varints. Addresses are untagged object start
+ * addresses. A 'name' is a varint length followed by that many bytes of UTF-8.
+ *
+ *  END     (0)
+ *  OBJECT  (1)  address widetag:byte generation:byte nbytes layout ref* 0
+ *  TYPE    (2)  widetag:byte name
+ *  LAYOUT  (3)  address name
+ *  THREAD  (4)  thread lisp-thread
+ *  ROOT    (5)  kind:byte thread address
+ *
+ * OBJECT:
+ *   Conses have a 'widetag' of LIST_POINTER_LOWTAG. The 'generation' of an
+ *   object in static space is 255. Objects there, and in pseudo-static space,
+ *   are never freed and need no other root.
+ *   'layout' is the address of the layout of an instance or funcallable
+ *   instance, and 0 for anything else.
+ *   Each 'ref' is 1 plus the zigzag encoding of the signed distance, in words,
+ *   from the object to an object it refers to. References to static space,
+ *   weak references, and references from weak vectors are omitted.
+ *   A simple-fun is part of its code object, so a reference to one is a
+ *   reference to the code.
+ * TYPE:
+ *   Names each widetag that has a name. These come first.
+ * LAYOUT:
+ *   Gives the class name (without package) of the instances whose 'layout'
+ *   is 'address'. The same layout may be named more than once.
+ * THREAD:
+ *   'thread' is the runtime's thread structure, used only to identify the
+ *   thread in ROOT records. 'lisp-thread' is the address of its Lisp
+ *   thread object.
+ * ROOT:
+ *   'address' is kept alive by the thread which is 'thread' (or 0 for
+ *   none) in one of these ways, as given by 'kind'.
+ *     1  a word on the control stack, conservatively
+ *     2  a register in an interrupt context, conservatively
+ *     3  a value on the binding stack
+ *     4  a thread-local symbol value
+ *     5  a variable in the runtime
+ *
+ * Everything needed for dominator trees and retained sizes is there: build
+ * the graph from OBJECT records, add a synthetic root pointing to each ROOT
+ * address and to every static and pseudo-static object, and run any of the
+ * usual dominator algorithms.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sbcl.h"
+#ifdef LISP_FEATURE_GENCGC
+#include "runtime.h"
+#include "os.h"
+#include "globals.h"
+#include "interrupt.h"
+#include "lispregs.h"
+#include "thread.h"
+#include "validate.h"
+#include "gc.h"
+#include "gc-internal.h"
+#include "gc-private.h"
+#include "gencgc-private.h"
+#include "search.h"
+#include "code.h"
+#include "immobile-space.h"
+#include "genesis/gc-tables.h"
+#include "genesis/closure.h"
+#include "genesis/fdefn.h"
+#include "genesis/instance.h"
+#include "genesis/layout.h"
+#include "genesis/symbol.h"
+#include "genesis/vector.h"
+
+char* gc_heap_dump_pathname;
+int gc_heap_dump_errno;
+
+enum dump_record { DUMP_END, DUMP_OBJECT, DUMP_TYPE, DUMP_LAYOUT, DUMP_THREAD, DUMP_ROOT };
+enum dump_root_kind { ROOT_STACK = 1, ROOT_CONTEXT, ROOT_BINDING, ROOT_TLS, ROOT_RUNTIME };
+#define DUMP_STATIC_GENERATION 255
+
+/* A worker appends its buffer to the file once it holds this much */
+#define DUMP_BUFFER_BYTES (1024*1024)
+#define DUMP_CHUNK_PAGES 64
+#define DUMP_LAYOUT_CACHE 256
+
+struct dump_buffer {
+    unsigned char* data;
+    uword_t fill, capacity;
+    // Layouts for which a LAYOUT record was written lately
+    lispobj named_layouts[DUMP_LAYOUT_CACHE];
+};
+static struct dump_buffer dump_buffers[GC_MAX_THREADS];
+static int dump_fd, dump_errno;
+
+static void dump_flush(struct dump_buffer* b)
+{
+    // O_APPEND makes each write() land in one piece after everything
+    // that any other buffer wrote so far.
+    if (b->fill && !dump_errno) {
+        ssize_t wrote = write(dump_fd, b->data, b->fill);
+        if (wrote != (ssize_t)b->fill) dump_errno = wrote < 0 ? errno : ENOSPC;
+    }
+    b->fill = 0;
+}
+
+static void dump_grow(struct dump_buffer* b)
+{
+    b->capacity = b->capacity ? 2 * b->capacity : DUMP_BUFFER_BYTES + 4096;
+    b->data = realloc(b->data, b->capacity);
+    if (!b->data) lose("can't allocate heap dump buffer");
+}
+
+static inline void dump_byte(struct dump_buffer* b, int byte)
+{
+    if (b->fill == b->capacity) dump_grow(b);
+    b->data[b->fill++] = byte;
+}
+
+static inline void dump_uword(struct dump_buffer* b, uword_t n)
+{
+    while (n >= 0x80) { dump_byte(b, (n & 0x7f) | 0x80); n >>= 7; }
+    dump_byte(b, n);
+}
+
+static void dump_name(struct dump_buffer* b, const char* name)
+{
+    int len = strlen(name);
+    dump_uword(b, len);
+    while (len--) dump_byte(b, *name++);
+}
+
+static void dump_utf8(struct dump_buffer* b, unsigned int c)
+{
+    if (c < 0x80) dump_byte(b, c);
+    else if (c < 0x800) { dump_byte(b, 0xc0 | c >> 6); dump_byte(b, 0x80 | (c & 0x3f)); }
+    else if (c < 0x10000) {
+        dump_byte(b, 0xe0 | c >> 12);
+        dump_byte(b, 0x80 | ((c >> 6) & 0x3f)); dump_byte(b, 0x80 | (c & 0x3f));
+    } else {
+        dump_byte(b, 0xf0 | c >> 18); dump_byte(b, 0x80 | ((c >> 12) & 0x3f));
+        dump_byte(b, 0x80 | ((c >> 6) & 0x3f)); dump_byte(b, 0x80 | (c & 0x3f));
+    }
+}
+
+static void dump_lisp_string(struct dump_buffer* b, struct vector* string)
+{
+    if (!string) { dump_uword(b, 0); return; }
+    sword_t i, len = vector_len(string);
+#ifdef SIMPLE_CHARACTER_STRING_WIDETAG
+    if (header_widetag(string->header) == SIMPLE_CHARACTER_STRING_WIDETAG) {
+        unsigned int* chars = (unsigned int*)string->data;
+        uword_t nbytes = 0;
+        for (i = 0; i < len; ++i)
+            nbytes += chars[i] < 0x80 ? 1 : chars[i] < 0x800 ? 2 : chars[i] < 0x10000 ? 3 : 4;
+        dump_uword(b, nbytes);
+        for (i = 0; i < len; ++i) dump_utf8(b, chars[i]);
+        return;
+    }
+#endif
+    if (header_widetag(string->header) != SIMPLE_BASE_STRING_WIDETAG) {
+        dump_uword(b, 0);
+        return;
+    }
+    dump_uword(b, len);
+    for (i = 0; i < len; ++i) dump_byte(b, ((unsigned char*)string->data)[i]);
+}
+
+static inline boolean static_space_obj_p(lispobj* obj)
+{
+    return (uword_t)obj >= STATIC_SPACE_START && obj < static_space_free_pointer;
+}
+
+/* Return the start of the object that 'ref' points to, which is the code
+ * object for a simple-fun, or 0 if it should not be written */
+static inline lispobj* dump_target(lispobj ref)
+{
+    if (!is_lisp_pointer(ref) || ref == NIL) return 0;
+    lispobj* target = native_pointer(ref);
+    if (lowtag_of(ref) == FUN_POINTER_LOWTAG && embedded_obj_p(widetag_of(target)))
+        target = fun_code_header(target);
+    return static_space_obj_p(target) ? 0 : target;
+}
+
+static inline void dump_ref(struct dump_buffer* b, lispobj* source, lispobj ref)
+{
+    lispobj* target = dump_target(ref);
+    if (!target) return;
+    sword_t delta = target - source;
+    dump_uword(b, 1 + (((uword_t)delta << 1) ^ (uword_t)(delta >> (N_WORD_BITS-1))));
+}
+
+static void dump_layout_name(struct dump_buffer* b, lispobj layout)
+{
+    extern struct vector * layout_classoid_name(lispobj*);
+    lispobj* cell = &b->named_layouts[(layout >> (1+WORD_SHIFT)) % DUMP_LAYOUT_CACHE];
+    if (*cell == layout) return;
+    *cell = layout;
+    dump_byte(b, DUMP_LAYOUT);
+    dump_uword(b, (uword_t)native_pointer(layout));
+    dump_lisp_string(b, layout_classoid_name(native_pointer(layout)));
+}
+
+/* Write the object at 'where' and return its size in words.
+ * This is another variant of trace_object() in fullcgc */
+static sword_t dump_object(struct dump_buffer* b, lispobj* where, int gen)
+{
+    lispobj header = *where, layout = 0;
+    sword_t nwords, i, scan_from = 1, scan_to;
+    int widetag;
+    if (is_header(header)) {
+        widetag = header_widetag(header);
+        nwords = scan_to = sizetab[widetag](where);
+        if (widetag == FILLER_WIDETAG) return nwords;
+        if (instanceoid_widetag_p(widetag)) layout = layout_of(where);
+    } else {
+        widetag = LIST_POINTER_LOWTAG;
+        nwords = 2;
+        scan_from = 0;
+        scan_to = 2;
+    }
+    if (b->fill >= DUMP_BUFFER_BYTES) dump_flush(b);
+    if (layout) dump_layout_name(b, layout);
+    dump_byte(b, DUMP_OBJECT);
+    dump_uword(b, (uword_t)where);
+    dump_byte(b, widetag);
+    dump_byte(b, gen);
+    dump_uword(b, nwords << WORD_SHIFT);
+    dump_uword(b, layout ? (uword_t)native_pointer(layout) : 0);
+
+    if (instanceoid_widetag_p(widetag)) {
+        scan_to = 0;
+        if (layout) {
+#ifdef LISP_FEATURE_METASPACE
+            dump_ref(b, where, LAYOUT(layout)->friend);
+#else
+            dump_ref(b, where, layout);
+#endif
+            if (lockfree_list_node_layout_p(LAYOUT(layout))) { // allow untagged 'next'
+                lispobj next = ((struct instance*)where)->slots[INSTANCE_DATA_START];
+                if (fixnump(next) && next) dump_ref(b, where, next|INSTANCE_POINTER_LOWTAG);
+            }
+            struct bitmap bitmap = get_layout_bitmap(LAYOUT(layout));
+            int nslots = instanceoid_length(header);
+            for (i = 0; i < nslots; ++i)
+                if (bitmap_logbitp(i, bitmap)) dump_ref(b, where, where[1+i]);
+        }
+    } else if (widetag != LIST_POINTER_LOWTAG) switch (widetag) {
+    case SIMPLE_VECTOR_WIDETAG:
+        if (vector_flagp(header, VectorWeak)) scan_to = 0;
+        break;
+#if defined(LISP_FEATURE_X86) || defined(LISP_FEATURE_X86_64) || defined (LISP_FEATURE_ARM64)
+    case CLOSURE_WIDETAG:
+        dump_ref(b, where, fun_taggedptr_from_self(((struct closure*)where)->fun));
+        scan_from = 2;
+        break;
+#endif
+    case CODE_HEADER_WIDETAG:
+        scan_to = code_header_words((struct code*)where);
+#ifdef LISP_FEATURE_UNTAGGED_FDEFNS
+        {
+        struct code* code = (struct code*)where;
+        lispobj* fdefns_start = code->constants
+                                + code_n_funs(code) * CODE_SLOTS_PER_SIMPLE_FUN;
+        lispobj* fdefns_end  = fdefns_start + code_n_named_calls(code);
+        for (i = scan_from; i < scan_to; ++i) {
+            lispobj word = where[i];
+            if (where+i >= fdefns_start && where+i < fdefns_end) word |= OTHER_POINTER_LOWTAG;
+            dump_ref(b, where, word);
+        }
+        scan_to = 0;
+        }
+#endif
+        break;
+#ifdef LISP_FEATURE_COMPACT_SYMBOL
+    case SYMBOL_WIDETAG:
+        {
+        struct symbol* s = (void*)where;
+        dump_ref(b, where, decode_symbol_name(s->name));
+        dump_ref(b, where, s->value);
+        dump_ref(b, where, s->info);
+        dump_ref(b, where, s->fdefn);
+        // the unnamed slot of augmented symbols
+        if ((s->header & 0xFF00) == (SYMBOL_SIZE<<8)) dump_ref(b, where, *(1+&s->fdefn));
+        scan_to = 0;
+        }
+        break;
+#endif
+    case FDEFN_WIDETAG:
+        dump_ref(b, where, fdefn_callee_lispobj((struct fdefn*)where));
+        scan_to = 3;
+        break;
+    case WEAK_POINTER_WIDETAG:
+        scan_to = 0;
+        break;
+    default:
+        if (leaf_obj_widetag_p(widetag)) scan_to = 0;
+    }
+    for (i = scan_from; i < scan_to; ++i) dump_ref(b, where, where[i]);
+    dump_byte(b, 0);
+    return nwords;
+}
+
+static void dump_range(struct dump_buffer* b, lispobj* where, lispobj* limit,
+                       int gen, boolean headered_only)
+{
+    while (where < limit) {
+        // Free slots in fixedobj space start with a fixnum
+        if (headered_only && !is_header(*where)) { where += 2; continue; }
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+        if (gen < 0) {
+            where += dump_object(b, where, immobile_obj_generation(where));
+            continue;
+        }
+#endif
+        where += dump_object(b, where, gen);
+    }
+}
+
+static void dump_pages(int worker, void* arg)
+{
+    struct dump_buffer* b = &dump_buffers[worker];
+    page_index_t first, end, page, last;
+    while ((first = gc_claim_chunk(arg, DUMP_CHUNK_PAGES, next_free_page, &end)) >= 0)
+        for (page = first; page < end; ++page) {
+            if (!page_words_used(page) || !page_starts_contiguous_block_p(page)) continue;
+            // A block that starts in this chunk is ours even if it ends beyond it
+            for (last = page; !page_ends_contiguous_block_p(last, page_table[page].gen); ++last)
+                ;
+            dump_range(b, (lispobj*)page_address(page),
+                       (lispobj*)page_address(last) + page_words_used(last),
+                       page_table[page].gen, 0);
+        }
+    dump_flush(b);
+}
+
+static void dump_root(struct dump_buffer* b, int kind, struct thread* th, lispobj* obj)
+{
+    dump_byte(b, DUMP_ROOT);
+    dump_byte(b, kind);
+    dump_uword(b, (uword_t)th);
+    dump_uword(b, (uword_t)obj);
+}
+
+static void dump_precise_root(struct dump_buffer* b, int kind, struct thread* th, lispobj word)
+{
+    lispobj* obj = dump_target(word);
+    if (obj) dump_root(b, kind, th, obj);
+}
+
+/* Accept the same words that would pin an object: pointers to the start of
+ * an object with the right lowtag, and any pointer into code */
+static void dump_ambiguous_root(struct dump_buffer* b, int kind, struct thread* th, uword_t word)
+{
+    if (word < BACKEND_PAGE_BYTES) return;
+    lispobj* base = search_all_gc_spaces((void*)word);
+    if (!base || static_space_obj_p(base)) return;
+    if (is_header(*base) && header_widetag(*base) == CODE_HEADER_WIDETAG)
+        dump_root(b, kind, th, base);
+    else if (compute_lispobj(base) == word
+             && !(is_header(*base) && header_widetag(*base) == FILLER_WIDETAG))
+        dump_root(b, kind, th, base);
+}
+
+// The context scanner takes only a function, so it gets its state from here
+static struct thread* context_root_thread;
+static void dump_context_root(os_context_register_t word)
+{
+    dump_ambiguous_root(&dump_buffers[0], ROOT_CONTEXT, context_root_thread, word);
+}
+
+static void NO_SANITIZE_MEMORY
+dump_thread_roots(struct dump_buffer* b, struct thread* th,
+                  void (*context_scanner)(), void* stack_hot_end)
+{
+    lispobj* where;
+    dump_byte(b, DUMP_THREAD);
+    dump_uword(b, (uword_t)th);
+    dump_uword(b, (uword_t)dump_target(th->lisp_thread));
+
+#ifdef LISP_FEATURE_C_STACK_IS_CONTROL_STACK
+    lispobj* sp = (lispobj*)-1;
+# ifdef LISP_FEATURE_SB_SAFEPOINT
+    sp = os_get_csp(th);
+# else
+    int i;
+    context_root_thread = th;
+    for (i = fixnum_value(read_TLS(FREE_INTERRUPT_CONTEXT_INDEX,th))-1; i >= 0; --i) {
+        os_context_t *c = nth_interrupt_context(i, th);
+        if (context_scanner) context_scanner(dump_context_root, c);
+        lispobj* csp = (lispobj*)*os_context_register_addr(c, reg_SP);
+        if (csp >= th->control_stack_start && csp < th->control_stack_end && csp < sp)
+            sp = csp;
+    }
+# endif
+    if (th == get_sb_vm_thread() && (lispobj*)stack_hot_end < sp)
+        sp = PTR_ALIGN_DOWN(stack_hot_end, N_WORD_BYTES);
+    if (sp != (lispobj*)-1)
+        for (where = sp; where < th->control_stack_end; ++where)
+            dump_ambiguous_root(b, ROOT_STACK, th, *where);
+#else
+    for (where = th->control_stack_start;
+         where < (lispobj*)access_control_stack_pointer(th); ++where)
+        dump_ambiguous_root(b, ROOT_STACK, th, *where);
+#endif
+
+    struct binding* binding = (struct binding*)th->binding_stack_start;
+    for ( ; (lispobj*)binding < (lispobj*)get_binding_stack_pointer(th); ++binding)
+        dump_precise_root(b, ROOT_BINDING, th, binding->value);
+#ifdef LISP_FEATURE_SB_THREAD
+    lispobj* to = (lispobj*)(SymbolValue(FREE_TLS_INDEX,0) + (char*)th);
+    for (where = &th->lisp_thread; where < to; ++where)
+        dump_precise_root(b, ROOT_TLS, th, *where);
+#endif
+}
+
+/* Write the heap to 'pathname', setting gc_heap_dump_errno if that fails.
+ * Called by collect_garbage() with the world stopped */
+void gc_write_heap_dump(void (*context_scanner)(), char* pathname)
+{
+    extern lispobj lisp_init_function;
+    int here; // approximates the hot end of this thread's stack
+    dump_fd = open(pathname, O_WRONLY|O_CREAT|O_TRUNC|O_APPEND, 0666);
+    if (dump_fd < 0) { gc_heap_dump_errno = errno; return; }
+    dump_errno = 0;
+    struct dump_buffer* b = &dump_buffers[0];
+    int i;
+
+    const char magic[] = "SBCLHEAP";
+    for (i = 0; i < 8; ++i) dump_byte(b, magic[i]);
+    dump_byte(b, 1);
+    dump_byte(b, N_WORD_BYTES);
+    dump_byte(b, PSEUDO_STATIC_GENERATION);
+    dump_byte(b, 0);
+    dump_byte(b, DUMP_TYPE);
+    dump_byte(b, LIST_POINTER_LOWTAG);
+    dump_name(b, "cons");
+    for (i = 0; i < 256; i += 4)
+        if (other_immediate_lowtag_p(i) && strncmp(widetag_names[i>>2], "unk", 3)) {
+            dump_byte(b, DUMP_TYPE);
+            dump_byte(b, i);
+            dump_name(b, widetag_names[i>>2]);
+        }
+
+    struct thread* th;
+    for_each_thread(th) dump_thread_roots(b, th, context_scanner, &here);
+    for (i = 0; i < NSIG; ++i) dump_precise_root(b, ROOT_RUNTIME, 0, lisp_sig_handlers[i]);
+    dump_precise_root(b, ROOT_RUNTIME, 0, lisp_init_function);
+    dump_precise_root(b, ROOT_RUNTIME, 0, lisp_package_vector);
+    dump_precise_root(b, ROOT_RUNTIME, 0, alloc_profile_data);
+
+    dump_range(b, (lispobj*)NIL_SYMBOL_SLOTS_START, (lispobj*)NIL_SYMBOL_SLOTS_END,
+               DUMP_STATIC_GENERATION, 0);
+    dump_range(b, (lispobj*)STATIC_SPACE_OBJECTS_START, static_space_free_pointer,
+               DUMP_STATIC_GENERATION, 0);
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+    dump_range(b, (lispobj*)FIXEDOBJ_SPACE_START, fixedobj_free_pointer, -1, 1);
+    dump_range(b, (lispobj*)VARYOBJ_SPACE_START, varyobj_free_pointer, -1, 0);
+#endif
+    dump_flush(b);
+
+    page_index_t cursor = 0;
+    gc_run_on_thread_pool(dump_pages, &cursor);
+
+    dump_byte(b, DUMP_END);
+    dump_flush(b);
+    if (close(dump_fd) && !dump_errno) dump_errno = errno;
+    for (i = 0; i < GC_MAX_THREADS; ++i) {
+        free(dump_buffers[i].data);
+        memset(&dump_buffers[i], 0, sizeof dump_buffers[i]);
+    }
+    gc_heap_dump_errno = dump_errno;
+}
+#endif
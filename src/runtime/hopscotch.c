@@ -31,6 +31,11 @@ extern int ffs(int);
 #endif
 #include "genesis/vector.h"
 #include "murmur_hash.h"
+#if defined LISP_FEATURE_X86_64 && !defined HOPSCOTCH_INSTRUMENT
+#include <immintrin.h>
+#include "x86-64-arch.h" // for avx2_supported
+#define HOPSCOTCH_VECTOR_PROBE
+#endif
 
 #define hopscotch_allocate(nbytes) os_allocate(nbytes)
 #define hopscotch_deallocate(addr,length) os_deallocate(addr, length)
@@ -164,7 +169,7 @@ void hopscotch_init() // Called once on runtime startup, from gc_init().
  * As such, no attempt is made to minimize storage use,
  * and if used more generally, would badly suffer from fragmentation.
  */
-static char* cached_allocate(os_vm_size_t nbytes)
+static char* cached_allocate_1(os_vm_size_t nbytes)
 {
     // See if either cached allocation is large enough.
     if (cached_alloc[0] && usable_size(cached_alloc[0]) >= nbytes) {
@@ -196,7 +201,7 @@ static char* cached_allocate(os_vm_size_t nbytes)
  * which is why the length is specified again.
  * If returning it to the OS and not the cache, then don't bother 0-filling.
  */
-static void cached_deallocate(char* mem, uword_t zero_fill_length)
+static void cached_deallocate_1(char* mem, uword_t zero_fill_length)
 {
     int line = 0;
     if (!cached_alloc[0]) {
@@ -223,6 +228,23 @@ static void cached_deallocate(char* mem, uword_t zero_fill_length)
     memset(mem, 0, zero_fill_length);
     cached_alloc[line] = mem;
 }
+
+/// Striped tables may resize on several threads at once, so the cache
+/// needs a lock. It is held only briefly and never across a wait.
+static int cache_lock;
+static char* cached_allocate(os_vm_size_t nbytes)
+{
+    while (__sync_lock_test_and_set(&cache_lock, 1)) ;
+    char* result = cached_allocate_1(nbytes);
+    __sync_lock_release(&cache_lock);
+    return result;
+}
+static void cached_deallocate(char* mem, uword_t zero_fill_length)
+{
+    while (__sync_lock_test_and_set(&cache_lock, 1)) ;
+    cached_deallocate_1(mem, zero_fill_length);
+    __sync_lock_release(&cache_lock);
+}
 #endif
 
 /* Initialize 'ht' for 'size' logical bins with a max hop of 'hop_range'.
@@ -273,7 +295,25 @@ static void hopscotch_realloc(tableptr ht, int size, char hop_range)
     ht->values    = ht->value_size ? (sword_t*)(ht->hops + size) : 0;
 }
 
-/// Same as SB-KERNEL:%SXHASH-SIMPLE-STRING
+/// Same as SB-IMPL::%SXHASH-SIMPLE-SUBSTRING of the whole string.
+/// Characters are taken 32 bits each, N_WORD_BITS/32 to a word, and two
+/// words at a time are folded in with a full-width multiply.
+#ifdef LISP_FEATURE_64_BIT
+typedef __uint128_t string_hash_product_t;
+#else
+typedef uint64_t string_hash_product_t;
+#endif
+static inline uword_t string_hash_mum(uword_t x, uword_t y)
+{
+    string_hash_product_t p = (string_hash_product_t)x * y;
+    return (uword_t)p ^ (uword_t)(p >> N_WORD_BITS);
+}
+#define STRING_HASH_K1 (uword_t)0xa0761d6478bd642fULL
+#define STRING_HASH_K2 (uword_t)0xe7037ed1a0b428dbULL
+#define STRING_HASH_K3 (uword_t)0x8ebc6af09c88c6e3ULL
+#define STRING_HASH_SEED (uword_t)0x589965cc75374cc3ULL
+#define CHARS_PER_WORD (N_WORD_BITS/32)
+
 uword_t sxhash_simple_string(struct vector* string)
 {
 #ifdef SIMPLE_CHARACTER_STRING_WIDETAG
@@ -281,22 +321,21 @@ uword_t sxhash_simple_string(struct vector* string)
 #endif
     unsigned char* base_string = (unsigned char*)(string->data);
     sword_t len = vector_len(string);
-    uword_t result = 0;
-    sword_t i;
-    switch (widetag_of(&string->header)) {
-#define MIX(ch) {result += ch; result += result<<10; result ^= (result>>6);}
+    uword_t result = STRING_HASH_SEED;
+    sword_t i, j;
+    int character_string = 0;
 #ifdef SIMPLE_CHARACTER_STRING_WIDETAG
-    case SIMPLE_CHARACTER_STRING_WIDETAG:
-        for(i=0;i<len;++i) MIX(char_string[i])
-        break;
+    character_string = widetag_of(&string->header) == SIMPLE_CHARACTER_STRING_WIDETAG;
 #endif
-    case SIMPLE_BASE_STRING_WIDETAG:
-        for(i=0;i<len;++i) MIX(base_string[i])
-        break;
+#define CHAR(i) (character_string ? char_string[i] : base_string[i])
+    for (i = 0; i < len; i += 2*CHARS_PER_WORD) {
+        uword_t w[2] = {0, 0};
+        for (j = 0; j < 2*CHARS_PER_WORD && i + j < len; ++j)
+            w[j / CHARS_PER_WORD] |= (uword_t)CHAR(i + j) << (32 * (j % CHARS_PER_WORD));
+        result = string_hash_mum(w[0] ^ STRING_HASH_K1, w[1] ^ result);
     }
-    result += result << 3;
-    result ^= result >> 11;
-    result ^= result << 15;
+#undef CHAR
+    result = string_hash_mum(result ^ STRING_HASH_K2, (uword_t)len ^ STRING_HASH_K3);
     result &= (~(uword_t)0) >> (1+N_FIXNUM_TAG_BITS);
     return result;
 }
@@ -640,6 +679,48 @@ int hopscotch_insert(tableptr ht, uword_t key, sword_t val)
 #define tally_miss(table,n)
 #endif
 
+#ifdef HOPSCOTCH_VECTOR_PROBE
+/// Compare 'key' against the 8 keys starting at 'keys' at once, returning
+/// a bitmask of the matching cells. Reading 8 cells from any logical bin
+/// stays within the key array only if the hop range is a multiple of 8,
+/// which it is unless the creator of the table asked for something odd.
+#define vector_probe_p(ht) !(ht->hop_range & 7)
+__attribute__((target("avx2")))
+static unsigned match8_avx2(uword_t* keys, uword_t key)
+{
+    __m256i k = _mm256_set1_epi64x(key);
+    __m256i lo = _mm256_cmpeq_epi64(_mm256_loadu_si256((__m256i*)keys), k);
+    __m256i hi = _mm256_cmpeq_epi64(_mm256_loadu_si256((__m256i*)(keys+4)), k);
+    return _mm256_movemask_pd(_mm256_castsi256_pd(lo))
+        | _mm256_movemask_pd(_mm256_castsi256_pd(hi)) << 4;
+}
+static unsigned match8_sse2(uword_t* keys, uword_t key)
+{
+    // SSE2 has no 64-bit compare: a cell matches if both of its halves do
+    __m128i k = _mm_set1_epi64x(key);
+    unsigned bits = 0;
+    int i;
+    for (i = 0; i < 8; i += 2) {
+        __m128i c = _mm_cmpeq_epi32(_mm_loadu_si128((__m128i*)(keys+i)), k);
+        c = _mm_and_si128(c, _mm_shuffle_epi32(c, _MM_SHUFFLE(2,3,0,1)));
+        bits |= _mm_movemask_pd(_mm_castsi128_pd(c)) << i;
+    }
+    return bits;
+}
+/// Return the physical index of 'key' in the neighborhood of logical bin
+/// 'index' whose occupied cells are 'bits', or -1 if not there.
+static inline int vector_probe(tableptr ht, int index, unsigned bits, uword_t key)
+{
+    for ( ; bits ; bits >>= 8, index += 8)
+        if (bits & 0xff) {
+            unsigned hits = bits & 0xff &
+                (avx2_supported ? match8_avx2 : match8_sse2)(ht->keys + index, key);
+            if (hits) return index + ffs(hits) - 1;
+        }
+    return -1;
+}
+#endif
+
 /* Test for membership in a hashset. Return 1 or 0. */
 int hopscotch_containsp(tableptr ht, uword_t key)
 {
@@ -654,8 +735,10 @@ int hopscotch_containsp(tableptr ht, uword_t key)
                 return 1;
         return 0;
     }
+#ifdef HOPSCOTCH_VECTOR_PROBE
+    if (vector_probe_p(ht)) return vector_probe(ht, index, bits, key) >= 0;
+#endif
     // *** Use care when modifying this code, and benchmark it thoroughly! ***
-    // TODO: use XMM register to test 2 keys at once if properly aligned.
     if (bits & 0xff) {
         probe((1<<0), index+0, return 1);
         probe((1<<1), index+1, return 1);
@@ -702,6 +785,12 @@ sword_t hopscotch_get(tableptr ht, uword_t key, sword_t notfound)
             if ((bits & 1) && ht->compare(ht->keys[index], key))
                 goto found0;
         }
+#ifdef HOPSCOTCH_VECTOR_PROBE
+    else if (vector_probe_p(ht)) {
+        int found = vector_probe(ht, index, bits, key);
+        if (found >= 0) { index = found; goto found0; }
+    }
+#endif
     else for ( ; bits ; bits >>= 4, index += 4)
         if (bits & 0xf) {
             probe(1, index+0, goto found0);
@@ -718,6 +807,27 @@ found0:
     return get_val(ht, index);
 }
 
+/* Look up 'n' keys at once, storing into 'values' the value associated with
+ * each, or 'notfound'. This overlaps the cache misses of a batch of keys by
+ * prefetching all their neighborhoods before probing any of them. */
+#define GET_MANY_BATCH 16
+void hopscotch_get_many(tableptr ht, uword_t* keys, int n,
+                        sword_t* values, sword_t notfound)
+{
+    int start, i;
+    for (start = 0; start < n; start += GET_MANY_BATCH) {
+        int end = start + GET_MANY_BATCH < n ? start + GET_MANY_BATCH : n;
+        if (!ht->compare)
+            for (i = start; i < end; ++i) {
+                int index = hash(ht, keys[i]) & ht->mask;
+                __builtin_prefetch(&ht->hops[index]);
+                __builtin_prefetch(&ht->keys[index]);
+            }
+        for (i = start; i < end; ++i)
+            values[i] = hopscotch_get(ht, keys[i], notfound);
+    }
+}
+
 /* Return the address of the value associated with 'key',
    insert 'key' with value 0 if it was not found. */
 void* hopscotch_get_ref(tableptr ht, uword_t key)
@@ -731,6 +841,12 @@ void* hopscotch_get_ref(tableptr ht, uword_t key)
             if ((bits & 1) && ht->compare(ht->keys[index], key))
                 goto found0;
         }
+#ifdef HOPSCOTCH_VECTOR_PROBE
+    else if (vector_probe_p(ht)) {
+        int found = vector_probe(ht, index, bits, key);
+        if (found >= 0) { index = found; goto found0; }
+    }
+#endif
     else for ( ; bits ; bits >>= 4, index += 4)
         if (bits & 0xf) {
             probe(1, index+0, goto found0);
@@ -771,6 +887,12 @@ int hopscotch_put(tableptr ht, uword_t key, sword_t val)
             if ((bits & 1) && ht->compare(ht->keys[index], key))
                 goto found0;
         }
+#ifdef HOPSCOTCH_VECTOR_PROBE
+    else if (vector_probe_p(ht)) {
+        int found = vector_probe(ht, index, bits, key);
+        if (found >= 0) { index = found; goto found0; }
+    }
+#endif
     else for ( ; bits ; bits >>= 4, index += 4 )
         if (bits & 0xf) {
             probe(1, index+0, goto found0);
@@ -815,6 +937,107 @@ boolean hopscotch_delete(tableptr ht, uword_t key)
     return 1;
 }
 
+/// Striped tables
+
+static inline struct hopscotch_stripe*
+lock_stripe(struct hopscotch_striped_table* st, uword_t key)
+{
+    // Take the top bits of a multiplicative hash, so that the choice of
+    // stripe is not correlated with the bin that 'key' gets in the stripe
+    uint32_t h = st->hash(key) * 0x9E3779B1U;
+    struct hopscotch_stripe* stripe = &st->stripes[h >> 28];
+    while (__sync_lock_test_and_set(&stripe->lock, 1)) ;
+    return stripe;
+}
+#define unlock_stripe(stripe) __sync_lock_release(&stripe->lock)
+
+void hopscotch_striped_create(struct hopscotch_striped_table* st, int hashfun,
+                              int bytes_per_value, int size, char hop_range)
+{
+    gc_assert(HOPSCOTCH_N_STRIPES == 16); // lock_stripe() takes 4 bits
+    int stripe_size = size / HOPSCOTCH_N_STRIPES;
+    if (stripe_size < 32) stripe_size = 32;
+    int i;
+    for (i = 0; i < HOPSCOTCH_N_STRIPES; ++i) {
+        hopscotch_create(&st->stripes[i].table, hashfun,
+                         bytes_per_value, stripe_size, hop_range);
+        st->stripes[i].lock = 0;
+    }
+    // A stripe may switch from the default hash to hmix when it resizes,
+    // so the stripe can't be chosen with the stripe's own hash.
+    // Tables with a custom comparator have a fixed hash which must be used,
+    // since keys that compare equal must land in the same stripe.
+    st->hash = st->stripes[0].table.compare ? st->stripes[0].table.hash
+        : hopscotch_hmix;
+}
+
+void hopscotch_striped_destroy(struct hopscotch_striped_table* st)
+{
+    int i;
+    for (i = 0; i < HOPSCOTCH_N_STRIPES; ++i)
+        hopscotch_destroy(&st->stripes[i].table);
+}
+
+/* Not thread-safe: call when no other thread is using the table */
+void hopscotch_striped_reset(struct hopscotch_striped_table* st)
+{
+    int i;
+    for (i = 0; i < HOPSCOTCH_N_STRIPES; ++i)
+        hopscotch_reset(&st->stripes[i].table);
+}
+
+/* Add 'key' with 'val' unless it is present.
+ * Return 1 if this call inserted it, 0 if it was already there */
+int hopscotch_striped_insert(struct hopscotch_striped_table* st,
+                             uword_t key, sword_t val)
+{
+    struct hopscotch_stripe* stripe = lock_stripe(st, key);
+    int inserted = !hopscotch_containsp(&stripe->table, key);
+    if (inserted) hopscotch_insert(&stripe->table, key, val);
+    unlock_stripe(stripe);
+    return inserted;
+}
+
+/* Add 'key' with 'val' unless it is present, and otherwise lower its value
+ * to 'val' if that is less, as unsigned words. Whatever order threads come
+ * in, each key ends up with the least value any of them gave it.
+ * The table must have word-sized values, none of which is 0 */
+void hopscotch_striped_insert_min(struct hopscotch_striped_table* st,
+                                  uword_t key, sword_t val)
+{
+    struct hopscotch_stripe* stripe = lock_stripe(st, key);
+    gc_dcheck(stripe->table.value_size == N_WORD_BYTES);
+    uword_t* ref = hopscotch_get_ref(&stripe->table, key); // inserts 0 if absent
+    if (*ref == 0 || (uword_t)val < *ref) *ref = val;
+    unlock_stripe(stripe);
+}
+
+int hopscotch_striped_containsp(struct hopscotch_striped_table* st, uword_t key)
+{
+    // Even readers lock, because an insert can move keys between cells
+    struct hopscotch_stripe* stripe = lock_stripe(st, key);
+    int found = hopscotch_containsp(&stripe->table, key);
+    unlock_stripe(stripe);
+    return found;
+}
+
+sword_t hopscotch_striped_get(struct hopscotch_striped_table* st,
+                              uword_t key, sword_t notfound)
+{
+    struct hopscotch_stripe* stripe = lock_stripe(st, key);
+    sword_t val = hopscotch_get(&stripe->table, key, notfound);
+    unlock_stripe(stripe);
+    return val;
+}
+
+/* Not thread-safe: call when no other thread is using the table */
+int hopscotch_striped_count(struct hopscotch_striped_table* st)
+{
+    int i, n = 0;
+    for (i = 0; i < HOPSCOTCH_N_STRIPES; ++i) n += st->stripes[i].table.count;
+    return n;
+}
+
 #if 0
 #include <stdio.h>
 int popcount(unsigned x)
@@ -39,6 +39,7 @@ void hopscotch_destroy(struct hopscotch_table*);
 int hopscotch_insert(struct hopscotch_table*,uword_t,sword_t);
 int hopscotch_put(struct hopscotch_table*,uword_t,sword_t);
 sword_t hopscotch_get(struct hopscotch_table*,uword_t,sword_t);
+void hopscotch_get_many(struct hopscotch_table*,uword_t*,int,sword_t*,sword_t);
 void* hopscotch_get_ref(struct hopscotch_table*,uword_t);
 int hopscotch_containsp(struct hopscotch_table*,uword_t);
 boolean hopscotch_delete(struct hopscotch_table*,uword_t);
@@ -47,6 +48,31 @@ void hopscotch_log_stats(struct hopscotch_table*,char*);
 
 uint32_t hopscotch_hmix(uword_t);
 
+/* A table that several threads may use at once. Keys are spread by hash
+ * over independent tables, each guarded by its own spinlock, so threads
+ * contend only when they touch the same stripe. Resizing a stripe locks
+ * nothing else. The operations are those the collector needs when pinning
+ * or coalescing in parallel: insert-if-absent, membership, lookup, and
+ * lowering a value toward the least of several. */
+#define HOPSCOTCH_N_STRIPES 16
+struct hopscotch_stripe {
+    struct hopscotch_table table;
+    int lock;
+} __attribute__((aligned(64))); // keep locks on separate cache lines
+struct hopscotch_striped_table {
+    struct hopscotch_stripe stripes[HOPSCOTCH_N_STRIPES];
+    uint32_t (*hash)(uword_t); // picks the stripe, fixed at creation
+};
+
+void hopscotch_striped_create(struct hopscotch_striped_table*,int,int,int,char);
+void hopscotch_striped_destroy(struct hopscotch_striped_table*);
+void hopscotch_striped_reset(struct hopscotch_striped_table*);
+int hopscotch_striped_insert(struct hopscotch_striped_table*,uword_t,sword_t);
+void hopscotch_striped_insert_min(struct hopscotch_striped_table*,uword_t,sword_t);
+int hopscotch_striped_containsp(struct hopscotch_striped_table*,uword_t);
+sword_t hopscotch_striped_get(struct hopscotch_striped_table*,uword_t,sword_t);
+int hopscotch_striped_count(struct hopscotch_striped_table*);
+
 #define HOPSCOTCH_HASH_FUN_DEFAULT 1
 #define HOPSCOTCH_HASH_FUN_MIX 2
 #define HOPSCOTCH_STRING_HASH 3
@@ -48,6 +48,7 @@
 #include "gc.h"
 #include "gc-internal.h"
 #include "gc-private.h"
+#include "gencgc-private.h"
 #include "genesis/gc-tables.h"
 #include "genesis/cons.h"
 #include "genesis/vector.h"
@@ -111,6 +112,10 @@ unsigned int immobile_scav_queue_count;
 // Ignore the write-protect bits and the generations when comparing attributes
 #define ATTRIBUTES_MATCH_P(page_attr,specified_attr) \
   ((page_attr & 0xFFFF3F) == specified_attr)
+// Set while a thread allocates on the page (see alloc_immobile_fixedobj).
+// It is outside the bits that get compared, so an owned page
+// never matches the attributes sought by another thread.
+#define OWNED_PAGE_ATTR (1<<16)
 #define SET_WP_FLAG(index,flag) \
   fixedobj_pages[index].attr.parts.flags = (fixedobj_pages[index].attr.parts.flags & 0x3F) | flag
 
@@ -176,9 +181,18 @@ unsigned char varyobj_page_gens_augmented(low_page_index_t page_index)
 /* Return the index of an immobile page that is probably not totally full,
    starting with 'hint_page' and wrapping around.
    'attributes' determine an eligible page.
+   The caller becomes the owner of the page, which no other thread
+   can obtain until it is released.
    *FIXEDOBJ-SPACE-FREE-POINTER* is updated to point beyond the found page
    if it previously did not. */
 
+static inline boolean own_page(int page, int page_attr_packed)
+{
+    return __sync_bool_compare_and_swap(&fixedobj_pages[page].attr.packed,
+                                        page_attr_packed,
+                                        page_attr_packed | OWNED_PAGE_ATTR);
+}
+
 static int get_freeish_page(int hint_page, int attributes)
 {
   int page = hint_page;
@@ -197,7 +211,7 @@ static int get_freeish_page(int hint_page, int attributes)
       if (page_attr_packed == 0)
           if ((page_attr_packed =
                __sync_val_compare_and_swap(&fixedobj_pages[page].attr.packed,
-                                           0, attributes)) == 0) {
+                                           0, attributes | OWNED_PAGE_ATTR)) == 0) {
               // Atomically assign MAX(old_free_pointer, new_free_pointer)
               // into the free pointer.
               new_free_pointer = fixedobj_page_address(page+1);
@@ -219,8 +233,8 @@ static int get_freeish_page(int hint_page, int attributes)
           // because then touching the young object forces scanning the page,
           // which is unfortunate if most things on it were untouched.
           if (fixedobj_pages[page].gens < (1<<PSEUDO_STATIC_GENERATION)) {
-            // instant win
-            return page;
+            // instant win, unless another thread just took it
+            if (own_page(page, page_attr_packed)) return page;
           } else if (fixedobj_pages[page].gens < best_genmask) {
             best_genmask = fixedobj_pages[page].gens;
             best_page = page;
@@ -228,39 +242,30 @@ static int get_freeish_page(int hint_page, int attributes)
       }
       if (++page >= npages) page = 0;
   } while (page != hint_page);
-  if (best_page >= 0)
-      return best_page;
+  if (best_page >= 0) {
+      page_attr_packed = fixedobj_pages[best_page].attr.packed;
+      if (ATTRIBUTES_MATCH_P(page_attr_packed, attributes)
+          && !page_full_p(best_page) && own_page(best_page, page_attr_packed))
+          return best_page;
+      // Lost a race for it. Look again.
+      return get_freeish_page(hint_page, attributes);
+  }
   lose("No more immobile pages available");
 }
 
 /// Size class is specified by lisp now
-#define MAX_ALLOCATOR_SIZE_CLASSES 10
 long fixedobj_page_hint[MAX_ALLOCATOR_SIZE_CLASSES];
 
 // Unused, but possibly will be for some kind of collision-avoidance scheme
 // on claiming of new free pages.
 long immobile_alloc_collisions;
 
-/* Beginning at page index *hint, attempt to find space
-   for an object on a page with page_attributes. Write its header word
-   and return a C (native) pointer. The start page MUST have the proper
-   characteristisc, but might be totally full.
+/* Find space for an object of the given size class, starting on the
+   calling thread's current page for that size class. Write its header word
+   and return the object, tagged.
 
    Precondition: Lisp has established a pseudo-atomic section. */
 
-/* There is a slightly different algorithm that would probably be faster
-   than what is currently implemented:
-   - hint should be the address of a word that you try to claim
-     as an object header; it moves from high-to-low instead of low-to-high.
-     It's easier to compute the page base than the last valid object start
-     if there are some wasted words at the end due to page size not being
-     a perfect multiple of object size.
-   - you do a CAS into that word, and either suceed or fail
-   - if you succeed, subtract the object spacing and compare
-     to the page's base address, which can be computed by
-     masking. if the next address is above or equal to the page start,
-     store it in the hint, otherwise mark the page full */
-
 lispobj AMD64_SYSV_ABI
 alloc_immobile_fixedobj(int size_class, int spacing_words, uword_t header)
 {
@@ -268,86 +273,82 @@ alloc_immobile_fixedobj(int size_class, int spacing_words, uword_t header)
   spacing_words = fixnum_value(spacing_words);
   header = fixnum_value(header);
 
-  int page;
   lispobj word;
-  char * page_data, * obj_ptr, * next_obj_ptr, * limit, * next_free;
+  char * page_data, * obj_ptr, * limit;
   int page_attributes = MAKE_ATTR(spacing_words);
   int spacing_in_bytes = spacing_words << WORD_SHIFT;
   const int npages = FIXEDOBJ_SPACE_SIZE / IMMOBILE_CARD_BYTES;
 
-  page = fixedobj_page_hint[size_class];
-  if (!page) page = get_freeish_page(0, page_attributes);
-  /* BUG: This assertion is itself buggy and has to be commented out
-   * if running with extra debug assertions.
-   * It's only OK in single-threaded code, but consider two threads:
-   *   Thread A                          Thread B
-   *   --------                          --------
-   *   1. change attributes  of
-   *      page 483 (e.g.) from 0
-   *      to something
-   *                                     2. observe that page 483 has
-   *                                        desired page_attributes,
-   *                                        and return it from get_freeish_page
-   *                                     3. read the now-obsolete value of
-   *                                        fixedobj_free_pointer at the dcheck.
-   *   4. bump the free pointer to
-   *      the end of page 483
-   *      and return that page
-   *                                     5. FAIL the dcheck
-   *   5. pass the dcheck */
-  // gc_dcheck(fixedobj_page_address(page) < (void*)fixedobj_free_pointer);
+  /* Like a TLAB, each thread has a current page per size class.
+   * The thread owns the page, so it can claim cells without atomic
+   * operations. Only obtaining a new page needs any. The page hint is
+   * now just where the search for a new page starts. */
+  int* current_page = &thread_extra_data(get_sb_vm_thread())->fixedobj_alloc_page[size_class];
+  int page = *current_page;
+  if (!page) page = get_freeish_page(fixedobj_page_hint[size_class], page_attributes);
   do {
       page_data = fixedobj_page_address(page);
       obj_ptr = page_data + fixedobj_pages[page].free_index;
       limit = page_data + IMMOBILE_CARD_BYTES - spacing_in_bytes;
-      while (obj_ptr <= limit) {
+      for ( ; obj_ptr <= limit ; obj_ptr += spacing_in_bytes ) {
           word = *(lispobj*)obj_ptr;
-          next_obj_ptr = obj_ptr + spacing_in_bytes;
-          if (fixnump(word) // a fixnum marks free space
-              && __sync_bool_compare_and_swap((lispobj*)obj_ptr,
-                                              word, header)) {
+          if (fixnump(word)) { // a fixnum marks free space
+              *(lispobj*)obj_ptr = header;
               // The value formerly in the header word was the offset to
               // the next hole. Use it to update the freelist pointer.
-              // Just slam it in.
-              fixedobj_pages[page].free_index = next_obj_ptr + word - page_data;
+              fixedobj_pages[page].free_index =
+                  obj_ptr + spacing_in_bytes + word - page_data;
+              *current_page = page;
               return compute_lispobj((lispobj*)obj_ptr);
           }
-          // If some other thread updated the free_index
-          // to a larger value, use that. (See example below)
-          next_free = page_data + fixedobj_pages[page].free_index;
-          obj_ptr = next_free > next_obj_ptr ? next_free : next_obj_ptr;
       }
       set_page_full(page);
-      int old_page = page;
+      __sync_fetch_and_and(&fixedobj_pages[page].attr.packed, ~OWNED_PAGE_ATTR);
+      *current_page = 0;
       page = get_freeish_page(page+1 >= npages ? 0 : page+1,
                               page_attributes);
-      // try to update the hint
-      __sync_val_compare_and_swap(&fixedobj_page_hint[size_class],
-                                  old_page, page);
+      fixedobj_page_hint[size_class] = page;
   } while (1);
 }
 
-/*
-Example: Conside the freelist initially pointing to word index 6
-Threads A, and B, and C each want to claim index 6.
-- Thread A wins and then is switched out immediately after the CAS.
-- Thread B fails to claim cell 6, claims cell 12 instead.
-- Thread C fails to claim a cell and is switched out immediately
-  after the CAS.
-- Thread B writes the index of the next hole, cell 18 into the
-  page's freelist cell.
-- Thread A wakes up and writes 12 into the freelist cell.
-- Thread C wakes up sees 12 for next_offset. 12 is greater than 6,
-  so it sets its next probe location to 12.
-  It fails the fixnump(header) test.
-- Thread C sees that next_offset is still 12,
-  so it skips by the page's object spacing instead, and will continue
-  to do so until hitting the end of the page.
-*/
+/* Give up the pages that 'th' allocates on. This is done when the thread
+ * exits, and for all threads in GC, since sweeping can free or empty pages */
+void immobile_space_release_thread_pages(struct thread* th)
+{
+    int* pages = thread_extra_data(th)->fixedobj_alloc_page;
+    int i;
+    for (i = 0; i < MAX_ALLOCATOR_SIZE_CLASSES; ++i)
+        if (pages[i]) {
+            __sync_fetch_and_and(&fixedobj_pages[pages[i]].attr.packed, ~OWNED_PAGE_ATTR);
+            pages[i] = 0;
+        }
+}
 
 //// The collector
 
 // Find the high water marks for this GC scavenge phase
+#ifdef LISP_FEATURE_SOFT_CARD_MARKS
+/* Return true if a card mark that the store barrier sets on a write to
+ * fixedobj page PAGE is marked. The card table is sized for dynamic space,
+ * so these marks are shared with dynamic space cards. An unmarked card
+ * proves that the page was not written, but a marked one does not prove
+ * that it was. */
+static boolean fixedobj_page_cards_marked_p(low_page_index_t page)
+{
+    char* addr = fixedobj_page_address(page);
+    char* end = addr + IMMOBILE_CARD_BYTES;
+    for ( ; addr < end ; addr += GENCGC_CARD_BYTES)
+        if (gc_card_mark[addr_to_card_index(addr)] != CARD_UNMARKED) return 1;
+    return 0;
+}
+// A write-protected page needs the MMU only if its card marks can't tell
+// whether it was written. Otherwise the barrier's mark does the job.
+#define fixedobj_page_needs_mprotect(i) \
+  (fixedobj_page_wp(i) && fixedobj_page_cards_marked_p(i))
+#else
+#define fixedobj_page_needs_mprotect(i) fixedobj_page_wp(i)
+#endif
+
 // (avoid passing exactly IMMOBILE_SPACE_END, which has no page index)
 #define calc_max_used_fixedobj_page() find_fixedobj_page_index(fixedobj_free_pointer-1)
 #define calc_max_used_varyobj_page() find_varyobj_page_index(varyobj_free_pointer-1)
@@ -367,8 +368,20 @@ void update_immobile_nursery_bits()
   for (page=0; page <= max_used_fixedobj_page ; ++page) {
       // any page whose free index changed contains nursery objects
       if (fixedobj_pages[page].free_index >> WORD_SHIFT !=
-          fixedobj_pages[page].prior_gc_free_word_index)
+          fixedobj_pages[page].prior_gc_free_word_index) {
           fixedobj_pages[page].gens |= 1;
+#ifdef LISP_FEATURE_SOFT_CARD_MARKS
+          // Allocation has no store barrier, and the page might not
+          // have been protected by the MMU to catch it.
+          if (fixedobj_page_wp(page)) SET_WP_FLAG(page, WRITE_PROTECT_CLEARED);
+#endif
+      }
+#ifdef LISP_FEATURE_SOFT_CARD_MARKS
+      // Read the marks of pages that were protected only by their cards
+      // before this GC starts unmarking the aliased dynamic space cards.
+      if (fixedobj_page_wp(page) && fixedobj_page_cards_marked_p(page))
+          SET_WP_FLAG(page, WRITE_PROTECT_CLEARED);
+#endif
 #ifdef VERIFY_PAGE_GENS
       check_fixedobj_page(page, 0xff, 0xff);
 #endif
@@ -697,14 +710,17 @@ void write_protect_immobile_space()
 
     // Now find contiguous ranges of pages that are protectable,
     // minimizing the number of system calls as much as possible.
+    // With soft card marks, a page whose cards are all unmarked is left
+    // alone, and the next GC sees from its marks whether it was written.
     int i, start = -1, end = -1; // inclusive bounds on page indices
     low_page_index_t max_used_fixedobj_page = calc_max_used_fixedobj_page();
     for (i = max_used_fixedobj_page ; i >= 0 ; --i) {
-        if (fixedobj_page_wp(i)) {
+        boolean protect = fixedobj_page_needs_mprotect(i);
+        if (protect) {
             if (end < 0) end = i;
             start = i;
         }
-        if (end >= 0 && (!fixedobj_page_wp(i) || i == 0)) {
+        if (end >= 0 && (!protect || i == 0)) {
             os_protect(fixedobj_page_address(start),
                        IMMOBILE_CARD_BYTES * (1 + end - start),
                        OS_VM_PROT_READ|OS_VM_PROT_EXECUTE);
@@ -1014,6 +1030,8 @@ sweep_fixedobj_pages(int raise)
         dprintf((logfile,"page %d: %d holes\n", page, n_holes));
     }
     memset(fixedobj_page_hint, 0, sizeof fixedobj_page_hint);
+    struct thread* th;
+    for_each_thread(th) immobile_space_release_thread_pages(th);
 }
 
 static void make_filler(void* where, int nbytes)
@@ -1714,6 +1732,44 @@ static void fixup_space(lispobj* where, size_t n_words)
     }
 }
 
+static uword_t fixup_range(lispobj* where, lispobj* end,
+                           uword_t __attribute__((unused)) arg)
+{
+    fixup_space(where, end - where);
+    return 0;
+}
+
+/* fixup_space() writes only to the object it is looking at, and reads
+ * other objects only to find their forwarding pointer or layout, none of
+ * which change while fixing up. So disjoint ranges of objects can be fixed
+ * up by the GC helper threads at the same time. Code in varyobj tempspace
+ * is divided by component, as the components are laid out contiguously
+ * in the order of the code_component_order[] array */
+#define FIXUP_COMPONENT_CHUNK 512
+struct code_fixup_job {
+    int* components;
+    page_index_t n_components;
+    lispobj code_end; // logical address just past the last component
+    page_index_t cursor;
+};
+static lispobj component_vaddr(struct code_fixup_job* job, page_index_t i)
+{
+    for ( ; i < job->n_components ; ++i)
+        if (job->components[i*2+1]) return job->components[i*2+1];
+    return job->code_end;
+}
+static void fixup_components_task(int __attribute__((unused)) worker, void* arg)
+{
+    struct code_fixup_job* job = arg;
+    page_index_t i, end;
+    while ((i = gc_claim_chunk(&job->cursor, FIXUP_COMPONENT_CHUNK,
+                               job->n_components, &end)) >= 0) {
+        lispobj start = component_vaddr(job, i), limit = component_vaddr(job, end);
+        if (start < limit)
+            fixup_space(tempspace_addr((void*)start), (limit - start) >> WORD_SHIFT);
+    }
+}
+
 int* immobile_space_reloc_index;
 int* immobile_space_relocs;
 
@@ -2238,13 +2294,26 @@ static void defrag_immobile_space(boolean verbose)
     fixup_space((lispobj*)FIXEDOBJ_SPACE_START,
                 FIXEDOBJ_SPACE_SIZE >> WORD_SHIFT);
 #endif
-    fixup_space((lispobj*)varyobj_tempspace.start,
-                varyobj_tempspace.n_bytes >> WORD_SHIFT);
+    lispobj code_end = VARYOBJ_SPACE_START;
+    if (components && gc_n_threads > 1) {
+        struct code_fixup_job job = {
+            components, 0, VARYOBJ_SPACE_START + n_code_bytes, 0 };
+        while (components[job.n_components*2]) ++job.n_components;
+#ifdef LISP_FEATURE_METASPACE
+        job.cursor = 1; // as above, the 0th entry was not moved
+#endif
+        gc_run_on_thread_pool(fixup_components_task, &job);
+        code_end = job.code_end;
+    }
+    // Fillers, and objects placed after the code
+    if ((int)(code_end - VARYOBJ_SPACE_START) < varyobj_tempspace.n_bytes)
+        fixup_space(tempspace_addr((void*)code_end),
+                    (varyobj_tempspace.n_bytes - (code_end - VARYOBJ_SPACE_START)) >> WORD_SHIFT);
 
     // Dynamic space
-    // We can safely ignore allocation region boundaries.
-    fixup_space((lispobj*)DYNAMIC_SPACE_START,
-                ((uword_t)dynamic_space_highwatermark() - DYNAMIC_SPACE_START) >> WORD_SHIFT);
+    // Free pages are all zero, so only the used blocks need fixing up.
+    uword_t unused_args[GC_MAX_THREADS] = {0};
+    walk_generation_parallel(fixup_range, -1, unused_args);
 
     // Copy the spaces back where they belong.
 #if DEFRAGMENT_FIXEDOBJ_SUBSPACE
@@ -28,6 +28,8 @@ extern void scavenge_immobile_roots(generation_index_t,generation_index_t);
 extern void scavenge_immobile_newspace(void);
 extern void sweep_immobile_space(int raise);
 extern void write_protect_immobile_space(void);
+struct thread;
+extern void immobile_space_release_thread_pages(struct thread*);
 extern unsigned int immobile_scav_queue_count;
 typedef int low_page_index_t;
 
@@ -597,6 +597,86 @@ block_blockable_signals(sigset_t *old)
     thread_sigmask(SIG_BLOCK, &blockable_sigset, old);
 }
 
+/* Lazy blocking of the blockable signals, for short sections of C code
+ * that must not be interrupted by a handler that runs Lisp code or stops
+ * for GC. Blocking and restoring the mask costs two system calls, and a
+ * signal hardly ever arrives in between. So, much like pseudo-atomic in
+ * Lisp code, the section only sets a flag in the thread. A handler that
+ * finds the flag set blocks the signals in the interrupted context,
+ * remembering its mask, and sends itself the signal again, which then
+ * stays pending until the section ends and restores that mask.
+ *
+ * The section must not call into Lisp, and must not wait on another
+ * thread that may need to signal this one, as for stopping the world.
+ * Deferrable signals that have no handler take their default action
+ * within it. Sections nest: pass the value of lazy_block_signals() to
+ * lazy_unblock_signals(). */
+#if !defined LISP_FEATURE_SB_SAFEPOINT && !defined LISP_FEATURE_WIN32
+int lazy_block_signals()
+{
+    struct interrupt_data *data = &thread_interrupt_data(get_sb_vm_thread());
+    int previous = data->lazily_blocked;
+    data->lazily_blocked = 1;
+    __asm__ __volatile__ ("" : : : "memory");
+    return previous;
+}
+
+void lazy_unblock_signals(int previous)
+{
+    struct interrupt_data *data = &thread_interrupt_data(get_sb_vm_thread());
+    __asm__ __volatile__ ("" : : : "memory");
+    data->lazily_blocked = previous;
+    __asm__ __volatile__ ("" : : : "memory");
+    /* A signal can only set the flag before the store above, since once
+     * it has, all blockable signals are blocked for real */
+    if (!previous && data->lazy_block_interrupted) {
+        data->lazy_block_interrupted = 0;
+        thread_sigmask(SIG_SETMASK, &data->lazy_saved_mask, 0);
+    }
+}
+
+/* Called first thing by handlers that respect lazy blocking. Returns 1
+ * if the signal was put off until the end of the section. */
+static boolean
+defer_if_lazily_blocked(int signal, os_context_t *context)
+{
+    struct thread *thread = get_sb_vm_thread();
+    if (!thread) return 0;
+    struct interrupt_data *data = &thread_interrupt_data(thread);
+    if (!data->lazily_blocked) return 0;
+    sigset_t *sigset = os_context_sigmask_addr(context);
+    if (!data->lazy_block_interrupted) {
+        sigcopyset(&data->lazy_saved_mask, sigset);
+        data->lazy_block_interrupted = 1;
+    }
+    sigaddset_blockable(sigset);
+#ifdef LISP_FEATURE_SB_THREAD
+    pthread_kill(pthread_self(), signal);
+#else
+    kill(getpid(), signal);
+#endif
+    return 1;
+}
+#else
+/* Without SIG_STOP_FOR_GC there is nothing to gain, so block for real */
+#define defer_if_lazily_blocked(signal, context) 0
+int lazy_block_signals()
+{
+    struct interrupt_data *data = &thread_interrupt_data(get_sb_vm_thread());
+    int previous = data->lazily_blocked;
+    if (!previous) block_blockable_signals(&data->lazy_saved_mask);
+    data->lazily_blocked = 1;
+    return previous;
+}
+
+void lazy_unblock_signals(int previous)
+{
+    struct interrupt_data *data = &thread_interrupt_data(get_sb_vm_thread());
+    data->lazily_blocked = previous;
+    if (!previous) thread_sigmask(SIG_SETMASK, &data->lazy_saved_mask, 0);
+}
+#endif
+
 // Do one of two things depending on whether the specified 'where'
 // is non-null or null.
 // 1. If non-null, then alter the mask in *where, removing deferrable signals
@@ -678,34 +758,41 @@ maybe_save_gc_mask_and_block_deferrables(sigset_t *sigset)
 #ifndef LISP_FEATURE_WIN32
     struct thread *thread = get_sb_vm_thread();
     struct interrupt_data *data = &thread_interrupt_data(thread);
-    sigset_t oldset;
-    /* Obviously, this function is called when signals may not be
-     * blocked. Let's make sure we are not interrupted. */
-    block_blockable_signals(&oldset);
 #ifndef LISP_FEATURE_SB_THREAD
     /* With threads a SIG_STOP_FOR_GC and a normal GC may also want to
      * block. */
     if (data->gc_blocked_deferrables)
         lose("gc_blocked_deferrables already true");
 #endif
+    if (sigset) {
+        /* This is the sigmask of some context, so only the interrupt
+         * data needs protecting, and a lazy block will do. */
+        int lazy = lazy_block_signals();
+        if ((!data->pending_handler) &&
+            (!data->gc_blocked_deferrables)) {
+            FSHOW_SIGNAL((stderr,"/setting gc_blocked_deferrables\n"));
+            data->gc_blocked_deferrables = 1;
+            sigcopyset(&data->pending_mask, sigset);
+            sigaddset_deferrable(sigset);
+        }
+        lazy_unblock_signals(lazy);
+        return;
+    }
+    sigset_t oldset;
+    /* Obviously, this function is called when signals may not be
+     * blocked. Let's make sure we are not interrupted. The mask is
+     * changed for real below, so a lazy block would not do. */
+    block_blockable_signals(&oldset);
     if ((!data->pending_handler) &&
         (!data->gc_blocked_deferrables)) {
         FSHOW_SIGNAL((stderr,"/setting gc_blocked_deferrables\n"));
         data->gc_blocked_deferrables = 1;
-        if (sigset) {
-            /* This is the sigmask of some context. */
-            sigcopyset(&data->pending_mask, sigset);
-            sigaddset_deferrable(sigset);
-            thread_sigmask(SIG_SETMASK,&oldset,0);
-            return;
-        } else {
-            /* Operating on the current sigmask. Save oldset and
-             * unblock gc signals. In the end, this is equivalent to
-             * blocking the deferrables. */
-            sigcopyset(&data->pending_mask, &oldset);
-            unblock_gc_signals();
-            return;
-        }
+        /* Operating on the current sigmask. Save oldset and
+         * unblock gc signals. In the end, this is equivalent to
+         * blocking the deferrables. */
+        sigcopyset(&data->pending_mask, &oldset);
+        unblock_gc_signals();
+        return;
     }
     thread_sigmask(SIG_SETMASK,&oldset,0);
 #endif
@@ -1368,6 +1455,10 @@ static void
 maybe_now_maybe_later(int signal, siginfo_t *info, void *void_context)
 {
     SAVE_ERRNO(signal,context,void_context);
+    if (defer_if_lazily_blocked(signal, context)) {
+        RESTORE_ERRNO;
+        return;
+    }
     struct thread *thread = get_sb_vm_thread();
     struct interrupt_data *data = &thread_interrupt_data(thread);
     if (can_handle_now(interrupt_handle_now, data, signal, info, context))
@@ -1385,13 +1476,16 @@ pthread_mutex_t gcmetrics_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* This function must not cons, because that may trigger a GC. */
 void
-sig_stop_for_gc_handler(int __attribute__((unused)) signal,
+sig_stop_for_gc_handler(int signal,
                         siginfo_t __attribute__((unused)) *info,
                         os_context_t *context)
 {
     struct thread *thread=get_sb_vm_thread();
     boolean was_in_lisp;
 
+    if (defer_if_lazily_blocked(signal, context))
+        return;
+
     /* Test for GC_INHIBIT _first_, else we'd trap on every single
      * pseudo atomic until gc is finally allowed. */
     if (read_TLS(GC_INHIBIT,thread) != NIL) {
@@ -1448,8 +1542,10 @@ sig_stop_for_gc_handler(int __attribute__((unused)) signal,
 
     /* We say that the thread is "stopped" as of now, but the blocking operation
      * occurs below at thread_wait_until_not(STATE_STOPPED). Note that sem_post()
-     * is expressly permitted in signal handlers, and set_thread_state uses it */
-    set_thread_state(thread, STATE_STOPPED, 0);
+     * is expressly permitted in signal handlers, and set_thread_state uses it.
+     * The handler runs with all blockable signals blocked. */
+    thread_extra_data(thread)->stop_for_gc_pc = os_context_pc(context);
+    set_thread_state(thread, STATE_STOPPED, 1);
     FSHOW_SIGNAL((stderr,"suspended\n"));
 
     /* While waiting for gc to finish occupy ourselves with zeroing
@@ -41,6 +41,9 @@ extern void unblock_gc_signals(void);
 
 extern void maybe_save_gc_mask_and_block_deferrables(sigset_t *sigset);
 
+extern int lazy_block_signals(void);
+extern void lazy_unblock_signals(int previous);
+
 /* maximum signal nesting depth
  *
  * FIXME: In CMUCL this was 4096, and it was first scaled down to 256
@@ -80,6 +83,12 @@ struct interrupt_data {
      * and with no pending handler. Both deferrable interrupt handlers
      * and gc are careful not to clobber each other's pending_mask. */
     boolean gc_blocked_deferrables;
+    /* Nonzero in a section of C code that lazy_block_signals() protects.
+     * A signal arriving there sets lazy_block_interrupted and saves the
+     * mask to restore in lazy_saved_mask. */
+    int lazily_blocked;
+    boolean lazy_block_interrupted;
+    sigset_t lazy_saved_mask;
 #if defined LISP_FEATURE_MIPS || defined LISP_FEATURE_PPC \
   || defined LISP_FEATURE_PPC64 || defined LISP_FEATURE_SPARC
 #define HAVE_ALLOCATION_TRAP_CONTEXT 1
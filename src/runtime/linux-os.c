@@ -41,6 +41,7 @@
 #include <signal.h>
 /* #include <sys/sysinfo.h> */
 #include <sys/time.h>
+#include <time.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <linux/version.h>
@@ -162,9 +163,14 @@ void lisp_mutex_done_eventrecording() {
  * futexes when available.*/
 #define FUTEX_WAIT_PRIVATE (0+128)
 #define FUTEX_WAKE_PRIVATE (1+128)
+/* FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout (Linux 2.6.25) */
+#define FUTEX_WAIT_BITSET 9
+#define FUTEX_WAIT_BITSET_PRIVATE (9+128)
+#define FUTEX_BITSET_MATCH_ANY 0xffffffff
 
 /* Not static so that Lisp may query it. */
 boolean futex_private_supported_p;
+boolean futex_bitset_supported_p;
 
 static inline int
 futex_wait_op()
@@ -183,6 +189,11 @@ static inline int sys_futex(void *futex, int op, int val, struct timespec *rel)
     return syscall(SYS_futex, futex, op, val, rel);
 }
 
+static inline int sys_futex_bitset(void *futex, int op, int val, struct timespec *abs)
+{
+    return syscall(SYS_futex, futex, op, val, abs, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
 static void
 futex_init()
 {
@@ -199,6 +210,9 @@ futex_init()
         futex_private_supported_p = 0;
         SHOW("No futex private suppport\n");
     }
+    struct timespec past = {0, 0};
+    sys_futex_bitset(&x, FUTEX_WAIT_BITSET, 0, &past);
+    futex_bitset_supported_p = errno == ETIMEDOUT;
 }
 
 /* Try to guess the name of the mutex for this futex, based on knowing
@@ -247,6 +261,47 @@ futex_wait(int *lock_word, int oldval, long sec, unsigned long usec)
       return -1;
 }
 
+/* Like futex_wait, but 'sec' and 'usec' are an absolute time on the
+ * GET-INTERNAL-REAL-TIME clock, so that a caller that loops on spurious
+ * wakeups does not need to recompute a relative timeout each time, nor
+ * accumulate error in doing so. A negative 'sec' means no timeout. */
+int
+futex_wait_until(int *lock_word, int oldval, long sec, unsigned long usec)
+{
+    if (sec < 0) return futex_wait(lock_word, oldval, -1, 0);
+    /* Internal real time counts from lisp_init_time on CLOCK_MONOTONIC(_COARSE),
+     * which is the clock FUTEX_WAIT_BITSET measures absolute timeouts against */
+    extern struct timespec lisp_init_time;
+    struct timespec deadline;
+    deadline.tv_sec = lisp_init_time.tv_sec + sec;
+    deadline.tv_nsec = lisp_init_time.tv_nsec + usec * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_nsec -= 1000000000;
+        ++deadline.tv_sec;
+    }
+    if (!futex_bitset_supported_p) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long rel_sec = deadline.tv_sec - now.tv_sec;
+        long rel_nsec = deadline.tv_nsec - now.tv_nsec;
+        if (rel_nsec < 0) { rel_nsec += 1000000000; --rel_sec; }
+        if (rel_sec < 0) return 1;
+        return futex_wait(lock_word, oldval, rel_sec, rel_nsec / 1000);
+    }
+    int t = sys_futex_bitset(lock_word,
+                             futex_private_supported_p ?
+                             FUTEX_WAIT_BITSET_PRIVATE : FUTEX_WAIT_BITSET,
+                             oldval, &deadline);
+    if (t==0)
+        return 0;
+    else if (errno==ETIMEDOUT)
+        return 1;
+    else if (errno==EINTR)
+        return 2;
+    else
+        return -1;
+}
+
 int
 futex_wake(int *lock_word, int n)
 {
@@ -439,3 +494,58 @@ char *os_get_runtime_executable_path()
 
     return copied_string(path);
 }
+
+/* Minimal NUMA support without libnuma, for the allocator.
+ * The node count is 1 + the highest node number in the "online" mask,
+ * which is a list of ranges such as "0-1" or "0,2-3". */
+int os_numa_node_count()
+{
+    int fd = open("/sys/devices/system/node/online", O_RDONLY);
+    if (fd < 0) return 1;
+    char buf[128];
+    int n = read(fd, buf, sizeof buf - 1);
+    close(fd);
+    if (n <= 0) return 1;
+    buf[n] = 0;
+    int highest = 0, val = 0, i;
+    for (i = 0; i < n; ++i)
+        if (buf[i] >= '0' && buf[i] <= '9') val = val*10 + buf[i]-'0';
+        else { if (val > highest) highest = val; val = 0; }
+    if (val > highest) highest = val;
+    return 1 + highest;
+}
+
+int os_current_numa_node()
+{
+    unsigned int cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, 0) != 0) return 0;
+    return node;
+}
+
+/* Make every running thread of this process execute a full memory barrier
+ * before returning, without signalling them, using membarrier(2).
+ * Return 0 if that was done, or -1 if the kernel can't. A thread that does
+ * a store and then publishes it with only a compiler barrier can count on
+ * a thread that calls this after seeing the publication to see the store. */
+int os_process_membarrier()
+{
+#ifdef SYS_membarrier
+    // From <linux/membarrier.h>
+    const int cmd_private_expedited = 1<<3, cmd_register_private_expedited = 1<<4;
+    static int registered; // 1 = yes, -1 = not possible
+    if (!registered)
+        registered =
+            syscall(SYS_membarrier, cmd_register_private_expedited, 0) ? -1 : 1;
+    if (registered > 0 && !syscall(SYS_membarrier, cmd_private_expedited, 0))
+        return 0;
+#endif
+    return -1;
+}
+
+/* Set the memory policy of a range to prefer 'node'. Failure is harmless */
+void os_numa_prefer_node(os_vm_address_t addr, os_vm_size_t len, int node)
+{
+    unsigned long nodemask = 1UL << node;
+    const int mpol_preferred = 1; // MPOL_PREFERRED from <linux/mempolicy.h>
+    syscall(SYS_mbind, addr, len, mpol_preferred, &nodemask, 8*sizeof nodemask, 0);
+}
@@ -74,6 +74,13 @@ boolean os_preinit(char *argv[], char *envp[]);
 void os_link_runtime();
 void os_unlink_runtime();
 
+#ifdef LISP_FEATURE_LINUX
+extern int os_numa_node_count(void);
+extern int os_current_numa_node(void);
+extern void os_numa_prefer_node(os_vm_address_t addr, os_vm_size_t len, int node);
+extern int os_process_membarrier(void);
+#endif
+
 /* Do anything we need to do when starting up the runtime environment
  * in this OS. */
 extern void os_init();
@@ -33,6 +33,13 @@
 #include <errno.h>
 #include <dirent.h>
 #include <sys/syscall.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef LISP_FEATURE_LINUX
+#include <sched.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#endif
 #include "interr.h" // for lose()
 
 #ifdef LISP_FEATURE_OPENBSD
@@ -125,16 +132,80 @@ int closefrom_fddir(char *dir, int lowfd)
     return 0;
 }
 
+#ifdef LISP_FEATURE_LINUX
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
+
+/* Close the open fds from FIRST to LAST, looking for them in
+ * /proc/self/fd so that the cost depends on how many fds are open and
+ * not on RLIMIT_NOFILE. The directory is read with getdents64() into a
+ * buffer on the stack, since readdir() may call malloc(), which is
+ * prone to deadlocking in a child of a multithreaded process. Return
+ * -1 if /proc is not available. */
+static int closefds_proc(unsigned int first, unsigned int last)
+{
+    struct fd_dirent {
+        uint64_t ino;
+        int64_t off;
+        unsigned short reclen;
+        unsigned char type;
+        char name[];
+    };
+    char buf[4096] __attribute__((aligned(8)));
+    int dir = open("/proc/self/fd", O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+
+    if (dir < 0) return -1;
+    for (;;) {
+        long n = syscall(__NR_getdents64, dir, buf, sizeof buf);
+        long pos;
+        int closed = 0;
+        if (n <= 0) break;
+        for (pos = 0; pos < n; pos += ((struct fd_dirent*)(buf + pos))->reclen) {
+            char *c = ((struct fd_dirent*)(buf + pos))->name;
+            unsigned int fd = 0;
+            if (!*c || *c == '.') continue;
+            for (; *c >= '0' && *c <= '9'; c++) fd = fd * 10 + (*c - '0');
+            if (fd >= first && fd <= last && (int)fd != dir) {
+                close(fd);
+                closed = 1;
+            }
+        }
+        /* Closing fds removes entries, which may shift the ones that
+         * haven't been read yet. Start over until nothing is left. */
+        if (closed) lseek(dir, 0, SEEK_SET);
+    }
+    close(dir);
+    return 0;
+}
+#endif
+
 void closefds_range(unsigned int first, unsigned int last)
 {
     int fds_closed = 0;
     // Try using close_range syscall first.
 #if defined(LISP_FEATURE_OS_PROVIDES_CLOSE_RANGE_WRAPPER)
     // Prefer the libc wrapper, if it exists at build time.
-    fds_closed = !close_range(first, last, 0);
+#define CLOSE_RANGE(flags) close_range(first, last, flags)
 #elif defined(LISP_FEATURE_LINUX) && defined(__NR_close_range)
     // Use syscall(2) if we could detect the syscall number at build time.
-    fds_closed = !syscall(__NR_close_range, first, last, 0);
+#define CLOSE_RANGE(flags) syscall(__NR_close_range, first, last, flags)
+#endif
+#ifdef CLOSE_RANGE
+#ifdef LISP_FEATURE_LINUX
+    // Marking the fds close-on-exec (Linux 5.11) only flips bits in the
+    // fd table of the child. The exec then closes them after it has
+    // released a parent waiting in vfork, so closing 100k sockets does
+    // not hold up the parent.
+    fds_closed = !CLOSE_RANGE(CLOSE_RANGE_CLOEXEC);
+#endif
+    if (!fds_closed)
+        fds_closed = !CLOSE_RANGE(0);
+#undef CLOSE_RANGE
+#endif
+#ifdef LISP_FEATURE_LINUX
+    if (!fds_closed)
+        fds_closed = !closefds_proc(first, last);
 #endif
     // Otherwise (if the syscall information isn't availble at build time or if
     // the run time kernel doesn't support the syscall), fall back to close()
@@ -166,7 +237,12 @@ void closefds_from(int lowfd, int* dont_close)
         for (i = 0; i < length; i++)
         {
             int fd = dont_close[i];
-            closefds_range(lowfd, fd - 1);
+            /* Skip fds below LOWFD and duplicates, which would make an
+             * empty or, for fd 0, an unbounded range. */
+            if (fd < lowfd)
+                continue;
+            if (fd > lowfd)
+                closefds_range(lowfd, fd - 1);
             lowfd = fd+1;
         }
     }
@@ -176,21 +252,7 @@ void closefds_from(int lowfd, int* dont_close)
     || defined(LISP_FEATURE_SUNOS)
     closefrom(lowfd);
 #else
-    int fds_closed = 0;
-
-/* readdir() uses malloc, which is prone to deadlocking
-#ifdef LISP_FEATURE_LINUX
-    if (!fds_closed)
-        fds_closed = !closefrom_fddir("/proc/self/fd/", lowfd);
-#endif
-#ifdef LISP_FEATURE_DARWIN
-    if (!fds_closed)
-        fds_closed = !closefrom_fddir("/dev/fd/", lowfd);
-#endif
-*/
-
-    if (!fds_closed)
-        closefds_range(lowfd, ~0U);
+    closefds_range(lowfd, ~0U);
 #endif
 }
 
@@ -232,30 +294,113 @@ int wait_for_exec(int pid, int channel[2]) {
 }
 
 extern char **environ;
-int spawn(char *program, char *argv[], int sin, int sout, int serr,
-          int search, char *envp[], char *pty_name,
-          int channel[2],
-          char *pwd, int* dont_close)
+
+/* execvp() with the PATH of ENVP instead of that of the caller, as if
+ * ENVIRON had been set to ENVP first. A child that shares the address
+ * space of its parent must not set ENVIRON, and execvpe() looks at the
+ * PATH of the caller. Only returns if every exec failed. */
+static void execvp_env(char *file, char *argv[], char *envp[])
 {
-    pid_t pid;
+    char *path = "/bin:/usr/bin", **env;
+    size_t file_len = strlen(file);
+    int eacces = 0;
+
+    if (strchr(file, '/')) {
+        execve(file, argv, envp);
+        return;
+    }
+    for (env = envp; *env; env++)
+        if (!strncmp(*env, "PATH=", 5)) {
+            path = *env + 5;
+            break;
+        }
+    for (;;) {
+        char *end = path;
+        while (*end && *end != ':') end++;
+        {
+            size_t dir_len = end - path;
+            char name[dir_len + file_len + 2];
+            memcpy(name, path, dir_len);
+            /* An empty element stands for the current directory. */
+            if (dir_len) name[dir_len++] = '/';
+            memcpy(name + dir_len, file, file_len + 1);
+            execve(name, argv, envp);
+            switch (errno) {
+            case EACCES:
+                eacces = 1;
+                /* fall through */
+            case ENOENT:
+            case ENOTDIR:
+                break;
+            case ENOEXEC: {
+                /* Like execvp(), run a file without a #! line as a
+                 * shell script. */
+                int argc = 0;
+                while (argv[argc]) argc++;
+                {
+                    char *sh_argv[argc + 2];
+                    sh_argv[0] = "sh";
+                    sh_argv[1] = name;
+                    memcpy(sh_argv + 2, argv + 1, argc * sizeof (char*));
+                    execve("/bin/sh", sh_argv, envp);
+                }
+                return;
+            }
+            default:
+                return;
+            }
+        }
+        if (!*end) break;
+        path = end + 1;
+    }
+    if (eacces) errno = EACCES;
+}
+
+struct spawn_args {
+    char *program;
+    char **argv;
+    int sin, sout, serr;
+    int search;
+    char **envp;
+    char *pty_name;
+    int channel[2];
+    char *pwd;
+    int *dont_close;
+    /* nonzero if the child runs in the address space of the parent,
+     * in which case it may write to nothing but its own stack */
+    int shared_vm;
+};
+
+/* The child side of SPAWN, which never returns. */
+static int spawn_child(void *arg)
+{
+    struct spawn_args *args = arg;
+    int channel = args->channel[1];
     sigset_t sset;
     int failure_code = 2;
 
-    channel[0] = -1;
-    channel[1] = -1;
-    // Surely we can do better than to lose()
-    if (pipe(channel)) lose("can't run-program");
-
-    pid = fork();
-    if (pid) {
-        return pid;
+    if (args->shared_vm) {
+        /* The signal handlers of the parent would run on the memory of
+         * the parent. The parent blocked every signal before cloning,
+         * so none can have been delivered yet. Ignored signals stay
+         * ignored, as they would across exec. */
+        struct sigaction sa;
+        int sig;
+        for (sig = 1; sig < NSIG; sig++)
+            if (!sigaction(sig, NULL, &sa)
+                && sa.sa_handler != SIG_IGN && sa.sa_handler != SIG_DFL) {
+                sa.sa_handler = SIG_DFL;
+                sa.sa_flags = 0;
+                sigemptyset(&sa.sa_mask);
+                sigaction(sig, &sa, NULL);
+            }
     }
-    close (channel[0]);
+    close(args->channel[0]);
 
     /* Put us in our own process group, but only if we need not
      * share stdin with our parent. In the latter case we claim
      * control of the terminal. */
-    if (sin >= 0) {
+    if (args->sin >= 0) {
 #ifdef LISP_FEATURE_OPENBSD
       setsid();
 #elif defined(LISP_FEATURE_DARWIN)
@@ -274,50 +419,50 @@ int spawn(char *program, char *argv[], int sin, int sout, int serr,
     sigprocmask(SIG_SETMASK, &sset, NULL);
 
     /* If we are supposed to be part of some other pty, go for it. */
-    if (pty_name)
-        set_pty(pty_name);
+    if (args->pty_name)
+        set_pty(args->pty_name);
     else {
     /* Set up stdin, stdout, and stderr */
-    if (sin >= 0)
-        dup2(sin, 0);
-    if (sout >= 0)
-        dup2(sout, 1);
-    if (serr >= 0)
-        dup2(serr, 2);
+    if (args->sin >= 0)
+        dup2(args->sin, 0);
+    if (args->sout >= 0)
+        dup2(args->sout, 1);
+    if (args->serr >= 0)
+        dup2(args->serr, 2);
     }
     /* Close all other fds. First arrange for the pipe fd to be the
      * lowest free fd, then close every open fd above that. */
-    channel[1] = dup2(channel[1], 3);
-    closefds_from(4, dont_close);
+    channel = dup2(channel, 3);
+    closefds_from(4, args->dont_close);
 
-    if (-1 != channel[1]) {
-        if (-1==fcntl(channel[1], F_SETFD,  FD_CLOEXEC)) {
-            close(channel[1]);
-            channel[1] = -1;
+    if (-1 != channel) {
+        if (-1==fcntl(channel, F_SETFD,  FD_CLOEXEC)) {
+            close(channel);
+            channel = -1;
         }
     }
 
-    if (pwd && chdir(pwd) < 0) {
+    if (args->pwd && chdir(args->pwd) < 0) {
        failure_code = 3;
     } else {
-        if (envp) {
-            environ = envp;
-        }
         /* Exec the program. */
-        if (search)
-            execvp(program, argv);
+        char **envp = args->envp ? args->envp : environ;
+        if (!args->search)
+            execve(args->program, args->argv, envp);
+        else if (args->envp)
+            execvp_env(args->program, args->argv, envp);
         else
-            execv(program, argv);
+            execvp(args->program, args->argv);
     }
 
     /* When exec or chdir fails and channel is available, send the errno value. */
-    if (-1 != channel[1]) {
+    if (-1 != channel) {
         int our_errno = errno;
         int bytes = sizeof(int);
         int n;
         char *p = (char*)&our_errno;
         while ((bytes > 0) &&
-               (n = write(channel[1], p, bytes))) {
+               (n = write(channel, p, bytes))) {
             if (-1 == n) {
                 if (EINTR == errno) {
                     continue;
@@ -329,8 +474,87 @@ int spawn(char *program, char *argv[], int sin, int sout, int serr,
                 p += n;
             }
         }
-        close(channel[1]);
+        close(channel);
     }
     _exit(failure_code);
 }
 
+#ifdef LISP_FEATURE_LINUX
+/* Start SPAWN_CHILD in a new process that borrows our address space
+ * until it calls exec or exits, as vfork() does. Unlike fork(), that
+ * copies no page tables, so it takes as long with a huge heap as with
+ * a small one. The child gets a stack of its own, so that nothing it
+ * does can overwrite our frames. Return -1 if that cannot be done. */
+static pid_t clone_vfork(struct spawn_args *args)
+{
+    sigset_t all, old;
+    /* room for the few frames of the child, and for the arrays that
+     * execvp() and EXECVP_ENV put on the stack */
+    size_t stack_size = 65536;
+    char **p, *path;
+    void *stack;
+    pid_t pid;
+
+    for (p = args->argv; *p; p++) stack_size += sizeof (char*);
+    path = getenv("PATH");
+    if (args->envp)
+        for (p = args->envp; *p; p++)
+            if (!strncmp(*p, "PATH=", 5)) path = *p + 5;
+    if (path) stack_size += strlen(path);
+
+    stack = mmap(0, stack_size, PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) return -1;
+    args->shared_vm = 1;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    /* The stack grows down on every platform we run on. */
+    pid = clone(spawn_child, (char*)stack + stack_size,
+                CLONE_VM|CLONE_VFORK|SIGCHLD, args);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    munmap(stack, stack_size);
+    return pid;
+}
+#endif
+
+int spawn(char *program, char *argv[], int sin, int sout, int serr,
+          int search, char *envp[], char *pty_name,
+          int channel[2],
+          char *pwd, int* dont_close)
+{
+    pid_t pid;
+    struct spawn_args args;
+
+    channel[0] = -1;
+    channel[1] = -1;
+    // Surely we can do better than to lose()
+    if (pipe(channel)) lose("can't run-program");
+
+    args.program = program;
+    args.argv = argv;
+    args.sin = sin;
+    args.sout = sout;
+    args.serr = serr;
+    args.search = search;
+    args.envp = envp;
+    args.pty_name = pty_name;
+    args.channel[0] = channel[0];
+    args.channel[1] = channel[1];
+    args.pwd = pwd;
+    args.dont_close = dont_close;
+    args.shared_vm = 0;
+
+#ifdef LISP_FEATURE_LINUX
+    pid = clone_vfork(&args);
+    if (pid != -1)
+        return pid;
+    /* Maybe clone() is filtered out. fork() works everywhere. */
+    args.shared_vm = 0;
+#endif
+    pid = fork();
+    if (pid) {
+        return pid;
+    }
+    spawn_child(&args);
+    return -1; /* not reached */
+}
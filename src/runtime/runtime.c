@@ -135,6 +135,18 @@ Common runtime options:\n\
   --dynamic-space-size <MiB> Size of reserved dynamic space in megabytes.\n\
   --control-stack-size <MiB> Size of reserved control stack in megabytes.\n\
   --tls-limit                Maximum number of thread-local symbols.\n\
+  --gc-threads <n>           Number of threads to use for parts of GC.\n\
+  --gc-background-release    Return free memory to the OS from a thread.\n\
+  --gc-pause-target <ms>     Adapt the nursery size to this GC pause budget.\n\
+  --soft-heap-limit <MiB>    Collect harder as heap use nears this size.\n\
+  --gc-verify-concurrently <gen> Check the heap from <gen> up in a thread.\n\
+  --gc-verify-log <file>     Write the failures of those checks to <file>.\n\
+  --huge-pages               Use transparent huge pages for dynamic space.\n\
+  --numa                     Allocate from memory local to each thread's node.\n\
+  --object-start-bitmap      Record object starts for faster pointer lookup.\n\
+  --perf-map                 Name Lisp code in /tmp/perf-<pid>.map for perf.\n\
+  --startup-trace            Print the time taken by each phase of startup.\n\
+  --startup-trace-json <file> Write those times to <file> as JSON.\n\
 \n\
 Common toplevel options:\n\
   --sysinit <filename>       System-wide init-file to use instead of default.\n\
@@ -409,6 +421,75 @@ static int is_memsize_arg(char *argv[], int argi, int argc, int *merge_core_page
         dynamic_values_bytes = N_WORD_BYTES * atoi(argv[argi+1]);
         return 2;
     }
+#ifdef LISP_FEATURE_GENCGC
+    if (!strcmp(arg, "--gc-threads")) {
+        if ((argi+1) >= argc) lose("missing argument for --gc-threads");
+        gc_n_threads = atoi(argv[argi+1]);
+        return 2;
+    }
+    if (!strcmp(arg, "--soft-heap-limit")) {
+        extern os_vm_size_t gencgc_soft_heap_limit;
+        if ((argi+1) >= argc) lose("missing argument for --soft-heap-limit");
+        gencgc_soft_heap_limit = parse_size_arg(argv[argi+1], "--soft-heap-limit");
+        return 2;
+    }
+    if (!strcmp(arg, "--gc-pause-target")) {
+        extern unsigned int gencgc_pause_target_ms;
+        if ((argi+1) >= argc) lose("missing argument for --gc-pause-target");
+        gencgc_pause_target_ms = atoi(argv[argi+1]);
+        return 2;
+    }
+    if (!strcmp(arg, "--numa")) {
+        extern int gencgc_numa_nodes;
+        gencgc_numa_nodes = 1; // the actual count is determined later
+        return 1;
+    }
+    if (!strcmp(arg, "--huge-pages")) {
+        gencgc_huge_pages = 1;
+        return 1;
+    }
+    if (!strcmp(arg, "--gc-background-release")) {
+        extern int gencgc_release_in_background;
+        gencgc_release_in_background = 1;
+        return 1;
+    }
+    if (!strcmp(arg, "--gc-verify-concurrently")) {
+        extern int gencgc_verify_concurrently;
+        if ((argi+1) >= argc) lose("missing argument for --gc-verify-concurrently");
+        gencgc_verify_concurrently = atoi(argv[argi+1]);
+        if (gencgc_verify_concurrently < 0 || gencgc_verify_concurrently > PSEUDO_STATIC_GENERATION)
+            lose("bad generation for --gc-verify-concurrently: %s", argv[argi+1]);
+        return 2;
+    }
+    if (!strcmp(arg, "--gc-verify-log")) {
+        extern char *gencgc_verify_log;
+        if ((argi+1) >= argc) lose("missing filename for --gc-verify-log");
+        gencgc_verify_log = copied_string(argv[argi+1]);
+        return 2;
+    }
+    if (!strcmp(arg, "--object-start-bitmap")) {
+        extern int gencgc_object_start_bitmap;
+        gencgc_object_start_bitmap = 1;
+        return 1;
+    }
+#ifdef LISP_FEATURE_LINUX
+    if (!strcmp(arg, "--perf-map")) {
+        extern int perf_map_enabled;
+        perf_map_enabled = 1;
+        return 1;
+    }
+#endif
+#endif
+    if (!strcmp(arg, "--startup-trace")) {
+        startup_trace_enabled = 1;
+        return 1;
+    }
+    if (!strcmp(arg, "--startup-trace-json")) {
+        if ((argi+1) >= argc) lose("missing filename for --startup-trace-json");
+        startup_trace_enabled = 1;
+        startup_trace_json_file = copied_string(argv[argi+1]);
+        return 2;
+    }
     if (!strcmp(arg, "--merge-core-pages")) {
         *merge_core_pages = 1;
         return 1;
@@ -618,6 +699,7 @@ initialize_lisp(int argc, char *argv[], char *envp[])
 #endif
         , &lisp_init_time);
 #endif
+    startup_trace_start();
 
     /* the name of the core file we're to execute. Note that this is
      * a malloc'ed string which should be freed eventually. */
@@ -658,6 +740,7 @@ initialize_lisp(int argc, char *argv[], char *envp[])
     }
 
     struct cmdline_options options = parse_argv(memsize_options, argc, argv, core);
+    startup_trace_mark("parse-argv");
 
     /* Align down to multiple of page_table page size, and to the appropriate
      * stack alignment. */
@@ -674,6 +757,7 @@ initialize_lisp(int argc, char *argv[], char *envp[])
     // already obtained (if any) so it is unhelpful to try again here.
     allocate_lisp_dynamic_space(have_hardwired_spaces);
     gc_init();
+    startup_trace_mark("allocate-spaces");
 
     /* If no core file was specified, look for one. */
     core = options.core;
@@ -728,6 +812,7 @@ initialize_lisp(int argc, char *argv[], char *envp[])
     if (initial_function == NIL) {
         lose("couldn't find initial function");
     }
+    startup_trace_mark("load-core-file");
 
 #if defined(SVR4) || defined(__linux__) || defined(__NetBSD__) || defined(__HAIKU__)
     tzset();
@@ -740,6 +825,7 @@ initialize_lisp(int argc, char *argv[], char *envp[])
         enable_lossage_handler();
 
     os_link_runtime();
+    startup_trace_mark("os-link-runtime");
 #ifdef LISP_FEATURE_IMMOBILE_SPACE
     /* Delayed until after dynamic space has been mapped, fixups made,
      * and/or immobile-space linkage entries written,
@@ -768,6 +854,12 @@ initialize_lisp(int argc, char *argv[], char *envp[])
 
     FSHOW((stderr, "/funcalling initial_function=0x%lx\n",
           (unsigned long)initial_function));
+#if defined LISP_FEATURE_LINUX && defined LISP_FEATURE_GENCGC
+    extern int perf_map_enabled;
+    extern void perf_map_init(void);
+    if (perf_map_enabled) perf_map_init();
+#endif
+    startup_trace_mark("install-handlers");
     create_main_lisp_thread(initial_function);
     return 0;
 }
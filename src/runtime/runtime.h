@@ -402,6 +402,13 @@ struct lisp_startup_options {
 };
 extern struct lisp_startup_options lisp_startup_options;
 
+/* in startup-trace.c */
+extern int startup_trace_enabled;
+extern char *startup_trace_json_file;
+void startup_trace_start(void);
+void startup_trace_mark(const char *phase);
+void startup_trace_report(void);
+
 /* Even with just -O1, gcc optimizes the jumps in this "loop" away
  * entirely, giving the ability to define WITH-FOO-style macros. */
 #define RUN_BODY_ONCE(prefix, finally_do)               \
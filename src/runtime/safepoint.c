@@ -831,10 +831,13 @@ void thread_interrupted(os_context_t *ctxptr)
 }
 #endif
 
+static uint64_t stop_the_world_time; // for gc_pause_histogram
+
 void
 gc_stop_the_world()
 {
     struct thread* self = get_sb_vm_thread();
+    stop_the_world_time = gc_monotonic_nsec();
     odxprint(safepoints, "stop the world");
     WITH_GC_STATE_LOCK {
         /* This thread is the collector, and needs special handling in
@@ -882,16 +885,19 @@ gc_stop_the_world()
         set_thread_csp_access(self,1);
     }
     SET_THREAD_STOP_PENDING(self,NIL);
+    gc_record_pause(GC_PHASE_STOP, gc_monotonic_nsec() - stop_the_world_time);
 }
 
 
 void gc_start_the_world()
 {
     odxprint(safepoints,"%s","start the world");
+    gc_record_pause(GC_PHASE_PAUSE, gc_monotonic_nsec() - stop_the_world_time);
     WITH_GC_STATE_LOCK {
         gc_state.collector = NULL;
         gc_advance(GC_NONE,GC_COLLECT);
     }
+    finalizer_thread_wake_if_queued();
 }
 
 
@@ -44,6 +44,13 @@
 #ifdef LISP_FEATURE_SB_CORE_COMPRESSION
 # include <zlib.h>
 #endif
+#ifdef LISP_FEATURE_SB_CORE_ZSTD
+# include <zstd.h>
+#endif
+#ifdef DELTA_CORES
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 
 #define GENERAL_WRITE_FAILURE_MSG "error writing to core file"
 
@@ -75,21 +82,309 @@ write_lispobj(lispobj obj, FILE *file)
     }
 }
 
+#if defined(LISP_FEATURE_WIN32) && defined(LISP_FEATURE_64_BIT)
+#define FTELL _ftelli64
+#define FSEEK _fseeki64
+typedef __int64 ftell_type;
+#else
+#define FTELL ftell
+#define FSEEK fseek
+typedef long ftell_type;
+#endif
+
 static void
-write_bytes_to_file(FILE * file, char *addr, size_t bytes, int compression)
+write_all_bytes(FILE * file, char *addr, size_t bytes)
 {
-    if (compression == COMPRESSION_LEVEL_NONE) {
-        while (bytes > 0) {
-            sword_t count = fwrite(addr, 1, bytes, file);
-            if (count > 0) {
-                bytes -= count;
-                addr += count;
-            }
-            else {
-                perror(GENERAL_WRITE_FAILURE_MSG);
-                lose("core file is incomplete or corrupt");
+    while (bytes > 0) {
+        sword_t count = fwrite(addr, 1, bytes, file);
+        if (count > 0) {
+            bytes -= count;
+            addr += count;
+        }
+        else {
+            perror(GENERAL_WRITE_FAILURE_MSG);
+            lose("core file is incomplete or corrupt");
+        }
+    }
+}
+
+#ifdef LISP_FEATURE_SB_CORE_ZSTD
+#if defined LISP_FEATURE_SB_THREAD && !defined LISP_FEATURE_WIN32
+# define ZSTD_JOB_THREADED 1
+#endif
+/* Chunks are compressed into a ring of ZSTD_JOB_SLOTS buffers and written
+ * in order as soon as they are done, so the compression of later chunks
+ * overlaps the writing of earlier ones, and the memory needed for the
+ * compressed output stays bounded */
+#define ZSTD_JOB_SLOTS (2*CORE_MAX_WORKER_THREADS)
+struct zstd_chunk {
+    void *dst;
+    size_t dst_size; // the compressed size, once compressed
+    int done; // compressed and not yet written
+};
+struct zstd_job {
+    char *src;
+    size_t src_size;
+    int n_chunks;
+    int next_chunk; // claimed by atomic increment
+    int level;
+    FILE *file;
+    uint64_t *sizes;
+    uint64_t total_written;
+    // The rest is protected by 'lock'
+    int n_written;
+    int writing; // whether some thread is writing out done chunks
+#ifdef ZSTD_JOB_THREADED
+    pthread_mutex_t lock;
+    pthread_cond_t chunk_written;
+#endif
+    struct zstd_chunk slots[ZSTD_JOB_SLOTS];
+};
+#ifdef ZSTD_JOB_THREADED
+# define zstd_job_lock(job) pthread_mutex_lock(&(job)->lock)
+# define zstd_job_unlock(job) pthread_mutex_unlock(&(job)->lock)
+# define zstd_job_wait(job) pthread_cond_wait(&(job)->chunk_written, &(job)->lock)
+# define zstd_job_notify(job) pthread_cond_broadcast(&(job)->chunk_written)
+#else
+# define zstd_job_lock(job)
+# define zstd_job_unlock(job)
+# define zstd_job_wait(job) lose("zstd chunk slot is not free")
+# define zstd_job_notify(job)
+#endif
+
+static void* compress_zstd_chunks(void* arg)
+{
+    struct zstd_job *job = arg;
+    int i;
+    while ((i = __sync_fetch_and_add(&job->next_chunk, 1)) < job->n_chunks) {
+        struct zstd_chunk *chunk = &job->slots[i % ZSTD_JOB_SLOTS];
+        size_t start = (size_t)i * ZSTD_CORE_CHUNK_BYTES;
+        size_t src_size = (job->src_size - start < ZSTD_CORE_CHUNK_BYTES)
+                          ? job->src_size - start : ZSTD_CORE_CHUNK_BYTES;
+        // The slot is free once the chunk that last used it has been written
+        zstd_job_lock(job);
+        while (i - job->n_written >= ZSTD_JOB_SLOTS) zstd_job_wait(job);
+        zstd_job_unlock(job);
+        size_t result = ZSTD_compress(chunk->dst, ZSTD_compressBound(src_size),
+                                      job->src + start, src_size, job->level);
+        if (ZSTD_isError(result))
+            lose("zstd compression error: %s", ZSTD_getErrorName(result));
+        chunk->dst_size = result;
+        zstd_job_lock(job);
+        chunk->done = 1;
+        if (!job->writing) {
+            // Write out the chunks which are done, in order, without holding
+            // the lock so that the other threads can go on compressing
+            job->writing = 1;
+            struct zstd_chunk *next;
+            while ((next = &job->slots[job->n_written % ZSTD_JOB_SLOTS])->done) {
+                zstd_job_unlock(job);
+                write_all_bytes(job->file, next->dst, next->dst_size);
+                job->sizes[job->n_written] = next->dst_size;
+                job->total_written += next->dst_size;
+                zstd_job_lock(job);
+                next->done = 0;
+                ++job->n_written;
+                zstd_job_notify(job);
             }
+            job->writing = 0;
         }
+        zstd_job_unlock(job);
+    }
+    return 0;
+}
+
+/* Write 'bytes' at 'addr' in the chunked format described in core.h */
+static void
+write_zstd_chunks(FILE *file, char *addr, size_t bytes, int level)
+{
+    uint64_t n_chunks = (bytes + ZSTD_CORE_CHUNK_BYTES - 1) / ZSTD_CORE_CHUNK_BYTES;
+    uint64_t header[2] = { ZSTD_CORE_CHUNK_BYTES, n_chunks };
+    uint64_t *sizes = calloc(n_chunks ? n_chunks : 1, sizeof (uint64_t));
+    size_t bound = ZSTD_compressBound(ZSTD_CORE_CHUNK_BYTES);
+    int n_slots = n_chunks < ZSTD_JOB_SLOTS ? (int)n_chunks : ZSTD_JOB_SLOTS;
+    char *buffers = successful_malloc(bound * (n_slots ? n_slots : 1));
+    struct zstd_job *job = calloc(1, sizeof (struct zstd_job));
+    int i;
+
+    if (!sizes || !job) lose("can't allocate zstd chunk table");
+    write_all_bytes(file, (char*)header, sizeof header);
+    ftell_type sizes_position = FTELL(file);
+    write_all_bytes(file, (char*)sizes, n_chunks * sizeof (uint64_t)); // placeholder
+    job->src = addr;
+    job->src_size = bytes;
+    job->n_chunks = n_chunks;
+    job->level = level;
+    job->file = file;
+    job->sizes = sizes;
+    // With fewer chunks than slots, chunk I always goes in slot I
+    for (i = 0; i < n_slots; ++i) job->slots[i].dst = buffers + i * bound;
+#ifdef ZSTD_JOB_THREADED
+    pthread_mutex_init(&job->lock, 0);
+    pthread_cond_init(&job->chunk_written, 0);
+#endif
+    run_core_workers(compress_zstd_chunks, job);
+    gc_assert((uint64_t)job->n_written == n_chunks);
+#ifdef ZSTD_JOB_THREADED
+    pthread_mutex_destroy(&job->lock);
+    pthread_cond_destroy(&job->chunk_written);
+#endif
+    FSEEK(file, sizes_position, SEEK_SET);
+    write_all_bytes(file, (char*)sizes, n_chunks * sizeof (uint64_t));
+    FSEEK(file, 0, SEEK_END);
+    printf("compressed %lu bytes into %lu with zstd at level %i\n",
+           (unsigned long)bytes, (unsigned long)job->total_written, level);
+    free(job);
+    free(buffers);
+    free(sizes);
+}
+#endif
+
+#ifdef DELTA_CORES
+/* The namestring of the base core to save a delta core against, or 0.
+ * Set by SAVE-LISP-AND-DIE */
+char *save_base_core;
+
+static struct {
+    int fd;
+    os_vm_offset_t start; // of the core in its file
+    os_vm_offset_t size; // of the file
+    uint32_t fingerprint;
+    // Spaces that can be saved as deltas have a nonzero page count
+    struct ndir_entry spaces[MAX_CORE_SPACE_ID+1];
+} base_core = { -1, 0, 0, 0, {{0}} };
+
+/* Read the header of the base core, which must have been saved by this
+ * runtime. Return 0 if it is unusable */
+static boolean open_base_core(char *path)
+{
+    boolean build_id_ok = 0, ok = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    os_vm_offset_t start = search_for_embedded_core(path, 0);
+    if (start == -1) start = 0;
+    core_entry_elt_t *header = successful_malloc(os_vm_page_size);
+    core_entry_elt_t *limit = header + os_vm_page_size / sizeof (core_entry_elt_t);
+    struct stat st;
+    if (fstat(fd, &st) != 0
+        || pread(fd, header, os_vm_page_size, start) != (ssize_t)os_vm_page_size
+        || header[0] != CORE_MAGIC)
+        goto done;
+    core_entry_elt_t *ptr = header + 1;
+    while (ptr + 2 <= limit) {
+        core_entry_elt_t val = *ptr++, len = *ptr++;
+        if (len < 2 || ptr + len - 2 > limit) break;
+        if (val == END_CORE_ENTRY_TYPE_CODE) { ok = build_id_ok; break; }
+        if (val == BUILD_ID_CORE_ENTRY_TYPE_CODE)
+            build_id_ok = (size_t)ptr[0] == strlen((const char*)build_id)
+                && !memcmp(ptr + 1, build_id, ptr[0]);
+        if (val == DIRECTORY_CORE_ENTRY_TYPE_CODE) {
+            struct ndir_entry *entry = (struct ndir_entry*)ptr;
+            int i, n = (len - 2) / NDIR_ENTRY_LENGTH;
+            // Compressed and delta spaces have flags in the identifier,
+            // so only plain spaces are eligible
+            for (i = 0; i < n; ++i, ++entry)
+                if (entry->identifier >= 1 && entry->identifier <= MAX_CORE_SPACE_ID)
+                    base_core.spaces[entry->identifier] = *entry;
+        }
+        ptr += len - 2;
+    }
+    if (ok) {
+        base_core.fd = fd;
+        base_core.start = start;
+        base_core.size = st.st_size;
+        base_core.fingerprint =
+            core_header_fingerprint((unsigned char*)header, os_vm_page_size);
+    }
+done:
+    free(header);
+    if (!ok) {
+        memset(base_core.spaces, 0, sizeof base_core.spaces);
+        close(fd);
+    }
+    return ok;
+}
+
+static void write_base_core_entry(FILE *file)
+{
+    int stringlen = strlen(save_base_core);
+    int string_words = ALIGN_UP(stringlen, sizeof (core_entry_elt_t))
+        / sizeof (core_entry_elt_t);
+    char *string = calloc(string_words ? string_words : 1, sizeof (core_entry_elt_t));
+    if (!string) lose("can't allocate base core entry");
+    memcpy(string, save_base_core, stringlen);
+    write_lispobj(BASE_CORE_ENTRY_TYPE_CODE, file);
+    write_lispobj(6 + string_words, file);
+    write_lispobj(base_core.size, file);
+    write_lispobj(base_core.start, file);
+    write_lispobj(base_core.fingerprint, file);
+    write_lispobj(stringlen, file);
+    write_all_bytes(file, string, string_words * sizeof (core_entry_elt_t));
+    free(string);
+}
+
+static inline boolean delta_page_changed_p(uword_t *bitmap, uword_t page) {
+    return (bitmap[page / N_WORD_BITS] >> (page % N_WORD_BITS)) & 1;
+}
+
+/* Like write_bytes(), but write only the pages that differ from the
+ * space 'base' of the base core, in the format described in core.h */
+static long write_delta_bytes(FILE *file, char *addr, size_t bytes,
+                              os_vm_offset_t file_offset, struct ndir_entry *base)
+{
+    uword_t npages = bytes / os_vm_page_size, i;
+    size_t bitmap_bytes = ALIGN_UP(npages, N_WORD_BITS) / 8;
+    uword_t *bitmap = calloc(bitmap_bytes ? bitmap_bytes : 1, 1);
+    char *buf = successful_malloc(os_vm_page_size);
+    struct delta_space_header header;
+    ftell_type here, data;
+
+    if (!bitmap) lose("can't allocate delta core bitmap");
+    header.base_offset = base_core.start + (1 + base->data_page) * os_vm_page_size;
+    header.base_npages = (uword_t)base->page_count < npages ? (uword_t)base->page_count : npages;
+    header.n_changed = 0;
+    header.header_bytes = ALIGN_UP(sizeof header + bitmap_bytes, os_vm_page_size);
+    for (i = 0; i < npages; ++i) {
+        if (i < header.base_npages
+            && pread(base_core.fd, buf, os_vm_page_size,
+                     header.base_offset + i * os_vm_page_size) == (ssize_t)os_vm_page_size
+            && !memcmp(buf, addr + i * os_vm_page_size, os_vm_page_size))
+            continue;
+        bitmap[i / N_WORD_BITS] |= (uword_t)1 << (i % N_WORD_BITS);
+        ++header.n_changed;
+    }
+
+    fflush(file);
+    here = FTELL(file);
+    FSEEK(file, 0, SEEK_END);
+    data = ALIGN_UP(FTELL(file), os_vm_page_size);
+    FSEEK(file, data, SEEK_SET);
+    write_all_bytes(file, (char*)&header, sizeof header);
+    write_all_bytes(file, (char*)bitmap, bitmap_bytes);
+    memset(buf, 0, os_vm_page_size);
+    write_all_bytes(file, buf, header.header_bytes - sizeof header - bitmap_bytes);
+    for (i = 0; i < npages; ++i)
+        if (delta_page_changed_p(bitmap, i))
+            write_all_bytes(file, addr + i * os_vm_page_size, os_vm_page_size);
+    FSEEK(file, here, SEEK_SET);
+    if (!lisp_startup_options.noinform)
+        printf("%lu of %lu pages differ from the base core\n",
+               (unsigned long)header.n_changed, (unsigned long)npages);
+    free(buf);
+    free(bitmap);
+    return ((data - file_offset) / os_vm_page_size) - 1;
+}
+#endif
+
+static void
+write_bytes_to_file(FILE * file, char *addr, size_t bytes, int compression)
+{
+    if (compression == COMPRESSION_LEVEL_NONE) {
+        write_all_bytes(file, addr, bytes);
+#ifdef LISP_FEATURE_SB_CORE_ZSTD
+    } else if (zstd_compression_level_p(compression)) {
+        write_zstd_chunks(file, addr, bytes, compression - ZSTD_COMPRESSION_LEVEL_BASE);
+#endif
 #ifdef LISP_FEATURE_SB_CORE_COMPRESSION
     } else if ((compression >= -1) && (compression <= 9)) {
 # define ZLIB_BUFFER_SIZE (1u<<16)
@@ -131,10 +426,10 @@ write_bytes_to_file(FILE * file, char *addr, size_t bytes, int compression)
 # undef ZLIB_BUFFER_SIZE
 #endif
     } else {
-#ifdef LISP_FEATURE_SB_CORE_COMPRESSION
+#if defined LISP_FEATURE_SB_CORE_COMPRESSION || defined LISP_FEATURE_SB_CORE_ZSTD
         lose("Unknown core compression level %i, exiting", compression);
 #else
-        lose("zlib-compressed core support not built in this runtime");
+        lose("compressed core support not built in this runtime");
 #endif
     }
 
@@ -144,16 +439,6 @@ write_bytes_to_file(FILE * file, char *addr, size_t bytes, int compression)
     }
 };
 
-#if defined(LISP_FEATURE_WIN32) && defined(LISP_FEATURE_64_BIT)
-#define FTELL _ftelli64
-#define FSEEK _fseeki64
-typedef __int64 ftell_type;
-#else
-#define FTELL ftell
-#define FSEEK fseek
-typedef long ftell_type;
-#endif
-
 static long write_bytes(FILE *file, char *addr, size_t bytes,
                         os_vm_offset_t file_offset, int compression)
 {
@@ -187,8 +472,17 @@ output_space(FILE *file, int id, lispobj *addr, lispobj *end,
                             "immobile", "immobile"};
 
     compressed_flag
-            = ((core_compression_level != COMPRESSION_LEVEL_NONE)
-               ? DEFLATED_CORE_SPACE_ID_FLAG : 0);
+            = ((core_compression_level == COMPRESSION_LEVEL_NONE) ? 0
+               : zstd_compression_level_p(core_compression_level) ? ZSTD_CORE_SPACE_ID_FLAG
+               : DEFLATED_CORE_SPACE_ID_FLAG);
+#ifdef DELTA_CORES
+    // The space has to be where it was in the base core for pages to match
+    struct ndir_entry *base = &base_core.spaces[id];
+    boolean delta = base_core.fd >= 0 && base->page_count != 0
+        && base->address == (core_entry_elt_t)addr
+        && core_compression_level == COMPRESSION_LEVEL_NONE;
+    if (delta) compressed_flag = DELTA_CORE_SPACE_ID_FLAG;
+#endif
 
     write_lispobj(id | compressed_flag, file);
     words = end - addr;
@@ -218,6 +512,12 @@ output_space(FILE *file, int id, lispobj *addr, lispobj *end,
      * up count that were not zeroized and would not have been written had we not rounded.
      * That seems quite bogus to operate on bytes that the caller didn't promise were OK
      * to be saved out (and didn't contain, say, a password and social security number) */
+#ifdef DELTA_CORES
+    if (delta)
+        data = write_delta_bytes(file, (char *)addr, ALIGN_UP(bytes, os_vm_page_size),
+                                 file_offset, base);
+    else
+#endif
     data = write_bytes(file, (char *)addr, ALIGN_UP(bytes, os_vm_page_size),
                        file_offset, core_compression_level);
 
@@ -308,6 +608,39 @@ save_to_filehandle(FILE *file, char *filename, lispobj init_function,
     if (nwrote != (int)(sizeof (core_entry_elt_t) * string_words))
         perror(GENERAL_WRITE_FAILURE_MSG);
 
+#ifdef LISP_FEATURE_GENCGC
+    /* The relocation map has to come before the directory, because
+     * the loader relocates the heap as soon as the spaces are in place */
+    {
+        extern void gc_store_relocation_map(uint32_t*);
+        size_t true_size = next_free_page * sizeof (uint32_t);
+        size_t aligned_size = ALIGN_UP(true_size, N_WORD_BYTES);
+        uint32_t* map = calloc(aligned_size ? aligned_size : 1, 1);
+        if (!map) lose("can't allocate relocation map");
+        gc_store_relocation_map(map);
+        write_lispobj(RELOCATION_MAP_CORE_ENTRY_TYPE_CODE, file);
+        write_lispobj(5, file); // number of words in this core header entry
+        write_lispobj(next_free_page, file);
+        write_lispobj(aligned_size, file);
+        sword_t offset = write_bytes(file, (char*)map, aligned_size, core_start_pos,
+                                     COMPRESSION_LEVEL_NONE);
+        write_lispobj(offset, file);
+        free(map);
+    }
+#endif
+
+#ifdef DELTA_CORES
+    if (save_base_core) {
+        if (core_compression_level != COMPRESSION_LEVEL_NONE)
+            fprintf(stderr, "WARNING: a compressed core can't be a delta core\n");
+        else if (strlen(save_base_core) > 1024 || !open_base_core(save_base_core))
+            fprintf(stderr, "WARNING: can't use %s as a base core, saving a full core\n",
+                    save_base_core);
+        else
+            write_base_core_entry(file);
+    }
+#endif
+
     write_lispobj(DIRECTORY_CORE_ENTRY_TYPE_CODE, file);
     write_lispobj(/* (word count = N spaces described by 5 words each, plus the
           * entry type code, plus this count itself) */
@@ -15,6 +15,11 @@
 #include "core.h"
 
 #define COMPRESSION_LEVEL_NONE INT_MIN
+/* A zstd compression level N is passed as ZSTD_COMPRESSION_LEVEL_BASE + N,
+ * which SAVE-LISP-AND-DIE has to agree with. Anything else is a zlib level */
+#define ZSTD_COMPRESSION_LEVEL_BASE 1000
+#define zstd_compression_level_p(level) ((level) > ZSTD_COMPRESSION_LEVEL_BASE \
+                                         && (level) <= ZSTD_COMPRESSION_LEVEL_BASE + 22)
 
 void unwind_binding_stack(void);
 
@@ -1,3 +1,6 @@
+/* needed for F_SETSIG and F_SETOWN_EX in glibc's fcntl.h */
+#define _GNU_SOURCE
+
 #include <signal.h>
 #include <stdio.h>
 #include <errno.h>
@@ -58,6 +61,15 @@
 #endif
 #define INITIAL_FREE_POINTER 2
 
+/* In bounded mode, used for continuous profiling, a thread's buffer never
+ * grows beyond sb_sprof_capacity_max elements. Once it is full, new traces
+ * are dropped (and counted) rather than disabling the sampler, and repeats
+ * of traces already in the buffer are still counted. Lisp drains the
+ * buffers periodically, which starts each thread over with an empty one */
+int sb_sprof_bounded;
+uint32_t sb_sprof_capacity_max = CAPACITY_MAX;
+uint32_t sb_sprof_dropped_ct;
+
 // Lisp and C both accesses this.
 // The structure is 2 elements long, each element being 8 bytes.
 struct sprof_data {
@@ -361,7 +373,8 @@ static void* initialize_sprof_data(struct thread* thread)
 {
     void* buckets = (void*)os_allocate(N_BUCKETS * sizeof (uint32_t));
     if (!buckets) return 0;
-    int capacity = 128*1024; // arbitrary starting size for traces, 128K elements = 1MiB
+    uint32_t capacity = 128*1024; // arbitrary starting size for traces, 128K elements = 1MiB
+    if (capacity > sb_sprof_capacity_max) capacity = sb_sprof_capacity_max;
     struct sprof_data *data = (void*)os_allocate(capacity * ELEMENT_SIZE);
     if (!data) { os_deallocate(buckets, N_BUCKETS * sizeof (uint32_t)); return 0; }
     data->capacity = capacity;
@@ -405,12 +418,16 @@ int sb_sprof_trace_ct_max;
 /* this could get false msan positives because Lisp don't mark stack words as clean
    so anything may appear as unwritten from C depending on whether any C code
    ever marked them. So it was basically down to luck whether this worked or not */
+/* Record the current backtrace as 'weight' samples. If 'phash' is supplied,
+ * store the hash of the trace as recorded into it, or leave it alone if the
+ * trace was not recorded */
 static int NO_SANITIZE_MEMORY
-collect_backtrace(struct thread* th, int contextp, void* context_or_fp)
+collect_backtrace(struct thread* th, int contextp, void* context_or_fp,
+                  int weight, uint32_t* phash)
 {
-    int oldcount = __sync_fetch_and_add(&sb_sprof_trace_ct, 1);
+    int oldcount = __sync_fetch_and_add(&sb_sprof_trace_ct, weight);
     if (oldcount >= sb_sprof_trace_ct_max) {
-        __sync_fetch_and_sub(&sb_sprof_trace_ct, 1);
+        __sync_fetch_and_sub(&sb_sprof_trace_ct, weight);
         return -1; // sample limit exceeded
     }
     struct trace trace;
@@ -450,21 +467,28 @@ collect_backtrace(struct thread* th, int contextp, void* context_or_fp)
             uint32_t n_elements = TRACE_PREFIX_ELEMENTS + len;
             uint32_t capacity = data->capacity;
             if (data->free_pointer + n_elements > capacity) {
+                uint32_t new_capacity = 2*capacity;
+                if (new_capacity > sb_sprof_capacity_max) new_capacity = sb_sprof_capacity_max;
                 // If we're at maximum capacity, bail out
-                if (capacity == CAPACITY_MAX) return 0;
+                if (data->free_pointer + n_elements > new_capacity) {
+                    if (!sb_sprof_bounded) return 0;
+                    __sync_fetch_and_add(&sb_sprof_dropped_ct, 1);
+                    return 1;
+                }
                 // Before enlarging the buffer, check whether anyone is trying
                 // to read it; if so, just bail out.
                 // This is not to avoid a race - that's taken care of by the
                 // cmpxchg - but it's preferable to drop the current sample
                 // versus make a bunch more system call while there is a waiter.
                 if (SPROF_LOCK(th) & LOCKED_BY_OTHER) return 0;
-                data = enlarge_buffer(data, 2*capacity);
+                data = enlarge_buffer(data, new_capacity);
                 th->sprof_data = (lispobj)data;
             }
             pcount = hash_insert(data, &trace, hash);
         }
     }
-    ++*pcount;
+    *pcount += weight;
+    if (phash) *phash = hash;
     return 1;
 }
 
@@ -474,7 +498,7 @@ static void diagnose_failure(struct thread* thread) {
     // arbitrary number of times. The automatic disable tries to avoid an explosion
     // in memory consumption.
     struct sprof_data* data = (void*)thread->sprof_data;
-    if (data && data->capacity == CAPACITY_MAX) {
+    if (data && data->capacity >= sb_sprof_capacity_max) {
         // disable the profiler in this thread
         thread->state_word.sprof_enable = 0;
 #ifdef LISP_FEATURE_SB_THREAD
@@ -488,7 +512,7 @@ static void diagnose_failure(struct thread* thread) {
 }
 
 void record_backtrace_from_context(void *context, struct thread* thread) {
-    int success = collect_backtrace(thread, 1, context) == 1;
+    int success = collect_backtrace(thread, 1, context, 1, 0) == 1;
     // Release the lock. This synchronizes with acquire_sprof_data_lock()
     // which atomically adds LOCKED_BY_OTHER to the lock field.
     // If that happens first, then the cmpxchg will fail, and we'll do
@@ -498,6 +522,124 @@ void record_backtrace_from_context(void *context, struct thread* thread) {
     if (!success) diagnose_failure(thread);
 }
 
+#ifdef LISP_FEATURE_LINUX
+/* Per-thread samplers.
+ * The process-wide ITIMER_PROF counts the CPU time of all threads together
+ * and raises SIGPROF in whichever thread the kernel picks, which need not be
+ * the thread that used up the time. Instead, each profiled thread can have
+ * a sampler that signals only that thread: either a POSIX timer on the
+ * thread's CPU-time clock, or a perf event counter (cycles, cache misses,
+ * and so on) which overflows once every 'period' events.
+ * Either way the signal is SIGPROF and goes through sigprof_handler(),
+ * so samples land in the thread's sprof_data just as with the itimer.
+ *
+ * sb_sprof_sampler_event is -1 if no samplers are wanted, 0 for the CPU-time
+ * clock, with 'period' in nanoseconds, or 1 + PERF_COUNT_HW_<n> for a hardware
+ * event. New threads arm themselves in init_new_thread() while it is >= 0.
+ *
+ * A sampler may be armed by its own thread when the thread starts, and by
+ * Lisp from any thread (holding the target's interruptions lock), and torn
+ * down by either. The 'sprof_sampler' word makes that safe: arming claims
+ * it from 0 to SAMPLER_BUSY, and teardown swaps it to 0 and releases
+ * whatever it held. An armer which finds the word no longer BUSY when it
+ * is done lost to a teardown and releases its own resource */
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define SAMPLER_BUSY  1
+#define SAMPLER_TIMER 2
+#define SAMPLER_PERF  3
+
+int sb_sprof_sampler_event = -1;
+long sb_sprof_sampler_period;
+
+static void release_sampler(struct extra_thread_data* ed, int kind)
+{
+    if (kind == SAMPLER_TIMER) timer_delete(ed->sprof_timer);
+    else if (kind == SAMPLER_PERF) close(ed->sprof_perf_fd);
+}
+
+/* Return 0 on success (or if there is nothing to do), or an errno value */
+int sb_sprof_start_thread_sampler(struct thread* th)
+{
+    int event = sb_sprof_sampler_event;
+    long period = sb_sprof_sampler_period;
+    struct extra_thread_data* ed = thread_extra_data(th);
+    if (event < 0 || period <= 0) return 0;
+    if (!__sync_bool_compare_and_swap(&ed->sprof_sampler, 0, SAMPLER_BUSY))
+        return 0; // already armed
+    int tid = th->os_kernel_tid, kind, err = 0;
+    if (event == 0) {
+        clockid_t clock;
+        struct sigevent sev;
+        memset(&sev, 0, sizeof sev);
+        sev.sigev_notify = SIGEV_THREAD_ID;
+        sev.sigev_signo = SIGPROF;
+        sev.sigev_notify_thread_id = tid;
+        struct itimerspec its;
+        its.it_interval.tv_sec = its.it_value.tv_sec = period / 1000000000;
+        its.it_interval.tv_nsec = its.it_value.tv_nsec = period % 1000000000;
+        kind = SAMPLER_TIMER;
+#ifdef LISP_FEATURE_SB_THREAD
+        err = pthread_getcpuclockid(th->os_thread, &clock);
+#else
+        clock = CLOCK_THREAD_CPUTIME_ID;
+#endif
+        if (!err && timer_create(clock, &sev, &ed->sprof_timer)) err = errno;
+        else if (!err && timer_settime(ed->sprof_timer, 0, &its, 0)) {
+            err = errno;
+            timer_delete(ed->sprof_timer);
+        }
+    } else {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = event - 1;
+        attr.sample_period = period;
+        attr.exclude_kernel = attr.exclude_hv = 1;
+        attr.disabled = 1;
+        kind = SAMPLER_PERF;
+        int fd = syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+        struct f_owner_ex owner = { F_OWNER_TID, tid };
+        if (fd < 0) err = errno;
+        else if (fcntl(fd, F_SETFL, O_ASYNC|O_NONBLOCK)
+                 || fcntl(fd, F_SETSIG, SIGPROF)
+                 || fcntl(fd, F_SETOWN_EX, &owner)
+                 // Count to one overflow, then disable the counter and signal.
+                 // sigprof_handler() re-enables it.
+                 || ioctl(fd, PERF_EVENT_IOC_REFRESH, 1)) {
+            err = errno;
+            close(fd);
+        } else
+            ed->sprof_perf_fd = fd;
+    }
+    if (err) kind = 0;
+    if (!__sync_bool_compare_and_swap(&ed->sprof_sampler, SAMPLER_BUSY, kind))
+        release_sampler(ed, kind);
+    return err;
+}
+
+void sb_sprof_stop_thread_sampler(struct thread* th)
+{
+    struct extra_thread_data* ed = thread_extra_data(th);
+    release_sampler(ed, __sync_lock_test_and_set(&ed->sprof_sampler, 0));
+}
+
+/* A perf event counter stops after each overflow; let it count again */
+static void rearm_perf_sampler(struct thread* th, int fd)
+{
+    struct extra_thread_data* ed = thread_extra_data(th);
+    if (ed->sprof_sampler == SAMPLER_PERF && ed->sprof_perf_fd == fd)
+        ioctl(fd, PERF_EVENT_IOC_REFRESH, 1);
+}
+#endif
+
 /* The SIGPROF handler. This used to be deferrable via the can_handle_now_test()
  * check in interrupt.c, which would return false during GC, because Lisp binds
  * *INTERRUPTS-ENABLED* to NIL in the thread which performs the GC; and all other
@@ -513,9 +655,15 @@ void record_backtrace_from_context(void *context, struct thread* thread) {
 void sigprof_handler(int sig, __attribute__((unused)) siginfo_t* info,
                      void *context)
 {
-    if (gc_active_p) return; // no mem barrier needed to read this
     int _saved_errno = errno;
     struct thread* thread = get_sb_vm_thread();
+#ifdef LISP_FEATURE_LINUX
+    if (thread && info->si_code == POLL_HUP) rearm_perf_sampler(thread, info->si_fd);
+#endif
+    if (gc_active_p) { // no mem barrier needed to read this
+        errno = _saved_errno;
+        return;
+    }
     // We can only profile Lisp threads.
     if (thread) {
         if (thread->state_word.sprof_enable)
@@ -530,11 +678,14 @@ void sigprof_handler(int sig, __attribute__((unused)) siginfo_t* info,
 }
 
 #if !(defined LISP_FEATURE_PPC || defined LISP_FEATURE_PPC64 || defined LISP_FEATURE_SPARC)
-void allocator_record_backtrace(void* frame_ptr, struct thread* thread)
+/* Return the hash of the recorded trace, or 0 if none was recorded */
+uint32_t allocator_record_backtrace(void* frame_ptr, struct thread* thread, int weight)
 {
-    int success = collect_backtrace(thread, 0, frame_ptr) == 1;
+    uint32_t hash = 0;
+    int success = collect_backtrace(thread, 0, frame_ptr, weight, &hash) == 1;
     RELEASE_LOCK(thread);
     if (!success) diagnose_failure(thread);
+    return hash;
 }
 #endif
 
@@ -0,0 +1,159 @@
+/*
+ * Timing of the phases of startup, for --startup-trace
+ */
+
+/*
+ * This software is part of the SBCL system. See the README file for
+ * more information.
+ *
+ * This software is derived from the CMU CL system, which was
+ * written at Carnegie Mellon University and released into the
+ * public domain. The software is in the public domain and is
+ * provided with absolutely no warranty. See the COPYING and CREDITS
+ * files for more information.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "sbcl.h"
+#include "runtime.h"
+#ifndef LISP_FEATURE_WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+/* Nonzero if --startup-trace or --startup-trace-json was given */
+int startup_trace_enabled;
+/* The file named by --startup-trace-json, or 0 to print a summary */
+char *startup_trace_json_file;
+
+/* Each phase is recorded when it ends, and lasts from the end of the
+ * previous one. The first one starts when initialize_lisp() does. */
+struct startup_phase {
+    char name[32];
+    long long end_ns;
+    long rss_kb;       // resident set size at the end, or -1 if unknown
+    long minor_faults; // cumulative
+    long major_faults;
+};
+
+#define MAX_STARTUP_PHASES 64
+static struct startup_phase startup_phases[MAX_STARTUP_PHASES];
+static int n_startup_phases;
+static long long startup_start_ns;
+
+static long long startup_trace_now()
+{
+#ifdef LISP_FEATURE_WIN32
+    return (long long)clock() * (1000000000 / CLOCKS_PER_SEC);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+static void sample_memory(struct startup_phase *phase)
+{
+    phase->rss_kb = -1;
+    phase->minor_faults = phase->major_faults = 0;
+#ifndef LISP_FEATURE_WIN32
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage)) {
+        phase->minor_faults = usage.ru_minflt;
+        phase->major_faults = usage.ru_majflt;
+    }
+#ifdef LISP_FEATURE_LINUX
+    /* ru_maxrss is the peak, so ask for the current size */
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        long size, resident;
+        if (fscanf(statm, "%ld %ld", &size, &resident) == 2)
+            phase->rss_kb = resident * (getpagesize() / 1024);
+        fclose(statm);
+    }
+#else
+    phase->rss_kb = usage.ru_maxrss;
+#ifdef LISP_FEATURE_DARWIN
+    phase->rss_kb /= 1024; // bytes, not kilobytes
+#endif
+#endif
+#endif
+}
+
+/* Called first thing, before the options are parsed */
+void startup_trace_start()
+{
+    startup_start_ns = startup_trace_now();
+}
+
+/* Record the end of the phase PHASE. Lisp calls this too, with a
+ * string that may move later, so the name is copied. */
+void startup_trace_mark(const char *phase)
+{
+    if (!startup_trace_enabled || n_startup_phases == MAX_STARTUP_PHASES)
+        return;
+    struct startup_phase *p = &startup_phases[n_startup_phases++];
+    p->end_ns = startup_trace_now();
+    strncpy(p->name, phase, sizeof p->name - 1);
+    p->name[sizeof p->name - 1] = 0;
+    sample_memory(p);
+}
+
+static void print_summary(FILE *f)
+{
+    long long prev_ns = startup_start_ns;
+    long prev_minflt = 0, prev_majflt = 0;
+    int i;
+    fprintf(f, "%-24s %10s %10s %10s %9s %9s\n", "Startup phase",
+            "ms", "total ms", "RSS KiB", "minflt", "majflt");
+    for (i = 0; i < n_startup_phases; ++i) {
+        struct startup_phase *p = &startup_phases[i];
+        fprintf(f, "%-24s %10.3f %10.3f %10ld %9ld %9ld\n", p->name,
+                (p->end_ns - prev_ns) / 1e6, (p->end_ns - startup_start_ns) / 1e6,
+                p->rss_kb, p->minor_faults - prev_minflt, p->major_faults - prev_majflt);
+        prev_ns = p->end_ns;
+        prev_minflt = p->minor_faults;
+        prev_majflt = p->major_faults;
+    }
+}
+
+static void write_json(FILE *f)
+{
+    long long prev_ns = startup_start_ns;
+    long prev_minflt = 0, prev_majflt = 0;
+    int i;
+    fprintf(f, "{\"phases\": [");
+    for (i = 0; i < n_startup_phases; ++i) {
+        struct startup_phase *p = &startup_phases[i];
+        fprintf(f, "%s\n  {\"name\": \"%s\", \"ns\": %lld, \"end_ns\": %lld,"
+                " \"rss_kb\": %ld, \"minor_faults\": %ld, \"major_faults\": %ld}",
+                i ? "," : "", p->name, p->end_ns - prev_ns, p->end_ns - startup_start_ns,
+                p->rss_kb, p->minor_faults - prev_minflt, p->major_faults - prev_majflt);
+        prev_ns = p->end_ns;
+        prev_minflt = p->minor_faults;
+        prev_majflt = p->major_faults;
+    }
+    fprintf(f, "\n]}\n");
+}
+
+/* Called by Lisp when initialization is done */
+void startup_trace_report()
+{
+    if (!startup_trace_enabled)
+        return;
+    startup_trace_enabled = 0;
+    if (startup_trace_json_file) {
+        FILE *f = fopen(startup_trace_json_file, "w");
+        if (!f) {
+            perror(startup_trace_json_file);
+            return;
+        }
+        write_json(f);
+        fclose(f);
+    } else {
+        print_summary(stderr);
+        fflush(stderr);
+    }
+}
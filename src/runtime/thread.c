@@ -26,6 +26,9 @@
 #ifndef LISP_FEATURE_WIN32
 #include <sys/wait.h>
 #endif
+#ifdef LISP_FEATURE_LINUX
+#include <sys/mman.h>
+#endif
 
 #ifdef LISP_FEATURE_MACH_EXCEPTION_HANDLER
 #include <mach/mach.h>
@@ -50,6 +53,7 @@
 #include "pseudo-atomic.h"
 #include "interrupt.h"
 #include "lispregs.h"
+#include "immobile-space.h"
 
 #ifdef LISP_FEATURE_SB_THREAD
 
@@ -123,11 +127,12 @@ set_thread_state(struct thread *thread,
                  boolean signals_already_blocked) // for foreign thread
 {
     struct extra_thread_data *semaphores = thread_extra_data(thread);
-    int i, waitcount = 0;
-    sigset_t old;
-    // If we've already masked the blockable signals we can avoid two syscalls here.
+    int i, waitcount = 0, lazy = 0;
+    // If we've already masked the blockable signals there is nothing to do.
+    // Otherwise the section only waits for other calls of this function,
+    // so a lazy block is enough and avoids two syscalls.
     if (!signals_already_blocked)
-        block_blockable_signals(&old);
+        lazy = lazy_block_signals();
     os_sem_wait(&semaphores->state_sem, "set_thread_state");
     if (thread->state_word.state != state) {
         if ((STATE_STOPPED==state) ||
@@ -148,7 +153,7 @@ set_thread_state(struct thread *thread,
     }
     os_sem_post(&semaphores->state_sem, "set_thread_state");
     if (!signals_already_blocked)
-        thread_sigmask(SIG_SETMASK, &old, NULL);
+        lazy_unblock_signals(lazy);
 }
 
 // Wait until "thread's" state is something other than 'undesired_state'
@@ -279,6 +284,11 @@ void* read_current_thread() {
 extern pthread_key_t foreign_thread_ever_lispified;
 #endif
 
+#if defined LISP_FEATURE_SB_THREAD && !defined LISP_FEATURE_SB_SAFEPOINT
+static pthread_key_t attached_foreign_thread;
+static void detach_foreign_thread_at_exit(void*);
+#endif
+
 #if !defined COLLECT_GC_STATS && !defined STANDALONE_LDB && \
   defined LISP_FEATURE_LINUX && defined LISP_FEATURE_SB_THREAD && defined LISP_FEATURE_64_BIT
 #define COLLECT_GC_STATS
@@ -323,6 +333,9 @@ void create_main_lisp_thread(lispobj function) {
 #if defined LISP_FEATURE_DARWIN && defined LISP_FEATURE_SB_THREAD
     pthread_key_create(&foreign_thread_ever_lispified, 0);
 #endif
+#if defined LISP_FEATURE_SB_THREAD && !defined LISP_FEATURE_SB_SAFEPOINT
+    pthread_key_create(&attached_foreign_thread, detach_foreign_thread_at_exit);
+#endif
 #if defined(LISP_FEATURE_X86) || defined(LISP_FEATURE_X86_64)
     __attribute__((unused)) lispobj *args = NULL;
 #endif
@@ -416,6 +429,11 @@ init_new_thread(struct thread *th,
     gc_assert(lock_ret);
     link_thread(th);
     ignore_value(mutex_release(&all_threads_lock));
+#ifdef LISP_FEATURE_LINUX
+    extern int sb_sprof_sampler_event;
+    extern int sb_sprof_start_thread_sampler(struct thread*);
+    if (sb_sprof_sampler_event >= 0) sb_sprof_start_thread_sampler(th);
+#endif
 
     /* Kludge: Changed the order of some steps between the safepoint/
      * non-safepoint versions of this code.  Can we unify this more?
@@ -435,7 +453,14 @@ unregister_thread(struct thread *th,
     int lock_ret;
 
     block_blockable_signals(0);
+#ifdef LISP_FEATURE_LINUX
+    extern void sb_sprof_stop_thread_sampler(struct thread*);
+    sb_sprof_stop_thread_sampler(th);
+#endif
     gc_close_thread_regions(th);
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+    immobile_space_release_thread_pages(th);
+#endif
 #ifdef LISP_FEATURE_SB_SAFEPOINT
     pop_gcing_safety(&scribble->safety);
 #else
@@ -470,6 +495,7 @@ unregister_thread(struct thread *th,
 #endif
 
 #if defined(LISP_FEATURE_WIN32)
+    win32_iocp_destroy(th);
     CloseHandle((HANDLE)th->os_thread);
     int i;
     for (i = 0; i<NUM_PRIVATE_EVENTS; ++i)
@@ -615,8 +641,16 @@ void* new_thread_trampoline_switch_stack(void* th) {
 }
 #endif
 
+/* Exited threads' memory is kept in a small pool so that starting a thread
+ * can skip the mmap, the guard page mprotects, and faulting in the stack pages.
+ * The pool holds at most 'thread_struct_pool_size' entries, which may be set
+ * from Lisp; zero disables it. Both Lisp threads (when joined) and foreign
+ * threads (on detach) return their memory here, and either kind can draw on it */
+int thread_struct_pool_size = 4;
+uword_t thread_struct_pool_hits, thread_struct_pool_misses;
 static struct thread* recyclebin_threads;
-static struct thread* get_recyclebin_item()
+static int n_recyclebin_threads;
+void* get_recyclebin_item()
 {
     struct thread* result = 0;
     int rc;
@@ -625,18 +659,31 @@ static struct thread* get_recyclebin_item()
     if (recyclebin_threads) {
         result = recyclebin_threads;
         recyclebin_threads = result->next;
+        --n_recyclebin_threads;
+        ++thread_struct_pool_hits;
+    } else {
+        ++thread_struct_pool_misses;
     }
     ignore_value(mutex_release(&recyclebin_lock));
     return result ? result->os_address : 0;
 }
-static void put_recyclebin_item(struct thread* th)
+void put_recyclebin_item(struct thread* th)
 {
-    int rc;
-    rc = mutex_acquire(&recyclebin_lock);
-    gc_assert(rc);
-    th->next = recyclebin_threads;
-    recyclebin_threads = th;
-    ignore_value(mutex_release(&recyclebin_lock));
+    // A thread which exited after exhausting its control stack is not reusable
+    // as-is because its guard page was left unprotected.
+    if (th->state_word.control_stack_guard_page_protected) {
+        int rc;
+        rc = mutex_acquire(&recyclebin_lock);
+        gc_assert(rc);
+        if (n_recyclebin_threads < thread_struct_pool_size) {
+            th->next = recyclebin_threads;
+            recyclebin_threads = th;
+            ++n_recyclebin_threads;
+            th = 0;
+        }
+        ignore_value(mutex_release(&recyclebin_lock));
+    }
+    if (th) free_thread_struct(th);
 }
 void empty_thread_recyclebin()
 {
@@ -652,6 +699,7 @@ void empty_thread_recyclebin()
             this = next;
         }
         recyclebin_threads = 0;
+        n_recyclebin_threads = 0;
         ignore_value(mutex_release(&recyclebin_lock));
     }
     thread_sigmask(SIG_SETMASK, &old, 0);
@@ -665,6 +713,11 @@ static void attach_os_thread(init_thread_data *scribble)
     void* recycled_memory = get_recyclebin_item();
     struct thread *th = alloc_thread_struct(recycled_memory,
                                             NO_TLS_VALUE_MARKER_WIDETAG);
+#ifndef LISP_FEATURE_WIN32
+    /* The memory may later be reused for a lisp thread, which expects
+     * every pooled thread struct to have its own control stack guarded */
+    if (!recycled_memory) protect_control_stack_guard_page(1, th);
+#endif
 
 #ifndef LISP_FEATURE_SB_SAFEPOINT
     /* new-lisp-thread-trampoline doesn't like when the GC signal is blocked */
@@ -762,6 +815,40 @@ static void detach_os_thread(init_thread_data *scribble)
 #endif
 }
 
+#ifndef LISP_FEATURE_SB_SAFEPOINT
+/* If this is nonzero when a foreign thread first calls into Lisp, the thread
+ * stays attached after the callback returns, and later callbacks enter Lisp
+ * as cheaply as they would from a Lisp thread. The thread is detached by the
+ * destructor of 'attached_foreign_thread' when it exits. Between callbacks it
+ * is stopped for GC like a Lisp thread in a foreign call, so it has to keep
+ * SIG_STOP_FOR_GC unblocked. May be set from Lisp */
+int keep_foreign_threads_attached;
+
+static struct thread* attach_foreign_thread()
+{
+    init_thread_data scribble;
+    attach_os_thread(&scribble);
+    struct thread *th = get_sb_vm_thread();
+    pthread_setspecific(attached_foreign_thread, th);
+    funcall0(StaticSymbolFunction(ATTACH_FOREIGN_THREAD));
+    thread_sigmask(SIG_SETMASK, &scribble.oldset, 0);
+    unblock_gc_signals();
+    return th;
+}
+
+static void detach_foreign_thread_at_exit(void* arg)
+{
+    struct thread *th = arg;
+    init_thread_data scribble;
+    /* Without GCC_TLS, the current thread lives in a pthread key too,
+     * which may have been cleared before this destructor runs */
+    ASSIGN_CURRENT_THREAD(th);
+    block_deferrable_signals(&scribble.oldset);
+    funcall0(StaticSymbolFunction(DETACH_FOREIGN_THREAD));
+    detach_os_thread(&scribble);
+}
+#endif
+
 #if defined(LISP_FEATURE_X86_64) && !defined(LISP_FEATURE_WIN32)
 extern void funcall_alien_callback(lispobj arg1, lispobj arg2, lispobj arg0,
                                    struct thread* thread)
@@ -782,6 +869,10 @@ callback_wrapper_trampoline(
     lispobj arg0, lispobj arg1, lispobj arg2)
 {
     struct thread* th = get_sb_vm_thread();
+#ifndef LISP_FEATURE_SB_SAFEPOINT
+    if (!th && keep_foreign_threads_attached)
+        th = attach_foreign_thread();
+#endif
     if (!th) {                  /* callback invoked in non-lisp thread */
         init_thread_data scribble;
         attach_os_thread(&scribble);
@@ -854,6 +945,48 @@ callback_wrapper_trampoline(
  * On sb-safepoint builds one page before the thread base is used for the foreign calls safepoint.
  */
 
+#if defined LISP_FEATURE_SB_THREAD && defined LISP_FEATURE_LINUX && defined MFD_CLOEXEC
+#define MAP_TLS_MARKER_PAGES
+/* Each thread has a TLS slot for every symbol that any thread has bound, but
+ * binds few of them itself. So rather than storing NO_TLS_VALUE_MARKER into
+ * every slot of a new thread, the whole pages of its TLS are mapped
+ * copy-on-write from a file that holds nothing but the marker. The threads
+ * share those pages until they write them, so a large --tls-limit costs each
+ * thread only the pages it writes to, and starting a thread touches none.
+ * Mapping over the memory of a recycled thread discards what it left there. */
+static int tls_marker_fd = -1; // or -2 if there can't be one
+static int map_tls_marker_pages(lispobj* start, lispobj* end)
+{
+    int fd = tls_marker_fd;
+    if (fd == -1) {
+        size_t size = ALIGN_UP(dynamic_values_bytes, os_vm_page_size);
+        fd = memfd_create("sbcl-tls", MFD_CLOEXEC);
+        if (fd >= 0) {
+            lispobj* words = ftruncate(fd, size) ? MAP_FAILED
+                : mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+            if (words == MAP_FAILED) {
+                close(fd);
+                fd = -2;
+            } else {
+                lispobj* ptr;
+                for (ptr = words; ptr < words + size / N_WORD_BYTES; ++ptr)
+                    *ptr = NO_TLS_VALUE_MARKER_WIDETAG;
+                munmap(words, size);
+            }
+        } else
+            fd = -2;
+        int old = __sync_val_compare_and_swap(&tls_marker_fd, -1, fd);
+        if (old != -1) { // another thread got there first
+            if (fd >= 0) close(fd);
+            fd = old;
+        }
+    }
+    return fd >= 0 &&
+        mmap(start, (char*)end - (char*)start, PROT_READ|PROT_WRITE,
+             MAP_PRIVATE|MAP_FIXED, fd, 0) == start;
+}
+#endif
+
 struct thread *
 alloc_thread_struct(void* spaces, lispobj start_routine) {
     /* May as well allocate all the spaces at once: it saves us from
@@ -896,6 +1029,14 @@ alloc_thread_struct(void* spaces, lispobj start_routine) {
     memset(th, 0, sizeof *th);
     lispobj* ptr = (lispobj*)(th + 1);
     lispobj* end = (lispobj*)((char*)th + dynamic_values_bytes);
+#ifdef MAP_TLS_MARKER_PAGES
+    lispobj* pages = PTR_ALIGN_UP(ptr, os_vm_page_size);
+    lispobj* pages_end = PTR_ALIGN_DOWN(end, os_vm_page_size);
+    if (pages < pages_end && map_tls_marker_pages(pages, pages_end)) {
+        while (ptr < pages) *ptr++ = NO_TLS_VALUE_MARKER_WIDETAG;
+        ptr = pages_end;
+    }
+#endif
     while (ptr < end) *ptr++ = NO_TLS_VALUE_MARKER_WIDETAG;
     th->tls_size = dynamic_values_bytes;
 #endif
@@ -923,7 +1064,13 @@ alloc_thread_struct(void* spaces, lispobj start_routine) {
     th->control_stack_end = th->binding_stack_start;
 
     if (zeroize_stack) {
-#if GENCGC_IS_PRECISE
+#ifdef LISP_FEATURE_LINUX
+    /* Zero all three stacks by giving their memory back. Linux maps in
+     * zeroed pages as they are touched, so the new thread starts with no
+     * more memory than a fresh one, however deep the old one went.
+     * The guard pages stay protected. */
+        madvise(aligned_spaces, csp_page - aligned_spaces, MADV_DONTNEED);
+#elif GENCGC_IS_PRECISE
     /* Clear the entire control stack. Without this I was able to induce a GC failure
      * in a test which hammered on thread creation for hours. The control stack is
      * scavenged before the heap, so a stale word could point to the start (or middle)
@@ -1031,6 +1178,8 @@ alloc_thread_struct(void* spaces, lispobj start_routine) {
 
     thread_interrupt_data(th).pending_handler = 0;
     thread_interrupt_data(th).gc_blocked_deferrables = 0;
+    thread_interrupt_data(th).lazily_blocked = 0;
+    thread_interrupt_data(th).lazy_block_interrupted = 0;
 #if HAVE_ALLOCATION_TRAP_CONTEXT
     thread_interrupt_data(th).allocation_trap_context = 0;
 #endif
@@ -1062,6 +1211,7 @@ alloc_thread_struct(void* spaces, lispobj start_routine) {
     for (i = 0; i<NUM_PRIVATE_EVENTS; ++i)
         thread_private_events(th,i) = CreateEvent(NULL,FALSE,FALSE,NULL);
     thread_extra_data(th)->synchronous_io_handle_and_flag = 0;
+    thread_extra_data(th)->iocp = 0;
 #endif
     th->stepping = 0;
     return th;
@@ -1156,8 +1306,10 @@ int release_gc_lock() { return mutex_release(&in_gc_lock); }
  * (so that dereferencing was valid), but if dereferencing was valid, then the thread
  * can't have died (i.e. if ESRCH could be returned, then that implies that
  * the memory shouldn't be there) */
+static uint64_t stop_the_world_time; // for gc_pause_histogram
 void gc_stop_the_world()
 {
+    stop_the_world_time = gc_monotonic_nsec();
 #ifdef COLLECT_GC_STATS
     struct timespec stw_begin_time, stw_end_time;
     // Measuring the wait time has to use a realtime clock, not a thread clock
@@ -1178,6 +1330,7 @@ void gc_stop_the_world()
             struct extra_thread_data *semaphores = thread_extra_data(th);
             os_sem_wait(&semaphores->state_sem, "notify stop");
             int state = get_thread_state(th);
+            semaphores->stop_for_gc_pc = 0;
             if (state == STATE_RUNNING) {
                 rc = pthread_kill(th->os_thread,SIG_STOP_FOR_GC);
                 /* This used to bogusly check for ESRCH.
@@ -1190,12 +1343,27 @@ void gc_stop_the_world()
             os_sem_post(&semaphores->state_sem, "notified stop");
         }
     }
+    /* The thread that we spent longest waiting for is the one that held
+     * up the stop, though not necessarily the last to arrive */
+    uint64_t seen = stop_the_world_time, worst_wait = 0;
+    uword_t worst_arrival = 0, worst_pc = 0, worst_tid = 0;
     for_each_thread(th) {
         if (th != me) {
             __attribute__((unused)) int state = thread_wait_until_not(STATE_RUNNING, th);
             gc_assert(state != STATE_RUNNING);
+            uint64_t now = gc_monotonic_nsec();
+            gc_record_pause(GC_PHASE_SAFEPOINT, now - stop_the_world_time);
+            if (!worst_tid || now - seen > worst_wait) {
+                worst_wait = now - seen;
+                worst_arrival = now - stop_the_world_time;
+                worst_pc = thread_extra_data(th)->stop_for_gc_pc;
+                worst_tid = th->os_kernel_tid;
+            }
+            seen = now;
         }
     }
+    if (worst_tid) gc_note_stop_offender(worst_arrival, worst_pc, worst_tid);
+    gc_record_pause(GC_PHASE_STOP, gc_monotonic_nsec() - stop_the_world_time);
     FSHOW_SIGNAL((stderr,"/gc_stop_the_world:end\n"));
 #ifdef COLLECT_GC_STATS
     clock_gettime(CLOCK_MONOTONIC, &stw_end_time);
@@ -1207,6 +1375,7 @@ void gc_stop_the_world()
 
 void gc_start_the_world()
 {
+    gc_record_pause(GC_PHASE_PAUSE, gc_monotonic_nsec() - stop_the_world_time);
 #ifdef COLLECT_GC_STATS
     struct timespec gc_end_time;
     clock_gettime(CLOCK_MONOTONIC, &gc_end_time);
@@ -1247,6 +1416,7 @@ void gc_start_the_world()
 
     lock_ret = mutex_release(&all_threads_lock);
     gc_assert(lock_ret);
+    finalizer_thread_wake_if_queued();
 }
 
 #endif /* !LISP_FEATURE_SB_SAFEPOINT */
@@ -4,6 +4,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stddef.h>
+#include <time.h>
 #include "sbcl.h"
 #include "globals.h"
 #include "runtime.h"
@@ -91,6 +92,8 @@ struct extra_thread_data
     // make these "only" 4 bytes each, instead of lispwords.
     uint32_t state_not_running_waitcount;
     uint32_t state_not_stopped_waitcount;
+    // Where the thread was when it stopped for the most recent GC
+    uword_t stop_for_gc_pc;
 #endif
 #if defined LISP_FEATURE_SB_THREAD && defined LISP_FEATURE_UNIX
     // According to https://github.com/adrienverge/openfortivpn/issues/105
@@ -102,6 +105,36 @@ struct extra_thread_data
     os_sem_t sprof_sem;
 #endif
     int sprof_lock;
+#ifdef LISP_FEATURE_LINUX
+    // The source of this thread's own profiling signals, if any.
+    // See sb_sprof_start_thread_sampler()
+    int sprof_sampler;
+    int sprof_perf_fd;
+    timer_t sprof_timer;
+#endif
+    // Byte-based allocation sampling, see alloc_samples_due()
+    uword_t alloc_sample_mean;
+    sword_t alloc_sample_countdown;
+    uint64_t alloc_sample_rng;
+    // The arena that the mixed and cons TLABs allocate from, if any.
+    // See arena_switch()
+    struct arena* arena;
+#if defined LISP_FEATURE_GENCGC && defined LISP_FEATURE_SB_THREAD
+    // What is left of the block that this thread last took from the shared
+    // code region, for small code objects. See alloc_code_object()
+    char* code_chunk_free;
+    char* code_chunk_end;
+#endif
+#ifdef THREAD_PAGE_CACHE_SIZE
+    // for the mixed and the cons TLAB respectively
+    struct thread_page_cache page_cache[2];
+#endif
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+#define MAX_ALLOCATOR_SIZE_CLASSES 10
+    // The page of fixedobj space that this thread owns for each size class,
+    // or 0. See alloc_immobile_fixedobj()
+    int fixedobj_alloc_page[MAX_ALLOCATOR_SIZE_CLASSES];
+#endif
 #ifdef LISP_FEATURE_WIN32
     // these are different from the masks that interrupt_data holds
     sigset_t pending_signal_set;
@@ -115,6 +148,8 @@ struct extra_thread_data
     os_context_register_t carried_base_pointer;
     HANDLE synchronous_io_handle_and_flag;
     void* waiting_on_address; // used only if #+sb-futex
+    // the completion port and descriptor watches of sb_select(), if used
+    struct win32_iocp* iocp;
 #endif
 };
 #define thread_extra_data(thread) \
@@ -445,7 +480,20 @@ extern int sb_GetTID();
 #endif
 
 #ifdef LISP_FEATURE_DARWIN_JIT
-#define THREAD_JIT(x) pthread_jit_write_protect_np((x))
+/* MAP_JIT pages are either writable or executable for each thread.
+ * THREAD_JIT(0) makes them writable and THREAD_JIT(1) executable again,
+ * and the pairs nest: only the outermost pair changes the protection,
+ * so that a GC or a batch of writes toggles it once however many
+ * writers it calls. */
+extern __thread int jit_write_depth;
+static inline void thread_jit(int protect)
+{
+    if (protect) {
+        if (--jit_write_depth == 0) pthread_jit_write_protect_np(1);
+    } else if (jit_write_depth++ == 0)
+        pthread_jit_write_protect_np(0);
+}
+#define THREAD_JIT(x) thread_jit((x))
 #else
 #define THREAD_JIT(x)
 #endif
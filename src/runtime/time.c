@@ -18,11 +18,383 @@
 #include "sbcl.h"
 #include "runtime.h"
 
+#ifndef LISP_FEATURE_WIN32
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* localtime_r() takes a lock in the C library, and may stat the zone
+ * file, for every call. So the zone named by TZ is read once, from its
+ * TZif file or as a POSIX TZ string, into a table that is looked up
+ * without locks. The table is rebuilt when TZ changes, or after
+ * reset_timezone_cache(). Tables are never freed, as another thread
+ * may be looking at one; they are small and rarely replaced. When the
+ * zone can't be understood, localtime_r() is used as before. */
+
+struct tz_rule_date {
+    char kind;                  /* 'J', 'D' (zero-based day) or 'M' */
+    int month, week, day;       /* day is the day of the week for 'M' */
+    int time;                   /* seconds after local midnight */
+};
+
+struct tz_table {
+    char *tz;                   /* the value of TZ, or NULL if unset */
+    int usable;
+    int n_transitions;
+    int64_t *transitions;
+    unsigned char *transition_types;
+    int n_types;
+    int32_t *utoffs;
+    unsigned char *isdst;
+    /* For times after the last transition, from the POSIX TZ string */
+    int has_rule, rule_has_dst;
+    int32_t std_utoff, dst_utoff;
+    struct tz_rule_date start, end;
+};
+
+static struct tz_table *current_tz_table;
+
+void reset_timezone_cache(void)
+{
+    __atomic_store_n(&current_tz_table, NULL, __ATOMIC_RELEASE);
+}
+
+static const char *parse_tz_name(const char *p)
+{
+    const char *start = p;
+    if (*p == '<') {
+        while (*p && *p != '>') p++;
+        return (*p == '>' && p - start > 3) ? p + 1 : NULL;
+    }
+    while ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) p++;
+    return p - start >= 3 ? p : NULL;
+}
+
+static int parse_tz_number(const char **pp, int max)
+{
+    const char *p = *pp;
+    int n = 0;
+    if (*p < '0' || *p > '9') return -1;
+    while (*p >= '0' && *p <= '9') {
+        n = n * 10 + (*p++ - '0');
+        if (n > max) return -1;
+    }
+    *pp = p;
+    return n;
+}
+
+/* [+-]hh[:mm[:ss]], in seconds */
+static const char *parse_tz_time(const char *p, int max_hours, int *seconds)
+{
+    int sign = 1, h, m = 0, s = 0;
+    if (*p == '+' || *p == '-') sign = (*p++ == '-') ? -1 : 1;
+    if ((h = parse_tz_number(&p, max_hours)) < 0) return NULL;
+    if (*p == ':') {
+        p++;
+        if ((m = parse_tz_number(&p, 59)) < 0) return NULL;
+        if (*p == ':') {
+            p++;
+            if ((s = parse_tz_number(&p, 59)) < 0) return NULL;
+        }
+    }
+    *seconds = sign * ((h * 60 + m) * 60 + s);
+    return p;
+}
+
+static const char *parse_tz_date(const char *p, struct tz_rule_date *date)
+{
+    if (*p == 'M') {
+        p++;
+        date->kind = 'M';
+        if ((date->month = parse_tz_number(&p, 12)) < 1 || *p++ != '.'
+            || (date->week = parse_tz_number(&p, 5)) < 1 || *p++ != '.'
+            || (date->day = parse_tz_number(&p, 6)) < 0)
+            return NULL;
+    } else if (*p == 'J') {
+        p++;
+        date->kind = 'J';
+        if ((date->day = parse_tz_number(&p, 365)) < 1) return NULL;
+    } else {
+        date->kind = 'D';
+        if ((date->day = parse_tz_number(&p, 365)) < 0) return NULL;
+    }
+    date->time = 2 * 3600;
+    if (*p == '/')
+        p = parse_tz_time(p + 1, 167, &date->time);
+    return p;
+}
+
+/* A POSIX TZ string such as "CET-1CEST,M3.5.0,M10.5.0/3" */
+static int parse_tz_rule(const char *p, struct tz_table *table)
+{
+    int offset;
+    if (!(p = parse_tz_name(p)) || !(p = parse_tz_time(p, 24, &offset)))
+        return 0;
+    table->std_utoff = -offset;
+    table->rule_has_dst = 0;
+    if (*p) {
+        if (!(p = parse_tz_name(p))) return 0;
+        table->dst_utoff = table->std_utoff + 3600;
+        if (*p && *p != ',') {
+            if (!(p = parse_tz_time(p, 24, &offset))) return 0;
+            table->dst_utoff = -offset;
+        }
+        if (*p) {
+            if (*p++ != ',' || !(p = parse_tz_date(p, &table->start))
+                || *p++ != ',' || !(p = parse_tz_date(p, &table->end))
+                || *p)
+                return 0;
+        } else {
+            /* The C library's default, the US rules since 2007 */
+            table->start = (struct tz_rule_date){'M', 3, 2, 0, 2 * 3600};
+            table->end = (struct tz_rule_date){'M', 11, 1, 0, 2 * 3600};
+        }
+        table->rule_has_dst = 1;
+    }
+    table->has_rule = 1;
+    return 1;
+}
+
+static int leap_year_p(int64_t year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+/* Days from 1970-01-01 to YEAR-MONTH-DAY in the proleptic Gregorian
+ * calendar, after Howard Hinnant's days_from_civil */
+static int64_t days_from_civil(int64_t year, int month, int day)
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yoe = year - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int64_t year_of_time(int64_t t)
+{
+    int64_t days = t >= 0 ? t / 86400 : -((-t + 86399) / 86400);
+    int64_t year = 1970 + days / 366;
+    while (days_from_civil(year + 1, 1, 1) <= days) year++;
+    while (days_from_civil(year, 1, 1) > days) year--;
+    return year;
+}
+
+/* The UTC time at which DATE of YEAR happens at local offset UTOFF */
+static int64_t rule_date_time(int64_t year, struct tz_rule_date *date,
+                              int32_t utoff)
+{
+    static const int month_days[] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    int64_t day;
+    switch (date->kind) {
+    case 'J':
+        day = days_from_civil(year, 1, 1) + date->day - 1
+            + (leap_year_p(year) && date->day >= 60);
+        break;
+    case 'D':
+        day = days_from_civil(year, 1, 1) + date->day;
+        break;
+    default: {
+        int64_t first = days_from_civil(year, date->month, 1);
+        int wday = (int)(((first + 4) % 7 + 7) % 7); /* 1970-01-01 was a Thursday */
+        int mday = 1 + (date->day - wday + 7) % 7 + (date->week - 1) * 7;
+        int length = month_days[date->month - 1]
+            + (date->month == 2 && leap_year_p(year));
+        while (mday > length) mday -= 7;
+        day = first + mday - 1;
+    }
+    }
+    return day * 86400 + date->time - utoff;
+}
+
+static int32_t rule_utoff(struct tz_table *table, int64_t t, boolean *dst)
+{
+    *dst = 0;
+    if (!table->rule_has_dst)
+        return table->std_utoff;
+    /* The rules of the year in UTC, and of 1970 before then, as in glibc */
+    int64_t year = t < 0 ? 1970 : year_of_time(t);
+    int64_t start = rule_date_time(year, &table->start, table->std_utoff);
+    int64_t end = rule_date_time(year, &table->end, table->dst_utoff);
+    *dst = start < end ? (start <= t && t < end) : !(end <= t && t < start);
+    return *dst ? table->dst_utoff : table->std_utoff;
+}
+
+static uint64_t tzif_be(const unsigned char *p, int n)
+{
+    uint64_t x = 0;
+    while (n--) x = (x << 8) | *p++;
+    return x;
+}
+
+/* RFC 8536. Only the 64-bit data of version 2 and later is used; zones
+ * with leap seconds are left to the C library. */
+static int parse_tzif(const unsigned char *data, size_t size,
+                      struct tz_table *table)
+{
+    const unsigned char *p = data;
+    if (size < 44 || memcmp(p, "TZif", 4) || p[4] < '2') return 0;
+    int word = 4;
+    for (int pass = 0; pass < 2; pass++) {
+        if ((size_t)(p - data) + 44 > size || memcmp(p, "TZif", 4)) return 0;
+        uint64_t isutcnt = tzif_be(p + 20, 4), isstdcnt = tzif_be(p + 24, 4),
+            leapcnt = tzif_be(p + 28, 4), timecnt = tzif_be(p + 32, 4),
+            typecnt = tzif_be(p + 36, 4), charcnt = tzif_be(p + 40, 4);
+        uint64_t length = timecnt * (word + 1) + typecnt * 6 + charcnt
+            + leapcnt * (word + 4) + isstdcnt + isutcnt;
+        p += 44;
+        if (timecnt > 100000 || typecnt > 256 || charcnt > 100000
+            || leapcnt > 100000 || isstdcnt > 256 || isutcnt > 256
+            || length > size - (size_t)(p - data))
+            return 0;
+        if (pass == 0) {
+            p += length;
+            word = 8;
+            continue;
+        }
+        if (leapcnt || !typecnt) return 0;
+        table->n_transitions = (int)timecnt;
+        table->n_types = (int)typecnt;
+        table->transitions = calloc(timecnt + 1, sizeof (int64_t));
+        table->transition_types = calloc(timecnt + 1, 1);
+        table->utoffs = calloc(typecnt, sizeof (int32_t));
+        table->isdst = calloc(typecnt, 1);
+        if (!table->transitions || !table->transition_types
+            || !table->utoffs || !table->isdst)
+            return 0;
+        for (uint64_t i = 0; i < timecnt; i++, p += 8) {
+            table->transitions[i] = (int64_t)tzif_be(p, 8);
+            if (i && table->transitions[i] <= table->transitions[i-1]) return 0;
+        }
+        for (uint64_t i = 0; i < timecnt; i++, p++) {
+            if (*p >= typecnt) return 0;
+            table->transition_types[i] = *p;
+        }
+        for (uint64_t i = 0; i < typecnt; i++, p += 6) {
+            table->utoffs[i] = (int32_t)tzif_be(p, 4);
+            table->isdst[i] = p[4] != 0;
+        }
+        p += charcnt + isstdcnt + isutcnt;
+    }
+    /* The footer, "\n<TZ string>\n", for times after the last transition */
+    const unsigned char *end = data + size;
+    if (p < end && *p == '\n') {
+        const unsigned char *q = memchr(p + 1, '\n', end - p - 1);
+        if (q && q > p + 1) {
+            char rule[256];
+            size_t n = q - p - 1;
+            if (n >= sizeof rule) return 0;
+            memcpy(rule, p + 1, n);
+            rule[n] = 0;
+            if (!parse_tz_rule(rule, table)) return 0;
+        }
+    }
+    return 1;
+}
+
+static int load_tzif_file(const char *name, struct tz_table *table)
+{
+    char path[4096];
+    if (*name != '/') {
+        const char *dir = getenv("TZDIR");
+        if (!dir || !*dir) dir = "/usr/share/zoneinfo";
+        if ((size_t)snprintf(path, sizeof path, "%s/%s", dir, name) >= sizeof path)
+            return 0;
+        name = path;
+    }
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    int ok = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size < (1<<20)) {
+        unsigned char *data = malloc(st.st_size);
+        if (data && read(fd, data, st.st_size) == st.st_size)
+            ok = parse_tzif(data, st.st_size, table);
+        free(data);
+    }
+    close(fd);
+    return ok;
+}
+
+static struct tz_table *make_tz_table(const char *tz)
+{
+    struct tz_table *table = calloc(1, sizeof (struct tz_table));
+    if (!table) return NULL;
+    if (tz && !(table->tz = strdup(tz))) {
+        free(table);
+        return NULL;
+    }
+    if (!tz)
+        table->usable = load_tzif_file("/etc/localtime", table);
+    else if (!*tz) {
+        table->has_rule = 1;    /* UTC */
+        table->usable = 1;
+    } else if (*tz == ':')
+        table->usable = load_tzif_file(tz + 1, table);
+    else {
+        table->usable = load_tzif_file(tz, table);
+        if (!table->usable) {
+            struct tz_table rule = { 0 };
+            if (parse_tz_rule(tz, &rule)) {
+                rule.tz = table->tz;
+                *table = rule;
+                table->usable = 1;
+            }
+        }
+    }
+    return table;
+}
+
+static struct tz_table *tz_table(void)
+{
+    const char *tz = getenv("TZ");
+    struct tz_table *table = __atomic_load_n(&current_tz_table, __ATOMIC_ACQUIRE);
+    if (table && (tz ? table->tz && !strcmp(tz, table->tz) : !table->tz))
+        return table;
+    table = make_tz_table(tz);
+    if (table)
+        __atomic_store_n(&current_tz_table, table, __ATOMIC_RELEASE);
+    return table;
+}
+
+/* Seconds east of UTC at WHEN */
+static int table_utoff(struct tz_table *table, int64_t when, boolean *dst)
+{
+    int n = table->n_transitions;
+    if (n == 0 || when < table->transitions[0]) {
+        if (n == 0 && table->has_rule)
+            return rule_utoff(table, when, dst);
+        *dst = table->isdst[0];
+        return table->utoffs[0];
+    }
+    if (when >= table->transitions[n-1] && table->has_rule)
+        return rule_utoff(table, when, dst);
+    int low = 0, high = n;       /* transitions[low] <= when < transitions[high] */
+    while (high - low > 1) {
+        int mid = (low + high) / 2;
+        if (table->transitions[mid] <= when) low = mid; else high = mid;
+    }
+    int type = table->transition_types[low];
+    *dst = table->isdst[type];
+    return table->utoffs[type];
+}
+#endif
+
 int get_timezone(time_t when, boolean *dst)
 {
     struct tm ltm, gtm;
     int sw;
 
+#ifndef LISP_FEATURE_WIN32
+    struct tz_table *table = tz_table();
+    if (table && table->usable)
+        return -table_utoff(table, when, dst);
+#endif
+
 #ifdef LISP_FEATURE_WIN32
     /* No _r versions on Windows, but the API documentation also
      * doesn't warn them about being non-reentrant... So here's
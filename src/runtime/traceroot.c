@@ -2,8 +2,10 @@
 #include "arch.h"
 #include "runtime.h"
 #include "lispregs.h"
+#include "gc.h"
 #include "gc-internal.h"
 #include "gc-private.h"
+#include "gencgc-private.h"
 #include "code.h"
 #include "genesis/closure.h"
 #include "genesis/cons.h"
@@ -30,25 +32,6 @@
 #include <sys/resource.h> // for getrusage()
 #endif
 
-#ifndef TRACEROOT_USE_ABSL_HASHMAP
-#define TRACEROOT_USE_ABSL_HASHMAP 0
-#endif
-
-#if TRACEROOT_USE_ABSL_HASHMAP
-extern void* new_absl_hashmap(int);
-extern void absl_hashmap_destroy(void*);
-extern unsigned absl_hashmap_get(void*,lispobj);
-extern unsigned* absl_hashmap_get_ref(void*,lispobj);
-extern int absl_hashmap_size(void*,int*);
-typedef void* inverted_heap_t;
-#define inverted_heap_get(graph, key) absl_hashmap_get(graph, key)
-#define inverted_heap_get_ref(graph, key) absl_hashmap_get_ref(graph, key)
-#else
-typedef struct hopscotch_table* inverted_heap_t;
-#define inverted_heap_get(graph, key) hopscotch_get(graph, key, 0)
-#define inverted_heap_get_ref(graph, key) hopscotch_get_ref(graph, key)
-#endif
-
 int heap_trace_verbose = 0;
 
 extern generation_index_t gencgc_oldest_gen_to_gc;
@@ -67,22 +50,31 @@ struct layer {
     int count;
 };
 
-/// memory in which to build the object lists comprising the
-/// values in 'inverted_heap', the hashtable which maps each object
-/// to a list of objects pointing to it.
-struct scratchpad {
-    char* base, *free, *end;
+/// The inverted heap is every reference from one object to another,
+/// as a pair of compressed pointers (see encode_pointer).
+/// The pairs are grouped into buckets by a hash of the target and sorted
+/// by target within each bucket, so that the referrers of any object form
+/// one contiguous run of edges, found by binary search.
+struct edge { uint32_t target, source; };
+#define EDGE_BUCKET_BITS 12
+#define N_EDGE_BUCKETS (1<<EDGE_BUCKET_BITS)
+struct inverted_heap {
+    struct edge* edges;
+    uword_t n_edges;
+    os_vm_size_t size; // of the mapping at 'edges'
+    uword_t bucket_start[N_EDGE_BUCKETS+1];
 };
+static inline int edge_bucket(uint32_t target) {
+    return (uint32_t)(target * 0x9E3779B1u) >> (32 - EDGE_BUCKET_BITS);
+}
 
+/// Each worker inverting the heap appends edges to its own array
+/// and counts how many of them fall in each bucket.
 struct scan_state {
     long n_objects;
-    long n_scanned_words;
-    long n_immediates;
-    long n_pointers;
-    int record_ptrs;
-    // A hashmap from object to list of objects pointing to it
-    struct hopscotch_table* inverted_heap;
-    struct scratchpad scratchpad;
+    struct edge* edges;
+    uword_t n_edges, capacity;
+    uword_t* bucket_count;
     lispobj ignored_objects;
     int keep_leaves;
 };
@@ -428,6 +420,24 @@ static inline lispobj decode_pointer(uint32_t encoding)
         return encoding; // Literal pointer
 }
 
+/// Return the first edge into 'target', and store one past the last in '*end'.
+static struct edge* find_referrers(struct inverted_heap* graph, lispobj target,
+                                   struct edge** end)
+{
+    uint32_t key = encode_pointer((lispobj)native_pointer(target));
+    int bucket = edge_bucket(key);
+    struct edge* lo = graph->edges + graph->bucket_start[bucket];
+    struct edge* limit = graph->edges + graph->bucket_start[bucket+1];
+    struct edge* hi = limit;
+    while (lo < hi) {
+        struct edge* mid = lo + (hi - lo) / 2;
+        if (mid->target < key) lo = mid + 1; else hi = mid;
+    }
+    for (hi = lo; hi < limit && hi->target == key; ++hi) ;
+    *end = hi;
+    return lo;
+}
+
 static void maybe_show_object_name(lispobj obj, FILE* stream)
 {
     lispobj package, package_name;
@@ -471,6 +481,20 @@ static lispobj mkcons(lispobj car, lispobj cdr)
 static lispobj liststar3(lispobj x, lispobj y, lispobj z) {
   return mkcons(x, mkcons(y, z));
 }
+/// Copy a path or a tail of one. The (object . wordindex) nodes are copied
+/// along with the spine because Lisp postprocessing modifies them.
+/// The root descriptor at the end is shared.
+static lispobj copy_path(lispobj path)
+{
+    lispobj result = NIL, *tail = &result;
+    for ( ; path != NIL ; path = CONS(path)->cdr) {
+        lispobj elt = CONS(path)->car;
+        if (CONS(path)->cdr != NIL) elt = mkcons(CONS(elt)->car, CONS(elt)->cdr);
+        *tail = mkcons(elt, NIL);
+        tail = &CONS(*tail)->cdr;
+    }
+    return result;
+}
 static lispobj make_sap(char* value)
 {
     struct sap *sap = (struct sap*)
@@ -482,15 +506,20 @@ static lispobj make_sap(char* value)
 
 /// Find any shortest path to 'object' starting at a tenured object or a thread stack.
 /// Return the path as a list, or 0 if a path could not be found.
+/// 'on_path' maps each object on a path found earlier in the same batch to
+/// the cons cell whose car is that object's node. Reaching such an object
+/// ends the search, and the rest of the path is copied from the earlier one.
+/// The result is then as short as possible only up to the point of joining.
 static lispobj trace1(lispobj object,
                       struct hopscotch_table* targets,
                       struct hopscotch_table* visited,
-                      inverted_heap_t graph,
-                      struct scratchpad* scratchpad,
+                      struct hopscotch_table* on_path,
+                      struct inverted_heap* graph,
                       int n_pins, lispobj* pins, void (*context_scanner)(),
                       int criterion)
 {
     struct node* anchor = 0;
+    lispobj joined_path = hopscotch_get(on_path, object, 0);
     lispobj thread_ref;
     enum ref_kind root_kind;
     struct thread* root_thread;
@@ -502,6 +531,7 @@ static lispobj trace1(lispobj object,
     struct layer* top_layer = 0;
     int layer_capacity = 0;
 
+    if (joined_path) return copy_path(CONS(joined_path)->cdr);
     hopscotch_put(targets, object, 1);
     while ((thread_ref = examine_threads(targets, context_scanner, n_pins, pins,
                                          &root_kind, &root_thread, &thread_pc,
@@ -516,13 +546,13 @@ static lispobj trace1(lispobj object,
         if (heap_trace_verbose)
             printf("Next layer: Looking for %d object(s)\n", targets->count);
         for_each_hopscotch_key(i, target, (*targets)) {
-            uint32_t list = inverted_heap_get(graph, target);
+            struct edge *edge, *end;
+            edge = find_referrers(graph, target, &end);
             if (heap_trace_verbose>1) {
-                uint32_t list1 = list;
+                struct edge* edge1;
                 fprintf(stderr, "target=%p srcs=", (void*)target);
-                while (list1) {
-                    uint32_t* cell = (uint32_t*)(scratchpad->base + list1);
-                    lispobj* ptr = (lispobj*)decode_pointer(cell[0]);
+                for (edge1 = edge; edge1 < end; ++edge1) {
+                    lispobj* ptr = (lispobj*)decode_pointer(edge1->source);
                     if (hopscotch_containsp(visited, (lispobj)ptr))
                         fprintf(stderr, "%p ", ptr);
                     else {
@@ -530,14 +560,11 @@ static lispobj trace1(lispobj object,
                         int nwords = OBJECT_SIZE(word, ptr);
                         fprintf(stderr, "%p+%d ", ptr, nwords);
                     }
-                    list1 = cell[1];
                 }
                 putc('\n',stderr);
             }
-            while (list && !anchor) {
-                uint32_t* cell = (uint32_t*)(scratchpad->base + list);
-                lispobj ptr = decode_pointer(cell[0]);
-                list = cell[1];
+            for ( ; edge < end && !anchor ; ++edge) {
+                lispobj ptr = decode_pointer(edge->source);
                 if (hopscotch_containsp(visited, ptr))
                     continue;
                 int wordindex = find_ref((lispobj*)ptr, target);
@@ -551,12 +578,19 @@ static lispobj trace1(lispobj object,
                 hopscotch_insert(visited, ptr, 1);
                 add_to_layer((lispobj*)ptr, wordindex,
                              top_layer, &layer_capacity);
+                struct node* node = &top_layer->nodes[top_layer->count-1];
                 // Stop if the object at 'ptr' is tenured.
                 if (root_p(ptr, criterion)) {
                     if (heap_trace_verbose) {
                         fprintf(stderr, "Stopping at %p: tenured\n", (void*)ptr);
                     }
-                    anchor = &top_layer->nodes[top_layer->count-1];
+                    anchor = node;
+                } else if (on_path->count &&
+                           (joined_path = hopscotch_get(on_path, node->object, 0)) != 0) {
+                    if (heap_trace_verbose) {
+                        fprintf(stderr, "Stopping at %p: on a known path\n", (void*)ptr);
+                    }
+                    anchor = node;
                 }
             }
         }
@@ -577,8 +611,8 @@ static lispobj trace1(lispobj object,
         }
         if (heap_trace_verbose>1)
             printf("Found %d object(s)\n", top_layer->count);
-        // The top layer's last object if static or tenured
-        // stops the scan. (And no more objects go in the top layer)
+        // The top layer's last object if static, tenured, or on a known
+        // path stops the scan. (And no more objects go in the top layer)
         if (anchor)
             break;
         // Transfer the top layer objects into 'targets'
@@ -590,8 +624,9 @@ static lispobj trace1(lispobj object,
         }
     }
 
-    lispobj path_node = NIL;
+    lispobj path;
     if (thread_ref) {
+        lispobj path_node;
   #if 0
         char *ref_kind_name[4] = {"heap","C stack","bindings","TLS"};
         fprintf(stderr,
@@ -616,15 +651,16 @@ static lispobj trace1(lispobj object,
                                   (lispobj)root_thread,
                                   make_sap(thread_pc));
         }
+        path = mkcons(path_node, NIL);
+    } else if (joined_path) { // Stopped at an object on a known path
+        path = copy_path(CONS(joined_path)->cdr);
     } else { // Stopped at (pseudo)static object
         if (heap_trace_verbose) {
             fprintf(stderr, "Anchor object is @ %p. word[%d]\n",
                     native_pointer(anchor->object), anchor->wordindex);
         }
-        path_node = liststar3(0, 0, 0);
+        path = mkcons(liststar3(0, 0, 0), NIL);
     }
-
-    lispobj path = mkcons(path_node, NIL);
     target = thread_ref;
     while (top_layer) {
         struct node next = *anchor;
@@ -664,10 +700,8 @@ static lispobj trace1(lispobj object,
     return path;
 }
 
-// Add 'source' to the list of objects keyed by 'target' in the inverted heap.
+// Add an edge from 'source' to 'target' to the worker's part of the inverted heap.
 // Note that 'source' has no lowtag, and 'target' does.
-// Pointer compression is used: the linked list of source objects
-// is built using offsets into the scratchpad rather than absolute addresses.
 // Return 1 if and only if 'target' was actually added to the graph.
 static boolean record_ptr(lispobj* source, lispobj target,
                           struct scan_state* ss)
@@ -677,27 +711,30 @@ static boolean record_ptr(lispobj* source, lispobj target,
             leaf_obj_widetag_p(widetag_of(native_pointer(target)))) return 0;
     }
     target = canonical_obj(target);
-    uint32_t* new_cell = (uint32_t*)ss->scratchpad.free;
-    uint32_t* next = new_cell + 2;
-    gc_assert((char*)next <= ss->scratchpad.end);
-    ss->scratchpad.free = (char*)next;
-    if (ss->scratchpad.free > ss->scratchpad.end) lose("undersized scratchpad");
-    new_cell[0] = encode_pointer((lispobj)source);
-    uint32_t* valref = inverted_heap_get_ref(ss->inverted_heap, target);
-    new_cell[1] = *valref;
-    *valref = (uint32_t)((char*)new_cell - ss->scratchpad.base);
+    if (ss->n_edges == ss->capacity) {
+        // Don't use malloc: this may run on a GC helper thread while the
+        // world is stopped, and some stopped thread could own a malloc lock.
+        uword_t capacity = ss->capacity ? 2 * ss->capacity : 1<<16;
+        struct edge* edges = (struct edge*)os_allocate(capacity * sizeof (struct edge));
+        if (!edges) lose("Can't allocate %lu edges for heap inverse", (unsigned long)capacity);
+        if (ss->edges) {
+            memcpy(edges, ss->edges, ss->n_edges * sizeof (struct edge));
+            os_deallocate((os_vm_address_t)ss->edges, ss->capacity * sizeof (struct edge));
+        }
+        ss->edges = edges;
+        ss->capacity = capacity;
+    }
+    struct edge* edge = &ss->edges[ss->n_edges++];
+    edge->target = encode_pointer((lispobj)native_pointer(target));
+    edge->source = encode_pointer((lispobj)source);
+    ++ss->bucket_count[edge_bucket(edge->target)];
     return 1;
 }
 
 #define relevant_ptr_p(x) (find_page_index((void*)(x))>=0||immobile_space_p((lispobj)(x)))
 
-#define COUNT_POINTER(x) { ++n_scanned_words; \
-      if (!is_lisp_pointer(x)) ++n_immediates; \
-      else if (relevant_ptr_p(x)) ++n_pointers; }
-
 #define check_ptr(x) { \
-    if (count_only) COUNT_POINTER(x) \
-    else if (is_lisp_pointer(x) && relevant_ptr_p(x)) record_ptr(where,x,ss); }
+    if (is_lisp_pointer(x) && relevant_ptr_p(x)) record_ptr(where,x,ss); }
 
 static boolean ignorep(lispobj* base_ptr,
                        lispobj ignored_objects)
@@ -714,10 +751,8 @@ static uword_t build_refs(lispobj* where, lispobj* end,
 {
     lispobj layout;
     sword_t nwords, scan_limit, i;
-    uword_t n_objects = 0, n_scanned_words = 0,
-            n_immediates = 0, n_pointers = 0;
+    uword_t n_objects = 0;
 
-    boolean count_only = !ss->record_ptrs;
     for ( ; where < end ; where += nwords ) {
         if (ss->ignored_objects && ignorep(where, ss->ignored_objects)) {
             nwords = OBJECT_SIZE(*where, where);
@@ -796,7 +831,7 @@ static uword_t build_refs(lispobj* where, lispobj* end,
                 (widetag == RATIO_WIDETAG))
                 continue;
         }
-        if (widetag == SIMPLE_VECTOR_WIDETAG && ss->record_ptrs) {
+        if (widetag == SIMPLE_VECTOR_WIDETAG) {
             // Try to eliminate some duplicate edges in the reversed graph.
             // This is only a heuristic and will not eliminate all duplicate edges.
             // It helps for vectors which get initialized like #(#:FOO #:FOO ...)
@@ -815,110 +850,127 @@ static uword_t build_refs(lispobj* where, lispobj* end,
             for(i=1; i<scan_limit; ++i) check_ptr(where[i]);
         }
     }
-    if (count_only) {
-        ss->n_objects += n_objects;
-        ss->n_scanned_words += n_scanned_words;
-        ss->n_immediates += n_immediates;
-        ss->n_pointers += n_pointers;
-    }
+    ss->n_objects += n_objects;
     return 0;
 }
 #undef check_ptr
 
-#define show_tally(b,a) /* "before" and "after" */   \
-  if(heap_trace_verbose && !ss->record_ptrs) \
-    fprintf(stderr, "%ld objs, %ld ptrs, %ld immediates\n", \
-            a->n_objects - b.n_objects, a->n_pointers - b.n_pointers, \
-            (a->n_scanned_words - a->n_pointers) - (b.n_scanned_words - b.n_pointers))
-
-static void scan_spaces(struct scan_state* ss)
+/* Distribute one worker's edges to their places in the combined array.
+ * The worker's bucket counts were turned into insertion points */
+struct inversion {
+    struct inverted_heap* graph;
+    struct scan_state* ss;
+    page_index_t cursor; // next bucket to sort
+};
+static void scatter_edges(int worker, void* arg)
 {
-    struct scan_state old = *ss;
-    build_refs((lispobj*)NIL_SYMBOL_SLOTS_START, (lispobj*)NIL_SYMBOL_SLOTS_END, ss);
-    build_refs((lispobj*)STATIC_SPACE_OBJECTS_START, static_space_free_pointer, ss);
-    show_tally(old, ss);
-#ifdef LISP_FEATURE_IMMOBILE_SPACE
-    old = *ss; build_refs((lispobj*)FIXEDOBJ_SPACE_START, fixedobj_free_pointer, ss);
-    show_tally(old, ss);
-    old = *ss; build_refs((lispobj*)VARYOBJ_SPACE_START, varyobj_free_pointer, ss);
-    show_tally(old, ss);
-#endif
-    old = *ss;
-    walk_generation((uword_t(*)(lispobj*,lispobj*,uword_t))build_refs,
-                    -1, (uword_t)ss);
-    show_tally(old, ss);
+    struct inversion* inversion = arg;
+    struct scan_state* ss = &inversion->ss[worker];
+    struct edge* edges = inversion->graph->edges;
+    uword_t i;
+    for (i = 0; i < ss->n_edges; ++i) {
+        struct edge edge = ss->edges[i];
+        edges[ss->bucket_count[edge_bucket(edge.target)]++] = edge;
+    }
+    if (ss->edges)
+        os_deallocate((os_vm_address_t)ss->edges, ss->capacity * sizeof (struct edge));
+    ss->edges = 0;
 }
 
-#define HASH_FUNCTION HOPSCOTCH_HASH_FUN_MIX
+static int compare_edges(const void* a, const void* b)
+{
+    const struct edge *x = a, *y = b;
+    if (x->target != y->target) return x->target < y->target ? -1 : 1;
+    return (x->source > y->source) - (x->source < y->source);
+}
+static void sort_edges(int __attribute__((unused)) worker, void* arg)
+{
+    struct inversion* inversion = arg;
+    uword_t* start = inversion->graph->bucket_start;
+    page_index_t i, end;
+    while ((i = gc_claim_chunk(&inversion->cursor, 16, N_EDGE_BUCKETS, &end)) >= 0)
+        for ( ; i < end ; ++i)
+            qsort(inversion->graph->edges + start[i], start[i+1] - start[i],
+                  sizeof (struct edge), compare_edges);
+}
 
-static void* compute_heap_inverse(boolean keep_leaves,
-                                  lispobj ignored_objects,
-                                  struct scratchpad* scratchpad)
+/* Build the inverted heap in 'graph'. Dynamic space is divided among the
+ * GC helper threads, if there are any, and each one records edges in its
+ * own array. Then the arrays are merged into one, bucket by bucket,
+ * and the buckets are sorted in parallel */
+static void compute_heap_inverse(boolean keep_leaves,
+                                 lispobj ignored_objects,
+                                 struct inverted_heap* graph)
 {
-    struct scan_state ss;
-    memset(&ss, 0, sizeof ss);
-    ss.ignored_objects = ignored_objects;
-    ss.keep_leaves = keep_leaves;
-    if (heap_trace_verbose) fprintf(stderr, "Pass 1: Counting heap objects...\n");
-    scan_spaces(&ss);
-    // Guess at the initial size of ~ .5 million objects.
-    int size = 1<<19; // flsl(tot_n_objects); this would work if you have it
-    while (ss.n_objects > size) size <<= 1;
-    if (heap_trace_verbose) {
-        fprintf(stderr, "Pass 2: Inverting heap. Initial size=%d objects\n", size);
-    }
-#if TRACEROOT_USE_ABSL_HASHMAP
-    void* inverted_heap = new_absl_hashmap(size);
-    ss.inverted_heap = inverted_heap;
-#else
-    ss.inverted_heap = malloc(sizeof(struct hopscotch_table));
-    hopscotch_create(ss.inverted_heap, HASH_FUNCTION,
-                     4, // XXX: half the word size if 64-bit
-                     size /* initial size */, 0 /* default hop range */);
-#endif
-    // Add one pointer due to inability to use the first
-    // two words of the scratchpad.
-    uword_t scratchpad_min_size = (1 + ss.n_pointers) * 2 * sizeof (uint32_t);
-    int pagesize = os_reported_page_size;
-    uword_t scratchpad_size = ALIGN_UP(scratchpad_min_size, pagesize);
-    ss.scratchpad.base = os_allocate(scratchpad_size);
-    gc_assert(ss.scratchpad.base);
-    ss.scratchpad.free = ss.scratchpad.base + 2 * sizeof(uint32_t);
-    ss.scratchpad.end  = ss.scratchpad.base + scratchpad_size;
-    if (heap_trace_verbose) {
-        fprintf(stderr, "Scratchpad: %lu bytes\n", (long unsigned)scratchpad_size);
-    }
+    struct scan_state ss[GC_MAX_THREADS];
+    uword_t args[GC_MAX_THREADS];
+    int n_workers = gc_n_threads > 1 ? gc_n_threads : 1;
+    int i, bucket;
 #if HAVE_GETRUSAGE
     struct rusage before, after;
     getrusage(RUSAGE_SELF, &before);
 #endif
-    ss.record_ptrs = 1;
-    scan_spaces(&ss);
-    *scratchpad = ss.scratchpad;
+    memset(ss, 0, sizeof ss);
+    for (i = 0; i < n_workers; ++i) {
+        ss[i].ignored_objects = ignored_objects;
+        ss[i].keep_leaves = keep_leaves;
+        ss[i].bucket_count = (uword_t*)os_allocate(N_EDGE_BUCKETS * sizeof (uword_t));
+        gc_assert(ss[i].bucket_count);
+        args[i] = (uword_t)&ss[i];
+    }
+    if (heap_trace_verbose)
+        fprintf(stderr, "Inverting heap on %d thread%s\n", n_workers, n_workers > 1 ? "s" : "");
+    // The non-dynamic spaces are small. Worker 0 does them here.
+    build_refs((lispobj*)NIL_SYMBOL_SLOTS_START, (lispobj*)NIL_SYMBOL_SLOTS_END, &ss[0]);
+    build_refs((lispobj*)STATIC_SPACE_OBJECTS_START, static_space_free_pointer, &ss[0]);
+#ifdef LISP_FEATURE_IMMOBILE_SPACE
+    build_refs((lispobj*)FIXEDOBJ_SPACE_START, fixedobj_free_pointer, &ss[0]);
+    build_refs((lispobj*)VARYOBJ_SPACE_START, varyobj_free_pointer, &ss[0]);
+#endif
+    walk_generation_parallel((uword_t(*)(lispobj*,lispobj*,uword_t))build_refs,
+                             -1, args);
+
+    // Lay out the buckets end to end, and within each bucket, the
+    // edges of each worker in turn.
+    uword_t n_edges = 0;
+    long n_objects = 0;
+    for (bucket = 0; bucket < N_EDGE_BUCKETS; ++bucket) {
+        graph->bucket_start[bucket] = n_edges;
+        for (i = 0; i < n_workers; ++i) {
+            uword_t count = ss[i].bucket_count[bucket];
+            ss[i].bucket_count[bucket] = n_edges;
+            n_edges += count;
+        }
+    }
+    graph->bucket_start[N_EDGE_BUCKETS] = n_edges;
+    graph->n_edges = n_edges;
+    graph->size = ALIGN_UP((n_edges ? n_edges : 1) * sizeof (struct edge),
+                           os_reported_page_size);
+    graph->edges = (struct edge*)os_allocate(graph->size);
+    if (!graph->edges) lose("Can't allocate %lu edges for heap inverse", (unsigned long)n_edges);
+    struct inversion inversion = { graph, ss, 0 };
+    gc_run_on_thread_pool(scatter_edges, &inversion);
+    gc_run_on_thread_pool(sort_edges, &inversion);
+    for (i = 0; i < n_workers; ++i) {
+        n_objects += ss[i].n_objects;
+        os_deallocate((os_vm_address_t)ss[i].bucket_count, N_EDGE_BUCKETS * sizeof (uword_t));
+    }
 #if HAVE_GETRUSAGE
     getrusage(RUSAGE_SELF, &after);
     // We're done building the necessary structure. Show some memory stats.
     if (heap_trace_verbose) {
-        int count;
-        int capacity;
-#if TRACEROOT_USE_ABSL_HASHMAP
-        count = absl_hashmap_size(ss.inverted_heap, &capacity);
-#else
-        count = ss.inverted_heap->count;
-        capacity = 1+hopscotch_max_key_index(*ss.inverted_heap);
-#endif
 #define timediff(b,a,field) \
         ((a.field.tv_sec-b.field.tv_sec)*1000000+(a.field.tv_usec-b.field.tv_usec))
         float stime = timediff(before, after, ru_stime);
         float utime = timediff(before, after, ru_utime);
         fprintf(stderr,
-                "Inverted heap: ct=%d, cap=%d, LF=%f ET=%f+%f sys+usr=%f\n",
-                count, capacity, 100*(float)count / (capacity>0?capacity:1),
+                "Inverted heap: %ld objs, %lu edges (%lu bytes) ET=%f+%f sys+usr=%f\n",
+                n_objects, (unsigned long)n_edges,
+                (unsigned long)(n_edges * sizeof (struct edge)),
                 stime/1000000, utime/1000000, (stime+utime)/1000000);
     }
 #endif
-    return ss.inverted_heap;
-};
+}
 
 /* Return true if the user wants to find a leaf object.
  * If not, then we can omit all leaf objects from the inverted heap
@@ -936,8 +988,13 @@ static boolean finding_leaf_p(lispobj weak_pointers)
     return 0; // this is the expected (and optimal) case
 }
 
+#define HASH_FUNCTION HOPSCOTCH_HASH_FUN_MIX
+
 /* Find any shortest path from a thread or tenured object
  * to each of the specified objects.
+ * The heap is inverted just once for all of them, and paths found for
+ * earlier objects are reused by later ones (see trace1), so a large
+ * batch costs little more than one object.
  */
 static int trace_paths(void (*context_scanner)(),
                        lispobj weak_pointers, // list of inputs
@@ -947,12 +1004,13 @@ static int trace_paths(void (*context_scanner)(),
                        int criterion)
 {
     int i;
-    void* inverted_heap;
-    struct scratchpad scratchpad;
+    struct inverted_heap* inverted_heap;
     // A hashset of all objects in the reverse reachability graph so far
     struct hopscotch_table visited;  // *Without* lowtag
     // A hashset of objects in the current graph layer
     struct hopscotch_table targets;  // With lowtag
+    // A hashmap from object on a path already found to the cell naming it
+    struct hopscotch_table on_path;  // With lowtag
     int n_found = 0; // how many objects had paths to them
 
     if (heap_trace_verbose) {
@@ -961,10 +1019,11 @@ static int trace_paths(void (*context_scanner)(),
           fprintf(stderr, " %p%s", (void*)pins[i],
                   ((i%8)==7||i==n_pins-1)?"\n":"");
     }
-    inverted_heap = compute_heap_inverse(finding_leaf_p(weak_pointers),
-                                         ignore, &scratchpad);
+    inverted_heap = malloc(sizeof (struct inverted_heap));
+    compute_heap_inverse(finding_leaf_p(weak_pointers), ignore, inverted_heap);
     hopscotch_create(&visited, HASH_FUNCTION, 0, 32, 0);
     hopscotch_create(&targets, HASH_FUNCTION, 0, 32, 0);
+    hopscotch_create(&on_path, HASH_FUNCTION, N_WORD_BYTES, 32, 0);
     i = 0;
     do {
         // Oh dear, is this really supposed to be '<=' (vs '<') ?
@@ -978,25 +1037,30 @@ static int trace_paths(void (*context_scanner)(),
             hopscotch_reset(&visited);
             hopscotch_reset(&targets);
             lispobj path = trace1(canonical_obj(value),
-                                  &targets, &visited,
-                                  inverted_heap, &scratchpad,
+                                  &targets, &visited, &on_path,
+                                  inverted_heap,
                                   n_pins, pins, context_scanner, criterion);
             lispobj* elt = VECTOR(paths)->data + i;
             notice_pointer_store(elt);
             if ((*elt = path) != 0) ++n_found;
+            // Remember the cells of the new path, except for the last node,
+            // whose successor is only the root descriptor.
+            lispobj cell;
+            if (path) for (cell = path ; CONS(CONS(cell)->cdr)->cdr != NIL ;
+                           cell = CONS(cell)->cdr) {
+                lispobj object = CONS(CONS(cell)->car)->car;
+                if (!hopscotch_containsp(&on_path, object))
+                    hopscotch_insert(&on_path, object, cell);
+            }
         }
         ++i;
     } while (weak_pointers != NIL);
     gc_close_collector_regions();
-    os_invalidate(scratchpad.base, scratchpad.end-scratchpad.base);
-#if TRACEROOT_USE_ABSL_HASHMAP
-    absl_hashmap_destroy(inverted_heap);
-#else
-    hopscotch_destroy(inverted_heap);
+    os_deallocate((os_vm_address_t)inverted_heap->edges, inverted_heap->size);
     free(inverted_heap);
-#endif
     hopscotch_destroy(&visited);
     hopscotch_destroy(&targets);
+    hopscotch_destroy(&on_path);
     return n_found;
 }
 
@@ -1058,7 +1122,6 @@ int gc_prove_liveness(void(*context_scanner)(),
  */
 int prove_liveness(lispobj objects, int criterion)
 {
-    extern struct hopscotch_table pinned_objects;
     extern int gc_pin_count;
     extern lispobj* gc_filtered_pins;
     return gc_prove_liveness(0, objects, gc_pin_count, gc_filtered_pins, criterion);
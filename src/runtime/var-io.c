@@ -9,6 +9,7 @@
  * files for more information.
  */
 
+#include <string.h>
 #include "genesis/config.h"
 #include "genesis/bignum.h"
 #include "gc-assert.h"
@@ -88,9 +89,63 @@ int varint_unpack(struct varint_unpacker* unpacker, int* result)
     return 1;
 }
 
+#if defined LISP_FEATURE_LITTLE_ENDIAN && defined LISP_FEATURE_64_BIT
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+// Squeeze out the high bit of each byte of 'x',
+// concatenating the low 7 bits of the bytes.
+static inline uword_t gather7(uword_t x)
+{
+#ifdef __BMI2__
+    return _pext_u64(x, 0x7F7F7F7F7F7F7F7FULL);
+#else
+    x &= 0x7F7F7F7F7F7F7F7FULL;
+    x = (x & 0x007F007F007F007FULL) | ((x & 0x7F007F007F007F00ULL) >> 1);
+    x = (x & 0x00003FFF00003FFFULL) | ((x & 0x3FFF00003FFF0000ULL) >> 2);
+    x = (x & 0x000000000FFFFFFFULL) | ((x & 0x0FFFFFFF00000000ULL) >> 4);
+    return x;
+#endif
+}
+#endif
+
+// Fetch up to 'n' varints of a zero-terminated series from 'unpacker'
+// into 'result', and return how many were stored. The terminating 0 is
+// consumed but not stored, so a return value less than 'n' means that
+// the series ended (or the data did).
+// This is quicker than calling varint_unpack() repeatedly, as it decodes
+// a word at a time when it can.
+int varint_unpack_stream(struct varint_unpacker* unpacker, int* result, int n)
+{
+    int count = 0, val;
+#if defined LISP_FEATURE_LITTLE_ENDIAN && defined LISP_FEATURE_64_BIT
+    while (count < n && unpacker->index + N_WORD_BYTES <= unpacker->limit) {
+        uword_t word;
+        memcpy(&word, unpacker->data + unpacker->index, N_WORD_BYTES);
+        // A byte whose high bit is clear ends a varint
+        uword_t ends = ~word & 0x8080808080808080ULL;
+        if (!ends) break;
+        do {
+            int nbits = __builtin_ctzll(ends) + 1;
+            uword_t bytes = nbits == 64 ? word : word & (((uword_t)1 << nbits) - 1);
+            val = (int)gather7(bytes);
+            unpacker->index += nbits / 8;
+            if (val == 0) return count;
+            result[count++] = val;
+            if (nbits == 64) break;
+            word >>= nbits;
+            ends >>= nbits;
+        } while (ends && count < n);
+    }
+#endif
+    while (count < n && varint_unpack(unpacker, &val) && val != 0)
+        result[count++] = val;
+    return count;
+}
+
 void skip_data_stream(struct varint_unpacker* unpacker)
 {
     // Read elements until seeing a 0
-    int val;
-    while (varint_unpack(unpacker, &val) && val != 0) { }
+    int buf[VARINT_STREAM_BATCH];
+    while (varint_unpack_stream(unpacker, buf, VARINT_STREAM_BATCH) == VARINT_STREAM_BATCH) { }
 }
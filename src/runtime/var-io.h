@@ -25,6 +25,10 @@ struct varint_unpacker {
 
 void varint_unpacker_init(struct varint_unpacker*, lispobj);
 int varint_unpack(struct varint_unpacker*, int*);
+int varint_unpack_stream(struct varint_unpacker*, int*, int);
 void skip_data_stream(struct varint_unpacker* unpacker);
 
+// A reasonable buffer size for varint_unpack_stream()
+#define VARINT_STREAM_BATCH 32
+
 #endif /* _VAR_IO_H_ */
@@ -1783,12 +1783,16 @@ unlock:
     return result;
 }
 
+static void iocp_wake(struct thread *th);
+
 boolean
 win32_maybe_interrupt_io(void* thread)
 {
     struct thread *th = thread;
     boolean done = 0;
 
+    iocp_wake(th);
+
 #ifdef LISP_FEATURE_SB_FUTEX
     if (thread_extra_data(th)->waiting_on_address)
         WakeByAddressAll(thread_extra_data(th)->waiting_on_address);
@@ -1872,7 +1876,8 @@ win32_unix_write(HANDLE handle, void * buf, int count)
         return win32_write_console(handle,buf,count);
     }
 
-    overlapped.hEvent = thread_private_events(self,0);
+    /* The low bit keeps the completion off the port of sb_select() */
+    overlapped.hEvent = (HANDLE)((uintptr_t)thread_private_events(self,0) | 1);
     seekable = SetFilePointerEx(handle,
                                 zero_large_offset,
                                 &file_position,
@@ -1947,7 +1952,8 @@ win32_unix_read(HANDLE handle, void * buf, int count)
         return win32_read_console(handle, buf, count);
     }
 
-    overlapped.hEvent = thread_private_events(self,0);
+    /* The low bit keeps the completion off the port of sb_select() */
+    overlapped.hEvent = (HANDLE)((uintptr_t)thread_private_events(self,0) | 1);
     /* If it has a position, we won't try overlapped */
     seekable = SetFilePointerEx(handle,
                                 zero_large_offset,
@@ -2024,6 +2030,349 @@ win32_unix_read(HANDLE handle, void * buf, int count)
     return read_bytes;
 }
 
+/* sb_select() for SERVE-EVENT and WAIT-UNTIL-FD-USABLE.
+ *
+ * Each thread that waits gets an I/O completion port. A socket waited on
+ * for input is associated with the port of its thread, and a zero-byte
+ * overlapped receive is kept pending on it: that completes, with a packet
+ * on the port, as soon as there is something to receive or the connection
+ * fails, without consuming anything. Datagram sockets receive with
+ * MSG_PEEK so that the datagram stays. Reads and writes of win32_unix_read
+ * and win32_unix_write tag their event so that they queue no packets.
+ *
+ * Sockets that can't do that, such as listening sockets or sockets whose
+ * handle is associated with the port of another thread, and any other
+ * kind of handle, have no way to tell the port when they become ready,
+ * so they are checked every IOCP_POLL_MS while they are waited on.
+ * Output is always possible, since writes wait for their overlapped
+ * operation to complete, as before.
+ *
+ * WAKE_THREAD posts a packet that ends the wait, so that interruptions
+ * are not held up by a long timeout. */
+
+#define IOCP_WAKEUP_KEY 1
+#define IOCP_POLL_MS 10
+/* the FD-SETSIZE of the Lisp side, see grovel-headers-win32.inc */
+#define SB_SELECT_FD_SETSIZE 1024
+
+enum fd_watch_state {
+    WATCH_IDLE,         /* a socket with nothing pending */
+    WATCH_PENDING,      /* a socket with a zero-byte receive pending */
+    WATCH_READY,        /* the receive has completed */
+    WATCH_POLLED,       /* anything to be checked every IOCP_POLL_MS */
+    WATCH_ORPHAN        /* pending, but its descriptor was reused */
+};
+
+struct fd_watch {
+    OVERLAPPED overlapped;      /* first, overlapped results come back as this */
+    HANDLE handle;
+    WSABUF buffer;
+    int socketp, datagramp, associatedp;
+    enum fd_watch_state state;
+};
+
+struct win32_iocp {
+    HANDLE port;
+    int n_watches;
+    int n_pending;              /* watches whose receive hasn't completed */
+    struct fd_watch **watches;  /* by descriptor */
+};
+
+static struct win32_iocp *thread_iocp(struct thread *th)
+{
+    struct win32_iocp *iocp = thread_extra_data(th)->iocp;
+    if (iocp)
+        return iocp;
+    iocp = calloc(1, sizeof *iocp);
+    if (!iocp)
+        return 0;
+    iocp->port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (!iocp->port) {
+        free(iocp);
+        return 0;
+    }
+    /* Publish the port before checking for a wakeup (see sb_select) */
+    InterlockedExchangePointer((volatile LPVOID *)&thread_extra_data(th)->iocp, iocp);
+    return iocp;
+}
+
+static void iocp_wake(struct thread *th)
+{
+    struct win32_iocp *iocp = thread_extra_data(th)->iocp;
+    if (iocp)
+        PostQueuedCompletionStatus(iocp->port, 0, IOCP_WAKEUP_KEY, NULL);
+}
+
+/* Dequeue completions, waiting up to MS milliseconds for the first one.
+ * Return true if a wakeup was dequeued. */
+static boolean iocp_dequeue(struct win32_iocp *iocp, DWORD ms)
+{
+    boolean woken = 0;
+    for (;;) {
+        DWORD n_bytes;
+        ULONG_PTR key;
+        LPOVERLAPPED overlapped = NULL;
+        BOOL ok = GetQueuedCompletionStatus(iocp->port, &n_bytes, &key, &overlapped, ms);
+        if (!overlapped) {
+            if (!ok)            /* timed out, or there is no port any more */
+                return woken;
+            if (key == IOCP_WAKEUP_KEY)
+                woken = 1;
+        } else {
+            struct fd_watch *watch = (struct fd_watch *)overlapped;
+            --iocp->n_pending;
+            if (watch->state == WATCH_ORPHAN)
+                free(watch);
+            else if (!ok && GetLastError() == ERROR_OPERATION_ABORTED)
+                watch->state = WATCH_IDLE;
+            else
+                /* success, or an error for the reader to see */
+                watch->state = WATCH_READY;
+        }
+        ms = 0;
+    }
+}
+
+static boolean socket_input_ready(SOCKET socket)
+{
+    fd_set readable, failed;
+    struct timeval zero = {0, 0};
+    FD_ZERO(&readable);
+    FD_ZERO(&failed);
+    FD_SET(socket, &readable);
+    FD_SET(socket, &failed);
+    /* If select() itself fails, the reader will see why */
+    return select(0, &readable, NULL, &failed, &zero) != 0;
+}
+
+/* The same tests as SB-WIN32:HANDLE-LISTEN */
+static boolean handle_input_ready(HANDLE handle)
+{
+    DWORD avail;
+    if (console_handle_p(handle))
+        return win32_tty_listen(handle);
+    switch (GetFileType(handle)) {
+    case FILE_TYPE_DISK:
+        return 1;
+    case FILE_TYPE_PIPE:
+        if (PeekNamedPipe(handle, NULL, 0, NULL, &avail, NULL))
+            return avail > 0;
+        if (GetLastError() == ERROR_BROKEN_PIPE)
+            return 1;
+        /* sockets are pipes too */
+        return socket_input_ready((SOCKET)handle);
+    default:
+        return WaitForSingleObject(handle, 0) == WAIT_OBJECT_0;
+    }
+}
+
+static struct fd_watch *fd_watch(struct win32_iocp *iocp, int fd, HANDLE handle)
+{
+    struct fd_watch *watch;
+    int type;
+    int length = sizeof type;
+
+    if (fd >= iocp->n_watches) {
+        int n = iocp->n_watches ? iocp->n_watches : 64;
+        while (n <= fd) n *= 2;
+        struct fd_watch **watches = realloc(iocp->watches, n * sizeof *watches);
+        if (!watches)
+            return 0;
+        memset(watches + iocp->n_watches, 0, (n - iocp->n_watches) * sizeof *watches);
+        iocp->watches = watches;
+        iocp->n_watches = n;
+    }
+    watch = iocp->watches[fd];
+    if (watch && watch->handle == handle)
+        return watch;
+    if (watch) {
+        /* The descriptor was closed and reused. The receive of the old
+         * one may yet complete, and needs its OVERLAPPED till then. */
+        if (watch->state == WATCH_PENDING)
+            watch->state = WATCH_ORPHAN;
+        else
+            free(watch);
+        iocp->watches[fd] = 0;
+    }
+    watch = calloc(1, sizeof *watch);
+    if (!watch)
+        return 0;
+    watch->handle = handle;
+    if (!getsockopt((SOCKET)handle, SOL_SOCKET, SO_TYPE, (char *)&type, &length)) {
+        watch->socketp = 1;
+        watch->datagramp = (type == SOCK_DGRAM);
+        watch->state = WATCH_IDLE;
+    } else {
+        watch->state = WATCH_POLLED;
+    }
+    iocp->watches[fd] = watch;
+    return watch;
+}
+
+enum { FD_WAITING, FD_READY, FD_POLLED };
+
+/* Say whether FD has input, arranging to hear about it if not */
+static int fd_input_state(struct win32_iocp *iocp, int fd, HANDLE handle)
+{
+    struct fd_watch *watch = iocp ? fd_watch(iocp, fd, handle) : 0;
+
+    if (!watch || !watch->socketp)
+        return handle_input_ready(handle) ? FD_READY : FD_POLLED;
+    SOCKET socket = (SOCKET)handle;
+    switch (watch->state) {
+    case WATCH_PENDING:
+        return FD_WAITING;
+    case WATCH_POLLED:
+        return socket_input_ready(socket) ? FD_READY : FD_POLLED;
+    case WATCH_READY:
+        /* The input may have been read by other means since the receive
+         * completed, so make sure, and start over if it has. */
+        watch->state = WATCH_IDLE;
+        if (socket_input_ready(socket))
+            return FD_READY;
+        break;
+    default:
+        break;
+    }
+    if (!watch->associatedp) {
+        if (!CreateIoCompletionPort(handle, iocp->port, 0, 0)) {
+            /* Associated with the port of another thread */
+            watch->state = WATCH_POLLED;
+            return socket_input_ready(socket) ? FD_READY : FD_POLLED;
+        }
+        watch->associatedp = 1;
+    }
+    DWORD flags = watch->datagramp ? MSG_PEEK : 0;
+    memset(&watch->overlapped, 0, sizeof watch->overlapped);
+    if (!WSARecv(socket, &watch->buffer, 1, NULL, &flags, &watch->overlapped, NULL)
+        || WSAGetLastError() == WSA_IO_PENDING) {
+        /* A receive that completed at once still queues its packet */
+        watch->state = WATCH_PENDING;
+        ++iocp->n_pending;
+        return FD_WAITING;
+    }
+    switch (WSAGetLastError()) {
+    case WSAENOTCONN:           /* listening, or still connecting */
+    case WSAEINVAL:
+        watch->state = WATCH_POLLED;
+        return socket_input_ready(socket) ? FD_READY : FD_POLLED;
+    default:                    /* the reader will see the error */
+        return FD_READY;
+    }
+}
+
+int sb_select(int top_fd, DWORD *read_set, DWORD *write_set, DWORD *except_set,
+              struct timeval *timeout)
+{
+    struct thread *self = get_sb_vm_thread();
+    struct win32_iocp *iocp = thread_iocp(self);
+    DWORD wanted[SB_SELECT_FD_SETSIZE / 32];
+    DWORD start = GetTickCount();
+    DWORD total = INFINITE;
+    int n_output = 0;
+    int i;
+
+    if (top_fd > SB_SELECT_FD_SETSIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (timeout)
+        total = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+    for (i = 0; i < top_fd; i += 32) {
+        wanted[i >> 5] = read_set ? read_set[i >> 5] : 0;
+        if (except_set) except_set[i >> 5] = 0;
+    }
+    /* Every descriptor is ready for output */
+    if (write_set)
+        for (i = 0; i < top_fd; i++)
+            if (write_set[i >> 5] & (1u << (i & 31)))
+                n_output++;
+
+    for (;;) {
+        int n_ready = n_output, n_polled = 0;
+        for (i = 0; i < top_fd; i++) {
+            if (!(wanted[i >> 5] & (1u << (i & 31))))
+                continue;
+            HANDLE handle = (HANDLE)_get_osfhandle(i);
+            if (handle == INVALID_HANDLE_VALUE) {
+                errno = EBADF;
+                return -1;
+            }
+            switch (fd_input_state(iocp, i, handle)) {
+            case FD_READY:
+                read_set[i >> 5] |= (1u << (i & 31));
+                n_ready++;
+                continue;
+            case FD_POLLED:
+                n_polled++;
+                break;
+            }
+            read_set[i >> 5] &= ~(1u << (i & 31));
+        }
+        if (n_ready)
+            return n_ready;
+
+        DWORD elapsed = GetTickCount() - start;
+        DWORD remaining = total == INFINITE ? INFINITE
+            : elapsed >= total ? 0 : total - elapsed;
+        if (!remaining)
+            return 0;
+        if (n_polled || !iocp)
+            remaining = remaining < IOCP_POLL_MS ? remaining : IOCP_POLL_MS;
+#ifdef LISP_FEATURE_SB_THREAD
+        /* WAKE_THREAD sets the event before looking for the port, so
+         * either it posts to the port or the event is set here. */
+        if (WaitForSingleObject(thread_private_events(self,1), 0) == WAIT_OBJECT_0) {
+            errno = EINTR;
+            return -1;
+        }
+#endif
+        if (!iocp)
+            Sleep(remaining);
+        else if (iocp_dequeue(iocp, remaining)) {
+#ifdef LISP_FEATURE_SB_THREAD
+            WaitForSingleObject(thread_private_events(self,1), 0);
+#endif
+            errno = EINTR;
+            return -1;
+        }
+    }
+}
+
+void win32_iocp_destroy(void *thread)
+{
+    struct thread *th = thread;
+    struct win32_iocp *iocp = thread_extra_data(th)->iocp;
+    int i;
+
+    if (!iocp)
+        return;
+    thread_extra_data(th)->iocp = 0;
+    for (i = 0; i < iocp->n_watches; i++) {
+        struct fd_watch *watch = iocp->watches[i];
+        if (watch && watch->state == WATCH_PENDING) {
+            CancelIo(watch->handle);
+            /* An orphan now, to be freed when its receive completes */
+            watch->state = WATCH_ORPHAN;
+        } else {
+            free(watch);
+        }
+    }
+    while (iocp->n_pending) {
+        int n_pending = iocp->n_pending;
+        iocp_dequeue(iocp, 1000);
+        /* Better to leak the last few than to free what the kernel
+         * may yet write to */
+        if (iocp->n_pending == n_pending)
+            break;
+    }
+    if (!iocp->n_pending) {
+        CloseHandle(iocp->port);
+        free(iocp->watches);
+        free(iocp);
+    }
+}
+
 /* We used to have a scratch() function listing all symbols needed by
  * Lisp.  Much rejoicing commenced upon its removal.  However, I would
  * like cold init to fail aggressively when encountering unused symbols.
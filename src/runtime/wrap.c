@@ -23,6 +23,11 @@
  * files for more information.
  */
 
+#ifdef __linux__
+/* glibc won't give us splice() without this */
+#define _GNU_SOURCE
+#endif
+
 #include "sbcl.h"
 
 #include <sys/types.h>
@@ -36,6 +41,7 @@
 #include <limits.h>
 #include <fcntl.h>
 #include <math.h>
+#include <stdint.h>
 
 #ifndef LISP_FEATURE_WIN32
 #include <pwd.h>
@@ -172,6 +178,53 @@ sb_dirent_name(struct dirent * ent)
 {
     return ent->d_name;
 }
+
+#ifndef NAME_MAX
+#define NAME_MAX 255
+#endif
+
+/* Copy as many entries of DIRP as fit into BUF of SIZE octets, skipping
+ * "." and "..", to save an alien call for each. Each entry is an octet
+ * for its kind, 0 if unknown, 1 for a regular file, 2 for a directory,
+ * 3 for a symlink and 4 for anything else, then its name and a NUL.
+ * Returns the number of octets used, 0 at the end of the directory, or
+ * -1 with errno set on error. SIZE should be at least NAME_MAX + 2, and
+ * no entry is read that might not fit. */
+extern int
+sb_readdir_batch(DIR * dirp, char * buf, int size)
+{
+    int used = 0;
+    while (size - used >= NAME_MAX + 2) {
+        errno = 0;
+        struct dirent *ent = readdir(dirp);
+        if (!ent) {
+            if (errno) return -1;
+            break;
+        }
+        char *name = ent->d_name;
+        if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+            continue;
+        int length = strlen(name);
+        if (length > NAME_MAX) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        char kind = 0;
+#ifdef DT_UNKNOWN
+        switch (ent->d_type) {
+        case DT_UNKNOWN: kind = 0; break;
+        case DT_REG: kind = 1; break;
+        case DT_DIR: kind = 2; break;
+        case DT_LNK: kind = 3; break;
+        default: kind = 4;
+        }
+#endif
+        buf[used] = kind;
+        memcpy(buf + used + 1, name, length + 1);
+        used += length + 2;
+    }
+    return used;
+}
 
 /*
  * stat(2) stuff
@@ -261,6 +314,71 @@ fstat_wrapper(int filedes, struct stat_wrapper *buf)
     return ret;
 }
 
+#ifndef LISP_FEATURE_WIN32
+/* The same, but into a vector of STAT_WORDS 64-bit words from Lisp,
+ * with the nanoseconds of the times, so that nothing needs to be
+ * allocated to return the fields. The order is that of the
+ * STAT-WORD- constants in unix.lisp. */
+#define STAT_WORDS 16
+
+#ifdef LISP_FEATURE_DARWIN
+#define STAT_NSEC(from, stem) (from)->st_##stem##timespec.tv_nsec
+#else
+#define STAT_NSEC(from, stem) (from)->st_##stem##tim.tv_nsec
+#endif
+
+static void
+copy_to_stat_words(uint64_t *to, struct stat *from)
+{
+    to[0] = from->st_dev;
+    to[1] = from->st_ino;
+    to[2] = from->st_mode;
+    to[3] = from->st_nlink;
+    to[4] = from->st_uid;
+    to[5] = from->st_gid;
+    to[6] = from->st_rdev;
+    to[7] = from->st_size;
+    to[8] = from->st_blksize;
+    to[9] = from->st_blocks;
+    to[10] = from->st_atime;
+    to[11] = STAT_NSEC(from, a);
+    to[12] = from->st_mtime;
+    to[13] = STAT_NSEC(from, m);
+    to[14] = from->st_ctime;
+    to[15] = STAT_NSEC(from, c);
+}
+
+int
+stat_words(const char *file_name, uint64_t *buf)
+{
+    struct stat real_buf;
+    int ret;
+    if ((ret = stat(file_name, &real_buf)) >= 0)
+        copy_to_stat_words(buf, &real_buf);
+    return ret;
+}
+
+int
+lstat_words(const char *file_name, uint64_t *buf)
+{
+    struct stat real_buf;
+    int ret;
+    if ((ret = lstat(file_name, &real_buf)) >= 0)
+        copy_to_stat_words(buf, &real_buf);
+    return ret;
+}
+
+int
+fstat_words(int filedes, uint64_t *buf)
+{
+    struct stat real_buf;
+    int ret;
+    if ((ret = fstat(filedes, &real_buf)) >= 0)
+        copy_to_stat_words(buf, &real_buf);
+    return ret;
+}
+#endif
+
 /* A wrapper for mkstemp(3), for two reasons: (1) mkstemp does not
    exist on Windows; (2) by passing down a mode_t, we don't need a
    binding to chmod in SB-UNIX, and need not concern ourselves with
@@ -396,55 +514,7 @@ wrapped_environ()
     return environ;
 }
 
-#ifdef LISP_FEATURE_WIN32
-#include <windows.h>
-#include <time.h>
-/*
- * faked-up implementation of select(). Right now just enough to get through
- * second genesis.
- */
-int sb_select(int top_fd, DWORD *read_set, DWORD *write_set, DWORD *except_set, time_t *timeout)
-{
-    /*
-     * FIXME: Going forward, we may want to use MsgWaitForMultipleObjects
-     * in order to support a windows message loop inside serve-event.
-     */
-    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
-    int fds[MAXIMUM_WAIT_OBJECTS];
-    int num_handles;
-    int i;
-    DWORD retval;
-    int polling_write;
-    DWORD win_timeout;
-
-    num_handles = 0;
-    polling_write = 0;
-    for (i = 0; i < top_fd; i++) {
-        if (except_set) except_set[i >> 5] = 0;
-        if (write_set && (write_set[i >> 5] & (1 << (i & 31)))) polling_write = 1;
-        if (read_set[i >> 5] & (1 << (i & 31))) {
-            read_set[i >> 5] &= ~(1 << (i & 31));
-            fds[num_handles] = i;
-            handles[num_handles++] = (HANDLE) _get_osfhandle(i);
-        }
-    }
-
-    win_timeout = INFINITE;
-    if (timeout) win_timeout = (timeout[0] * 1000) + timeout[1];
-
-    /* Last parameter here is timeout in milliseconds. */
-    /* retval = WaitForMultipleObjects(num_handles, handles, 0, INFINITE); */
-    retval = WaitForMultipleObjects(num_handles, handles, 0, win_timeout);
-
-    if (retval < WAIT_ABANDONED) {
-        /* retval, at this point, is the index of the single live HANDLE/fd. */
-        read_set[fds[retval] >> 5] |= (1 << (fds[retval] & 31));
-        return 1;
-    }
-    return polling_write;
-}
-#endif
-
+/* sb_select() for win32 is in win32-os.c */
 
 /* We will need to define these things or their equivalents for Win32
    eventually, but for now let's get it working for everyone else. */
@@ -630,6 +700,104 @@ int sb_sigprocmask(int how, const sigset_t *set, sigset_t *oldset)
 #endif
 #endif
 
+#ifdef LISP_FEATURE_LINUX
+/* epoll for SERVE-EVENT. The layout of 'struct epoll_event' differs among
+ * architectures (it's packed on x86-64), so Lisp goes through these.
+ * Events are expressed as bit 0 = input, bit 1 = output. */
+#include <sys/epoll.h>
+
+int sb_epoll_create()
+{
+    return epoll_create1(EPOLL_CLOEXEC);
+}
+
+/* Make 'events' the set of events reported for 'fd', adding 'fd' to,
+ * or removing it from, the interest list as needed. Return 0 on success,
+ * or 1 if 'fd' denotes a file that epoll can't wait on (regular files and
+ * directories, which poll() considers always ready) */
+int sb_epoll_set(int epfd, int fd, int events)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof event);
+    if (!events)
+        return epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &event);
+    event.events = ((events & 1) ? EPOLLIN : 0) | ((events & 2) ? EPOLLOUT : 0);
+    event.data.fd = fd;
+    // The kernel forgets a descriptor once its file is closed,
+    // so a descriptor that Lisp believes is registered may not be.
+    int result = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &event);
+    if (result < 0 && errno == ENOENT)
+        result = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event);
+    if (result < 0 && errno == EPERM)
+        return 1;
+    return result;
+}
+
+/* Wait as epoll_wait() does, storing the descriptor and events of each
+ * ready file into 'fds' and 'events'. As with poll(), an error or hangup
+ * makes an input wait ready, and an error makes an output wait ready. */
+int sb_epoll_wait(int epfd, int* fds, int* events, int maxevents, int timeout)
+{
+    struct epoll_event buf[256];
+    if (maxevents > 256) maxevents = 256;
+    int n = epoll_wait(epfd, buf, maxevents, timeout), i;
+    for (i = 0; i < n; ++i) {
+        uint32_t e = buf[i].events;
+        fds[i] = buf[i].data.fd;
+        events[i] = ((e & (EPOLLIN|EPOLLHUP|EPOLLERR)) ? 1 : 0)
+                  | ((e & (EPOLLOUT|EPOLLERR)) ? 2 : 0);
+    }
+    return n;
+}
+
+/* Have the kernel move up to 'len' bytes from 'in' to 'out' for
+ * SB-SYS:COPY-STREAM, without copying them through user space:
+ * 'how' is 0 for copy_file_range(), 1 for sendfile(), 2 for splice().
+ * Return -2 if that can't be used with these descriptors, which is
+ * discovered by trying. Otherwise return as the system call does. */
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+int sb_copy_fd_range(int in, int out, int len, int how)
+{
+    ssize_t n = -1;
+    switch (how) {
+    case 0:
+#ifdef __NR_copy_file_range
+        n = syscall(__NR_copy_file_range, in, NULL, out, NULL, (size_t)len, 0);
+#else
+        errno = ENOSYS;
+#endif
+        break;
+    case 1:
+        n = sendfile(out, in, NULL, len);
+        break;
+    case 2:
+        n = splice(in, NULL, out, NULL, len, SPLICE_F_MOVE);
+        break;
+    default:
+        errno = ENOSYS;
+    }
+    if (n < 0 && (errno == ENOSYS || errno == EINVAL || errno == EXDEV
+                  || errno == EOPNOTSUPP
+                  // copy_file_range() says this for O_APPEND output
+                  || (how == 0 && errno == EBADF)))
+        return -2;
+    return n;
+}
+#endif
+
+/* The number of processors that can run threads, for dividing up work
+ * in Lisp (see PARALLEL-SORT-VECTOR) */
+int sb_online_processor_count()
+{
+#ifdef HAVE_os_number_of_processors
+    return os_number_of_processors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+#endif
+}
+
 #ifdef LISP_FEATURE_WIN32
 
 // These are used in src/code/irrat.lisp. Search for DEF-MATH-RTN
@@ -12,6 +12,8 @@
 #define _GNU_SOURCE /* for REG_RAX etc. from sys/ucontext */
 
 #include <stdio.h>
+#include <string.h>
+#include <immintrin.h>
 
 #include "sbcl.h"
 #include "runtime.h"
@@ -44,6 +46,13 @@
 
 int avx_supported = 0, avx2_supported = 0;
 
+/* Copies and fills of at least this many bytes bypass the cache with
+ * non-temporal stores, because the destination could not stay in the
+ * cache anyway, and would evict everything else on its way. */
+static uword_t nontemporal_store_threshold = 4*1024*1024;
+static int fill_with_rep_stos = 0;
+static int count_with_popcnt = 0;
+
 static void cpuid(unsigned info, unsigned subinfo,
                   unsigned *eax, unsigned *ebx, unsigned *ecx, unsigned *edx)
 {
@@ -71,74 +80,280 @@ static void xgetbv(unsigned *eax, unsigned *edx)
             : "c" (0));
 }
 
-#define VECTOR_FILL_T "VECTOR-FILL/T"
+/* CPU features, as bits of *CPU-FEATURE-BITS*. Keep these in sync with
+ * the CPU-HAS-... constants in compiler/x86-64/parms.lisp */
+#define CPU_HAS_AVX2   (1<<0)
+#define CPU_HAS_POPCNT (1<<1)
+#define CPU_HAS_BMI2   (1<<2)
+#define CPU_HAS_ERMS   (1<<3)
+#define CPU_HAS_FSRM   (1<<4)
+#define CPU_HAS_AVX512 (1<<5)
+#define CPU_HAS_AVX    (1<<6)
+#define CPU_HAS_SSE42  (1<<7)
+
+/* Assembly routines that come in several variants. Callers go through
+ * the slot of ENTRY in the indirect call table of the assembly routines,
+ * into which we store the first ROUTINE listed for ENTRY whose FEATURES
+ * the CPU has. The variants of an entry are listed together, from the
+ * most to the least demanding. The last one needs no features, and is
+ * what gets saved in a core, so that the core runs on any x86-64.
+ * A routine that has to be reached through its entry must not be
+ * called directly by name, see SAVE-XMM in assembly/x86-64/tramps. */
+static struct asm_routine_variant {
+    char *entry, *routine;
+    int features;
+} asm_routine_variants[] = {
+    {"FPR-SAVE", "SAVE-YMM", CPU_HAS_AVX},
+    {"FPR-SAVE", "SAVE-XMM", 0},
+    {"FPR-RESTORE", "RESTORE-YMM", CPU_HAS_AVX},
+    {"FPR-RESTORE", "RESTORE-XMM", 0},
+};
 
-void set_alloc_tramp_vectors(int ymm_enable)
+static void select_asm_routine_variants(int features)
 {
     struct code* code = (struct code*)asm_routines_start;
     lispobj* instructions = (lispobj*)code + code_header_words(code);
+    char *selected = 0;
+    unsigned int i;
     int index;
-    get_asm_routine_by_name("FPR-SAVE", &index);
-    if (index)
-        instructions[index] =
-            (lispobj)get_asm_routine_by_name(ymm_enable ? "SAVE-YMM" : "SAVE-XMM", 0);
-    get_asm_routine_by_name("FPR-RESTORE", &index);
-    if (index)
-        instructions[index] =
-            (lispobj)get_asm_routine_by_name(ymm_enable ? "RESTORE-YMM" : "RESTORE-XMM", 0);
-}
-
-// Poke in a byte that changes an opcode to enable faster vector fill.
-// Using fixed offsets and bytes is no worse than what we do elsewhere.
-void tune_asm_routines_for_microarch(void)
+    for (i = 0; i < sizeof asm_routine_variants / sizeof asm_routine_variants[0]; i++) {
+        struct asm_routine_variant *v = &asm_routine_variants[i];
+        if ((selected && !strcmp(selected, v->entry))
+            || (v->features & features) != v->features)
+            continue;
+        selected = v->entry;
+        get_asm_routine_by_name(v->entry, &index);
+        if (index)
+            instructions[index] = (lispobj)get_asm_routine_by_name(v->routine, 0);
+    }
+}
+
+static int detect_cpu_features(void)
 {
-    unsigned int eax, ebx, ecx, edx;
-    unsigned int cpuid_fn1_ecx = 0;
+    unsigned int eax, ebx, ecx, edx, max_fn;
+    int features = 0, xcr0 = 0;
 
-    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
-    if (eax >= 1) { // see if we can execute basic id function 1
+    cpuid(0, 0, &max_fn, &ebx, &ecx, &edx);
+    if (max_fn >= 1) { // see if we can execute basic id function 1
         unsigned avx_mask = 0x18000000; // OXSAVE and AVX
         cpuid(1, 0, &eax, &ebx, &ecx, &edx);
-        cpuid_fn1_ecx = ecx;
+        if (ecx & (1<<23)) features |= CPU_HAS_POPCNT;
+        if (ecx & (1<<20)) features |= CPU_HAS_SSE42;
         if ((ecx & avx_mask) == avx_mask) {
             xgetbv(&eax, &edx);
-            if ((eax & 0x06) == 0x06) { // YMM and XMM
-                avx_supported = 1;
-                cpuid(7, 0, &eax, &ebx, &ecx, &edx);
-                if  (ebx & 0x20)  {
-                    avx2_supported = 1;
-                }
-            }
+            xcr0 = eax;
+            if ((xcr0 & 0x06) == 0x06) // YMM and XMM
+                features |= CPU_HAS_AVX;
         }
     }
-    set_alloc_tramp_vectors(avx_supported);
-    int our_cpu_feature_bits = 0;
-    // avx2_supported gets copied into bit 1 of *CPU-FEATURE-BITS*
-    if (avx2_supported) our_cpu_feature_bits |= 1;
-    // POPCNT = ECX bit 23, which gets copied into bit 2 in *CPU-FEATURE-BITS*
-    if (cpuid_fn1_ecx & (1<<23)) our_cpu_feature_bits |= 2;
-    SetSymbolValue(CPU_FEATURE_BITS, make_fixnum(our_cpu_feature_bits), 0);
-
     // I don't know if this works on Windows
 #ifndef _MSC_VER
-    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
-    if (eax >= 7) {
+    if (max_fn >= 7) {
         cpuid(7, 0, &eax, &ebx, &ecx, &edx);
-        if (ebx & (1<<9)) // Enhanced Repeat Movs/Stos
-          asm_routine_poke(VECTOR_FILL_T, 0x12, 0x7C); // Change JMP to JL
+        if ((features & CPU_HAS_AVX) && (ebx & (1<<5))) features |= CPU_HAS_AVX2;
+        // AVX-512F, usable if the OS saves the opmask and ZMM registers
+        if ((features & CPU_HAS_AVX) && (ebx & (1<<16)) && (xcr0 & 0xE0) == 0xE0)
+            features |= CPU_HAS_AVX512;
+        if (ebx & (1<<8)) features |= CPU_HAS_BMI2;
+        if (ebx & (1<<9)) features |= CPU_HAS_ERMS; // Enhanced Repeat Movs/Stos
+        if (edx & (1<<4)) features |= CPU_HAS_FSRM; // Fast Short Rep Movs
     }
 #endif
+    return features;
+}
+
+/* Return the size in bytes of the last level of cache, or 0 if we can't
+ * tell. Leaf 4 describes the caches on Intel, and leaf 0x8000001D in the
+ * same format on AMD. */
+static uword_t last_level_cache_size(void)
+{
+    unsigned int eax, ebx, ecx, edx, max_fn, leaf = 4, i;
+    uword_t size = 0;
+
+    cpuid(0, 0, &max_fn, &ebx, &ecx, &edx);
+    if (ebx == 0x68747541) { // "Auth"enticAMD
+        cpuid(0x80000000, 0, &max_fn, &ebx, &ecx, &edx);
+        leaf = 0x8000001D;
+    }
+    if (max_fn < leaf) return 0;
+    for (i = 0; i < 16; i++) {
+        cpuid(leaf, i, &eax, &ebx, &ecx, &edx);
+        if ((eax & 0x1f) == 0) break; // no more caches
+        if ((eax & 0x1f) != 2) // not an instruction cache
+            size = (uword_t)(((ebx >> 22) & 0x3ff) + 1) // ways
+                * (((ebx >> 12) & 0x3ff) + 1)           // partitions
+                * ((ebx & 0xfff) + 1)                   // line size
+                * ((uword_t)ecx + 1);                   // sets
+    }
+    return size;
+}
+
+/* Like memmove(), but with non-temporal stores when N is large enough and
+ * the source and destination don't overlap. For copies between unboxed
+ * vectors, such as by REPLACE and SUBSEQ. */
+void bulk_copy(char *dst, char *src, uword_t n)
+{
+    if (n < nontemporal_store_threshold || (dst < src + n && src < dst + n)) {
+        memmove(dst, src, n);
+        return;
+    }
+    // Align the stores. The loads may remain unaligned.
+    uword_t head = -(uword_t)dst & 15;
+    memcpy(dst, src, head);
+    dst += head; src += head; n -= head;
+    for ( ; n >= 64 ; n -= 64, dst += 64, src += 64) {
+        __m128i a = _mm_loadu_si128((__m128i*)src),
+            b = _mm_loadu_si128((__m128i*)(src + 16)),
+            c = _mm_loadu_si128((__m128i*)(src + 32)),
+            d = _mm_loadu_si128((__m128i*)(src + 48));
+        _mm_stream_si128((__m128i*)dst, a);
+        _mm_stream_si128((__m128i*)(dst + 16), b);
+        _mm_stream_si128((__m128i*)(dst + 32), c);
+        _mm_stream_si128((__m128i*)(dst + 48), d);
+    }
+    // Non-temporal stores are weakly ordered
+    _mm_sfence();
+    memcpy(dst, src, n);
+}
+
+/* Store NWORDS copies of VALUE from DST, which is word-aligned. For FILL
+ * of unboxed vectors. */
+void bulk_fill_words(uword_t *dst, uword_t value, uword_t nwords)
+{
+    if (nwords * N_WORD_BYTES >= nontemporal_store_threshold) {
+        for ( ; nwords ; --nwords)
+            _mm_stream_si64((long long*)dst++, value);
+        _mm_sfence();
+    } else if (fill_with_rep_stos) {
+        __asm__ volatile ("rep stosq"
+                          : "+D" (dst), "+c" (nwords)
+                          : "a" (value)
+                          : "memory");
+    } else {
+        for ( ; nwords ; --nwords)
+            *dst++ = value;
+    }
+}
+
+/* The operations of BIT-AND and its kin on whole words, in the order of
+ * BIT-VECTOR-OP-CODE in Lisp. DST may be the same as A or B. Inlined into
+ * a copy for AVX2, where the compiler vectorizes the loops with 256-bit
+ * registers, and into one for the SSE2 that every x86-64 has. */
+static inline __attribute__((always_inline))
+void bit_vector_op_loops(int op, uword_t *dst, uword_t *a, uword_t *b, uword_t nwords)
+{
+    uword_t i;
+#define BIT_VECTOR_OP_LOOP(expr) for (i = 0 ; i < nwords ; ++i) dst[i] = (expr); break
+    switch (op) {
+    case 0: BIT_VECTOR_OP_LOOP(a[i] & b[i]);
+    case 1: BIT_VECTOR_OP_LOOP(a[i] | b[i]);
+    case 2: BIT_VECTOR_OP_LOOP(a[i] ^ b[i]);
+    case 3: BIT_VECTOR_OP_LOOP(~(a[i] ^ b[i]));
+    case 4: BIT_VECTOR_OP_LOOP(~(a[i] & b[i]));
+    case 5: BIT_VECTOR_OP_LOOP(~(a[i] | b[i]));
+    case 6: BIT_VECTOR_OP_LOOP(~a[i] & b[i]);
+    case 7: BIT_VECTOR_OP_LOOP(a[i] & ~b[i]);
+    case 8: BIT_VECTOR_OP_LOOP(~a[i] | b[i]);
+    case 9: BIT_VECTOR_OP_LOOP(a[i] | ~b[i]);
+    }
+#undef BIT_VECTOR_OP_LOOP
+}
+
+__attribute__((target("avx2")))
+static void bit_vector_op_avx2(int op, uword_t *dst, uword_t *a, uword_t *b, uword_t nwords)
+{
+    bit_vector_op_loops(op, dst, a, b, nwords);
+}
+
+void bit_vector_op(int op, uword_t *dst, uword_t *a, uword_t *b, uword_t nwords)
+{
+    if (avx2_supported)
+        bit_vector_op_avx2(op, dst, a, b, nwords);
+    else
+        bit_vector_op_loops(op, dst, a, b, nwords);
+}
+
+/* The number of bits set in NWORDS words from WORDS, with PSHUFB looking up
+ * the count of each nibble, 32 octets at a time, after Mula. Counts per octet
+ * add up in octets for 31 rounds at most, then in words by PSADBW. */
+__attribute__((target("avx2,popcnt")))
+static uword_t bit_vector_count_avx2(uword_t *words, uword_t nwords)
+{
+    const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                            0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f), zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    uword_t i = 0;
+    while (nwords - i >= 4) {
+        __m256i octets = zero;
+        int round;
+        for (round = 0 ; round < 31 && nwords - i >= 4 ; ++round, i += 4) {
+            __m256i v = _mm256_loadu_si256((__m256i*)(words + i));
+            __m256i lo = _mm256_and_si256(v, nibble),
+                hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+            octets = _mm256_add_epi8(octets,
+                                     _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                                     _mm256_shuffle_epi8(lookup, hi)));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(octets, zero));
+    }
+    uword_t count = _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1)
+        + _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+    for ( ; i < nwords ; ++i)
+        count += __builtin_popcountll(words[i]);
+    return count;
+}
+
+__attribute__((target("popcnt")))
+static uword_t bit_vector_count_popcnt(uword_t *words, uword_t nwords)
+{
+    uword_t count = 0, i;
+    for (i = 0 ; i < nwords ; ++i)
+        count += __builtin_popcountll(words[i]);
+    return count;
+}
+
+/* For COUNT of bits, on the interior words of a bit vector */
+uword_t bit_vector_count(uword_t *words, uword_t nwords)
+{
+    if (avx2_supported && count_with_popcnt)
+        return bit_vector_count_avx2(words, nwords);
+    if (count_with_popcnt)
+        return bit_vector_count_popcnt(words, nwords);
+    uword_t count = 0, i;
+    for (i = 0 ; i < nwords ; ++i)
+        count += __builtin_popcountll(words[i]);
+    return count;
+}
+
+/* Make assembly routines use what this CPU has, by selecting among
+ * the variants of routines above, and by publishing the features in
+ * *CPU-FEATURE-BITS* for routines that test them as they run, like
+ * VECTOR-FILL/T and LOGCOUNT, and pick how BULK_COPY and BULK_FILL_WORDS
+ * store and how BIT_VECTOR_COUNT counts. */
+void tune_asm_routines_for_microarch(void)
+{
+    int features = detect_cpu_features();
+
+    avx_supported = (features & CPU_HAS_AVX) != 0;
+    avx2_supported = (features & CPU_HAS_AVX2) != 0;
+    fill_with_rep_stos = (features & CPU_HAS_ERMS) != 0;
+    count_with_popcnt = (features & CPU_HAS_POPCNT) != 0;
+    uword_t cache_size = last_level_cache_size();
+    // Half of the cache leaves room for what the source is evicting
+    nontemporal_store_threshold = cache_size ? cache_size / 2 : 4*1024*1024;
+    select_asm_routine_variants(features);
+    SetSymbolValue(CPU_FEATURE_BITS, make_fixnum(features), 0);
 }
 
-/* Undo code patches so that the core file applies to the most generic
-   microarchitecture on startup. As it happens, FILL-VECTOR/T is fine
-   either way, but in general this might not be true for code using
-   instructions that don't exist on some cpu family members */
+/* Undo the tuning so that the core file applies to the most generic
+   microarchitecture on startup. */
 void untune_asm_routines_for_microarch(void)
 {
-    asm_routine_poke(VECTOR_FILL_T, 0x12, 0xEB); // Change JL to JMP
     SetSymbolValue(CPU_FEATURE_BITS, 0, 0);
-    set_alloc_tramp_vectors(0);
+    fill_with_rep_stos = 0;
+    count_with_popcnt = 0;
+    select_asm_routine_variants(0);
 }
 
 #ifndef _WIN64
@@ -555,3 +555,16 @@
 
 (with-test (:name :no-vector-sap-of-array-nil)
   (assert-error (sb-sys:vector-sap (opaque-identity (make-array 5 :element-type nil)))))
+
+(define-alien-routine ("strlen" leaf-strlen) (:leaf unsigned-long) (s c-string))
+
+(with-test (:name (alien-funcall :leaf))
+  (assert (equal (second (sb-alien::unparse-alien-type
+                          (sb-alien::parse-alien-type '(function (:leaf int) double) nil)))
+                 '(:leaf int)))
+  (assert (= (leaf-strlen "hello") 5))
+  (let ((f (checked-compile
+            '(lambda (x)
+               (alien-funcall (extern-alien "abs" (function (:leaf int) int)) x)))))
+    (assert (= (funcall f -42) 42)))
+  (assert-error (sb-alien::parse-alien-type '(function (:leaf :bogus int)) nil)))
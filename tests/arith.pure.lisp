@@ -1032,3 +1032,18 @@
                 a b))
       (- a b))
    (((- (expt 2 sb-vm:n-word-bits) 10) (- (expt 2 sb-vm:n-word-bits) 9)) -1)))
+
+(with-test (:name (* bignum :karatsuba))
+  (flet ((try (a b)
+           (let ((product (* a b)))
+             (assert (equal (multiple-value-list (truncate product b)) (list a 0)))
+             (assert (= (- (* (1+ a) b) b) product))
+             (assert (= (* b a) product)))))
+    (dolist (bits '(64 2560 2625 5000 10000 40000))
+      (dolist (other-bits (list 64 (floor bits 3) (1- bits) bits (* 3 bits)))
+        (let ((a (random (ash 1 bits)))
+              (b (random (ash 1 other-bits))))
+          (try (1+ a) (1+ b))
+          (try (- (1+ a)) (1+ b))
+          (try (1- (ash 1 bits)) (1- (ash 1 other-bits)))
+          (try (1+ a) (1+ a)))))))
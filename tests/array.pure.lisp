@@ -449,6 +449,22 @@
          ;; Strings are null-terminated for C interoperability
          (char #.(coerce "abcd" 'simple-base-string) x))
     ((4) #\Nul)))
+(with-test (:name :check-bound-elision-decreasing-index)
+  (checked-compile-and-assert (:optimize :safe)
+      `(lambda (v)
+         (declare (simple-vector v))
+         (loop for i from (1- (length v)) downto 0
+               collect (svref v i)))
+    ((#(1 2 3)) '(3 2 1) :test #'equal)
+    ((#()) nil))
+  ;; Stepping past zero still gets caught
+  (checked-compile-and-assert (:optimize :safe)
+      `(lambda (v)
+         (declare (simple-vector v))
+         (let ((i (1- (length v))))
+           (loop (svref v i)
+                 (decf i 2))))
+    ((#(1 2 3)) (condition 'error))))
 (defun check-bound-multiple-reads (x i)
   (let* ((x (truly-the simple-vector x))
          (l (sb-c::vector-length x)))
@@ -3,7 +3,7 @@
 
 #-sb-thread (invoke-restart 'run-tests::skip-file) ;; some of the symbols below disappear
 
-(import 'sb-thread::(avlnode-key avlnode-data avlnode-left avlnode-right
+(import 'sb-thread::(avlnode-key avlnode-data avlnode-left avlnode-right avlnode-height
                      avl-find<= avl-find>=
                      avl-insert avl-delete avl-find
                      avl-balance-factor avl-count))
@@ -33,6 +33,14 @@ node [shape=record];~%")
         (assert (<= min key max))
         (recurse (avlnode-left node) min (1- key))
         (recurse (avlnode-right node) (1+ key) max))))
+  ;; with the right height in each node
+  (named-let recurse ((node tree))
+    (if node
+        (let ((height (1+ (max (recurse (avlnode-left node))
+                               (recurse (avlnode-right node))))))
+          (assert (= (avlnode-height node) height))
+          height)
+        0))
   ;; and as balanced as required
   (named-let recurse ((node tree))
     (when node
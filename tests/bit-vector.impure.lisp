@@ -56,6 +56,42 @@
       (assert (= 1 (count 1 bv3)))
       (assert (= 67 (count 0 bv3))))))
 
+(defun random-bit-vector (length)
+  (let ((vector (make-array length :element-type 'bit)))
+    (dotimes (i length vector)
+      (setf (sbit vector i) (random 2)))))
+
+;;; Long enough for the C runtime to do the work, and with ends that
+;;; aren't on word boundaries
+(with-test (:name (bit-vector count :start :end :long))
+  (let ((vector (random-bit-vector 10000)))
+    (dolist (start '(0 1 63 64 65 777))
+      (dolist (end '(777 4095 4097 9999 10000))
+        (let ((ones (loop for i from start below end count (= (sbit vector i) 1))))
+          (assert (= (count 1 vector :start start :end end) ones))
+          (assert (= (count 0 vector :start start :end end) (- end start ones))))))
+    (let ((displaced (make-array 9000 :element-type 'bit :displaced-to vector
+                                      :displaced-index-offset 99 :fill-pointer 8000)))
+      (assert (= (count 1 displaced)
+                 (loop for i from 99 below 8099 count (= (sbit vector i) 1)))))
+    (assert (= (count 1 vector :key #'identity) (count 1 vector)))))
+
+(with-test (:name (bit-vector bit-and bit-ior bit-xor :long))
+  (let ((a (random-bit-vector 10000))
+        (b (random-bit-vector 10000)))
+    (loop for (operation function) in `((bit-and ,#'logand) (bit-ior ,#'logior)
+                                        (bit-xor ,#'logxor) (bit-eqv ,#'logeqv)
+                                        (bit-nand ,#'lognand) (bit-nor ,#'lognor)
+                                        (bit-andc1 ,#'logandc1) (bit-andc2 ,#'logandc2)
+                                        (bit-orc1 ,#'logorc1) (bit-orc2 ,#'logorc2))
+          do (let ((result (funcall operation a b))
+                   (in-place (copy-seq a)))
+               (funcall operation in-place b t)
+               (dotimes (i 10000)
+                 (let ((bit (logand (funcall function (sbit a i) (sbit b i)) 1)))
+                   (assert (= (sbit result i) bit))
+                   (assert (= (sbit in-place i) bit))))))))
+
 ;;; now test the biggy, mostly that it works...
 ;;;
 ;;; except on machines where the arrays won't fit into the dynamic
@@ -2694,3 +2694,57 @@
                      (lambda (c) (use-value 2 c))))
       (setf (setf-slot-value-restart-a instance) 'y))
     (assert (eql (setf-slot-value-restart-a instance) 2))))
+
+(defclass inline-cache-a () ())
+(defclass inline-cache-b (inline-cache-a) ())
+(defclass inline-cache-c () ())
+(defgeneric inline-cache-gf (x y))
+(defmethod inline-cache-gf ((x inline-cache-a) y) (list :a y))
+(defmethod inline-cache-gf ((x inline-cache-c) y) (list :c y))
+
+(with-test (:name (:generic-function-inline-caches))
+  (let ((fun (compile nil '(lambda (x)
+                            (declare (optimize (sb-c::generic-function-inline-caches 3)))
+                            (inline-cache-gf x 1))))
+        (a (make-instance 'inline-cache-a))
+        (b (make-instance 'inline-cache-b))
+        (c (make-instance 'inline-cache-c)))
+    (assert (ctu:find-named-callees fun :name 'sb-pcl::call-site-cache-miss))
+    (dotimes (i 3)
+      (assert (equal (funcall fun a) '(:a 1)))
+      (assert (equal (funcall fun b) '(:a 1)))
+      (assert (equal (funcall fun c) '(:c 1))))
+    ;; New methods and class redefinitions invalidate the cache.
+    (defmethod inline-cache-gf ((x inline-cache-b) y) (list :b y))
+    (dotimes (i 3)
+      (assert (equal (funcall fun b) '(:b 1)))
+      (assert (equal (funcall fun a) '(:a 1))))
+    (defclass inline-cache-b (inline-cache-c) ())
+    (dotimes (i 3)
+      (assert (equal (funcall fun b) '(:b 1)))
+      (assert (equal (funcall fun c) '(:c 1))))
+    (remove-method #'inline-cache-gf
+                   (find-method #'inline-cache-gf '() '(inline-cache-b t)))
+    (dotimes (i 3)
+      (assert (equal (funcall fun b) '(:c 1))))
+    (assert-error (funcall fun 42))))
+
+(defclass typep-chain-a () ())
+(defclass typep-chain-b (typep-chain-a) ())
+(defclass typep-chain-c (typep-chain-b) ())
+(defclass typep-chain-mixin () ())
+(defclass typep-chain-d (typep-chain-mixin typep-chain-b) ())
+
+(with-test (:name (typep standard-object :single-inheritance))
+  (let ((fun (compile nil '(lambda (x)
+                            (list (typep x 'typep-chain-a)
+                                  (typep x 'typep-chain-b)
+                                  (typep x 'typep-chain-c)
+                                  (typep x 'typep-chain-mixin))))))
+    (assert (equal (funcall fun (make-instance 'typep-chain-c)) '(t t t nil)))
+    (assert (equal (funcall fun (make-instance 'typep-chain-d)) '(t t nil t)))
+    (assert (equal (funcall fun (make-instance 'typep-chain-a)) '(t nil nil nil)))
+    (assert (equal (funcall fun 42) '(nil nil nil nil)))
+    ;; The mixin moves B away from its place after its ancestors.
+    (defclass typep-chain-c (typep-chain-mixin typep-chain-b) ())
+    (assert (equal (funcall fun (make-instance 'typep-chain-c)) '(t t t t)))))
@@ -197,6 +197,84 @@
     (mapc #'sb-thread:join-thread threads)
     (assert (= 0 (box-word box)))))
 
+;;; Specialized vectors, with their types known and not
+(with-test (:name (:cas :atomic-incf :atomic-exchange :specialized-vectors)
+            :skipped-on (not :x86-64))
+  (dolist (type '(sb-ext:word (unsigned-byte 32) fixnum))
+    (let ((vector (make-array 3 :element-type type :initial-element 0)))
+      (checked-compile-and-assert ()
+          `(lambda (v)
+             (declare (type (simple-array ,type (*)) v))
+             (list (atomic-incf (aref v 1) 5)
+                   (atomic-decf (aref v 1) 2)
+                   (cas (aref v 1) 3 7)
+                   (cas (aref v 1) 3 8)
+                   (atomic-exchange (aref v 1) 9 :order :release)
+                   (atomic-load (aref v 1) :order :acquire)
+                   (aref v 0)
+                   (aref v 2)))
+        ((vector) '(0 5 3 7 7 9 0 0)))
+      (assert (equal (list (atomic-incf (aref (opaque-identity vector) 2))
+                           (cas (aref (opaque-identity vector) 2) 1 2)
+                           (atomic-exchange (aref (opaque-identity vector) 2) 4)
+                           (aref vector 2))
+                     '(0 1 2 4)))
+      (assert-error (cas (aref (opaque-identity vector) 3) 0 1))
+      (assert-error (atomic-exchange (aref (opaque-identity vector) 3) 1))))
+  (let ((vector (make-array 1 :element-type '(unsigned-byte 32)
+                              :initial-element #xffffffff)))
+    (assert (= (atomic-incf (aref vector 0) 2) #xffffffff))
+    (assert (= (atomic-decf (aref vector 0) 2) 1))
+    (assert (= (aref vector 0) #xffffffff)))
+  (let ((vector (make-array 1 :element-type 'fixnum
+                              :initial-element most-positive-fixnum)))
+    (assert (= (atomic-incf (aref vector 0)) most-positive-fixnum))
+    (assert (= (aref vector 0) most-negative-fixnum))
+    (assert (= (atomic-exchange (aref vector 0) -1) most-negative-fixnum))
+    (assert (= (atomic-decf (aref vector 0) -3) -1))
+    (assert (= (aref vector 0) 2)))
+  (let ((vector (make-array 1 :element-type 'sb-ext:word
+                              :initial-element sb-ext:most-positive-word)))
+    ;; Compared as numbers, not by EQ
+    (assert (= (cas (aref vector 0) (1+ (1- sb-ext:most-positive-word)) 0)
+               sb-ext:most-positive-word))
+    (assert (= (aref vector 0) 0))))
+
+(with-test (:name (:atomic-exchange :atomic-load :other-places))
+  (let ((box (make-box :word 42))
+        (cons (cons 1 2))
+        (vector (vector :a :b)))
+    (assert (= (atomic-exchange (box-word box) sb-ext:most-positive-word) 42))
+    (assert (= (atomic-load (box-word box)) sb-ext:most-positive-word))
+    (assert (= (atomic-exchange (car cons) 3 :order :acq-rel) 1))
+    (assert (eq (atomic-exchange (svref vector 1) :c) :b))
+    (assert (eq (atomic-exchange (aref vector 1) :d) :c))
+    (assert (eq (cas (aref vector 0) :a :e) :a))
+    (assert (equal (list (atomic-load (car cons) :order :relaxed)
+                         (atomic-load (aref vector 1))
+                         (atomic-load (aref vector 0) :order :seq-cst))
+                   '(3 :d :e))))
+  (assert-error (macroexpand-1 '(atomic-load (car x) :order :release)))
+  (assert-error (macroexpand-1 '(atomic-exchange (car x) 1 :order :consume))))
+
+#+(and sb-thread x86-64)
+(with-test (:name (:atomic-incf :atomic-exchange :specialized-vectors :threads))
+  (let ((counts (make-array 4 :element-type '(unsigned-byte 32) :initial-element 0))
+        (slots (make-array 2 :element-type 'fixnum :initial-element 0)))
+    (mapc #'sb-thread:join-thread
+          (loop for i from 1 to 16
+                collect (let ((i i))
+                          (sb-thread:make-thread
+                           (lambda ()
+                             (dotimes (j 10000)
+                               (atomic-incf (aref counts (mod j 4)))
+                               ;; Every value is taken out exactly once
+                               (let ((old (atomic-exchange (aref slots 0) i)))
+                                 (atomic-incf (aref slots 1) old))))))))
+    (assert (every (lambda (count) (= count 40000)) counts))
+    (assert (= (+ (aref slots 1) (aref slots 0))
+               (* 10000 (loop for i from 1 to 16 sum i))))))
+
 (defglobal **my-atomic-counter* 0)
 (declaim (fixnum **my-atomic-counter*))
 ;; Assert that safe (atomic-incf car) type-checks the car.
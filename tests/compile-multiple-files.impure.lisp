@@ -43,3 +43,27 @@
        (in-package :multiple-file-compile)
        (defun multiple-file-compile:bar (a b)
          (* a (multiple-file-compile:foo a b)))))))
+
+(defpackage multiple-file-block
+  (:use :cl)
+  (:export :entry))
+
+(with-test (:name (:compile-multiple-files :block-compile :entry-points))
+  (let ((lisps (list (scratch-file-name "lisp") (scratch-file-name "lisp")))
+        (fasl (scratch-file-name "fasl")))
+    (unwind-protect
+         (progn
+           (with-open-file (f (first lisps) :direction :output)
+             (print '(in-package "MULTIPLE-FILE-BLOCK") f)
+             (print '(defun helper (x) (* x 2)) f))
+           (with-open-file (f (second lisps) :direction :output)
+             (print '(in-package "MULTIPLE-FILE-BLOCK") f)
+             (print '(defun entry (x) (1+ (helper x))) f))
+           (sb-c:compile-files lisps :output-file fasl :block-compile t
+                                     :entry-points '(multiple-file-block:entry))
+           (load fasl)
+           (assert (= (multiple-file-block:entry 20) 41))
+           ;; The call from the second file became a local call, and
+           ;; HELPER has no global definition.
+           (assert (not (fboundp (find-symbol "HELPER" "MULTIPLE-FILE-BLOCK")))))
+      (mapc #'delete-file (remove-if-not #'probe-file (list* fasl lisps))))))
@@ -3656,3 +3656,57 @@
            ((46 64 3 18 36 49 37) 1)
            (t A)))
     ((-5) -5)))
+
+(with-test (:name :hoist-loop-invariant-vops)
+  ;; Invariant in the inner loop, but not in the outer one
+  (checked-compile-and-assert
+      (:optimize '(:speed 2 :compilation-speed 0))
+      `(lambda (n m)
+         (declare (type (integer 0 100) n m))
+         (let ((sum 0))
+           (declare (fixnum sum))
+           (dotimes (i n sum)
+             (dotimes (j n)
+               (incf sum (logand (* i m) 255))))))
+    ((3 7) 63)
+    ((0 7) 0))
+  ;; Used after the loop, and written again when it is entered again
+  (checked-compile-and-assert
+      (:optimize '(:speed 2 :compilation-speed 0))
+      `(lambda (v m)
+         (declare (simple-vector v) (type (integer 0 100) m))
+         (let ((k (+ m 1)))
+           (loop repeat 2
+                 do (dotimes (i (length v))
+                      (setf (svref v i) (* k 2)))
+                    (incf k))
+           (list k (coerce v 'list))))
+    (((vector 0 0) 4) '(7 (12 12)) :test #'equal)
+    (((vector) 4) '(7 nil) :test #'equal)))
+
+(with-test (:name :hoist-loop-invariant-array-header-reads)
+  (checked-compile-and-assert
+      (:optimize '(:speed 2 :compilation-speed 0))
+      `(lambda (a)
+         (declare (type (simple-array double-float (* *)) a))
+         (let ((sum 0d0))
+           (declare (double-float sum))
+           (dotimes (i (array-dimension a 0) sum)
+             (dotimes (j (array-dimension a 1))
+               (incf sum (* (aref a i j) (+ i 1)))))))
+    (((make-array '(2 3) :element-type 'double-float
+                         :initial-contents '((1d0 2d0 3d0) (4d0 5d0 6d0))))
+     36d0)
+    (((make-array '(0 3) :element-type 'double-float)) 0d0))
+  ;; Only known to be an array inside the loop
+  (checked-compile-and-assert
+      (:optimize '(:speed 2 :compilation-speed 0))
+      `(lambda (x n)
+         (declare (type (integer 0 10) n))
+         (let ((count 0))
+           (dotimes (i n count)
+             (when (typep x '(simple-array t (* *)))
+               (incf count (array-dimension x 1))))))
+    ((nil 3) 0)
+    ((42 3) 0)
+    (((make-array '(1 5)) 3) 15)))
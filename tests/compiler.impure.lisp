@@ -3111,3 +3111,90 @@
   (with-scratch-file (fasl "fasl")
     (compile-file "bug-255" :output-file fasl))
   (delete-package :bug255))
+
+(with-test (:name (compile sb-ext:*tiered-compile-threshold*))
+  (let* ((fun (let ((sb-ext:*tiered-compile-threshold* 3))
+                (compile nil '(lambda (x) (1+ x)))))
+         (quick (sb-kernel:%funcallable-instance-fun fun)))
+    (assert (typep fun 'sb-c::tiered-function))
+    (assert (compiled-function-p fun))
+    (dotimes (i 3)
+      (assert (= (funcall fun i) (1+ i))))
+    (loop repeat 500
+          while (eq (sb-kernel:%funcallable-instance-fun fun) quick)
+          do (sleep .01))
+    (assert (not (eq (sb-kernel:%funcallable-instance-fun fun) quick)))
+    (assert (= (funcall fun 41) 42))))
+
+(with-test (:name (compile sb-c::with-compile-profile))
+  (with-scratch-file (trace "json")
+    (let* ((summary
+             (with-output-to-string (s)
+               (sb-c::with-compile-profile (:summary s :trace-file trace)
+                 (compile 'profiled-fun '(lambda (x) (* x 2))))))
+           (json (with-open-file (f trace) (read-line f))))
+      (assert (search "compiler profile" summary))
+      (assert (search "pack" summary))
+      (assert (search "slowest functions" summary))
+      (assert (= (profiled-fun 21) 42))
+      (assert (string= json "{\"traceEvents\":[")))))
+
+(defun fdefn-ftype-fun (x y) (declare (fixnum x y)) (+ x y))
+(with-test (:name (compile :cached-fdefn-ftype))
+  (sb-int:clear-info :function :type 'fdefn-ftype-fun)
+  (multiple-value-bind (fun failure-p warnings style-warnings)
+      (checked-compile '(lambda (a) (list (fdefn-ftype-fun a) (fdefn-ftype-fun a)))
+                       :allow-warnings t :allow-style-warnings t)
+    (declare (ignore fun failure-p))
+    (assert (= (length (append warnings style-warnings)) 2))))
+
+(declaim (ftype (function (double-float double-float) (values double-float &optional))
+                unboxed-return-add)
+         (ftype (function (sb-ext:word) (values sb-ext:word &optional))
+                unboxed-return-not))
+(locally (declare (optimize speed (space 0) (debug 1)))
+  (defun unboxed-return-add (x y) (+ x y))
+  (defun unboxed-return-not (x) (logxor x sb-ext:most-positive-word)))
+(with-test (:name (defun :unboxed-return))
+  (assert (eq (sb-int:info :function :unboxed-return 'unboxed-return-add) 'double-float))
+  (assert (eq (sb-int:info :function :unboxed-return 'unboxed-return-not) 'sb-ext:word))
+  (assert (= (unboxed-return-add 1d0 2d0) 3d0))
+  (let ((add (checked-compile '(lambda (x y) (unboxed-return-add x y))))
+        (flip (checked-compile '(lambda (x) (unboxed-return-not x)))))
+    (assert (ctu:find-named-callees add :name '(sb-impl::unboxed-return unboxed-return-add)))
+    (assert (= (funcall add 1d0 2d0) 3d0))
+    (assert (= (funcall flip 0) sb-ext:most-positive-word))
+    (assert (= (funcall flip sb-ext:most-positive-word) 0))
+    ;; Callers compiled for the companion keep working after a
+    ;; redefinition without one
+    (handler-bind ((warning #'muffle-warning))
+      (eval '(defun unboxed-return-add (x y) (- x y))))
+    (assert (not (sb-int:info :function :unboxed-return 'unboxed-return-add)))
+    (assert (= (funcall add 1d0 2d0) -1d0))))
+
+(with-test (:name (compile sb-c::*compile-cache-directory*))
+  (let* ((dir (format nil "~A/" (scratch-file-name)))
+         (sb-c::*compile-cache-directory* dir)
+         (form '(lambda (x) (declare (fixnum x)) (list x 1.5d0 "str"))))
+    (flet ((fasls () (directory (merge-pathnames "*.fasl" dir)))
+           (source (fun)
+             (sb-c::debug-source-namestring
+              (sb-c::debug-info-source
+               (sb-kernel:%code-debug-info (sb-kernel:fun-code-header fun))))))
+      (unwind-protect
+           (let ((fun (compile nil form)))
+             (assert (equal (funcall fun 3) '(3 1.5d0 "str")))
+             (assert (= (length (fasls)) 1))
+             ;; The same form again comes from the fasl
+             (let* ((again (compile nil (copy-tree form)))
+                    (source (source again)))
+               (assert (and source (search ".lisp" source)))
+               (assert (equal (funcall again 4) '(4 1.5d0 "str"))))
+             ;; Under another policy it is another entry
+             (with-compilation-unit (:policy '(optimize (debug 0) (safety 0)))
+               (compile nil form))
+             (assert (= (length (fasls)) 2))
+             ;; Constants which don't print readably aren't cached
+             (compile nil `(lambda () ,(make-hash-table)))
+             (assert (= (length (fasls)) 2)))
+        (sb-ext:delete-directory dir :recursive t)))))
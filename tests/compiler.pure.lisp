@@ -6330,3 +6330,31 @@
       (handler-bind ((error (constantly nil)))
         (pathname-type x)))
    :allow-notes nil))
+
+(with-test (:name (compile :linear-scan-register-allocation))
+  (let ((vars (loop repeat 40 collect (gensym "V"))))
+    (checked-compile-and-assert ()
+        `(lambda (n x)
+           (declare (optimize (sb-c::linear-scan-register-allocation 3))
+                    (fixnum n) (double-float x))
+           (let* ,(loop for var in vars
+                        for i from 1
+                        collect `(,var (* n ,i)))
+             (declare (fixnum ,@vars))
+             (let ((sum 0) (y x))
+               (declare (fixnum sum) (double-float y))
+               (dotimes (i n)
+                 (setf sum (logand (+ sum i ,@vars) #xffff)
+                       y (+ y (float (funcall (if (evenp i) #'identity #'-) i)
+                                     1d0))))
+               (values sum y (list ,@vars)))))
+      ((10 1d0) (values (logand (+ 45 (* 10 (* 10 820))) #xffff)
+                        -4d0
+                        (loop for i from 1 to 40 collect (* 10 i)))))))
+
+(with-test (:name (compile sb-c::*compile-phase-times*))
+  (let ((sb-c::*compile-phase-times* (make-hash-table)))
+    (checked-compile '(lambda (x) (if (consp x) (car x) x)))
+    (dolist (phase '(:ir1-optimize :constraint :ir2-convert :life :pack :code))
+      (assert (typep (gethash phase sb-c::*compile-phase-times*)
+                     '(integer 0))))))
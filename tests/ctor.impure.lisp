@@ -382,3 +382,33 @@
         (destructuring-bind (f-6-e-c f-6-e-1 f-6-e-2)
             (mapcar #'make `(,constant-name-2 1 2))
           (check f-6-e-c 1 f-6-e-1 1 f-6-e-2 2))))))
+
+(defclass runtime-ctor-class ()
+  ((a :initarg :a :reader runtime-ctor-a)
+   (b :initarg :b :initform 2 :reader runtime-ctor-b)))
+
+(with-test (:name (make-instance :runtime-ctor))
+  (let* ((class (find-class 'runtime-ctor-class))
+         (initargs (list :a 1))
+         (instances (loop for i below (* 2 sb-pcl::+runtime-ctor-threshold+)
+                          collect (apply #'make-instance class
+                                         (list* :b i initargs))))
+         (entry (find '(:b :a) (sb-pcl::plist-value class 'sb-pcl::runtime-ctors)
+                      :key #'car :test #'equal)))
+    (loop for instance in instances
+          for i from 0
+          do (assert (eql (runtime-ctor-a instance) 1))
+             (assert (eql (runtime-ctor-b instance) i)))
+    (assert (typep (cdr entry) 'sb-pcl::ctor))
+    (assert (eq (sb-pcl::ctor-state (cdr entry)) 'sb-pcl::optimized))
+    ;; Redefinition resets the ctor, and the next call optimizes it again.
+    (defclass runtime-ctor-class ()
+      ((a :initarg :a :reader runtime-ctor-a)
+       (b :initarg :b :initform 3 :reader runtime-ctor-b)
+       (c :initform 4 :reader runtime-ctor-c)))
+    (let ((instance (apply #'make-instance class :b 5 initargs)))
+      (assert (eql (runtime-ctor-b instance) 5))
+      (assert (eql (runtime-ctor-c instance) 4)))
+    (assert (eq (sb-pcl::ctor-state (cdr entry)) 'sb-pcl::optimized))
+    (assert (eql (runtime-ctor-b (apply #'make-instance class :a 0 ())) 3))
+    (assertoid:assert-error (apply #'make-instance class :b 1 :bogus 2 ()))))
@@ -148,6 +148,20 @@
                                          1~@
                                          0~%")))))
 
+(with-test (:name (trace :report :buffer))
+  (sb-debug:trace-buffer-events :clear t)
+  (let ((output (with-traced-function (trace-this :report :buffer)
+                  (assert (eq 'ok (trace-this 1)))
+                  (assert (eq 'ok (funcall 'trace-this 2))))))
+    (assert (sequence:emptyp output))
+    (assert (equal (mapcar #'cddr (sb-debug:trace-buffer-events))
+                   '((:call trace-this 1) (:return trace-this ok)
+                     (:call trace-this 2) (:return trace-this ok)))))
+  ;; Untracing restores the entry point.
+  (assert (eq 'ok (trace-this 3)))
+  (assert (= (length (sb-debug:trace-buffer-events :clear t)) 4))
+  (assert (null (sb-debug:trace-buffer-events))))
+
 (with-test (:name :bug-414)
   (handler-bind ((warning #'error))
     (with-scratch-file (output "fasl")
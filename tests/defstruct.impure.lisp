@@ -1481,3 +1481,43 @@ redefinition."
     (assert (eq f #'sb-int:pathname=)))
   (let ((f (sb-kernel:wrapper-equalp-impl (sb-kernel:find-layout 'hash-table))))
     (assert (eq f #'sb-int:hash-table-equalp))))
+
+(defstruct (packed-struct (:packed t))
+  (a 0 :type (unsigned-byte 8))
+  (b nil :type boolean)
+  (c 0 :type (signed-byte 16))
+  name
+  (d 0 :type (unsigned-byte 16))
+  (e 0 :type (unsigned-byte 32)))
+(defstruct (packed-substruct (:include packed-struct) (:packed t))
+  (f t :type boolean))
+
+(test-util:with-test (:name (defstruct :packed))
+  (let ((x (make-packed-struct :a 200 :b t :c -300 :name 'x :d 65535 :e 7)))
+    ;; A, B, C and D share a word, and E takes another with room for F
+    (assert (= (sb-kernel:%instance-length x)
+               (sb-kernel:%instance-length (make-packed-substruct))))
+    (assert (equal (list (packed-struct-a x) (packed-struct-b x) (packed-struct-c x)
+                         (packed-struct-name x) (packed-struct-d x) (packed-struct-e x))
+                   '(200 t -300 x 65535 7)))
+    (setf (packed-struct-c x) 32767 (packed-struct-b x) nil)
+    (assert (equal (list (packed-struct-a x) (packed-struct-b x) (packed-struct-c x)
+                         (packed-struct-d x))
+                   '(200 nil 32767 65535)))
+    (incf (packed-struct-a x) 55)
+    (assert (= (packed-struct-a x) 255))
+    (assert-error (setf (packed-struct-a x) 256))
+    (assert (equalp x (copy-packed-struct x)))
+    (assert (= (sb-impl::psxhash x) (sb-impl::psxhash (copy-packed-struct x))))
+    (assert (not (equalp x (make-packed-struct :a 255 :c 32767 :name 'x :d 65535 :e 7
+                                               :b t))))
+    (assert (search "#S(PACKED-STRUCT :A 255 :B NIL :C 32767 :NAME X :D 65535 :E 7)"
+                    (write-to-string x :pretty nil))))
+  (let ((y (make-packed-substruct :c -1 :f nil)))
+    (assert (equal (list (packed-struct-c y) (packed-substruct-f y) (packed-struct-b y))
+                   '(-1 nil nil)))
+    (setf (packed-substruct-f y) t)
+    (assert (equal (list (packed-struct-c y) (packed-substruct-f y)) '(-1 t)))
+    (assert (eql (slot-value y 'c) -1))
+    (setf (slot-value y 'c) 5)
+    (assert (eql (packed-struct-c y) 5))))
@@ -0,0 +1,49 @@
+#!/bin/sh
+
+# tests related to delta .core files
+
+# This software is part of the SBCL system. See the README file for
+# more information.
+#
+# While most of SBCL is derived from the CMU CL system, the test
+# files (like this one) were written from scratch after the fork
+# from CMU CL.
+#
+# This software is in the public domain and is provided with
+# absolutely no warranty. See the COPYING and CREDITS files for
+# more information.
+
+. ./subr.sh
+
+use_test_subdirectory
+
+if [ -z "`run_sbcl --eval '(progn #+(and gencgc (not win32) (not darwin-jit)) (princ :yes))' --quit`" ]
+then
+    # shell tests don't have a way of exiting as "not applicable"
+    exit $EXIT_TEST_WIN
+fi
+
+basecore=$TEST_FILESTEM-base.core
+tmpcore=$TEST_FILESTEM.core
+
+run_sbcl <<EOF
+  (defvar *base-data* (make-array 100000 :initial-element :base))
+  (save-lisp-and-die "$basecore")
+EOF
+run_sbcl_with_core "$basecore" --noinform --no-userinit --no-sysinit --disable-debugger \
+    --eval '(defvar *delta-data* (make-list 1000 :initial-element :delta))' \
+    --eval "(save-lisp-and-die \"$tmpcore\" :base-core \"$basecore\")"
+run_sbcl_with_core "$tmpcore" --noinform --no-userinit --no-sysinit --disable-debugger \
+    --eval '(assert (every (lambda (x) (eq x :base)) *base-data*))' \
+    --eval '(assert (equal *delta-data* (make-list 1000 :initial-element :delta)))' \
+    --eval '(gc :full t)' --quit
+check_status_maybe_lose "SAVE-LISP-AND-DIE :BASE-CORE" $? 0 "(delta core ran)"
+
+run_sbcl_with_core "$basecore" --noinform --no-userinit --no-sysinit --disable-debugger \
+    --eval "(handler-case (save-lisp-and-die \"$basecore\" :base-core \"$basecore\")
+              (error () (exit :code 3)))"
+check_status_maybe_lose "SAVE-LISP-AND-DIE :BASE-CORE over itself" $? 3 "(refused)"
+
+rm -f "$tmpcore" "$basecore"
+
+exit $EXIT_TEST_WIN
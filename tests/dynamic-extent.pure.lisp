@@ -691,6 +691,26 @@
                    (:no-error (res)
                      (1- res))))))
 
+;;; and so should restart-case, for the closures over its tags and
+;;; arguments as well as for the restarts
+
+(defun dx-restart-case (x)
+  (restart-case (/ 2 x)
+    (use-value (value)
+      :report (lambda (stream) (format stream "Use a value instead of ~S." x))
+      :interactive (lambda () (list (read)))
+      value)
+    (store-value (&rest values)
+      :test (lambda (c) (declare (ignore c)) (plusp x))
+      values)
+    (continue ()
+      :report "Return zero."
+      0)))
+
+(defun dx-with-simple-restart (x)
+  (with-simple-restart (abort "Give up on ~S." x)
+    (/ 2 x)))
+
 (defun list-delete-some-stuff ()
   ;; opaque-identity hides the fact that we are calling a destructive function
   ;; on a constant, which is technically illegal. But no deletion occurs,
@@ -731,7 +751,9 @@
   (assert-no-consing (nested-good 42))
   (assert-no-consing (nested-dx-conses))
   (assert-no-consing (dx-handler-bind 2))
-  (assert-no-consing (dx-handler-case 2)))
+  (assert-no-consing (dx-handler-case 2))
+  (assert-no-consing (dx-restart-case 2))
+  (assert-no-consing (dx-with-simple-restart 2)))
 
 (with-test (:name (:no-consing :dx-vectors))
   (assert-no-consing (force-make-array-on-stack 128))
@@ -1694,3 +1716,34 @@
                       x)))
              (declare (dynamic-extent *)))))
     ((1) 1)))
+
+;;; Stack allocation without a declaration
+
+(declaim (inline make-non-escaping-point))
+(defstruct non-escaping-point x y)
+(defun non-escaping-sum (a b)
+  (declare (optimize speed (debug 0)) (fixnum a b))
+  (let ((list (list a b))
+        (vector (make-array 4 :initial-element a))
+        (point (make-non-escaping-point :x a :y b)))
+    (setf (svref vector 1) b)
+    (if (and (= (length list) 2)
+             (eql (car list) (svref vector 3))
+             (eql (non-escaping-point-y point) (svref vector 1)))
+        :ok
+        :bad)))
+
+(with-test (:name (:non-escaping :stack-allocated) :skipped-on (not (or :x86 :x86-64)))
+  (assert (eq (non-escaping-sum 1 2) :ok))
+  (assert-no-consing (non-escaping-sum 1 2)))
+
+(with-test (:name (:non-escaping :escaping-is-heap-allocated))
+  (checked-compile-and-assert
+      (:optimize '(:speed 3 :debug 0))
+      `(lambda (a)
+         (let ((x (list a (list a)))
+               (y (list a))
+               (z (make-array 2 :initial-element a)))
+           (car y)
+           (list (cdr x) (car (cdr x)) y (aref z 0) z)))
+    ((1) '(((1)) (1) (1) 1 #(1 1)) :test #'equalp)))
@@ -1070,4 +1070,39 @@
                    (read-line f))))
   (delete-file *test-path*))
 
+;;; Runs of characters that are their own octets, as copied in bulk,
+;;; broken up by ones that aren't, across the ends of the buffers
+(with-test (:name (:single-octet-runs :roundtrip))
+  (dolist (xf '(:utf-8 :latin-1))
+    (dolist (other (list (code-char #xe9) (code-char #x3b1)))
+      (unless (and (eq xf :latin-1) (> (char-code other) 255))
+        (let ((string (make-string 20000 :initial-element #\a)))
+          (loop for i from 0 below 20000 by 997
+                do (setf (char string i) other
+                         (char string (min 19999 (+ i 3))) other))
+          (with-open-file (s *test-path* :direction :output
+                                         :if-exists :supersede :external-format xf)
+            (write-string string s))
+          (with-open-file (s *test-path* :direction :input :external-format xf)
+            (let ((got (make-string 20000)))
+              (assert (= (read-sequence got s) 20000))
+              (assert (string= got string))
+              (assert (eq (read-char s nil s) s)))))))))
+
+(with-test (:name (:single-octet-runs :decoding-error))
+  (with-open-file (s *test-path* :direction :output :if-exists :supersede
+                                 :element-type '(unsigned-byte 8))
+    (write-sequence (make-array 100 :element-type '(unsigned-byte 8)
+                                    :initial-element (char-code #\a))
+                    s)
+    (write-byte 200 s)
+    (write-byte (char-code #\b) s))
+  (with-open-file (s *test-path* :direction :input
+                                 :external-format '(:ascii :replacement #\?))
+    (let ((got (make-string 102)))
+      (assert (= (read-sequence got s) 102))
+      (assert (string= got (concatenate 'string (make-string 100 :initial-element #\a)
+                                        "?b")))))
+  (delete-file *test-path*))
+
 ;;;; success
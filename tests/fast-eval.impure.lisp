@@ -338,3 +338,18 @@
   (assert (eql (f) 3))
   (assert (not (compiled-function-p #'f)))
   (assert (compiled-function-p #'fancypkg:mystruct-x)))
+
+(in-package sb-interpreter)
+(defvar *hot-form-var* 1)
+(test-util:with-test (:name :hot-form-sexpr)
+  (let ((form (list '+ '*hot-form-var* 1)))
+    (dotimes (i 10)
+      (assert (= (eval form) 2)))
+    (assert (sexpr-p (car (gethash form *hot-forms*))))
+    ;; The SEXPR sees changes to the environment ...
+    (setq *hot-form-var* 10)
+    (assert (= (eval form) 11))
+    ;; ... and is discarded when the form is modified.
+    (setf (third form) 2)
+    (assert (= (eval form) 12))
+    (assert (not (sexpr-p (car (gethash form *hot-forms*)))))))
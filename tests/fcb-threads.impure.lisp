@@ -194,3 +194,26 @@
 (with-test (:name :try-join-foreign-thread)
   (assert (eq (tryjoiner) 'ok)))
 
+
+;;; With keep_foreign_threads_attached, a foreign thread is attached once,
+;;; and detached when it exits.
+(defglobal *callback-threads* nil)
+(define-alien-callable notethread int ()
+  (push sb-thread:*current-thread* *callback-threads*)
+  0)
+
+(with-test (:name (:foreign-thread :kept-attached) :skipped-on :sb-safepoint)
+  (setq *callback-threads* nil)
+  (setf (extern-alien "keep_foreign_threads_attached" int) 1)
+  (unwind-protect
+       (with-alien ((testfun (function int system-area-pointer int)
+                             :extern "minimal_perftest"))
+         (alien-funcall testfun (alien-sap (alien-callable-function 'notethread)) 10))
+    (setf (extern-alien "keep_foreign_threads_attached" int) 0))
+  (assert (= (length *callback-threads*) 10))
+  (let ((thread (first *callback-threads*)))
+    (assert (every (lambda (x) (eq x thread)) *callback-threads*))
+    (assert (sb-thread::thread-kept-attached-p thread))
+    ;; pthread_join returned, so the key destructor has run
+    (assert (not (sb-thread:thread-alive-p thread)))
+    (assert (not (member thread (sb-thread:list-all-threads))))))
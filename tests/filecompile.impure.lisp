@@ -55,3 +55,34 @@
           (delete-file thr1-out)
           (delete-file thr2-out)
           (delete-file thr3-out))))))))
+
+(with-test (:name (compile-files-in-parallel :output-in-order))
+  (let ((sources (loop for i below 5 collect (scratch-file-name "lisp"))))
+    (unwind-protect
+         (progn
+           (loop for source in sources
+                 for i from 0
+                 do (with-open-file (stream source :direction :output
+                                                   :if-exists :supersede)
+                      (format stream "(eval-when (:compile-toplevel) (format t \"<~D>\"))~%~
+                                      (defun parallel-compile-test-~D () ~D)~%"
+                              i i i)))
+           (multiple-value-bind (fasls warnings-p failure-p)
+               (let ((*standard-output* (make-string-output-stream)))
+                 (multiple-value-prog1
+                     (compile-files-in-parallel sources :threads 3)
+                   (let ((output (get-output-stream-string *standard-output*)))
+                     (assert (apply #'<
+                                    (loop for i below 5
+                                          collect (search (format nil "<~D>" i)
+                                                          output)))))))
+             (assert (not warnings-p))
+             (assert (not failure-p))
+             (assert (= (length fasls) 5))
+             (loop for fasl in fasls
+                   for i from 0
+                   do (load fasl)
+                      (assert (= (funcall (intern (format nil "PARALLEL-COMPILE-TEST-~D" i)))
+                                 i))
+                      (delete-file fasl))))
+      (mapc (lambda (source) (ignore-errors (delete-file source))) sources))))
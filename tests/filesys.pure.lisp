@@ -440,3 +440,55 @@
             (test (make-unspecific nil t)   "foo/")
             (test (make-unspecific t   nil) "foo/")
             (test (make-unspecific t   t)   "foo/")))
+
+;;; Enough entries to take several reads of the directory
+(with-test (:name (sb-ext:map-directory :namestrings) :skipped-on :win32)
+  (let ((test-directory (concatenate 'string (sb-ext:posix-getenv "TEST_DIRECTORY")
+                                     "/map-directory/")))
+    (ensure-directories-exist (merge-pathnames "subdir/" test-directory))
+    (unwind-protect
+         (flet ((entries (namestrings)
+                  (let ((entries '()))
+                    (sb-ext:map-directory (lambda (entry)
+                                            (push (if namestrings
+                                                      entry
+                                                      (native-namestring entry))
+                                                  entries))
+                                          test-directory :namestrings namestrings)
+                    (sort entries #'string<))))
+           (dotimes (i 3000)
+             (close (open (format nil "~Afile-~4,'0D.txt" test-directory i)
+                          :direction :output)))
+           (let ((namestrings (entries t)))
+             (assert (= (length namestrings) 3001))
+             (assert (equal namestrings (entries nil)))
+             (let ((subdir (car (last namestrings))))
+               (assert (string= "/subdir/" subdir :start2 (- (length subdir) 8))))))
+      (delete-directory test-directory :recursive t))))
+
+(with-test (:name (sb-unix:unix-stat-words :same-as sb-unix:unix-stat) :skipped-on :win32)
+  (let* ((name (native-namestring *load-truename*))
+         (octets (concatenate '(vector (unsigned-byte 8))
+                              (string-to-octets name) #(0)))
+         (buffer (make-array sb-unix:stat-words :element-type '(unsigned-byte 64))))
+    (multiple-value-bind (existsp dev ino mode nlink uid gid rdev size atime mtime)
+        (sb-unix:unix-stat name)
+      (declare (ignore dev nlink uid gid rdev atime))
+      (assert existsp)
+      (flet ((check ()
+               (assert (= (aref buffer sb-unix:stat-word-ino) ino))
+               (assert (= (aref buffer sb-unix:stat-word-mode) mode))
+               (assert (= (aref buffer sb-unix:stat-word-size) size))
+               (assert (= (aref buffer sb-unix:stat-word-mtime) mtime))
+               (assert (< (aref buffer sb-unix:stat-word-mtime-nsec) 1000000000))
+               (fill buffer 0)))
+        (assert (sb-unix:unix-stat-words name buffer))
+        (check)
+        (assert (sb-unix:unix-lstat-words (coerce octets '(simple-array (unsigned-byte 8) (*)))
+                                          buffer))
+        (check)
+        (with-open-file (stream name)
+          (assert (sb-unix:unix-fstat-words (sb-sys:fd-stream-fd stream) buffer))
+          (check))
+        (assert (equal (multiple-value-list (sb-unix:unix-stat-words "/nonexistent/x" buffer))
+                       (list nil sb-unix:enoent)))))))
@@ -486,5 +486,33 @@ cat > $TEST_FILESTEM.alien.enum.lisp <<EOF
 EOF
 expect_clean_compile $TEST_FILESTEM.alien.enum.lisp
 
+# A saved core remembers where each foreign symbol was found. If the
+# shared object has changed when the core starts, its symbols have to
+# be looked up again.
+cat > $TEST_FILESTEM.relink.c <<EOF
+int relink_value() { return 1; }
+EOF
+build_so $TEST_FILESTEM.relink
+
+run_sbcl <<EOF
+  (load-shared-object (truename "$TEST_FILESTEM.relink.so"))
+  (defun relink-value () (alien-funcall (extern-alien "relink_value" (function int))))
+  (assert (= (relink-value) 1))
+  (save-lisp-and-die "$TEST_FILESTEM.relink.core")
+EOF
+check_status_maybe_lose "save relink" $? 0 "(successful save)"
+
+cat > $TEST_FILESTEM.relink.c <<EOF
+int relink_padding(int x) { return x * 3 + 1; }
+int relink_value() { return relink_padding(0) + 1; }
+EOF
+build_so $TEST_FILESTEM.relink
+
+run_sbcl_with_core $TEST_FILESTEM.relink.core --no-sysinit --no-userinit <<EOF
+  (assert (= (relink-value) 2))
+  (exit :code $EXIT_LISP_WIN)
+EOF
+check_status_maybe_lose "start relink" $?
+
 # success convention for script
 exit $EXIT_TEST_WIN
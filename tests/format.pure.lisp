@@ -150,3 +150,14 @@
              (format nil control-string '(1 2)))))
       (assert (string= s1 "hello (1 2)"))
       (assert (string= s2 "Yello (1 2)")))))
+
+(with-test (:name :compiled-runtime-control-string)
+  (let ((control-string
+         (locally (declare (notinline format)) (format nil "~~A=~~D~~@[ ~~A~~]~~*~~{<~~A>~~}")))
+        (results nil))
+    (dotimes (i 30)
+      (push (format nil control-string 'x i (oddp i) 'skipped '(1 2)) results))
+    (assert (functionp (car (gethash control-string sb-format::*compiled-formats*))))
+    (loop for result in results
+          for i downfrom 29
+          do (assert (string= result (format nil "X=~D~:[~; T~]<1><2>" i (oddp i)))))))
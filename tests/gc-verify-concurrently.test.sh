@@ -0,0 +1,45 @@
+#!/bin/sh
+
+# This software is part of the SBCL system. See the README file for
+# more information.
+#
+# While most of SBCL is derived from the CMU CL system, the test
+# files (like this one) were written from scratch after the fork
+# from CMU CL.
+#
+# This software is in the public domain and is provided with
+# absolutely no warranty. See the COPYING and CREDITS files for
+# more information.
+
+. ./subr.sh
+
+use_test_subdirectory
+
+# The concurrent verifier must get through the heap a few times while
+# Lisp stores young objects into old ones and collects, and find nothing.
+tmplog=$TEST_DIRECTORY/$TEST_FILESTEM.log
+run_sbcl_with_args --gc-verify-concurrently 1 --gc-verify-log "$tmplog" \
+    --noinform --no-sysinit --no-userinit --disable-debugger --non-interactive \
+    --eval '
+#-sb-thread (exit :code 52)
+#+sb-thread
+(progn
+  (setf (extern-alien "concurrent_verify_interval_ms" unsigned-int) 10)
+  (let ((old (make-array 10000)))
+    (dotimes (i (length old)) (setf (aref old i) (list i)))
+    (gc :full t)
+    (let ((deadline (+ (get-internal-real-time)
+                       (* 60 internal-time-units-per-second)))
+          (start (extern-alien "concurrent_verify_passes" unsigned-long)))
+      (loop for n from 0
+            until (or (> (extern-alien "concurrent_verify_passes" unsigned-long)
+                         (+ start 3))
+                      (> (get-internal-real-time) deadline))
+            do (setf (car (aref old (mod n (length old)))) (make-string 10))
+               (when (zerop (mod n 100000)) (gc))))
+    (exit :code (if (and (> (extern-alien "concurrent_verify_passes" unsigned-long) 0)
+                         (zerop (extern-alien "concurrent_verify_errors" unsigned-long)))
+                    52 1))))'
+check_status_maybe_lose "concurrent verification" $?
+
+exit $EXIT_TEST_WIN
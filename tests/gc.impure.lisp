@@ -477,3 +477,341 @@
   (gc)
   (let ((marks (sb-kernel:object-card-marks *vvv*)))
     (assert (not (find 1 marks)))))
+
+;;; Small instances are copied to pages holding a single object size,
+;;; where the start of an object is computed from an interior address.
+(defstruct (sc1 (:copier nil) (:predicate nil)) a)
+(defstruct (sc3 (:copier nil) (:predicate nil)) a b c)
+(defstruct (sc8 (:copier nil) (:predicate nil)) a b c d e f g h)
+#+gencgc
+(with-test (:name :search-size-class-pages)
+  (let ((objects (loop repeat 2000
+                       collect (make-sc1) collect (make-sc3) collect (make-sc8))))
+    (gc)
+    (dolist (obj objects)
+      (let ((base (logandc2 (sb-kernel:get-lisp-obj-address obj) sb-vm:lowtag-mask)))
+        (loop for offset below (* (sb-kernel:%instance-length obj) sb-vm:n-word-bytes)
+              by sb-vm:n-word-bytes
+              do (assert (= (alien-funcall (extern-alien "search_all_gc_spaces"
+                                                         (function unsigned unsigned))
+                                           (+ base offset))
+                            base)))))))
+
+(with-test (:name :gc-pause-histogram)
+  (flet ((total (histogram phase)
+           (loop for i below 32 sum (aref histogram phase i))))
+    (let ((before (sb-ext:gc-pause-histogram)))
+      (gc)
+      (let ((after (sb-ext:gc-pause-histogram)))
+        #+gencgc (assert (> (total after 1) (total before 1)))
+        #+sb-thread
+        (assert (> (total after 5) (total before 5)))
+        #+sb-thread
+        (assert (> (total after 6) (total before 6)))))))
+
+#+(and sb-thread (not sb-safepoint))
+(with-test (:name :gc-stop-offenders)
+  (let* ((stop nil)
+         (thread (sb-thread:make-thread
+                  (lambda () (loop until stop do (sb-thread:thread-yield))))))
+    (gc)
+    (setq stop t)
+    (sb-thread:join-thread thread)
+    (let ((offenders (sb-ext:gc-stop-offenders)))
+      (assert offenders)
+      (assert (apply #'>= (mapcar #'first offenders)))
+      (assert (every (lambda (x) (plusp (third x))) offenders)))))
+
+#+(and gencgc (or x86 x86-64))
+(with-test (:name :incremental-stack-scan)
+  ;; Objects referenced only from deep, unchanging frames must stay pinned
+  ;; when those frames are skipped using the previous GC's snapshot
+  (setf (extern-alien "gencgc_incremental_stack_scan" int) 1)
+  (unwind-protect
+       (labels ((recurse (n)
+                  (if (zerop n)
+                      (dotimes (i 5 t) (gc) (make-list 1000))
+                      (let ((x (list n (make-array 3 :initial-element n))))
+                        (prog1 (recurse (1- n))
+                          (assert (= (first x) n))
+                          (assert (every (lambda (e) (eql e n)) (second x))))))))
+         (assert (recurse 200)))
+    (setf (extern-alien "gencgc_incremental_stack_scan" int) 0)))
+
+#+gencgc
+(with-test (:name :large-eq-table-cardwise-rehash)
+  ;; A large old EQ table is scanned only where it was written to.
+  ;; Keys that move must still cause the table to be rehashed
+  (let ((table (make-hash-table :test 'eq))
+        (keys (make-array 20000)))
+    (dotimes (i 20000)
+      (let ((key (list i)))
+        (setf (aref keys i) key (gethash key table) i)))
+    (gc :gen 1)
+    (loop for i from 0 below 20000 by 97
+          do (let ((key (list i)))
+               (remhash (aref keys i) table)
+               (setf (aref keys i) key (gethash key table) i)))
+    (gc)
+    (dotimes (i 20000)
+      (assert (eql (gethash (aref keys i) table) i)))))
+
+#+(and gencgc soft-card-marks)
+(with-test (:name :remembered-set)
+  ;; A few young objects referenced from an old list and vector have to
+  ;; survive collections that visit only the remembered slots
+  (setf (extern-alien "gencgc_remembered_set" int) 1)
+  (unwind-protect
+       (let ((list (make-list 10000))
+             (vector (make-array 100000 :initial-element nil)))
+         (gc :full t)
+         (loop for cell on list by (lambda (x) (nthcdr 100 x))
+               for i from 0
+               do (setf (car cell) (list i)))
+         (loop for i below 100000 by 1000
+               do (setf (svref vector i) (list i)))
+         (dotimes (i 5)
+           (gc)
+           (make-array 100000))
+         (loop for cell on list by (lambda (x) (nthcdr 100 x))
+               for i from 0
+               do (assert (equal (car cell) (list i))))
+         (loop for i below 100000 by 1000
+               do (assert (equal (svref vector i) (list i)))))
+    (setf (extern-alien "gencgc_remembered_set" int) 0)))
+
+#+gencgc
+(defun call-with-every-nth-pinned (list n fun)
+  (if list
+      (let ((cell list))
+        (sb-sys:with-pinned-objects (cell)
+          (call-with-every-nth-pinned (nthcdr n list) n fun)))
+      (funcall fun)))
+
+#+gencgc
+(with-test (:name :pin-inplace-threshold)
+  ;; When most of the nursery is pinned, the live conses of a list that
+  ;; share pages with pinned ones stay where they are
+  (setf (extern-alien "gencgc_pin_inplace_threshold" int) 50)
+  (unwind-protect
+       (progn
+         (gc)
+         (let* ((list (loop for i below 20000 collect (list i)))
+                (addresses (make-array 20000 :element-type 'sb-ext:word)))
+           (call-with-every-nth-pinned
+            list 64
+            (lambda ()
+              (loop for cell on list for i from 0
+                    do (setf (aref addresses i) (sb-kernel:get-lisp-obj-address cell)))
+              (gc)
+              (let ((moved (loop for cell on list for i from 0
+                                 count (/= (aref addresses i)
+                                           (sb-kernel:get-lisp-obj-address cell)))))
+                (assert (< moved 2000)))))
+           (gc)
+           (loop for x in list for i from 0
+                 do (assert (equal x (list i))))))
+    (setf (extern-alien "gencgc_pin_inplace_threshold" int) 0)))
+
+#+gencgc
+(defun call-with-elements-pinned (list fun)
+  (if list
+      (let ((object (car list)))
+        (sb-sys:with-pinned-objects (object)
+          (call-with-elements-pinned (cdr list) fun)))
+      (funcall fun)))
+
+#+gencgc
+(with-test (:name (sb-sys:with-pinned-objects :many-small-objects))
+  ;; Pinned small objects of several kinds stay put, including the ones
+  ;; that are pinned more than once
+  (let ((objects (loop for i below 3000
+                       collect (case (mod i 3)
+                                 (0 (make-array 8 :element-type '(unsigned-byte 8)))
+                                 (1 (list i))
+                                 (2 (make-string 3))))))
+    (call-with-elements-pinned
+     objects
+     (lambda ()
+       (call-with-elements-pinned
+        (loop for x in objects by #'cddddr collect x)
+        (lambda ()
+          (let ((addresses (mapcar #'sb-kernel:get-lisp-obj-address objects)))
+            (gc)
+            (assert (equal (mapcar #'sb-kernel:get-lisp-obj-address objects)
+                           addresses)))))))))
+
+#+(and gencgc sb-thread)
+(with-test (:name :concurrent-tlab-refill)
+  ;; Threads that refill their allocation regions from pages they have
+  ;; claimed keep what they allocated across GCs, heap walks, and exits
+  (flet ((work (n)
+           (let ((lists nil) (vectors nil))
+             (dotimes (i 2000)
+               (push (make-list 50 :initial-element n) lists)
+               (push (make-array 100 :initial-element n) vectors))
+             (and (every (lambda (l) (every (lambda (x) (eql x n)) l)) lists)
+                  (every (lambda (v) (every (lambda (x) (eql x n)) v)) vectors)))))
+    (let ((threads (loop for n below 8
+                         collect (let ((n n))
+                                   (sb-thread:make-thread (lambda () (work n)))))))
+      (dotimes (i 5)
+        (gc)
+        (sb-vm:map-allocated-objects (lambda (obj type size)
+                                       (declare (ignore obj type size)))
+                                     :dynamic))
+      (assert (every #'sb-thread:join-thread threads))
+      (gc :full t)
+      (assert (<= (sb-kernel:dynamic-usage) (sb-ext:dynamic-space-size))))))
+
+#+gencgc
+(defstruct census-thing a)
+#+gencgc
+(with-test (:name :gc-census)
+  (let ((things (loop repeat 5000 collect (make-census-thing))))
+    (setf (sb-vm:gc-census-enabled) t)
+    (unwind-protect (gc :full t)
+      (setf (sb-vm:gc-census-enabled) nil))
+    (multiple-value-bind (types classes) (sb-vm:gc-census :print nil)
+      (assert (>= (second (assoc 'cons types)) (length things)))
+      (let ((entry (assoc 'census-thing classes)))
+        (assert (>= (second entry) 5000))
+        (assert (>= (third entry)
+                    (* 5000 (sb-ext:primitive-object-size (first things)))))))
+    (assert (not (sb-vm:gc-census-enabled)))))
+
+#+gencgc
+(with-test (:name (sb-vm::type-breakdown :dynamic))
+  (let ((list (make-list 5000)))
+    (gc)
+    (let* ((breakdown (sb-vm::type-breakdown :dynamic))
+           (conses (find 'cons breakdown :key #'third))
+           (total 0))
+      (sb-vm:map-allocated-objects
+       (lambda (obj type size)
+         (declare (ignore obj type))
+         (incf total size))
+       :dynamic)
+      (assert (>= (second conses) (length list)))
+      ;; Only what was allocated in between differs
+      (assert (< (abs (- (reduce #'+ breakdown :key #'first) total))
+                 (* 1024 1024))))))
+
+(defstruct heap-dump-thing a)
+(with-test (:name :write-heap-dump :skipped-on (not :gencgc))
+  (let* ((list (list 1 2 3))
+         (thing (make-heap-dump-thing :a list))
+         (file (scratch-file-name "heap")))
+    (sb-sys:with-pinned-objects (thing list)
+      (let ((thing-address (logandc2 (sb-kernel:get-lisp-obj-address thing)
+                                     sb-vm:lowtag-mask))
+            (list-address (logandc2 (sb-kernel:get-lisp-obj-address list)
+                                    sb-vm:lowtag-mask))
+            (layouts (make-hash-table))
+            (thing-record nil)
+            (rootp nil))
+        (assert (eq (write-heap-dump file) file))
+        (with-open-file (s file :element-type '(unsigned-byte 8))
+          (labels ((u8 () (read-byte s))
+                   (uint ()
+                     (loop for shift from 0 by 7
+                           for byte = (u8)
+                           sum (ash (ldb (byte 7 0) byte) shift)
+                           while (logbitp 7 byte)))
+                   (name ()
+                     (let ((octets (make-array (uint) :element-type '(unsigned-byte 8))))
+                       (read-sequence octets s)
+                       (sb-ext:octets-to-string octets :external-format :utf-8))))
+            (let ((magic (make-array 8 :element-type '(unsigned-byte 8))))
+              (read-sequence magic s)
+              (assert (string= (map 'string #'code-char magic) "SBCLHEAP")))
+            (assert (= (u8) 1))
+            (assert (= (u8) sb-vm:n-word-bytes))
+            (u8) (u8)
+            (loop
+              (ecase (u8)
+                (0 (return))
+                (1 (let* ((address (uint))
+                          (widetag (u8))
+                          (generation (u8))
+                          (nbytes (uint))
+                          (layout (uint))
+                          (refs (loop for ref = (uint)
+                                      until (zerop ref)
+                                      collect (let ((z (1- ref)))
+                                                (+ address
+                                                   (* sb-vm:n-word-bytes
+                                                      (if (evenp z)
+                                                          (ash z -1)
+                                                          (- (ash (1+ z) -1)))))))))
+                     (declare (ignore generation))
+                     (when (= address thing-address)
+                       (setq thing-record (list widetag nbytes layout refs)))))
+                (2 (u8) (name))
+                (3 (let ((address (uint)))
+                     (setf (gethash address layouts) (name))))
+                (4 (uint) (uint))
+                (5 (u8) (uint)
+                   (when (= (uint) thing-address) (setq rootp t)))))))
+        (delete-file file)
+        (destructuring-bind (widetag nbytes layout refs) thing-record
+          (assert (= widetag sb-vm:instance-widetag))
+          (assert (= nbytes (sb-ext:primitive-object-size thing)))
+          (assert (string= (gethash layout layouts) "HEAP-DUMP-THING"))
+          (assert (member list-address refs)))
+        ;; WITH-PINNED-OBJECTS keeps THING itself on the stack
+        #+(or x86 x86-64) (assert rootp)))))
+
+(with-test (:name (sb-ext:with-arena :roots-and-destruction) :skipped-on (not :gencgc))
+  (let* ((arena (sb-ext:make-arena))
+         (list (sb-ext:with-arena (arena)
+                 (let ((list (loop for i below 10000
+                                   collect (make-array 3 :initial-element i))))
+                   ;; A heap object that only the arena refers to
+                   (push (sb-ext:with-arena (nil) (make-string 10 :initial-element #\a))
+                         list)
+                   list))))
+    (assert (not (sb-ext:heap-allocated-p list)))
+    (assert (sb-ext:heap-allocated-p (car list)))
+    (gc)
+    (gc :full t)
+    (assert (string= (car list) "aaaaaaaaaa"))
+    (assert (= (aref (car (last list)) 0) 9999))
+    (assert-error (sb-ext:with-arena (arena) (sb-ext:destroy-arena arena)))
+    (setq list nil)
+    (sb-ext:destroy-arena arena)
+    (assert-error (sb-ext:destroy-arena arena))
+    (assert-error (sb-ext:with-arena (arena) (cons 1 2)))))
+
+(with-test (:name (sb-ext:soft-heap-limit sb-ext:*memory-pressure-hooks*)
+            :skipped-on (not :gencgc))
+  (let ((old (sb-ext:soft-heap-limit))
+        (called nil))
+    (unwind-protect
+         (progn
+           (setf (sb-ext:soft-heap-limit) (* 1024 1024))
+           (assert (= (sb-ext:soft-heap-limit) (* 1024 1024)))
+           (push (lambda () (setq called t)) sb-ext:*memory-pressure-hooks*)
+           (gc)
+           (assert called)
+           (setq called nil)
+           (setf (sb-ext:soft-heap-limit) nil)
+           (gc)
+           (assert (not called)))
+      (setf (sb-ext:soft-heap-limit) old
+            sb-ext:*memory-pressure-hooks* nil))))
+
+(with-test (:name (sb-ext:rewind-arena :reuse) :skipped-on (not :gencgc))
+  (let* ((arena (sb-ext:make-arena))
+         (first (sb-kernel:get-lisp-obj-address
+                 (sb-ext:with-arena (arena) (make-array 100 :initial-element 1)))))
+    (sb-ext:with-arena (arena)
+      (loop repeat 100000 collect (cons 1 2)))
+    (assert-error (sb-ext:with-arena (arena) (sb-ext:rewind-arena arena)))
+    (sb-ext:rewind-arena arena)
+    (let ((vector (sb-ext:with-arena (arena) (make-array 100))))
+      (assert (= (sb-kernel:get-lisp-obj-address vector) first))
+      (assert (every #'zerop vector)))
+    (sb-ext:rewind-arena arena)
+    (sb-ext:destroy-arena arena)
+    (assert-error (sb-ext:rewind-arena arena))))
@@ -210,3 +210,93 @@
           (unwind-protect (sleep 2.5)
             (mapc #'terminate-thread threads))
           (assert (not *errors*)))))))
+
+;;; GETHASH on a synchronized table doesn't take the lock, so it must
+;;; never see a value stored under some other key, however the writers
+;;; reshuffle, grow and clear the table under it.
+(with-test (:name (hash-table :synchronized :lock-free-readers)
+            :broken-on :win32)
+  (dolist (test '(eq equal))
+    (let* ((*errors* nil)
+           (hash (make-hash-table :test test :synchronized t))
+           (keys (coerce (loop for i below 1000
+                               collect (if (eq test 'eq)
+                                           (cons i i)
+                                           (format nil "key~D" i)))
+                         'vector)))
+      (flet ((reader ()
+               (catch 'done
+                 (handler-bind ((serious-condition 'oops))
+                   (loop
+                     (let* ((i (random 1000))
+                            (x (gethash (aref keys i) hash)))
+                       (assert (or (not x) (eql x i))))))))
+             (writer ()
+               (catch 'done
+                 (handler-bind ((serious-condition 'oops))
+                   (loop
+                     (loop repeat 1000
+                           do (let ((i (random 1000)))
+                                (if (zerop (random 2))
+                                    (setf (gethash (aref keys i) hash) i)
+                                    (remhash (aref keys i) hash))))
+                     (when (zerop (random 20))
+                       (clrhash hash)))))))
+        (let ((threads
+               (list (make-kill-thread #'reader :name "reader 1")
+                     (make-kill-thread #'reader :name "reader 2")
+                     (make-kill-thread #'reader :name "reader 3")
+                     (make-kill-thread #'writer :name "writer 1")
+                     (make-kill-thread #'writer :name "writer 2")
+                     (make-kill-thread
+                      (lambda ()
+                        (catch 'done
+                          (handler-bind ((serious-condition 'oops))
+                            (loop (sleep (random *sleep-delay-max*))
+                                  (sb-ext:gc)))))
+                      :name "collector"))))
+          (unwind-protect (sleep 2.5)
+            (mapc #'terminate-thread threads))
+          (assert (not *errors*)))))))
+
+;;; The same for weak tables, whose pairs GC also culls under the readers.
+(with-test (:name (hash-table :weak :lock-free-readers)
+            :broken-on :win32)
+  (let* ((*errors* nil)
+         (hash (make-hash-table :test 'eq :weakness :key))
+         (keys (coerce (loop for i below 1000 collect (cons i i)) 'vector)))
+    (flet ((reader ()
+             (catch 'done
+               (handler-bind ((serious-condition 'oops))
+                 (loop
+                   (let* ((i (random 1000))
+                          (x (gethash (aref keys i) hash)))
+                     (assert (or (not x) (eql x i))))))))
+           (writer ()
+             (catch 'done
+               (handler-bind ((serious-condition 'oops))
+                 (loop
+                   (loop repeat 1000
+                         do (let ((i (random 1000)))
+                              (case (random 3)
+                                (0 (setf (gethash (aref keys i) hash) i))
+                                (1 (remhash (aref keys i) hash))
+                                ;; garbage for GC to cull
+                                (2 (setf (gethash (list i) hash) -1)))))
+                   (when (zerop (random 20))
+                     (clrhash hash)))))))
+      (let ((threads
+             (list (make-kill-thread #'reader :name "reader 1")
+                   (make-kill-thread #'reader :name "reader 2")
+                   (make-kill-thread #'reader :name "reader 3")
+                   (make-kill-thread #'writer :name "writer")
+                   (make-kill-thread
+                    (lambda ()
+                      (catch 'done
+                        (handler-bind ((serious-condition 'oops))
+                          (loop (sleep (random *sleep-delay-max*))
+                                (sb-ext:gc)))))
+                    :name "collector"))))
+        (unwind-protect (sleep 2.5)
+          (mapc #'terminate-thread threads))
+        (assert (not *errors*))))))
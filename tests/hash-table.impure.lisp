@@ -110,6 +110,30 @@
     (assert (= (vector-flag-bits (sb-impl::hash-table-pairs h))
                sb-vm:vector-hashing-flag))))
 
+(with-test (:name (hash-table :incremental-growth))
+  (dolist (test '(eq eql equal))
+    (let* ((h (make-hash-table :test test))
+           (keys (make-array 200000))
+           (saw-unsplit nil))
+      (dotimes (i (length keys))
+        (let ((key (if (evenp i) i (list i))))
+          (setf (aref keys i) key
+                (gethash key h) i))
+        (when (plusp (sb-impl::hash-table-unsplit-buckets h))
+          (unless saw-unsplit
+            ;; Move the address-hashed keys while some buckets are unsplit
+            (gc)
+            (dotimes (j (1+ i))
+              (assert (eql (gethash (aref keys j) h) j))))
+          (setq saw-unsplit t)))
+      (assert saw-unsplit)
+      (loop for i from 0 below (length keys) by 3
+            do (assert (remhash (aref keys i) h)))
+      (gc)
+      (dotimes (i (length keys))
+        (assert (eql (gethash (aref keys i) h)
+                     (if (zerop (mod i 3)) nil i)))))))
+
 (defmacro kv-vector-needs-rehash (x) `(svref ,x 1))
 ;;; EQL tables no longer get a hash vector, so the GC has to decide
 ;;; for itself whether key movement forces rehash.
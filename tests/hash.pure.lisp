@@ -216,6 +216,19 @@
     (let ((data (sb-kernel:get-header-data (sb-impl::hash-table-pairs tbl))))
       (assert (not (logtest data sb-vm:vector-addr-hashing-flag))))))
 
+(with-test (:name :eq-hash-stable-across-gc)
+  (let ((tbl (make-hash-table :test 'eq))
+        (keys (append (loop repeat 1000 collect (make-broadcast-stream))
+                      (loop repeat 1000 collect (gensym)))))
+    (loop for key in keys for i from 0 do (setf (gethash key tbl) i))
+    (let ((pairs (sb-impl::hash-table-pairs tbl)))
+      (assert (not (logtest (sb-kernel:get-header-data pairs)
+                            sb-vm:vector-addr-hashing-flag)))
+      (sb-ext:gc :full t)
+      ;; The rehash bit of the stamp is clear
+      (assert (evenp (svref pairs 1))))
+    (loop for key in keys for i from 0 do (assert (eql (gethash key tbl) i)))))
+
 (with-test (:name (hash-table :small-rehash-size))
   (let ((ht (make-hash-table :rehash-size 2)))
     (dotimes (i 100)
@@ -228,9 +241,12 @@
   (flet ((kv-flag-bits (ht)
            (ash (sb-kernel:get-header-data (sb-impl::hash-table-pairs ht))
                 (- sb-vm:array-flags-data-position))))
-    ;; verify that EQ hashing on symbols is address-sensitive
+    ;; verify that EQ hashing on symbols is not address-sensitive,
+    ;; but on conses it is
     (let ((h (make-hash-table :test 'eq)))
       (setf (gethash 'foo h) 1)
+      (assert (not (logtest (kv-flag-bits h) sb-vm:vector-addr-hashing-flag)))
+      (setf (gethash (list 'foo) h) 1)
       (assert (logtest (kv-flag-bits h) sb-vm:vector-addr-hashing-flag)))
     (let ((h (make-hash-table :test 'eq :hash-function 'sb-kernel:symbol-hash)))
       (setf (gethash 'foo h) 1)
@@ -404,6 +420,21 @@
     ;; Also the same issue exists with bit-vectors.
     (assert-error (sxhash displaced-string))))
 
+(with-test (:name (sxhash string :word-at-a-time))
+  ;; Exercise every tail length, and check that the hash depends only
+  ;; on the characters: not on the element type, not on the position
+  ;; of a substring.
+  (let ((text "The quick brown fox jumps over the lazy dog"))
+    (loop for length from 0 to (length text)
+          for base = (coerce (subseq text 0 length) 'simple-base-string)
+          for wide = (coerce base '(simple-array character (*)))
+          for displaced = (make-array length :element-type 'character
+                                             :displaced-to (concatenate 'string "xyz" wide)
+                                             :displaced-index-offset 3)
+          do (assert (= (sxhash base) (sxhash wide) (sxhash displaced)))))
+  (assert (/= (sxhash "ab") (sxhash "ba")))
+  (assert (/= (sxhash "a") (sxhash (coerce '(#\a #\Nul) 'string)))))
+
 (with-test (:name :array-psxhash-non-consing :skipped-on :interpreter)
    (let ((a (make-array 1000 :element-type 'double-float)))
      (ctu:assert-no-consing (sb-int:psxhash a))))
@@ -73,6 +73,29 @@
              lisp-ht)
     lisp-ht))
 
+(defun check-get-many (table lisp-ht)
+  ;; Batched lookup of every key plus one absent key must agree with LISP-HT
+  (let* ((n (1+ (hash-table-count lisp-ht)))
+         (keys (make-alien unsigned-long n))
+         (values (make-alien long n))
+         (i 0))
+    (maphash (lambda (k v) (declare (ignore v))
+               (setf (deref keys i) k) (incf i))
+             lisp-ht)
+    (setf (deref keys i) (ash (1+ (ash 1 20)) sb-vm:n-lowtag-bits))
+    (alien-funcall (extern-alien "hopscotch_get_many"
+                                 (function void system-area-pointer (* unsigned-long)
+                                           int (* long) long))
+                   table keys n values -1)
+    (dotimes (i n)
+      (let ((result (deref values i)))
+        (assert (eq (unless (eql result -1)
+                      (sb-kernel:make-lisp-obj
+                       (logand result sb-ext:most-positive-word)))
+                    (gethash (deref keys i) lisp-ht)))))
+    (free-alien keys)
+    (free-alien values)))
+
 (defun randomly-bang-on-table (sizeof-value &optional (n-iter 10))
   (setq *random-state* (sb-ext:seed-random-state t))
   (dotimes (i n-iter)
@@ -98,6 +121,7 @@
            (loop for i from 1 to (ash 1 15)
                  do (assert (eq (hhget c-table i)
                                 (gethash i lisp-table))))
+           (check-get-many c-table lisp-table)
            ;; If statistics collection is enabled, show the performance
            (alien-funcall (extern-alien "hopscotch_log_stats"
                                         (function void system-area-pointer))
@@ -110,3 +134,34 @@
   ;; Try for values[] array being int16 and int32
   (dolist (sizeof-value '(2 4))
     (randomly-bang-on-table sizeof-value 1)))
+
+#+sb-thread
+(with-test (:name :hopscotch-striped)
+  ;; Several threads insert the same keys at once: each key must be
+  ;; inserted by exactly one of them
+  (let* ((mem (sb-alien::%make-alien 5000)) ; overestimate the C structure size
+         ;; the stripes are aligned to cache lines
+         (table (sb-sys:int-sap (logandc2 (+ (sb-sys:sap-int mem) 63) 63)))
+         (n-keys 20000))
+    (sb-sys:without-gcing
+      (alien-funcall (extern-alien "hopscotch_striped_create"
+                                   (function void system-area-pointer int int int int))
+                     table 1 0 64 0))
+    (flet ((insert-all ()
+             (sb-sys:without-gcing
+               (loop for i from 1 to n-keys
+                     sum (alien-funcall
+                          (extern-alien "hopscotch_striped_insert"
+                                        (function int system-area-pointer
+                                                  unsigned-long long))
+                          table (ash i sb-vm:n-lowtag-bits) 0)))))
+      (let ((threads (loop repeat 4 collect (sb-thread:make-thread #'insert-all))))
+        (assert (= (reduce #'+ (mapcar #'sb-thread:join-thread threads)) n-keys))))
+    (assert (= (alien-funcall (extern-alien "hopscotch_striped_count"
+                                            (function int system-area-pointer))
+                              table)
+               n-keys))
+    (sb-sys:without-gcing
+      (alien-funcall (extern-alien "hopscotch_striped_destroy"
+                                   (function void system-area-pointer))
+                     table))))
@@ -57,3 +57,41 @@
 (print things)
 (setf (trythis-a (car things)) "anewstring")
 (gc)
+
+;;; Code that became garbage leaves holes for new code to reuse
+#+immobile-code
+(progn
+  (defun compile-some (n)
+    (loop for i below n
+          collect (compile nil `(lambda (x) (list x ,@(make-list (mod i 40) :initial-element i))))))
+  (defun varyobj-free-ptr ()
+    (sb-sys:sap-int sb-vm::*varyobj-space-free-pointer*))
+  (gc :full t)
+  (let* ((start (varyobj-free-ptr))
+         (growth (progn (compile-some 300) (gc :full t) (- (varyobj-free-ptr) start))))
+    (dotimes (i 5)
+      (let ((funs (compile-some 300)))
+        (assert (equal (funcall (first funs) 1) '(1)))
+        (assert (equal (funcall (second funs) 2) '(2 1))))
+      (gc :full t))
+    ;; Without reuse, this would be at least 5 times GROWTH
+    (assert (< (- (varyobj-free-ptr) start) (* 3 (max growth 65536))))))
+
+;;; Threads allocating fixed-size objects at the same time each get
+;;; their own page, and must never be handed the same cell
+#+sb-thread
+(let* ((threads
+        (loop for i below 8
+              collect (sb-thread:make-thread
+                       (lambda (i)
+                         (loop for j below 20000
+                               collect (sb-vm::make-immobile-symbol (format nil "S~D-~D" i j))
+                               when (zerop (mod j 5000)) do (gc)))
+                       :arguments i)))
+       (symbols (mapcan #'sb-thread:join-thread threads))
+       (seen (make-hash-table :test 'eq)))
+  (dolist (symbol symbols)
+    (assert (not (gethash symbol seen)))
+    (setf (gethash symbol seen) t)
+    (assert (char= (char (symbol-name symbol) 0) #\S)))
+  (assert (= (hash-table-count seen) (* 8 20000))))
@@ -443,6 +443,30 @@
     (assert (not (string= (get-output-stream-string s) "")))
     (delete-file *tmp-filename*)))
 
+(defvar *loaded-base-strings*)
+(defvar *loaded-symbol*)
+;; Base-strings and symbol names are read straight out of the stream buffer,
+;; so try lengths on either side of the size of that buffer.
+(with-test (:name (load :base-strings))
+  (let ((strings (loop for n in '(0 1 7 500 511 512 513 4000 70000)
+                       collect (let ((s (make-string n :element-type 'base-char)))
+                                 (dotimes (i n s)
+                                   (setf (char s i) (code-char (+ 32 (mod i 95))))))))
+        (name (make-string 3000 :initial-element #\Q)))
+    (with-open-file (stream *tmp-filename*
+                            :direction :output :if-exists :supersede)
+      (let ((*print-readably* nil) (*print-pretty* nil))
+        (format stream "(setq *loaded-base-strings* (list ~{#.(coerce ~S 'base-string)~^ ~}))~%"
+                strings)
+        (format stream "(setq *loaded-symbol* '#:~A)~%" name)))
+    (let ((output (compile-file *tmp-filename*)))
+      (load output)
+      (delete-file output))
+    (delete-file *tmp-filename*)
+    (assert (every (lambda (x) (typep x 'simple-base-string)) *loaded-base-strings*))
+    (assert (equal *loaded-base-strings* strings))
+    (assert (string= (symbol-name *loaded-symbol*) name))))
+
 (with-test (:name :load-reader-error)
   (unwind-protect
        (block result
@@ -463,3 +487,23 @@
   ;; uses this internal macro and that we should endeavor not to break the syntax.
   (macroexpand '(sb-c:do-forms-from-info
                  ((myform myindex) my-source-info) (something))))
+
+(with-test (:name (load-files :in-order))
+  (with-scratch-file (file1 "lisp")
+    (with-scratch-file (file2 "lisp")
+      (with-open-file (stream file1 :direction :output :if-exists :supersede)
+        (write-string "(defpackage \"LOAD-FILES-TEST\" (:use \"CL\"))
+(in-package \"LOAD-FILES-TEST\")
+(defun f () 'first)" stream))
+      (with-open-file (stream file2 :direction :output :if-exists :supersede)
+        (write-string "(in-package \"LOAD-FILES-TEST\")
+(defun g () (list (f) 'second))" stream))
+      (let ((fasls (list (compile-file file1) (compile-file file2))))
+        (unwind-protect
+             (progn
+               (delete-package "LOAD-FILES-TEST")
+               (assert (eq (load-files fasls :threads 2) t))
+               (assert (equal (funcall (find-symbol "G" "LOAD-FILES-TEST"))
+                              (list (find-symbol "FIRST" "LOAD-FILES-TEST")
+                                    (find-symbol "SECOND" "LOAD-FILES-TEST")))))
+          (mapc #'delete-file fasls))))))
@@ -36,4 +36,16 @@ chmod u+x "$tmpcore"
 ./"$tmpcore" --no-userinit --no-sysinit
 check_status_maybe_lose "SAVE-LISP-AND-DIE :EXECUTABLE-COMPRESS" $? 0 "(executable compressed saved core ran)"
 
+if [ -n "`run_sbcl --eval '(progn #+sb-core-zstd (princ :yes))' --quit`" ]
+then
+  rm "$tmpcore"
+  run_sbcl <<EOF
+    (save-lisp-and-die "$tmpcore" :toplevel (lambda () 42)
+                       :compression '(:zstd 5))
+EOF
+  run_sbcl_with_core "$tmpcore" --noinform --no-userinit --no-sysinit \
+      --eval "(setf sb-ext:*evaluator-mode* :${TEST_SBCL_EVALUATOR_MODE:-compile})"
+  check_status_maybe_lose "SAVE-LISP-AND-DIE :COMPRESSION :ZSTD" $? 0 "(zstd saved core ran)"
+fi
+
 exit $EXIT_TEST_WIN
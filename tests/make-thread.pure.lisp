@@ -160,3 +160,16 @@
                (without-gcing
                    (make-thread (lambda () 'hi))))
               'hi)))
+
+#+pauseless-threadstart
+(test-util:with-test (:name :thread-struct-pool)
+  (flet ((hits () (extern-alien "thread_struct_pool_hits" unsigned-long)))
+    (let ((hits (hits)))
+      ;; A thread's memory goes back to the pool only once it is pthread_joined,
+      ;; which happens lazily when the next thread is made. Give each thread
+      ;; a moment to finish exiting so that its successor can reuse it.
+      (loop repeat 100
+            do (join-thread (make-thread (lambda () 'hi)))
+               (sleep .01)
+            until (> (hits) hits))
+      (assert (> (hits) hits)))))
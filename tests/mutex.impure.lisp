@@ -37,3 +37,26 @@
     (process-all-interrupts child)
     (terminate-thread child)
     (wait-for-threads (list child))))
+
+(defun wait-for-held-mutex (mutex)
+  (with-mutex (mutex) t))
+
+(with-test (:name (:mutex :contention-profiling))
+  (let ((mutex (make-mutex :name "profiled"))
+        (sem (make-semaphore)))
+    (start-mutex-contention-profiling)
+    (let ((holder (make-thread (lambda ()
+                                 (with-mutex (mutex)
+                                   (signal-semaphore sem)
+                                   (sleep .2))))))
+      (wait-on-semaphore sem)
+      (wait-for-held-mutex mutex)
+      (join-thread holder))
+    (let ((row (find mutex (stop-mutex-contention-profiling) :key #'first)))
+      (assert row)
+      (destructuring-bind (waiter count usec) (cdr row)
+        (assert (eq waiter 'wait-for-held-mutex))
+        (assert (= count 1))
+        (assert (>= usec 100000))))
+    ;; Recording has stopped
+    (assert (null (sb-thread:report-mutex-contention :stream nil)))))
@@ -422,3 +422,34 @@
         (assert (string= b1 b2))
         ;; COMPILE-FILE-POSITION is insensitive to file encoding.
         (assert (string= c1 c2))))))
+
+;;; The ASCII fast paths work a word at a time, so try a non-ASCII
+;;; character at many offsets and alignments.
+(with-test (:name (:utf-8 :ascii-runs) :skipped-on (not :sb-unicode))
+  (dolist (odd (list (code-char #xe9) (code-char #x20ac) (code-char #x1f600)))
+    (loop for length from 0 to 40
+          do (loop for where from -1 below length
+                   for string = (let ((s (make-string length :initial-element #\a)))
+                                  (when (>= where 0)
+                                    (setf (char s where) odd))
+                                  s)
+                   for octets = (string-to-octets string :external-format :utf-8)
+                   do (assert (= (length octets)
+                                 (+ length (if (>= where 0)
+                                               (1- (length (string-to-octets
+                                                            (string odd)
+                                                            :external-format :utf-8)))
+                                               0))))
+                      ;; starting inside a character is a decoding error
+                      (handler-bind ((sb-int:character-decoding-error
+                                       (lambda (c) (use-value #\? c))))
+                        (dotimes (start 9)
+                          (when (<= start (length octets))
+                            (let ((decoded (octets-to-string octets :external-format :utf-8
+                                                                    :start start)))
+                              (assert (string= decoded
+                                               (octets-to-string
+                                                (subseq octets start)
+                                                :external-format :utf-8)))
+                              (when (zerop start)
+                                (assert (string= decoded string)))))))))))
@@ -942,6 +942,39 @@ if a restart was invoked."
              (if (eq old actual-old) (return))
              (setq old actual-old))))))))
 
+;; Changing the use list of a package must not make its other inherited
+;; symbols transiently inaccessible to concurrent FIND-SYMBOL.
+(with-test (:name :concurrent-find-symbol-inherited :skipped-on (not :sb-thread))
+  (let* ((base (make-package (gensym "BASE") :use nil))
+         (other (make-package (gensym "OTHER") :use nil))
+         (pkg (make-package (gensym) :use (list base)))
+         (names (loop for i below 50
+                      collect (let ((name (string (gensym "INHERITED"))))
+                                (export (intern name base) base)
+                                name)))
+         (run nil)
+         (done nil)
+         (threads
+           (loop repeat 4
+                 collect (sb-thread:make-thread
+                          (lambda ()
+                            (wait-for run)
+                            (let ((n-missing 0))
+                              (loop until done
+                                    do (dolist (name names)
+                                         (unless (eq (nth-value 1 (find-symbol name pkg))
+                                                     :inherited)
+                                           (incf n-missing))))
+                              n-missing))))))
+    (export (intern "OTHER-SYMBOL" other) other)
+    (setq run t)
+    (unwind-protect
+         (dotimes (i 2000)
+           (use-package other pkg)
+           (unuse-package other pkg))
+      (setq done t))
+    (assert (zerop (reduce #'+ (mapcar #'sb-thread:join-thread threads))))))
+
 ;; This test would consistently fail when GENTEMP first called FIND-SYMBOL
 ;; and then INTERN when FIND-SYMBOL said that it found no symbol.
 (with-test (:name (gentemp :threadsafety) :skipped-on (not :sb-thread))
@@ -0,0 +1,40 @@
+#!/bin/sh
+
+# This software is part of the SBCL system. See the README file for
+# more information.
+#
+# While most of SBCL is derived from the CMU CL system, the test
+# files (like this one) were written from scratch after the fork
+# from CMU CL.
+#
+# This software is in the public domain and is provided with
+# absolutely no warranty. See the COPYING and CREDITS files for
+# more information.
+
+. ./subr.sh
+
+# The map written by --perf-map has to name a freshly compiled function
+# at its address after a full GC, which normally moves it.
+run_sbcl_with_args --perf-map --noinform --no-sysinit --no-userinit \
+    --disable-debugger --non-interactive --eval '
+(progn
+  #-(and linux gencgc) (exit :code 52)
+  (defun perf-map-test-function (x) (1+ x))
+  (gc :full t)
+  (let* ((file (format nil "/tmp/perf-~D.map" (sb-unix:unix-getpid)))
+         (code (sb-kernel:fun-code-header #'\''perf-map-test-function))
+         (start (sb-sys:sap-int (sb-kernel:code-instructions code)))
+         (end (+ start (sb-kernel:%code-text-size code)))
+         (found nil))
+    (with-open-file (s file)
+      (loop for line = (read-line s nil) while line
+            when (search "CL-USER::PERF-MAP-TEST-FUNCTION" line)
+            do (let ((addr (parse-integer line :end (position #\space line)
+                                               :radix 16)))
+                 (when (and (<= start addr) (< addr end))
+                   (setq found t)))))
+    (delete-file file)
+    (exit :code (if found 52 1))))'
+check_status_maybe_lose "perf map names moved code" $?
+
+exit $EXIT_TEST_WIN
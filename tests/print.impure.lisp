@@ -645,6 +645,50 @@
                        (list f (read-from-string (prin1-to-string f))))
                      oops)))))
 
+;;; The digits of the shortest path without bignums are those of the
+;;; general algorithm, including where two are equally near, around
+;;; powers of two, and for subnormals, which keep all their digits.
+(with-test (:name (print float :shortest-digits))
+  (loop for (float k digits)
+          in `((0.1 0 "1")
+               (,most-positive-single-float 39 "34028235")
+               (,least-positive-normalized-single-float -37 "11754944")
+               (16777218.0 8 "16777218")
+               (0.1d0 0 "1")
+               (1d23 24 "1")
+               (,(/ 1d0 3) 0 "3333333333333333")
+               (,most-positive-double-float 309 "17976931348623157")
+               (,least-positive-normalized-double-float -307 "22250738585072014")
+               (,least-positive-double-float -323 "49406564584124654")
+               (,(scale-float 6398023135427354d0 -3) 15 "7997528919284193"))
+        do (assert (equal (multiple-value-list (sb-impl::flonum-to-digits float))
+                          (list k digits)))))
+
+;;; Reading gives the float nearest to the decimal, however it is found
+(with-test (:name (read float :nearest))
+  (let ((*read-default-float-format* 'double-float))
+    (assert (eql (read-from-string "9007199254740993") 9007199254740992))
+    (assert (eql (read-from-string "9007199254740993.0") 9007199254740992d0))
+    (assert (eql (read-from-string "9007199254740995.0") 9007199254740996d0))
+    (assert (eql (read-from-string "2.2250738585072014d-308")
+                 least-positive-normalized-double-float))
+    (assert (eql (read-from-string "1.7976931348623157d308")
+                 most-positive-double-float))
+    (assert (eql (read-from-string "4.9406564584124654d-324")
+                 least-positive-double-float))
+    (assert (eql (read-from-string "-1.5") -1.5d0))
+    (assert (eql (read-from-string "123456789012345678901234567890.0")
+                 1.2345678901234568d29)))
+  (let ((*random-state* (make-random-state t)))
+    (loop repeat 20000
+          do (let ((w (random (ash 1 64)))
+                   (q (- (random 581) 300)))
+               (assert (eql (read-from-string (format nil "~Dd~D" w q))
+                            (coerce (* w (expt 10 q)) 'double-float)))
+               (when (<= -30 q 18)
+                 (assert (eql (read-from-string (format nil "~Df~D" w q))
+                              (coerce (* w (expt 10 q)) 'single-float))))))))
+
 (with-test (:name (format :bug-811386))
   (assert (equal "   0.00" (format nil "~7,2,-2f" 0)))
   (assert (equal "   0.00" (format nil "~7,2,2f" 0)))
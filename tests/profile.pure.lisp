@@ -105,3 +105,22 @@
                (sb-profile::incf-counter c n)
                (incf i n)))
     (assert (= i (sb-profile::counter-count c)))))
+
+(defun profiled-leaf (x) (1+ x))
+
+(with-test (:name (profile :threads :calls-add-up)
+                  :skipped-on (not :sb-thread)
+                  :broken-on :win32)
+  (profile profiled-leaf)
+  (unwind-protect
+       (let ((threads (loop repeat 8
+                            collect (make-thread
+                                     (lambda ()
+                                       (dotimes (i 10000)
+                                         (profiled-leaf i)))))))
+         (mapc #'join-thread threads)
+         (let ((info (gethash 'profiled-leaf
+                              sb-profile::*profiled-fun-name->info*)))
+           (assert (= (funcall (sb-profile::profile-info-read-stats-fun info))
+                      80000))))
+    (unprofile profiled-leaf)))
@@ -331,6 +331,28 @@
     (let ((foo (read-from-string "#[a b c]")))
       (assert (equal foo '(:start a b c :end))))))
 
+;;; Symbols whose plain constituents are taken from the buffer of an
+;;; FD-STREAM at once, across refills of the buffer
+(with-test (:name (read fd-stream :constituent-run))
+  (let ((pathname (scratch-file-name "lisp"))
+        (symbols (loop for length from 1 to 1100 by 7
+                       collect (intern (make-string length :initial-element #\Z)
+                                       "KEYWORD"))))
+    (unwind-protect
+         (progn
+           (with-open-file (stream pathname :direction :output
+                                            :if-exists :supersede)
+             (with-standard-io-syntax
+               (dolist (symbol symbols)
+                 (prin1 symbol stream)
+                 (write-char #\Space stream))))
+           (with-open-file (stream pathname)
+             (assert (equal (loop for symbol = (read stream nil stream)
+                                  until (eq symbol stream)
+                                  collect symbol)
+                            symbols))))
+      (delete-file pathname))))
+
 ;;; THIS SHOULD BE LAST as it frobs the standard readtable
 (with-test (:name :set-macro-character-nil)
   (handler-bind ((sb-int:standard-readtable-modified-error #'continue))
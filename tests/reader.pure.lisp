@@ -599,3 +599,19 @@
       (assert-read-eqlity "0.333R0" 333/1000)
       (assert-read-eqlity "1R-3" 1/1000)
       (assert-read-eqlity ".1R2" 10))))
+
+;;; Symbols whose plain constituents are taken from the string at once
+(with-test (:name (read :string-input-stream :constituent-run))
+  (let ((long (make-string 1000 :initial-element #\A)))
+    (with-input-from-string (stream (format nil "(:abc-def cl:car cl-user::x\\yz ~
+                                                 :ab|cD|ef :~A 1+)x"
+                                            long))
+      (assert (equal (read stream)
+                     (list :abc-def 'car 'cl-user::|XyZ| :|ABcDEF|
+                           (intern long "KEYWORD") '1+)))
+      (assert (char= (read-char stream) #\x)))
+    (assert (equal (multiple-value-list (read-from-string ":foo-bar baz"))
+                   '(:foo-bar 9)))
+    (let ((*readtable* (copy-readtable)))
+      (setf (readtable-case *readtable*) :preserve)
+      (assert (eq (read-from-string ":MixedCase") :|MixedCase|)))))
@@ -34,6 +34,35 @@ do
               --eval '(gc :full t)' --quit
 done
 
+# A core saved by SAVE-LISP-AND-DIE has a relocation map, so relocation
+# skips the pages that need no adjustment. Mix pages of unboxed data with
+# pages that point to them, and check that everything was adjusted.
+tmpcore=$TEST_FILESTEM.core
+run_sbcl <<EOF
+  (defvar *strings* (loop repeat 2000 collect (make-string 100 :initial-element #\x)))
+  (defvar *octets* (make-array 1000000 :element-type '(unsigned-byte 8) :initial-element 7))
+  (defvar *conses* (loop for i below 100000 collect (cons i (elt *strings* (mod i 2000)))))
+  (defvar *table* (let ((h (make-hash-table :test 'eq)))
+                    (dolist (s *strings* h) (setf (gethash s h) s))))
+  (save-lisp-and-die "$tmpcore")
+EOF
+i=1
+while [ $i -le 3 ]
+do
+  echo Saved core trial $i
+  i=`expr $i + 1`
+  $test_sbcl --lose-on-corruption --disable-ldb --noinform --core "$tmpcore" \
+              --no-sysinit --no-userinit --noprint --disable-debugger \
+              --eval '(assert (every (lambda (s) (and (eq (gethash s *table*) s)
+                                                  (every (lambda (c) (char= c #\x)) s)))
+                                     *strings*))' \
+              --eval '(assert (loop for (i . s) in *conses*
+                                    always (eq s (elt *strings* (mod i 2000)))))' \
+              --eval '(assert (every (lambda (x) (= x 7)) *octets*))' \
+              --eval '(gc :full t)' --quit
+done
+rm -f "$tmpcore"
+
 rm -f $test_sbcl
 
 exit $EXIT_TEST_WIN
@@ -490,3 +490,15 @@
              (process (run-program "test" (list "-e" (format nil "/dev/fd/~a" fd))
                                    :search t)))
         (assert (not (zerop (process-exit-code process))))))))
+
+(with-test (:name (run-program :search :environment-path)
+            :skipped-on :win32)
+  (assert (string= (with-output-to-string (s)
+                     (run-program "sh" '("-c" "echo $FOO")
+                                  :search t :output s
+                                  :environment '("PATH=/nonexistent::/bin:/usr/bin"
+                                                 "FOO=found")))
+                   (format nil "found~%")))
+  (assert-error (run-program "sh" '("-c" "true")
+                             :search t
+                             :environment '("PATH=/nonexistent"))))
@@ -0,0 +1,83 @@
+# Don't try to run sbcl from /tmp on openbsd as it's unlikely to be
+# mounted with wxallowed
+if [ "$SBCL_SOFTWARE_TYPE" != OpenBSD ]; then
+    export TEST_BASEDIR=${TMPDIR:-/tmp}
+fi
+. ./subr.sh
+
+use_test_subdirectory
+
+tmpcore=$TEST_FILESTEM.core
+
+if [ -z "`run_sbcl --eval '(progn #+gencgc (princ :yes))' --quit`" ]
+then
+    exit $EXIT_TEST_WIN
+fi
+
+# Saving with gc_segregate_immutable_data changes the order in which the
+# final GC copies objects, but must not change what gets saved.
+run_sbcl <<EOF
+  (defun some-saved-function (x) (list x 'some-saved-symbol))
+  (defvar *names* (mapcar #'string '(some-saved-function some-saved-symbol)))
+  (setf (extern-alien "gc_segregate_immutable_data" char) 1)
+  (save-lisp-and-die "$tmpcore")
+EOF
+run_sbcl_with_core "$tmpcore" --noinform --no-userinit --no-sysinit --disable-debugger \
+    --eval '(assert (equal (some-saved-function 1) (list 1 (quote some-saved-symbol))))' \
+    --eval '(assert (equal *names* (list "SOME-SAVED-FUNCTION" "SOME-SAVED-SYMBOL")))' \
+    --eval '(assert (equal (sb-kernel:%simple-fun-arglist (function some-saved-function)) (quote (x))))' \
+    --eval '(gc :full t)' --quit
+check_status_maybe_lose "SAVE-LISP-AND-DIE gc_segregate_immutable_data" $? 0 "(saved core ran)"
+
+# Defragmentation of immobile space at save time is done in parallel
+# with --gc-threads
+run_sbcl_with_args --gc-threads 4 --noinform --no-userinit --no-sysinit --disable-debugger <<EOF
+  (defun some-saved-function (x) (list x 'old))
+  (compile 'some-saved-function)
+  (defun some-saved-function (x) (list x 'some-saved-symbol))
+  (compile 'some-saved-function)
+  (save-lisp-and-die "$tmpcore")
+EOF
+run_sbcl_with_core "$tmpcore" --noinform --no-userinit --no-sysinit --disable-debugger \
+    --eval '(assert (equal (some-saved-function 1) (list 1 (quote some-saved-symbol))))' \
+    --eval '(assert (string= (princ-to-string (quote car)) "CAR"))' \
+    --eval '(gc :full t)' --quit
+check_status_maybe_lose "SAVE-LISP-AND-DIE with --gc-threads" $? 0 "(saved core ran)"
+
+# Identical vectors of debug information are shared in the saved core
+run_sbcl <<EOF
+  (defun some-debug-fun-1 (x y) (if (car x) (list x y) (cons y x)))
+  (defun some-debug-fun-2 (x y) (if (car x) (list x y) (cons y x)))
+  (save-lisp-and-die "$tmpcore")
+EOF
+run_sbcl_with_core "$tmpcore" --noinform --no-userinit --no-sysinit --disable-debugger \
+    --eval '(flet ((debug-funs (f)
+                     (loop for df = (sb-c::compiled-debug-info-fun-map
+                                     (sb-kernel:%code-debug-info (sb-kernel:fun-code-header f)))
+                           then (sb-c::compiled-debug-fun-next df)
+                           while df collect df)))
+              (assert (every (lambda (a b)
+                               (and (eq (sb-c::compiled-debug-fun-vars a)
+                                        (sb-c::compiled-debug-fun-vars b))
+                                    (eq (sb-c::compiled-debug-fun-blocks a)
+                                        (sb-c::compiled-debug-fun-blocks b))))
+                             (debug-funs (function some-debug-fun-1))
+                             (debug-funs (function some-debug-fun-2)))))' \
+    --quit
+check_status_maybe_lose "SAVE-LISP-AND-DIE shares debug vectors" $? 0 "(saved core ran)"
+
+# A core saved with :COMPACT NIL, after only one collection, works the same
+run_sbcl <<EOF
+  (defun some-saved-function (x) (list x 'some-saved-symbol))
+  (defvar *some-saved-vector* (make-array 100000 :initial-element 'some-saved-symbol))
+  (save-lisp-and-die "$tmpcore" :compact nil)
+EOF
+run_sbcl_with_core "$tmpcore" --noinform --no-userinit --no-sysinit --disable-debugger \
+    --eval '(assert (equal (some-saved-function 1) (list 1 (quote some-saved-symbol))))' \
+    --eval '(assert (every (lambda (x) (eq x (quote some-saved-symbol))) *some-saved-vector*))' \
+    --eval '(gc :full t)' --quit
+check_status_maybe_lose "SAVE-LISP-AND-DIE :COMPACT NIL" $? 0 "(saved core ran)"
+
+rm -f "$tmpcore"
+
+exit $EXIT_TEST_WIN
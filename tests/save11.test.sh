@@ -0,0 +1,59 @@
+#!/bin/sh
+
+# tests related to SAVE-LISP-AND-DIE :TREE-SHAKE
+
+# This software is part of the SBCL system. See the README file for
+# more information.
+#
+# While most of SBCL is derived from the CMU CL system, the test
+# files (like this one) were written from scratch after the fork
+# from CMU CL.
+#
+# This software is in the public domain and is provided with
+# absolutely no warranty. See the COPYING and CREDITS files for
+# more information.
+
+. ./subr.sh
+
+use_test_subdirectory
+
+tmpcore=$TEST_FILESTEM.core
+
+# What only its package refers to goes away, and so do docstrings.
+run_sbcl <<EOF
+  (defpackage "SHAKE-TEST" (:use "CL"))
+  (in-package "SHAKE-TEST")
+  (defun kept (x) "Documented" (list x 'kept-symbol))
+  (defun dropped (x) (list x 'dropped-symbol))
+  (defun main ()
+    (sb-ext:exit :code (if (and (equal (kept 1) (list 1 'kept-symbol))
+                                (eq (find-symbol "KEPT" "SHAKE-TEST") 'kept)
+                                (null (find-symbol "DROPPED" "SHAKE-TEST"))
+                                (null (find-symbol "DROPPED-SYMBOL" "SHAKE-TEST"))
+                                (null (documentation 'kept 'function)))
+                           0
+                           1)))
+  (sb-ext:save-lisp-and-die "$tmpcore" :toplevel #'main :tree-shake t)
+EOF
+run_sbcl_with_core "$tmpcore" --noinform --no-userinit --no-sysinit --disable-debugger
+check_status_maybe_lose "SAVE-LISP-AND-DIE :TREE-SHAKE" $? 0 "(saved core ran)"
+
+# Packages among the roots keep all their symbols.
+run_sbcl <<EOF
+  (defpackage "SHAKE-TEST" (:use "CL"))
+  (in-package "SHAKE-TEST")
+  (defun dropped (x) (list x 'dropped-symbol))
+  (defun main ()
+    (sb-ext:exit :code (if (and (fboundp (find-symbol "DROPPED" "SHAKE-TEST"))
+                                (find-symbol "DROPPED-SYMBOL" "SHAKE-TEST"))
+                           0
+                           1)))
+  (sb-ext:save-lisp-and-die "$tmpcore" :toplevel #'main
+                            :tree-shake (list (find-package "SHAKE-TEST")))
+EOF
+run_sbcl_with_core "$tmpcore" --noinform --no-userinit --no-sysinit --disable-debugger
+check_status_maybe_lose "SAVE-LISP-AND-DIE :TREE-SHAKE with roots" $? 0 "(saved core ran)"
+
+rm -f "$tmpcore"
+
+exit $EXIT_TEST_WIN
@@ -611,3 +611,159 @@
       `(lambda (v s)
          (replace (the simple-vector v) #() :start1 s))
     ((#(1) 0) #(1) :test #'equalp)))
+
+(with-test (:name (position :octets-and-base-strings))
+  (let ((f (checked-compile
+            `(lambda (item v from-end start end)
+               (position item (the (simple-array (unsigned-byte 8) (*)) v)
+                         :from-end from-end :start start :end end))))
+        (g (checked-compile
+            `(lambda (item v from-end start end)
+               (position item (the simple-base-string v)
+                         :from-end from-end :start start :end end)))))
+    (dotimes (length 24)
+      (dotimes (hit length)
+        (let ((v (make-array length :element-type '(unsigned-byte 8)
+                                    :initial-element 1))
+              (s (make-string length :element-type 'base-char
+                                     :initial-element #\a)))
+          (setf (aref v hit) 7
+                (char s hit) #\z)
+          (loop for start to length
+                do (loop for end from start to length
+                         do (dolist (from-end '(nil t))
+                              (flet ((expect (item seq)
+                                       (position item seq :from-end from-end
+                                                          :start start :end end
+                                                          :test (lambda (x y) (eql x y)))))
+                                (assert (eql (funcall f 7 v from-end start end)
+                                             (expect 7 v)))
+                                (assert (eql (funcall g #\z s from-end start end)
+                                             (expect #\z s)))
+                                (assert (eql (position 7 v :from-end from-end
+                                                           :start start :end end)
+                                             (expect 7 v)))
+                                (assert (eql (position #\z s :from-end from-end
+                                                             :start start :end end)
+                                             (expect #\z s))))))))))
+    (assert (null (funcall f 300 (make-array 3 :element-type '(unsigned-byte 8))
+                           nil 0 3)))
+    (assert (null (funcall g (code-char 200) (coerce "abc" 'simple-base-string)
+                           nil 0 3)))))
+
+(with-test (:name (sort :parallel) :skipped-on (not :sb-thread))
+  (let ((sb-impl::*parallel-sort-threshold* 40000))
+    (flet ((try (vector predicate)
+             (let ((expect (coerce (stable-sort (coerce vector 'simple-vector)
+                                                predicate)
+                                   'list)))
+               (assert (every #'eql (sort (copy-seq vector) predicate) expect))
+               (assert (every #'eql (stable-sort (copy-seq vector) predicate)
+                              expect)))))
+      (dolist (n '(40000 100003))
+        (let ((doubles (make-array n :element-type 'double-float))
+              (fixnums (make-array n :element-type 'fixnum))
+              (words (make-array n :element-type 'word)))
+          (dotimes (i n)
+            (setf (aref doubles i) (- (random 1000d0) 500)
+                  (aref fixnums i) (- (random 1000) 500)
+                  (aref words i) (random (ash 1 sb-vm:n-word-bits))))
+          ;; Ties between 0.0 and -0.0 show whether the order is kept
+          (loop for i from 0 below n by 97
+                do (setf (aref doubles i) (if (oddp i) -0d0 0d0)))
+          (dolist (predicate (list #'< #'>))
+            (try doubles predicate)
+            (try fixnums predicate)
+            (try words predicate)
+            (try (coerce doubles '(simple-array single-float (*))) predicate)))
+        ;; A NaN makes the threads give up, but no element may be lost
+        (let ((v (make-array n :element-type 'double-float :initial-element 1d0)))
+          (setf (aref v 5) (sb-kernel:make-double-float -524288 0))
+          (assert (= (count 1d0 (sort v #'<)) (1- n))))))))
+
+(with-test (:name (sort :radix))
+  (flet ((try (vector type predicate)
+           (let ((expect (coerce (stable-sort (coerce vector 'simple-vector)
+                                              predicate)
+                                 'list))
+                 (inline (checked-compile
+                          `(lambda (v)
+                             (sort (the (simple-array ,type (*)) v)
+                                   #',(if (eq predicate #'<) '< '>))))))
+             ;; SORT needn't keep 0.0 and -0.0 in order
+             (assert (every #'= (funcall inline (copy-seq vector)) expect))
+             (assert (every #'= (sort (copy-seq vector) predicate) expect))
+             (assert (every #'eql (stable-sort (copy-seq vector) predicate)
+                            expect)))))
+    (dolist (n '(0 1 2 63 64 65 1000))
+      (let ((fixnums (make-array n :element-type 'fixnum))
+            (small (make-array n :element-type 'fixnum))
+            (ub32 (make-array n :element-type '(unsigned-byte 32)))
+            (doubles (make-array n :element-type 'double-float)))
+        (dotimes (i n)
+          (setf (aref fixnums i) (- (random most-positive-fixnum)
+                                    (random most-positive-fixnum))
+                (aref small i) (random 100)
+                (aref ub32 i) (random (ash 1 32))
+                (aref doubles i) (case (mod i 7)
+                                   (0 0d0)
+                                   (1 -0d0)
+                                   (2 sb-ext:double-float-negative-infinity)
+                                   (t (- (random 2d10) 1d10)))))
+        (dolist (predicate (list #'< #'>))
+          (try fixnums 'fixnum predicate)
+          (try small 'fixnum predicate)
+          (try ub32 '(unsigned-byte 32) predicate)
+          (try doubles 'double-float predicate))))))
+
+(with-test (:name (fill simple-vector :lengths))
+  ;; VECTOR-FILL/T switches to REP STOS for long vectors on some cpus
+  (dolist (n '(0 1 7 8 9 349 350 351 1000 4097))
+    (dolist (item (list 0 nil (list 1) "foo"))
+      (let ((v (make-array (+ n 2) :initial-element :guard)))
+        (fill v item :start 1 :end (1+ n))
+        (assert (eq (svref v 0) :guard))
+        (assert (eq (svref v (1+ n)) :guard))
+        (loop for i from 1 to n do (assert (eq (svref v i) item)))))))
+
+(with-test (:name (fill replace :unboxed :lengths))
+  ;; Long fills and copies of unboxed vectors call out to C, which
+  ;; switches to non-temporal stores for the longest ones on x86-64
+  (dolist (type '((unsigned-byte 8) (unsigned-byte 16) (unsigned-byte 64) bit))
+    (dolist (n (list 0 1 255 256 257 2047 2048 2049 100003 (* 1024 1024)))
+      (dolist (start '(0 1 3))
+        (let ((v (make-array (+ n start 1) :element-type type :initial-element 0))
+              (copy (make-array (+ n 2) :element-type type :initial-element 0)))
+          (fill v 1 :start start :end (+ start n))
+          (assert (= (count 1 v) n))
+          (assert (zerop (aref v (+ start n))))
+          (unless (zerop start)
+            (assert (zerop (aref v (1- start)))))
+          (replace copy v :start1 1 :start2 start :end2 (+ start n))
+          (assert (= (count 1 copy) n))
+          (assert (zerop (aref copy 0)))
+          (assert (zerop (aref copy (1+ n))))
+          (assert (equalp (subseq copy 1 (1+ n)) (subseq v start (+ start n)))))))))
+
+(with-test (:name (map-into :packed-float-arithmetic))
+  ;; On x86-64 these are done several elements at a time, with the
+  ;; last few left over done one at a time
+  (dolist (type '(single-float double-float))
+    (dolist (op '(+ - *))
+      (let ((fun (checked-compile
+                  `(lambda (result a b)
+                     (declare (optimize speed (space 0))
+                              (type (simple-array ,type (*)) result a b))
+                     (map-into result #',op a b)))))
+        (dolist (n '(0 1 2 3 4 5 7 8 9 100))
+          (let ((a (make-array n :element-type type))
+                (b (make-array (1+ n) :element-type type))
+                (result (make-array (+ n 2) :element-type type
+                                            :initial-element (coerce -1 type))))
+            (dotimes (i n)
+              (setf (aref a i) (coerce (+ i 1/2) type)
+                    (aref b i) (coerce (- 3 i) type)))
+            (assert (eq (funcall fun result a b) result))
+            (dotimes (i n)
+              (assert (= (aref result i) (funcall op (aref a i) (aref b i)))))
+            (assert (= (aref result n) (aref result (1+ n)) -1))))))))
@@ -91,3 +91,66 @@
               (make-handler :input 2 #'car)
               (make-handler :input 9 #'car)
               (make-handler :input 55 #'car))))
+
+(with-test (:name (serve-event :epoll)
+            :skipped-on (not :linux))
+  (let ((sb-impl::*descriptor-handlers* nil)
+        (sb-impl::*epoll-threshold* 4)
+        (called nil))
+    (multiple-value-bind (in out) (sb-unix:unix-pipe)
+      (let ((null (sb-unix:unix-open "/dev/null" sb-unix:o_rdonly 0))
+            (byte (make-array 1 :element-type '(unsigned-byte 8)))
+            (handlers nil))
+        (unwind-protect
+             (flet ((handler (fd) (push fd called)))
+               (dotimes (i 4)
+                 (push (sb-sys:add-fd-handler in :input #'handler) handlers))
+               ;; nothing to read yet
+               (assert (not (sb-sys:serve-event 0)))
+               (assert (integerp (sb-impl::pollfds-epfd
+                                  sb-impl::*descriptor-handlers*)))
+               (sb-unix:unix-write out byte 0 1)
+               (assert (sb-sys:serve-event 1))
+               (assert (equal called (list in in in in)))
+               ;; epoll can't wait on /dev/null, which is always ready
+               (setq called nil)
+               (push (sb-sys:add-fd-handler null :input #'handler) handlers)
+               (sb-sys:with-pinned-objects (byte)
+                 (sb-unix:unix-read in (sb-sys:vector-sap byte) 1))
+               (assert (sb-sys:serve-event 1))
+               (assert (equal called (list null)))
+               ;; back to poll() below half the threshold
+               (mapc #'sb-sys:remove-fd-handler (cdr handlers))
+               (setq handlers (list (car handlers)))
+               (setq called nil)
+               (assert (sb-sys:serve-event 0))
+               (assert (equal called (list null)))
+               (assert (not (sb-impl::pollfds-epfd
+                             sb-impl::*descriptor-handlers*))))
+          (mapc #'sb-sys:remove-fd-handler handlers)
+          (mapc #'sb-unix:unix-close (list in out null)))))))
+
+(with-test (:name (serve-event :pipe))
+  (let ((sb-impl::*descriptor-handlers* nil)
+        (called nil))
+    (multiple-value-bind (in out) (sb-unix:unix-pipe)
+      (let ((byte (make-array 1 :element-type '(unsigned-byte 8)))
+            (handler nil))
+        (unwind-protect
+             (progn
+               ;; nothing to read yet, with or without handlers to serve
+               (assert (not (sb-sys:wait-until-fd-usable in :input 0.05 nil)))
+               (setq handler (sb-sys:add-fd-handler in :input
+                                                    (lambda (fd) (push fd called))))
+               (assert (not (sb-sys:serve-event 0)))
+               (assert (not (sb-sys:serve-event 0.05)))
+               (assert (not called))
+               (sb-unix:unix-write out byte 0 1)
+               (assert (sb-sys:serve-event 1))
+               (assert (equal called (list in)))
+               (assert (sb-sys:wait-until-fd-usable in :input 1 nil))
+               (sb-sys:remove-fd-handler (shiftf handler nil))
+               (assert (sb-sys:wait-until-fd-usable in :input 1 t)))
+          (when handler
+            (sb-sys:remove-fd-handler handler))
+          (mapc #'sb-unix:unix-close (list in out)))))))
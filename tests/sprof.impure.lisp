@@ -18,3 +18,80 @@
           ;; surely more samples is better, right?
           sb-sprof-test::*sprof-loop-test-max-samples* 100)
     (sb-sprof-test::run-tests)))
+
+(defun spin-for-a-second ()
+  (let ((end (+ (get-internal-real-time) internal-time-units-per-second)))
+    (loop while (< (get-internal-real-time) end))))
+
+(with-test (:name (:sprof :thread-cpu-event)
+            :skipped-on (:or (:not :linux) (:not :sb-thread)))
+  ;; Threads made while profiling arm their own samplers, and each
+  ;; of them gets samples for its own CPU time.
+  (let ((threads))
+    (sb-sprof:with-profiling (:event :thread-cpu :sample-interval 0.001
+                              :reset t :report nil)
+      (setq threads (loop repeat 2 collect (sb-thread:make-thread #'spin-for-a-second)))
+      (mapc #'sb-thread:join-thread threads))
+    (sb-sprof:report :type nil)
+    (let ((counts (mapcar (lambda (thread) (cons thread 0)) threads)))
+      (sb-sprof:map-traces (lambda (thread trace)
+                             (declare (ignore trace))
+                             (let ((cell (assoc thread counts)))
+                               (when cell (incf (cdr cell)))))
+                           sb-sprof::*samples*)
+      (assert (every (lambda (x) (> (cdr x) 100)) counts)))))
+
+(with-test (:name (:sprof :continuous) :skipped-on (:not :sb-thread))
+  (let ((profiles))
+    (sb-sprof:start-continuous-profiling :frequency 1000 :interval 0.2
+                                         :output (lambda (octets) (push octets profiles)))
+    (spin-for-a-second)
+    (sb-sprof:stop-continuous-profiling)
+    (assert (>= (length profiles) 2))
+    ;; Each is a Profile message, starting with its sample_type field
+    (assert (every (lambda (octets) (= (aref octets 0) #x0a)) profiles))
+    ;; and the profiler is off
+    (assert (not sb-sprof::*profiling*))))
+
+(with-test (:name (:sprof :write-pprof))
+  (flet ((profile ()
+           (sb-sprof:with-profiling (:sample-interval 0.001 :reset t :report nil)
+             (spin-for-a-second))))
+    (with-scratch-file (f "pb")
+      ;; straight from the sample buffers
+      (profile)
+      (sb-sprof:write-pprof f)
+      (with-open-file (s f :element-type '(unsigned-byte 8))
+        (assert (> (file-length s) 100))
+        (assert (= (read-byte s) #x0a)))
+      ;; and from the samples of a report
+      (profile)
+      (sb-sprof:report :type nil)
+      (sb-sprof:write-pprof f)
+      (with-open-file (s f :element-type '(unsigned-byte 8))
+        (assert (> (file-length s) 100))))))
+
+(defvar *retained*)
+(defun alloc-retained () (push (make-array 1000) *retained*))
+(defun alloc-garbage () (make-array 1000))
+
+(with-test (:name (:sprof :alloc-interval)
+            ;; these record the allocation trap instead of sampling bytes
+            :skipped-on (:or (:not :gencgc) :ppc :ppc64 :sparc))
+  (setq *retained* nil)
+  (sb-sprof:with-profiling (:mode :alloc :alloc-interval 65536 :max-samples 100000
+                            :reset t :report nil)
+    (dotimes (i 2000)
+      (alloc-retained)
+      (dotimes (j 10) (alloc-garbage))))
+  (gc :full t)
+  (let* ((sites (sb-sprof:report-allocation-sites :stream (make-broadcast-stream)))
+         (retained (assoc 'alloc-retained sites))
+         (garbage (assoc 'alloc-garbage sites)))
+    (assert (and retained garbage))
+    (destructuring-bind (n-retained n-retained-live) (cdr retained)
+      (destructuring-bind (n-garbage n-garbage-live) (cdr garbage)
+        ;; ten times the bytes, so about ten times the samples
+        (assert (< (* 5 n-retained) n-garbage (* 20 n-retained)))
+        (assert (> n-retained-live (floor n-retained 2)))
+        (assert (< n-garbage-live (floor n-garbage 10)))))))
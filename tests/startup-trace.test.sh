@@ -0,0 +1,33 @@
+#!/bin/sh
+
+# This software is part of the SBCL system. See the README file for
+# more information.
+#
+# While most of SBCL is derived from the CMU CL system, the test
+# files (like this one) were written from scratch after the fork
+# from CMU CL.
+#
+# This software is in the public domain and is provided with
+# absolutely no warranty. See the COPYING and CREDITS files for
+# more information.
+
+. ./subr.sh
+
+use_test_subdirectory
+
+# --startup-trace-json has to have written each phase of startup, from
+# the runtime and from Lisp, by the time toplevel options are processed.
+tmpjson=$TEST_DIRECTORY/$TEST_FILESTEM.json
+run_sbcl_with_args --startup-trace-json "$tmpjson" --noinform --no-sysinit \
+    --no-userinit --disable-debugger --non-interactive --eval '
+(with-open-file (s "'$tmpjson'")
+  (let ((json (make-string (file-length s))))
+    (read-sequence json s)
+    (exit :code (if (and (search "\"load-core-file\"" json)
+                         (search "\"os-link-runtime\"" json)
+                         (search "\"init-hooks\"" json)
+                         (search "\"major_faults\"" json))
+                    52 1))))'
+check_status_maybe_lose "startup trace JSON" $?
+
+exit $EXIT_TEST_WIN
@@ -871,3 +871,75 @@
         (read-char-no-hang cs)
         (assert (listen cs))))
     (delete-file file)))
+
+(with-test (:name (:fd-stream :serve-events :output-queue)
+            :skipped-on (or :win32 (not :sb-thread)))
+  (multiple-value-bind (in out) (sb-posix:pipe)
+    (sb-posix:fcntl out sb-posix:f-setfl
+                    (logior sb-posix:o-nonblock
+                            (sb-posix:fcntl out sb-posix:f-getfl)))
+    ;; Far more than a pipe holds, so that many buffers are queued
+    (let* ((data (let ((v (make-array (* 100 8192) :element-type '(unsigned-byte 8))))
+                   (dotimes (i (length v) v)
+                     (setf (aref v i) (random 256)))))
+           (reader (sb-thread:make-thread
+                    (lambda ()
+                      (let ((s (sb-sys:make-fd-stream in :input t
+                                                         :element-type '(unsigned-byte 8)))
+                            (v (make-array (length data)
+                                           :element-type '(unsigned-byte 8))))
+                        (sleep .1)
+                        (values (read-sequence v s) v)))))
+           (stream (sb-sys:make-fd-stream out :output t
+                                              :element-type '(unsigned-byte 8)
+                                              :buffering :full
+                                              :serve-events t)))
+      (write-sequence data stream)
+      (finish-output stream)
+      (assert (not (sb-impl::fd-stream-output-queue stream)))
+      (close stream)
+      (multiple-value-bind (n result) (sb-thread:join-thread reader)
+        (assert (= n (length data)))
+        (assert (equalp result data))))))
+
+(with-test (:name sb-sys:copy-stream)
+  (let ((data (let ((v (make-array 100000 :element-type '(unsigned-byte 8))))
+                (dotimes (i (length v) v)
+                  (setf (aref v i) (random 256)))))
+        (from (scratch-file-name))
+        (to (scratch-file-name)))
+    (flet ((contents (file)
+             (with-open-file (s file :element-type '(unsigned-byte 8))
+               (let ((v (make-array (file-length s)
+                                    :element-type '(unsigned-byte 8))))
+                 (read-sequence v s)
+                 v))))
+      (with-open-file (s from :direction :output :if-exists :supersede
+                              :element-type '(unsigned-byte 8))
+        (write-sequence data s))
+      (unwind-protect
+           (progn
+             ;; All of it, having read some already
+             (with-open-file (in from :element-type '(unsigned-byte 8))
+               (with-open-file (out to :direction :output :if-exists :supersede
+                                       :element-type '(unsigned-byte 8))
+                 (assert (= (read-byte in) (aref data 0)))
+                 (write-byte (aref data 0) out)
+                 (assert (= (sb-sys:copy-stream in out) (1- (length data))))
+                 (assert (not (read-byte in nil)))))
+             (assert (equalp (contents to) data))
+             ;; COUNT of them
+             (with-open-file (in from :element-type '(unsigned-byte 8))
+               (with-open-file (out to :direction :output :if-exists :supersede
+                                       :element-type '(unsigned-byte 8))
+                 (assert (= (sb-sys:copy-stream in out 1234) 1234))
+                 (assert (= (read-byte in) (aref data 1234)))))
+             (assert (equalp (contents to) (subseq data 0 1234)))
+             ;; Not fd-streams
+             (let ((out (make-string-output-stream)))
+               (assert (= (sb-sys:copy-stream (make-string-input-stream "hello")
+                                              out)
+                          5))
+               (assert (string= (get-output-stream-string out) "hello"))))
+        (delete-file from)
+        (delete-file to)))))
@@ -511,3 +511,56 @@
       (assert-error (read-char syn))
       (close syn) ; no error
       (assert (eql (read-char *some-stream*) #\o)))))
+
+(with-test (:name (get-output-stream-string :chunks))
+  ;; Long outputs are kept in chunks, which are recycled after
+  ;; extraction. Make sure that recycled chunks don't leak old contents.
+  (dolist (element-type '(base-char character))
+    (let ((stream (make-string-output-stream :element-type element-type)))
+      (dolist (n '(100000 70000 5 0 40000))
+        (let ((expected (make-string n :element-type element-type)))
+          (dotimes (i n)
+            (setf (char expected i) (code-char (+ 32 (mod (* i 7) 90)))))
+          (if (oddp n)
+              (write-string expected stream)
+              (loop for i below n by 1000
+                    do (write-string expected stream :start i
+                                                     :end (min n (+ i 1000)))))
+          (let ((result (get-output-stream-string stream)))
+            (assert (string= result expected))
+            (assert (= (length result) n))))))))
+
+(with-test (:name (get-output-stream-string :one-buffer))
+  (let ((stream (make-string-output-stream)))
+    (write-string "hello" stream)
+    (let ((result (get-output-stream-string stream)))
+      (write-string "world" stream)
+      (assert (string= result "hello"))
+      (assert (string= (get-output-stream-string stream) "world"))))
+  (let ((stream (make-string-output-stream)))
+    (write-char (code-char 955) stream)
+    (assert (string= (get-output-stream-string stream) (string (code-char 955))))
+    (write-string "abc" stream)
+    (let ((result (get-output-stream-string stream)))
+      (assert (typep result '(simple-array character (3))))
+      (assert (string= result "abc"))))
+  (let ((stream (make-string-output-stream :element-type 'base-char)))
+    (write-string "abc" stream)
+    (let ((result (get-output-stream-string stream)))
+      (assert (typep result '(simple-array base-char (3))))
+      (assert (string= result "abc")))))
+
+(with-test (:name sb-sys:write-output-stream-string)
+  (let ((stream (make-string-output-stream))
+        (expected (make-string 50000 :initial-element #\x)))
+    (setf (char expected 40000) (code-char 955))
+    (write-string expected stream)
+    (assert (string= (with-output-to-string (out)
+                       (sb-sys:write-output-stream-string stream out))
+                     expected))
+    (assert (string= (get-output-stream-string stream) ""))
+    (write-string "abc" stream)
+    (file-position stream 1)
+    (assert (string= (with-output-to-string (out)
+                       (sb-sys:write-output-stream-string stream out))
+                     "abc"))))
@@ -278,3 +278,54 @@ claim that any particular result from these edge cases constitutes a bug.
   (assert-error
    (funcall (opaque-identity 'make-string) 10
             :element-type '(member #\a #\b #\c) :initial-element #\x)))
+
+(with-test (:name (string= :long-strings-at-offsets))
+  ;; Long enough for the string= methods that call memcmp()
+  (dolist (type '(base-char character))
+    (let ((a (make-string 100 :element-type type :initial-element #\a))
+          (b (make-string 100 :element-type type :initial-element #\a)))
+      (loop for length in '(31 32 33 64 97)
+            do (loop for start from 0 to 3
+                     do (assert (string= a b :start1 start :end1 (+ start length)
+                                             :start2 0 :end2 length))
+                        (setf (char b (1- length)) #\b)
+                        (assert (not (string= a b :start1 start :end1 (+ start length)
+                                                  :start2 0 :end2 length)))
+                        (setf (char b (1- length)) #\a))))))
+
+(with-test (:name (string-upcase string-downcase string-equal :ascii-at-offsets))
+  ;; All of ASCII, in pieces that don't line up with words
+  (let ((ascii (coerce (loop for code below 128 collect (code-char code)) 'base-string)))
+    (dolist (type '(base-char character))
+      (let ((string (coerce ascii `(simple-array ,type (*)))))
+        (loop for start from 0 to 9
+              do (loop for end from (+ start 0) to 128 by 7
+                       for upcased = (string-upcase string :start start :end end)
+                       for downcased = (string-downcase string :start start :end end)
+                       do (loop for i below 128
+                                for char = (char string i)
+                                for inside = (< (1- start) i end)
+                                do (assert (char= (char upcased i)
+                                                  (if inside (char-upcase char) char)))
+                                   (assert (char= (char downcased i)
+                                                  (if inside (char-downcase char) char))))
+                          (assert (string-equal upcased downcased :start1 start :end1 end
+                                                                  :start2 start :end2 end))
+                          (assert (string-equal (subseq upcased start end)
+                                                (subseq downcased start end)))
+                          (when (< (1+ start) end)
+                            (assert (not (string-equal upcased downcased
+                                                       :start1 (1+ start) :end1 end
+                                                       :start2 start :end2 (1- end)))))))))
+    (assert (string-equal "Content-Type: text/html" "content-type: TEXT/HTML"))
+    (assert (not (string-equal "Content-Type: text/html" "content-type: TEXT/HTMM")))
+    (assert (not (string-equal "[" "{")))
+    (assert (not (string-equal "@@@@@@@@@" "`````````")))))
+
+#+sb-unicode
+(with-test (:name (sb-unicode:normalize-string :ascii))
+  (let ((string (coerce "plain ASCII text" '(simple-array character (*)))))
+    (dolist (form '(:nfd :nfc :nfkd :nfkc))
+      (let ((normalized (sb-unicode:normalize-string string form)))
+        (assert (string= normalized string))
+        (assert (not (eq normalized string)))))))
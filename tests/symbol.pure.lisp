@@ -72,3 +72,24 @@
    '(lambda (vars vals)
      (progv vars vals))
    ((nil nil) nil)))
+
+(defvar *bind-n-a* :a0)
+(defvar *bind-n-b* :b0)
+(defvar *bind-n-c* :c0)
+
+(with-test (:name (let :several-specials))
+  (checked-compile-and-assert
+   ()
+   '(lambda (x throwp)
+     (flet ((current () (list *bind-n-a* *bind-n-b* *bind-n-c*)))
+       (list
+        (let ((*bind-n-a* x) (*bind-n-b* 1) (*bind-n-c* nil))
+          (let ((*bind-n-a* *bind-n-b*) (*bind-n-b* *bind-n-a*))
+            (current)))
+        (current)
+        (catch 'out
+          (let ((*bind-n-a* 'inner) (*bind-n-c* (make-list 2)))
+            (if throwp (throw 'out (current)) (current))))
+        (current))))
+   ((42 nil) '((1 42 nil) (:a0 :b0 :c0) (inner :b0 (nil nil)) (:a0 :b0 :c0)))
+   (("x" t) '((1 "x" nil) (:a0 :b0 :c0) (inner :b0 (nil nil)) (:a0 :b0 :c0)))))
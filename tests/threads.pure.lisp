@@ -377,6 +377,21 @@
           (expected (loop for i from 9 downto 0 collect i)))
       (assert (equal (remove nil values) expected)))))
 
+(with-test (:name (wait-on-semaphore :timeout :spurious-wakeups)
+            :skipped-on (not :sb-thread))
+  ;; Interruptions wake the waiter early, many times. It must neither time out
+  ;; before the deadline nor keep extending it.
+  (let* ((semaphore (make-semaphore))
+         (start (get-internal-real-time))
+         (waiter (make-thread (lambda () (wait-on-semaphore semaphore :timeout 0.3)))))
+    (loop repeat 20
+          do (sleep 0.01)
+             (ignore-errors (interrupt-thread waiter (lambda ()))))
+    (assert (not (join-thread waiter)))
+    (let ((elapsed (/ (- (get-internal-real-time) start)
+                      internal-time-units-per-second)))
+      (assert (<= 0.29 elapsed 5)))))
+
 (with-test (:name (wait-on-semaphore :timeout :many-threads)
             :skipped-on (not :sb-thread))
   (let* ((count 10)
@@ -510,3 +525,31 @@
               (read-line stream)))
           :name "testme")))
     (assert (string= (join-thread thr) "testme"))))
+
+(with-test (:name (:rwlock :exclusion)
+            :skipped-on (not :sb-thread))
+  (let* ((lock (make-rwlock :name "pair"))
+         (pair (cons 0 0))
+         (done nil)
+         (readers
+           (loop repeat 4
+                 collect (make-thread
+                          (lambda ()
+                            (loop for n from 0
+                                  until done
+                                  do (with-rwlock-read (lock)
+                                       (assert (= (car pair) (cdr pair))))
+                                  finally (return n))))))
+         (writers
+           (loop repeat 2
+                 collect (make-thread
+                          (lambda ()
+                            (dotimes (i 2000)
+                              (with-rwlock-write (lock)
+                                (incf (car pair))
+                                (sleep 0)
+                                (incf (cdr pair)))))))))
+    (mapc #'join-thread writers)
+    (setq done t)
+    (assert (every #'plusp (mapcar #'join-thread readers)))
+    (assert (equal pair '(4000 . 4000)))))
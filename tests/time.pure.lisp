@@ -29,3 +29,34 @@
   (let ((output (with-output-to-string (*trace-output*)
                   (time (checked-compile '(lambda () 42))))))
     (assert (search "1 lambda converted" output))))
+
+(with-test (:name (sb-ext:get-monotonic-nanoseconds :monotonic))
+  (let ((time0 (sb-ext:get-monotonic-nanoseconds)))
+    #+64-bit (assert (typep time0 'fixnum))
+    (loop repeat 1000
+          for time = (sb-ext:get-monotonic-nanoseconds)
+          do (assert (>= time time0))
+             (setq time0 time))))
+
+(with-test (:name (sb-ext:get-monotonic-nanoseconds :no-consing)
+            :skipped-on (or (not :64-bit) :interpreter))
+  (ctu:assert-no-consing (sb-ext:get-monotonic-nanoseconds)))
+
+(with-test (:name (decode-universal-time :tz-changes) :skipped-on :win32)
+  (let ((tz (sb-unix::posix-getenv "TZ"))
+        (time (encode-universal-time 0 0 12 1 7 2021 0)))
+    (flet ((decode (tz)
+             (test-util::setenv "TZ" tz)
+             (multiple-value-bind (second minute hour date month year day dst zone)
+                 (decode-universal-time time)
+               (declare (ignore second minute date month year day))
+               (list hour dst zone))))
+      (unwind-protect
+           (assert (equal (list (decode "EST5EDT,M3.2.0,M11.1.0")
+                                (decode "UTC0")
+                                (decode "<+0530>-5:30")
+                                (decode "CET-1CEST,M3.5.0,M10.5.0/3"))
+                          '((8 t 5) (12 nil 0) (17 nil -11/2) (14 t -1))))
+        (if tz
+            (test-util::setenv "TZ" tz)
+            (alien-funcall (extern-alien "unsetenv" (function int c-string)) "TZ"))))))
@@ -23,6 +23,24 @@
     (unless (equal sorted heap-sorted)
       (error "Heap sort failure ~S" heap-sorted))))
 
+(with-test (:name (:heap :extract-from-middle))
+  (let ((heap (make-array 0 :adjustable t :fill-pointer 0))
+        (positions (make-hash-table)))
+    (flet ((position (item index)
+             (if index
+                 (setf (gethash item positions) index)
+                 (remhash item positions))))
+      (dotimes (i 300)
+        (sb-impl::heap-insert heap (random 1d0) :position #'position))
+      (loop while (plusp (length heap))
+            do (sb-impl::heap-extract heap (random (length heap)) :position #'position)
+               (assert (loop for i from 1 below (length heap)
+                             always (>= (aref heap (sb-impl::heap-parent i))
+                                        (aref heap i))))
+               (assert (= (hash-table-count positions) (length heap)))
+               (assert (loop for i below (length heap)
+                             always (eql (gethash (aref heap i) positions) i)))))))
+
 (sb-alien:define-alien-routine "check_deferrables_blocked_or_lose"
     void
   (where sb-alien:unsigned-long))
@@ -300,6 +318,16 @@
         (loop for thread in threads
               do (sb-thread:join-thread thread :timeout 40))))))
 
+(with-test (:name (:timer :unschedule-many))
+  (let ((timers (loop repeat 2000 collect (make-timer (lambda ())))))
+    (dolist (timer timers)
+      (schedule-timer timer (+ 1000 (random 1000))))
+    ;; Unschedule from the middle of the schedule, in no particular order
+    (loop for (timer) on timers by #'cddr do (unschedule-timer timer))
+    (loop for (nil timer) on timers by #'cddr do (unschedule-timer timer))
+    (assert (zerop (length (sb-impl::%pqueue-contents sb-impl::*schedule*))))
+    (assert (notany #'sb-impl::%timer-schedule-index timers))))
+
 ;; A timer with a repeat interval can be configured to "catch up" in
 ;; case of missed calls.
 (with-test (:name (:timer :catch-up))
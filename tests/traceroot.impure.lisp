@@ -129,3 +129,20 @@
 #+gencgc
 (with-test (:name (sb-ext:search-roots :ignore-immediate))
   (sb-ext:search-roots (make-weak-pointer 48) :gc t :print nil))
+
+(defvar *many-targets*)
+(with-test (:name (sb-ext:search-roots :many-targets))
+  ;; Every target is reachable through the same vector. The paths found
+  ;; after the first one join it there instead of being traced to the root.
+  (setq *many-targets*
+        (coerce (loop for i below 2000 collect (list (make-foo :a i))) 'vector))
+  (let* ((wps (map 'list (lambda (x) (make-weak-pointer (car x))) *many-targets*))
+         (paths (sb-ext:search-roots wps :criterion :static :print nil)))
+    (assert (= (length paths) 2000))
+    (loop for (target) in paths
+          for wp in wps
+          do (assert (eq target (weak-pointer-value wp))))
+    ;; Allow for a few targets being seen on the stack
+    (assert (> (count-if (lambda (path) (find *many-targets* (cddr path) :key #'car))
+                         paths)
+               1990))))
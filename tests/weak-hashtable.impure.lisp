@@ -53,3 +53,31 @@
     (setf (gethash 10 hash) (sb-kernel:%make-lisp-obj sb-vm:other-pointer-lowtag))
     (sb-ext:gc :full t)
     hash))
+
+(with-test (:name :cull-large-weak-value-table)
+  ;; Enough buckets to be split into many ranges for culling
+  (let ((table (make-hash-table :weakness :value))
+        (keep (make-array 100000)))
+    (dotimes (i 200000)
+      (let ((value (list i)))
+        (when (evenp i) (setf (aref keep (floor i 2)) value))
+        (setf (gethash i table) value)))
+    (gc :full t)
+    (assert (= (hash-table-count table) 100000))
+    (dotimes (i 100000)
+      (assert (eq (gethash (* 2 i) table) (aref keep i))))))
+
+(with-test (:name :weak-key-chain)
+  ;; Each value is the key of the next entry, so the entries become live
+  ;; one at a time over as many rounds of trigger testing
+  (let* ((table (make-hash-table :weakness :key))
+         (keys (loop for i below 1000 collect (list i)))
+         (head (first keys)))
+    (loop for (key next) on keys
+          do (setf (gethash key table) (or next 'end)))
+    (setq keys nil)
+    (gc :full t)
+    (assert (= (hash-table-count table) 1000))
+    (let ((key head))
+      (loop repeat 999 do (setq key (gethash key table)))
+      (assert (eq (gethash key table) 'end)))))
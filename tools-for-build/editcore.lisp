@@ -1736,6 +1736,17 @@
                                           :element-type 'base-char)))
                  (%byte-blt core-header (* (1+ ptr) n-word-bytes) string 0 (length string))
                  (format t "Build ID [~a]~%" string))))
+            (#.base-core-entry-type-code
+             (error "~A is a delta core, which can't be split" input-pathname))
+            (#.relocation-map-core-entry-type-code
+             (aver (= len 3))
+             ;; This precedes the directory, so its page needs no adjustment
+             (symbol-macrolet ((nbytes (%vector-raw-bits core-header (+ ptr 1)))
+                               (data-page (%vector-raw-bits core-header (+ ptr 2))))
+               (when verbose
+                 (format t "relocation map: page=~5x~40tbytes=~8x~%" data-page nbytes))
+               (incf original-total-npages (ceiling nbytes +backend-page-bytes+))
+               (push (cons data-page nbytes) copy-actions)))
             (#.directory-core-entry-type-code
              (do-directory-entry ((index ptr len) core-header)
                (incf original-total-npages npages)
@@ -1905,6 +1916,11 @@
              (core-size 0))
         (do-core-header-entry ((id len ptr) core-header)
           (case id
+            (#.base-core-entry-type-code
+             (error "~A is a delta core, which can't be converted" input-pathname))
+            (#.relocation-map-core-entry-type-code
+             (incf total-npages (ceiling (%vector-raw-bits core-header (+ ptr 1))
+                                         +backend-page-bytes+)))
             (#.directory-core-entry-type-code
              (do-directory-entry ((index ptr len) core-header)
                (incf total-npages npages)